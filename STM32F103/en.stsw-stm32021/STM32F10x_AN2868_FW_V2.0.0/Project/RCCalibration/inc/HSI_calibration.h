@@ -26,25 +26,43 @@
 /* Includes ------------------------------------------------------------------*/
 
 /* Exported types ------------------------------------------------------------*/
+/* Trimming service state */
+typedef enum
+{
+  HSI_TRIM_IDLE = 0,   /* Service stopped, HSITRIM left untouched */
+  HSI_TRIM_SEARCH,     /* Binary search over HSITRIM[4:0] */
+  HSI_TRIM_TRACK,      /* Searched: watching the error at the current HSITRIM */
+  HSI_TRIM_PROBE       /* Tracking: measuring the neighbour HSITRIM value */
+} HSI_TrimState_TypeDef;
+
 /* Exported constants --------------------------------------------------------*/
 /* Comment this line if the RTC/64 signal (PC13) is not the reference frequency */
 #define USE_Reference_RTC
 #define Ref_Frequency   512 /* The reference frequency value in Hertz */
-#define NbOfPeriod       10 /* NbOfPeriod must be less than
-                                0xFFFFFFFF / Freq(HSITRIM)max 
-                                If we assume that Freq(HSITRIM)max don't exceed
-                                8600000Hz. So NbOfPeriod value must be less than
-                                499 */
+#define NbOfPeriod       10 /* Number of reference periods per measurement window.
+                               The ticks of one window are accumulated in 32 bits:
+                               NbOfPeriod * TIM3CLK / Ref_Frequency must stay
+                               below 0xFFFFFFFF (NbOfPeriod < 30000 with
+                               TIM3CLK = 72MHz and the RTC/64 reference) */
+#define HSI_MaxOverflow  16 /* Timer overflows without a reference edge before
+                               the current measurement window is dropped */
 /* Exported macro ------------------------------------------------------------*/
+/* Exported variables --------------------------------------------------------*/
+extern __IO HSI_TrimState_TypeDef HSI_TrimState;
+extern __IO int32_t Real_RC_Frequency;
+extern __IO int32_t HSI_TrimError;
+extern __IO uint32_t HSI_TrimStep;
+extern __IO uint32_t HSI_TrimWindows;
+
 /* Exported functions ------------------------------------------------------- */
 void HSI_FreqMeasure(void);
-int32_t HSI_CalibrateMinError(void);
-ErrorStatus HSI_CalibrateFixedError(uint32_t AllowedErrorMax, int32_t* Freq);
+ErrorStatus HSI_TrimStart(uint32_t AllowedErrorMax);
+void HSI_TrimStop(void);
+ErrorStatus HSI_TrimGetStatus(void);
 void RCC_ConfigurationForHSI(void);
 void TIM_ConfigurationForHSI(void);
 void RTC_ConfigurationForHSI(void);
 void GPIO_ConfigurationForHSI(void);
-void Restore_RCC_UserConfiguration(void);
 #endif /* __HSI_CALIBRATION_H */
 
 /******************* (C) COPYRIGHT 2009 STMicroelectronics *****END OF FILE****/
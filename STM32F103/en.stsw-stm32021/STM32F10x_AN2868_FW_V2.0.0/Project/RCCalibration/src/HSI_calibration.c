@@ -19,384 +19,467 @@
   */ 
 
 
+
 /* Includes ------------------------------------------------------------------*/
 #include "stm32f10x.h"
 #include "HSI_calibration.h"
 
 /* Private variables--------------------------------------------------------- */
 __IO uint32_t IC1_ValueHSI = 0;
-uint32_t N_OverflowCounter = 0;
+__IO uint32_t N_OverflowCounter = 0;
 __IO int32_t Real_RC_Frequency=0;
-__IO uint32_t MeasurementDone=0;
-uint32_t CurrentPeriodFreq=0;
-__IO uint32_t Real_RC_Frequency_cumul = 0;
 __IO uint32_t PeriodCount=0;
-uint32_t APB1_UserPeriph=0;
-uint32_t APB2_UserPeriph=0;
+__IO uint32_t WindowTicks = 0;
 FunctionalState BA_bit = DISABLE;
 FunctionalState CC0_Bit= DISABLE;
 
+/* Trimming service state, published to the application */
+__IO HSI_TrimState_TypeDef HSI_TrimState = HSI_TRIM_IDLE;
+__IO int32_t HSI_TrimError = 0;      /* HSI error in Hz at the applied HSITRIM */
+__IO uint32_t HSI_TrimStep = 0;      /* Measured frequency step of one HSITRIM unit */
+__IO uint32_t HSI_TrimWindows = 0;   /* Completed measurement windows */
+
 /** @addtogroup RCCalibration
   * @{
-  */ 
+  */
 
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
+#define HSITRIM_Max        31
+#define HSITRIM_Default    16
+
 /* Private macro -------------------------------------------------------------*/
+#define HSI_ABS(x)         (((x) < 0) ? (uint32_t)(-(x)) : (uint32_t)(x))
+
 /* Private variables ---------------------------------------------------------*/
+static uint32_t HSI_TimerClock = 0;
+static uint32_t HSI_AllowedError = 0;
+static uint8_t HSITRIM = HSITRIM_Default;
+static uint8_t TrimLow = 0;
+static uint8_t TrimHigh = HSITRIM_Max;
+static uint8_t TrimPrevious = HSITRIM_Default;
+static int32_t ErrorPrevious = 0;
+static uint32_t TrimMeasured = 0;
+static int32_t TrimFrequency[HSITRIM_Max + 1];
+
 /* Private function prototypes -----------------------------------------------*/
-extern void RCC_Configuration(void);
+static int32_t HSI_WindowFrequency(uint32_t Ticks);
+static FlagStatus HSI_TrimNext(int32_t Frequency);
+static void HSI_SearchDone(void);
 
 /* Private functions ---------------------------------------------------------*/
 
 
 /**
-  * @brief  Restore the RCC user configuration (configuration before
-  *   calibration procedure)
-  * @param  None
-  * @retval : None
+  * @brief  Converts the timer ticks of one measurement window into the HSI
+  *   frequency. TIM3 runs from a clock derived from the HSI, so the ticks
+  *   counted during NbOfPeriod reference periods scale with the HSI.
+  * @param Ticks: TIM3 ticks counted during NbOfPeriod reference periods
+  * @retval : The HSI frequency in Hz
   */
-void Restore_RCC_UserConfiguration(void)
+static int32_t HSI_WindowFrequency(uint32_t Ticks)
 {
-  /* Call your default RCC configuration here, for exemple: RCC_Configuration(); */
-   RCC_Configuration();
+  return (int32_t)(((uint64_t)Ticks * Ref_Frequency * HSI_Value) /
+                   ((uint64_t)HSI_TimerClock * NbOfPeriod));
 }
 
 
-
 /**
-  * @brief  Calibrates the internal RC and returns the current frequency 
-  *   after calibration.
+  * @brief  Measures the HSI frequency against the reference. Called from
+  *   the TIM3 interrupt: the reference edges reset TIM3 (slave reset mode),
+  *   so every capture holds one full reference period. Each NbOfPeriod
+  *   periods the trimming state machine is stepped.
   * @param  None
   * @retval : None
   */
 void HSI_FreqMeasure(void)
-{  
+{
   /* If the counter has overflowed */
-  if((TIM_GetITStatus(TIM3, TIM_IT_Update) == SET)&&(MeasurementDone == 0)) 
+  if(TIM_GetITStatus(TIM3, TIM_IT_Update) == SET)
   {
     /* Clear TIM3 counter update interrupt pending bit */
     TIM_ClearITPendingBit(TIM3, TIM_IT_Update);
-    
+
     /* Increment N_OverflowCounter if the overflow condition has been occured */
     N_OverflowCounter ++;
+
+    /* The reference is missing: drop the current window */
+    if(N_OverflowCounter > HSI_MaxOverflow)
+    {
+      N_OverflowCounter = 0;
+      WindowTicks = 0;
+      PeriodCount = 0;
+    }
   }
-      
+
   /* If the Input capture 1 interrupt has been occured: new period occured */
-  if((TIM_GetITStatus(TIM3, TIM_IT_CC1) == SET)&&(MeasurementDone == 0))
-  {	
+  if(TIM_GetITStatus(TIM3, TIM_IT_CC1) == SET)
+  {
     /* Clear TIM3 Capture compare 1 interrupt pending bit */
     TIM_ClearITPendingBit(TIM3, TIM_IT_CC1);
-    
+
     /* Get the Input Capture 1 value of timer TIM3 */
     IC1_ValueHSI = TIM_GetCapture1(TIM3);
-             
-    /* Compute the frequency */
-   CurrentPeriodFreq = Ref_Frequency * (IC1_ValueHSI + ((N_OverflowCounter-1) * 0xFFFF));
-    
-    if(PeriodCount!=0)
+
+    /* The reset of the counter by the reference edge does not raise an
+       update event (TIM_UpdateSource_Regular), so N_OverflowCounter only
+       holds the real overflows of this period */
+    WindowTicks += IC1_ValueHSI + (N_OverflowCounter << 16);
+    N_OverflowCounter = 0;
+
+#ifdef  USE_Reference_RTC
+    /* Ignore the edges produced while the LSE is starting: the window
+       starts on the first edge seen with the LSE ready */
+    if(RCC_GetFlagStatus(RCC_FLAG_LSERDY) == RESET)
     {
-      /* Add the current frequency to previous cumulation */
-      Real_RC_Frequency_cumul = Real_RC_Frequency_cumul + CurrentPeriodFreq;
-    
-      /* If the number of desired period is reached, compute the frequency average */
-      if(PeriodCount==NbOfPeriod)
-      {    
-        /* Compute the HSI frequency average of the the current HSITRIM configuration */
-        Real_RC_Frequency = (int32_t)(Real_RC_Frequency_cumul / NbOfPeriod);
-        /* Initialize the frequency cumulation variable */
-        Real_RC_Frequency_cumul = 0;
-        /* Initialize the measured period number */
-        PeriodCount=0;
-        /* Set the "measurement done": the frequency of all desired periods has 
-           been measured */
-        MeasurementDone = 1;
+      PeriodCount = 0;
+      return;
+    }
+#endif
+
+    /* The first edge only starts the window */
+    if(PeriodCount == 0)
+    {
+      WindowTicks = 0;
+    }
+
+    /* If the number of desired period is reached, compute the frequency */
+    if(PeriodCount == NbOfPeriod)
+    {
+      Real_RC_Frequency = HSI_WindowFrequency(WindowTicks);
+      WindowTicks = 0;
+      PeriodCount = 0;
+      HSI_TrimWindows++;
+
+      /* A new HSITRIM value makes the running period a mix of the two
+         frequencies: restart the window on the next edge */
+      if(HSI_TrimNext(Real_RC_Frequency) == SET)
+      {
+        return;
       }
     }
-    
-    /* Initialize N_OverflowCounter */
-    N_OverflowCounter = 0;
+
     /* Increment the number of measured periods */
     PeriodCount ++;
   }
 }
 
 
+/**
+  * @brief  Steps the trimming state machine with the frequency measured
+  *   at the current HSITRIM value.
+  * @param Frequency: HSI frequency measured over the last window
+  * @retval : SET if a new HSITRIM value has been applied, RESET otherwise
+  */
+static FlagStatus HSI_TrimNext(int32_t Frequency)
+{
+  int32_t Error = Frequency - (int32_t)HSI_Value;
+  uint32_t Threshold = 0;
+
+  switch(HSI_TrimState)
+  {
+    case HSI_TRIM_SEARCH:
+      TrimFrequency[HSITRIM] = Frequency;
+      TrimMeasured |= (uint32_t)1 << HSITRIM;
+
+      /* The HSI frequency grows with HSITRIM: keep the interval holding
+         the first value at or above the target */
+      if(Frequency < (int32_t)HSI_Value)
+      {
+        TrimLow = HSITRIM + 1;
+      }
+      else
+      {
+        TrimHigh = HSITRIM;
+      }
+
+      if(TrimLow < TrimHigh)
+      {
+        HSITRIM = (TrimLow + TrimHigh) / 2;
+      }
+      else if((TrimMeasured & ((uint32_t)1 << TrimLow)) == 0)
+      {
+        HSITRIM = TrimLow;
+      }
+      else if((TrimLow != 0) && ((TrimMeasured & ((uint32_t)1 << (TrimLow - 1))) == 0))
+      {
+        HSITRIM = TrimLow - 1;
+      }
+      else
+      {
+        HSI_SearchDone();
+      }
+      break;
+
+    case HSI_TRIM_TRACK:
+      HSI_TrimError = Error;
+
+      /* Move one step only when it brings the error down: half a step plus
+         some hysteresis against the measurement noise */
+      Threshold = HSI_TrimStep / 2 + HSI_TrimStep / 8;
+      if(Threshold < HSI_AllowedError)
+      {
+        Threshold = HSI_AllowedError;
+      }
+
+      if(HSI_ABS(Error) > Threshold)
+      {
+        if((Error > 0) && (HSITRIM > 0))
+        {
+          TrimPrevious = HSITRIM;
+          ErrorPrevious = Error;
+          HSITRIM--;
+          HSI_TrimState = HSI_TRIM_PROBE;
+        }
+        else if((Error < 0) && (HSITRIM < HSITRIM_Max))
+        {
+          TrimPrevious = HSITRIM;
+          ErrorPrevious = Error;
+          HSITRIM++;
+          HSI_TrimState = HSI_TRIM_PROBE;
+        }
+      }
+      break;
+
+    case HSI_TRIM_PROBE:
+      HSI_TrimStep = HSI_ABS(Error - ErrorPrevious);
+      HSI_TrimState = HSI_TRIM_TRACK;
+
+      if(HSI_ABS(Error) < HSI_ABS(ErrorPrevious))
+      {
+        /* Keep the neighbour value */
+        HSI_TrimError = Error;
+        return RESET;
+      }
+
+      /* The neighbour is not better: go back */
+      HSITRIM = TrimPrevious;
+      break;
+
+    default:
+      return RESET;
+  }
+
+  if(((RCC->CR & RCC_CR_HSITRIM) >> 3) == HSITRIM)
+  {
+    return RESET;
+  }
+
+  /* Set the HSITRIM[4:0] bits to the new value */
+  RCC_AdjustHSICalibrationValue(HSITRIM);
+  return SET;
+}
+
 
 /**
-  * @brief  Calibrates the internal RC with the minimum error found 
-  *   and returns the frequency error after calibration.
+  * @brief  Ends the binary search: applies the measured HSITRIM value with
+  *   the minimum error and derives the frequency step of one HSITRIM unit
+  *   from the measured values.
   * @param  None
-  * @retval : The HSI frequency value after calibration
+  * @retval : None
   */
-int32_t HSI_CalibrateMinError(void)
+static void HSI_SearchDone(void)
 {
-   NVIC_InitTypeDef  NVIC_InitStructureForHSI; 
-   int32_t FrequencyAfterCalib = 0;
-   uint8_t Calibration_value=0;
-   int32_t CurrentError=0;
-   uint32_t PreviousError = 1000000; /* large value */
-   uint8_t HSITRIM=0;
-   
-   /* System clock configuration for HSI calibration process */
-   RCC_ConfigurationForHSI();
+  uint32_t BestError = 0xFFFFFFFF;
+  uint8_t First = HSITRIM_Max + 1;
+  uint8_t Last = 0;
+  uint8_t i = 0;
 
-    /* Enable the TIM3 global Interrupt */
-   NVIC_InitStructureForHSI.NVIC_IRQChannel = TIM3_IRQn;
-   NVIC_InitStructureForHSI.NVIC_IRQChannelPreemptionPriority = 1;
-   NVIC_InitStructureForHSI.NVIC_IRQChannelSubPriority = 1;
-   NVIC_InitStructureForHSI.NVIC_IRQChannelCmd = ENABLE;
-   NVIC_Init(&NVIC_InitStructureForHSI);
+  for(i = 0; i <= HSITRIM_Max; i++)
+  {
+    if((TrimMeasured & ((uint32_t)1 << i)) == 0)
+    {
+      continue;
+    }
 
-   /* Configure the GPIO ports for HSI calibration process */
-   GPIO_ConfigurationForHSI();
+    if(First > HSITRIM_Max)
+    {
+      First = i;
+    }
+    Last = i;
 
-#ifdef  USE_Reference_RTC   
-   /* RTC configuration for HSI calibration process if the clock souce is RTC */
-   RTC_ConfigurationForHSI();
-  
-   /* output the RTC clock with frequency divided by 64 on the Tamper pin */
-   BKP_RTCOutputConfig(BKP_RTCOutputSource_CalibClock);
-#endif   
-  
-   /* Configure the timer TIM3 for HSI calibration process */
-   TIM_ConfigurationForHSI();
+    if(HSI_ABS(TrimFrequency[i] - (int32_t)HSI_Value) < BestError)
+    {
+      BestError = HSI_ABS(TrimFrequency[i] - (int32_t)HSI_Value);
+      HSITRIM = i;
+    }
+  }
 
-   /* RC Frequency measurement for different values 0 to 31 of HSITRIM[4:0] bits
-      in RCC_CR register */
-   for (HSITRIM=0; HSITRIM<32; HSITRIM++)
-   {
-     /* Reset "measurement done" */
-     MeasurementDone = 0;
-  
-     /* Set the HSITRIM[4:0] bits to HSITRIM value to be ready for measurement */
-     RCC_AdjustHSICalibrationValue(HSITRIM);
-    
-     /* Start Frequency measurement for current HSITRIM value:
-     Enable TIM3 and its interrupts */
-     TIM_Cmd(TIM3, ENABLE); 
-     TIM_ITConfig(TIM3, TIM_IT_CC1 | TIM_IT_Update, ENABLE);
-    
-     /* Wait for all periods of the current frequency were measured */
-     while (MeasurementDone == 0)
-     {
-     }
-     
-     /* Initialize the counted periods after measurement */
-     PeriodCount=0;
-     
-     /* Disable TIM3 */
-     TIM_Cmd(TIM3, DISABLE); 
-    
-     /* Disable TIM3 interrupts to avoid to enter again in the interrpt routine */
-     TIM_ITConfig(TIM3, TIM_IT_CC1 | TIM_IT_Update, DISABLE);
-     
-     /* Compute current frequency Error corresponding to the current HSITRIM value */
-     if((Real_RC_Frequency - 8000000) < 0)
-     {
-       CurrentError = 8000000 - Real_RC_Frequency;
-     }
-     else
-     {
-       CurrentError = Real_RC_Frequency - 8000000;
-     }
-     
-     /* Get the best calibration value to have the nearest frequency value to 
-        8000000Hz of the HSI in this chip */
-     if(PreviousError > CurrentError)
-     {
-       PreviousError = CurrentError;
-       Calibration_value = HSITRIM;
-       FrequencyAfterCalib = Real_RC_Frequency;
-     }
-   }
-   
-    /* Set HSITRIM bits corresponding to the nearest frequency */
-    RCC_AdjustHSICalibrationValue(Calibration_value);
-   
-    /* Disable TIM3 and its interrupts */
-    NVIC_InitStructureForHSI.NVIC_IRQChannel = TIM3_IRQn;
-    NVIC_InitStructureForHSI.NVIC_IRQChannelCmd = DISABLE;
-    NVIC_Init(&NVIC_InitStructureForHSI);
-
-#ifdef  USE_Reference_RTC     
-    /* Restore user configuration of RTC output on the Tamper pin after calibration */
-    BKP_RTCOutputConfig(CC0_Bit);
-    
-    /* Restore the user configuration of the access to BKP Domain after calibration */
-    PWR_BackupAccessCmd(BA_bit);
-#endif
-    
-    /* Restore RCC User configuration after calibration process */
-    Restore_RCC_UserConfiguration();
-                      
-    /* Return the RC frequency after calibration */
-    return (FrequencyAfterCalib);
-}
+  if(Last > First)
+  {
+    HSI_TrimStep = (uint32_t)(TrimFrequency[Last] - TrimFrequency[First]) /
+                   (Last - First);
+  }
 
+  HSI_TrimError = TrimFrequency[HSITRIM] - (int32_t)HSI_Value;
+  HSI_TrimState = HSI_TRIM_TRACK;
+}
 
 
 /**
-  * @brief  Calibrates the internal RC with the maximum allowed Error 
-  *   value fixed by the user. If this value was not found, this
-  *   function sets the RC frequency to default value (HSITRIM = 16).
-  * @param AllowedErrorMax: maximum absolute value allowed of the HSI 
-  *   frequency Error given in Hz.
-  * @param Freq: pointer to a uint32_t variable that will contain the value  
-  *   of the HSI frequency after calibration.
+  * @brief  Starts the background HSI trimming. The function returns at
+  *   once: the TIM3 interrupt measures the HSI against the reference,
+  *   runs a binary search over HSITRIM[4:0] and then keeps tracking the
+  *   HSI drift one HSITRIM step at a time. HSI_TrimError publishes the
+  *   error measured at the applied HSITRIM value.
+  *   The system clock must be the HSI or the PLL fed by HSI/2, TIM3 is
+  *   clocked from it.
+  * @param AllowedErrorMax: absolute HSI error in Hz accepted before the
+  *   tracking moves HSITRIM. 0 keeps the HSITRIM value with the minimum
+  *   error.
   * @retval : - An ErrorStatus enumuration value:
-  * @param SUCCESS: an error with value =< AllowedErrorMax was
-  *   found.
-  * @param ERROR: an error with value =< AllowedErrorMax was
-  *   not found.                  
+  * @param SUCCESS: the trimming has been started.
+  * @param ERROR: the system clock is not derived from the HSI.
   */
-ErrorStatus HSI_CalibrateFixedError(uint32_t AllowedErrorMax, int32_t* Freq)
+ErrorStatus HSI_TrimStart(uint32_t AllowedErrorMax)
 {
-   NVIC_InitTypeDef  NVIC_InitStructureForHSI; 
-   int32_t Error=0;
-   int8_t HSITRIM=16;
-   int8_t Sign= 1;
-   int8_t i;
-   ErrorStatus CalibrationStatus = ERROR;
- 
-   /* System clock configuration for HSI calibration process */
-   RCC_ConfigurationForHSI();
+   NVIC_InitTypeDef  NVIC_InitStructureForHSI;
+   RCC_ClocksTypeDef RCC_ClocksForHSI;
 
-   /* Enable the TIM3 global Interrupt for HSI calibration process */
-   NVIC_InitStructureForHSI.NVIC_IRQChannel = TIM3_IRQn;
-   NVIC_InitStructureForHSI.NVIC_IRQChannelPreemptionPriority = 0;
-   NVIC_InitStructureForHSI.NVIC_IRQChannelSubPriority = 1;
-   NVIC_InitStructureForHSI.NVIC_IRQChannelCmd = ENABLE;
-   NVIC_Init(&NVIC_InitStructureForHSI);
+   /* TIM3 must count a clock derived from the HSI */
+   if((RCC_GetSYSCLKSource() == 0x04) ||
+      ((RCC_GetSYSCLKSource() == 0x08) && ((RCC->CFGR & RCC_CFGR_PLLSRC) != 0)))
+   {
+     return ERROR;
+   }
+
+   /* Nominal TIM3 clock: PCLK1, doubled when APB1 is divided */
+   RCC_GetClocksFreq(&RCC_ClocksForHSI);
+   HSI_TimerClock = RCC_ClocksForHSI.PCLK1_Frequency;
+   if((RCC->CFGR & RCC_CFGR_PPRE1_2) != 0)
+   {
+     HSI_TimerClock *= 2;
+   }
+
+   /* Peripheral clocks for HSI calibration process */
+   RCC_ConfigurationForHSI();
 
    /* Configure the GPIO ports for HSI calibration process */
    GPIO_ConfigurationForHSI();
 
-#ifdef  USE_Reference_RTC   
-   /* RTC configuration for HSI calibration process */
+#ifdef  USE_Reference_RTC
+   /* RTC configuration for HSI calibration process if the clock souce is RTC */
    RTC_ConfigurationForHSI();
-  
+
    /* output the RTC clock with frequency divided by 64 on the Tamper pin */
    BKP_RTCOutputConfig(BKP_RTCOutputSource_CalibClock);
-#endif   
-  
-   /* Configure the timer for HSI calibration process */
+#endif
+
+   /* Configure the timer TIM3 for HSI calibration process */
    TIM_ConfigurationForHSI();
 
-   /* RC Frequency measurement for different values 0 to 31 of HSITRIM[4:0] bits
-      in RCC_CR register */
-   for(i=0; i<32; i++)
-   {
-     /* Reset "measurement done" */
-     MeasurementDone = 0;
-     
-     /* Compute next HSITRIM value for frequency measurments */
-     /* HSITRIM = 16 then 15, 17, 14, 18, 13, 19 etc until HSITRIM = 31 */
-     HSITRIM = HSITRIM + (i*Sign);
-     Sign *= (-1);
-       
-     /* Set the HSITRIM[4:0] bits to HSITRIM value to be ready for measurements */
-     RCC_AdjustHSICalibrationValue(HSITRIM);
-    
-     /* Start Frequency measurement for current HSITRIM value:
-     Enable TIM3 and its interrupts */
-     TIM_Cmd(TIM3, ENABLE); 
-     TIM_ITConfig(TIM3, TIM_IT_CC1 | TIM_IT_Update, ENABLE);
-    
-     /* Wait for all periods of the current frequency were measured */
-     while (MeasurementDone == 0)
-     {
-     }
-     
-     /* Initialize the counted periods after measurement */
-     PeriodCount=0;
-     
-     /* Disable TIM3 */
-     TIM_Cmd(TIM3, DISABLE); 
-    
-     /* Disable TIM3 interrupts to avoid to enter again in the interrpt routine */
-     TIM_ITConfig(TIM3, TIM_IT_CC1 | TIM_IT_Update, DISABLE);
-     
-     /* Compute current frequency Error */
-     if(((int32_t)Real_RC_Frequency - 8000000) < 0)
-     {
-       Error = 8000000 - Real_RC_Frequency;
-     }
-     else
-     {
-       Error = Real_RC_Frequency - 8000000;
-     }
-     /* If an error less or equal to value settled by the user */
-     if((uint32_t)Error <= AllowedErrorMax )
-     {
-       CalibrationStatus = SUCCESS; /* The calibration has succeed */
-       break; /* stop searching and measurments for frequencies */
-     }
-   }
+   /* Binary search over HSITRIM[4:0], starting from the middle value */
+   HSI_AllowedError = AllowedErrorMax;
+   HSI_TrimStep = 0;
+   HSI_TrimWindows = 0;
+   TrimLow = 0;
+   TrimHigh = HSITRIM_Max;
+   TrimMeasured = 0;
+   HSITRIM = (TrimLow + TrimHigh) / 2;
+   N_OverflowCounter = 0;
+   WindowTicks = 0;
+   PeriodCount = 0;
+   HSI_TrimState = HSI_TRIM_SEARCH;
+   RCC_AdjustHSICalibrationValue(HSITRIM);
+
+   /* Enable the TIM3 global Interrupt */
+   NVIC_InitStructureForHSI.NVIC_IRQChannel = TIM3_IRQn;
+   NVIC_InitStructureForHSI.NVIC_IRQChannelPreemptionPriority = 1;
+   NVIC_InitStructureForHSI.NVIC_IRQChannelSubPriority = 1;
+   NVIC_InitStructureForHSI.NVIC_IRQChannelCmd = ENABLE;
+   NVIC_Init(&NVIC_InitStructureForHSI);
+
+   /* Start the measurements: enable TIM3 and its interrupts */
+   TIM_ITConfig(TIM3, TIM_IT_CC1 | TIM_IT_Update, ENABLE);
+   TIM_Cmd(TIM3, ENABLE);
+
+   return SUCCESS;
+}
+
+
+/**
+  * @brief  Stops the background HSI trimming. The applied HSITRIM value
+  *   is kept.
+  * @param  None
+  * @retval : None
+  */
+void HSI_TrimStop(void)
+{
+   NVIC_InitTypeDef  NVIC_InitStructureForHSI;
 
-   *Freq = Real_RC_Frequency;
-   
-   /* If the frequncy error settled by the user was not found in the chip */
-   if(CalibrationStatus == ERROR)
-   {
-     /* Set the HSITRIM[4:0] bits to HSITRIM default value */      
-     RCC_AdjustHSICalibrationValue(16);
-   }
-   
    /* Disable TIM3 and its interrupts */
+   TIM_Cmd(TIM3, DISABLE);
+   TIM_ITConfig(TIM3, TIM_IT_CC1 | TIM_IT_Update, DISABLE);
+
    NVIC_InitStructureForHSI.NVIC_IRQChannel = TIM3_IRQn;
+   NVIC_InitStructureForHSI.NVIC_IRQChannelPreemptionPriority = 1;
+   NVIC_InitStructureForHSI.NVIC_IRQChannelSubPriority = 1;
    NVIC_InitStructureForHSI.NVIC_IRQChannelCmd = DISABLE;
    NVIC_Init(&NVIC_InitStructureForHSI);
 
-#ifdef  USE_Reference_RTC     
+   HSI_TrimState = HSI_TRIM_IDLE;
+
+#ifdef  USE_Reference_RTC
    /* Restore user configuration of RTC output on the Tamper pin */
-   BKP_RTCOutputConfig(CC0_Bit);
-    
+   if(CC0_Bit == DISABLE)
+   {
+     BKP_RTCOutputConfig(BKP_RTCOutputSource_None);
+   }
+
    /* Restore the user configuration of the access to BKP Domain */
    PWR_BackupAccessCmd(BA_bit);
 #endif
-    
-   /* Restore RCC User configuration */
-   Restore_RCC_UserConfiguration();
-   
-   /* Return the calibration status: failed or succeed */
-   return (CalibrationStatus);
+}
+
 
+/**
+  * @brief  Returns the state of the background HSI trimming.
+  * @param  None
+  * @retval : - An ErrorStatus enumuration value:
+  * @param SUCCESS: the search is done and the error at the applied
+  *   HSITRIM value is within the AllowedErrorMax given to HSI_TrimStart().
+  * @param ERROR: the search is running, the trimming is stopped or the
+  *   error exceeds AllowedErrorMax.
+  */
+ErrorStatus HSI_TrimGetStatus(void)
+{
+  if((HSI_TrimState != HSI_TRIM_TRACK) && (HSI_TrimState != HSI_TRIM_PROBE))
+  {
+    return ERROR;
+  }
+
+  if((HSI_AllowedError != 0) && (HSI_ABS(HSI_TrimError) > HSI_AllowedError))
+  {
+    return ERROR;
+  }
+
+  return SUCCESS;
 }
 
 
 
 /**
-  * @brief  Configures the GPIOs Pins.
+  * @brief  Configures the RTC clock (LSE) used as reference. The LSE start
+  *   is not waited for: the measurement ignores the reference edges until
+  *   the LSE is ready.
   * @param  None
   * @retval : None
   */
 void RTC_ConfigurationForHSI(void)
 {
-    /* Check if the backup domain write protection was enabled by
+    /* Check if the access to the backup domain was enabled by
        the user application */
-    if(PWR->CR&0x100)
-    {
-      BA_bit = ENABLE; /* The backup domain write protection was enabled by
-                          the user application*/
-    }
+    BA_bit = ((PWR->CR & 0x100) != 0) ? ENABLE : DISABLE;
+
     /* Check if the RTC clock / 64 on Tamper pin was used by the user application */
-    if(BKP->RTCCR&0x0080)
-    {
-      CC0_Bit = ENABLE; /* The RTC clock was used by the user application */
-    }
-    
+    CC0_Bit = ((BKP->RTCCR & 0x0080) != 0) ? ENABLE : DISABLE;
+
     /* Allow access to BKP Domain */
     PWR_BackupAccessCmd(ENABLE);
 
     /* Enable LSE */
     RCC_LSEConfig(RCC_LSE_ON);
-  
-    /* Wait till LSE is ready */
-    while(RCC_GetFlagStatus(RCC_FLAG_LSERDY) == RESET)
-    {
-    }
 
     /* Select LSE as RTC Clock Source */
     RCC_RTCCLKConfig(RCC_RTCCLKSource_LSE);
@@ -438,6 +521,10 @@ void TIM_ConfigurationForHSI(void)
    
     /* Enable the Master/Slave Mode */
     TIM_SelectMasterSlaveMode(TIM3, TIM_MasterSlaveMode_Enable);
+
+    /* Only the counter overflows raise the update interrupt, not the
+       counter reset done by the reference edges */
+    TIM_UpdateRequestConfig(TIM3, TIM_UpdateSource_Regular);
     
     /* Disable TIM3 and its interrupts to avoid unwanted frequency measurements */
     TIM_Cmd(TIM3, DISABLE); 
@@ -451,44 +538,20 @@ void TIM_ConfigurationForHSI(void)
 
 
 /**
-  * @brief  Configures the different system clocks.
+  * @brief  Enables the peripheral clocks used by the HSI calibration. The
+  *   system clock configuration of the application is left untouched.
   * @param  None
-  * @retval : the Peripheral used by the user before the calibration
+  * @retval : None
   */
 void RCC_ConfigurationForHSI(void)
 { 
-    /* Enable Prefetch Buffer */
-    FLASH_PrefetchBufferCmd(FLASH_PrefetchBuffer_Enable);
-
-    /* HCLK = SYSCLK = 8MHz */
-    RCC_HCLKConfig(RCC_SYSCLK_Div1); 
-      
-    /* PCLK2 = HCLK = 8MHz */
-    RCC_PCLK2Config(RCC_HCLK_Div1); 
-
-    /* PCLK1 = HCLK = 8MHz */
-    RCC_PCLK1Config(RCC_HCLK_Div1);
-    
-    /* Flash 0 wait state */
-    FLASH_SetLatency(FLASH_Latency_0);
-
-    /* Select HSI as system clock source */
-    RCC_SYSCLKConfig(RCC_SYSCLKSource_HSI);
-    
-    /* Get the used user clocks on APB1 before calibration */
-    APB1_UserPeriph = RCC->APB1ENR;
-    /* Get the used user clocks on APB2 before calibration */
-    APB2_UserPeriph = RCC->APB2ENR;    
-
     /* Enable (add to user clocks) TIM3, Buckup and PWR clocks */
-    RCC_APB1PeriphClockCmd( APB1_UserPeriph | RCC_APB1Periph_TIM3 |
-                            RCC_APB1Periph_BKP  |
-                            RCC_APB1Periph_PWR , ENABLE);
+    RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM3 | RCC_APB1Periph_BKP |
+                           RCC_APB1Periph_PWR, ENABLE);
 
     /* Enable (add to user clocks)  GPIOA, GPIOC and AFIO clocks */
-    RCC_APB2PeriphClockCmd( APB2_UserPeriph | RCC_APB2Periph_GPIOA |
-                            RCC_APB2Periph_GPIOC |
-                            RCC_APB2Periph_AFIO, ENABLE);
+    RCC_APB2PeriphClockCmd(RCC_APB2Periph_GPIOA | RCC_APB2Periph_GPIOC |
+                           RCC_APB2Periph_AFIO, ENABLE);
 }
 
 
@@ -31,10 +31,17 @@
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
-  /* Uncomment this line to activate demo 1: calibration with fixed Error */
-  /* Comment this line to activate demo 2: calibration with minimum Error found */
+  /* Uncomment this line to activate demo 1: tracking with fixed Error */
+  /* Comment this line to activate demo 2: tracking with minimum Error found */
 //#define USE_HSI_Fixed_Error 
 
+#ifdef USE_HSI_Fixed_Error
+/* Fix the maximum value of the error frequency at +/- 14000Hz -> 0.17% */
+ #define HSI_AllowedErrorMax  14000
+#else
+ #define HSI_AllowedErrorMax  0
+#endif
+
 /* Incomment this line to output HSI on pin MCO (PA8) */
 #define OUTPUT_RC_ON_MCO_FOR_DEBUG
  
@@ -46,7 +53,6 @@
 
 /* Private macro -------------------------------------------------------------*/
 /* Private variables ---------------------------------------------------------*/ 
-int32_t Current_RC_Frequency = 0;
 ErrorStatus CalibStatus = ERROR;
 /* Private function prototypes -----------------------------------------------*/
 void RCC_Configuration(void);
@@ -72,38 +78,33 @@ int main(void)
    /* Initialize GPIOC.0 to GPIOC.6 for LEDs */
    GPIO_ResetBits(GPIOC, HSITRIM_5LEDs| LED_Green | LED_Red );
    
-#ifdef USE_HSI_Fixed_Error   
-   /* Calibrate internal RC with the maximum error allowed in Hz */
-   /* Fix the maximum value of the error frequency at +/- 14000Hz -> 0.17% */
-   CalibStatus = HSI_CalibrateFixedError(14000, &Current_RC_Frequency);
-
-#else   
-   /* Calibrate internal RC and return its frequency in Hz after calibration */
-   Current_RC_Frequency = HSI_CalibrateMinError();
-
-#endif  
-   
-   /* Get the HSITRIM value from the RCC_CR register (5 bits) after calibration */
-   DisplayHSITRIMbits();
-   
-#ifdef USE_HSI_Fixed_Error /* If the user selected the demo 1: calibration with */
-   if(CalibStatus == SUCCESS) /* fixed Error */
-   {
-      /* The LED Green glows when the Calibration was done */
-      GPIO_SetBits(GPIOC, LED_Green);
-   }
-   else
+   /* Start the background calibration of the internal RC: the HSI is
+      measured and trimmed from the TIM3 interrupt */
+   if(HSI_TrimStart(HSI_AllowedErrorMax) == ERROR)
    {
-     /* The LED Red glows when the Calibration was not done */
+     /* The LED Red glows when the system clock is not derived from HSI */
      GPIO_SetBits(GPIOC, LED_Red);
    }
-#else  /* The user selected the demo 2: calibration with the minimum Error value found */
-    /* The LED Green glows */
-    GPIO_SetBits(GPIOC, LED_Green);
-#endif     
-   
+
    while(1)
    {
+     /* Get the HSITRIM value from the RCC_CR register (5 bits) */
+     DisplayHSITRIMbits();
+
+     /* The LED Green glows while the HSI error is within the allowed
+        error (demo 1) or once the minimum error was found (demo 2),
+        the LED Red glows otherwise */
+     CalibStatus = HSI_TrimGetStatus();
+     if(CalibStatus == SUCCESS)
+     {
+       GPIO_ResetBits(GPIOC, LED_Red);
+       GPIO_SetBits(GPIOC, LED_Green);
+     }
+     else
+     {
+       GPIO_ResetBits(GPIOC, LED_Green);
+       GPIO_SetBits(GPIOC, LED_Red);
+     }
    }
 }
 
@@ -31,21 +31,10 @@
  extern "C" {
 #endif
 
-#if !defined (IR_RC5_PROTOCOL) && !defined (IR_SIRC_PROTOCOL)
-//#define IR_RC5_PROTOCOL
-//#define IR_SIRC_PROTOCOL
-#endif 
-   
 /* Includes ------------------------------------------------------------------*/
 #include "stm32f10x.h"
 #include "stm32100e_eval_lcd.h"
 #include <stdio.h>
-
-#if defined IR_RC5_PROTOCOL
-  #include "rc5_decode.h"
-#elif defined  IR_SIRC_PROTOCOL
-  #include "sirc_decode.h"
-#endif
    
 /** @addtogroup STM32F10x_Infrared_Decoders
   * @{
@@ -62,10 +51,68 @@
 /** @defgroup IR_DECODE_Exported_Types
   * @{
   */
+typedef enum { NO = 0, YES = !NO} StatusYesOrNo;
+
+/** 
+  * @brief  IR protocol descriptor. All timings are in us.
+  */
+typedef struct
+{
+  const char *Name;       /*!< Protocol name */
+  uint8_t  Encoding;      /*!< IR_ENC_MARK_SPACE or IR_ENC_MANCHESTER */
+  uint8_t  Flags;         /*!< IR_MSB_FIRST, IR_STOP_BIT, IR_MARK_FIRST_ONE */
+  uint8_t  Bits;          /*!< Data bits per frame */
+  uint8_t  Tolerance;     /*!< Timing tolerance in percent */
+  uint16_t HeaderMark;    /*!< Header mark, 0 = no header */
+  uint16_t HeaderSpace;   /*!< Header space */
+  uint16_t RepeatSpace;   /*!< Header space of a repeat code, 0 = none */
+  uint16_t ZeroMark;      /*!< Mark/space coding: bit timings */
+  uint16_t ZeroSpace;
+  uint16_t OneMark;
+  uint16_t OneSpace;
+  uint16_t Unit;          /*!< Manchester coding: half bit length */
+  uint8_t  WideBit;       /*!< Manchester coding: bit sent at double width */
+  uint8_t  ToggleBit;     /*!< Toggle bit position or IR_NO_BIT */
+  uint8_t  AddressShift;  /*!< Address field position and width */
+  uint8_t  AddressBits;
+  uint8_t  CommandShift;  /*!< Command field position and width */
+  uint8_t  CommandBits;
+  uint16_t RepeatMs;      /*!< Longest silence between frames of a held key */
+} IR_Protocol_TypeDef;
+
+/** 
+  * @brief  Match state of one protocol for the frame being received
+  */
+typedef struct
+{
+  uint8_t  State;         /*!< IR_MATCH_xxx */
+  uint8_t  BitCount;      /*!< Bits received */
+  uint8_t  Half;          /*!< Manchester: first half of a bit seen */
+  uint8_t  First;         /*!< Manchester: level of that first half */
+  uint32_t Data;          /*!< Bits received */
+} IR_Match_TypeDef;
+
+/** 
+  * @brief  IR frame structure
+  */
+typedef struct
+{
+  __IO uint8_t  Protocol;   /*!< Index into IR_Protocols */
+  __IO uint8_t  ToggleBit;  /*!< Toggle bit, 0 if the protocol has none */
+  __IO uint16_t Address;    /*!< Address field */
+  __IO uint16_t Command;    /*!< Command field */
+  __IO uint16_t Repeat;     /*!< 0 for a new key press, counts up while held */
+  __IO uint32_t Data;       /*!< Raw frame bits */
+} IR_Frame_TypeDef;
+
+/**
+  * @}
+  */
 
 /** @defgroup IR_DECODE_Exported_Constants
   * @{
   */
+#define USE_LCD
    
 #define IR_TIM                 TIM3                     /*!< Timer used for IR decoding */
 #define TIM_PRESCALER          23                       /* !< TIM prescaler */
@@ -76,13 +123,51 @@
 #define IR_GPIO_PORT           GPIOC                    /*!< Port which IR output is connected */
 #define IR_GPIO_PORT_CLK       RCC_APB2Periph_GPIOC     /*!< IR pin GPIO Clock Port */
 #define IR_GPIO_PIN            GPIO_Pin_6               /*!< Pin which IR is connected */
+
+#define IR_RING_SIZE           64       /*!< Pulses buffered between TIM3_IRQHandler and IR_Decode(), power of 2 */
+#define IR_GAP_US              10000    /*!< Minimum line idle time ending a frame */
+#define IR_SLACK_US            100      /*!< Added to every tolerance: receivers stretch marks */
+
+/* Protocols in IR_Protocols */
+#define IR_NEC                 0
+#define IR_RC5                 1
+#define IR_RC6                 2
+#define IR_SIRC                3
+#define IR_SAMSUNG             4
+#define IR_PROTOCOL_COUNT      5
+
+/* IR_Protocol_TypeDef Encoding */
+#define IR_ENC_MARK_SPACE      0        /*!< Each bit is a mark + space (pulse distance or width) */
+#define IR_ENC_MANCHESTER      1        /*!< Bi-phase, half bits of Unit us */
+
+/* IR_Protocol_TypeDef Flags */
+#define IR_MSB_FIRST           0x01
+#define IR_STOP_BIT            0x02     /*!< Trailing mark after the last bit */
+#define IR_MARK_FIRST_ONE      0x04     /*!< Manchester: mark then space is a 1 (RC6) */
+
+#define IR_NO_BIT              0xFF
+
+/* IR_Match_TypeDef State */
+#define IR_MATCH_HEADER        0
+#define IR_MATCH_BITS          1
+#define IR_MATCH_STOP          2
+#define IR_MATCH_REPEAT        3
+#define IR_MATCH_DONE          4
+#define IR_MATCH_REPEAT_DONE   5
+#define IR_MATCH_FAIL          6
+
+/* Line levels */
+#define IR_SPACE               0
+#define IR_MARK                1
 /**
   * @}
   */
 
-/** @defgroup IR_DECODE_Exported_Macros
+/** @defgroup IR_DECODE_Exported_Variables
   * @{
   */
+extern const IR_Protocol_TypeDef IR_Protocols[IR_PROTOCOL_COUNT];
+extern __IO uint32_t IROverruns;
 /**
   * @}
   */
@@ -92,9 +177,14 @@
   */
 void IR_DeInit(void);
 void IR_Init(void);
-void IR_Decode(IR_Frame_TypeDef *ir_frame);
+StatusYesOrNo IR_Decode(IR_Frame_TypeDef *ir_frame);
+StatusYesOrNo IR_KeyHeld(void);
 void IR_ResetPacket(void);
 
+/* Used by the protocol decoders */
+uint8_t IR_Near(uint32_t measured, uint32_t expected, uint8_t tolerance);
+void IR_AddBit(const IR_Protocol_TypeDef *p, IR_Match_TypeDef *m, uint8_t bit);
+
 #ifdef __cplusplus
 }
 #endif
@@ -65,7 +65,6 @@
 /** @defgroup IR_COMMANDS_Private_Variables
   * @{
   */
-#ifdef IR_SIRC_PROTOCOL
 /* Table of SIRC address */
 uint8_t* IR_devices[32] = {
          "        SAT         ",  /* 0 */
@@ -233,7 +232,7 @@ uint8_t* IR_Commands[128] = {
         "      Reserved      ",   /* 126 */
         "Display a red Rtests"    /* 127 */
    };
-#elif defined (IR_RC5_PROTOCOL)
+
 /* RC5 address table */
 uint8_t* rc5_devices[32] = {
         "         TV1        ",                  /*  0 */
@@ -401,8 +400,6 @@ uint8_t* rc5_Commands[128] = {
         "  TV Movie Expand   ",                                       /* 126 */
         "  TV Parental Access"                                        /* 127 */
    };
-
-#endif
 /**
   * @}
   */
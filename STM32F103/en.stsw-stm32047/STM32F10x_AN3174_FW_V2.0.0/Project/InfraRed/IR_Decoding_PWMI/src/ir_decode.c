@@ -8,17 +8,31 @@
   *    
   * 1. How to use this driver
   * -------------------------         
-  *      - TIM3 Capture Compare and Update interrupts are used to decode the IR
-  *        frame, if a frame is received correctly a global variable IRFrameReceived 
-  *        will be set to inform the application.
+  *      - Call IR_Init() to configure TIM3 in PWM input mode on the IR 
+  *        receiver pin. The channel 1 capture gives the time between two 
+  *        falling edges (whole pulse) and the channel 2 capture the low 
+  *        pulse (mark) length.
   *          
-  *      - Then the application should call the function IR_Decode() to retrieve 
-  *        the received IR frame. 
+  *      - TIM3_IRQHandler only pushes the captured (low, whole) pairs into a
+  *        ring buffer. All the decoding is done by IR_Decode(), which the 
+  *        application calls from its main loop: it returns YES and fills the
+  *        IR_Frame_TypeDef when a frame has been received.
   *        
-  *      - You can easily tailor this driver to any other InfraRed protocol, 
-  *        by just adapting the defines from sirc_decode.h to the InfraRed 
-  *        protocol specification(Bit Duration, Header Duration, Marge Tolerance, 
-  *        Number of bits...) and the command and device tables from ir_commands.c.         
+  *      - Every pulse pair is offered to all the entries of IR_Protocols at
+  *        once (NEC, RC5, RC6 mode 0, SIRC 12 bits, Samsung). A protocol drops
+  *        out at the first pulse that does not fit, so no protocol has to be
+  *        selected in advance. A frame ends when the line stays idle for the
+  *        longest mark + space of the table (timer overflow).
+  *        
+  *      - Frames of the same key repeated within IR_Protocol_TypeDef.RepeatMs
+  *        are reported with IR_Frame_TypeDef.Repeat counting up. NEC repeat
+  *        codes are expanded to the last key, and an RC5/RC6 toggle bit 
+  *        change is a new key press. IR_KeyHeld() tells whether the last key
+  *        is still being repeated.
+  *        
+  *      - You can add another protocol by adding an entry to IR_Protocols and
+  *        the IR_xxx index in ir_decode.h. Mark/space coded protocols are 
+  *        decoded in this file, Manchester coded ones in rc5_decode.c.
   *                   
   * 2. Important to know
   * --------------------  
@@ -28,6 +42,12 @@
   *           - either add your application code in these ISRs
   *           - or copy the contents of these ISRs in you application code
   *                              
+  *      - If IR_Decode() is not called often enough the ring buffer overflows;
+  *        the lost pulses are counted in IROverruns.
+  *      
+  *      - Define IR_PROFILE to record the longest TIM3_IRQHandler execution, 
+  *        in CPU cycles, in IRIsrMaxCycles.
+  *                              
   ******************************************************************************
   * @attention
   *
@@ -47,6 +67,7 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "ir_decode.h"
+#include "rc5_decode.h"
 #include "stm32100e_eval_lcd.h"
 #include "ir_commands.c"
 
@@ -74,6 +95,15 @@
 /** @defgroup IR_DECODE_Private_Defines
   * @{
   */
+#define IR_IC_FILTER           0x3      /*!< 8 samples at fCK_INT: drops glitches */
+#define IR_FRAME_START         0xFFFF   /*!< Ring entry "whole" value marking a frame start */
+#define IR_MAX_TICKS           0xFFFE   /*!< Auto-reload limit, keeps IR_FRAME_START free */
+
+#ifdef IR_PROFILE
+#define IR_DEMCR               (*(__IO uint32_t *)0xE000EDFC)
+#define IR_DWT_CTRL            (*(__IO uint32_t *)0xE0001000)
+#define IR_DWT_CYCCNT          (*(__IO uint32_t *)0xE0001004)
+#endif
 /**
   * @}  
   */
@@ -89,23 +119,54 @@
 /** @defgroup IR_DECODE_Private_Variables
   * @{
   */
-__IO StatusYesOrNo IRFrameReceived = NO;   /*!< IR frame status */
-  
-/* IR bit definitions*/
-uint16_t IROnTimeMin = 0; 
-uint16_t IROnTimeMax = 0; 
-uint16_t IRValueStep = 0;
-uint16_t IRValueMargin = 0;
-uint16_t IRValue00 = 0;
-
-/* Header time definitions*/
-uint16_t IRHeaderLowMin = 0;
-uint16_t IRHeaderLowMax = 0;
-uint16_t IRHeaderWholeMin = 0;
-uint16_t IRHeaderWholeMax = 0;
-tIR_packet IRTmpPacket; /*!< IR packet*/
-
-uint16_t IRTimeOut = 0;
+
+/* Timings in us, see IR_Protocol_TypeDef for the field order */
+const IR_Protocol_TypeDef IR_Protocols[IR_PROTOCOL_COUNT] =
+{
+  /* NEC: pulse distance, 32 bits LSB first (address, ~address, command, ~command) */
+  { "NEC", IR_ENC_MARK_SPACE, IR_STOP_BIT, 32, 25,
+    9000, 4500, 2250, 560, 560, 560, 1690,
+    0, IR_NO_BIT, IR_NO_BIT, 0, 16, 16, 8, 150 },
+  /* Philips RC5: 14 bits MSB first (S1 S2 T A4..A0 C5..C0) */
+  { "RC5", IR_ENC_MANCHESTER, IR_MSB_FIRST, 14, 25,
+    0, 0, 0, 0, 0, 0, 0,
+    889, IR_NO_BIT, 11, 6, 5, 0, 6, 150 },
+  /* Philips RC6 mode 0: start bit, 3 mode bits, double width trailer 
+     (toggle), 8 address and 8 command bits */
+  { "RC6", IR_ENC_MANCHESTER, IR_MSB_FIRST | IR_MARK_FIRST_ONE, 21, 25,
+    2666, 889, 0, 0, 0, 0, 0,
+    444, 4, 16, 8, 8, 0, 8, 150 },
+  /* Sony SIRC 12 bits: pulse width, 7 command then 5 address bits LSB first */
+  { "SIRC", IR_ENC_MARK_SPACE, 0, 12, 25,
+    2400, 600, 0, 600, 600, 1200, 600,
+    0, IR_NO_BIT, IR_NO_BIT, 7, 5, 0, 7, 100 },
+  /* Samsung: NEC timing with a 4.5 ms header mark and no repeat code */
+  { "Samsung", IR_ENC_MARK_SPACE, IR_STOP_BIT, 32, 25,
+    4500, 4500, 0, 560, 560, 560, 1690,
+    0, IR_NO_BIT, IR_NO_BIT, 0, 16, 16, 8, 150 },
+};
+
+/* Captured pulses: (whole << 16) | low, in timer ticks */
+static __IO uint32_t IRPulseRing[IR_RING_SIZE];
+static __IO uint16_t IRPulseHead = 0;
+static __IO uint16_t IRPulseTail = 0;
+static __IO uint8_t  IRLineIdle = 1;          /*!< No falling edge since the last overflow */
+static __IO uint16_t IRIdleOverflows = 0;     /*!< Timer overflows since the last frame */
+__IO uint32_t IROverruns = 0;                 /*!< Pulse pairs lost, ring full */
+#ifdef IR_PROFILE
+__IO uint32_t IRIsrMaxCycles = 0;             /*!< Longest TIM3_IRQHandler, in CPU cycles */
+#endif
+
+/* Decoder state, only used outside the ISR */
+static IR_Match_TypeDef IRMatch[IR_PROTOCOL_COUNT];
+static uint8_t  IRInFrame = 0;
+static uint32_t IRGapUs = 0;                  /*!< Line idle time ending a frame */
+static uint32_t IRSilenceUs = 0;              /*!< Silence before the frame being received */
+
+/* Repeat tracker */
+static StatusYesOrNo IRHaveLast = NO;
+static IR_Frame_TypeDef IRLastFrame;
+
 __IO uint32_t TIMCLKValueKHz = 0;/*!< Timer clock */
 
 /**
@@ -116,10 +177,15 @@ __IO uint32_t TIMCLKValueKHz = 0;/*!< Timer clock */
   * @{
   */
  
-static void IR_DataSampling(uint32_t lowPulseLength, uint32_t wholePulseLength);
-static uint8_t IR_DecodeHeader(uint32_t lowPulseLength, uint32_t wholePulseLength);
-static uint8_t IR_DecodeBit(uint32_t lowPulseLength, uint32_t wholePulseLength);
+static void IR_PushPulse(uint32_t pulse);
+static StatusYesOrNo IR_DataSampling(uint32_t lowPulseLength, uint32_t wholePulseLength, IR_Frame_TypeDef *ir_frame);
+static uint8_t IR_MarkSpaceMatch(const IR_Protocol_TypeDef *p, IR_Match_TypeDef *m, uint32_t lowPulseLength, uint32_t spaceLength, uint8_t end);
+static StatusYesOrNo IR_Report(uint8_t protocol, uint8_t repeatCode, IR_Frame_TypeDef *ir_frame);
+static uint32_t IR_LongestPair(const IR_Protocol_TypeDef *p);
 static uint32_t TIM_GetCounterCLKValue(void);
+#ifdef USE_LCD
+static void IR_Display(IR_Frame_TypeDef *ir_frame);
+#endif
  
 /**
   * @}
@@ -141,7 +207,7 @@ void IR_DeInit(void)
 }
 
 /**
-  * @brief  Initialize the IR bit time range.
+  * @brief  Initialize the timer, the pin and the decoder.
   * @param  None
   * @retval None
   */
@@ -150,6 +216,8 @@ void IR_Init(void)
   GPIO_InitTypeDef GPIO_InitStructure;
   NVIC_InitTypeDef NVIC_InitStructure;
   TIM_ICInitTypeDef TIM_ICInitStructure;
+  uint32_t gapTicks = 0;
+  uint8_t i = 0;
   
   /*  Clock Configuration for TIMER */
   RCC_APB1PeriphClockCmd(IR_TIM_CLK , ENABLE);
@@ -182,7 +250,7 @@ void IR_Init(void)
   TIM_ICInitStructure.TIM_ICPolarity = TIM_ICPolarity_Falling;
   TIM_ICInitStructure.TIM_ICSelection = TIM_ICSelection_DirectTI;
   TIM_ICInitStructure.TIM_ICPrescaler = TIM_ICPSC_DIV1;
-  TIM_ICInitStructure.TIM_ICFilter = 0x0;
+  TIM_ICInitStructure.TIM_ICFilter = IR_IC_FILTER;
   TIM_PWMIConfig(IR_TIM, &TIM_ICInitStructure); 
 
   /* Timer Clock */
@@ -200,10 +268,23 @@ void IR_Init(void)
   /* Configures the TIM Update Request Interrupt source: counter overflow */
   TIM_UpdateRequestConfig(IR_TIM,  TIM_UpdateSource_Regular);
    
-  IRTimeOut = TIMCLKValueKHz * IR_TIME_OUT_US/1000;
-
-  /* Set the TIM auto-reload register for each IR protocol */
-  IR_TIM->ARR = IRTimeOut;
+  /* The counter only restarts on a falling edge, so the overflow that ends
+     a frame must come later than the longest mark + space of any protocol */
+  IRGapUs = IR_GAP_US;
+  for (i = 0; i < IR_PROTOCOL_COUNT; i++)
+  {
+    if (IR_LongestPair(&IR_Protocols[i]) > IRGapUs)
+    {
+      IRGapUs = IR_LongestPair(&IR_Protocols[i]);
+    }
+  }
+  gapTicks = TIMCLKValueKHz * IRGapUs / 1000;
+  if (gapTicks > IR_MAX_TICKS)
+  {
+    gapTicks = IR_MAX_TICKS;
+    IRGapUs = IR_MAX_TICKS * 1000 / TIMCLKValueKHz;
+  }
+  IR_TIM->ARR = gapTicks;
   
   /* Clear update flag */
   TIM_ClearFlag(IR_TIM, TIM_FLAG_Update);
@@ -211,10 +292,19 @@ void IR_Init(void)
   /* Enable TIM3 Update Event Interrupt Request */
   TIM_ITConfig(IR_TIM, TIM_IT_Update, ENABLE);
 
-  /* Enable the CC2/CC1 Interrupt Request */
-  TIM_ITConfig(IR_TIM, TIM_IT_CC2, ENABLE);
+  /* Enable the CC1 Interrupt Request: the CC2 capture (low pulse) is read
+     on the next falling edge, it needs no interrupt of its own */
   TIM_ITConfig(IR_TIM, TIM_IT_CC1, ENABLE);
 
+#ifdef IR_PROFILE
+  /* Enable the DWT cycle counter */
+  IR_DEMCR |= 0x01000000;
+  IR_DWT_CTRL |= 0x00000001;
+#endif
+
+  /* Default state */
+  IR_ResetPacket();
+
   /* Enable the timer */
   TIM_Cmd(IR_TIM, ENABLE);
   
@@ -225,230 +315,492 @@ void IR_Init(void)
   /* Set the LCD Text Color */
   LCD_SetTextColor(LCD_COLOR_GREEN);
   LCD_DisplayStringLine(LCD_LINE_0, "   STM32100E-EVAL   ");
-  LCD_DisplayStringLine(LCD_LINE_1, IR_MESSAGE);
+  LCD_DisplayStringLine(LCD_LINE_1, "  IR Remote Decoder ");
   
   LCD_SetBackColor(LCD_COLOR_BLUE);
   /* Set the LCD Text Color */
   LCD_SetTextColor(LCD_COLOR_WHITE);
 #endif
-  /* Header */	
-  IRHeaderLowMin = TIMCLKValueKHz * IR_HEADER_LOW_MIN_US/1000;
-  IRHeaderLowMax = TIMCLKValueKHz * IR_HEADER_LOW_MAX_US/1000;
-  IRHeaderWholeMin = TIMCLKValueKHz * IR_HEADER_WHOLE_MIN_US/1000;
-  IRHeaderWholeMax = TIMCLKValueKHz * IR_HEADER_WHOLE_MAX_US/1000;
-
-  /* Bit time range*/
-  IROnTimeMax = TIMCLKValueKHz * IR_ONTIME_MAX_US /1000;
-  IROnTimeMin = TIMCLKValueKHz * IR_ONTIME_MIN_US/1000; 
-  IRValueStep = TIMCLKValueKHz * IR_VALUE_STEP_US/1000;
-  IRValueMargin = TIMCLKValueKHz * IR_VALUE_MARGIN_US/1000;
-  IRValue00 = TIMCLKValueKHz * IR_VALUE_00_US/1000;
-
-  /* Default state */
-  IR_ResetPacket();
 }
 
 /**
-  * @brief  Decode the IR frame (ADDRESS, COMMAND) when all the frame is 
-  *         received, the IRFrameReceived will equal to YES.
-  *         The IRFrameReceived is set to YES inside the  IR_DataSampling() 
-  *         function when the whole IR frame is received without any error.
-  *         If any received bit timing is out of the defined range, the IR packet
-  *         is reset and the IRFrameReceived is set to NO.
-  *         After the IR received display, the IRFrameReceived is set NO.
-  *         User can check the IRFrameReceived variable status to verify if there
-  *         is a new IR frame already received.          
-  * @param  ir_frame: pointer to IR_Frame_TypeDef structure that contains the 
-  *         the IR protocol fields (Address, Command,...).
-  * @retval None
+  * @brief  Decode the pulses received since the last call, up to the end of
+  *         the next complete IR frame.
+  *         Call it from the main loop: the pulses wait in a ring buffer of
+  *         IR_RING_SIZE entries, a NEC frame takes 34 of them.
+  * @param  ir_frame: pointer to IR_Frame_TypeDef structure that receives the
+  *         the IR protocol fields (Protocol, Address, Command,...).
+  * @retval YES if a frame was decoded into ir_frame, else NO.
   */
-void IR_Decode(IR_Frame_TypeDef *ir_frame)
+StatusYesOrNo IR_Decode(IR_Frame_TypeDef *ir_frame)
 {  
-  if(IRFrameReceived != NO) 
+  uint32_t pulse = 0;
+  uint32_t low = 0, whole = 0;
+
+  while (IRPulseTail != IRPulseHead)
   {
-    IRTmpPacket.data = __RBIT(IRTmpPacket.data);
+    pulse = IRPulseRing[IRPulseTail];
+    IRPulseTail = (IRPulseTail + 1) & (IR_RING_SIZE - 1);
 
-#ifdef IR_SIRC_PROTOCOL   
-    ir_frame->Command = (IRTmpPacket.data >> 20)& 0x7F;
-    ir_frame->Address = (IRTmpPacket.data >> 27) & 0x1F;
-#endif
-    
-    /* Default state */
-    IRFrameReceived = NO; 
-    IR_ResetPacket();
-    
+    whole = pulse >> 16;
+    low = pulse & 0xFFFF;
+    if (whole == IR_FRAME_START)
+    {
+      /* low holds the overflows counted while the line was idle. A frame
+         whose end was lost in a ring overrun is dropped here. */
+      IRSilenceUs = (low + 1) * IRGapUs;
+      IRInFrame = 0;
+      continue;
+    }
+
+    /* Timer ticks to us */
+    low = low * 1000 / TIMCLKValueKHz;
+    whole = whole * 1000 / TIMCLKValueKHz;
+
+    if (IR_DataSampling(low, whole, ir_frame) != NO)
+    {
 #ifdef USE_LCD 
-    /* Display command and address */
-    LCD_DisplayStringLine(LCD_LINE_5, IR_Commands[ir_frame->Command]);
-    LCD_DisplayStringLine(LCD_LINE_6, IR_devices[ir_frame->Address]);
+      IR_Display(ir_frame);
 #endif
+      return YES;
+    }
+  }
+  return NO;
+}
+
+/**
+  * @brief  Tell whether the last decoded key is still being repeated.
+  * @param  None
+  * @retval YES while the remote keeps sending the key, else NO.
+  */
+StatusYesOrNo IR_KeyHeld(void)
+{
+  if (IRHaveLast == NO)
+  {
+    return NO;
+  }
+  if (!IRLineIdle)
+  {
+    return YES;
+  }
+  if ((uint32_t)(IRIdleOverflows + 1) * IRGapUs < IR_Protocols[IRLastFrame.Protocol].RepeatMs * 1000)
+  {
+    return YES;
   }
+  return NO;
 }
 
 /**
-  * @brief  Put the packet to default state, ready to be filled in by incoming 
-  *         data.
+  * @brief  Put the decoder to default state: drop the buffered pulses, the
+  *         frame being received and the last key.
   * @param  None
   * @retval None
   */
 void IR_ResetPacket(void)
 {
-  IRTmpPacket.count = 0;
-  IRTmpPacket.status = INITIAL_STATUS;
-  IRTmpPacket.data = 0;
+  IRPulseTail = IRPulseHead;
+  IRInFrame = 0;
+  IRHaveLast = NO;
 }
 
 /**
   * @brief  This function handles TIM interrupt Handler.
-  *         SIRC Infrared decoder Implementation
-  *         ===================================  
-  *         Capture Compare Interrupt:Timer Falling Edge Event:
-  *         ---------------------------------------------------
-  *         The Timer interrupt is used to measure the different period between 
-  *         two successive falling edges in order to identify the frame bits.
+  *         Capture Compare 1 Interrupt: Timer Falling Edge Event:
+  *         ------------------------------------------------------
+  *         The counter is reset on every falling edge (start of a mark), CCR1
+  *         holds the period since the previous falling edge (whole pulse) 
+  *         and CCR2 the rising edge in between (low pulse). The pair is 
+  *         pushed into the ring buffer. The first falling edge after an idle
+  *         line pushes a frame start entry with the idle time instead.
   *
-  *         We measure the low pulse duration:
-  *           - If the period measured is equal to T = 1200 s and the low pulse 
-  *             duration is equal to T/2 = 600s => the bit is logic '0'. 
-  *           - If the period measured is equal to 3T/2 = 1800s and the low pulse 
-  *             duration is equal to T = 1200s => the bit is logic '1'.
-  *           - If the whole period measured is equal to 3000s and the low pulse 
-  *             duration is equal to 2400s => the bit is start bit.
-  *
-  *         Update event:InfraRed decoders time out event
-  *         ----------------------------------------------
-  *         It resets the InfraRed decoders packet.                 
-  *         - The Timer Overflow is set to 4 ms. 
+  *         Update event: line idle
+  *         -----------------------
+  *         No falling edge for the longest mark + space of the protocol 
+  *         table: the frame is over. The last mark (CCR2, if a rising edge 
+  *         was captured) is pushed with a whole pulse of 0. Further 
+  *         overflows count the idle time for the repeat tracker.
   * @param  None
   * @retval None
   */
 void TIM3_IRQHandler (void)
 {
-  static uint32_t ICValue1;
-  static uint32_t ICValue2;
+#ifdef IR_PROFILE
+  uint32_t cycles = IR_DWT_CYCCNT;
+#endif
+  uint32_t ICValue1;
+  uint32_t ICValue2;
   
   /* IC1 Interrupt */
   if((TIM_GetFlagStatus(IR_TIM, TIM_FLAG_CC1) != RESET))
   {
-    TIM_ClearFlag(IR_TIM, TIM_FLAG_CC1);
-    /* Get the Input Capture value */
+    /* Reading CCR1 and CCR2 clears the CC1 and CC2 flags */
     ICValue2 = TIM_GetCapture1(IR_TIM);
-    IR_DataSampling(ICValue1, ICValue2); 
-  }  /* IC2 Interrupt*/   
-  else  if((TIM_GetFlagStatus(IR_TIM, TIM_FLAG_CC2) != RESET))
-  {
-    TIM_ClearFlag(IR_TIM, TIM_FLAG_CC2);
-    /* Get the Input Capture value */
     ICValue1 = TIM_GetCapture2(IR_TIM);
-  } 
+    if (IRLineIdle)
+    {
+      /* First edge of a frame, the counter was free running */
+      IRLineIdle = 0;
+      IR_PushPulse(((uint32_t)IR_FRAME_START << 16) | IRIdleOverflows);
+    }
+    else
+    {
+      IR_PushPulse((ICValue2 << 16) | ICValue1);
+    }
+  }
   /* Checks whether the IR_TIM flag is set or not. */
   else if ((TIM_GetFlagStatus(IR_TIM, TIM_FLAG_Update) != RESET))
   { 
     /* Clears the IR_TIM's pending flags*/
     TIM_ClearFlag(IR_TIM, TIM_FLAG_Update);
     
-    IR_ResetPacket();
+    if (!IRLineIdle)
+    {
+      IRLineIdle = 1;
+      IRIdleOverflows = 0;
+      ICValue1 = 0;
+      if (TIM_GetFlagStatus(IR_TIM, TIM_FLAG_CC2) != RESET)
+      {
+        ICValue1 = TIM_GetCapture2(IR_TIM);
+      }
+      IR_PushPulse(ICValue1);
+    }
+    else if (IRIdleOverflows < IR_MAX_TICKS)
+    {
+      IRIdleOverflows++;
+    }
+  }
+#ifdef IR_PROFILE
+  cycles = IR_DWT_CYCCNT - cycles;
+  if (cycles > IRIsrMaxCycles)
+  {
+    IRIsrMaxCycles = cycles;
   }
+#endif
 }
 
 /**
-  * @brief  Identify the IR data.
-  * @param  lowPulseLength: low pulse duration. 
-  * @param  wholePulseLength: whole pulse duration.
+  * @brief  Store one ring buffer entry, called from TIM3_IRQHandler.
+  * @param  pulse: (whole << 16) | low
   * @retval None
   */
-static void IR_DataSampling(uint32_t lowPulseLength, uint32_t wholePulseLength)
+static void IR_PushPulse(uint32_t pulse)
 {
-  uint8_t  tmpBit = 0;
-  
-  /* If the pulse timing is correct */
-  if ((IRTmpPacket.status == IR_STATUS_RX)) 
+  uint16_t next = (IRPulseHead + 1) & (IR_RING_SIZE - 1);
+
+  if (next == IRPulseTail)
+  {
+    IROverruns++;
+    return;
+  }
+  IRPulseRing[IRPulseHead] = pulse;
+  IRPulseHead = next;
+}
+
+/**
+  * @brief  Offer one pulse pair to every protocol still in the running.
+  * @param  lowPulseLength: low pulse (mark) duration in us. 
+  * @param  wholePulseLength: whole pulse duration in us, 0 at the end of a
+  *         frame.
+  * @param  ir_frame: receives the frame when it is complete.
+  * @retval YES if a frame was decoded, else NO.
+  */
+static StatusYesOrNo IR_DataSampling(uint32_t lowPulseLength, uint32_t wholePulseLength, IR_Frame_TypeDef *ir_frame)
+{
+  const IR_Protocol_TypeDef *p;
+  IR_Match_TypeDef *m;
+  uint8_t end = (wholePulseLength == 0);
+  uint32_t space = 0;
+  uint8_t done = IR_PROTOCOL_COUNT;
+  uint8_t complete = 0;
+  uint8_t i = 0;
+
+  if (wholePulseLength > lowPulseLength)
   {
-    /* Convert raw pulse timing to data value */
-    tmpBit = IR_DecodeBit(lowPulseLength, wholePulseLength); 
-    if (tmpBit != IR_BIT_ERROR) /* If the pulse timing is correct */
+    space = wholePulseLength - lowPulseLength;
+  }
+
+  if (!IRInFrame)
+  {
+    for (i = 0; i < IR_PROTOCOL_COUNT; i++)
     {
-      /* This operation fills in the incoming bit to the correct position in
-      32 bit word*/
-      IRTmpPacket.data |= tmpBit;
-      IRTmpPacket.data <<= 1;
-      /* Increment the bit count  */
-      IRTmpPacket.count++;
+      IRMatch[i].State = IR_MATCH_HEADER;
+      IRMatch[i].BitCount = 0;
+      IRMatch[i].Half = 0;
+      IRMatch[i].Data = 0;
     }
-    /* If all bits identified */
-    if (IRTmpPacket.count == IR_TOTAL_BITS_COUNT)
+    IRInFrame = 1;
+  }
+
+  for (i = 0; i < IR_PROTOCOL_COUNT; i++)
+  {
+    p = &IR_Protocols[i];
+    m = &IRMatch[i];
+
+    if (m->State == IR_MATCH_FAIL)
     {
-      /* Frame received*/
-      IRFrameReceived = YES;
+      continue;
     }
-    /* Bit 15:the idle time between IR message and the inverted one */
-    else if (IRTmpPacket.count == IR_BITS_COUNT)
+    if (p->Encoding == IR_ENC_MANCHESTER)
     {
-      IRTmpPacket.status = IR_STATUS_HEADER; 
-    }
-  }
-  else if ((IRTmpPacket.status == IR_STATUS_HEADER))
-  {
-    /* Convert raw pulse timing to data value */
-    tmpBit = IR_DecodeHeader(lowPulseLength, wholePulseLength);
-    
-    /* If the Header timing is correct */
-    if ( tmpBit!= IR_HEADER_ERROR)
-    { 
-      /* Reception Status for the inverted message */
-      IRTmpPacket.status = IR_STATUS_RX; 
+      complete = IR_RC5_Match(p, m, lowPulseLength, space, end);
     }
     else
     {
-      /* Wrong header time */
-      IR_ResetPacket();  
+      complete = IR_MarkSpaceMatch(p, m, lowPulseLength, space, end);
+    }
+    if (complete && (done == IR_PROTOCOL_COUNT))
+    {
+      done = i;
     }
   }
+
+  if (!end)
+  {
+    return NO;
+  }
+  IRInFrame = 0;
+  if (done == IR_PROTOCOL_COUNT)
+  {
+    return NO;
+  }
+  return IR_Report(done, IRMatch[done].State == IR_MATCH_REPEAT_DONE, ir_frame);
+}
+
+/**
+  * @brief  Pulse distance (NEC, Samsung) and pulse width (SIRC) coding: one
+  *         pulse pair per bit, told apart by the mark and/or space length.
+  * @param  p: protocol descriptor.
+  * @param  m: match state of this protocol for the current frame.
+  * @param  lowPulseLength: mark duration in us.
+  * @param  spaceLength: space duration in us (ignored when end is set).
+  * @param  end: 1 if the line went idle after this mark (end of frame).
+  * @retval 1 when the frame is complete, else 0.
+  */
+static uint8_t IR_MarkSpaceMatch(const IR_Protocol_TypeDef *p, IR_Match_TypeDef *m, uint32_t lowPulseLength, uint32_t spaceLength, uint8_t end)
+{
+  switch (m->State)
+  {
+    case IR_MATCH_HEADER:
+      if (p->HeaderMark != 0)
+      {
+        if (end || !IR_Near(lowPulseLength, p->HeaderMark, p->Tolerance))
+        {
+          break;
+        }
+        if (IR_Near(spaceLength, p->HeaderSpace, p->Tolerance))
+        {
+          m->State = IR_MATCH_BITS;
+          return 0;
+        }
+        if ((p->RepeatSpace != 0) && IR_Near(spaceLength, p->RepeatSpace, p->Tolerance))
+        {
+          m->State = IR_MATCH_REPEAT;
+          return 0;
+        }
+        break;
+      }
+      /* No header: this pair is the first bit */
+      m->State = IR_MATCH_BITS;
+      /* Fall through */
+    case IR_MATCH_BITS:
+      /* The space of the last bit runs into the idle line */
+      if (IR_Near(lowPulseLength, p->ZeroMark, p->Tolerance)
+          && (end || IR_Near(spaceLength, p->ZeroSpace, p->Tolerance)))
+      {
+        IR_AddBit(p, m, 0);
+      }
+      else if (IR_Near(lowPulseLength, p->OneMark, p->Tolerance)
+               && (end || IR_Near(spaceLength, p->OneSpace, p->Tolerance)))
+      {
+        IR_AddBit(p, m, 1);
+      }
+      else
+      {
+        break;
+      }
+      if (m->BitCount < p->Bits)
+      {
+        if (end)
+        {
+          break;
+        }
+        return 0;
+      }
+      if (p->Flags & IR_STOP_BIT)
+      {
+        if (end)
+        {
+          break;
+        }
+        m->State = IR_MATCH_STOP;
+        return 0;
+      }
+      if (!end)
+      {
+        break;
+      }
+      m->State = IR_MATCH_DONE;
+      return 1;
+    case IR_MATCH_STOP:
+    case IR_MATCH_REPEAT:
+      if (!end || !IR_Near(lowPulseLength, p->ZeroMark, p->Tolerance))
+      {
+        break;
+      }
+      m->State = (m->State == IR_MATCH_STOP) ? IR_MATCH_DONE : IR_MATCH_REPEAT_DONE;
+      return 1;
+    default:
+      break;
+  }
+  m->State = IR_MATCH_FAIL;
+  return 0;
 }
 
 /**
-  * @brief  Check the header pulse if it has correct pulse time.
-  * @param  lowPulseLength: low pulse header duration.
-  * @param  wholePulseLength: whole pulse header duration.
-  * @retval IR_HEADER_OK or IR_HEADER_ERROR
+  * @brief  A frame matched: work out whether it is a new key press or the
+  *         same key held.
+  * @param  protocol: index of the matching protocol.
+  * @param  repeatCode: 1 for a repeat code (NEC), which carries no data.
+  * @param  ir_frame: receives the frame.
+  * @retval YES if ir_frame was filled in, NO for a repeat code with no key
+  *         to repeat.
   */
-static uint8_t IR_DecodeHeader(uint32_t lowPulseLength, uint32_t wholePulseLength)
+static StatusYesOrNo IR_Report(uint8_t protocol, uint8_t repeatCode, IR_Frame_TypeDef *ir_frame)
 {
-  /* First check if low pulse time is according to the specs */
-  if ((lowPulseLength >= IRHeaderLowMin) && (lowPulseLength <= IRHeaderLowMax)) 
+  const IR_Protocol_TypeDef *p = &IR_Protocols[protocol];
+  uint32_t data = IRMatch[protocol].Data;
+  uint8_t recent = (IRHaveLast != NO) && (IRLastFrame.Protocol == protocol)
+                   && (IRSilenceUs < p->RepeatMs * 1000);
+
+  if (repeatCode)
+  {
+    if (!recent)
+    {
+      return NO;
+    }
+    IRLastFrame.Repeat++;
+  }
+  else if (recent && (data == IRLastFrame.Data))
   {
-    /* Check if the high pulse is OK */
-    if ((wholePulseLength >= IRHeaderWholeMin) && (wholePulseLength <= IRHeaderWholeMax))
+    IRLastFrame.Repeat++;
+  }
+  else
+  {
+    IRLastFrame.Protocol = protocol;
+    IRLastFrame.Data = data;
+    IRLastFrame.Repeat = 0;
+    IRLastFrame.Address = (data >> p->AddressShift) & ((1UL << p->AddressBits) - 1);
+    IRLastFrame.Command = (data >> p->CommandShift) & ((1UL << p->CommandBits) - 1);
+    IRLastFrame.ToggleBit = 0;
+    if (p->ToggleBit != IR_NO_BIT)
     {
-      return IR_HEADER_OK; /* Valid Header */
+      IRLastFrame.ToggleBit = (data >> p->ToggleBit) & 1;
     }
-  }	
-  return IR_HEADER_ERROR;  /* Wrong Header */
+    IRHaveLast = YES;
+  }
+  *ir_frame = IRLastFrame;
+  return YES;
 }
 
 /**
-  * @brief  Convert raw time to data value.
-  * @param  lowPulseLength: low pulse bit duration.
-  * @param  wholePulseLength: whole pulse bit duration.
-  * @retval BitValue( data0 or data1) or IR_BIT_ERROR
+  * @brief  Check a measured duration against the expected one.
+  * @param  measured: measured duration in us.
+  * @param  expected: expected duration in us.
+  * @param  tolerance: tolerance in percent, IR_SLACK_US is added to it.
+  * @retval 1 if the duration fits, else 0.
   */
-static uint8_t IR_DecodeBit(uint32_t lowPulseLength , uint32_t wholePulseLength)
+uint8_t IR_Near(uint32_t measured, uint32_t expected, uint8_t tolerance)
 {
-  uint8_t i = 0;
-  
-  /* First check if low pulse time is according to the specs */
-  if ((lowPulseLength >= IROnTimeMin) && (lowPulseLength <= IROnTimeMax))
+  uint32_t slack = expected * tolerance / 100 + IR_SLACK_US;
+
+  return (measured + slack >= expected) && (measured <= expected + slack);
+}
+
+/**
+  * @brief  Insert one bit into the frame data word.
+  * @param  p: protocol descriptor (bit order).
+  * @param  m: match state.
+  * @param  bit: 0 or 1.
+  * @retval None
+  */
+void IR_AddBit(const IR_Protocol_TypeDef *p, IR_Match_TypeDef *m, uint8_t bit)
+{
+  if (p->Flags & IR_MSB_FIRST)
+  {
+    m->Data = (m->Data << 1) | bit;
+  }
+  else
+  {
+    m->Data |= (uint32_t)bit << m->BitCount;
+  }
+  m->BitCount++;
+}
+
+/**
+  * @brief  Longest mark + space a protocol sends within a frame, with its 
+  *         tolerance.
+  * @param  p: protocol descriptor.
+  * @retval Duration in us.
+  */
+static uint32_t IR_LongestPair(const IR_Protocol_TypeDef *p)
+{
+  uint32_t space = (p->HeaderSpace > p->RepeatSpace) ? p->HeaderSpace : p->RepeatSpace;
+  uint32_t n = p->HeaderMark + space;
+
+  if (p->Encoding == IR_ENC_MANCHESTER)
+  {
+    if (RC5_MAX_UNITS * (uint32_t)p->Unit > n)
+    {
+      n = RC5_MAX_UNITS * (uint32_t)p->Unit;
+    }
+  }
+  else
   {
-    for (i = 0; i < 2; i++) /* There are data0 to data1 */
+    if ((uint32_t)p->ZeroMark + p->ZeroSpace > n)
+    {
+      n = (uint32_t)p->ZeroMark + p->ZeroSpace;
+    }
+    if ((uint32_t)p->OneMark + p->OneSpace > n)
     {
-      /* Check if the length is in given range */
-      if ((wholePulseLength >= IRValue00 + (IRValueStep * i) - IRValueMargin) 
-          && (wholePulseLength <= IRValue00 + (IRValueStep * i) + IRValueMargin))
-        return i; /* Return bit value */
+      n = (uint32_t)p->OneMark + p->OneSpace;
     }
   }
-  return IR_BIT_ERROR; /* No correct pulse length was found */
+  return n + n * p->Tolerance / 100 + IR_SLACK_US;
+}
+
+#ifdef USE_LCD 
+/**
+  * @brief  Display the received frame.
+  * @param  ir_frame: the frame.
+  * @retval None
+  */
+static void IR_Display(IR_Frame_TypeDef *ir_frame)
+{
+  uint8_t line[24];
+
+  sprintf((char *)line, "%-7s repeat %-5u", IR_Protocols[ir_frame->Protocol].Name,
+          (unsigned)ir_frame->Repeat);
+  LCD_DisplayStringLine(LCD_LINE_4, line);
+
+  if (ir_frame->Protocol == IR_RC5)
+  {
+    LCD_DisplayStringLine(LCD_LINE_5, rc5_Commands[ir_frame->Command]);
+    LCD_DisplayStringLine(LCD_LINE_6, rc5_devices[ir_frame->Address]);
+  }
+  else if (ir_frame->Protocol == IR_SIRC)
+  {
+    LCD_DisplayStringLine(LCD_LINE_5, IR_Commands[ir_frame->Command]);
+    LCD_DisplayStringLine(LCD_LINE_6, IR_devices[ir_frame->Address]);
+  }
+  else
+  {
+    sprintf((char *)line, "  Command 0x%02X      ", (unsigned)ir_frame->Command);
+    LCD_DisplayStringLine(LCD_LINE_5, line);
+    sprintf((char *)line, "  Address 0x%04X    ", (unsigned)ir_frame->Address);
+    LCD_DisplayStringLine(LCD_LINE_6, line);
+  }
 }
+#endif
 
 /**
   * @brief  Identify TIM clock
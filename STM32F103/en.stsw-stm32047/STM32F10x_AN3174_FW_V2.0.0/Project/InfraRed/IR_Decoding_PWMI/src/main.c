@@ -94,20 +94,13 @@ int32_t main(void)
   /* Clear the LCD */ 
   LCD_Clear(LCD_COLOR_WHITE);
 
-#if defined IR_RC5_PROTOCOL
-  IR_RC5_Init();
-#else
+  /* All the protocols of IR_Protocols are decoded at once */
   IR_Init();
-#endif 
   
   while(1)
   { 
-#if defined (IR_RC5_PROTOCOL)
-   /* RC5 */
-   IR_RC5_Decode(&IR_FRAME);
-#else
+   /* Decode the captured pulses, the frame is displayed on the LCD */
    IR_Decode(&IR_FRAME);
-#endif
   }
 }
 
@@ -31,6 +31,17 @@
   *                completed (variable decremented to 0). Stopping transfer tasks
   *                are performed into DMA interrupt handlers (which are integrated
   *                into this driver).
+  *
+  *          @note Writes can also go through a write-back cache of 
+  *                sEE_CACHE_PAGES pages: sEE_CacheWriteBuffer() merges the data
+  *                into RAM and returns. sEE_PollHandler(), called from a timer
+  *                interrupt, sends one page to the EEPROM and then polls its 
+  *                address once per call until the write cycle is over, before
+  *                sending the next page. sEE_CacheReadBuffer() returns the 
+  *                cached data without waiting for it to be written, 
+  *                sEE_CacheBarrier() keeps the writes made before it ahead of
+  *                the ones made after it, and sEE_CacheFlush() waits until the 
+  *                EEPROM holds everything.
   *            
   *     +-----------------------------------------------------------------+
   *     |                        Pin assignment                           |                 
@@ -83,6 +94,16 @@
 /** @defgroup STM32_EVAL_I2C_EE_Private_Types
   * @{
   */ 
+typedef struct
+{
+  uint16_t Page;                  /*!< EEPROM page held by the line, sEE_CACHE_FREE if none */
+  uint8_t  Epoch;                 /*!< sEE_CacheBarrier() epoch of the dirty bytes */
+  uint32_t Seq;                   /*!< Order in which the line became dirty */
+  uint32_t Used;                  /*!< Last access, for the least recently used replacement */
+  uint32_t Valid;                 /*!< One bit per byte known to hold the EEPROM data (or newer) */
+  uint32_t Dirty;                 /*!< One bit per byte not sent to the EEPROM yet */
+  uint8_t  Data[sEE_PAGESIZE];    /*!< Page contents */
+} sEE_CacheLine_TypeDef;
 /**
   * @}
   */ 
@@ -91,6 +112,16 @@
 /** @defgroup STM32_EVAL_I2C_EE_Private_Defines
   * @{
   */  
+#define sEE_CACHE_FREE            ((uint16_t)0xFFFF)
+
+/* States of the page write started by the cache */
+#define sEE_CACHE_IDLE            0   /*!< No page write in progress */
+#define sEE_CACHE_TRANSFER        1   /*!< Page being sent by the DMA */
+#define sEE_CACHE_CYCLE           2   /*!< EEPROM busy with its internal write cycle */
+
+#if (sEE_PAGESIZE > 32)
+ #error "The cache byte masks hold 32 bytes at most"
+#endif
 /**
   * @}
   */ 
@@ -112,6 +143,16 @@ __IO uint32_t  sEETimeout = sEE_LONG_TIMEOUT;
 __IO uint16_t* sEEDataReadPointer;   
 __IO uint8_t*  sEEDataWritePointer;  
 __IO uint8_t   sEEDataNum;
+
+static sEE_CacheLine_TypeDef sEE_Cache[sEE_CACHE_PAGES];
+static uint8_t  sEE_CacheTxBuffer[sEE_PAGESIZE];   /*!< Bytes of the page write in progress */
+static __IO uint8_t  sEE_CacheDataNum = 0;         /*!< Zeroed by the DMA Tx interrupt */
+static __IO uint16_t sEE_CacheReadNum = 0;         /*!< Zeroed by the DMA Rx interrupt */
+static __IO uint8_t  sEE_CacheState = sEE_CACHE_IDLE;
+static __IO uint8_t  sEE_CacheLocked = 0;          /*!< I2C in use, sEE_PollHandler() keeps off */
+static uint8_t  sEE_CacheEpoch = 0;                /*!< Current sEE_CacheBarrier() epoch */
+static uint32_t sEE_CacheSeq = 0;                  /*!< Next dirty line sequence number */
+static uint32_t sEE_CacheUsed = 0;                 /*!< Next access stamp */
 /**
   * @}
   */ 
@@ -120,6 +161,17 @@ __IO uint8_t   sEEDataNum;
 /** @defgroup STM32_EVAL_I2C_EE_Private_Function_Prototypes
   * @{
   */ 
+static uint32_t sEE_PollStandbyState(void);
+static uint32_t sEE_CacheMask(uint16_t Offset, uint16_t Count);
+static sEE_CacheLine_TypeDef* sEE_CacheLookup(uint16_t Page);
+static sEE_CacheLine_TypeDef* sEE_CacheAllocate(uint16_t Page);
+static void     sEE_CacheInvalidate(uint16_t Addr, uint16_t NumByte);
+static void     sEE_CacheStep(void);
+static uint32_t sEE_CacheStartWrite(void);
+static uint32_t sEE_CacheWaitIdle(void);
+static uint32_t sEE_CacheRun(void);
+static uint32_t sEE_CacheDrain(void);
+static uint32_t sEE_CacheReadEeprom(uint8_t* pBuffer, uint16_t ReadAddr, uint16_t NumByteToRead);
 /**
   * @}
   */ 
@@ -147,6 +199,7 @@ void sEE_DeInit(void)
 void sEE_Init(void)
 { 
   I2C_InitTypeDef  I2C_InitStructure;
+  uint32_t i = 0;
   
   sEE_LowLevel_Init();
   
@@ -192,6 +245,17 @@ void sEE_Init(void)
   sEEAddress = sEE_Block3_ADDRESS;
  #endif 
 #endif /*!< sEE_M24C64_32 */    
+
+  /*!< Empty the write-back cache */
+  for (i = 0; i < sEE_CACHE_PAGES; i++)
+  {
+    sEE_Cache[i].Page = sEE_CACHE_FREE;
+    sEE_Cache[i].Valid = 0;
+    sEE_Cache[i].Dirty = 0;
+    sEE_Cache[i].Used = 0;
+  }
+  sEE_CacheState = sEE_CACHE_IDLE;
+  sEE_CacheLocked = 0;
 }
 
 /**
@@ -211,6 +275,11 @@ void sEE_Init(void)
   *       Meanwhile, the user application may perform other tasks.
   *       When number of data to be read is 1, then the DMA is not used. The byte
   *       is read in polling mode.
+  *
+  * @note This function reads the EEPROM itself: it does not see the data still
+  *       in the write-back cache and fails while the cache is writing a page.
+  *       Use sEE_CacheReadBuffer() or call sEE_CacheFlush() first when the
+  *       cache is in use.
   * 
   * @retval sEE_OK (0) if operation is correctly performed, else return value 
   *         different from sEE_OK (0) or the timeout user callback.
@@ -472,6 +541,8 @@ uint32_t sEE_WritePage(uint8_t* pBuffer, uint16_t WriteAddr, uint8_t* NumByteToW
   *         to the EEPROM.
   * @param  WriteAddr : EEPROM's internal address to write to.
   * @param  NumByteToWrite : number of bytes to write to the EEPROM.
+  * @note   The write-back cache is written first, and forgets the pages 
+  *         written here.
   * @retval None
   */
 void sEE_WriteBuffer(uint8_t* pBuffer, uint16_t WriteAddr, uint16_t NumByteToWrite)
@@ -479,6 +550,11 @@ void sEE_WriteBuffer(uint8_t* pBuffer, uint16_t WriteAddr, uint16_t NumByteToWri
   uint8_t NumOfPage = 0, NumOfSingle = 0, count = 0;
   uint16_t Addr = 0;
 
+  sEE_CacheLocked = 1;
+  sEE_CacheDrain();
+  sEE_CacheInvalidate(WriteAddr, NumByteToWrite);
+  sEE_CacheLocked = 0;
+
   Addr = WriteAddr % sEE_PAGESIZE;
   count = sEE_PAGESIZE - Addr;
   NumOfPage =  NumByteToWrite / sEE_PAGESIZE;
@@ -729,6 +805,242 @@ uint32_t sEE_WaitEepromStandbyState(void)
   }
 }
 
+/**
+  * @brief  Writes buffer of data to the I2C EEPROM through the write-back 
+  *         cache, and returns as soon as the data is in RAM.
+  *
+  * @note   The data is merged into the cached pages: several writes to the 
+  *         same page before it is sent cost a single EEPROM write cycle. When
+  *         no page can take the data, this function waits for the oldest 
+  *         dirty page to be written. sEE_PollHandler() writes the pages in the
+  *         order they were first modified.
+  *
+  * @param  pBuffer : pointer to the buffer containing the data to be written 
+  *         to the EEPROM.
+  * @param  WriteAddr : EEPROM's internal address to write to.
+  * @param  NumByteToWrite : number of bytes to write to the EEPROM.
+  * @retval sEE_OK (0) if operation is correctly performed, else return value 
+  *         different from sEE_OK (0) or the timeout user callback.
+  */
+uint32_t sEE_CacheWriteBuffer(uint8_t* pBuffer, uint16_t WriteAddr, uint16_t NumByteToWrite)
+{
+  sEE_CacheLine_TypeDef* pLine;
+  uint32_t status = sEE_OK;
+  uint16_t offset = 0, count = 0, i = 0;
+
+  sEE_CacheLocked = 1;
+  
+  while ((NumByteToWrite > 0) && (status == sEE_OK))
+  {
+    /*!< Up to the end of the page */
+    offset = WriteAddr % sEE_PAGESIZE;
+    count = sEE_PAGESIZE - offset;
+    if (count > NumByteToWrite)
+    {
+      count = NumByteToWrite;
+    }
+
+    /*!< Bytes written before the last barrier are sent before these ones */
+    pLine = sEE_CacheLookup(WriteAddr / sEE_PAGESIZE);
+    while ((pLine != 0) && (pLine->Dirty != 0) && (pLine->Epoch != sEE_CacheEpoch))
+    {
+      status = sEE_CacheRun();
+      if (status != sEE_OK)
+      {
+        break;
+      }
+    }
+
+    if ((status == sEE_OK) && (pLine == 0))
+    {
+      pLine = sEE_CacheAllocate(WriteAddr / sEE_PAGESIZE);
+      if (pLine == 0)
+      {
+        status = sEE_FAIL;
+      }
+    }
+
+    if (status == sEE_OK)
+    {
+      if (pLine->Dirty == 0)
+      {
+        pLine->Epoch = sEE_CacheEpoch;
+        pLine->Seq = sEE_CacheSeq++;
+      }
+      for (i = 0; i < count; i++)
+      {
+        pLine->Data[offset + i] = pBuffer[i];
+      }
+      pLine->Valid |= sEE_CacheMask(offset, count);
+      pLine->Dirty |= sEE_CacheMask(offset, count);
+      pLine->Used = sEE_CacheUsed++;
+
+      WriteAddr += count;
+      pBuffer += count;
+      NumByteToWrite -= count;
+    }
+  }
+
+  /*!< Start the first page write now rather than on the next timer tick */
+  if (status == sEE_OK)
+  {
+    sEE_CacheStep();
+  }
+  
+  sEE_CacheLocked = 0;
+  return status;
+}
+
+/**
+  * @brief  Reads a block of data from the EEPROM as if the write-back cache had
+  *         already been written, and waits for the data.
+  *
+  * @note   Pages whose requested bytes are all in the cache are read from RAM.
+  *         Others are read from the EEPROM, after the end of the page write in 
+  *         progress, and the cached bytes are copied over them.
+  *
+  * @param  pBuffer : pointer to the buffer that receives the data read from 
+  *         the EEPROM.
+  * @param  ReadAddr : EEPROM's internal address to start reading from.
+  * @param  NumByteToRead : number of bytes to read from the EEPROM.
+  * @retval sEE_OK (0) if operation is correctly performed, else return value 
+  *         different from sEE_OK (0) or the timeout user callback.
+  */
+uint32_t sEE_CacheReadBuffer(uint8_t* pBuffer, uint16_t ReadAddr, uint16_t NumByteToRead)
+{
+  sEE_CacheLine_TypeDef* pLine;
+  uint32_t status = sEE_OK, mask = 0;
+  uint16_t offset = 0, count = 0, i = 0;
+
+  sEE_CacheLocked = 1;
+  
+  while ((NumByteToRead > 0) && (status == sEE_OK))
+  {
+    /*!< Up to the end of the page */
+    offset = ReadAddr % sEE_PAGESIZE;
+    count = sEE_PAGESIZE - offset;
+    if (count > NumByteToRead)
+    {
+      count = NumByteToRead;
+    }
+    mask = sEE_CacheMask(offset, count);
+
+    pLine = sEE_CacheLookup(ReadAddr / sEE_PAGESIZE);
+    if ((pLine == 0) || ((pLine->Valid & mask) != mask))
+    {
+      /*!< Some bytes are not in RAM: the EEPROM answers once its write cycle is over */
+      status = sEE_CacheWaitIdle();
+      if (status == sEE_OK)
+      {
+        status = sEE_CacheReadEeprom(pBuffer, ReadAddr, count);
+      }
+    }
+
+    if ((status == sEE_OK) && (pLine != 0))
+    {
+      /*!< Cached bytes are the newest, the others fill the line */
+      for (i = 0; i < count; i++)
+      {
+        if (pLine->Valid & sEE_CacheMask(offset + i, 1))
+        {
+          pBuffer[i] = pLine->Data[offset + i];
+        }
+        else
+        {
+          pLine->Data[offset + i] = pBuffer[i];
+        }
+      }
+      pLine->Valid |= mask;
+      pLine->Used = sEE_CacheUsed++;
+    }
+
+    ReadAddr += count;
+    pBuffer += count;
+    NumByteToRead -= count;
+  }
+  
+  sEE_CacheLocked = 0;
+  return status;
+}
+
+/**
+  * @brief  Orders the cached writes: the data written before this call reaches
+  *         the EEPROM before the data written after it.
+  * @note   Without a barrier, pages are written in the order they were first
+  *         modified and a later write to a page still in the cache goes out
+  *         with it. After a barrier, such a write waits for the page to be
+  *         sent first.
+  * @param  None
+  * @retval None
+  */
+void sEE_CacheBarrier(void)
+{
+  sEE_CacheEpoch++;
+}
+
+/**
+  * @brief  Writes every dirty page of the cache and waits for the end of the
+  *         last EEPROM write cycle.
+  * @param  None
+  * @retval sEE_OK (0) if operation is correctly performed, else return value 
+  *         different from sEE_OK (0) or the timeout user callback.
+  */
+uint32_t sEE_CacheFlush(void)
+{
+  uint32_t status = sEE_OK;
+  
+  sEE_CacheLocked = 1;
+  status = sEE_CacheDrain();
+  sEE_CacheLocked = 0;
+  
+  return status;
+}
+
+/**
+  * @brief  Checks whether the cache still has data to write.
+  * @param  None
+  * @retval SET while dirty pages remain or a page write is in progress, RESET
+  *         otherwise.
+  */
+FlagStatus sEE_GetCacheStatus(void)
+{
+  uint32_t i = 0;
+  
+  if (sEE_CacheState != sEE_CACHE_IDLE)
+  {
+    return SET;
+  }
+  for (i = 0; i < sEE_CACHE_PAGES; i++)
+  {
+    if (sEE_Cache[i].Dirty != 0)
+    {
+      return SET;
+    }
+  }
+  return RESET;
+}
+
+/**
+  * @brief  Advances the write-back cache without waiting: while the EEPROM is
+  *         in its write cycle, polls its address once; when it acknowledges, 
+  *         sends the next dirty page.
+  * @note   To be called periodically, typically from a 1 ms timer interrupt
+  *         (a write cycle lasts up to 5 ms). It returns at once while another
+  *         sEE function is using the I2C.
+  * @param  None
+  * @retval None
+  */
+void sEE_PollHandler(void)
+{
+  if (sEE_CacheLocked)
+  {
+    return;
+  }
+  sEE_CacheLocked = 1;
+  sEE_CacheStep();
+  sEE_CacheLocked = 0;
+}
+
 /**
   * @brief  This function handles the DMA Tx Channel interrupt Handler.
   * @param  None
@@ -831,6 +1143,338 @@ void sEE_ExitCriticalSection_UserCallback(void)
 }
 #endif /* USE_DEFAULT_CRITICAL_CALLBACK */
 
+/**
+  * @brief  Polls the EEPROM address once.
+  * @param  None
+  * @retval sEE_OK (0) if the EEPROM acknowledged (write cycle over), sEE_FAIL
+  *         if not, or the timeout user callback.
+  */
+static uint32_t sEE_PollStandbyState(void)
+{
+  __IO uint16_t tmpSR1 = 0;
+
+  /*!< Send START condition */
+  I2C_GenerateSTART(sEE_I2C, ENABLE);
+
+  /*!< Test on EV5 and clear it */
+  sEETimeout = sEE_FLAG_TIMEOUT;
+  while(!I2C_CheckEvent(sEE_I2C, I2C_EVENT_MASTER_MODE_SELECT))
+  {
+    if((sEETimeout--) == 0) return sEE_TIMEOUT_UserCallback();
+  }    
+
+  /*!< Send EEPROM address for write */
+  I2C_Send7bitAddress(sEE_I2C, sEEAddress, I2C_Direction_Transmitter);
+  
+  /* Wait for the address to be acknowledged (ADDR) or not (AF) */
+  sEETimeout = sEE_LONG_TIMEOUT;
+  do
+  {     
+    tmpSR1 = sEE_I2C->SR1;
+    if((sEETimeout--) == 0) return sEE_TIMEOUT_UserCallback();
+  }
+  while((tmpSR1 & (I2C_SR1_ADDR | I2C_SR1_AF)) == 0);
+   
+  if (tmpSR1 & I2C_SR1_ADDR)
+  {
+    /* Clear ADDR Flag by reading SR1 then SR2 registers (SR1 have already 
+       been read) */
+    (void)sEE_I2C->SR2;
+    
+    /*!< STOP condition */    
+    I2C_GenerateSTOP(sEE_I2C, ENABLE);
+    return sEE_OK;
+  }
+
+  /*!< Clear AF flag and release the bus until the next trial */
+  I2C_ClearFlag(sEE_I2C, I2C_FLAG_AF);
+  I2C_GenerateSTOP(sEE_I2C, ENABLE);
+  return sEE_FAIL;
+}
+
+/**
+  * @brief  Builds the byte mask of a part of a cache line.
+  * @param  Offset : first byte in the page.
+  * @param  Count : number of bytes.
+  * @retval One bit set per byte.
+  */
+static uint32_t sEE_CacheMask(uint16_t Offset, uint16_t Count)
+{
+  if (Count >= 32)
+  {
+    return 0xFFFFFFFF;
+  }
+  return ((((uint32_t)1 << Count) - 1) << Offset);
+}
+
+/**
+  * @brief  Finds the cache line holding an EEPROM page.
+  * @param  Page : EEPROM page number.
+  * @retval The line, 0 if the page is not cached.
+  */
+static sEE_CacheLine_TypeDef* sEE_CacheLookup(uint16_t Page)
+{
+  uint32_t i = 0;
+
+  for (i = 0; i < sEE_CACHE_PAGES; i++)
+  {
+    if (sEE_Cache[i].Page == Page)
+    {
+      return &sEE_Cache[i];
+    }
+  }
+  return 0;
+}
+
+/**
+  * @brief  Gives an EEPROM page the least recently used clean line, writing 
+  *         dirty pages until one is clean.
+  * @param  Page : EEPROM page number.
+  * @retval The line, 0 if a page write failed.
+  */
+static sEE_CacheLine_TypeDef* sEE_CacheAllocate(uint16_t Page)
+{
+  sEE_CacheLine_TypeDef* pLine = 0;
+  uint32_t i = 0;
+
+  while (pLine == 0)
+  {
+    for (i = 0; i < sEE_CACHE_PAGES; i++)
+    {
+      if ((sEE_Cache[i].Dirty == 0) &&
+          ((pLine == 0) || ((int32_t)(sEE_Cache[i].Used - pLine->Used) < 0)))
+      {
+        pLine = &sEE_Cache[i];
+      }
+    }
+    if ((pLine == 0) && (sEE_CacheRun() != sEE_OK))
+    {
+      return 0;
+    }
+  }
+
+  pLine->Page = Page;
+  pLine->Valid = 0;
+  return pLine;
+}
+
+/**
+  * @brief  Drops the clean cache lines overlapping an EEPROM area.
+  * @param  Addr : first EEPROM address of the area.
+  * @param  NumByte : size of the area.
+  * @retval None
+  */
+static void sEE_CacheInvalidate(uint16_t Addr, uint16_t NumByte)
+{
+  uint32_t i = 0, first = 0, last = 0;
+
+  if (NumByte == 0)
+  {
+    return;
+  }
+  first = Addr / sEE_PAGESIZE;
+  last = ((uint32_t)Addr + NumByte - 1) / sEE_PAGESIZE;
+  
+  for (i = 0; i < sEE_CACHE_PAGES; i++)
+  {
+    if ((sEE_Cache[i].Page != sEE_CACHE_FREE) && (sEE_Cache[i].Dirty == 0) &&
+        (sEE_Cache[i].Page >= first) && (sEE_Cache[i].Page <= last))
+    {
+      sEE_Cache[i].Page = sEE_CACHE_FREE;
+      sEE_Cache[i].Valid = 0;
+    }
+  }
+}
+
+/**
+  * @brief  One step of the page write without waiting: notes the end of the
+  *         DMA transfer, polls the EEPROM once during its write cycle and 
+  *         starts the next page write when it is over.
+  * @param  None
+  * @retval None
+  */
+static void sEE_CacheStep(void)
+{
+  if (sEE_CacheState == sEE_CACHE_TRANSFER)
+  {
+    /*!< The DMA Tx interrupt zeroes the counter once the page is sent */
+    if (sEE_CacheDataNum > 0)
+    {
+      return;
+    }
+    sEE_CacheState = sEE_CACHE_CYCLE;
+  }
+
+  /*!< Keep off the bus while another transfer uses it */
+  if (I2C_GetFlagStatus(sEE_I2C, I2C_FLAG_BUSY))
+  {
+    return;
+  }
+
+  if (sEE_CacheState == sEE_CACHE_CYCLE)
+  {
+    /*!< The EEPROM does not acknowledge its address until the end of the 
+         write cycle: try again on the next call */
+    if (sEE_PollStandbyState() != sEE_OK)
+    {
+      return;
+    }
+    sEE_CacheState = sEE_CACHE_IDLE;
+  }
+
+  sEE_CacheStartWrite();
+}
+
+/**
+  * @brief  Sends the first run of dirty bytes of the oldest dirty line with a
+  *         single page write. The EEPROM write cycle starts at the end of the
+  *         DMA transfer.
+  * @note   Only consecutive dirty bytes are sent: the bytes between two runs
+  *         may never have been read from the EEPROM. 
+  * @param  None
+  * @retval sEE_OK (0) if a page write was started or nothing is dirty, else
+  *         the timeout user callback.
+  */
+static uint32_t sEE_CacheStartWrite(void)
+{
+  sEE_CacheLine_TypeDef* pLine = 0;
+  uint32_t i = 0, first = 0, count = 0, status = sEE_OK;
+
+  /*!< Oldest dirty line first: pages reach the EEPROM in the order they were
+       first modified, which keeps the sEE_CacheBarrier() order */
+  for (i = 0; i < sEE_CACHE_PAGES; i++)
+  {
+    if ((sEE_Cache[i].Dirty != 0) &&
+        ((pLine == 0) || ((int32_t)(sEE_Cache[i].Seq - pLine->Seq) < 0)))
+    {
+      pLine = &sEE_Cache[i];
+    }
+  }
+  if (pLine == 0)
+  {
+    return sEE_OK;
+  }
+
+  while ((pLine->Dirty & sEE_CacheMask(first, 1)) == 0)
+  {
+    first++;
+  }
+  while (((first + count) < sEE_PAGESIZE) && (pLine->Dirty & sEE_CacheMask(first + count, 1)))
+  {
+    sEE_CacheTxBuffer[count] = pLine->Data[first + count];
+    count++;
+  }
+
+  /*!< The bytes are copied: writes made from now on stay dirty for the next 
+       page write */
+  pLine->Dirty &= ~sEE_CacheMask(first, count);
+  sEE_CacheDataNum = count;
+  status = sEE_WritePage(sEE_CacheTxBuffer, (uint16_t)(pLine->Page * sEE_PAGESIZE + first), 
+                         (uint8_t*)(&sEE_CacheDataNum));
+  if (status != sEE_OK)
+  {
+    pLine->Dirty |= sEE_CacheMask(first, count);
+    return status;
+  }
+  
+  sEE_CacheState = sEE_CACHE_TRANSFER;
+  return sEE_OK;
+}
+
+/**
+  * @brief  Waits for the end of the page write in progress, if any.
+  * @param  None
+  * @retval sEE_OK (0) if operation is correctly performed, else return value 
+  *         different from sEE_OK (0) or the timeout user callback.
+  */
+static uint32_t sEE_CacheWaitIdle(void)
+{
+  uint32_t status = sEE_OK;
+
+  if (sEE_CacheState == sEE_CACHE_TRANSFER)
+  {
+    /* Wait transfer through DMA to be complete */
+    sEETimeout = sEE_LONG_TIMEOUT;
+    while (sEE_CacheDataNum > 0)
+    {
+      if((sEETimeout--) == 0) return sEE_TIMEOUT_UserCallback();
+    }
+    sEE_CacheState = sEE_CACHE_CYCLE;
+  }
+  
+  if (sEE_CacheState == sEE_CACHE_CYCLE)
+  {
+    status = sEE_WaitEepromStandbyState();
+    sEE_CacheState = sEE_CACHE_IDLE;
+  }
+  
+  return status;
+}
+
+/**
+  * @brief  Waits for the page write in progress, then starts the next one.
+  * @param  None
+  * @retval sEE_OK (0) if operation is correctly performed, else return value 
+  *         different from sEE_OK (0) or the timeout user callback.
+  */
+static uint32_t sEE_CacheRun(void)
+{
+  uint32_t status = sEE_CacheWaitIdle();
+
+  if (status == sEE_OK)
+  {
+    status = sEE_CacheStartWrite();
+  }
+  return status;
+}
+
+/**
+  * @brief  Writes every dirty line and waits for the last write cycle.
+  * @param  None
+  * @retval sEE_OK (0) if operation is correctly performed, else return value 
+  *         different from sEE_OK (0) or the timeout user callback.
+  */
+static uint32_t sEE_CacheDrain(void)
+{
+  uint32_t status = sEE_OK;
+
+  do
+  {
+    status = sEE_CacheRun();
+  }
+  while ((status == sEE_OK) && (sEE_CacheState != sEE_CACHE_IDLE));
+  
+  return status;
+}
+
+/**
+  * @brief  Reads a block of data from the EEPROM and waits for it.
+  * @param  pBuffer : pointer to the buffer that receives the data.
+  * @param  ReadAddr : EEPROM's internal address to start reading from.
+  * @param  NumByteToRead : number of bytes to read.
+  * @retval sEE_OK (0) if operation is correctly performed, else return value 
+  *         different from sEE_OK (0) or the timeout user callback.
+  */
+static uint32_t sEE_CacheReadEeprom(uint8_t* pBuffer, uint16_t ReadAddr, uint16_t NumByteToRead)
+{
+  uint32_t status = sEE_OK;
+
+  sEE_CacheReadNum = NumByteToRead;
+  status = sEE_ReadBuffer(pBuffer, ReadAddr, (uint16_t*)(&sEE_CacheReadNum));
+  if (status != sEE_OK)
+  {
+    return status;
+  }
+
+  /* Wait transfer through DMA to be complete */
+  sEETimeout = sEE_LONG_TIMEOUT;
+  while (sEE_CacheReadNum > 0)
+  {
+    if((sEETimeout--) == 0) return sEE_TIMEOUT_UserCallback();
+  }
+  return sEE_OK;
+}
+
 /**
   * @}
   */
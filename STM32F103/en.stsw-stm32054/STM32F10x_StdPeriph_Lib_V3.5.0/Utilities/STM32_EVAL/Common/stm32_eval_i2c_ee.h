@@ -129,6 +129,12 @@
 #define sEE_OK                    0
 #define sEE_FAIL                  1   
 
+/* Number of EEPROM pages held by the write-back cache of sEE_CacheWriteBuffer().
+   Each page costs sEE_PAGESIZE bytes of RAM plus its bookkeeping. */
+#ifndef sEE_CACHE_PAGES
+ #define sEE_CACHE_PAGES          4
+#endif
+
 /**
   * @}
   */ 
@@ -150,6 +156,16 @@ uint32_t sEE_WritePage(uint8_t* pBuffer, uint16_t WriteAddr, uint8_t* NumByteToW
 void     sEE_WriteBuffer(uint8_t* pBuffer, uint16_t WriteAddr, uint16_t NumByteToWrite);
 uint32_t sEE_WaitEepromStandbyState(void);
 
+/* Write-back cache functions: sEE_CacheWriteBuffer() returns as soon as the 
+   data is in RAM and sEE_PollHandler(), called from a timer interrupt, writes 
+   one page per EEPROM write cycle. */
+uint32_t sEE_CacheWriteBuffer(uint8_t* pBuffer, uint16_t WriteAddr, uint16_t NumByteToWrite);
+uint32_t sEE_CacheReadBuffer(uint8_t* pBuffer, uint16_t ReadAddr, uint16_t NumByteToRead);
+void     sEE_CacheBarrier(void);
+uint32_t sEE_CacheFlush(void);
+FlagStatus sEE_GetCacheStatus(void);
+void     sEE_PollHandler(void);
+
 /* USER Callbacks: These are functions for which prototypes only are declared in
    EEPROM driver and that should be implemented into user applicaiton. */  
 /* sEE_TIMEOUT_UserCallback() function is called whenever a timeout condition 
@@ -15,6 +15,16 @@
   *          You can easily tailor this driver to any other development board, 
   *          by just adapting the defines for hardware resources and 
   *          sFLASH_LowLevel_Init() function.
+  *
+  *          Data phases go through DMA (sFLASH_DMA_xxx defines) and reads use
+  *          the FAST_READ instruction. Page programs and erases can also be
+  *          queued with sFLASH_QueueWriteBuffer()/sFLASH_QueueEraseSector():
+  *          they return at once and sFLASH_PollHandler(), called from a timer
+  *          interrupt, reads the status register once per call and starts the
+  *          next operation when the FLASH is ready. sFLASH_ReadBuffer() returns
+  *          the data as if the queue had already been written. The
+  *          sFLASH_LogXxx() functions append records to a FLASH area and
+  *          gather them into full pages before queueing them.
   *            
   *          +-----------------------------------------------------------+
   *          |                     Pin assignment                        |
@@ -67,6 +77,13 @@
 /** @defgroup STM32_EVAL_SPI_FLASH_Private_Types
   * @{
   */ 
+typedef struct
+{
+  uint32_t Addr;                        /*!< FLASH address of the operation */
+  uint16_t Length;                      /*!< Number of bytes to program */
+  uint8_t  Cmd;                         /*!< sFLASH_CMD_WRITE, sFLASH_CMD_SE or sFLASH_CMD_BE */
+  uint8_t  Data[sFLASH_SPI_PAGESIZE];   /*!< Bytes to program */
+} sFLASH_Operation_TypeDef;
 /**
   * @}
   */ 
@@ -75,6 +92,7 @@
 /** @defgroup STM32_EVAL_SPI_FLASH_Private_Defines
   * @{
   */  
+#define sFLASH_QUEUE_MASK         (sFLASH_QUEUE_DEPTH - 1)
 /**
   * @}
   */ 
@@ -90,6 +108,22 @@
 /** @defgroup STM32_EVAL_SPI_FLASH_Private_Variables
   * @{
   */ 
+static sFLASH_Operation_TypeDef sFLASH_Queue[sFLASH_QUEUE_DEPTH];
+static __IO uint8_t sFLASH_QueueHead = 0;     /*!< Next free entry of sFLASH_Queue */
+static __IO uint8_t sFLASH_QueueTail = 0;     /*!< Oldest entry of sFLASH_Queue */
+static __IO uint8_t sFLASH_Started = 0;       /*!< Oldest entry has been sent to the FLASH */
+static __IO uint8_t sFLASH_BusLocked = 0;     /*!< SPI in use, sFLASH_PollHandler() keeps off */
+
+static const uint8_t sFLASH_DMADummy = sFLASH_DUMMY_BYTE;
+static uint8_t sFLASH_DMASink;
+
+static uint32_t sFLASH_LogStart = 0;          /*!< First address of the log area */
+static uint32_t sFLASH_LogEnd = 0;            /*!< End of the log area */
+static uint32_t sFLASH_LogPage = 0;           /*!< Page being filled */
+static uint32_t sFLASH_LogErased = 0;         /*!< End of the sectors already erased */
+static uint16_t sFLASH_LogFill = 0;           /*!< Bytes of sFLASH_LogPage in use */
+static uint16_t sFLASH_LogDone = 0;           /*!< Bytes of sFLASH_LogPage already queued */
+static uint8_t sFLASH_LogBuffer[sFLASH_SPI_PAGESIZE];
 /**
   * @}
   */ 
@@ -98,6 +132,16 @@
 /** @defgroup STM32_EVAL_SPI_FLASH_Private_Function_Prototypes
   * @{
   */ 
+static void sFLASH_SendAddress(uint32_t Addr);
+static void sFLASH_DMATransfer(const uint8_t* pTxBuffer, uint8_t* pRxBuffer, uint16_t NumByte);
+static void sFLASH_StartOperation(void);
+static void sFLASH_EndOperation(void);
+static void sFLASH_FlushQueue(void);
+static sFLASH_Operation_TypeDef* sFLASH_GetFreeOperation(void);
+static void sFLASH_PushOperation(void);
+static void sFLASH_ApplyQueue(uint8_t* pBuffer, uint32_t ReadAddr, uint16_t NumByteToRead);
+static uint8_t sFLASH_LogPageErased(uint32_t PageAddr, int16_t* pLast);
+static void sFLASH_LogQueuePage(void);
 /**
   * @}
   */ 
@@ -159,6 +203,10 @@ void sFLASH_Init(void)
   */
 void sFLASH_EraseSector(uint32_t SectorAddr)
 {
+  /*!< Complete the queued operations first */
+  sFLASH_BusLocked = 1;
+  sFLASH_FlushQueue();
+
   /*!< Send write enable instruction */
   sFLASH_WriteEnable();
 
@@ -178,6 +226,8 @@ void sFLASH_EraseSector(uint32_t SectorAddr)
 
   /*!< Wait the end of Flash writing */
   sFLASH_WaitForWriteEnd();
+
+  sFLASH_BusLocked = 0;
 }
 
 /**
@@ -187,6 +237,10 @@ void sFLASH_EraseSector(uint32_t SectorAddr)
   */
 void sFLASH_EraseBulk(void)
 {
+  /*!< Complete the queued operations first */
+  sFLASH_BusLocked = 1;
+  sFLASH_FlushQueue();
+
   /*!< Send write enable instruction */
   sFLASH_WriteEnable();
 
@@ -200,6 +254,8 @@ void sFLASH_EraseBulk(void)
 
   /*!< Wait the end of Flash writing */
   sFLASH_WaitForWriteEnd();
+
+  sFLASH_BusLocked = 0;
 }
 
 /**
@@ -215,6 +271,10 @@ void sFLASH_EraseBulk(void)
   */
 void sFLASH_WritePage(uint8_t* pBuffer, uint32_t WriteAddr, uint16_t NumByteToWrite)
 {
+  /*!< Complete the queued operations first */
+  sFLASH_BusLocked = 1;
+  sFLASH_FlushQueue();
+
   /*!< Enable the write access to the FLASH */
   sFLASH_WriteEnable();
 
@@ -229,20 +289,16 @@ void sFLASH_WritePage(uint8_t* pBuffer, uint32_t WriteAddr, uint16_t NumByteToWr
   /*!< Send WriteAddr low nibble address byte to write to */
   sFLASH_SendByte(WriteAddr & 0xFF);
 
-  /*!< while there is data to be written on the FLASH */
-  while (NumByteToWrite--)
-  {
-    /*!< Send the current byte */
-    sFLASH_SendByte(*pBuffer);
-    /*!< Point on the next byte to be written */
-    pBuffer++;
-  }
+  /*!< Send the data by DMA */
+  sFLASH_DMATransfer(pBuffer, 0, NumByteToWrite);
 
   /*!< Deselect the FLASH: Chip Select high */
   sFLASH_CS_HIGH();
 
   /*!< Wait the end of Flash writing */
   sFLASH_WaitForWriteEnd();
+
+  sFLASH_BusLocked = 0;
 }
 
 /**
@@ -327,6 +383,9 @@ void sFLASH_WriteBuffer(uint8_t* pBuffer, uint32_t WriteAddr, uint16_t NumByteTo
 
 /**
   * @brief  Reads a block of data from the FLASH.
+  * @note   The data of the operations still waiting in the queue is merged
+  *         into the buffer. An operation already sent to the FLASH is waited
+  *         for, as the FLASH can't be read during a program or erase cycle.
   * @param  pBuffer: pointer to the buffer that receives the data read from the FLASH.
   * @param  ReadAddr: FLASH's internal address to read from.
   * @param  NumByteToRead: number of bytes to read from the FLASH.
@@ -334,29 +393,319 @@ void sFLASH_WriteBuffer(uint8_t* pBuffer, uint32_t WriteAddr, uint16_t NumByteTo
   */
 void sFLASH_ReadBuffer(uint8_t* pBuffer, uint32_t ReadAddr, uint16_t NumByteToRead)
 {
+  /*!< Take the bus and let the operation in progress complete */
+  sFLASH_BusLocked = 1;
+  sFLASH_EndOperation();
+
   /*!< Select the FLASH: Chip Select low */
   sFLASH_CS_LOW();
 
-  /*!< Send "Read from Memory " instruction */
-  sFLASH_SendByte(sFLASH_CMD_READ);
+  /*!< Send "Read from Memory at higher speed" instruction */
+  sFLASH_SendByte(sFLASH_CMD_FAST_READ);
 
-  /*!< Send ReadAddr high nibble address byte to read from */
-  sFLASH_SendByte((ReadAddr & 0xFF0000) >> 16);
-  /*!< Send ReadAddr medium nibble address byte to read from */
-  sFLASH_SendByte((ReadAddr& 0xFF00) >> 8);
-  /*!< Send ReadAddr low nibble address byte to read from */
-  sFLASH_SendByte(ReadAddr & 0xFF);
+  /*!< Send ReadAddr, then the dummy byte that FAST_READ expects */
+  sFLASH_SendAddress(ReadAddr);
+  sFLASH_SendByte(sFLASH_DUMMY_BYTE);
 
-  while (NumByteToRead--) /*!< while there is data to be read */
-  {
-    /*!< Read a byte from the FLASH */
-    *pBuffer = sFLASH_SendByte(sFLASH_DUMMY_BYTE);
-    /*!< Point to the next location where the byte read will be saved */
-    pBuffer++;
-  }
+  /*!< Read the data by DMA */
+  sFLASH_DMATransfer(0, pBuffer, NumByteToRead);
 
   /*!< Deselect the FLASH: Chip Select high */
   sFLASH_CS_HIGH();
+
+  /*!< Merge the operations that are not in the FLASH yet */
+  sFLASH_ApplyQueue(pBuffer, ReadAddr, NumByteToRead);
+
+  sFLASH_BusLocked = 0;
+}
+
+/**
+  * @brief  Queues block of data to be written to the FLASH and returns as soon
+  *         as it has been copied. The data is split at page boundaries, one
+  *         queue entry per page; when the queue is full, this function waits
+  *         for the oldest entry to be written.
+  * @note   The area must have been erased, as with sFLASH_WriteBuffer().
+  * @param  pBuffer: pointer to the buffer  containing the data to be written
+  *         to the FLASH.
+  * @param  WriteAddr: FLASH's internal address to write to.
+  * @param  NumByteToWrite: number of bytes to write to the FLASH.
+  * @retval None
+  */
+void sFLASH_QueueWriteBuffer(uint8_t* pBuffer, uint32_t WriteAddr, uint32_t NumByteToWrite)
+{
+  sFLASH_Operation_TypeDef* pOperation;
+  uint32_t count = 0, i = 0;
+
+  while (NumByteToWrite > 0)
+  {
+    /*!< Up to the end of the page */
+    count = sFLASH_SPI_PAGESIZE - (WriteAddr % sFLASH_SPI_PAGESIZE);
+    if (count > NumByteToWrite)
+    {
+      count = NumByteToWrite;
+    }
+
+    pOperation = sFLASH_GetFreeOperation();
+    pOperation->Cmd = sFLASH_CMD_WRITE;
+    pOperation->Addr = WriteAddr;
+    pOperation->Length = count;
+    for (i = 0; i < count; i++)
+    {
+      pOperation->Data[i] = pBuffer[i];
+    }
+    sFLASH_PushOperation();
+
+    WriteAddr += count;
+    pBuffer += count;
+    NumByteToWrite -= count;
+  }
+}
+
+/**
+  * @brief  Queues the erase of the specified FLASH sector.
+  * @param  SectorAddr: address of the sector to erase.
+  * @retval None
+  */
+void sFLASH_QueueEraseSector(uint32_t SectorAddr)
+{
+  sFLASH_Operation_TypeDef* pOperation;
+
+  pOperation = sFLASH_GetFreeOperation();
+  pOperation->Cmd = sFLASH_CMD_SE;
+  pOperation->Addr = SectorAddr;
+  pOperation->Length = 0;
+  sFLASH_PushOperation();
+}
+
+/**
+  * @brief  Queues the erase of the entire FLASH.
+  * @param  None
+  * @retval None
+  */
+void sFLASH_QueueEraseBulk(void)
+{
+  sFLASH_Operation_TypeDef* pOperation;
+
+  pOperation = sFLASH_GetFreeOperation();
+  pOperation->Cmd = sFLASH_CMD_BE;
+  pOperation->Addr = 0;
+  pOperation->Length = 0;
+  sFLASH_PushOperation();
+}
+
+/**
+  * @brief  Checks whether queued operations remain.
+  * @param  None
+  * @retval SET while operations are queued or in progress, RESET otherwise.
+  */
+FlagStatus sFLASH_GetQueueStatus(void)
+{
+  return (sFLASH_QueueHead != sFLASH_QueueTail) ? SET : RESET;
+}
+
+/**
+  * @brief  Waits until every queued operation has been written to the FLASH.
+  * @param  None
+  * @retval None
+  */
+void sFLASH_WaitForQueueEnd(void)
+{
+  sFLASH_BusLocked = 1;
+  sFLASH_FlushQueue();
+  sFLASH_BusLocked = 0;
+}
+
+/**
+  * @brief  Advances the queue without waiting: reads the status register
+  *         once if an operation is in progress and, when the FLASH is ready,
+  *         sends the next queued operation.
+  * @note   To be called periodically, typically from a timer interrupt (a
+  *         page program takes about 1.4 ms). It returns at once while another
+  *         sFLASH function is using the SPI.
+  * @param  None
+  * @retval None
+  */
+void sFLASH_PollHandler(void)
+{
+  uint8_t flashstatus = 0;
+
+  if (sFLASH_BusLocked)
+  {
+    return;
+  }
+  sFLASH_BusLocked = 1;
+
+  if (sFLASH_Started)
+  {
+    /*!< Select the FLASH: Chip Select low */
+    sFLASH_CS_LOW();
+    /*!< Send "Read Status Register" instruction and read the status once */
+    sFLASH_SendByte(sFLASH_CMD_RDSR);
+    flashstatus = sFLASH_SendByte(sFLASH_DUMMY_BYTE);
+    /*!< Deselect the FLASH: Chip Select high */
+    sFLASH_CS_HIGH();
+
+    if ((flashstatus & sFLASH_WIP_FLAG) == SET)
+    {
+      /*!< Write in progress, try again on the next call */
+      sFLASH_BusLocked = 0;
+      return;
+    }
+    sFLASH_Started = 0;
+    sFLASH_QueueTail++;
+  }
+
+  if (sFLASH_QueueTail != sFLASH_QueueHead)
+  {
+    sFLASH_StartOperation();
+  }
+
+  sFLASH_BusLocked = 0;
+}
+
+/**
+  * @brief  Opens the append log in the given FLASH area and looks for the end
+  *         of the records already written there.
+  * @note   The log is written in order, so its end is found by bisection on
+  *         erased pages: records must not end with 0xFF and must not contain
+  *         a whole page of 0xFF.
+  * @param  StartAddr: first address of the log area, sector aligned.
+  * @param  Size: size of the log area, a multiple of the sector size.
+  * @retval sFLASH_OK (0) if the area is valid, sFLASH_FAIL (1) otherwise.
+  */
+uint32_t sFLASH_LogInit(uint32_t StartAddr, uint32_t Size)
+{
+  uint32_t low = 0, high = 0, middle = 0;
+  int16_t last = 0;
+
+  if ((((StartAddr | Size) & (sFLASH_SPI_SECTORSIZE - 1)) != 0) || (Size == 0) ||
+      (StartAddr >= sFLASH_SPI_FLASHSIZE) || (Size > sFLASH_SPI_FLASHSIZE - StartAddr))
+  {
+    return sFLASH_FAIL;
+  }
+  sFLASH_LogStart = StartAddr;
+  sFLASH_LogEnd = StartAddr + Size;
+
+  /*!< Look for the first erased page */
+  high = Size / sFLASH_SPI_PAGESIZE;
+  while (low < high)
+  {
+    middle = (low + high) / 2;
+    if (sFLASH_LogPageErased(StartAddr + middle * sFLASH_SPI_PAGESIZE, &last))
+    {
+      high = middle;
+    }
+    else
+    {
+      low = middle + 1;
+    }
+  }
+
+  sFLASH_LogPage = StartAddr + low * sFLASH_SPI_PAGESIZE;
+  sFLASH_LogFill = 0;
+  if (low > 0)
+  {
+    /*!< Go on in the last written page if it has room left */
+    sFLASH_LogPageErased(sFLASH_LogPage - sFLASH_SPI_PAGESIZE, &last);
+    if (last < sFLASH_SPI_PAGESIZE - 1)
+    {
+      sFLASH_LogPage -= sFLASH_SPI_PAGESIZE;
+      sFLASH_LogFill = last + 1;
+    }
+  }
+  sFLASH_LogDone = sFLASH_LogFill;
+
+  /*!< The rest of a sector already written to is still erased */
+  sFLASH_LogErased = sFLASH_LogPage;
+  if ((sFLASH_LogFill != 0) || ((sFLASH_LogPage & (sFLASH_SPI_SECTORSIZE - 1)) != 0))
+  {
+    sFLASH_LogErased = (sFLASH_LogPage & ~(sFLASH_SPI_SECTORSIZE - 1)) + sFLASH_SPI_SECTORSIZE;
+  }
+
+  return sFLASH_OK;
+}
+
+/**
+  * @brief  Appends a record to the log. Records are gathered in RAM and
+  *         queued one full page at a time; each sector is erased just before
+  *         its first page is written.
+  * @param  pBuffer: pointer to the record.
+  * @param  NumByteToWrite: size of the record.
+  * @retval sFLASH_OK (0) if the record has been taken, sFLASH_FAIL (1) if the
+  *         log area is full.
+  */
+uint32_t sFLASH_LogAppend(uint8_t* pBuffer, uint32_t NumByteToWrite)
+{
+  uint32_t count = 0;
+
+  if (NumByteToWrite > sFLASH_LogEnd - sFLASH_LogPage - sFLASH_LogFill)
+  {
+    return sFLASH_FAIL;
+  }
+
+  while (NumByteToWrite > 0)
+  {
+    count = sFLASH_SPI_PAGESIZE - sFLASH_LogFill;
+    if (count > NumByteToWrite)
+    {
+      count = NumByteToWrite;
+    }
+    NumByteToWrite -= count;
+    while (count--)
+    {
+      sFLASH_LogBuffer[sFLASH_LogFill++] = *pBuffer++;
+    }
+
+    if (sFLASH_LogFill == sFLASH_SPI_PAGESIZE)
+    {
+      sFLASH_LogQueuePage();
+      sFLASH_LogPage += sFLASH_SPI_PAGESIZE;
+      sFLASH_LogFill = 0;
+      sFLASH_LogDone = 0;
+    }
+  }
+
+  return sFLASH_OK;
+}
+
+/**
+  * @brief  Queues the records of the page being filled. The rest of the page
+  *         stays in use: later records are programmed into it.
+  * @param  None
+  * @retval None
+  */
+void sFLASH_LogFlush(void)
+{
+  sFLASH_LogQueuePage();
+}
+
+/**
+  * @brief  Erases the log area and restarts the log at its beginning.
+  * @param  None
+  * @retval None
+  */
+void sFLASH_LogClear(void)
+{
+  uint32_t addr = 0;
+
+  for (addr = sFLASH_LogStart; addr < sFLASH_LogEnd; addr += sFLASH_SPI_SECTORSIZE)
+  {
+    sFLASH_QueueEraseSector(addr);
+  }
+  sFLASH_LogPage = sFLASH_LogStart;
+  sFLASH_LogFill = 0;
+  sFLASH_LogDone = 0;
+  sFLASH_LogErased = sFLASH_LogEnd;
+}
+
+/**
+  * @brief  Returns the number of bytes in the log.
+  * @param  None
+  * @retval Bytes appended since the start of the log area.
+  */
+uint32_t sFLASH_LogGetSize(void)
+{
+  return sFLASH_LogPage + sFLASH_LogFill - sFLASH_LogStart;
 }
 
 /**
@@ -518,6 +867,290 @@ void sFLASH_WaitForWriteEnd(void)
   sFLASH_CS_HIGH();
 }
 
+/**
+  * @brief  Sends the 24-bit address of a FLASH instruction.
+  * @param  Addr: FLASH's internal address.
+  * @retval None
+  */
+static void sFLASH_SendAddress(uint32_t Addr)
+{
+  /*!< Send Addr high nibble address byte */
+  sFLASH_SendByte((Addr & 0xFF0000) >> 16);
+  /*!< Send Addr medium nibble address byte */
+  sFLASH_SendByte((Addr & 0xFF00) >> 8);
+  /*!< Send Addr low nibble address byte */
+  sFLASH_SendByte(Addr & 0xFF);
+}
+
+/**
+  * @brief  Moves a block of data through the SPI by DMA and waits for the end
+  *         of the transfer. The FLASH must be selected.
+  * @param  pTxBuffer: bytes to send, or 0 to send dummy bytes.
+  * @param  pRxBuffer: buffer for the received bytes, or 0 to discard them.
+  * @param  NumByte: number of bytes to transfer.
+  * @retval None
+  */
+static void sFLASH_DMATransfer(const uint8_t* pTxBuffer, uint8_t* pRxBuffer, uint16_t NumByte)
+{
+  DMA_InitTypeDef DMA_InitStructure;
+
+  if (NumByte == 0)
+  {
+    return;
+  }
+
+  /*!< RX channel: drains every received byte so that none is lost */
+  DMA_DeInit(sFLASH_DMA_RX_CHANNEL);
+  DMA_InitStructure.DMA_PeripheralBaseAddr = sFLASH_SPI_DR;
+  if (pRxBuffer != 0)
+  {
+    DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)pRxBuffer;
+    DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+  }
+  else
+  {
+    DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)&sFLASH_DMASink;
+    DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Disable;
+  }
+  DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralSRC;
+  DMA_InitStructure.DMA_BufferSize = NumByte;
+  DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+  DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Byte;
+  DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_Byte;
+  DMA_InitStructure.DMA_Mode = DMA_Mode_Normal;
+  DMA_InitStructure.DMA_Priority = DMA_Priority_VeryHigh;
+  DMA_InitStructure.DMA_M2M = DMA_M2M_Disable;
+  DMA_Init(sFLASH_DMA_RX_CHANNEL, &DMA_InitStructure);
+
+  /*!< TX channel: sends the buffer or repeats the dummy byte */
+  DMA_DeInit(sFLASH_DMA_TX_CHANNEL);
+  if (pTxBuffer != 0)
+  {
+    DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)pTxBuffer;
+    DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+  }
+  else
+  {
+    DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)&sFLASH_DMADummy;
+    DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Disable;
+  }
+  DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralDST;
+  DMA_InitStructure.DMA_Priority = DMA_Priority_High;
+  DMA_Init(sFLASH_DMA_TX_CHANNEL, &DMA_InitStructure);
+
+  DMA_Cmd(sFLASH_DMA_RX_CHANNEL, ENABLE);
+  DMA_Cmd(sFLASH_DMA_TX_CHANNEL, ENABLE);
+  SPI_I2S_DMACmd(sFLASH_SPI, SPI_I2S_DMAReq_Rx | SPI_I2S_DMAReq_Tx, ENABLE);
+
+  /*!< The last byte has been clocked in when the RX channel completes */
+  while (DMA_GetFlagStatus(sFLASH_DMA_RX_FLAG_TC) == RESET)
+  {
+  }
+
+  SPI_I2S_DMACmd(sFLASH_SPI, SPI_I2S_DMAReq_Rx | SPI_I2S_DMAReq_Tx, DISABLE);
+  DMA_Cmd(sFLASH_DMA_TX_CHANNEL, DISABLE);
+  DMA_Cmd(sFLASH_DMA_RX_CHANNEL, DISABLE);
+  DMA_ClearFlag(sFLASH_DMA_RX_FLAG_GL | sFLASH_DMA_TX_FLAG_GL);
+}
+
+/**
+  * @brief  Sends the oldest queued operation to the FLASH. The bus must be
+  *         locked and the queue not empty.
+  * @param  None
+  * @retval None
+  */
+static void sFLASH_StartOperation(void)
+{
+  sFLASH_Operation_TypeDef* pOperation = &sFLASH_Queue[sFLASH_QueueTail & sFLASH_QUEUE_MASK];
+
+  /*!< Enable the write access to the FLASH */
+  sFLASH_WriteEnable();
+
+  /*!< Select the FLASH: Chip Select low */
+  sFLASH_CS_LOW();
+  /*!< Send the instruction, its address and the data to program */
+  sFLASH_SendByte(pOperation->Cmd);
+  if (pOperation->Cmd != sFLASH_CMD_BE)
+  {
+    sFLASH_SendAddress(pOperation->Addr);
+  }
+  if (pOperation->Cmd == sFLASH_CMD_WRITE)
+  {
+    sFLASH_DMATransfer(pOperation->Data, 0, pOperation->Length);
+  }
+  /*!< Deselect the FLASH: Chip Select high, the FLASH starts its cycle */
+  sFLASH_CS_HIGH();
+
+  sFLASH_Started = 1;
+}
+
+/**
+  * @brief  Waits for the operation sent to the FLASH, if any, and removes it
+  *         from the queue. The bus must be locked.
+  * @param  None
+  * @retval None
+  */
+static void sFLASH_EndOperation(void)
+{
+  if (sFLASH_Started)
+  {
+    sFLASH_WaitForWriteEnd();
+    sFLASH_Started = 0;
+    sFLASH_QueueTail++;
+  }
+}
+
+/**
+  * @brief  Writes every queued operation to the FLASH. The bus must be locked.
+  * @param  None
+  * @retval None
+  */
+static void sFLASH_FlushQueue(void)
+{
+  sFLASH_EndOperation();
+  while (sFLASH_QueueTail != sFLASH_QueueHead)
+  {
+    sFLASH_StartOperation();
+    sFLASH_EndOperation();
+  }
+}
+
+/**
+  * @brief  Returns the next free queue entry, first waiting for the oldest
+  *         operation if the queue is full.
+  * @param  None
+  * @retval Queue entry to fill before calling sFLASH_PushOperation().
+  */
+static sFLASH_Operation_TypeDef* sFLASH_GetFreeOperation(void)
+{
+  sFLASH_BusLocked = 1;
+  if ((uint8_t)(sFLASH_QueueHead - sFLASH_QueueTail) == sFLASH_QUEUE_DEPTH)
+  {
+    if (!sFLASH_Started)
+    {
+      sFLASH_StartOperation();
+    }
+    sFLASH_EndOperation();
+  }
+  sFLASH_BusLocked = 0;
+
+  return &sFLASH_Queue[sFLASH_QueueHead & sFLASH_QUEUE_MASK];
+}
+
+/**
+  * @brief  Adds the entry returned by sFLASH_GetFreeOperation() to the queue
+  *         and starts it at once if the FLASH is idle.
+  * @param  None
+  * @retval None
+  */
+static void sFLASH_PushOperation(void)
+{
+  sFLASH_QueueHead++;
+  sFLASH_PollHandler();
+}
+
+/**
+  * @brief  Applies the queued operations to data read from the FLASH: a
+  *         program clears bits, an erase sets the bytes to 0xFF.
+  * @param  pBuffer: data read from the FLASH.
+  * @param  ReadAddr: FLASH's internal address the data was read from.
+  * @param  NumByteToRead: number of bytes read.
+  * @retval None
+  */
+static void sFLASH_ApplyQueue(uint8_t* pBuffer, uint32_t ReadAddr, uint16_t NumByteToRead)
+{
+  sFLASH_Operation_TypeDef* pOperation;
+  uint32_t start = 0, end = 0, addr = 0;
+  uint8_t index = 0;
+
+  for (index = sFLASH_QueueTail; index != sFLASH_QueueHead; index++)
+  {
+    pOperation = &sFLASH_Queue[index & sFLASH_QUEUE_MASK];
+
+    if (pOperation->Cmd == sFLASH_CMD_WRITE)
+    {
+      start = pOperation->Addr;
+      end = start + pOperation->Length;
+    }
+    else if (pOperation->Cmd == sFLASH_CMD_SE)
+    {
+      start = pOperation->Addr & ~(sFLASH_SPI_SECTORSIZE - 1);
+      end = start + sFLASH_SPI_SECTORSIZE;
+    }
+    else
+    {
+      start = 0;
+      end = sFLASH_SPI_FLASHSIZE;
+    }
+
+    /*!< Part of the operation inside the buffer */
+    if (start < ReadAddr)
+    {
+      start = ReadAddr;
+    }
+    if (end > ReadAddr + NumByteToRead)
+    {
+      end = ReadAddr + NumByteToRead;
+    }
+
+    for (addr = start; addr < end; addr++)
+    {
+      if (pOperation->Cmd == sFLASH_CMD_WRITE)
+      {
+        pBuffer[addr - ReadAddr] &= pOperation->Data[addr - pOperation->Addr];
+      }
+      else
+      {
+        pBuffer[addr - ReadAddr] = 0xFF;
+      }
+    }
+  }
+}
+
+/**
+  * @brief  Checks whether a page of the log area is erased.
+  * @param  PageAddr: address of the page.
+  * @param  pLast: receives the offset of the last byte of the page that is
+  *         not 0xFF, -1 if the page is erased.
+  * @retval 1 if the page is erased, 0 otherwise.
+  */
+static uint8_t sFLASH_LogPageErased(uint32_t PageAddr, int16_t* pLast)
+{
+  uint8_t page[sFLASH_SPI_PAGESIZE];
+  int16_t last = sFLASH_SPI_PAGESIZE - 1;
+
+  sFLASH_ReadBuffer(page, PageAddr, sFLASH_SPI_PAGESIZE);
+  while ((last >= 0) && (page[last] == 0xFF))
+  {
+    last--;
+  }
+  *pLast = last;
+
+  return (last < 0);
+}
+
+/**
+  * @brief  Queues the bytes of the log page not queued yet, after the erase
+  *         of its sector if the page is the first one used in that sector.
+  * @param  None
+  * @retval None
+  */
+static void sFLASH_LogQueuePage(void)
+{
+  if (sFLASH_LogDone == sFLASH_LogFill)
+  {
+    return;
+  }
+  if (sFLASH_LogPage >= sFLASH_LogErased)
+  {
+    sFLASH_QueueEraseSector(sFLASH_LogPage);
+    sFLASH_LogErased = (sFLASH_LogPage & ~(sFLASH_SPI_SECTORSIZE - 1)) + sFLASH_SPI_SECTORSIZE;
+  }
+  sFLASH_QueueWriteBuffer(&sFLASH_LogBuffer[sFLASH_LogDone], sFLASH_LogPage + sFLASH_LogDone,
+                          sFLASH_LogFill - sFLASH_LogDone);
+  sFLASH_LogDone = sFLASH_LogFill;
+}
+
 /**
   * @}
   */
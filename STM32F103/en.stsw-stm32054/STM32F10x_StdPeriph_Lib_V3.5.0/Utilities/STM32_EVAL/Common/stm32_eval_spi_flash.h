@@ -64,6 +64,7 @@
 #define sFLASH_CMD_WRSR           0x01  /*!< Write Status Register instruction */
 #define sFLASH_CMD_WREN           0x06  /*!< Write enable instruction */
 #define sFLASH_CMD_READ           0x03  /*!< Read from Memory instruction */
+#define sFLASH_CMD_FAST_READ      0x0B  /*!< Read from Memory at higher speed instruction */
 #define sFLASH_CMD_RDSR           0x05  /*!< Read Status Register instruction  */
 #define sFLASH_CMD_RDID           0x9F  /*!< Read identification */
 #define sFLASH_CMD_SE             0xD8  /*!< Sector Erase instruction */
@@ -76,6 +77,18 @@
 
 #define sFLASH_M25P128_ID         0x202018
 #define sFLASH_M25P64_ID          0x202017
+
+#define sFLASH_OK                 0
+#define sFLASH_FAIL               1
+
+/**
+  * @brief  Number of page program / erase operations that can wait in the
+  *         queue fed by sFLASH_QueueWriteBuffer() and sFLASH_QueueEraseSector().
+  *         Each entry holds one page of data. Must be a power of 2.
+  */
+#ifndef sFLASH_QUEUE_DEPTH
+ #define sFLASH_QUEUE_DEPTH       4
+#endif
   
 /**
   * @}
@@ -114,6 +127,25 @@ void sFLASH_ReadBuffer(uint8_t* pBuffer, uint32_t ReadAddr, uint16_t NumByteToRe
 uint32_t sFLASH_ReadID(void);
 void sFLASH_StartReadSequence(uint32_t ReadAddr);
 
+/**
+  * @brief  Queued write/erase functions
+  */
+void sFLASH_QueueWriteBuffer(uint8_t* pBuffer, uint32_t WriteAddr, uint32_t NumByteToWrite);
+void sFLASH_QueueEraseSector(uint32_t SectorAddr);
+void sFLASH_QueueEraseBulk(void);
+FlagStatus sFLASH_GetQueueStatus(void);
+void sFLASH_WaitForQueueEnd(void);
+void sFLASH_PollHandler(void);
+
+/**
+  * @brief  Append log functions
+  */
+uint32_t sFLASH_LogInit(uint32_t StartAddr, uint32_t Size);
+uint32_t sFLASH_LogAppend(uint8_t* pBuffer, uint32_t NumByteToWrite);
+void sFLASH_LogFlush(void);
+void sFLASH_LogClear(void);
+uint32_t sFLASH_LogGetSize(void);
+
 /**
   * @brief  Low layer functions
   */
@@ -15,6 +15,19 @@
   *          You can easily tailor this driver to any other development board, 
   *          by just adapting the defines for hardware resources and 
   *          SD_LowLevel_Init() function.
+  *
+  *          Block data is moved by DMA (SD_DMA_RX_CHANNEL/SD_DMA_TX_CHANNEL)
+  *          and its CRC16 is computed by the CPU while the DMA runs, so the
+  *          check costs no bus time. SD_ReadMultiBlocks() streams the whole
+  *          run with one CMD18, and SD_WriteMultiBlocks() announces the run
+  *          length with ACMD23, so that the card can pre-erase it, before
+  *          streaming it with one CMD25.
+  *          The card only checks the CRCs once CMD59 enables it, which this
+  *          driver does not send since its commands carry a dummy CRC: the
+  *          CRC of read blocks is checked here, the one of written blocks is
+  *          sent correct anyway.
+  *          The bytes polled while waiting for the card are accumulated per
+  *          command phase, see SD_GetLatency().
   *            
   *          +-------------------------------------------------------+
   *          |                     Pin assignment                    |
@@ -89,6 +102,49 @@
 /** @defgroup STM32_EVAL_SPI_SD_Private_Variables
   * @{
   */ 
+/**
+  * @brief  CRC16-CCITT (polynomial 0x1021) of the data blocks, one byte at a
+  *         time
+  */
+static const uint16_t SD_CRC16Table[256] =
+{
+  0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+  0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+  0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
+  0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
+  0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485,
+  0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
+  0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
+  0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
+  0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
+  0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
+  0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12,
+  0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
+  0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41,
+  0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
+  0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
+  0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
+  0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F,
+  0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+  0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E,
+  0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
+  0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
+  0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+  0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C,
+  0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
+  0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB,
+  0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
+  0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
+  0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
+  0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9,
+  0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
+  0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
+  0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0
+};
+
+static const uint8_t SD_DMADummy = SD_DUMMY_BYTE;
+static uint8_t SD_DMASink;
+static SD_Latency SD_LatencyStats;
 /**
   * @}
   */ 
@@ -97,6 +153,10 @@
 /** @defgroup STM32_EVAL_SPI_SD_Private_Function_Prototypes
   * @{
   */
+static uint16_t SD_DMATransfer(const uint8_t* pTxBuffer, uint8_t* pRxBuffer, uint16_t NumByte);
+static uint8_t SD_GetR1(void);
+static uint32_t SD_WaitReady(void);
+static void SD_UpdateLatency(SD_LatencyStat* Stat, uint32_t Sample);
 /**
   * @}
   */ 
@@ -130,6 +190,8 @@ SD_Error SD_Init(void)
   /*!< Initialize SD_SPI */
   SD_LowLevel_Init(); 
 
+  SD_ResetLatency();
+
   /*!< SD chip select high */
   SD_CS_HIGH();
 
@@ -192,12 +254,12 @@ SD_Error SD_GetCardInfo(SD_CardInfo *cardinfo)
   * @param  ReadAddr: SD's internal address to read from.
   * @param  BlockSize: the SD card Data block size.
   * @retval The SD Response:
-  *         - SD_RESPONSE_FAILURE: Sequence failed
+  *         - SD_RESPONSE_FAILURE: Sequence failed or CRC mismatch
   *         - SD_RESPONSE_NO_ERROR: Sequence succeed
   */
 SD_Error SD_ReadBlock(uint8_t* pBuffer, uint32_t ReadAddr, uint16_t BlockSize)
 {
-  uint32_t i = 0;
+  uint16_t Crc = 0;
   SD_Error rvalue = SD_RESPONSE_FAILURE;
 
   /*!< SD chip select low */
@@ -212,20 +274,16 @@ SD_Error SD_ReadBlock(uint8_t* pBuffer, uint32_t ReadAddr, uint16_t BlockSize)
     /*!< Now look for the data token to signify the start of the data */
     if (!SD_GetResponse(SD_START_DATA_SINGLE_BLOCK_READ))
     {
-      /*!< Read the SD block data : read NumByteToRead data */
-      for (i = 0; i < BlockSize; i++)
+      /*!< Read the SD block data by DMA, its CRC16 is computed meanwhile */
+      Crc = SD_DMATransfer(0, pBuffer, BlockSize);
+      /*!< Get CRC bytes and check them against the computed CRC16 */
+      Crc ^= (uint16_t)(SD_ReadByte() << 8);
+      Crc ^= SD_ReadByte();
+      if (Crc == 0)
       {
-        /*!< Save the received data */
-        *pBuffer = SD_ReadByte();
-       
-        /*!< Point to the next location where the byte read will be saved */
-        pBuffer++;
+        /*!< Set response value to success */
+        rvalue = SD_RESPONSE_NO_ERROR;
       }
-      /*!< Get CRC bytes (not really needed by us, but required by SD) */
-      SD_ReadByte();
-      SD_ReadByte();
-      /*!< Set response value to success */
-      rvalue = SD_RESPONSE_NO_ERROR;
     }
   }
   /*!< SD chip select high */
@@ -240,56 +298,65 @@ SD_Error SD_ReadBlock(uint8_t* pBuffer, uint32_t ReadAddr, uint16_t BlockSize)
 
 /**
   * @brief  Reads multiple block of data from the SD.
+  *         The blocks are streamed with one CMD18 and the transmission is
+  *         stopped with CMD12 after the last one.
   * @param  pBuffer: pointer to the buffer that receives the data read from the 
   *                  SD.
   * @param  ReadAddr: SD's internal address to read from.
   * @param  BlockSize: the SD card Data block size.
   * @param  NumberOfBlocks: number of blocks to be read.
   * @retval The SD Response:
-  *         - SD_RESPONSE_FAILURE: Sequence failed
+  *         - SD_RESPONSE_FAILURE: Sequence failed or CRC mismatch
   *         - SD_RESPONSE_NO_ERROR: Sequence succeed
   */
 SD_Error SD_ReadMultiBlocks(uint8_t* pBuffer, uint32_t ReadAddr, uint16_t BlockSize, uint32_t NumberOfBlocks)
 {
-  uint32_t i = 0, Offset = 0;
+  uint16_t Crc = 0;
   SD_Error rvalue = SD_RESPONSE_FAILURE;
   
   /*!< SD chip select low */
   SD_CS_LOW();
-  /*!< Data transfer */
-  while (NumberOfBlocks--)
+
+  /*!< Send CMD18 (SD_CMD_READ_MULT_BLOCK) to read the blocks */
+  SD_SendCmd(SD_CMD_READ_MULT_BLOCK, ReadAddr, 0xFF);
+
+  /*!< Check if the SD acknowledged the read command: R1 response (0x00: no errors) */
+  if (!SD_GetResponse(SD_RESPONSE_NO_ERROR))
   {
-    /*!< Send CMD17 (SD_CMD_READ_SINGLE_BLOCK) to read one block */
-    SD_SendCmd (SD_CMD_READ_SINGLE_BLOCK, ReadAddr + Offset, 0xFF);
-    /*!< Check if the SD acknowledged the read block command: R1 response (0x00: no errors) */
-    if (SD_GetResponse(SD_RESPONSE_NO_ERROR))
-    {
-      return  SD_RESPONSE_FAILURE;
-    }
-    /*!< Now look for the data token to signify the start of the data */
-    if (!SD_GetResponse(SD_START_DATA_SINGLE_BLOCK_READ))
+    rvalue = SD_RESPONSE_NO_ERROR;
+
+    /*!< Data transfer */
+    while (NumberOfBlocks--)
     {
-      /*!< Read the SD block data : read NumByteToRead data */
-      for (i = 0; i < BlockSize; i++)
+      /*!< Now look for the data token to signify the start of the data */
+      if (SD_GetResponse(SD_START_DATA_MULTIPLE_BLOCK_READ))
       {
-        /*!< Read the pointed data */
-        *pBuffer = SD_ReadByte();
-        /*!< Point to the next location where the byte read will be saved */
-        pBuffer++;
+        rvalue = SD_RESPONSE_FAILURE;
+        break;
       }
-      /*!< Set next read address*/
-      Offset += 512;
-      /*!< get CRC bytes (not really needed by us, but required by SD) */
-      SD_ReadByte();
-      SD_ReadByte();
-      /*!< Set response value to success */
-      rvalue = SD_RESPONSE_NO_ERROR;
+      /*!< Read the SD block data by DMA, its CRC16 is computed meanwhile */
+      Crc = SD_DMATransfer(0, pBuffer, BlockSize);
+      /*!< Get CRC bytes and check them against the computed CRC16 */
+      Crc ^= (uint16_t)(SD_ReadByte() << 8);
+      Crc ^= SD_ReadByte();
+      if (Crc != 0)
+      {
+        rvalue = SD_RESPONSE_FAILURE;
+        break;
+      }
+      /*!< Point to the next block */
+      pBuffer += BlockSize;
     }
-    else
+
+    /*!< Send CMD12 (SD_CMD_STOP_TRANSMISSION), skip the stuff byte and
+         wait for the R1 response and the end of the busy state */
+    SD_SendCmd(SD_CMD_STOP_TRANSMISSION, 0, 0xFF);
+    SD_ReadByte();
+    if (SD_GetR1() != SD_RESPONSE_NO_ERROR)
     {
-      /*!< Set response value to failure */
       rvalue = SD_RESPONSE_FAILURE;
     }
+    SD_WaitReady();
   }
   /*!< SD chip select high */
   SD_CS_HIGH();
@@ -311,13 +378,13 @@ SD_Error SD_ReadMultiBlocks(uint8_t* pBuffer, uint32_t ReadAddr, uint16_t BlockS
   */
 SD_Error SD_WriteBlock(uint8_t* pBuffer, uint32_t WriteAddr, uint16_t BlockSize)
 {
-  uint32_t i = 0;
+  uint16_t Crc = 0;
   SD_Error rvalue = SD_RESPONSE_FAILURE;
 
   /*!< SD chip select low */
   SD_CS_LOW();
 
-  /*!< Send CMD24 (SD_CMD_WRITE_SINGLE_BLOCK) to write multiple block */
+  /*!< Send CMD24 (SD_CMD_WRITE_SINGLE_BLOCK) to write one block */
   SD_SendCmd(SD_CMD_WRITE_SINGLE_BLOCK, WriteAddr, 0xFF);
   
   /*!< Check if the SD acknowledged the write block command: R1 response (0x00: no errors) */
@@ -327,19 +394,14 @@ SD_Error SD_WriteBlock(uint8_t* pBuffer, uint32_t WriteAddr, uint16_t BlockSize)
     SD_WriteByte(SD_DUMMY_BYTE);
 
     /*!< Send the data token to signify the start of the data */
-    SD_WriteByte(0xFE);
+    SD_WriteByte(SD_START_DATA_SINGLE_BLOCK_WRITE);
 
-    /*!< Write the block data to SD : write count data by block */
-    for (i = 0; i < BlockSize; i++)
-    {
-      /*!< Send the pointed byte */
-      SD_WriteByte(*pBuffer);
-      /*!< Point to the next location where the byte read will be saved */
-      pBuffer++;
-    }
-    /*!< Put CRC bytes (not really needed by us, but required by SD) */
-    SD_ReadByte();
-    SD_ReadByte();
+    /*!< Write the block data by DMA, its CRC16 is computed meanwhile */
+    Crc = SD_DMATransfer(pBuffer, 0, BlockSize);
+
+    /*!< Put CRC bytes */
+    SD_WriteByte((uint8_t)(Crc >> 8));
+    SD_WriteByte((uint8_t)Crc);
 
     /*!< Read data response */
     if (SD_GetDataResponse() == SD_DATA_OK)
@@ -358,6 +420,10 @@ SD_Error SD_WriteBlock(uint8_t* pBuffer, uint32_t WriteAddr, uint16_t BlockSize)
 
 /**
   * @brief  Writes many blocks on the SD
+  *         The number of blocks is first given to the card with ACMD23 so
+  *         that it can pre-erase them, then the blocks are streamed with one
+  *         CMD25 and closed by the stop token. Cards that do not support
+  *         ACMD23 simply reject it.
   * @param  pBuffer: pointer to the buffer containing the data to be written on 
   *                  the SD.
   * @param  WriteAddr: address to write on.
@@ -369,49 +435,56 @@ SD_Error SD_WriteBlock(uint8_t* pBuffer, uint32_t WriteAddr, uint16_t BlockSize)
   */
 SD_Error SD_WriteMultiBlocks(uint8_t* pBuffer, uint32_t WriteAddr, uint16_t BlockSize, uint32_t NumberOfBlocks)
 {
-  uint32_t i = 0, Offset = 0;
+  uint16_t Crc = 0;
   SD_Error rvalue = SD_RESPONSE_FAILURE;
 
   /*!< SD chip select low */
   SD_CS_LOW();
-  /*!< Data transfer */
-  while (NumberOfBlocks--)
+
+  /*!< Send ACMD23 (SD_ACMD_SET_WR_BLK_ERASE_COUNT) with the number of blocks
+       to pre-erase, its R1 response is not checked */
+  SD_SendCmd(SD_CMD_APP_CMD, 0, 0xFF);
+  if (SD_GetR1() == SD_RESPONSE_NO_ERROR)
+  {
+    SD_SendCmd(SD_ACMD_SET_WR_BLK_ERASE_COUNT, NumberOfBlocks & 0x007FFFFF, 0xFF);
+    SD_GetR1();
+  }
+
+  /*!< Send CMD25 (SD_CMD_WRITE_MULT_BLOCK) to write the blocks */
+  SD_SendCmd(SD_CMD_WRITE_MULT_BLOCK, WriteAddr, 0xFF);
+
+  /*!< Check if the SD acknowledged the write command: R1 response (0x00: no errors) */
+  if (!SD_GetResponse(SD_RESPONSE_NO_ERROR))
   {
-    /*!< Send CMD24 (SD_CMD_WRITE_SINGLE_BLOCK) to write blocks */
-    SD_SendCmd(SD_CMD_WRITE_SINGLE_BLOCK, WriteAddr + Offset, 0xFF);
-    /*!< Check if the SD acknowledged the write block command: R1 response (0x00: no errors) */
-    if (SD_GetResponse(SD_RESPONSE_NO_ERROR))
+    rvalue = SD_RESPONSE_NO_ERROR;
+
+    /*!< Data transfer */
+    while (NumberOfBlocks--)
     {
-      return SD_RESPONSE_FAILURE;
+      /*!< Send dummy byte */
+      SD_WriteByte(SD_DUMMY_BYTE);
+      /*!< Send the data token to signify the start of the data */
+      SD_WriteByte(SD_START_DATA_MULTIPLE_BLOCK_WRITE);
+      /*!< Write the block data by DMA, its CRC16 is computed meanwhile */
+      Crc = SD_DMATransfer(pBuffer, 0, BlockSize);
+      /*!< Put CRC bytes */
+      SD_WriteByte((uint8_t)(Crc >> 8));
+      SD_WriteByte((uint8_t)Crc);
+      /*!< Read data response, it waits for the block to be programmed */
+      if (SD_GetDataResponse() != SD_DATA_OK)
+      {
+        rvalue = SD_RESPONSE_FAILURE;
+        break;
+      }
+      /*!< Point to the next block */
+      pBuffer += BlockSize;
     }
-    /*!< Send dummy byte */
+
+    /*!< Send the stop token, then wait for the end of the busy state that
+         follows one byte later */
+    SD_WriteByte(SD_STOP_DATA_MULTIPLE_BLOCK_WRITE);
     SD_WriteByte(SD_DUMMY_BYTE);
-    /*!< Send the data token to signify the start of the data */
-    SD_WriteByte(SD_START_DATA_SINGLE_BLOCK_WRITE);
-    /*!< Write the block data to SD : write count data by block */
-    for (i = 0; i < BlockSize; i++)
-    {
-      /*!< Send the pointed byte */
-      SD_WriteByte(*pBuffer);
-      /*!< Point to the next location where the byte read will be saved */
-      pBuffer++;
-    }
-    /*!< Set next write address */
-    Offset += 512;
-    /*!< Put CRC bytes (not really needed by us, but required by SD) */
-    SD_ReadByte();
-    SD_ReadByte();
-    /*!< Read data response */
-    if (SD_GetDataResponse() == SD_DATA_OK)
-    {
-      /*!< Set response value to success */
-      rvalue = SD_RESPONSE_NO_ERROR;
-    }
-    else
-    {
-      /*!< Set response value to failure */
-      rvalue = SD_RESPONSE_FAILURE;
-    }
+    SD_UpdateLatency(&SD_LatencyStats.WriteBusy, SD_WaitReady());
   }
   /*!< SD chip select high */
   SD_CS_HIGH();
@@ -716,7 +789,7 @@ uint8_t SD_GetDataResponse(void)
   }
 
   /*!< Wait null data */
-  while (SD_ReadByte() == 0);
+  SD_UpdateLatency(&SD_LatencyStats.WriteBusy, SD_WaitReady());
 
   /*!< Return response */
   return response;
@@ -738,6 +811,17 @@ SD_Error SD_GetResponse(uint8_t Response)
   {
     Count--;
   }
+
+  /*!< R1 responses are command latencies, data tokens are read accesses */
+  if ((Response == SD_RESPONSE_NO_ERROR) || (Response == SD_IN_IDLE_STATE))
+  {
+    SD_UpdateLatency(&SD_LatencyStats.Command, 0x1000 - Count);
+  }
+  else
+  {
+    SD_UpdateLatency(&SD_LatencyStats.ReadAccess, 0x1000 - Count);
+  }
+
   if (Count == 0)
   {
     /*!< After time out */
@@ -777,6 +861,30 @@ uint16_t SD_GetStatus(void)
   return Status;
 }
 
+/**
+  * @brief  Returns the latency statistics accumulated since SD_Init() or the
+  *         last SD_ResetLatency().
+  * @param  SD_latency: pointer to a SD_Latency structure that receives the
+  *         statistics, counted in bytes clocked on the SPI bus.
+  * @retval None
+  */
+void SD_GetLatency(SD_Latency* SD_latency)
+{
+  *SD_latency = SD_LatencyStats;
+}
+
+/**
+  * @brief  Clears the latency statistics.
+  * @param  None
+  * @retval None
+  */
+void SD_ResetLatency(void)
+{
+  SD_Latency Reset = {{0, 0, 0, 0}, {0, 0, 0, 0}, {0, 0, 0, 0}};
+
+  SD_LatencyStats = Reset;
+}
+
 /**
   * @brief  Put SD in Idle state.
   * @param  None
@@ -876,6 +984,154 @@ uint8_t SD_ReadByte(void)
   return Data;
 }
 
+/**
+  * @brief  Exchanges a data block by DMA and computes its CRC16 meanwhile.
+  * @param  pTxBuffer: data to send, or 0 to send dummy bytes.
+  * @param  pRxBuffer: buffer that receives the data, or 0 to drop it.
+  * @param  NumByte: number of bytes to exchange.
+  * @retval The CRC16 of the sent data, or of the received data when pTxBuffer
+  *         is 0.
+  */
+static uint16_t SD_DMATransfer(const uint8_t* pTxBuffer, uint8_t* pRxBuffer, uint16_t NumByte)
+{
+  DMA_InitTypeDef DMA_InitStructure;
+  const __IO uint8_t* pData;
+  uint16_t Crc = 0, Done = 0, Avail = NumByte;
+
+  if (NumByte == 0)
+  {
+    return 0;
+  }
+
+  /*!< RX channel: drains every received byte so that none is lost */
+  DMA_DeInit(SD_DMA_RX_CHANNEL);
+  DMA_InitStructure.DMA_PeripheralBaseAddr = SD_SPI_DR;
+  if (pRxBuffer != 0)
+  {
+    DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)pRxBuffer;
+    DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+  }
+  else
+  {
+    DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)&SD_DMASink;
+    DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Disable;
+  }
+  DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralSRC;
+  DMA_InitStructure.DMA_BufferSize = NumByte;
+  DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+  DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Byte;
+  DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_Byte;
+  DMA_InitStructure.DMA_Mode = DMA_Mode_Normal;
+  DMA_InitStructure.DMA_Priority = DMA_Priority_VeryHigh;
+  DMA_InitStructure.DMA_M2M = DMA_M2M_Disable;
+  DMA_Init(SD_DMA_RX_CHANNEL, &DMA_InitStructure);
+
+  /*!< TX channel: sends the buffer or repeats the dummy byte */
+  DMA_DeInit(SD_DMA_TX_CHANNEL);
+  if (pTxBuffer != 0)
+  {
+    DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)pTxBuffer;
+    DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+  }
+  else
+  {
+    DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)&SD_DMADummy;
+    DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Disable;
+  }
+  DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralDST;
+  DMA_InitStructure.DMA_Priority = DMA_Priority_High;
+  DMA_Init(SD_DMA_TX_CHANNEL, &DMA_InitStructure);
+
+  DMA_Cmd(SD_DMA_RX_CHANNEL, ENABLE);
+  DMA_Cmd(SD_DMA_TX_CHANNEL, ENABLE);
+  SPI_I2S_DMACmd(SD_SPI, SPI_I2S_DMAReq_Rx | SPI_I2S_DMAReq_Tx, ENABLE);
+
+  /*!< Compute the CRC16 while the block moves: the data to send is already
+       in memory, the received data is followed as the RX channel stores it */
+  pData = (pTxBuffer != 0) ? pTxBuffer : pRxBuffer;
+  while (Done < NumByte)
+  {
+    if (pTxBuffer == 0)
+    {
+      Avail = NumByte - DMA_GetCurrDataCounter(SD_DMA_RX_CHANNEL);
+    }
+    while (Done < Avail)
+    {
+      Crc = (uint16_t)(Crc << 8) ^ SD_CRC16Table[(uint8_t)(Crc >> 8) ^ pData[Done++]];
+    }
+  }
+
+  /*!< The last byte has been clocked in when the RX channel completes */
+  while (DMA_GetFlagStatus(SD_DMA_RX_FLAG_TC) == RESET)
+  {
+  }
+
+  SPI_I2S_DMACmd(SD_SPI, SPI_I2S_DMAReq_Rx | SPI_I2S_DMAReq_Tx, DISABLE);
+  DMA_Cmd(SD_DMA_TX_CHANNEL, DISABLE);
+  DMA_Cmd(SD_DMA_RX_CHANNEL, DISABLE);
+  DMA_ClearFlag(SD_DMA_RX_FLAG_GL | SD_DMA_TX_FLAG_GL);
+
+  return Crc;
+}
+
+/**
+  * @brief  Returns the first R1 response byte (bit 7 cleared) of a command.
+  * @param  None
+  * @retval The R1 response, or 0xFF if the card did not answer.
+  */
+static uint8_t SD_GetR1(void)
+{
+  uint32_t Count = 0;
+  uint8_t Response = SD_DUMMY_BYTE;
+
+  /*!< The card answers within 8 bytes */
+  do
+  {
+    Response = SD_ReadByte();
+    Count++;
+  }
+  while ((Response & 0x80) && (Count < 10));
+
+  SD_UpdateLatency(&SD_LatencyStats.Command, Count);
+
+  return Response;
+}
+
+/**
+  * @brief  Waits for the end of the busy state, the card holds the data line
+  *         low while it is programming.
+  * @param  None
+  * @retval Number of busy bytes read.
+  */
+static uint32_t SD_WaitReady(void)
+{
+  uint32_t Count = 0;
+
+  while (SD_ReadByte() == 0)
+  {
+    Count++;
+  }
+
+  return Count;
+}
+
+/**
+  * @brief  Adds a sample to a latency statistic.
+  * @param  Stat: statistic to update.
+  * @param  Sample: latency in bytes clocked on the SPI bus.
+  * @retval None
+  */
+static void SD_UpdateLatency(SD_LatencyStat* Stat, uint32_t Sample)
+{
+  Stat->Count++;
+  Stat->Last = Sample;
+  Stat->Total += Sample;
+  if (Sample > Stat->Max)
+  {
+    Stat->Max = Sample;
+  }
+}
+
 /**
   * @}
   */
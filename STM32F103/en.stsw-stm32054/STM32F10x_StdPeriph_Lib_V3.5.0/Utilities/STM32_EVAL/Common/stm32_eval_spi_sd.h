@@ -147,6 +147,29 @@ typedef struct
   uint32_t CardBlockSize; /*!< Card Block Size */
 } SD_CardInfo;
 
+/** 
+  * @brief  Latency of one kind of command phase, counted in bytes clocked on
+  *         the SPI bus while the driver polls the card (one byte lasts 8 SPI
+  *         clock periods).
+  */
+typedef struct
+{
+  uint32_t Count;  /*!< Number of samples */
+  uint32_t Last;   /*!< Last sample */
+  uint32_t Total;  /*!< Sum of the samples */
+  uint32_t Max;    /*!< Longest sample */
+} SD_LatencyStat;
+
+/** 
+  * @brief SD Card latency statistics
+  */
+typedef struct
+{
+  SD_LatencyStat Command;    /*!< Command frame to R1 response */
+  SD_LatencyStat ReadAccess; /*!< R1 response or previous block to the data token */
+  SD_LatencyStat WriteBusy;  /*!< Data response or stop token to the end of programming */
+} SD_Latency;
+
 /**
   * @}
   */
@@ -173,7 +196,7 @@ typedef struct
 #define SD_START_DATA_SINGLE_BLOCK_READ    0xFE  /*!< Data token start byte, Start Single Block Read */
 #define SD_START_DATA_MULTIPLE_BLOCK_READ  0xFE  /*!< Data token start byte, Start Multiple Block Read */
 #define SD_START_DATA_SINGLE_BLOCK_WRITE   0xFE  /*!< Data token start byte, Start Single Block Write */
-#define SD_START_DATA_MULTIPLE_BLOCK_WRITE 0xFD  /*!< Data token start byte, Start Multiple Block Write */
+#define SD_START_DATA_MULTIPLE_BLOCK_WRITE 0xFC  /*!< Data token start byte, Start Multiple Block Write */
 #define SD_STOP_DATA_MULTIPLE_BLOCK_WRITE  0xFD  /*!< Data toke stop byte, Stop Multiple Block Write */
 
 /**
@@ -209,6 +232,12 @@ typedef struct
 #define SD_CMD_ERASE_GRP_END          36  /*!< CMD36 = 0x64 */
 #define SD_CMD_UNTAG_ERASE_GROUP      37  /*!< CMD37 = 0x65 */
 #define SD_CMD_ERASE                  38  /*!< CMD38 = 0x66 */
+#define SD_CMD_APP_CMD                55  /*!< CMD55 = 0x77 */
+
+/**
+  * @brief  Application specific commands, sent after SD_CMD_APP_CMD
+  */
+#define SD_ACMD_SET_WR_BLK_ERASE_COUNT 23 /*!< ACMD23 = 0x57 */
 
 /**
   * @}
@@ -248,6 +277,8 @@ SD_Error SD_GetResponse(uint8_t Response);
 uint8_t SD_GetDataResponse(void);
 SD_Error SD_GoIdleState(void);
 uint16_t SD_GetStatus(void);
+void SD_GetLatency(SD_Latency* SD_latency);
+void SD_ResetLatency(void);
 
 uint8_t SD_WriteByte(uint8_t byte);
 uint8_t SD_ReadByte(void);
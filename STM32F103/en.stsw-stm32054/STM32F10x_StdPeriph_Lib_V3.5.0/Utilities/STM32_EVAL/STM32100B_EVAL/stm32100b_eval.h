@@ -230,6 +230,15 @@
 #define SD_DETECT_GPIO_PORT              GPIOE                       /* GPIOE */
 #define SD_DETECT_GPIO_CLK               RCC_APB2Periph_GPIOE
 
+#define SD_SPI_DR                        ((uint32_t)0x4001300C)
+
+#define SD_DMA_CLK                       RCC_AHBPeriph_DMA1
+#define SD_DMA_RX_CHANNEL                DMA1_Channel2
+#define SD_DMA_TX_CHANNEL                DMA1_Channel3
+#define SD_DMA_RX_FLAG_TC                DMA1_FLAG_TC2
+#define SD_DMA_RX_FLAG_GL                DMA1_FLAG_GL2
+#define SD_DMA_TX_FLAG_GL                DMA1_FLAG_GL3
+
 /**
   * @}
   */
@@ -255,6 +264,17 @@
 #define sFLASH_CS_GPIO_PORT              GPIOD                       /* GPIOD */
 #define sFLASH_CS_GPIO_CLK               RCC_APB2Periph_GPIOD
 
+#define sFLASH_SPI_DR                    ((uint32_t)0x4001300C)
+#define sFLASH_SPI_FLASHSIZE             ((uint32_t)0x01000000)      /* M25P128: 16 MByte */
+#define sFLASH_SPI_SECTORSIZE            ((uint32_t)0x00040000)      /* 256 KByte sectors */
+
+#define sFLASH_DMA_CLK                   RCC_AHBPeriph_DMA1
+#define sFLASH_DMA_RX_CHANNEL            DMA1_Channel2
+#define sFLASH_DMA_TX_CHANNEL            DMA1_Channel3
+#define sFLASH_DMA_RX_FLAG_TC            DMA1_FLAG_TC2
+#define sFLASH_DMA_RX_FLAG_GL            DMA1_FLAG_GL2
+#define sFLASH_DMA_TX_FLAG_GL            DMA1_FLAG_GL3
+
 /**
   * @}
   */
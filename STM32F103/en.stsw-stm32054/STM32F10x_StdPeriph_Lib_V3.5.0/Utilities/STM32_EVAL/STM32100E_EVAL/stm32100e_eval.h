@@ -231,6 +231,15 @@
 #define SD_DETECT_GPIO_PORT              GPIOF                       /* GPIOF */
 #define SD_DETECT_GPIO_CLK               RCC_APB2Periph_GPIOF
 
+#define SD_SPI_DR                        ((uint32_t)0x4000380C)
+
+#define SD_DMA_CLK                       RCC_AHBPeriph_DMA1  /* shared with sEE, LM75 and IOE, not at the same time */
+#define SD_DMA_RX_CHANNEL                DMA1_Channel4
+#define SD_DMA_TX_CHANNEL                DMA1_Channel5
+#define SD_DMA_RX_FLAG_TC                DMA1_FLAG_TC4
+#define SD_DMA_RX_FLAG_GL                DMA1_FLAG_GL4
+#define SD_DMA_TX_FLAG_GL                DMA1_FLAG_GL5
+
 /**
   * @}
   */
@@ -302,6 +311,17 @@
 #define sFLASH_CS_GPIO_PORT              GPIOE                       /* GPIOE */
 #define sFLASH_CS_GPIO_CLK               RCC_APB2Periph_GPIOE
 
+#define sFLASH_SPI_DR                    ((uint32_t)0x4001300C)
+#define sFLASH_SPI_FLASHSIZE             ((uint32_t)0x01000000)      /* M25P128: 16 MByte */
+#define sFLASH_SPI_SECTORSIZE            ((uint32_t)0x00040000)      /* 256 KByte sectors */
+
+#define sFLASH_DMA_CLK                   RCC_AHBPeriph_DMA1
+#define sFLASH_DMA_RX_CHANNEL            DMA1_Channel2
+#define sFLASH_DMA_TX_CHANNEL            DMA1_Channel3
+#define sFLASH_DMA_RX_FLAG_TC            DMA1_FLAG_TC2
+#define sFLASH_DMA_RX_FLAG_GL            DMA1_FLAG_GL2
+#define sFLASH_DMA_TX_FLAG_GL            DMA1_FLAG_GL3
+
 /**
   * @}
   */
@@ -417,6 +417,9 @@ void SD_LowLevel_Init(void)
   /*!< SD_SPI Periph clock enable */
   RCC_APB2PeriphClockCmd(SD_SPI_CLK, ENABLE); 
 
+  /*!< SD DMA clock enable */
+  RCC_AHBPeriphClockCmd(SD_DMA_CLK, ENABLE);
+
   
   /*!< Configure SD_SPI pins: SCK */
   GPIO_InitStructure.GPIO_Pin = SD_SPI_SCK_PIN;
@@ -510,6 +513,9 @@ void sFLASH_LowLevel_Init(void)
 
   /*!< sFLASH_SPI Periph clock enable */
   RCC_APB2PeriphClockCmd(sFLASH_SPI_CLK, ENABLE);
+
+  /*!< sFLASH DMA clock enable */
+  RCC_AHBPeriphClockCmd(sFLASH_DMA_CLK, ENABLE);
   
   /*!< Configure sFLASH_SPI pins: SCK */
   GPIO_InitStructure.GPIO_Pin = sFLASH_SPI_SCK_PIN;
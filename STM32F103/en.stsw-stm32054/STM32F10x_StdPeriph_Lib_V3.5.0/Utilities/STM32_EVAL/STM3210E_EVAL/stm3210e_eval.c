@@ -558,6 +558,9 @@ void sFLASH_LowLevel_Init(void)
 
   /*!< sFLASH_SPI Periph clock enable */
   RCC_APB2PeriphClockCmd(sFLASH_SPI_CLK, ENABLE);
+
+  /*!< sFLASH DMA clock enable */
+  RCC_AHBPeriphClockCmd(sFLASH_DMA_CLK, ENABLE);
   
   /*!< Configure sFLASH_SPI pins: SCK */
   GPIO_InitStructure.GPIO_Pin = sFLASH_SPI_SCK_PIN;
@@ -25,6 +25,13 @@
 /* Exported functions ------------------------------------------------------- */
 void CTR_LP(void);
 void CTR_HP(void);
+void SetEPDblBuffBulk(uint8_t bEpNum, uint8_t bDir, uint16_t wBuf0Addr,
+                      uint16_t wBuf1Addr, uint16_t wCount);
+void ClearEPDblBuffDTOG(uint8_t bEpNum, uint8_t bDir);
+uint16_t GetEPDblBufTxAddr(uint8_t bEpNum);
+void SetEPDblBufTxValid(uint8_t bEpNum, uint16_t wCount);
+uint16_t GetEPDblBufRxAddr(uint8_t bEpNum);
+uint16_t GetEPDblBufRxCount(uint8_t bEpNum);
 
 /* External variables --------------------------------------------------------*/
 
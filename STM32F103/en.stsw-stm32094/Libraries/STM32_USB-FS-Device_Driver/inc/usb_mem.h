@@ -19,11 +19,23 @@
 
 /* Includes ------------------------------------------------------------------*/
 /* Exported types ------------------------------------------------------------*/
+/* A packet moved to or from the PMA in several pieces */
+typedef struct _PMA_STREAM
+{
+  uint16_t wPMABufAddr;  /* PMA address of the next word */
+  uint16_t wCount;       /* bytes moved so far */
+  uint16_t wCarry;       /* odd byte between two pieces */
+} PMA_STREAM;
+
 /* Exported constants --------------------------------------------------------*/
 /* Exported macro ------------------------------------------------------------*/
 /* Exported functions ------------------------------------------------------- */
 void UserToPMABufferCopy(uint8_t *pbUsrBuf, uint16_t wPMABufAddr, uint16_t wNBytes);
 void PMAToUserBufferCopy(uint8_t *pbUsrBuf, uint16_t wPMABufAddr, uint16_t wNBytes);
+void PMAStreamInit(PMA_STREAM *pStream, uint16_t wPMABufAddr);
+void PMAStreamWrite(PMA_STREAM *pStream, uint8_t *pbUsrBuf, uint16_t wNBytes);
+uint16_t PMAStreamFlush(PMA_STREAM *pStream);
+void PMAStreamRead(PMA_STREAM *pStream, uint8_t *pbUsrBuf, uint16_t wNBytes);
 
 /* External variables --------------------------------------------------------*/
 
@@ -39,6 +39,9 @@
 #define StatusInfo1 StatusInfo.bw.bb0
 
 /* Private macro -------------------------------------------------------------*/
+/* DTOG of a double-buffered bulk endpoint also selects its buffers */
+#define IsEPDblBuffBulk(bEpNum) \
+  ((_GetENDPOINT(bEpNum) & (EP_T_FIELD | EP_KIND)) == (EP_BULK | EP_KIND))
 /* Private variables ---------------------------------------------------------*/
 uint16_t_uint8_t StatusInfo;
 
@@ -295,7 +298,14 @@ RESULT Standard_ClearFeature(void)
       if (_GetTxStallStatus(Related_Endpoint ))
       {
       #ifndef STM32F10X_CL
-        ClearDTOG_TX(Related_Endpoint);
+        if (IsEPDblBuffBulk(Related_Endpoint))
+        {
+          ClearEPDblBuffDTOG(Related_Endpoint, EP_DBUF_IN);
+        }
+        else
+        {
+          ClearDTOG_TX(Related_Endpoint);
+        }
       #endif /* STM32F10X_CL */
         SetEPTxStatus(Related_Endpoint, EP_TX_VALID);
       }
@@ -314,7 +324,14 @@ RESULT Standard_ClearFeature(void)
         else
         {
         #ifndef STM32F10X_CL
-          ClearDTOG_RX(Related_Endpoint);
+          if (IsEPDblBuffBulk(Related_Endpoint))
+          {
+            ClearEPDblBuffDTOG(Related_Endpoint, EP_DBUF_OUT);
+          }
+          else
+          {
+            ClearDTOG_RX(Related_Endpoint);
+          }
         #endif /* STM32F10X_CL */
           _SetEPRxStatus(Related_Endpoint, EP_RX_VALID);
         }
@@ -183,6 +183,143 @@ void CTR_HP(void)
   }/* while(...) */
 }
 
+/*******************************************************************************
+* Function Name  : SetEPDblBuffBulk.
+* Description    : Set up a double-buffered bulk endpoint in one direction, the
+*                  other direction of the endpoint is disabled. The endpoint
+*                  transfers are then handled with GetEPDblBufTxAddr() and
+*                  SetEPDblBufTxValid() (IN) or GetEPDblBufRxAddr(),
+*                  GetEPDblBufRxCount() and FreeUserBuffer() (OUT).
+* Input          : - bEpNum: endpoint number.
+*                  - bDir: EP_DBUF_OUT or EP_DBUF_IN.
+*                  - wBuf0Addr, wBuf1Addr: addresses into PMA of the buffers.
+*                  - wCount: size of each buffer (OUT only).
+* Output         : None.
+* Return         : None.
+*******************************************************************************/
+void SetEPDblBuffBulk(uint8_t bEpNum, uint8_t bDir, uint16_t wBuf0Addr,
+                      uint16_t wBuf1Addr, uint16_t wCount)
+{
+  _SetEPType(bEpNum, EP_BULK);
+  _SetEPDoubleBuff(bEpNum);
+  _SetEPDblBuffAddr(bEpNum, wBuf0Addr, wBuf1Addr);
+  if (bDir == EP_DBUF_OUT)
+  {
+    _SetEPDblBuffCount(bEpNum, EP_DBUF_OUT, wCount);
+    ClearEPDblBuffDTOG(bEpNum, EP_DBUF_OUT);
+    _SetEPTxStatus(bEpNum, EP_TX_DIS);
+    _SetEPRxStatus(bEpNum, EP_RX_VALID);
+  }
+  else
+  {
+    _SetEPDblBuffCount(bEpNum, EP_DBUF_IN, 0);
+    ClearEPDblBuffDTOG(bEpNum, EP_DBUF_IN);
+    _SetEPRxStatus(bEpNum, EP_RX_DIS);
+    _SetEPTxStatus(bEpNum, EP_TX_VALID);
+  }
+}
+
+/*******************************************************************************
+* Function Name  : ClearEPDblBuffDTOG.
+* Description    : Put DTOG and SW_BUF of a double-buffered bulk endpoint back
+*                  to their start state, both buffers empty. The hardware uses
+*                  the buffer selected by DTOG and NAKs while SW_BUF selects
+*                  the same one.
+* Input          : - bEpNum: endpoint number.
+*                  - bDir: EP_DBUF_OUT or EP_DBUF_IN.
+* Output         : None.
+* Return         : None.
+*******************************************************************************/
+void ClearEPDblBuffDTOG(uint8_t bEpNum, uint8_t bDir)
+{
+  _ClearDTOG_RX(bEpNum);
+  _ClearDTOG_TX(bEpNum);
+  if (bDir == EP_DBUF_OUT)
+  {
+    /* SW_BUF (DTOG_TX) != DTOG_RX: the host may send into buffer 0 */
+    _ToggleDTOG_TX(bEpNum);
+  }
+  /* IN: SW_BUF (DTOG_RX) == DTOG_TX, NAK until SetEPDblBufTxValid() */
+}
+
+/*******************************************************************************
+* Function Name  : GetEPDblBufTxAddr.
+* Description    : Address into PMA of the buffer of a double-buffered IN
+*                  endpoint that the application may fill. It can be filled
+*                  while the other buffer is being sent.
+* Input          : bEpNum: endpoint number.
+* Output         : None.
+* Return         : Buffer address.
+*******************************************************************************/
+uint16_t GetEPDblBufTxAddr(uint8_t bEpNum)
+{
+  if ((_GetENDPOINT(bEpNum) & EP_DTOG_RX) != 0)
+  {
+    return _GetEPDblBuf1Addr(bEpNum);
+  }
+  return _GetEPDblBuf0Addr(bEpNum);
+}
+
+/*******************************************************************************
+* Function Name  : SetEPDblBufTxValid.
+* Description    : Hand the buffer filled at GetEPDblBufTxAddr() to the
+*                  hardware. One packet can wait behind the one being sent, so
+*                  after the first call this is done once per IN callback.
+* Input          : - bEpNum: endpoint number.
+*                  - wCount: no. of bytes in the buffer.
+* Output         : None.
+* Return         : None.
+*******************************************************************************/
+void SetEPDblBufTxValid(uint8_t bEpNum, uint16_t wCount)
+{
+  if ((_GetENDPOINT(bEpNum) & EP_DTOG_RX) != 0)
+  {
+    _SetEPDblBuf1Count(bEpNum, EP_DBUF_IN, wCount);
+  }
+  else
+  {
+    _SetEPDblBuf0Count(bEpNum, EP_DBUF_IN, wCount);
+  }
+  FreeUserBuffer(bEpNum, EP_DBUF_IN);
+}
+
+/*******************************************************************************
+* Function Name  : GetEPDblBufRxAddr.
+* Description    : Address into PMA of the packet received on a double-buffered
+*                  OUT endpoint, valid from its OUT callback. The buffer is
+*                  returned with FreeUserBuffer(bEpNum, EP_DBUF_OUT), which also
+*                  lets the host send into the other one: call it as soon as
+*                  the address and count are taken if the packet is read before
+*                  the next OUT callback, or after reading it otherwise.
+* Input          : bEpNum: endpoint number.
+* Output         : None.
+* Return         : Buffer address.
+*******************************************************************************/
+uint16_t GetEPDblBufRxAddr(uint8_t bEpNum)
+{
+  if ((_GetENDPOINT(bEpNum) & EP_DTOG_TX) != 0)
+  {
+    return _GetEPDblBuf0Addr(bEpNum);
+  }
+  return _GetEPDblBuf1Addr(bEpNum);
+}
+
+/*******************************************************************************
+* Function Name  : GetEPDblBufRxCount.
+* Description    : No. of bytes in the packet at GetEPDblBufRxAddr().
+* Input          : bEpNum: endpoint number.
+* Output         : None.
+* Return         : Packet length.
+*******************************************************************************/
+uint16_t GetEPDblBufRxCount(uint8_t bEpNum)
+{
+  if ((_GetENDPOINT(bEpNum) & EP_DTOG_TX) != 0)
+  {
+    return _GetEPDblBuf0Count(bEpNum);
+  }
+  return _GetEPDblBuf1Count(bEpNum);
+}
+
 #endif  /* STM32F10X_CL */
 
 /******************* (C) COPYRIGHT 2010 STMicroelectronics *****END OF FILE****/
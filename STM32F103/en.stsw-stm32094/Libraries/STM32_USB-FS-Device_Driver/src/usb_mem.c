@@ -27,6 +27,8 @@
 /*******************************************************************************
 * Function Name  : UserToPMABufferCopy
 * Description    : Copy a buffer from user memory area to packet memory area (PMA)
+*                  A halfword aligned buffer is read with halfword loads, four
+*                  PMA words per loop; any other buffer is read byte by byte.
 * Input          : - pbUsrBuf: pointer to user memory area.
 *                  - wPMABufAddr: address into PMA.
 *                  - wNBytes: no. of bytes to be copied.
@@ -35,23 +37,53 @@
 *******************************************************************************/
 void UserToPMABufferCopy(uint8_t *pbUsrBuf, uint16_t wPMABufAddr, uint16_t wNBytes)
 {
-  uint32_t n = (wNBytes + 1) >> 1;   /* n = (wNBytes + 1) / 2 */
-  uint32_t i, temp1, temp2;
+  uint32_t n = wNBytes >> 1;   /* n = wNBytes / 2 */
+  uint32_t temp1, temp2;
+  uint16_t *pwUsrBuf;
   uint16_t *pdwVal;
   pdwVal = (uint16_t *)(wPMABufAddr * 2 + PMAAddr);
-  for (i = n; i != 0; i--)
+  if (((uint32_t)pbUsrBuf & 1) == 0)
   {
-    temp1 = (uint16_t) * pbUsrBuf;
-    pbUsrBuf++;
-    temp2 = temp1 | (uint16_t) * pbUsrBuf << 8;
-    *pdwVal++ = temp2;
-    pdwVal++;
-    pbUsrBuf++;
+    pwUsrBuf = (uint16_t *)pbUsrBuf;
+    for (; n >= 4; n -= 4)
+    {
+      pdwVal[0] = pwUsrBuf[0];
+      pdwVal[2] = pwUsrBuf[1];
+      pdwVal[4] = pwUsrBuf[2];
+      pdwVal[6] = pwUsrBuf[3];
+      pdwVal += 8;
+      pwUsrBuf += 4;
+    }
+    for (; n != 0; n--)
+    {
+      *pdwVal = *pwUsrBuf++;
+      pdwVal += 2;
+    }
+    pbUsrBuf = (uint8_t *)pwUsrBuf;
+  }
+  else
+  {
+    for (; n != 0; n--)
+    {
+      temp1 = (uint16_t) * pbUsrBuf;
+      pbUsrBuf++;
+      temp2 = temp1 | (uint16_t) * pbUsrBuf << 8;
+      *pdwVal = temp2;
+      pdwVal += 2;
+      pbUsrBuf++;
+    }
+  }
+  if ((wNBytes & 1) != 0)
+  {
+    /* last byte alone, the byte after the buffer is not read */
+    *pdwVal = (uint16_t) * pbUsrBuf;
   }
 }
 /*******************************************************************************
 * Function Name  : PMAToUserBufferCopy
-* Description    : Copy a buffer from user memory area to packet memory area (PMA)
+* Description    : Copy a buffer from packet memory area (PMA) to user memory area
+*                  A halfword aligned buffer is written with halfword stores,
+*                  four PMA words per loop; any other buffer byte by byte.
 * Input          : - pbUsrBuf    = pointer to user memory area.
 *                  - wPMABufAddr = address into PMA.
 *                  - wNBytes     = no. of bytes to be copied.
@@ -60,14 +92,149 @@ void UserToPMABufferCopy(uint8_t *pbUsrBuf, uint16_t wPMABufAddr, uint16_t wNByt
 *******************************************************************************/
 void PMAToUserBufferCopy(uint8_t *pbUsrBuf, uint16_t wPMABufAddr, uint16_t wNBytes)
 {
-  uint32_t n = (wNBytes + 1) >> 1;/* /2*/
-  uint32_t i;
+  uint32_t n = wNBytes >> 1;/* /2*/
+  uint32_t temp;
+  uint16_t *pwUsrBuf;
   uint32_t *pdwVal;
   pdwVal = (uint32_t *)(wPMABufAddr * 2 + PMAAddr);
-  for (i = n; i != 0; i--)
+  if (((uint32_t)pbUsrBuf & 1) == 0)
+  {
+    pwUsrBuf = (uint16_t *)pbUsrBuf;
+    for (; n >= 4; n -= 4)
+    {
+      pwUsrBuf[0] = (uint16_t)pdwVal[0];
+      pwUsrBuf[1] = (uint16_t)pdwVal[1];
+      pwUsrBuf[2] = (uint16_t)pdwVal[2];
+      pwUsrBuf[3] = (uint16_t)pdwVal[3];
+      pwUsrBuf += 4;
+      pdwVal += 4;
+    }
+    for (; n != 0; n--)
+    {
+      *pwUsrBuf++ = (uint16_t)*pdwVal++;
+    }
+    pbUsrBuf = (uint8_t *)pwUsrBuf;
+  }
+  else
+  {
+    for (; n != 0; n--)
+    {
+      temp = *pdwVal++;
+      *pbUsrBuf++ = (uint8_t)temp;
+      *pbUsrBuf++ = (uint8_t)(temp >> 8);
+    }
+  }
+  if ((wNBytes & 1) != 0)
+  {
+    /* last byte alone, nothing is written past the buffer */
+    *pbUsrBuf = (uint8_t)*pdwVal;
+  }
+}
+/*******************************************************************************
+* Function Name  : PMAStreamInit
+* Description    : Start moving a packet to or from the PMA in several pieces,
+*                  e.g. straight out of or into a ring buffer, without staging
+*                  it in RAM first.
+* Input          : - pStream: stream to initialize.
+*                  - wPMABufAddr: address into PMA of the packet buffer.
+* Output         : None.
+* Return         : None.
+*******************************************************************************/
+void PMAStreamInit(PMA_STREAM *pStream, uint16_t wPMABufAddr)
+{
+  pStream->wPMABufAddr = wPMABufAddr;
+  pStream->wCount = 0;
+  pStream->wCarry = 0;
+}
+/*******************************************************************************
+* Function Name  : PMAStreamWrite
+* Description    : Append wNBytes from user memory area to the packet. An odd
+*                  byte is held back until the next piece or PMAStreamFlush().
+* Input          : - pStream: stream from PMAStreamInit().
+*                  - pbUsrBuf: pointer to user memory area.
+*                  - wNBytes: no. of bytes to be copied.
+* Output         : None.
+* Return         : None.
+*******************************************************************************/
+void PMAStreamWrite(PMA_STREAM *pStream, uint8_t *pbUsrBuf, uint16_t wNBytes)
+{
+  uint16_t *pdwVal;
+  uint16_t wNEven;
+
+  if (wNBytes == 0)
   {
-    *(uint16_t*)pbUsrBuf++ = *pdwVal++;
+    return;
+  }
+  pStream->wCount += wNBytes;
+  if ((pStream->wCount - wNBytes) & 1)
+  {
+    /* complete the PMA word with the byte held back */
+    pdwVal = (uint16_t *)(pStream->wPMABufAddr * 2 + PMAAddr);
+    *pdwVal = pStream->wCarry | (uint16_t) * pbUsrBuf << 8;
+    pStream->wPMABufAddr += 2;
     pbUsrBuf++;
+    wNBytes--;
+  }
+  wNEven = wNBytes & ~1;
+  UserToPMABufferCopy(pbUsrBuf, pStream->wPMABufAddr, wNEven);
+  pStream->wPMABufAddr += wNEven;
+  if ((wNBytes & 1) != 0)
+  {
+    pStream->wCarry = pbUsrBuf[wNEven];
+  }
+}
+/*******************************************************************************
+* Function Name  : PMAStreamFlush
+* Description    : Write out the byte held back by PMAStreamWrite(), if any.
+* Input          : - pStream: stream from PMAStreamInit().
+* Output         : None.
+* Return         : Number of bytes written, for SetEPTxCount().
+*******************************************************************************/
+uint16_t PMAStreamFlush(PMA_STREAM *pStream)
+{
+  uint16_t *pdwVal;
+
+  if ((pStream->wCount & 1) != 0)
+  {
+    pdwVal = (uint16_t *)(pStream->wPMABufAddr * 2 + PMAAddr);
+    *pdwVal = pStream->wCarry;
+  }
+  return pStream->wCount;
+}
+/*******************************************************************************
+* Function Name  : PMAStreamRead
+* Description    : Copy the next wNBytes of the packet to user memory area.
+* Input          : - pStream: stream from PMAStreamInit().
+*                  - pbUsrBuf: pointer to user memory area.
+*                  - wNBytes: no. of bytes to be copied.
+* Output         : None.
+* Return         : None.
+*******************************************************************************/
+void PMAStreamRead(PMA_STREAM *pStream, uint8_t *pbUsrBuf, uint16_t wNBytes)
+{
+  uint32_t *pdwVal;
+  uint16_t wNEven;
+
+  if (wNBytes == 0)
+  {
+    return;
+  }
+  pStream->wCount += wNBytes;
+  if ((pStream->wCount - wNBytes) & 1)
+  {
+    /* high byte of the PMA word read last time */
+    *pbUsrBuf++ = (uint8_t)pStream->wCarry;
+    wNBytes--;
+  }
+  wNEven = wNBytes & ~1;
+  PMAToUserBufferCopy(pbUsrBuf, pStream->wPMABufAddr, wNEven);
+  pStream->wPMABufAddr += wNEven;
+  if ((wNBytes & 1) != 0)
+  {
+    pdwVal = (uint32_t *)(pStream->wPMABufAddr * 2 + PMAAddr);
+    pStream->wCarry = (uint16_t)(*pdwVal >> 8);
+    pbUsrBuf[wNEven] = (uint8_t)*pdwVal;
+    pStream->wPMABufAddr += 2;
   }
 }
 
@@ -32,6 +32,7 @@
 /* Exported constants --------------------------------------------------------*/
 #define MAL_OK   0
 #define MAL_FAIL 1
+#define MAL_BUSY 2
 #define MAX_USED_MEDIA 3
 #define MAL_MASK 0x08000000
 
@@ -53,6 +54,9 @@
 uint16_t MAL_Init (void);
 uint16_t MAL_Erase (uint32_t SectorAddress);
 uint16_t MAL_Write (uint32_t SectorAddress, uint32_t DataLength);
+uint16_t MAL_WriteData (uint32_t SectorAddress, uint8_t *pBuffer, uint32_t DataLength);
+uint16_t MAL_WriteReady (uint32_t SectorAddress);
+uint16_t MAL_WriteDone (uint32_t SectorAddress);
 uint8_t  *MAL_Read (uint32_t SectorAddress, uint32_t DataLength);
 uint16_t MAL_GetStatus(uint32_t SectorAddress ,uint8_t Cmd, uint8_t *buffer);
 
@@ -28,7 +28,32 @@
 
 
 /* Exported types ------------------------------------------------------------*/
+/* Transfer counters, read back by the host as DFU upload block 1 */
+typedef struct
+{
+    uint32_t Time;            /* ms since I2C_FLASH_Init */
+    uint32_t BytesWritten;    /* page data handed to the target */
+    uint32_t BytesRead;       /* data read back from the target */
+    uint32_t PagesQueued;     /* pages accepted while the bus was still busy */
+    uint32_t QueueFull;       /* times the host was told to wait for a slot */
+    uint32_t ReadHits;        /* pages found in the read-ahead ring */
+    uint32_t ReadMisses;      /* pages read on demand */
+    uint32_t Batches;         /* batch commands executed */
+    uint32_t BusTime;         /* ms the bus spent moving data */
+    uint32_t ProgramTime;     /* ms the bus was held off for the target */
+    uint32_t Errors;          /* transfers aborted on a bus error or NACK */
+} I2C_FLASH_Stats_TypeDef;
+
 /* Exported constants --------------------------------------------------------*/
+#define I2C_FLASH_PAGE_SIZE     0x400     /* bytes per OPC_WREN command */
+#define I2C_FLASH_SIZE          0x20000   /* end of the target flash, as
+                                             offset from 0x08000000 */
+#define I2C_FLASH_WRITE_SLOTS   2         /* pages queued for the bus */
+#define I2C_FLASH_READ_SLOTS    2         /* pages of the read-ahead ring */
+#define I2C_FLASH_PAGE_TIME     25        /* ms to move one page at 400 kHz */
+#define I2C_FLASH_PROGRAM_TIME  100       /* ms the target needs to erase and
+                                             program a page after the STOP */
+
 /* Exported macro ------------------------------------------------------------*/
 /* Exported functions ------------------------------------------------------- */
 void I2C_FLASH_Init(void);
@@ -37,7 +62,23 @@ void i2c_send_add(uint32_t ADD_FLASH,uint8_t I2C1_Buffer_Tx[]);
 void i2c_send_byte_number(uint16_t byte_number,uint8_t I2C1_Buffer_Tx[]);
 void I2C_FLASH_BufferRead(uint8_t* pBuffer, uint32_t ReadAddr, uint16_t NumByteToRead);
 void I2C_FLASH_PageWrite(uint8_t* pBuffer, uint32_t WriteAddr, uint16_t NumByteToWrite);
+uint8_t I2C_FLASH_QueueWrite(uint8_t* pBuffer, uint32_t WriteAddr, uint16_t NumByteToWrite);
+uint8_t *I2C_FLASH_ReadPage(uint32_t ReadAddr, uint16_t NumByteToRead);
+void I2C_FLASH_Prefetch(uint32_t ReadAddr, uint16_t NumByteToRead);
+uint16_t I2C_FLASH_GetFreeSlots(void);
+uint16_t I2C_FLASH_GetWaitTime(uint8_t AllWrites);
+uint8_t I2C_FLASH_IsIdle(void);
+uint8_t I2C_FLASH_WriteFailed(void);
+void I2C_FLASH_EV_IRQHandler(void);
+void I2C_FLASH_ER_IRQHandler(void);
+void I2C_FLASH_DMATx_IRQHandler(void);
+void I2C_FLASH_DMARx_IRQHandler(void);
+void I2C_FLASH_TimingHandler(void);
 void i2c_delay (uint32_t delay);
+
+/* External variables --------------------------------------------------------*/
+extern I2C_FLASH_Stats_TypeDef I2C_FLASH_Stats;
+
 #endif /* __I2C_FLASH_H */
 
 /******************* (C) COPYRIGHT 2010 STMicroelectronics *****END OF FILE****/
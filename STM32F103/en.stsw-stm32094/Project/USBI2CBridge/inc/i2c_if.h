@@ -35,7 +35,11 @@
 uint16_t I2C_If_Init(void);
 uint16_t I2C_If_Erase(uint32_t SectorAddress);
 uint16_t I2C_If_Write(uint32_t SectorAddress, uint32_t DataLength);
+uint16_t I2C_If_WriteData(uint32_t SectorAddress, uint8_t *pBuffer, uint32_t DataLength);
+uint16_t I2C_If_WriteReady(uint32_t SectorAddress);
+uint16_t I2C_If_WriteDone(uint32_t SectorAddress);
 uint8_t *I2C_If_Read (uint32_t SectorAddress, uint32_t DataLength);
+uint16_t I2C_If_GetTiming(uint8_t Cmd);
 
 #endif /* __I2C_IF_MAL_H */
 
@@ -43,6 +43,10 @@ void PendSV_Handler(void);
 void SysTick_Handler(void);
 void USB_LP_CAN1_RX0_IRQHandler(void);
 void OTG_FS_IRQHandler(void);
+void I2C1_EV_IRQHandler(void);
+void I2C1_ER_IRQHandler(void);
+void DMA1_Channel6_IRQHandler(void);
+void DMA1_Channel7_IRQHandler(void);
 #endif /* __STM32F10x_IT_H */
 
 /******************* (C) COPYRIGHT 2010 STMicroelectronics *****END OF FILE****/
@@ -129,6 +129,9 @@ typedef enum _DFU_REQUESTS {
 #define CMD_GETCOMMANDS              0x00
 #define CMD_SETADDRESSPOINTER        0x21
 #define CMD_ERASE                    0x41
+#define CMD_BATCH                    0x51
+/* Records of a CMD_BATCH block only */
+#define CMD_WRITEMEMORY              0x31
 
 #endif /* __USB_PROP_H */
 
@@ -146,6 +146,69 @@ uint8_t *MAL_Read (uint32_t SectorAddress, uint32_t DataLength)
 
 
 
+/**
+  * @brief  Write data from a buffer, without padding it to a sector
+  * @param  None
+  * @retval : MAL_OK or MAL_FAIL
+  */
+uint16_t MAL_WriteData (uint32_t SectorAddress, uint8_t *pBuffer, uint32_t DataLength)
+{
+
+    switch (SectorAddress & MAL_MASK)
+    {
+    case I2C_FLASH_BASE:
+        return I2C_If_WriteData(SectorAddress, pBuffer, DataLength);
+
+
+    default:
+        return MAL_FAIL;
+    }
+}
+
+
+
+/**
+  * @brief  Tells whether MAL_Write takes a sector without waiting
+  * @param  None
+  * @retval : MAL_OK or MAL_FAIL
+  */
+uint16_t MAL_WriteReady (uint32_t SectorAddress)
+{
+
+    switch (SectorAddress & MAL_MASK)
+    {
+    case I2C_FLASH_BASE:
+        return I2C_If_WriteReady(SectorAddress);
+
+
+    default:
+        return MAL_OK;
+    }
+}
+
+
+
+/**
+  * @brief  Tells whether every sector written so far reached the media
+  * @param  None
+  * @retval : MAL_OK, MAL_BUSY or MAL_FAIL
+  */
+uint16_t MAL_WriteDone (uint32_t SectorAddress)
+{
+
+    switch (SectorAddress & MAL_MASK)
+    {
+    case I2C_FLASH_BASE:
+        return I2C_If_WriteDone(SectorAddress);
+
+
+    default:
+        return MAL_OK;
+    }
+}
+
+
+
 /**
   * @brief  Get status
   * @param  None
@@ -157,6 +220,14 @@ uint16_t MAL_GetStatus(uint32_t SectorAddress , uint8_t Cmd, uint8_t *buffer)
 
     uint8_t y = Cmd & 0x01;
 
+    if ((SectorAddress & MAL_MASK) == I2C_FLASH_BASE)
+    {
+        /* Writes are queued: the host only waits for a free slot, or for
+           the queue to drain at the end of the download (Cmd = 2) */
+        SET_POLLING_TIMING(I2C_If_GetTiming(Cmd));
+        return MAL_OK;
+    }
+
     SET_POLLING_TIMING(TimingTable[x][y]);  /* x: Erase/Write Timing */
     /* y: Media              */
     return MAL_OK;
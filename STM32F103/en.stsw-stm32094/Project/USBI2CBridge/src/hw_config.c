@@ -73,6 +73,9 @@ void Set_System(void)
   USB_Cable_Config(DISABLE);
 #endif /* USE_STM3210C_EVAL */
   
+  /* One preemption bit: the I2C transfers (0) interrupt the USB handlers (1) */
+  NVIC_PriorityGroupConfig(NVIC_PriorityGroup_1);
+
   /* Init the media interface */
   MAL_Init();
 
@@ -188,13 +191,13 @@ void USB_Interrupts_Config(void)
 #ifdef STM32F10X_CL
   /* Enable the USB Interrupts */
   NVIC_InitStructure.NVIC_IRQChannel = OTG_FS_IRQn;
-  NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 0;
+  NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 1;
   NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
   NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
   NVIC_Init(&NVIC_InitStructure);
 #else
   NVIC_InitStructure.NVIC_IRQChannel = USB_LP_CAN1_RX0_IRQn;
-  NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 0;
+  NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 1;
   NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
   NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
   NVIC_Init(&NVIC_InitStructure);
@@ -34,21 +34,62 @@
 
 
 /* Private typedef -----------------------------------------------------------*/
+/* One page of the read-ahead ring */
+typedef struct
+{
+    uint32_t Addr;
+    uint16_t Length;
+    __IO uint8_t State;
+    uint8_t Stale;      /* a write to this page was queued while it was read */
+    uint8_t Used;       /* already handed out by I2C_FLASH_ReadPage */
+    uint8_t Data[I2C_FLASH_PAGE_SIZE];
+} I2C_FLASH_ReadSlot_TypeDef;
+
 /* Private define ------------------------------------------------------------*/
 #define  ClockSpeed           400000
 #define  OPC_READ             (uint8_t)(0x03)
 #define  OPC_WREN             (uint8_t)(0x06)
 
-#define  BufferSize           0x408
+#define  HeaderSize           8
+#define  BufferSize           (HeaderSize + I2C_FLASH_PAGE_SIZE)
 #define  I2C_SLAVE_ADDRESS7   0x30
 #define I2C1_DR_Address       0x40005410
+
+/* What the bus is doing */
+#define  BUS_IDLE             0
+#define  BUS_WRITE            1   /* OPC_WREN header and page going out */
+#define  BUS_READ_CMD         2   /* OPC_READ header going out */
+#define  BUS_READ_DATA        3   /* page coming back */
+#define  BUS_PROGRAM          4   /* held off while the target programs */
+
+/* Read-ahead slot states */
+#define  SLOT_FREE            0
+#define  SLOT_PENDING         1   /* waiting for the bus */
+#define  SLOT_BUSY            2   /* on the bus */
+#define  SLOT_READY           3
+#define  SLOT_ERROR           4
+
 /* Private macro -------------------------------------------------------------*/
 /* Private variables ---------------------------------------------------------*/
-uint8_t  I2C1_Buffer_Tx[BufferSize];
-uint8_t  I2C1_Buffer_Rx[BufferSize];
+uint8_t  I2C1_Buffer_Tx[I2C_FLASH_WRITE_SLOTS][BufferSize];
+uint8_t  I2C1_Buffer_Cmd[HeaderSize];
+I2C_FLASH_ReadSlot_TypeDef I2C1_ReadSlot[I2C_FLASH_READ_SLOTS];
+I2C_FLASH_Stats_TypeDef I2C_FLASH_Stats;
+
+static uint16_t TxLength[I2C_FLASH_WRITE_SLOTS];
+static __IO uint8_t TxHead = 0, TxTail = 0, TxCount = 0;
+static __IO uint8_t BusState = BUS_IDLE;
+static __IO uint16_t HoldOff = 0;
+static __IO uint8_t WriteFailed = 0;  /* a queued page was dropped */
+static uint8_t ReadSlot = 0;      /* slot on the bus */
+static uint8_t ReadCurrent = 0;   /* slot last handed out */
+
 /* Private function prototypes -----------------------------------------------*/
+static void I2C_FLASH_StartNext(void);
+static I2C_FLASH_ReadSlot_TypeDef *I2C_FLASH_FindSlot(uint32_t ReadAddr, uint16_t NumByteToRead);
+static I2C_FLASH_ReadSlot_TypeDef *I2C_FLASH_GetVictim(void);
+
 /* Private functions ---------------------------------------------------------*/
-/* Private function prototypes -----------------------------------------------*/
 
 
 /**
@@ -61,6 +102,7 @@ void I2C_FLASH_Init(void)
     I2C_InitTypeDef   I2C_InitStructure;
     GPIO_InitTypeDef GPIO_InitStructure;
     DMA_InitTypeDef  DMA_InitStructure;
+    NVIC_InitTypeDef NVIC_InitStructure;
 
     /* Enable peripheral clocks --------------------------------------------------*/
     /* Enable I2C1 and I2C2 clock */
@@ -79,9 +121,10 @@ void I2C_FLASH_Init(void)
     I2C_DeInit(I2C1);
 
     /* DMA1 channel6 configuration ----------------------------------------------*/
+    /* The memory address and count are set for each transfer */
     DMA_DeInit(DMA1_Channel6);
     DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)I2C1_DR_Address;
-    DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)I2C1_Buffer_Tx;
+    DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)I2C1_Buffer_Tx[0];
     DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralDST;
     DMA_InitStructure.DMA_BufferSize = BufferSize;
     DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
@@ -92,17 +135,18 @@ void I2C_FLASH_Init(void)
     DMA_InitStructure.DMA_Priority = DMA_Priority_High;
     DMA_InitStructure.DMA_M2M = DMA_M2M_Disable;
     DMA_Init(DMA1_Channel6, &DMA_InitStructure);
-    /* Enable I2C1 DMA */
+    DMA_ITConfig(DMA1_Channel6, DMA_IT_TC, ENABLE);
 
 
     /* DMA1 channel7 configuration ---------------------------------------------*/
     DMA_DeInit(DMA1_Channel7);
     DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)I2C1_DR_Address;
-    DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)I2C1_Buffer_Rx;
+    DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)I2C1_ReadSlot[0].Data;
     DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralSRC;
-    DMA_InitStructure.DMA_BufferSize = BufferSize;
+    DMA_InitStructure.DMA_BufferSize = I2C_FLASH_PAGE_SIZE;
     DMA_InitStructure.DMA_Priority = DMA_Priority_VeryHigh;
     DMA_Init(DMA1_Channel7, &DMA_InitStructure);
+    DMA_ITConfig(DMA1_Channel7, DMA_IT_TC, ENABLE);
 
 
     /* I2C1 configuration ------------------------------------------------------*/
@@ -115,8 +159,27 @@ void I2C_FLASH_Init(void)
     /* Enable I2C  ------------------------------------------------------------*/
     I2C_Cmd(I2C1, ENABLE);
     I2C_DMACmd(I2C1, ENABLE);
-
-
+    I2C_ITConfig(I2C1, I2C_IT_ERR, ENABLE);
+
+    /* Interrupts --------------------------------------------------------------*/
+    /* The transfers run from the I2C1 and DMA interrupts. They preempt the USB
+       interrupt, which waits on them when the host reads a page that is not
+       in the ring yet */
+    NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 0;
+    NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
+    NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+    NVIC_InitStructure.NVIC_IRQChannel = I2C1_EV_IRQn;
+    NVIC_Init(&NVIC_InitStructure);
+    NVIC_InitStructure.NVIC_IRQChannel = I2C1_ER_IRQn;
+    NVIC_Init(&NVIC_InitStructure);
+    NVIC_InitStructure.NVIC_IRQChannel = DMA1_Channel6_IRQn;
+    NVIC_Init(&NVIC_InitStructure);
+    NVIC_InitStructure.NVIC_IRQChannel = DMA1_Channel7_IRQn;
+    NVIC_Init(&NVIC_InitStructure);
+
+    /* 1 ms time base for the target programming time */
+    SysTick_Config(SystemCoreClock / 1000);
+    NVIC_SetPriority(SysTick_IRQn, 0);
 }
 
 
@@ -184,132 +247,623 @@ void i2c_send_byte_number(uint16_t byte_number,uint8_t I2C1_Buffer[])
 
 
 
+/**
+  * @brief  Queues a page for the FLASH. The page is copied and goes out by
+  *   DMA once the pages before it are written; the call does not wait.
+  *   The number of bytes can't exceed I2C_FLASH_PAGE_SIZE, an odd count
+  *   is padded with 0xFF to the halfword the target programs.
+  * @param pBuffer : pointer to the buffer  containing the data to be
+  *   written into the FLASH.
+  * @param WriteAddr : FLASH's internal address to write to.
+  * @param NumByteToWrite : number of bytes to write to the FLASH.
+  * @retval : 1 if the page was queued, 0 if the queue is full.
+  */
+uint8_t I2C_FLASH_QueueWrite(uint8_t* pBuffer, uint32_t WriteAddr, uint16_t NumByteToWrite)
+{
+    uint8_t *pSlot;
+    uint16_t Idx;
+    uint8_t i;
+
+    if (TxCount == I2C_FLASH_WRITE_SLOTS)
+    {
+        return 0;
+    }
+
+    pSlot = I2C1_Buffer_Tx[TxTail];
+    for (Idx = 0; Idx < NumByteToWrite; Idx++)
+    {
+        pSlot[Idx + HeaderSize] = pBuffer[Idx];
+    }
+    if (NumByteToWrite & 1)
+    {
+        pSlot[HeaderSize + NumByteToWrite++] = 0xFF;
+    }
+    i2c_send_opcode(OPC_WREN, pSlot);
+    i2c_send_add(WriteAddr + 0x08000000, pSlot);
+    i2c_send_byte_number(NumByteToWrite, pSlot);
+    /* Dummy byte */
+    pSlot[7] = 0xFF;
+    TxLength[TxTail] = HeaderSize + NumByteToWrite;
+
+    __disable_irq();
+    /* Pages of the ring that this write changes must be read again */
+    for (i = 0; i < I2C_FLASH_READ_SLOTS; i++)
+    {
+        if ((I2C1_ReadSlot[i].Addr < WriteAddr + NumByteToWrite)
+                && (WriteAddr < I2C1_ReadSlot[i].Addr + I2C1_ReadSlot[i].Length))
+        {
+            if (I2C1_ReadSlot[i].State == SLOT_BUSY)
+            {
+                I2C1_ReadSlot[i].Stale = 1;
+            }
+            else
+            {
+                I2C1_ReadSlot[i].State = SLOT_FREE;
+            }
+        }
+    }
+    if (BusState != BUS_IDLE)
+    {
+        I2C_FLASH_Stats.PagesQueued++;
+    }
+    TxTail = (TxTail + 1) % I2C_FLASH_WRITE_SLOTS;
+    TxCount++;
+    I2C_FLASH_StartNext();
+    __enable_irq();
+
+    return 1;
+}
+
+
+
+/**
+  * @brief  Writes more than one byte to the FLASH with a single WRITE
+  *   cycle(Page WRITE sequence). Waits for room in the write queue only;
+  *   the page itself is written in the background.
+  * @param pBuffer : pointer to the buffer  containing the data to be
+  *   written into the FLASH.
+  * @param WriteAddr : FLASH's internal address to write to.
+  * @param NumByteToWrite : number of bytes to write to the FLASH,
+  *   must be equal or less than "I2C_FLASH_PAGE_SIZE" value.
+  * @retval : None
+  */
+void I2C_FLASH_PageWrite(uint8_t* pBuffer, uint32_t WriteAddr, uint16_t NumByteToWrite)
+{
+    while (I2C_FLASH_QueueWrite(pBuffer, WriteAddr, NumByteToWrite) == 0)
+    {
+        __WFI();
+    }
+}
+
+
+
+/**
+  * @brief  Returns a page of the FLASH from the read-ahead ring, reading
+  *   it first if it is not there. Queued writes reach the FLASH before
+  *   the read.
+  * @param ReadAddr : FLASH's internal address to read from.
+  * @param NumByteToRead : number of bytes to read from the FLASH, at most
+  *   I2C_FLASH_PAGE_SIZE.
+  * @retval : Pointer to the data, 0 if the target did not answer.
+  */
+uint8_t *I2C_FLASH_ReadPage(uint32_t ReadAddr, uint16_t NumByteToRead)
+{
+    I2C_FLASH_ReadSlot_TypeDef *pSlot;
+    uint8_t i;
+
+    /* The DMA end of transfer NACK needs two bytes at least */
+    if (NumByteToRead < 2)
+    {
+        NumByteToRead = 2;
+    }
+    if (NumByteToRead > I2C_FLASH_PAGE_SIZE)
+    {
+        NumByteToRead = I2C_FLASH_PAGE_SIZE;
+    }
+
+    __disable_irq();
+    pSlot = I2C_FLASH_FindSlot(ReadAddr, NumByteToRead);
+    if (pSlot == 0)
+    {
+        /* Read-ahead that has not started yet gives way to this page */
+        for (i = 0; i < I2C_FLASH_READ_SLOTS; i++)
+        {
+            if (I2C1_ReadSlot[i].State == SLOT_PENDING)
+            {
+                I2C1_ReadSlot[i].State = SLOT_FREE;
+            }
+        }
+        pSlot = I2C_FLASH_GetVictim();
+        if (pSlot == 0)
+        {
+            pSlot = &I2C1_ReadSlot[ReadCurrent];
+        }
+        pSlot->Addr = ReadAddr;
+        pSlot->Length = NumByteToRead;
+        pSlot->Stale = 0;
+        pSlot->Used = 1;
+        pSlot->State = SLOT_PENDING;
+        I2C_FLASH_Stats.ReadMisses++;
+    }
+    else if (pSlot->Used == 0)
+    {
+        /* Read ahead: done, or at least on its way */
+        pSlot->Used = 1;
+        I2C_FLASH_Stats.ReadHits++;
+    }
+    ReadCurrent = pSlot - I2C1_ReadSlot;
+    I2C_FLASH_StartNext();
+    __enable_irq();
+
+    while ((pSlot->State != SLOT_READY) && (pSlot->State != SLOT_ERROR))
+    {
+        __WFI();
+    }
+    if (pSlot->State == SLOT_ERROR)
+    {
+        pSlot->State = SLOT_FREE;
+        return 0;
+    }
+    return pSlot->Data;
+}
+
+
+
+/**
+  * @brief  Starts reading a page into the read-ahead ring, without
+  *   waiting for it. The page last returned by I2C_FLASH_ReadPage stays.
+  * @param ReadAddr : FLASH's internal address to read from.
+  * @param NumByteToRead : number of bytes to read from the FLASH, at most
+  *   I2C_FLASH_PAGE_SIZE.
+  * @retval : None
+  */
+void I2C_FLASH_Prefetch(uint32_t ReadAddr, uint16_t NumByteToRead)
+{
+    I2C_FLASH_ReadSlot_TypeDef *pSlot;
+
+    if (NumByteToRead < 2)
+    {
+        NumByteToRead = 2;
+    }
+    /* The target faults on a read past the end of its flash */
+    if ((NumByteToRead > I2C_FLASH_PAGE_SIZE)
+            || (ReadAddr + NumByteToRead > I2C_FLASH_SIZE))
+    {
+        return;
+    }
+
+    __disable_irq();
+    if (I2C_FLASH_FindSlot(ReadAddr, NumByteToRead) == 0)
+    {
+        pSlot = I2C_FLASH_GetVictim();
+        if (pSlot != 0)
+        {
+            pSlot->Addr = ReadAddr;
+            pSlot->Length = NumByteToRead;
+            pSlot->Stale = 0;
+            pSlot->Used = 0;
+            pSlot->State = SLOT_PENDING;
+            I2C_FLASH_StartNext();
+        }
+    }
+    __enable_irq();
+}
+
+
+
 /**
   * @brief  Reads a block of data from the FLASH.
   * @param pBuffer : pointer to the buffer that receives the data read
   *   from the FLASH.
   * @param ReadAddr : FLASH's internal address to read from.
-  * @param NumByteToRead : number of bytes to read from the FLASH.
+  * @param NumByteToRead : number of bytes to read from the FLASH, at most
+  *   I2C_FLASH_PAGE_SIZE.
   * @retval : None
   */
 void I2C_FLASH_BufferRead(uint8_t* pBuffer, uint32_t ReadAddr, uint16_t NumByteToRead)
 {
-    uint32_t add_flash;
-    __IO uint32_t  Rx1_Idx=0;
-
-    /*----------------------------1st sequence----------------------------------*/
-    i2c_send_opcode(OPC_READ,I2C1_Buffer_Tx);
-    add_flash = ReadAddr + 0x08000000;
-    i2c_send_add(add_flash,I2C1_Buffer_Tx);
-    i2c_send_byte_number(NumByteToRead,I2C1_Buffer_Tx);
-    /* Initialize the DMA Transmit counter: transmit opcode + address + number of data to be read */
-    DMA1_Channel6->CNDTR = 7;
-    /* Enable DMA1 Channel6 */
+    uint8_t *pData;
+
+    pData = I2C_FLASH_ReadPage(ReadAddr, NumByteToRead);
+    if (pData == 0)
+    {
+        return;
+    }
+    while (NumByteToRead--) /* while there is data to be read */
+    {
+        *pBuffer++ = *pData++;
+    }
+}
+
+
+
+/**
+  * @brief  Number of pages I2C_FLASH_QueueWrite takes without failing.
+  * @param  None
+  * @retval : Free write slots.
+  */
+uint16_t I2C_FLASH_GetFreeSlots(void)
+{
+    return I2C_FLASH_WRITE_SLOTS - TxCount;
+}
+
+
+
+/**
+  * @brief  Estimates how long the host should wait before it comes back.
+  * @param AllWrites : 0 to wait for a free write slot, 1 to wait until
+  *   every queued page is programmed.
+  * @retval : Time in ms, 0 if there is nothing to wait for.
+  */
+uint16_t I2C_FLASH_GetWaitTime(uint8_t AllWrites)
+{
+    uint16_t Time;
+
+    if (AllWrites == 0)
+    {
+        if (TxCount < I2C_FLASH_WRITE_SLOTS)
+        {
+            return 0;
+        }
+    }
+    else if (I2C_FLASH_IsIdle())
+    {
+        return 0;
+    }
+
+    /* What is on the bus now */
+    switch (BusState)
+    {
+    case BUS_WRITE:
+        Time = (uint16_t)((DMA1_Channel6->CNDTR * I2C_FLASH_PAGE_TIME) / BufferSize) + 1;
+        break;
+    case BUS_PROGRAM:
+        Time = HoldOff;
+        break;
+    case BUS_IDLE:
+        Time = 1;
+        break;
+    default:
+        Time = I2C_FLASH_PAGE_TIME;
+        break;
+    }
+    if (AllWrites == 0)
+    {
+        if (BusState == BUS_WRITE)
+        {
+            return Time;
+        }
+        return Time + I2C_FLASH_PAGE_TIME;
+    }
+
+    /* Then every page left in the queue */
+    if (BusState == BUS_WRITE)
+    {
+        Time += I2C_FLASH_PROGRAM_TIME;
+        return Time + (TxCount - 1) * (I2C_FLASH_PAGE_TIME + I2C_FLASH_PROGRAM_TIME);
+    }
+    return Time + TxCount * (I2C_FLASH_PAGE_TIME + I2C_FLASH_PROGRAM_TIME);
+}
+
+
+
+/**
+  * @brief  Tells whether every queued page is written and programmed.
+  * @param  None
+  * @retval : 1 if the bus is idle with no page queued, 0 otherwise.
+  */
+uint8_t I2C_FLASH_IsIdle(void)
+{
+    return (TxCount == 0) && (BusState == BUS_IDLE);
+}
+
+
+
+/**
+  * @brief  Tells whether a queued page was dropped on a bus error or a
+  *   NACK of the target, and clears the indication.
+  * @param  None
+  * @retval : 1 if a page was dropped since the last call, 0 otherwise.
+  */
+uint8_t I2C_FLASH_WriteFailed(void)
+{
+    uint8_t Failed;
+
+    __disable_irq();
+    Failed = WriteFailed;
+    WriteFailed = 0;
+    __enable_irq();
+
+    return Failed;
+}
+
+
+
+/**
+  * @brief  Starts the next transfer if the bus is free: queued pages
+  *   first, then the reads. Called with the I2C interrupts masked or from
+  *   them.
+  * @param  None
+  * @retval : None
+  */
+static void I2C_FLASH_StartNext(void)
+{
+    I2C_FLASH_ReadSlot_TypeDef *pSlot;
+    uint8_t i;
+
+    if (BusState != BUS_IDLE)
+    {
+        return;
+    }
+
+    if (TxCount != 0)
+    {
+        DMA1_Channel6->CMAR = (uint32_t)I2C1_Buffer_Tx[TxHead];
+        DMA1_Channel6->CNDTR = TxLength[TxHead];
+        BusState = BUS_WRITE;
+    }
+    else
+    {
+        for (i = 0; i < I2C_FLASH_READ_SLOTS; i++)
+        {
+            if (I2C1_ReadSlot[i].State == SLOT_PENDING)
+            {
+                break;
+            }
+        }
+        if (i == I2C_FLASH_READ_SLOTS)
+        {
+            return;
+        }
+        ReadSlot = i;
+        pSlot = &I2C1_ReadSlot[i];
+        pSlot->State = SLOT_BUSY;
+        /* Opcode + address + number of data to be read */
+        i2c_send_opcode(OPC_READ, I2C1_Buffer_Cmd);
+        i2c_send_add(pSlot->Addr + 0x08000000, I2C1_Buffer_Cmd);
+        i2c_send_byte_number(pSlot->Length, I2C1_Buffer_Cmd);
+        DMA1_Channel6->CMAR = (uint32_t)I2C1_Buffer_Cmd;
+        DMA1_Channel6->CNDTR = 7;
+        BusState = BUS_READ_CMD;
+    }
+
     DMA_Cmd(DMA1_Channel6, ENABLE);
+    I2C_ITConfig(I2C1, I2C_IT_EVT, ENABLE);
     /* Send I2C1 START condition */
     I2C_GenerateSTART(I2C1, ENABLE);
-    /* Test on I2C1 EV5 and clear it */
-    while (!I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_MODE_SELECT));
-    /* Send I2C2 slave Address for write */
-    I2C_Send7bitAddress(I2C1, I2C_SLAVE_ADDRESS7, I2C_Direction_Transmitter);
-    /* Test on I2C1 EV6 and clear it */
-    while (!I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_TRANSMITTER_MODE_SELECTED));
-    /* DMA1 Channel6 transfer complete test */
-    while (!DMA_GetFlagStatus(DMA1_FLAG_TC6));
-    DMA_ClearFlag(DMA1_FLAG_TC6);
-    while (!I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_BYTE_TRANSMITTED));
-    /* Send I2C1 STOP Condition */
-    I2C_GenerateSTOP(I2C1, ENABLE);
-    DMA_Cmd(DMA1_Channel6, DISABLE);
+}
 
-    /*-------------------------------2nd sequence---------------------------------*/
-    DMA1_Channel7->CNDTR = (BufferSize-8);
 
-    /*Enable the last transfer bit*/
-    I2C_DMALastTransferCmd(I2C1, ENABLE);
-     /* Send I2C1 START condition */
-    I2C_GenerateSTART(I2C1, ENABLE);
-    /* Test on I2C1 EV5 and clear it */
-    while (!I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_MODE_SELECT));
-    /* Send slave Address for write */
-    I2C_Send7bitAddress(I2C1, I2C_SLAVE_ADDRESS7, I2C_Direction_Receiver );
-    /* Test on I2C1 EV7 and clear it */
-    while (!I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_RECEIVER_MODE_SELECTED));
-    DMA_Cmd(DMA1_Channel7, ENABLE);
-    /* DMA1 Channel6 transfer complete test */
-    while (!DMA_GetFlagStatus(DMA1_FLAG_TC7));
-    DMA_ClearFlag(DMA1_FLAG_TC7);
+
+/**
+  * @brief  Looks a page up in the read-ahead ring.
+  * @param ReadAddr : FLASH's internal address.
+  * @param NumByteToRead : number of bytes needed.
+  * @retval : The slot holding or fetching the page, 0 if none.
+  */
+static I2C_FLASH_ReadSlot_TypeDef *I2C_FLASH_FindSlot(uint32_t ReadAddr, uint16_t NumByteToRead)
+{
+    I2C_FLASH_ReadSlot_TypeDef *pSlot;
+    uint8_t i;
+
+    for (i = 0; i < I2C_FLASH_READ_SLOTS; i++)
+    {
+        pSlot = &I2C1_ReadSlot[i];
+        if ((pSlot->State != SLOT_FREE) && (pSlot->State != SLOT_ERROR)
+                && (pSlot->Stale == 0) && (pSlot->Addr == ReadAddr)
+                && (pSlot->Length >= NumByteToRead))
+        {
+            return pSlot;
+        }
+    }
+    return 0;
+}
+
+
+
+/**
+  * @brief  Picks the slot for a new read: a free one, else a page already
+  *   read other than the one last handed out.
+  * @param  None
+  * @retval : The slot, 0 if every slot is in use.
+  */
+static I2C_FLASH_ReadSlot_TypeDef *I2C_FLASH_GetVictim(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < I2C_FLASH_READ_SLOTS; i++)
+    {
+        if ((I2C1_ReadSlot[i].State == SLOT_FREE)
+                || (I2C1_ReadSlot[i].State == SLOT_ERROR))
+        {
+            return &I2C1_ReadSlot[i];
+        }
+    }
+    for (i = 0; i < I2C_FLASH_READ_SLOTS; i++)
+    {
+        if ((I2C1_ReadSlot[i].State == SLOT_READY) && (i != ReadCurrent))
+        {
+            return &I2C1_ReadSlot[i];
+        }
+    }
+    return 0;
+}
+
+
+
+/**
+  * @brief  I2C1 event interrupt: address phase and end of transmission.
+  * @param  None
+  * @retval : None
+  */
+void I2C_FLASH_EV_IRQHandler(void)
+{
+    I2C_FLASH_ReadSlot_TypeDef *pSlot;
+    uint32_t Event;
+
+    /* Reading SR1 then SR2 also clears ADDR */
+    Event = I2C_GetLastEvent(I2C1);
+
+    if ((Event & I2C_EVENT_MASTER_MODE_SELECT) == I2C_EVENT_MASTER_MODE_SELECT)
+    {
+        /* EV5: send the target address */
+        if (BusState == BUS_READ_DATA)
+        {
+            I2C_Send7bitAddress(I2C1, I2C_SLAVE_ADDRESS7, I2C_Direction_Receiver);
+        }
+        else
+        {
+            I2C_Send7bitAddress(I2C1, I2C_SLAVE_ADDRESS7, I2C_Direction_Transmitter);
+        }
+    }
+    else if ((Event & I2C_EVENT_MASTER_BYTE_TRANSMITTED) == I2C_EVENT_MASTER_BYTE_TRANSMITTED)
+    {
+        /* EV8_2: the last byte is out */
+        I2C_ITConfig(I2C1, I2C_IT_EVT, DISABLE);
+        /* Send I2C1 STOP Condition */
+        I2C_GenerateSTOP(I2C1, ENABLE);
+        DMA_Cmd(DMA1_Channel6, DISABLE);
+
+        if (BusState == BUS_WRITE)
+        {
+            I2C_FLASH_Stats.BytesWritten += TxLength[TxHead] - HeaderSize;
+            TxHead = (TxHead + 1) % I2C_FLASH_WRITE_SLOTS;
+            TxCount--;
+            /* The target erases and programs the page before it listens
+               again; the extra tick makes up for the first, partial one */
+            HoldOff = I2C_FLASH_PROGRAM_TIME + 1;
+            BusState = BUS_PROGRAM;
+        }
+        else
+        {
+            /* Read header sent: restart as receiver for the data */
+            pSlot = &I2C1_ReadSlot[ReadSlot];
+            DMA1_Channel7->CMAR = (uint32_t)pSlot->Data;
+            DMA1_Channel7->CNDTR = pSlot->Length;
+            DMA_Cmd(DMA1_Channel7, ENABLE);
+            /*Enable the last transfer bit*/
+            I2C_DMALastTransferCmd(I2C1, ENABLE);
+            BusState = BUS_READ_DATA;
+            I2C_ITConfig(I2C1, I2C_IT_EVT, ENABLE);
+            /* Send I2C1 START condition */
+            I2C_GenerateSTART(I2C1, ENABLE);
+        }
+    }
+    else if (((Event & I2C_EVENT_MASTER_TRANSMITTER_MODE_SELECTED) == I2C_EVENT_MASTER_TRANSMITTER_MODE_SELECTED)
+             || ((Event & I2C_EVENT_MASTER_RECEIVER_MODE_SELECTED) == I2C_EVENT_MASTER_RECEIVER_MODE_SELECTED))
+    {
+        /* EV6: the DMA moves the data from here, its transfer complete
+           interrupt takes over */
+        I2C_ITConfig(I2C1, I2C_IT_EVT, DISABLE);
+    }
+}
+
+
+
+/**
+  * @brief  I2C1 error interrupt: the target did not acknowledge (not in
+  *   IAP mode) or the bus failed. The transfer is dropped and counted.
+  * @param  None
+  * @retval : None
+  */
+void I2C_FLASH_ER_IRQHandler(void)
+{
+    I2C_ClearITPendingBit(I2C1, I2C_IT_AF | I2C_IT_BERR | I2C_IT_ARLO);
+    I2C_ITConfig(I2C1, I2C_IT_EVT, DISABLE);
+    DMA_Cmd(DMA1_Channel6, DISABLE);
     DMA_Cmd(DMA1_Channel7, DISABLE);
+    I2C_DMALastTransferCmd(I2C1, DISABLE);
     /* Send I2C1 STOP Condition */
     I2C_GenerateSTOP(I2C1, ENABLE);
+    I2C_FLASH_Stats.Errors++;
 
-    while (NumByteToRead--) /* while there is data to be read */
+    if (BusState == BUS_WRITE)
     {
-
-        *pBuffer = I2C1_Buffer_Rx[Rx1_Idx++];
-        /* Point to the next location where the byte read will be saved */
-        pBuffer++;
+        TxHead = (TxHead + 1) % I2C_FLASH_WRITE_SLOTS;
+        TxCount--;
+        WriteFailed = 1;
     }
+    else if ((BusState == BUS_READ_CMD) || (BusState == BUS_READ_DATA))
+    {
+        I2C1_ReadSlot[ReadSlot].State = SLOT_ERROR;
+    }
+    else
+    {
+        return;
+    }
+    BusState = BUS_IDLE;
+    I2C_FLASH_StartNext();
+}
+
 
-    /* Reset the receive counter */
-    Rx1_Idx=0;
 
+/**
+  * @brief  DMA1 channel 6 (I2C1 TX) transfer complete interrupt.
+  * @param  None
+  * @retval : None
+  */
+void I2C_FLASH_DMATx_IRQHandler(void)
+{
+    DMA_ClearITPendingBit(DMA1_IT_GL6);
+    /* The last byte is still being shifted out: the STOP follows BTF */
+    I2C_ITConfig(I2C1, I2C_IT_EVT, ENABLE);
 }
 
 
 
 /**
-  * @brief  Writes more than one byte to the FLASH with a single WRITE
-  *   cycle(Page WRITE sequence). The number of byte can't exceed
-  *   the FLASH page size.
-  * @param pBuffer : pointer to the buffer  containing the data to be
-  *   written into the FLASH.
-  * @param WriteAddr : FLASH's internal address to write to.
-  * @param NumByteToWrite : number of bytes to write to the FLASH,
-  *   must be equal or less than "SPI_FLASH_PageSize" value.
+  * @brief  DMA1 channel 7 (I2C1 RX) transfer complete interrupt: the page
+  *   is in its slot.
+  * @param  None
   * @retval : None
   */
-void I2C_FLASH_PageWrite(uint8_t* pBuffer, uint32_t WriteAddr, uint16_t NumByteToWrite)
+void I2C_FLASH_DMARx_IRQHandler(void)
 {
-    uint32_t add_flash;
-    __IO uint32_t Tx1_Idx = 0;
-    /*----------------------------1st sequence----------------------------------*/
-    i2c_send_opcode(OPC_WREN,I2C1_Buffer_Tx);
-    add_flash = WriteAddr + 0x08000000;
-    i2c_send_add(add_flash,I2C1_Buffer_Tx);
-    i2c_send_byte_number(NumByteToWrite,I2C1_Buffer_Tx);
-    /* Dummy byte */
-    I2C1_Buffer_Tx[7] = 0xFF;
-    Tx1_Idx = 0;
-    while (NumByteToWrite--)
-    {
-        /* Send the current byte */
-        I2C1_Buffer_Tx[Tx1_Idx + 8] =*pBuffer;
-        /* Point on the next byte to be written */
-        pBuffer++;
-        Tx1_Idx++;
-    }
-    DMA1_Channel6->CNDTR = BufferSize;
-    /* Enable DMA1 Channel6 */
-    DMA_Cmd(DMA1_Channel6, ENABLE);
-    /* Send I2C1 START condition */
-    I2C_GenerateSTART(I2C1, ENABLE);
-    /* Test on I2C1 EV5 and clear it */
-    while (!I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_MODE_SELECT));
-    /* Send I2C2 slave Address for write */
-    I2C_Send7bitAddress(I2C1, I2C_SLAVE_ADDRESS7, I2C_Direction_Transmitter);
-    /* Test on I2C1 EV6 and clear it */
-    while (!I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_TRANSMITTER_MODE_SELECTED));
-    /* DMA1 Channel6 transfer complete test */
-    while (!DMA_GetFlagStatus(DMA1_FLAG_TC6));
-    DMA_ClearFlag(DMA1_FLAG_TC6);
-    while (!I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_BYTE_TRANSMITTED));
+    I2C_FLASH_ReadSlot_TypeDef *pSlot = &I2C1_ReadSlot[ReadSlot];
+
+    DMA_ClearITPendingBit(DMA1_IT_GL7);
+    DMA_Cmd(DMA1_Channel7, DISABLE);
     /* Send I2C1 STOP Condition */
     I2C_GenerateSTOP(I2C1, ENABLE);
-    DMA_Cmd(DMA1_Channel6, DISABLE);
+    I2C_DMALastTransferCmd(I2C1, DISABLE);
+
+    I2C_FLASH_Stats.BytesRead += pSlot->Length;
+    if (pSlot->Stale)
+    {
+        pSlot->State = SLOT_FREE;
+    }
+    else
+    {
+        pSlot->State = SLOT_READY;
+    }
+    BusState = BUS_IDLE;
+    I2C_FLASH_StartNext();
+}
 
 
 
+/**
+  * @brief  1 ms tick: ends the hold-off of the target programming time
+  *   and keeps the time counters.
+  * @param  None
+  * @retval : None
+  */
+void I2C_FLASH_TimingHandler(void)
+{
+    I2C_FLASH_Stats.Time++;
+    if (BusState == BUS_PROGRAM)
+    {
+        I2C_FLASH_Stats.ProgramTime++;
+        if (--HoldOff == 0)
+        {
+            BusState = BUS_IDLE;
+            I2C_FLASH_StartNext();
+        }
+    }
+    else if (BusState != BUS_IDLE)
+    {
+        I2C_FLASH_Stats.BusTime++;
+    }
 }
 
 
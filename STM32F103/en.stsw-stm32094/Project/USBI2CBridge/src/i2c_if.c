@@ -64,7 +64,7 @@ uint16_t I2C_If_Erase(uint32_t SectorAddress)
 
 
 /**
-  * @brief  Write sectors
+  * @brief  Write sectors: the page is queued and written in the background
   * @param  None
   * @retval : None
   */
@@ -72,16 +72,16 @@ uint16_t I2C_If_Write(uint32_t SectorAddress, uint32_t DataLength)
 {
     uint32_t idx;
 
-   if  (DataLength < 0x400) 
+   if  (DataLength < I2C_FLASH_PAGE_SIZE) 
     {
-        for ( idx = DataLength; idx < 0x400 ; idx++)
+        for ( idx = DataLength; idx < I2C_FLASH_PAGE_SIZE ; idx++)
         {
             MAL_Buffer[idx] = 0xFF;
         }
 
     }
 
-    I2C_FLASH_PageWrite(&MAL_Buffer[0], SectorAddress, 0x400);
+    I2C_FLASH_PageWrite(&MAL_Buffer[0], SectorAddress, I2C_FLASH_PAGE_SIZE);
 
     return MAL_OK;
 }
@@ -89,15 +89,105 @@ uint16_t I2C_If_Write(uint32_t SectorAddress, uint32_t DataLength)
 
 
 /**
-  * @brief  Read sectors
+  * @brief  Write data from a buffer, as it is (no padding to a page)
   * @param  None
-  * @retval : buffer address pointer
+  * @retval : None
+  */
+uint16_t I2C_If_WriteData(uint32_t SectorAddress, uint8_t *pBuffer, uint32_t DataLength)
+{
+    if (DataLength > I2C_FLASH_PAGE_SIZE)
+    {
+        return MAL_FAIL;
+    }
+
+    I2C_FLASH_PageWrite(pBuffer, SectorAddress, (uint16_t)DataLength);
+
+    return MAL_OK;
+}
+
+
+
+/**
+  * @brief  Tells whether a write is queued without waiting
+  * @param  None
+  * @retval : MAL_OK or MAL_FAIL
+  */
+uint16_t I2C_If_WriteReady(uint32_t SectorAddress)
+{
+    if (I2C_FLASH_GetFreeSlots() == 0)
+    {
+        return MAL_FAIL;
+    }
+
+    return MAL_OK;
+}
+
+
+
+/**
+  * @brief  Tells whether every queued write is programmed
+  * @param  None
+  * @retval : MAL_OK, MAL_BUSY while writing or MAL_FAIL if a page was
+  *   dropped since the last call
+  */
+uint16_t I2C_If_WriteDone(uint32_t SectorAddress)
+{
+    if (I2C_FLASH_IsIdle() == 0)
+    {
+        return MAL_BUSY;
+    }
+
+    if (I2C_FLASH_WriteFailed() != 0)
+    {
+        return MAL_FAIL;
+    }
+
+    return MAL_OK;
+}
+
+
+
+/**
+  * @brief  Read sectors through the read-ahead ring, and start reading the
+  *   next ones
+  * @param  None
+  * @retval : buffer address pointer, 0 if the target did not answer
   */
 uint8_t *I2C_If_Read(uint32_t SectorAddress, uint32_t DataLength)
 {
-    I2C_FLASH_BufferRead(MAL_Buffer, SectorAddress, (uint16_t)DataLength);
+    uint8_t *pData;
+
+    pData = I2C_FLASH_ReadPage(SectorAddress, (uint16_t)DataLength);
+    if (pData != 0)
+    {
+        I2C_FLASH_Prefetch(SectorAddress + DataLength, (uint16_t)DataLength);
+    }
+
+    return pData;
+}
+
+
+
+/**
+  * @brief  Poll time of the DFU GETSTATUS answer
+  * @param Cmd : 0 erase, 1 write, 2 end of download
+  * @retval : Time in ms
+  */
+uint16_t I2C_If_GetTiming(uint8_t Cmd)
+{
+    if (Cmd == 1)
+    {
+        /* Until a write slot frees */
+        return I2C_FLASH_GetWaitTime(0);
+    }
+    else if (Cmd == 2)
+    {
+        /* Until the last queued page is programmed */
+        return I2C_FLASH_GetWaitTime(1);
+    }
 
-    return MAL_Buffer;
+    /* Nothing to erase: the target erases each page as it writes it */
+    return 0;
 }
 
 
@@ -27,6 +27,7 @@
 #include "usb_istr.h"
 #include "usb_prop.h"
 #include "usb_pwr.h"
+#include "i2c_flash.h"
 
 /** @addtogroup USBI2CBridge
   * @{
@@ -158,6 +159,7 @@ void PendSV_Handler(void)
   */
 void SysTick_Handler(void)
 {
+  I2C_FLASH_TimingHandler();
 }
 
 /******************************************************************************/
@@ -193,6 +195,46 @@ void OTG_FS_IRQHandler(void)
 }
 #endif /* STM32F10X_CL */
 
+/**
+  * @brief  This function handles I2C1 event interrupt request.
+  * @param  None
+  * @retval : None
+  */
+void I2C1_EV_IRQHandler(void)
+{
+  I2C_FLASH_EV_IRQHandler();
+}
+
+/**
+  * @brief  This function handles I2C1 error interrupt request.
+  * @param  None
+  * @retval : None
+  */
+void I2C1_ER_IRQHandler(void)
+{
+  I2C_FLASH_ER_IRQHandler();
+}
+
+/**
+  * @brief  This function handles DMA1 Channel 6 (I2C1 TX) interrupt request.
+  * @param  None
+  * @retval : None
+  */
+void DMA1_Channel6_IRQHandler(void)
+{
+  I2C_FLASH_DMATx_IRQHandler();
+}
+
+/**
+  * @brief  This function handles DMA1 Channel 7 (I2C1 RX) interrupt request.
+  * @param  None
+  * @retval : None
+  */
+void DMA1_Channel7_IRQHandler(void)
+{
+  I2C_FLASH_DMARx_IRQHandler();
+}
+
 /******************************************************************************/
 /*                 STM32F10x Peripherals Interrupt Handlers                   */
 /*  Add here the Interrupt Handler for the used peripheral(s) (GlassLCD), for the  */
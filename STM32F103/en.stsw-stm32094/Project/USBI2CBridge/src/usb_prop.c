@@ -27,6 +27,7 @@
 #include "usb_desc.h"
 #include "usb_pwr.h"
 #include "dfu_mal.h"
+#include "i2c_flash.h"
 
 
 
@@ -44,6 +45,7 @@
 uint32_t wBlockNum = 0, wlength = 0;
 uint32_t Manifest_State = Manifest_complete;
 uint32_t Pointer = ApplicationAddress;  /* Base Address to Erase, Program or Read */
+uint32_t BatchOffset = 0;  /* Next record of a CMD_BATCH block */
 
 DEVICE Device_Table =
   {
@@ -108,6 +110,8 @@ extern  uint8_t DeviceState ;
 extern  uint8_t DeviceStatus[6];
 
 /* Private function prototypes -----------------------------------------------*/
+static RESULT DFU_Batch(void);
+
 /* Private functions ---------------------------------------------------------*/
 
 
@@ -225,6 +229,8 @@ void DFU_Status_Out (void)
 {
   DEVICE_INFO *pInfo = &Device_Info;
   uint32_t Addr;
+  RESULT Result;
+  uint16_t Status;
 
   if (pInfo->USBbRequest == DFU_GETSTATUS)
   {
@@ -249,11 +255,42 @@ void DFU_Status_Out (void)
           Pointer += MAL_Buffer[4] << 24;
           MAL_Erase(Pointer);
         }
+        else if (MAL_Buffer[0] == CMD_BATCH)
+        {
+          Result = DFU_Batch();
+          if (Result == USB_NOT_READY)
+          {
+            /* Write queue full: stay busy, the host comes back */
+            I2C_FLASH_Stats.QueueFull++;
+            MAL_GetStatus(Pointer, 1, DeviceStatus);
+            return;
+          }
+          else if (Result != USB_SUCCESS)
+          {
+            wlength = 0;
+            wBlockNum = 0;
+            DeviceState = STATE_dfuERROR;
+            DeviceStatus[0] = STATUS_ERRFILE;
+            DeviceStatus[4] = DeviceState;
+            DeviceStatus[1] = 0;
+            DeviceStatus[2] = 0;
+            DeviceStatus[3] = 0;
+            return;
+          }
+          I2C_FLASH_Stats.Batches++;
+        }
       }
 
       else if (wBlockNum > 1)  // Download Command
       {
         Addr = ((wBlockNum - 2) * wTransferSize) + Pointer;
+        if (MAL_WriteReady(Addr) != MAL_OK)
+        {
+          /* Write queue full: stay busy, the host comes back */
+          I2C_FLASH_Stats.QueueFull++;
+          MAL_GetStatus(Addr, 1, DeviceStatus);
+          return;
+        }
         MAL_Write(Addr, wlength);
       }
       wlength = 0;
@@ -268,6 +305,25 @@ void DFU_Status_Out (void)
     }
     else if (DeviceState == STATE_dfuMANIFEST)/* Manifestation in progress*/
     {
+      Status = MAL_WriteDone(Pointer);
+      if (Status == MAL_BUSY)
+      {
+        /* Queued blocks are still being written */
+        MAL_GetStatus(Pointer, 2, DeviceStatus);
+        return;
+      }
+      else if (Status != MAL_OK)
+      {
+        /* A queued block did not reach the media */
+        Manifest_State = Manifest_complete;
+        DeviceState = STATE_dfuERROR;
+        DeviceStatus[0] = STATUS_ERRWRITE;
+        DeviceStatus[4] = DeviceState;
+        DeviceStatus[1] = 0;
+        DeviceStatus[2] = 0;
+        DeviceStatus[3] = 0;
+        return;
+      }
       DFU_write_crc();
       return;
     }
@@ -519,7 +575,7 @@ uint8_t *UPLOAD(uint16_t Length)
 
   if (wBlockNum == 0)  /* Get Command */
   {
-    if (wlength > 3)
+    if (wlength > 4)
     {
       DeviceState = STATE_dfuIDLE ;
     }
@@ -536,15 +592,31 @@ uint8_t *UPLOAD(uint16_t Length)
     MAL_Buffer[0] = CMD_GETCOMMANDS;
     MAL_Buffer[1] = CMD_SETADDRESSPOINTER;
     MAL_Buffer[2] = CMD_ERASE;
+    MAL_Buffer[3] = CMD_BATCH;
 
     if (Length == 0)
     {
-      pInformation->Ctrl_Info.Usb_wLength = 3 ;
+      pInformation->Ctrl_Info.Usb_wLength = 4 ;
       return NULL;
     }
 
     return(&MAL_Buffer[0]);
   }
+  else if (wBlockNum == 1)  /* Transfer counters */
+  {
+    DeviceState = STATE_dfuUPLOAD_IDLE ;
+    DeviceStatus[4] = DeviceState;
+    DeviceStatus[1] = 0;
+    DeviceStatus[2] = 0;
+    DeviceStatus[3] = 0;
+
+    if (Length == 0)
+    {
+      pInformation->Ctrl_Info.Usb_wLength = sizeof(I2C_FLASH_Stats) - offset ;
+      return NULL;
+    }
+    return((uint8_t*)&I2C_FLASH_Stats + offset);
+  }
   else if (wBlockNum > 1)
   {
     DeviceState = STATE_dfuUPLOAD_IDLE ;
@@ -555,6 +627,15 @@ uint8_t *UPLOAD(uint16_t Length)
     Addr = ((wBlockNum - 2) * wTransferSize) + Pointer;  /* Change is Accelerated*/
 
     Phy_Addr = MAL_Read(Addr, wlength);
+    if (Phy_Addr == NULL)
+    {
+      /* The target did not answer: stall the request */
+      DeviceState = STATE_dfuERROR;
+      DeviceStatus[0] = STATUS_ERRUNKNOWN;
+      DeviceStatus[4] = DeviceState;
+      pInformation->Ctrl_Info.Usb_wLength = 0 ;
+      return NULL;
+    }
     returned = wlength - offset;
 
     if (Length == 0)
@@ -643,11 +724,28 @@ uint8_t *GETSTATE(uint16_t Length)
   */
 uint8_t *GETSTATUS(uint16_t Length)
 {
+  uint32_t Addr;
+
   switch (DeviceState)
   {
     case   STATE_dfuDNLOAD_SYNC:
-      if (wlength != 0)
+      Addr = ((wBlockNum - 2) * wTransferSize) + Pointer;
+      if ((wlength != 0) && (wBlockNum > 1) && (MAL_WriteReady(Addr) == MAL_OK))
       {
+        /* The block goes straight into the write queue: the host may send
+           the next one at once, without the busy round trip */
+        MAL_Write(Addr, wlength);
+        wlength = 0;
+        wBlockNum = 0;
+        DeviceState = STATE_dfuDNLOAD_IDLE;
+        DeviceStatus[4] = DeviceState;
+        DeviceStatus[1] = 0;
+        DeviceStatus[2] = 0;
+        DeviceStatus[3] = 0;
+      }
+      else if (wlength != 0)
+      {
+        BatchOffset = 1;
         DeviceState = STATE_dfuDNBUSY;
         DeviceStatus[4] = DeviceState;
         if ((wBlockNum == 0) && (MAL_Buffer[0] == CMD_ERASE))
@@ -705,6 +803,75 @@ uint8_t *GETSTATUS(uint16_t Length)
 
 
 
+/**
+  * @brief  Runs the records of a CMD_BATCH block, from BatchOffset on:
+  *   CMD_SETADDRESSPOINTER or CMD_ERASE followed by a 4-byte address, and
+  *   CMD_WRITEMEMORY followed by a 4-byte address, a 2-byte count and the
+  *   data, all little endian. One block replaces a round trip per command.
+  * @param ne.
+  * @retval : USB_SUCCESS when done, USB_NOT_READY when the write queue is
+  *   full (call again), USB_ERROR on a malformed record.
+  */
+static RESULT DFU_Batch(void)
+{
+  uint8_t *pRecord;
+  uint32_t Addr;
+  uint32_t Count;
+
+  while (BatchOffset < wlength)
+  {
+    pRecord = &MAL_Buffer[BatchOffset];
+    if ((BatchOffset + 5) > wlength)
+    {
+      return USB_ERROR;
+    }
+    Addr  = pRecord[1];
+    Addr += pRecord[2] << 8;
+    Addr += pRecord[3] << 16;
+    Addr += pRecord[4] << 24;
+
+    if (pRecord[0] == CMD_SETADDRESSPOINTER)
+    {
+      Pointer = Addr;
+      BatchOffset += 5;
+    }
+    else if (pRecord[0] == CMD_ERASE)
+    {
+      MAL_Erase(Addr);
+      BatchOffset += 5;
+    }
+    else if (pRecord[0] == CMD_WRITEMEMORY)
+    {
+      if ((BatchOffset + 7) > wlength)
+      {
+        return USB_ERROR;
+      }
+      Count  = pRecord[5];
+      Count += pRecord[6] << 8;
+      if ((BatchOffset + 7 + Count) > wlength)
+      {
+        return USB_ERROR;
+      }
+      if (MAL_WriteReady(Addr) != MAL_OK)
+      {
+        return USB_NOT_READY;
+      }
+      if (MAL_WriteData(Addr, &pRecord[7], Count) != MAL_OK)
+      {
+        return USB_ERROR;
+      }
+      BatchOffset += 7 + Count;
+    }
+    else
+    {
+      return USB_ERROR;
+    }
+  }
+  return USB_SUCCESS;
+}
+
+
+
 /**
   * @brief  DFU Write CRC routine.
   * @param ne.
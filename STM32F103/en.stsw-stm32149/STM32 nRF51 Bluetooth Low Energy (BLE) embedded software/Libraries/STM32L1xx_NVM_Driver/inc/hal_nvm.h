@@ -49,7 +49,7 @@
 
 /* Exported constants --------------------------------------------------------*/
 #define	NVM_OPERATION_QUEUE_SIZE		30							/* Queue of Write command */
-#define NVM_BASE_ADDRESS				0x08082460					/* Bank2 - After the memory (1120 bytes) reserved for BLE */
+#define NVM_BASE_ADDRESS				0x08082800					/* Bank2 - After the memory (2048 bytes) reserved for BLE */
 #define NVM_IT_PRIORITY					3
 
  /**
@@ -74,6 +74,7 @@
  void HAL_NVM_Read(uint8_t *UserAddress, uint8_t *NVMAddress, uint16_t Size);
  void HAL_NVM_Operation(eNVM_Operation_t eOperation, uint8_t *UserAddress, uint8_t *NVMAddress, uint16_t Size);
  void HAL_NVM_HSclkRequest(eHAL_NVM_HSclkMode_t eHSclkMode);
+ uint8_t HAL_NVM_GetPendingOperations(void);
 
 #ifdef __cplusplus
 }
@@ -248,6 +248,20 @@ void HAL_NVM_Read(uint8_t *UserAddress, uint8_t *NVMAddress, uint16_t Size)
 	return;
 }
 
+/**
+  * @brief  Interface to the user to know whether queued operations are still running
+  *
+  * @note	The source data of a write operation may be reused once this returns 0
+  *
+  * @param  None
+  *
+  * @retval Number of Write or Erase operations not completed yet
+  */
+uint8_t HAL_NVM_GetPendingOperations(void)
+{
+	return NumberOfPendingCommand;
+}
+
 /**
   * @brief  Flash interrupt handler
   *
@@ -43,6 +43,7 @@
  * This allows RWW (Read While Write) feature to improve performance of the system
  */
 #define BLE_NVM_BASE_ADDRESS		0x08082000
+#define BLE_NVM_SIZE				0x800		/**< Up to NVM_BASE_ADDRESS, where the NVM driver users start */
 
 /* Private variables ---------------------------------------------------------*/
 static uint16_t aBlockSizeList[3];				/**< Only 3 BLE modules Id supported */
@@ -63,6 +64,12 @@ uint32_t pstorage_init(void)
 uint32_t pstorage_register(pstorage_module_param_t * p_module_param,
                            pstorage_handle_t       * p_block_id)
 {
+	if(pCurrentPointerToNVMLocation + (p_module_param->block_size)*(p_module_param->block_count) >
+	   (uint8_t *)(BLE_NVM_BASE_ADDRESS + BLE_NVM_SIZE))
+	{
+		return NRF_ERROR_NO_MEM;
+	}
+
 	p_block_id->block_id = (uint32_t)pCurrentPointerToNVMLocation;
 	(p_block_id->module_id) = ModuleId;
 	 /*
@@ -106,6 +113,18 @@ uint32_t pstorage_load(uint8_t *           p_dest,
     return NRF_SUCCESS;
 }
 
+uint32_t pstorage_access_status_get(uint32_t * p_count)
+{
+	if(p_count == 0)
+	{
+		return NRF_ERROR_NULL;
+	}
+
+	*p_count = HAL_NVM_GetPendingOperations();
+
+    return NRF_SUCCESS;
+}
+
 uint32_t pstorage_clear(pstorage_handle_t * p_dest, pstorage_size_t size)
 {
 	HAL_NVM_Operation(eNVM_Clear, 0, (uint8_t *)(p_dest->block_id), aBlockSizeList[p_dest->module_id] * size);
@@ -87,10 +87,12 @@
  *          The bond manager provides the API @ref ble_bondmngr_sys_attr_store to allow the
  *          application to write the System Attributes to flash while in a connection. Your
  *          application should call this API when it considers that all CCCDs and other persistent
- *          attributes are in a stable state. This API call will safely fail if System Attributes
- *          data for the current connected central is already present in the flash. The API does so
- *          because a flash write in such a situation would require an erase of flash, which takes a
- *          long time (21 milliseconds) to complete. This may disrupt the radio.
+ *          attributes are in a stable state.
+ *
+ *          Bonding Information and System Attributes are kept in a log in NVM: a change only
+ *          appends a record for the central concerned, written in the background by the NVM
+ *          driver. When the log is full, the live data is copied to a second log area, which only
+ *          waits for the writes already queued.
  *
  *          Applications using the Bond Manager must have a configuration file named
  *          ble_bondmngr_cfg.h (see below for details).
@@ -228,8 +230,8 @@ void ble_bondmngr_on_ble_evt(ble_evt_t * p_ble_evt);
 /**@brief Function for storing the bonded centrals data including bonding info and System Attributes into
  *          flash memory.
  *
- * @details If the data to be written is different from the existing data, this function erases the
- *          flash pages before writing to flash.
+ * @details Only the Bonding Information and System Attributes that differ from those stored are
+ *          written, as records appended to the bond log.
  *
  * @warning This function could prevent the radio from running. Therefore it MUST be called ONLY
  *          when the application knows that the <i>Bluetooth</i> radio is not active. An example of
@@ -275,17 +277,15 @@ uint32_t ble_bondmngr_central_addr_get(int8_t central_handle, ble_gap_addr_t * p
 /**@brief Function for storing the System Attributes of a newly connected central.
  *
  * @details This function fetches the System Attributes of the current central from the stack, adds
- *          it to the database in memory, and also stores it in the flash (without erasing any
- *          flash page).
- *          This function is intended to facilitate the storage of System Attributes when connected
- *          to new central (whose System Attributes are NOT yet stored in flash) even in connected
+ *          it to the database in memory, and also stores it in the flash by appending a record to
+ *          the bond log, if they changed.
+ *          This function is intended to facilitate the storage of System Attributes in connected
  *          state without affecting radio link. This function can, for example, be called after the
- *          CCCD is written by a central. The function will succeed if the central is a new central.
+ *          CCCD is written by a central, also for a previously known central.
  *          See @ref ble_sdk_app_hids_keyboard or @ref ble_sdk_app_hids_mouse for sample usage.
  *
  * @return  NRF_SUCCESS on success, otherwise an error code.
- *          NRF_ERROR_INVALID_STATE is returned if the System Attributes of the current central is
- *          already present in the flash because it is a previously known central.
+ *          NRF_ERROR_INVALID_STATE is returned if the current central is not bonded.
  */
 uint32_t ble_bondmngr_sys_attr_store(void);
 
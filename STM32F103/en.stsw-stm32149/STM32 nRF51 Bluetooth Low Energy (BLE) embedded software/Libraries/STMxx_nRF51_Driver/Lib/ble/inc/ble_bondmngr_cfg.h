@@ -51,6 +51,10 @@
 /**@brief Maximum number of bonded centrals. */
 #define BLE_BONDMNGR_MAX_BONDED_CENTRALS   7
 
+/**@brief Size of each of the two halves of the bond log in NVM. Must hold all bonded centrals
+ *        with room to spare; the rest is filled with updates before the log is compacted. */
+#define BLE_BONDMNGR_LOG_HALF_SIZE         1024
+
 /**< Bit mask that defines an empty address in flash. */
 #define PSTORAGE_FLASH_EMPTY_MASK    0x00000000  
 
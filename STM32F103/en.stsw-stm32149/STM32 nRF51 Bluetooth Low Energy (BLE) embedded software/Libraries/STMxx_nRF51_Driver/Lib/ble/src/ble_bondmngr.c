@@ -34,6 +34,7 @@
 
 #include "ble_bondmngr.h"
 #include <stdlib.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <string.h>
 #include "ble_util.h"
@@ -49,8 +50,8 @@
 #define CRC_SIZE                     2                                                                   /**< Size of CRC in sys_attribute data. */
 #define SYS_ATTR_BUFFER_MAX_LEN      (((BLE_BONDMNGR_CCCD_COUNT + 1) * CCCD_SIZE) + CRC_SIZE)            /**< Size of sys_attribute data. */
 #define MAX_NUM_CENTRAL_WHITE_LIST   MIN(BLE_BONDMNGR_MAX_BONDED_CENTRALS, 8)                            /**< Maximum number of whitelisted centrals supported.*/
-#define MAX_BONDS_IN_FLASH           10                                                                  /**< Maximum number of bonds that can be stored in flash. */
-#define BOND_MANAGER_DATA_SIGNATURE  0x53240000
+#define BOND_MANAGER_DATA_SIGNATURE  0x53240000                                                          /**< Block header signature of the layout used before the log. */
+#define LOG_HEADER_SIGNATURE         0x4C470000                                                          /**< Log half header signature, distinct from the old block headers. */
 
 /**@defgroup ble_bond_mngr_sec_access  Bond Manager Security Status Access Macros
  * @brief    The following group of macros abstract access to Security Status with a peer.
@@ -192,6 +193,72 @@ typedef struct
     ble_gap_irk_t  * p_irk;                                                 /**< Pointer to the central's irk if available. */
 } whitelist_irk_t;
 
+/**@defgroup ble_bond_mngr_log  Bond Manager Log Store
+ * @brief    Bonding Information and System Attributes are kept in an append-only log.
+ *
+ * @details  The log has two halves. The active one starts with a header word holding the
+ *           signature and a generation number, followed by records. A change to one central only
+ *           appends a record for that central. When the active half is full, the live database is
+ *           written to the other half under the next generation, and the header word is written
+ *           last, so after a reset the old half stays valid until the new one is complete. At
+ *           startup the half with the newest valid header is replayed; the log ends at the first
+ *           record of another generation.
+ *
+ *           The NVM driver writes in the background from a RAM image of the active half, in which
+ *           each byte is written only once per generation.
+ * @{
+ */
+
+#define LOG_RECORD_BOND              0x01                                                                /**< Bonding Information of a central. */
+#define LOG_RECORD_SYS_ATTR          0x02                                                                /**< System Attributes of a central, sys_attr_size bytes. */
+#define LOG_RECORD_DELETE            0x03                                                                /**< Central removed, the following handles move down by one. */
+#define LOG_NOT_STORED               0                                                                   /**< Nothing in the log for this central yet. */
+
+/**@brief Header of one log record, followed by the data padded to a multiple of 4 bytes.
+ */
+typedef struct
+{
+    uint8_t  type;                                                           /**< LOG_RECORD_*, 0 in unused NVM. */
+    uint8_t  central_handle;                                                 /**< Central the record applies to. */
+    uint16_t size;                                                           /**< Size of the data. */
+    uint16_t gen;                                                            /**< Generation of the log half. */
+    uint16_t crc;                                                            /**< CRC of the data and header. */
+} log_record_t;
+
+STATIC_ASSERT(sizeof(log_record_t) % 4 == 0);
+
+#define LOG_RECORD_SIZE(DATA_SIZE)   (sizeof(log_record_t) + (((DATA_SIZE) + 3) & ~3U))                  /**< NVM used by a record. */
+#define LOG_LIVE_MAX_SIZE            (sizeof(uint32_t) + BLE_BONDMNGR_MAX_BONDED_CENTRALS *              \
+                                      (LOG_RECORD_SIZE(sizeof(central_bond_t)) +                        \
+                                       LOG_RECORD_SIZE(SYS_ATTR_BUFFER_MAX_LEN)))                       /**< Log half holding a full database. */
+
+// A full database must leave room for at least one more record, or every change would compact.
+STATIC_ASSERT(LOG_LIVE_MAX_SIZE + LOG_RECORD_SIZE(sizeof(central_bond_t)) <= BLE_BONDMNGR_LOG_HALF_SIZE);
+
+/** @} */
+
+/**@defgroup ble_bond_mngr_legacy  Bond Manager Legacy Layout
+ * @brief    Layout of the NVM area before the log, read once to migrate existing bonds.
+ *
+ * @details  The area started with LEGACY_BONDS_IN_FLASH Bonding Information blocks, followed by
+ *           as many System Attributes blocks. Each block is a header word holding
+ *           BOND_MANAGER_DATA_SIGNATURE and a CRC chained over all earlier blocks of its kind,
+ *           then the data. Every change cleared the area and rewrote the whole database.
+ * @{
+ */
+
+#define LEGACY_BONDS_IN_FLASH        10                                                                  /**< Blocks of each kind. */
+#define LEGACY_BOND_BLOCK_SIZE       (sizeof(uint32_t) + sizeof(central_bond_t))                          /**< Size of a Bonding Information block. */
+#define LEGACY_SYS_ATTR_BLOCK_SIZE   (sizeof(uint32_t) + sizeof(central_sys_attr_t))                      /**< Size of a System Attributes block. */
+#define LEGACY_SYS_ATTR_BASE         (LEGACY_BONDS_IN_FLASH * LEGACY_BOND_BLOCK_SIZE)                     /**< Offset of the first System Attributes block. */
+
+// Live legacy data must lie within log half 0, so that migrating into half 1 leaves it intact
+// until the new log is complete.
+STATIC_ASSERT(LEGACY_SYS_ATTR_BASE + BLE_BONDMNGR_MAX_BONDED_CENTRALS * LEGACY_SYS_ATTR_BLOCK_SIZE <=
+              BLE_BONDMNGR_LOG_HALF_SIZE);
+
+/** @} */
+
 static bool                m_is_bondmngr_initialized = false;               /**< Flag for checking if module has been initialized. */
 static ble_bondmngr_init_t m_bondmngr_config;                               /**< Configuration as specified by the application. */
 static uint16_t            m_conn_handle;                                   /**< Current connection handle. */
@@ -202,375 +269,365 @@ static whitelist_addr_t    m_whitelist_addr[MAX_NUM_CENTRAL_WHITE_LIST];    /**<
 static whitelist_irk_t     m_whitelist_irk[MAX_NUM_CENTRAL_WHITE_LIST];     /**< List of central's IRKs  for the whitelist. */
 static uint8_t             m_addr_count;                                    /**< Number of addresses in the whitelist. */
 static uint8_t             m_irk_count;                                     /**< Number of IRKs in the whitelist. */
-static uint16_t            m_crc_bond_info;                                 /**< Combined CRC for all Bonding Information currently stored in flash. */
-static uint16_t            m_crc_sys_attr;                                  /**< Combined CRC for all System Attributes currently stored in flash. */
-static pstorage_handle_t   mp_flash_bond_info;                              /**< Pointer to flash location to write next Bonding Information. */
-static pstorage_handle_t   mp_flash_sys_attr;                               /**< Pointer to flash location to write next System Attribute information. */
-static uint8_t             m_bond_info_in_flash_count;                      /**< Number of Bonding Information currently stored in flash. */
-static uint8_t             m_sys_attr_in_flash_count;                       /**< Number of System Attributes currently stored in flash. */
+static pstorage_handle_t   mp_flash_log;                                    /**< Base of the two log halves in flash. */
+static uint32_t            m_log_image[BLE_BONDMNGR_LOG_HALF_SIZE / sizeof(uint32_t)]; /**< RAM image of the active log half, source of the queued writes. */
+static uint8_t             m_log_half;                                      /**< Active log half. */
+static uint16_t            m_log_gen;                                       /**< Generation of the active log half. */
+static uint16_t            m_log_used;                                      /**< Bytes used in the active log half. */
 static uint8_t             m_sec_con_status;                                /**< Variable to denote security status.*/
 static bool                m_bond_loaded;                                   /**< Variable to indicate if the bonding information of the currently connected central is available in the RAM.*/
 static bool                m_sys_attr_loaded;                               /**< Variable to indicate if the system attribute information of the currently connected central is loaded from the database and set in the S110 SoftDevice.*/
-static uint32_t            m_bond_crc_array[BLE_BONDMNGR_MAX_BONDED_CENTRALS];
-static uint32_t            m_sys_crc_array[BLE_BONDMNGR_MAX_BONDED_CENTRALS];
+static uint16_t            m_bond_record[BLE_BONDMNGR_MAX_BONDED_CENTRALS];     /**< Offset of each central's latest Bonding Information record in the active log half, LOG_NOT_STORED if none. */
+static uint16_t            m_sys_attr_record[BLE_BONDMNGR_MAX_BONDED_CENTRALS]; /**< Offset of each central's latest System Attributes record in the active log half, LOG_NOT_STORED if none. */
 
-/**@brief      Function for extracting the CRC from an encoded 32 bit number that typical resides in
- *             the flash memory
- *
- * @param[in]  header   Header containing CRC and magic number.
- * @param[out] p_crc    Extracted CRC.
- *
- * @retval      NRF_SUCCESS              CRC successfully extracted.
- * @retval      NRF_ERROR_NOT_FOUND      Flash seems to be empty.
- * @retval      NRF_ERROR_INVALID_DATA   Header does not contain the magic number.
+/**@brief      Function for computing the CRC of a record, over the header and the data.
  */
-static uint32_t crc_extract(uint32_t header, uint16_t * p_crc)
+static uint16_t log_record_crc(const log_record_t * p_record, const uint8_t * p_data)
 {
-    if ((header & 0xFFFF0000U) == BOND_MANAGER_DATA_SIGNATURE)
-    {
-        *p_crc = (uint16_t)(header & 0x0000FFFFU);
+    uint16_t crc = crc16_compute((uint8_t *)p_record, offsetof(log_record_t, crc), NULL);
 
-        return NRF_SUCCESS;
-    }
-    else if (header == PSTORAGE_FLASH_EMPTY_MASK)
-    {
-        return NRF_ERROR_NOT_FOUND;
-    }
-    else
-    {
-        return NRF_ERROR_INVALID_DATA;
-    }
+    return crc16_compute(p_data, p_record->size, &crc);
 }
 
 
-/**@brief      Function for storing the Bonding Information of the specified central to the flash.
+/**@brief      Function for checking whether a record in the active log half holds the given data.
+ */
+static bool log_record_matches(uint16_t offset, const uint8_t * p_data, uint16_t size)
+{
+    const log_record_t * p_record = (const log_record_t *)((uint8_t *)m_log_image + offset);
+
+    return (offset != LOG_NOT_STORED)  &&
+           (p_record->size == size)    &&
+           (memcmp(p_record + 1, p_data, size) == 0);
+}
+
+
+/**@brief      Function for building a record in the RAM image of the active log half.
  *
- * @param[in]  p_bond   Bonding information to be stored.
+ * @param[in]  offset           Position of the record in the log half.
+ * @param[in]  type             LOG_RECORD_*.
+ * @param[in]  central_handle   Central the record applies to.
+ * @param[in]  p_data           Record data.
+ * @param[in]  size             Size of the data.
  *
- * @return     NRF_SUCCESS on success, an error_code otherwise.
+ * @return     NVM used by the record.
  */
-static uint32_t bond_info_store(central_bond_t * p_bond)
+static uint16_t log_record_build(uint16_t        offset,
+                                 uint8_t         type,
+                                 uint8_t         central_handle,
+                                 const uint8_t * p_data,
+                                 uint16_t        size)
 {
-    uint32_t err_code;
-    pstorage_handle_t dest_block;
+    uint8_t      * p_image     = (uint8_t *)m_log_image;
+    log_record_t * p_record    = (log_record_t *)(p_image + offset);
+    uint16_t       record_size = LOG_RECORD_SIZE(size);
 
-    // Check if flash is full
-    if (m_bond_info_in_flash_count >= MAX_BONDS_IN_FLASH)
-    {
-        return NRF_ERROR_NO_MEM;
-    }
+    p_record->type           = type;
+    p_record->central_handle = central_handle;
+    p_record->size           = size;
+    p_record->gen            = m_log_gen;
 
-    // Check if this is the first bond to be stored
-    if (m_bond_info_in_flash_count == 0)
-    {
-        // Initialize CRC
-        m_crc_bond_info = crc16_compute(NULL, 0, NULL);
-    }
+    memcpy(p_image + offset + sizeof(log_record_t), p_data, size);
+    memset(p_image + offset + sizeof(log_record_t) + size, 0, record_size - sizeof(log_record_t) - size);
 
-    // Get block pointer from base
-    err_code = pstorage_block_identifier_get(&mp_flash_bond_info,m_bond_info_in_flash_count,&dest_block);
-    if (err_code != NRF_SUCCESS)
-    {
-        return err_code;
-    }
-    
-    // Write Bonding Information
-    err_code = pstorage_store(&dest_block,
-                              (uint8_t *)p_bond,
-                              sizeof(central_bond_t),
-                              sizeof(uint32_t));
+    p_record->crc = log_record_crc(p_record, p_data);
+
+    return record_size;
+}
 
-    if (err_code != NRF_SUCCESS)
-    {
-        return err_code;
-    }
-    m_crc_bond_info = crc16_compute((uint8_t *)p_bond,
-                                     sizeof(central_bond_t),
-                                     &m_crc_bond_info);
 
-    // Write header
-    m_bond_crc_array[m_bond_info_in_flash_count] = (BOND_MANAGER_DATA_SIGNATURE | m_crc_bond_info);
+/**@brief      Function for queuing part of the RAM image for writing to the active log half.
+ */
+static uint32_t log_image_write(uint16_t offset, uint16_t size)
+{
+    uint32_t          err_code;
+    pstorage_handle_t dest_block;
 
-    err_code = pstorage_store (&dest_block, (uint8_t *)&m_bond_crc_array[m_bond_info_in_flash_count],sizeof(uint32_t),0);
+    err_code = pstorage_block_identifier_get(&mp_flash_log, m_log_half, &dest_block);
     if (err_code != NRF_SUCCESS)
     {
         return err_code;
     }
 
-    m_bond_info_in_flash_count++;
-    return NRF_SUCCESS;
+    return pstorage_store(&dest_block, (uint8_t *)m_log_image + offset, size, offset);
 }
 
 
-/**@brief      Function for storing the System Attributes related to a specified central in flash.
+/**@brief      Function for writing the whole database to the other log half and making it the
+ *             active one.
  *
- * @param[in]  p_sys_attr   System Attributes to be stored.
+ * @details    The RAM image is shared by both halves, so this first waits until the NVM driver
+ *             has written everything queued from it. That is the only time a store waits.
  *
  * @return     NRF_SUCCESS on success, an error_code otherwise.
  */
-static uint32_t sys_attr_store(central_sys_attr_t * p_sys_attr)
+static uint32_t log_compact(void)
 {
     uint32_t err_code;
-    pstorage_handle_t dest_block;
+    uint32_t count;
+    uint16_t offset;
+    int      i;
 
-    // Check if flash is full.
-    if (m_sys_attr_in_flash_count >= MAX_BONDS_IN_FLASH)
+    do
     {
-        return NRF_ERROR_NO_MEM;
-    }
+        err_code = pstorage_access_status_get(&count);
+        if (err_code != NRF_SUCCESS)
+        {
+            return err_code;
+        }
+    } while (count != 0);
 
-    // Check if this is the first time any System Attributes is stored.
-    if (m_sys_attr_in_flash_count == 0)
+    m_log_half ^= 1;
+    m_log_gen++;
+
+    offset = sizeof(uint32_t);
+    for (i = 0; i < m_centrals_in_db_count; i++)
     {
-        // Initialize CRC
-        m_crc_sys_attr = crc16_compute(NULL, 0, NULL);
-    }
+        central_t * p_central = &m_centrals_db[i];
 
+        m_bond_record[i] = offset;
+        offset += log_record_build(offset,
+                                   LOG_RECORD_BOND,
+                                   i,
+                                   (uint8_t *)&p_central->bond,
+                                   sizeof(central_bond_t));
 
-    // Get block pointer from base
-    err_code = pstorage_block_identifier_get(&mp_flash_sys_attr,m_sys_attr_in_flash_count,&dest_block);
-    if (err_code != NRF_SUCCESS)
-    {
-        return err_code;
+        if (p_central->sys_attr.central_handle != INVALID_CENTRAL_HANDLE)
+        {
+            m_sys_attr_record[i] = offset;
+            offset += log_record_build(offset,
+                                       LOG_RECORD_SYS_ATTR,
+                                       i,
+                                       p_central->sys_attr.sys_attr,
+                                       p_central->sys_attr.sys_attr_size);
+        }
+        else
+        {
+            m_sys_attr_record[i] = LOG_NOT_STORED;
+        }
     }
-    
-    // Write System Attributes in flash.
-    err_code = pstorage_store(&dest_block,
-                              (uint8_t *)p_sys_attr,
-                              sizeof(central_sys_attr_t),
-                              sizeof(uint32_t));
+    m_log_image[0] = LOG_HEADER_SIGNATURE | m_log_gen;
 
-    if (err_code != NRF_SUCCESS)
+    // The driver writes in order, so the header is written after the records.
+    if (offset > sizeof(uint32_t))
     {
-        return err_code;
+        err_code = log_image_write(sizeof(uint32_t), offset - sizeof(uint32_t));
+        if (err_code != NRF_SUCCESS)
+        {
+            return err_code;
+        }
     }
-    m_crc_sys_attr = crc16_compute((uint8_t *)p_sys_attr,
-                                             sizeof(central_sys_attr_t),
-                                             &m_crc_sys_attr);
-
-    // Write header.
-    m_sys_crc_array[m_sys_attr_in_flash_count] = (BOND_MANAGER_DATA_SIGNATURE | m_crc_sys_attr);
-
-    err_code = pstorage_store (&dest_block,
-                               (uint8_t *)&m_sys_crc_array[m_sys_attr_in_flash_count],
-                               sizeof(uint32_t),
-                               0);
+    err_code = log_image_write(0, sizeof(uint32_t));
     if (err_code != NRF_SUCCESS)
     {
         return err_code;
     }
 
-    m_sys_attr_in_flash_count++;
-
-    
+    m_log_used = offset;
     return NRF_SUCCESS;
 }
 
 
-/**@brief      Function for loading the Bonding Information of one central from flash.
+/**@brief      Function for appending a record to the log.
  *
- * @param[out] p_bond   Loaded Bonding Information.
+ * @details    The database in RAM must already hold the change: when the log half is full, the
+ *             log is compacted instead, which stores the change with the rest of the database.
  *
- * @return     NRF_SUCCESS on success, otherwise an error code.
+ * @param[in]  type             LOG_RECORD_*.
+ * @param[in]  central_handle   Central the record applies to.
+ * @param[in]  p_data           Record data.
+ * @param[in]  size             Size of the data.
+ * @param[out] p_offset         Set to the position of the record, may be NULL.
+ *
+ * @return     NRF_SUCCESS on success, an error_code otherwise.
  */
-static uint32_t bonding_info_load_from_flash(central_bond_t * p_bond)
+static uint32_t log_append(uint8_t         type,
+                           uint8_t         central_handle,
+                           const uint8_t * p_data,
+                           uint16_t        size,
+                           uint16_t      * p_offset)
 {
-    pstorage_handle_t source_block;
-    uint32_t          err_code;
-    uint32_t          crc;
-    uint16_t          crc_header;
-    
-    // Check if this is the first bond to be loaded, in which case the
-    // m_bond_info_in_flash_count variable would have the intial value 0.
-    if (m_bond_info_in_flash_count == 0)
-    {
-        // Initialize CRC.
-        m_crc_bond_info = crc16_compute(NULL, 0, NULL);
-    }
+    uint16_t record_size = LOG_RECORD_SIZE(size);
+    uint32_t err_code;
 
-    // Get block pointer from base
-    err_code = pstorage_block_identifier_get(&mp_flash_bond_info,
-                                             m_bond_info_in_flash_count,
-                                             &source_block);
-    if (err_code != NRF_SUCCESS)
+    if (m_log_used + record_size > BLE_BONDMNGR_LOG_HALF_SIZE)
     {
-        return err_code;
+        return log_compact();
     }
-    
-    err_code = pstorage_load((uint8_t *)&crc, &source_block, sizeof(uint32_t), 0);
-    if (err_code != NRF_SUCCESS)
-    {
-        return err_code;
-    }
-    
-    // Extract CRC from header.
-    err_code = crc_extract(crc, &crc_header);
-    if (err_code != NRF_SUCCESS)
-    {
-        return err_code;
-    }
-    
-    // Load central.
-    err_code = pstorage_load((uint8_t *)p_bond,
-                             &source_block,
-                             sizeof(central_bond_t),
-                             sizeof(uint32_t));
+
+    log_record_build(m_log_used, type, central_handle, p_data, size);
+
+    err_code = log_image_write(m_log_used, record_size);
     if (err_code != NRF_SUCCESS)
     {
         return err_code;
     }
 
-    // Check CRC.
-    m_crc_bond_info = crc16_compute((uint8_t *)p_bond,
-                                    sizeof(central_bond_t),
-                                    &m_crc_bond_info);
-    if (m_crc_bond_info == crc_header)
-    {
-        m_bond_info_in_flash_count++;
-        return NRF_SUCCESS;
-    }
-    else
+    if (p_offset != NULL)
     {
-        return NRF_ERROR_INVALID_DATA;
+        *p_offset = m_log_used;
     }
-}
 
+    m_log_used += record_size;
+    return NRF_SUCCESS;
+}
 
 
-/**@brief      Function for loading the System Attributes related to one central from flash.
+/**@brief      Function for storing the Bonding Information of a central if it has changed.
  *
- * @param[out] p_sys_attr   Loaded System Attributes.
+ * @param[in]  central_handle   Central whose database entry is to be stored.
  *
- * @return     NRF_SUCCESS on success, otherwise an error code.
+ * @return     NRF_SUCCESS on success, an error_code otherwise.
  */
-static uint32_t sys_attr_load_from_flash(central_sys_attr_t * p_sys_attr)
+static uint32_t bond_info_store(int32_t central_handle)
 {
-    pstorage_handle_t source_block;
-    uint32_t err_code;
-    uint32_t crc;
-    uint16_t crc_header;
+    central_bond_t * p_bond = &m_centrals_db[central_handle].bond;
 
-    // Check if this is the first time System Attributes is loaded from flash, in which case the
-    // m_sys_attr_in_flash_count variable would have the initial value 0.
-    if (m_sys_attr_in_flash_count == 0)
+    if (log_record_matches(m_bond_record[central_handle], (uint8_t *)p_bond, sizeof(central_bond_t)))
     {
-        // Initialize CRC.
-        m_crc_sys_attr = crc16_compute(NULL, 0, NULL);
+        return NRF_SUCCESS;
     }
 
-    // Get block pointer from base
-    err_code = pstorage_block_identifier_get(&mp_flash_sys_attr,
-                                             m_sys_attr_in_flash_count,
-                                             &source_block);
-    if (err_code != NRF_SUCCESS)
-    {
-        return err_code;
-    }
-    
-    err_code = pstorage_load((uint8_t *)&crc, &source_block, sizeof(uint32_t), 0);
-    if (err_code != NRF_SUCCESS)
-    {
-        return err_code;
-    }
-    
-    // Extract CRC from header.
-    err_code = crc_extract(crc, &crc_header);
-    if (err_code != NRF_SUCCESS)
-    {
-        return err_code;
-    }
-    
-    err_code = pstorage_load((uint8_t *)p_sys_attr,
-                             &source_block,
-                             sizeof(central_sys_attr_t),
-                             sizeof(uint32_t));
-    if (err_code != NRF_SUCCESS)
-    {
-        return err_code;
-    }
+    return log_append(LOG_RECORD_BOND,
+                      central_handle,
+                      (uint8_t *)p_bond,
+                      sizeof(central_bond_t),
+                      &m_bond_record[central_handle]);
+}
 
-    // Check CRC.
-    m_crc_sys_attr = crc16_compute((uint8_t *)p_sys_attr,
-                                   sizeof(central_sys_attr_t),
-                                   &m_crc_sys_attr);
 
-    if (m_crc_sys_attr == crc_header)
+/**@brief      Function for storing the System Attributes of a central if they have changed.
+ *
+ * @details    Only the sys_attr_size bytes in use are stored.
+ *
+ * @param[in]  central_handle   Central whose database entry is to be stored.
+ *
+ * @return     NRF_SUCCESS on success, an error_code otherwise.
+ */
+static uint32_t sys_attr_store(int32_t central_handle)
+{
+    central_sys_attr_t * p_sys_attr = &m_centrals_db[central_handle].sys_attr;
+
+    if (p_sys_attr->central_handle == INVALID_CENTRAL_HANDLE ||
+        p_sys_attr->sys_attr_size > SYS_ATTR_BUFFER_MAX_LEN)
     {
-        m_sys_attr_in_flash_count++;
         return NRF_SUCCESS;
     }
-    else
+
+    if (log_record_matches(m_sys_attr_record[central_handle],
+                           p_sys_attr->sys_attr,
+                           p_sys_attr->sys_attr_size))
     {
-        return NRF_ERROR_INVALID_DATA;
+        return NRF_SUCCESS;
     }
+
+    return log_append(LOG_RECORD_SYS_ATTR,
+                      central_handle,
+                      p_sys_attr->sys_attr,
+                      p_sys_attr->sys_attr_size,
+                      &m_sys_attr_record[central_handle]);
 }
 
 
-/**@brief      Function for erasing the flash pages that contain Bonding Information and System
- *             Attributes.
- *
- * @return     NRF_SUCCESS on success, otherwise an error code.
+/**@brief      Function for clearing a database entry.
  */
-static uint32_t flash_pages_erase(void)
+static void central_entry_clear(int i)
 {
-    uint32_t err_code;
-
-    err_code = pstorage_clear(&mp_flash_bond_info, MAX_BONDS_IN_FLASH);
-
-    if (err_code == NRF_SUCCESS)
-    {
-        err_code = pstorage_clear(&mp_flash_sys_attr, MAX_BONDS_IN_FLASH);
-    }
-
-    return err_code;
+    memset(&m_centrals_db[i], 0, sizeof(central_t));
+    m_centrals_db[i].bond.central_handle     = INVALID_CENTRAL_HANDLE;
+    m_centrals_db[i].sys_attr.sys_attr_size  = 0;
+    m_centrals_db[i].sys_attr.central_handle = INVALID_CENTRAL_HANDLE;
+    m_bond_record[i]                         = LOG_NOT_STORED;
+    m_sys_attr_record[i]                     = LOG_NOT_STORED;
 }
 
 
-/**@brief      Function for checking if Bonding Information in RAM is different from that in
- *             flash.
- *
- * @return     TRUE if Bonding Information in flash and RAM are different, FALSE otherwise.
+/**@brief      Function for removing a central from the database in RAM. The following centrals
+ *             move down by one handle.
  */
-static bool bond_info_changed(void)
+static void central_remove(int32_t central_handle)
 {
-    int      i;
-    uint16_t crc = crc16_compute(NULL, 0, NULL);
+    int i;
 
-    // Compute CRC for all bonds in database.
-    for (i = 0; i < m_centrals_in_db_count; i++)
+    for (i = central_handle; i < (m_centrals_in_db_count - 1); i++)
     {
-        crc = crc16_compute((uint8_t *)&m_centrals_db[i].bond,
-                                      sizeof(central_bond_t),
-                                      &crc);
+        // Overwrite the current central entry with the next one.
+        m_centrals_db[i]    = m_centrals_db[i + 1];
+        m_bond_record[i]     = m_bond_record[i + 1];
+        m_sys_attr_record[i] = m_sys_attr_record[i + 1];
+
+        // Decrement the value of handle.
+        m_centrals_db[i].bond.central_handle--;
+        if (INVALID_CENTRAL_HANDLE != m_centrals_db[i].sys_attr.central_handle)
+        {
+            m_centrals_db[i].sys_attr.central_handle--;
+        }
     }
 
-    // Compare the computed CRS to CRC stored in flash.
-    return (crc != m_crc_bond_info);
+    // Clear the last database entry.
+    m_centrals_in_db_count--;
+    central_entry_clear(m_centrals_in_db_count);
 }
 
 
-/**@brief      Function for checking if System Attributes in RAM is different from that in flash.
+/**@brief      Function for applying one log record to the database in RAM.
+ *
+ * @param[in]  p_record   Record in the RAM image of the active log half.
  *
- * @return     TRUE if System Attributes in flash and RAM are different, FALSE otherwise.
+ * @return     false if the record does not fit the database.
  */
-static bool sys_attr_changed(void)
+static bool log_record_apply(const log_record_t * p_record)
 {
-    int      i;
-    uint16_t crc = crc16_compute(NULL, 0, NULL);
+    const uint8_t * p_data = (const uint8_t *)(p_record + 1);
+    uint16_t        offset = (uint8_t *)p_record - (uint8_t *)m_log_image;
+    int32_t central_handle = p_record->central_handle;
 
-    // Compute CRC for all System Attributes in database.
-    for (i = 0; i < m_centrals_in_db_count; i++)
+    switch (p_record->type)
     {
-        crc = crc16_compute((uint8_t *)&m_centrals_db[i].sys_attr,
-                                      sizeof(central_sys_attr_t),
-                                      &crc);
-    }
+        case LOG_RECORD_BOND:
+            if ((p_record->size != sizeof(central_bond_t))    ||
+                (central_handle > m_centrals_in_db_count)       ||
+                (central_handle >= BLE_BONDMNGR_MAX_BONDED_CENTRALS))
+            {
+                return false;
+            }
+            if (central_handle == m_centrals_in_db_count)
+            {
+                // New central handle.
+                central_entry_clear(central_handle);
+                m_centrals_in_db_count++;
+            }
+            memcpy(&m_centrals_db[central_handle].bond, p_data, sizeof(central_bond_t));
+            m_centrals_db[central_handle].bond.central_handle = central_handle;
+            m_bond_record[central_handle] = offset;
+            return true;
+
+        case LOG_RECORD_SYS_ATTR:
+            if ((p_record->size > SYS_ATTR_BUFFER_MAX_LEN) || (central_handle >= m_centrals_in_db_count))
+            {
+                return false;
+            }
+            memcpy(m_centrals_db[central_handle].sys_attr.sys_attr, p_data, p_record->size);
+            m_centrals_db[central_handle].sys_attr.sys_attr_size  = p_record->size;
+            m_centrals_db[central_handle].sys_attr.central_handle = central_handle;
+            m_sys_attr_record[central_handle] = offset;
+            return true;
+
+        case LOG_RECORD_DELETE:
+            if (central_handle >= m_centrals_in_db_count)
+            {
+                return false;
+            }
+            central_remove(central_handle);
+            return true;
 
-    // Compare the CRC of System Attributes in flash with that of the System Attributes in memory.
-    return (crc != m_crc_sys_attr);
+        default:
+            return false;
+    }
 }
 
 
+
 /**@brief      Function for setting the System Attributes for specified central to the SoftDevice, or
  *             clearing the System Attributes if central is a previously unknown.
  *
@@ -679,7 +736,7 @@ static uint32_t on_auth_status_from_new_central(ble_gap_evt_auth_status_t * p_au
     }
 
     // Write new central's Bonding Information to flash.
-    err_code = bond_info_store(&m_central.bond);
+    err_code = bond_info_store(m_central.bond.central_handle);
     if ((err_code == NRF_ERROR_NO_MEM) && (m_bondmngr_config.evt_handler != NULL))
     {
         ble_bondmngr_evt_t evt;
@@ -771,98 +828,213 @@ static uint32_t central_find_in_db(uint16_t central_id)
 }
 
 
-/**@brief      Function for loading all Bonding Information and System Attributes from flash.
+/**@brief      Function for extracting the generation from the header word of a log half.
+ *
+ * @retval     NRF_SUCCESS              Generation successfully extracted.
+ * @retval     NRF_ERROR_INVALID_DATA   Header does not contain the magic number.
+ */
+static uint32_t log_header_extract(uint32_t header, uint16_t * p_gen)
+{
+    if ((header & 0xFFFF0000U) == LOG_HEADER_SIGNATURE)
+    {
+        *p_gen = (uint16_t)(header & 0x0000FFFFU);
+
+        return NRF_SUCCESS;
+    }
+
+    return NRF_ERROR_INVALID_DATA;
+}
+
+
+/**@brief      Function for loading the database from the legacy layout.
+ *
+ * @details    Blocks are read as the old bond manager read them: Bonding Information until the
+ *             first block without a valid header, where a handle already seen updates that
+ *             central, then one System Attributes block per central. Loading stops at the first
+ *             block that fails its CRC; what was read before it is kept.
  *
  * @return     NRF_SUCCESS on success, otherwise an error code.
  */
-static uint32_t load_all_from_flash(void)
+static uint32_t legacy_load(void)
 {
-    uint32_t err_code;
-    int      i;
+    uint32_t          err_code;
+    pstorage_handle_t source_block;
+    uint32_t          header;
+    uint16_t          crc;
+    int               i;
 
-    m_centrals_in_db_count = 0;
+    err_code = pstorage_block_identifier_get(&mp_flash_log, 0, &source_block);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
 
-    while (m_centrals_in_db_count < BLE_BONDMNGR_MAX_BONDED_CENTRALS)
+    crc = crc16_compute(NULL, 0, NULL);
+    for (i = 0; i < LEGACY_BONDS_IN_FLASH; i++)
     {
-        central_bond_t central_bond_info;
-        int           central_handle;
+        central_bond_t bond;
+        uint16_t       offset = i * LEGACY_BOND_BLOCK_SIZE;
 
-        // Load Bonding Information.
-        err_code = bonding_info_load_from_flash(&central_bond_info);
-        if (err_code == NRF_ERROR_NOT_FOUND)
+        pstorage_load((uint8_t *)&header, &source_block, sizeof(uint32_t), offset);
+        if ((header & 0xFFFF0000U) != BOND_MANAGER_DATA_SIGNATURE)
         {
-            // No more bonds in flash.
             break;
         }
-        else if (err_code != NRF_SUCCESS)
-        {
-            return err_code;
-        }
+        pstorage_load((uint8_t *)&bond, &source_block, sizeof(central_bond_t), offset + sizeof(uint32_t));
 
-        central_handle = central_bond_info.central_handle;
-        if (central_handle > m_centrals_in_db_count)
+        crc = crc16_compute((uint8_t *)&bond, sizeof(central_bond_t), &crc);
+        if ((crc != (uint16_t)header)                          ||
+            (bond.central_handle < 0)                          ||
+            (bond.central_handle > m_centrals_in_db_count)     ||
+            (bond.central_handle >= BLE_BONDMNGR_MAX_BONDED_CENTRALS))
         {
-            // Central handle value(s) missing in flash. This should never happen.
-            return NRF_ERROR_INVALID_DATA;
+            break;
         }
-        else
+        if (bond.central_handle == m_centrals_in_db_count)
         {
-            // Add/update Bonding Information in central array.
-            m_centrals_db[central_handle].bond = central_bond_info;
-            if (central_handle == m_centrals_in_db_count)
-            {
-                // New central handle, clear System Attributes.
-                m_centrals_db[central_handle].sys_attr.sys_attr_size  = 0;
-                m_centrals_db[central_handle].sys_attr.central_handle = INVALID_CENTRAL_HANDLE;
-                m_centrals_in_db_count++;
-            }
-            else
-            {
-                // Entry was updated, do nothing.
-            }
+            // New central handle.
+            m_centrals_in_db_count++;
         }
+        m_centrals_db[bond.central_handle].bond = bond;
     }
 
-    // Load System Attributes for all previously known centrals.
+    crc = crc16_compute(NULL, 0, NULL);
     for (i = 0; i < m_centrals_in_db_count; i++)
     {
-        central_sys_attr_t central_sys_attr;
+        central_sys_attr_t sys_attr;
+        uint16_t           offset = LEGACY_SYS_ATTR_BASE + i * LEGACY_SYS_ATTR_BLOCK_SIZE;
 
-        // Load System Attributes.
-        err_code = sys_attr_load_from_flash(&central_sys_attr);
-        if (err_code == NRF_ERROR_NOT_FOUND)
+        pstorage_load((uint8_t *)&header, &source_block, sizeof(uint32_t), offset);
+        if ((header & 0xFFFF0000U) != BOND_MANAGER_DATA_SIGNATURE)
         {
-            // No more System Attributes in flash.
             break;
         }
-        else if (err_code != NRF_SUCCESS)
+        pstorage_load((uint8_t *)&sys_attr, &source_block, sizeof(central_sys_attr_t), offset + sizeof(uint32_t));
+
+        crc = crc16_compute((uint8_t *)&sys_attr, sizeof(central_sys_attr_t), &crc);
+        if ((crc != (uint16_t)header)                          ||
+            (sys_attr.central_handle < 0)                      ||
+            (sys_attr.central_handle >= m_centrals_in_db_count) ||
+            (sys_attr.sys_attr_size > SYS_ATTR_BUFFER_MAX_LEN))
         {
-            return err_code;
+            break;
         }
+        m_centrals_db[sys_attr.central_handle].sys_attr = sys_attr;
+    }
+
+    return NRF_SUCCESS;
+}
+
+
+/**@brief      Function for loading all Bonding Information and System Attributes from the log.
+ *
+ * @details    A record that belongs to the current generation but fails its CRC was cut short
+ *             by a reset. The log is then compacted so that later records do not follow it.
+ *
+ * @return     NRF_SUCCESS on success, otherwise an error code.
+ */
+static uint32_t load_all_from_flash(void)
+{
+    uint32_t          err_code;
+    pstorage_handle_t source_block;
+    uint32_t          header[2];
+    uint16_t          gen[2];
+    bool              valid[2];
+    uint16_t          offset;
+    bool              torn = false;
+    int               i;
 
-        if (central_sys_attr.central_handle > m_centrals_in_db_count)
+    m_centrals_in_db_count = 0;
+    for (i = 0; i < BLE_BONDMNGR_MAX_BONDED_CENTRALS; i++)
+    {
+        central_entry_clear(i);
+    }
+
+    for (i = 0; i < 2; i++)
+    {
+        err_code = pstorage_block_identifier_get(&mp_flash_log, i, &source_block);
+        if (err_code != NRF_SUCCESS)
         {
-            // Central handle value(s) missing in flash. This should never happen.
-            return NRF_ERROR_INVALID_DATA;
+            return err_code;
         }
-        else
+        err_code = pstorage_load((uint8_t *)&header[i], &source_block, sizeof(uint32_t), 0);
+        if (err_code != NRF_SUCCESS)
         {
-            // Add/update Bonding Information in central array.
-            m_centrals_db[central_sys_attr.central_handle].sys_attr = central_sys_attr;
+            return err_code;
+        }
+        valid[i] = (log_header_extract(header[i], &gen[i]) == NRF_SUCCESS);
+    }
+
+    if (!valid[0] && !valid[1])
+    {
+        // No log yet. Bonds stored in the legacy layout lie within half 0, so the log starts in
+        // half 1 and they stay readable until its header is written.
+        err_code = legacy_load();
+        if (err_code != NRF_SUCCESS)
+        {
+            return err_code;
         }
+        update_whitelist();
+
+        m_log_half = 0;
+        m_log_gen  = 0;
+        return log_compact();
+    }
+
+    if (valid[0] && valid[1])
+    {
+        m_log_half = ((int16_t)(gen[1] - gen[0]) > 0) ? 1 : 0;
+    }
+    else
+    {
+        m_log_half = valid[1] ? 1 : 0;
     }
+    m_log_gen = gen[m_log_half];
 
-    // Initialize the remaining empty bond entries in the memory.
-    for (i = m_centrals_in_db_count; i < BLE_BONDMNGR_MAX_BONDED_CENTRALS; i++)
+    err_code = pstorage_block_identifier_get(&mp_flash_log, m_log_half, &source_block);
+    if (err_code != NRF_SUCCESS)
     {
-        m_centrals_db[i].bond.central_handle     = INVALID_CENTRAL_HANDLE;
-        m_centrals_db[i].sys_attr.sys_attr_size  = 0;
-        m_centrals_db[i].sys_attr.central_handle = INVALID_CENTRAL_HANDLE;
+        return err_code;
+    }
+    err_code = pstorage_load((uint8_t *)m_log_image, &source_block, BLE_BONDMNGR_LOG_HALF_SIZE, 0);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
     }
 
+    offset = sizeof(uint32_t);
+    while (offset + sizeof(log_record_t) <= BLE_BONDMNGR_LOG_HALF_SIZE)
+    {
+        const log_record_t * p_record = (const log_record_t *)((uint8_t *)m_log_image + offset);
+
+        if ((p_record->type == 0) || (p_record->gen != m_log_gen))
+        {
+            // End of the log; the rest is empty or left from an older generation.
+            break;
+        }
+        if (LOG_RECORD_SIZE(p_record->size) > BLE_BONDMNGR_LOG_HALF_SIZE - offset)
+        {
+            torn = true;
+            break;
+        }
+        if ((log_record_crc(p_record, (const uint8_t *)(p_record + 1)) != p_record->crc) ||
+            !log_record_apply(p_record))
+        {
+            torn = true;
+            break;
+        }
+        offset += LOG_RECORD_SIZE(p_record->size);
+    }
+    m_log_used = offset;
+
     // Update whitelist data structures.
     update_whitelist();
 
+    if (torn)
+    {
+        return log_compact();
+    }
+
     return NRF_SUCCESS;
 }
 
@@ -988,7 +1160,7 @@ static void auth_status_update(ble_gap_evt_auth_status_t * p_auth_status)
     m_centrals_db[m_central.bond.central_handle] = m_central;
 
     // Write updated Bonding Information to flash.
-    err_code = bond_info_store(&m_central.bond);
+    err_code = bond_info_store(m_central.bond.central_handle);
     if ((err_code == NRF_ERROR_NO_MEM) && (m_bondmngr_config.evt_handler != NULL))
     {
         ble_bondmngr_evt_t evt;
@@ -1266,48 +1438,20 @@ uint32_t ble_bondmngr_bonded_centrals_store(void)
         }
     }
 
-    // Save Bonding Information if changed.
-    if (bond_info_changed())
+    // Append whatever changed since it was last stored.
+    for (i = 0; i < m_centrals_in_db_count; i++)
     {
-        // Erase flash page.
-        err_code = pstorage_clear(&mp_flash_bond_info,MAX_BONDS_IN_FLASH);
+        err_code = bond_info_store(i);
         if (err_code != NRF_SUCCESS)
         {
             return err_code;
         }
 
-        // Store bond information for all centrals.
-        m_bond_info_in_flash_count = 0;
-        for (i = 0; i < m_centrals_in_db_count; i++)
-        {
-            err_code = bond_info_store(&m_centrals_db[i].bond);
-            if (err_code != NRF_SUCCESS)
-            {
-                return err_code;
-            }
-        }
-    }
-
-    // Save System Attributes, if changed.
-    if (sys_attr_changed())
-    {
-        // Erase flash page.
-        err_code = pstorage_clear(&mp_flash_sys_attr, MAX_BONDS_IN_FLASH);
+        err_code = sys_attr_store(i);
         if (err_code != NRF_SUCCESS)
         {
             return err_code;
         }
-
-        // Store System Attributes for all centrals.
-        m_sys_attr_in_flash_count = 0;
-        for (i = 0; i < m_centrals_in_db_count; i++)
-        {
-            err_code = sys_attr_store(&m_centrals_db[i].sys_attr);
-            if (err_code != NRF_SUCCESS)
-            {
-                return err_code;
-            }
-        }
     }
 
     m_conn_handle                     = BLE_CONN_HANDLE_INVALID;
@@ -1324,41 +1468,33 @@ uint32_t ble_bondmngr_bonded_centrals_store(void)
 uint32_t ble_bondmngr_sys_attr_store(void)
 {
     uint32_t err_code;
+    uint16_t sys_attr_size = SYS_ATTR_BUFFER_MAX_LEN;
 
-    if (m_central.sys_attr.sys_attr_size == 0)
+    if (m_central.bond.central_handle == INVALID_CENTRAL_HANDLE)
     {
-        // Connected to new central. So the flash block for System Attributes for this
-        // central is empty. Hence no erase is needed.
+        return NRF_ERROR_INVALID_STATE;
+    }
 
-        uint16_t sys_attr_size = SYS_ATTR_BUFFER_MAX_LEN;
+    // Fetch System Attributes from stack.
+    err_code = sd_ble_gatts_sys_attr_get(m_conn_handle,
+                                         m_central.sys_attr.sys_attr,
+                                         &sys_attr_size);
+    APP_ERROR_CHECK(err_code);
 
-        // Fetch System Attributes from stack.
-        err_code = sd_ble_gatts_sys_attr_get(m_conn_handle,
-                                             m_central.sys_attr.sys_attr,
-                                             &sys_attr_size);
-        APP_ERROR_CHECK(err_code);
-    
-        err_code = blocking_resp_wait();                                                     
-        if (err_code != NRF_SUCCESS)
-        {
-            return err_code;
-        }
+    err_code = blocking_resp_wait();
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
 
-        m_central.sys_attr.central_handle = m_central.bond.central_handle;
-        m_central.sys_attr.sys_attr_size  = (uint16_t)sys_attr_size;
+    m_central.sys_attr.central_handle = m_central.bond.central_handle;
+    m_central.sys_attr.sys_attr_size  = (uint16_t)sys_attr_size;
 
-        // Copy the System Attributes to database.
-        m_centrals_db[m_central.bond.central_handle].sys_attr = m_central.sys_attr;
+    // Copy the System Attributes to database.
+    m_centrals_db[m_central.bond.central_handle].sys_attr = m_central.sys_attr;
 
-        // Write new central's System Attributes to flash.
-        return (sys_attr_store(&m_central.sys_attr));
-    }
-    else
-    {
-        // Will not write to flash because System Attributes of an old central would already be
-        // in flash and so this operation needs a flash erase operation.
-        return NRF_ERROR_INVALID_STATE;
-    }
+    // Append them to the log; the NVM driver writes them in the background.
+    return sys_attr_store(m_central.bond.central_handle);
 }
 
 
@@ -1367,10 +1503,9 @@ uint32_t ble_bondmngr_bonded_centrals_delete(void)
     VERIFY_MODULE_INITIALIZED();
 
     m_centrals_in_db_count         = 0;
-    m_bond_info_in_flash_count     = 0;
-    m_sys_attr_in_flash_count      = 0;
 
-    return flash_pages_erase();
+    // A new generation holding no centrals.
+    return log_compact();
 }
 
 
@@ -1443,33 +1578,17 @@ uint32_t ble_bondmngr_init(ble_bondmngr_init_t * p_init)
         return NRF_ERROR_INVALID_PARAM;
     }
     
-    if (BLE_BONDMNGR_MAX_BONDED_CENTRALS > MAX_BONDS_IN_FLASH)
-    {
-        return NRF_ERROR_DATA_SIZE;
-    }
-          
-    param.block_size  = sizeof (central_bond_t) + sizeof (uint32_t);
-    param.block_count = MAX_BONDS_IN_FLASH;
+    // One block for each half of the log.
+    param.block_size  = BLE_BONDMNGR_LOG_HALF_SIZE;
+    param.block_count = 2;
     param.cb          = bm_pstorage_cb_handler;
-    
-    // Blocks are requested twice, once for bond information and once for system attributes.
-    // The number of blocks requested has to be the maximum number of bonded devices that
-    // need to be supported. However, the size of blocks can be different if the sizes of
-    // system attributes and bonds are not too close.
-    err_code = pstorage_register(&param, &mp_flash_bond_info);    
+
+    err_code = pstorage_register(&param, &mp_flash_log);
     if (err_code != NRF_SUCCESS)
     {
         return err_code;
     }
     
-    param.block_size = sizeof(central_sys_attr_t) + sizeof(uint32_t);
-    
-    err_code = pstorage_register(&param, &mp_flash_sys_attr);    
-    if (err_code != NRF_SUCCESS)
-    {
-        return err_code;
-    }    
-    
     m_bondmngr_config = *p_init;
 
     memset(&m_central, 0, sizeof(central_t));
@@ -1477,33 +1596,26 @@ uint32_t ble_bondmngr_init(ble_bondmngr_init_t * p_init)
     m_central.bond.central_handle  = INVALID_CENTRAL_HANDLE;
     m_conn_handle                  = BLE_CONN_HANDLE_INVALID;
     m_centrals_in_db_count         = 0;
-    m_bond_info_in_flash_count     = 0;
-    m_sys_attr_in_flash_count      = 0;
 
     SECURITY_STATUS_RESET();
 
+    // Load bond manager data from flash. This also finds the generation to continue the log with.
+    err_code = load_all_from_flash();
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
     // Erase all stored centrals if specified.
     if (m_bondmngr_config.bonds_delete)
     {
-        err_code = flash_pages_erase();
-        if (err_code != NRF_SUCCESS)
+        while (m_centrals_in_db_count > 0)
         {
-            return err_code;
+            central_remove(m_centrals_in_db_count - 1);
         }
+        update_whitelist();
 
-        m_centrals_in_db_count = 0;
-        
-        for (int i = m_centrals_in_db_count; i < BLE_BONDMNGR_MAX_BONDED_CENTRALS; i++)
-        {
-            m_centrals_db[i].bond.central_handle     = INVALID_CENTRAL_HANDLE;
-            m_centrals_db[i].sys_attr.sys_attr_size  = 0;
-            m_centrals_db[i].sys_attr.central_handle = INVALID_CENTRAL_HANDLE;
-        }
-    }
-    else
-    {
-        // Load bond manager data from flash.
-        err_code = load_all_from_flash();
+        err_code = log_compact();
         if (err_code != NRF_SUCCESS)
         {
             return err_code;
@@ -1570,59 +1682,18 @@ uint32_t ble_bondmngr_bonded_central_delete(uint16_t central_id)
         return NRF_ERROR_NOT_FOUND;
     }
 
-    // Delete the central in RAM.
-    for (i = central_handle_to_be_deleted; i < (m_centrals_in_db_count - 1); i++)
-    {
-        // Overwrite the current central entry with the next one.
-        m_centrals_db[i] = m_centrals_db[i + 1];
-
-        // Decrement the value of handle.
-        m_centrals_db[i].bond.central_handle--;
-        if (INVALID_CENTRAL_HANDLE != m_centrals_db[i].sys_attr.central_handle)
-        {
-            m_centrals_db[i].sys_attr.central_handle--;
-        }
-    }
-
-    // Clear the last database entry.
-    memset(&(m_centrals_db[m_centrals_in_db_count - 1]), 0, sizeof(central_t));
-
-    m_centrals_in_db_count--;
-
     uint32_t err_code;
 
-    // Reinitialize the pointers to the memory where bonding info and System Attributes are stored
-    // in flash.
-    // Refresh the data in the flash memory (both Bonding Information and System Attributes).
-    // Erase and rewrite bonding info and System Attributes.
+    // Delete the central in RAM.
+    central_remove(central_handle_to_be_deleted);
 
-    err_code = flash_pages_erase();
+    // Replaying the log performs the same removal.
+    err_code = log_append(LOG_RECORD_DELETE, central_handle_to_be_deleted, NULL, 0, NULL);
     if (err_code != NRF_SUCCESS)
     {
         return err_code;
     }
 
-    m_bond_info_in_flash_count    = 0;
-    m_sys_attr_in_flash_count     = 0;
-
-    for (i = 0; i < m_centrals_in_db_count; i++)
-    {
-        err_code = bond_info_store(&(m_centrals_db[i].bond));
-        if (err_code != NRF_SUCCESS)
-        {
-            return err_code;
-        }
-    }
-
-    for (i = 0; i < m_centrals_in_db_count; i++)
-    {
-        err_code = sys_attr_store(&(m_centrals_db[i].sys_attr));
-        if (err_code != NRF_SUCCESS)
-        {
-            return err_code;
-        }
-    }
-
     update_whitelist();
 
     return NRF_SUCCESS;
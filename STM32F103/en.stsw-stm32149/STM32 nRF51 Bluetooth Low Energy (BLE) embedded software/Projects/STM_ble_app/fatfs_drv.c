@@ -91,6 +91,8 @@ DSTATUS disk_status (BYTE pdrv)
   */
 DRESULT disk_read (BYTE pdrv, BYTE*buff, DWORD sector, UINT count)
 {
+  SD_Error status;
+  
   if (pdrv == 0)
   {
     if(SD_GetStatus() != 0xFF)
@@ -98,7 +100,20 @@ DRESULT disk_read (BYTE pdrv, BYTE*buff, DWORD sector, UINT count)
       return(RES_NOTRDY);
     }
     
-    SD_ReadBlock(buff, sector << 9, BLOCK_SIZE);
+    /* Consecutive sectors are streamed with a single CMD18 */
+    if (count == 1)
+    {
+      status = SD_ReadBlock(buff, sector << 9, BLOCK_SIZE);
+    }
+    else
+    {
+      status = SD_ReadMultiBlocks(buff, sector << 9, BLOCK_SIZE, count);
+    }
+    
+    if (status != SD_RESPONSE_NO_ERROR)
+    {
+      return RES_ERROR;
+    }
   }
   return RES_OK;
 }
@@ -119,6 +134,8 @@ DRESULT disk_read (BYTE pdrv, BYTE*buff, DWORD sector, UINT count)
 #if _USE_WRITE == 1
 DRESULT disk_write (BYTE pdrv, const BYTE* buff, DWORD sector, UINT count)
 {
+  SD_Error status;
+  
   if (pdrv == 0)
   {
     if(SD_GetStatus() != 0xFF)
@@ -126,7 +143,20 @@ DRESULT disk_write (BYTE pdrv, const BYTE* buff, DWORD sector, UINT count)
       return(RES_NOTRDY);
     }
     
-    SD_WriteBlock((BYTE *)buff, sector << 9, BLOCK_SIZE); 
+    /* Consecutive sectors are written with a single CMD25 */
+    if (count == 1)
+    {
+      status = SD_WriteBlock((BYTE *)buff, sector << 9, BLOCK_SIZE);
+    }
+    else
+    {
+      status = SD_WriteMultiBlocks((BYTE *)buff, sector << 9, BLOCK_SIZE, count);
+    }
+    
+    if (status != SD_RESPONSE_NO_ERROR)
+    {
+      return RES_ERROR;
+    }
   }
   return RES_OK;
 }
@@ -199,6 +229,9 @@ DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void *buff)
     {
       *(DWORD*)buff = 32;
     }
+    res = RES_OK;
+    break;
+    
   default:
     res = RES_PARERR;
   }
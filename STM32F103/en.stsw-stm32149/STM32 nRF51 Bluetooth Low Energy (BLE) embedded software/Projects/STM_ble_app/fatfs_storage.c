@@ -52,6 +52,15 @@
 /** @defgroup STORAGE_Private_Defines
 * @{
 */
+/* Bitmap lines staged per buffer. Each buffer holds them at 24 bpp, the 
+   deepest format accepted, of the full LCD width */
+#define BMP_BUFFER_LINES        8
+#define BMP_BUFFER_SIZE         (BMP_BUFFER_LINES * LCD_PIXEL_WIDTH * 3)
+
+/* Memory access control set by LCD_Setup(), and the same with the row 
+   address order reversed: bitmaps are stored bottom line first */
+#define BMP_LCD_MADCTL          0xC0
+#define BMP_LCD_MADCTL_BOTTOMUP 0x40
 /**
 * @}
 */
@@ -74,6 +83,9 @@ FIL MyFile;
 UINT BytesWritten;
 UINT BytesRead;
 
+/* Bitmap lines being sent to the LCD, and the next ones being prepared */
+static uint16_t aBmpBuffer[2][BMP_BUFFER_SIZE / 2];
+
 /**
 * @}
 */
@@ -82,6 +94,10 @@ UINT BytesRead;
 /** @defgroup STORAGE_Private_FunctionPrototypes
 * @{
 */
+static uint32_t Storage_ReadBitmapLines(FIL* file, uint16_t* pBuffer, uint32_t LineSize, uint32_t Lines);
+static void Storage_ConvertBitmapLines(uint16_t* pBuffer, uint32_t Width, uint32_t LineSize, 
+                                       uint32_t BytesPerPixel, uint32_t Lines);
+static void Storage_SetBitmapWindow(uint8_t Xpos, uint8_t Ypos, uint32_t Width, uint32_t Lines);
 /**
 * @}
 */
@@ -92,28 +108,35 @@ UINT BytesRead;
 
 
 /**
-* @brief  Open a file and copy its content to a buffer
-* @param  DirName: the Directory name to open
-* @param  FileName: the file name to open
-* @param  BufferAddress: A pointer to a buffer to copy the file to
-* @param  FileLen: the File length
+* @brief  Open a bitmap file and display it on the LCD
+* @note   The bitmap lines are staged in two buffers: while the LCD receives 
+*         one of them by DMA, the lines of the other one, already read from 
+*         the file, are converted to RGB565. The LCD and the uSD card share 
+*         the SPI bus, so the file is only read between two LCD transfers.
+* @param  Xpoz: the column of the right edge of the image
+* @param  Ypoz: the line of the bottom edge of the image
+* @param  BmpName: the bitmap file name, 16 bpp (RGB565) or 24 bpp
 * @retval err: Error status (0=> success, 1=> fail)
 */
 uint32_t Storage_OpenReadFile(uint8_t Xpoz, uint16_t Ypoz, const char* BmpName)
 {
-  uint32_t index = 0, size = 0, width = 0, height = 0, i1 = 0, x = 0, y = 159;
-  uint32_t bmpaddress, bit_pixel = 0;
+  uint32_t index = 0, width = 0, height = 0, bit_pixel = 0, linesize = 0;
+  uint32_t lines = 0, nextlines = 0, cur = 0, x = 0, y = 0;
+  uint8_t *bmpaddress;
   FIL file1;
-  uint16_t color = 0;
   
-  f_open(&file1, BmpName, FA_READ);
-  f_read(&file1, aBuffer, 66, &BytesRead);
-  
-  bmpaddress = (uint32_t)aBuffer;
+  if (f_open(&file1, BmpName, FA_READ) != FR_OK)
+  {
+    return 1;
+  }
+  if ((f_read(&file1, aBuffer, 54, &BytesRead) != FR_OK) || (BytesRead != 54) ||
+      (aBuffer[0] != 'B') || (aBuffer[1] != 'M'))
+  {
+    f_close(&file1);
+    return 1;
+  }
   
-  /* Read bitmap size */
-  size = *(uint16_t *) (bmpaddress + 2);
-  size |= (*(uint16_t *) (bmpaddress + 4)) << 16;
+  bmpaddress = aBuffer;
   
   /* Get bitmap data address offset */
   index = *(uint16_t *) (bmpaddress + 10);
@@ -131,51 +154,66 @@ uint32_t Storage_OpenReadFile(uint8_t Xpoz, uint16_t Ypoz, const char* BmpName)
   bit_pixel = *(uint16_t *) (bmpaddress + 28);  
   bit_pixel = bit_pixel/8;
   
-  size = (size - index);
+  /* Only bottom-up 16 bpp and 24 bpp bitmaps fitting on the left of and 
+     above (Xpoz, Ypoz) are displayed */
+  if (((bit_pixel != 2) && (bit_pixel != 3)) || (width == 0) || (height == 0) ||
+      (width > (uint32_t)Xpoz + 1) || (width > LCD_PIXEL_WIDTH) ||
+      (height > (uint32_t)Ypoz + 1) || (Ypoz >= LCD_PIXEL_HEIGHT))
+  {
+    f_close(&file1);
+    return 1;
+  }
+  
+  /* Bitmap lines are padded to a multiple of 4 bytes */
+  linesize = ((width * bit_pixel) + 3) & ~3;
+  x = Xpoz + 1 - width;
+  y = Ypoz;
   
   /* Synchronize f_read right in front of the image data */
-  f_read(&file1, aBuffer, index - 66, &BytesRead);
+  if (f_lseek(&file1, index) != FR_OK)
+  {
+    f_close(&file1);
+    return 1;
+  }
+  
+  lines = Storage_ReadBitmapLines(&file1, aBmpBuffer[cur], linesize, 
+                                  (height < BMP_BUFFER_LINES) ? height : BMP_BUFFER_LINES);
+  Storage_ConvertBitmapLines(aBmpBuffer[cur], width, linesize, bit_pixel, lines);
+  height -= lines;
   
-  do
+  /* Fill the LCD window from its bottom line upwards */
+  LCD_CS_LOW();
+  LCD_WriteCommand(ST7735_MADCTL);
+  LCD_WriteData(BMP_LCD_MADCTL_BOTTOMUP);
+  LCD_CS_HIGH();
+  
+  while (lines != 0)
   {
-    if(size*2 < 512)
-    {
-      i1 = size * 2;
-    }
-    else
-    {
-      i1 = 512;
-    }
-    size -= i1; 
-   
-    f_read(&file1, aBuffer, i1, &BytesRead);
+    /* Read the next lines while the bus is free */
+    nextlines = Storage_ReadBitmapLines(&file1, aBmpBuffer[cur ^ 1], linesize, 
+                                        (height < BMP_BUFFER_LINES) ? height : BMP_BUFFER_LINES);
+    height -= nextlines;
     
-    for (index = 0; index < i1/bit_pixel ; index++)
-    {
-      
-      if( index%bit_pixel == 0)
-      {
-        color = (aBuffer[ index + 1] << 8) | aBuffer[ index];
-      }
-      x = index/bit_pixel;
-      LCD_WriteRAM(x, y, color); 
-    }
-    y--;
-    for (index = i1/bit_pixel; index < i1 ; index++)
-    {
-      if( index%bit_pixel == 0)
-      {
-        color = (aBuffer[ index + 1] << 8) | aBuffer[ index];
-      } 
-      x = index/bit_pixel - width;
-      LCD_WriteRAM(x, y, color); 
-    }
-    y--;
+    /* Send these lines, and convert the next ones during the transfer */
+    Storage_SetBitmapWindow(x, y, width, lines);
+    STM_SPI_StartWrite16(aBmpBuffer[cur], lines * width);
+    Storage_ConvertBitmapLines(aBmpBuffer[cur ^ 1], width, linesize, bit_pixel, nextlines);
+    STM_SPI_WaitTransfer();
+    LCD_CS_HIGH();
+    
+    y -= lines;
+    lines = nextlines;
+    cur ^= 1;
   }
-  while (size > 0);
+  
+  LCD_CS_LOW();
+  LCD_WriteCommand(ST7735_MADCTL);
+  LCD_WriteData(BMP_LCD_MADCTL);
+  LCD_CS_HIGH();
+  
   f_close(&file1);
   
-  return 1;
+  return (height == 0) ? 0 : 1;
 }      
 
 /**
@@ -278,6 +316,108 @@ uint32_t Storage_GetDirectoryBitmapFiles(const char* DirName, char* Files[])
   return j;
 }
 
+/**
+* @brief  Reads whole bitmap lines, as stored in the file
+* @param  file: the bitmap file, positioned on a line
+* @param  pBuffer: the buffer receiving the lines
+* @param  LineSize: the size of a line in the file, padding included
+* @param  Lines: the number of lines to read
+* @retval The number of lines read
+*/
+static uint32_t Storage_ReadBitmapLines(FIL* file, uint16_t* pBuffer, uint32_t LineSize, uint32_t Lines)
+{
+  UINT bytesread = 0;
+  
+  if (Lines == 0)
+  {
+    return 0;
+  }
+  /* A single request lets FatFs read the whole sectors straight into the 
+     buffer, with multi-block transfers */
+  if (f_read(file, pBuffer, LineSize * Lines, &bytesread) != FR_OK)
+  {
+    return 0;
+  }
+  
+  return bytesread / LineSize;
+}
+
+/**
+* @brief  Converts bitmap lines, in place, to packed RGB565 pixels
+* @param  pBuffer: the buffer holding the lines as read from the file
+* @param  Width: the number of pixels per line
+* @param  LineSize: the size of a line in the file, padding included
+* @param  BytesPerPixel: 2 (RGB565) or 3 (BGR888)
+* @param  Lines: the number of lines in the buffer
+* @retval None
+*/
+static void Storage_ConvertBitmapLines(uint16_t* pBuffer, uint32_t Width, uint32_t LineSize, 
+                                       uint32_t BytesPerPixel, uint32_t Lines)
+{
+  uint8_t *src;
+  uint16_t *dst = pBuffer;
+  uint32_t line = 0, x = 0;
+  
+  /* Unpadded RGB565 lines are sent as they are read */
+  if ((BytesPerPixel == 2) && (LineSize == Width * 2))
+  {
+    return;
+  }
+  
+  /* The packed pixels never overtake the bytes still to be converted */
+  for (line = 0; line < Lines; line++)
+  {
+    src = (uint8_t *)pBuffer + (line * LineSize);
+    
+    for (x = 0; x < Width; x++)
+    {
+      if (BytesPerPixel == 2)
+      {
+        *dst++ = (uint16_t)(src[0] | (src[1] << 8));
+        src += 2;
+      }
+      else
+      {
+        /* Blue, green and red components */
+        *dst++ = (uint16_t)(((src[2] & 0xF8) << 8) | ((src[1] & 0xFC) << 3) | (src[0] >> 3));
+        src += 3;
+      }
+    }
+  }
+}
+
+/**
+* @brief  Opens the LCD memory window of a group of bitmap lines, and leaves 
+*         the LCD selected in data mode for the pixels
+* @note   The row address order is reversed while a bitmap is displayed, 
+*         so the window starts on the bottom line.
+* @param  Xpos: the left column of the lines
+* @param  Ypos: the bottom line
+* @param  Width: the number of pixels per line
+* @param  Lines: the number of lines
+* @retval None
+*/
+static void Storage_SetBitmapWindow(uint8_t Xpos, uint8_t Ypos, uint32_t Width, uint32_t Lines)
+{
+  uint8_t row = (LCD_PIXEL_HEIGHT - 1) - Ypos;
+  
+  LCD_CS_LOW();
+  
+  LCD_WriteCommand(CASET);
+  LCD_WriteData(0x00);
+  LCD_WriteData(Xpos);
+  LCD_WriteData(0x00);
+  LCD_WriteData(Xpos + Width - 1);
+  LCD_WriteCommand(RASET);
+  LCD_WriteData(0x00);
+  LCD_WriteData(row);
+  LCD_WriteData(0x00);
+  LCD_WriteData(row + Lines - 1);
+  LCD_WriteCommand(RAMWR);
+  
+  LCD_DC_HIGH();
+}
+
 /**
   * @brief  Compares two buffers.
   * @param  pBuffer1, pBuffer2: buffers to be compared
@@ -113,7 +113,6 @@ SD_Error SD_ADAFRUIT_Init(void)
   */
 SD_Error SD_ReadBlock(uint8_t* pBuffer, uint32_t ReadAddr, uint16_t BlockSize)
 {
-  uint32_t i = 0;
   SD_Error rvalue = SD_RESPONSE_FAILURE;
   
   /* SD chip select low */
@@ -128,15 +127,8 @@ SD_Error SD_ReadBlock(uint8_t* pBuffer, uint32_t ReadAddr, uint16_t BlockSize)
     /* Now look for the data token to signify the start of the data */
     if (!SD_GetResponse(SD_START_DATA_SINGLE_BLOCK_READ))
     {
-      /* Read the SD block data : read NumByteToRead data */
-      for (i = 0; i < BlockSize; i++)
-      {
-        /* Save the received data */
-        *pBuffer = SD_ReadByte();
-       
-        /* Point to the next location where the byte read will be saved */
-        pBuffer++;
-      }
+      /* Read the SD block data by DMA */
+      STM_SPI_ReadBuffer(pBuffer, BlockSize);
       /* Get CRC bytes (not really needed by us, but required by SD) */
       SD_ReadByte();
       SD_ReadByte();
@@ -167,48 +159,47 @@ SD_Error SD_ReadBlock(uint8_t* pBuffer, uint32_t ReadAddr, uint16_t BlockSize)
   */
 SD_Error SD_ReadMultiBlocks(uint8_t* pBuffer, uint32_t ReadAddr, uint16_t BlockSize, uint32_t NumberOfBlocks)
 {
-  uint32_t i = 0, Offset = 0;
   SD_Error rvalue = SD_RESPONSE_FAILURE;
   
   /* SD chip select low */
   SD_CS_LOW();
-  /* Data transfer */
-  while (NumberOfBlocks--)
+  
+  /* Send CMD18 (SD_CMD_READ_MULT_BLOCK): the card streams consecutive blocks 
+     until it receives CMD12 */
+  SD_SendCmd(SD_CMD_READ_MULT_BLOCK, ReadAddr, 0xFF);
+  
+  /* Check if the SD acknowledged the read command: R1 response (0x00: no errors) */
+  if (!SD_GetResponse(SD_RESPONSE_NO_ERROR))
   {
-    /* Read one block */
-    SD_SendCmd (SD_CMD_READ_SINGLE_BLOCK, ReadAddr + Offset, 0xFF);
-    /* Check if the SD acknowledged the read block command: R1 response (0x00: no errors) */
-    if (SD_GetResponse(SD_RESPONSE_NO_ERROR))
-    {
-      return  SD_RESPONSE_FAILURE;
-    }
-    /* Now look for the data token to signify the start of the data */
-    if (!SD_GetResponse(SD_START_DATA_SINGLE_BLOCK_READ))
+    rvalue = SD_RESPONSE_NO_ERROR;
+    
+    while (NumberOfBlocks--)
     {
-      /* Read the SD block data : read NumByteToRead data */
-      for (i = 0; i < BlockSize; i++)
+      /* Each block starts with its own data token */
+      if (SD_GetResponse(SD_START_DATA_MULTIPLE_BLOCK_READ))
       {
-        /* Read the pointed data */
-        *pBuffer = SD_ReadByte();
-      
-        /* Point to the next location where the byte read will be saved */
-        pBuffer++;
+        rvalue = SD_RESPONSE_FAILURE;
+        break;
       }
-      /* Set next read address*/
-      Offset += 512;
+      /* Read the block data by DMA */
+      STM_SPI_ReadBuffer(pBuffer, BlockSize);
+      pBuffer += BlockSize;
       
-      /* get CRC bytes (not really needed by us, but required by SD) */
+      /* Get CRC bytes (not really needed by us, but required by SD) */
       SD_ReadByte();
       SD_ReadByte();
-      
-      /* Set response value to success */
-      rvalue = SD_RESPONSE_NO_ERROR;
     }
-    else
+    
+    /* Send CMD12 (SD_CMD_STOP_TRANSMISSION) to end the stream: the byte 
+       following the command is a stuff byte, then comes the R1 response */
+    SD_SendCmd(SD_CMD_STOP_TRANSMISSION, 0, 0xFF);
+    SD_ReadByte();
+    if (SD_GetResponse(SD_RESPONSE_NO_ERROR))
     {
-      /* Set response value to failure */
       rvalue = SD_RESPONSE_FAILURE;
     }
+    /* Wait for the end of the busy state */
+    while (SD_ReadByte() == 0);
   }
   /* SD chip select high */
   SD_CS_HIGH();
@@ -232,7 +223,6 @@ SD_Error SD_ReadMultiBlocks(uint8_t* pBuffer, uint32_t ReadAddr, uint16_t BlockS
   */
 SD_Error SD_WriteBlock(uint8_t* pBuffer, uint32_t WriteAddr, uint16_t BlockSize)
 {
-  uint32_t i = 0;
   SD_Error rvalue = SD_RESPONSE_FAILURE;
 
   /* SD chip select low */
@@ -250,14 +240,8 @@ SD_Error SD_WriteBlock(uint8_t* pBuffer, uint32_t WriteAddr, uint16_t BlockSize)
     /* Send the data token to signify the start of the data */
     SD_WriteByte(0xFE);
 
-    /* Write the block data to SD : write count data by block */
-    for (i = 0; i < BlockSize; i++)
-    {
-      /* Send the pointed byte */
-      SD_WriteByte(*pBuffer);
-      /* Point to the next location where the byte read will be saved */
-      pBuffer++;
-    }
+    /* Write the block data to SD by DMA */
+    STM_SPI_WriteBuffer(pBuffer, BlockSize);
     /* Put CRC bytes (not really needed by us, but required by SD) */
     SD_ReadByte();
     SD_ReadByte();
@@ -291,49 +275,49 @@ SD_Error SD_WriteBlock(uint8_t* pBuffer, uint32_t WriteAddr, uint16_t BlockSize)
   */
 SD_Error SD_WriteMultiBlocks(uint8_t* pBuffer, uint32_t WriteAddr, uint16_t BlockSize, uint32_t NumberOfBlocks)
 {
-  uint32_t i = 0, Offset = 0;
   SD_Error rvalue = SD_RESPONSE_FAILURE;
 
   /* SD chip select low */
   SD_CS_LOW();
-  /* Data transfer */
-  while (NumberOfBlocks--)
+  
+  /* Send CMD25 (SD_CMD_WRITE_MULT_BLOCK): the card accepts consecutive blocks 
+     until it receives the stop token */
+  SD_SendCmd(SD_CMD_WRITE_MULT_BLOCK, WriteAddr, 0xFF);
+  
+  /* Check if the SD acknowledged the write command: R1 response (0x00: no errors) */
+  if (!SD_GetResponse(SD_RESPONSE_NO_ERROR))
   {
-    /* Write single block */
-    SD_SendCmd(SD_CMD_WRITE_SINGLE_BLOCK, WriteAddr + Offset, 0xFF);
-    /* Check if the SD acknowledged the write block command: R1 response (0x00: no errors) */
-    if (SD_GetResponse(SD_RESPONSE_NO_ERROR))
-    {
-      return SD_RESPONSE_FAILURE;
-    }
     /* Send dummy byte */
     SD_WriteByte(SD_DUMMY_BYTE);
-    /* Send the data token to signify the start of the data */
-    SD_WriteByte(SD_START_DATA_SINGLE_BLOCK_WRITE);
-    /* Write the block data to SD : write count data by block */
-    for (i = 0; i < BlockSize; i++)
+    
+    rvalue = SD_RESPONSE_NO_ERROR;
+    
+    while (NumberOfBlocks--)
     {
-      /* Send the pointed byte */
-      SD_WriteByte(*pBuffer);
-      /* Point to the next location where the byte read will be saved */
-      pBuffer++;
+      /* Send the data token to signify the start of the block */
+      SD_WriteByte(SD_START_DATA_MULTIPLE_BLOCK_WRITE);
+      
+      /* Write the block data by DMA */
+      STM_SPI_WriteBuffer(pBuffer, BlockSize);
+      pBuffer += BlockSize;
+      
+      /* Put CRC bytes (not really needed by us, but required by SD) */
+      SD_ReadByte();
+      SD_ReadByte();
+      
+      /* Read data response, then wait for the block to be programmed */
+      if (SD_GetDataResponse() != SD_DATA_OK)
+      {
+        rvalue = SD_RESPONSE_FAILURE;
+        break;
+      }
     }
-    /* Set next write address */
-    Offset += 512;
-    /* Put CRC bytes (not really needed by us, but required by SD) */
-    SD_ReadByte();
+    
+    /* Send the stop token, also after a rejected block, then wait for the 
+       end of the programming */
+    SD_WriteByte(SD_STOP_DATA_MULTIPLE_BLOCK_WRITE);
     SD_ReadByte();
-    /* Read data response */
-    if (SD_GetDataResponse() == SD_DATA_OK)
-    {
-      /* Set response value to success */
-      rvalue = SD_RESPONSE_NO_ERROR;
-    }
-    else
-    {
-      /* Set response value to failure */
-      rvalue = SD_RESPONSE_FAILURE;
-    }
+    while (SD_ReadByte() == 0);
   }
   /* SD chip select high */
   SD_CS_HIGH();
@@ -70,11 +70,21 @@ const uint8_t BUTTON_PORT_SOURCE[BUTTONn] = {USER_BUTTON_EXTI_PORT_SOURCE};
 const uint8_t BUTTON_PIN_SOURCE[BUTTONn] = {USER_BUTTON_EXTI_PIN_SOURCE}; 
 const uint8_t BUTTON_IRQn[BUTTONn] = {USER_BUTTON_EXTI_IRQn};
 
+/* Set while a transfer started by STM_SPI_StartWrite16() is not waited for */
+static __IO uint8_t SPI_DMAPending = 0;
+/* 0xFF filler clocked out by DMA reads and sink of the frames received 
+   during DMA writes */
+static const uint16_t SPI_DMAFiller = 0xFFFF;
+static uint16_t SPI_DMASink;
+
 /**
   * @}
   */ 
 
 /* Private function prototypes -----------------------------------------------*/
+static void STM_SPI_DMAStart(uint32_t RxAddr, uint32_t RxInc, uint32_t TxAddr, 
+                             uint32_t TxInc, uint16_t DataSize, uint16_t Length);
+static void STM_SPI_DMAWait(void);
 
 /** @defgroup STM32L1XX_NUCLEO_LOW_LEVEL_Private_Functions
   * @{
@@ -213,6 +223,9 @@ void STM_SPI_Init(void)
   /* Enable SPI clock */
   RCC_APB2PeriphClockCmd(LCD_SD_SPI_CLK, ENABLE); 
 
+  /* Enable the DMA clock used by the buffer transfers */
+  RCC_AHBPeriphClockCmd(LCD_SD_SPI_DMA_CLK, ENABLE);
+
   /* Configure SPI SCK pin */
   GPIO_InitStructure.GPIO_Pin = SPI_SCK_PIN;
   GPIO_InitStructure.GPIO_Mode = GPIO_Mode_AF;
@@ -321,6 +334,12 @@ uint8_t STM_SPI_WriteRead(uint8_t Data)
 {
   uint8_t tmp = 0x00;
  
+  /* The bus is shared: let a pending 16-bit DMA write complete first */
+  if (SPI_DMAPending != 0)
+  {
+    STM_SPI_WaitTransfer();
+  }
+
   /* Wait until the transmit buffer is empty */ 
   while(SPI_I2S_GetFlagStatus(LCD_SD_SPI, SPI_I2S_FLAG_TXE) != SET)
   {
@@ -347,6 +366,177 @@ uint8_t STM_SPI_WriteRead(uint8_t Data)
   return tmp;
 }
 
+/**
+  * @brief  Receives a buffer through the SPI interface using DMA, clocking 
+  *         out 0xFF. Returns when the last byte is received.
+  * @param  pBuffer: pointer to the buffer that receives the data.
+  * @param  Length: number of bytes to receive.
+  * @retval None
+  */
+void STM_SPI_ReadBuffer(uint8_t* pBuffer, uint16_t Length)
+{
+  if (Length == 0)
+  {
+    return;
+  }
+  STM_SPI_WaitTransfer();
+  
+  STM_SPI_DMAStart((uint32_t)pBuffer, DMA_MemoryInc_Enable, 
+                   (uint32_t)&SPI_DMAFiller, DMA_MemoryInc_Disable, 
+                   SPI_DataSize_8b, Length);
+  STM_SPI_DMAWait();
+}
+
+/**
+  * @brief  Sends a buffer through the SPI interface using DMA. The received 
+  *         bytes are discarded. Returns when the last byte is sent.
+  * @param  pBuffer: pointer to the data to be sent.
+  * @param  Length: number of bytes to send.
+  * @retval None
+  */
+void STM_SPI_WriteBuffer(const uint8_t* pBuffer, uint16_t Length)
+{
+  if (Length == 0)
+  {
+    return;
+  }
+  STM_SPI_WaitTransfer();
+  
+  STM_SPI_DMAStart((uint32_t)&SPI_DMASink, DMA_MemoryInc_Disable, 
+                   (uint32_t)pBuffer, DMA_MemoryInc_Enable, 
+                   SPI_DataSize_8b, Length);
+  STM_SPI_DMAWait();
+}
+
+/**
+  * @brief  Starts sending a buffer of 16-bit frames (MSB first) through the 
+  *         SPI interface using DMA, and returns immediately.
+  * @note   This is meant for RGB565 pixels: the little-endian halfwords go 
+  *         out high byte first with no byte swap.
+  * @note   The buffer must not be modified, and the chip select of the 
+  *         target must not be released, before STM_SPI_WaitTransfer() is 
+  *         called. Any other use of the bus waits for the transfer first.
+  * @param  pBuffer: pointer to the frames to be sent.
+  * @param  Length: number of 16-bit frames to send.
+  * @retval None
+  */
+void STM_SPI_StartWrite16(const uint16_t* pBuffer, uint16_t Length)
+{
+  if (Length == 0)
+  {
+    return;
+  }
+  STM_SPI_WaitTransfer();
+  
+  /* The frame format can only be changed while the SPI is disabled */
+  SPI_Cmd(LCD_SD_SPI, DISABLE);
+  SPI_DataSizeConfig(LCD_SD_SPI, SPI_DataSize_16b);
+  SPI_Cmd(LCD_SD_SPI, ENABLE);
+  
+  SPI_DMAPending = 1;
+  STM_SPI_DMAStart((uint32_t)&SPI_DMASink, DMA_MemoryInc_Disable, 
+                   (uint32_t)pBuffer, DMA_MemoryInc_Enable, 
+                   SPI_DataSize_16b, Length);
+}
+
+/**
+  * @brief  Waits for the end of a transfer started by STM_SPI_StartWrite16() 
+  *         and restores the 8-bit frame format. Returns at once if no 
+  *         transfer is pending.
+  * @param  None
+  * @retval None
+  */
+void STM_SPI_WaitTransfer(void)
+{
+  if (SPI_DMAPending == 0)
+  {
+    return;
+  }
+  STM_SPI_DMAWait();
+  
+  SPI_Cmd(LCD_SD_SPI, DISABLE);
+  SPI_DataSizeConfig(LCD_SD_SPI, SPI_DataSize_8b);
+  SPI_Cmd(LCD_SD_SPI, ENABLE);
+  
+  SPI_DMAPending = 0;
+}
+
+/**
+  * @brief  Programs both SPI DMA channels and starts a full duplex transfer.
+  * @param  RxAddr: memory address receiving the frames.
+  * @param  RxInc: DMA_MemoryInc_Enable or DMA_MemoryInc_Disable for RxAddr.
+  * @param  TxAddr: memory address of the frames to send.
+  * @param  TxInc: DMA_MemoryInc_Enable or DMA_MemoryInc_Disable for TxAddr.
+  * @param  DataSize: SPI_DataSize_8b or SPI_DataSize_16b, as configured in 
+  *         the SPI.
+  * @param  Length: number of frames.
+  * @retval None
+  */
+static void STM_SPI_DMAStart(uint32_t RxAddr, uint32_t RxInc, uint32_t TxAddr, 
+                             uint32_t TxInc, uint16_t DataSize, uint16_t Length)
+{
+  DMA_InitTypeDef DMA_InitStructure;
+  
+  DMA_Cmd(LCD_SD_SPI_DMA_RX_CHANNEL, DISABLE);
+  DMA_Cmd(LCD_SD_SPI_DMA_TX_CHANNEL, DISABLE);
+  DMA_ClearFlag(LCD_SD_SPI_DMA_RX_FLAG_GL | LCD_SD_SPI_DMA_TX_FLAG_GL);
+  
+  DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)&LCD_SD_SPI->DR;
+  DMA_InitStructure.DMA_BufferSize = Length;
+  DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+  if (DataSize == SPI_DataSize_16b)
+  {
+    DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_HalfWord;
+    DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_HalfWord;
+  }
+  else
+  {
+    DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Byte;
+    DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_Byte;
+  }
+  DMA_InitStructure.DMA_Mode = DMA_Mode_Normal;
+  DMA_InitStructure.DMA_M2M = DMA_M2M_Disable;
+  
+  /* Receive channel: served first so that no frame is overrun */
+  DMA_InitStructure.DMA_MemoryBaseAddr = RxAddr;
+  DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralSRC;
+  DMA_InitStructure.DMA_MemoryInc = RxInc;
+  DMA_InitStructure.DMA_Priority = DMA_Priority_VeryHigh;
+  DMA_Init(LCD_SD_SPI_DMA_RX_CHANNEL, &DMA_InitStructure);
+  
+  /* Transmit channel */
+  DMA_InitStructure.DMA_MemoryBaseAddr = TxAddr;
+  DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralDST;
+  DMA_InitStructure.DMA_MemoryInc = TxInc;
+  DMA_InitStructure.DMA_Priority = DMA_Priority_High;
+  DMA_Init(LCD_SD_SPI_DMA_TX_CHANNEL, &DMA_InitStructure);
+  
+  DMA_Cmd(LCD_SD_SPI_DMA_RX_CHANNEL, ENABLE);
+  DMA_Cmd(LCD_SD_SPI_DMA_TX_CHANNEL, ENABLE);
+  SPI_I2S_DMACmd(LCD_SD_SPI, SPI_I2S_DMAReq_Rx | SPI_I2S_DMAReq_Tx, ENABLE);
+}
+
+/**
+  * @brief  Waits for the end of the DMA transfer and releases the channels.
+  * @note   The receive channel completes with the last frame on the wire, 
+  *         so the bus is idle once it is done.
+  * @param  None
+  * @retval None
+  */
+static void STM_SPI_DMAWait(void)
+{
+  while (DMA_GetFlagStatus(LCD_SD_SPI_DMA_RX_FLAG_TC) == RESET)
+  {
+  }
+  while (SPI_I2S_GetFlagStatus(LCD_SD_SPI, SPI_I2S_FLAG_BSY) != RESET)
+  {
+  }
+  
+  SPI_I2S_DMACmd(LCD_SD_SPI, SPI_I2S_DMAReq_Rx | SPI_I2S_DMAReq_Tx, DISABLE);
+  DMA_Cmd(LCD_SD_SPI_DMA_RX_CHANNEL, DISABLE);
+  DMA_Cmd(LCD_SD_SPI_DMA_TX_CHANNEL, DISABLE);
+}
+
 /**
   * @brief  Initializes ADC, used to detect motion of Joystick available on 
   *         adafruit 1.8" TFT shield.
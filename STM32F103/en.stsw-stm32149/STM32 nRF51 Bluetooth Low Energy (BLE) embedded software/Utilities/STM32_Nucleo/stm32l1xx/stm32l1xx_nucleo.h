@@ -169,6 +169,17 @@ typedef enum
 #define SPI_MOSI_GPIO_CLK             RCC_AHBPeriph_GPIOA
 #define SPI_MOSI_SOURCE               GPIO_PinSource7
 #define SPI_MOSI_AF                   GPIO_AF_SPI1
+
+/**
+  * @brief  SPI DMA channels (DMA1 request mapping: SPI1_RX on channel 2, 
+  *         SPI1_TX on channel 3)
+  */
+#define LCD_SD_SPI_DMA_CLK            RCC_AHBPeriph_DMA1
+#define LCD_SD_SPI_DMA_RX_CHANNEL     DMA1_Channel2
+#define LCD_SD_SPI_DMA_RX_FLAG_TC     DMA1_FLAG_TC2
+#define LCD_SD_SPI_DMA_RX_FLAG_GL     DMA1_FLAG_GL2
+#define LCD_SD_SPI_DMA_TX_CHANNEL     DMA1_Channel3
+#define LCD_SD_SPI_DMA_TX_FLAG_GL     DMA1_FLAG_GL3
 /**
   * @}
   */  
@@ -222,6 +233,10 @@ uint32_t STM_EVAL_PBGetState(Button_TypeDef Button);
    LCD, uSD card and Joystick available in adafruit 1.8" TFT shield */
 void STM_SPI_Init(void);
 uint8_t STM_SPI_WriteRead(uint8_t Data);
+void STM_SPI_ReadBuffer(uint8_t* pBuffer, uint16_t Length);
+void STM_SPI_WriteBuffer(const uint8_t* pBuffer, uint16_t Length);
+void STM_SPI_StartWrite16(const uint16_t* pBuffer, uint16_t Length);
+void STM_SPI_WaitTransfer(void);
 void LCD_CtrlLines_Config(void);
 void SD_CtrlLines_Config(void);
 void STM_ADC_Config(void);
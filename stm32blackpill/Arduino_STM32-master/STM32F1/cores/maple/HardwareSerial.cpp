@@ -124,6 +124,19 @@ int HardwareSerial::peek(void)
     return usart_peek(this->usart_device);
 }
 
+/* The receive ring buffer, a contiguous run at a time, for Stream's
+ * bulk reads. */
+
+size_t HardwareSerial::readSpan(const uint8_t **data)
+{
+    return rb_span(this->usart_device->rb, data);
+}
+
+void HardwareSerial::consume(size_t n)
+{
+    rb_discard(this->usart_device->rb, n);
+}
+
 int HardwareSerial::availableForWrite(void)
 {
     return this->usart_device->wb->size-rb_full_count(this->usart_device->wb);
@@ -136,6 +136,8 @@ public:
     virtual int available(void);
     virtual int peek(void);
     virtual int read(void);
+    virtual size_t readSpan(const uint8_t **data);
+    virtual void consume(size_t n);
     int availableForWrite(void);
     virtual void flush(void);
     virtual size_t write(uint8_t);
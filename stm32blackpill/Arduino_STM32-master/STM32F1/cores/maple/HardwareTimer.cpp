@@ -66,6 +66,8 @@ HardwareTimer::HardwareTimer(uint8 timerNum) {
     timer_foreach(set_this_dev);
     interrupts();
     ASSERT(this->dev != NULL);
+    this->dma_d = NULL;
+    this->dma_state = DMA_STATE_IDLE;
 }
 
 void HardwareTimer::pause(void) {
@@ -147,6 +149,257 @@ void HardwareTimer::disableDMA(int channel) {
     timer_dma_disable_req(this->dev, (uint8)channel);
 }
 
+/*
+ * Capture/PWM DMA streams
+ */
+
+/* DMA request line per timer: (controller << 4) | channel, 0 = none.
+ * Index 0 is the update request, 1-4 the capture/compare channels. */
+static const uint8 timer_dma_map[8][5] = {
+    /*  UP    CH1   CH2   CH3   CH4 */
+    { 0x15, 0x12, 0x13, 0x16, 0x14 }, /* TIMER1 */
+    { 0x12, 0x15, 0x17, 0x11, 0x17 }, /* TIMER2 */
+    { 0x13, 0x16, 0x00, 0x12, 0x13 }, /* TIMER3 */
+    { 0x17, 0x11, 0x14, 0x15, 0x00 }, /* TIMER4 */
+    { 0x22, 0x25, 0x24, 0x22, 0x21 }, /* TIMER5 */
+    { 0x23, 0x00, 0x00, 0x00, 0x00 }, /* TIMER6 */
+    { 0x24, 0x00, 0x00, 0x00, 0x00 }, /* TIMER7 */
+    { 0x21, 0x23, 0x25, 0x21, 0x22 }, /* TIMER8 */
+};
+
+static uint8 timer_dma_request(timer_dev *dev, uint8 channel) {
+    uint8 t = dev->clk_id - RCC_TIMER1;
+    return t < 8 ? timer_dma_map[t][channel] : 0;
+}
+
+/* DMA handlers take no argument, so route each DMA channel back to
+ * the timer currently streaming on it. DMA1 channels 1-7 are slots
+ * 0-6, DMA2 channels 1-5 are slots 7-11. */
+static HardwareTimer *timer_dma_owner[12];
+
+static uint8 timer_dma_slot(dma_dev *dev, dma_tube tube) {
+    return (dev == DMA1 ? 0 : 7) + (tube - 1);
+}
+
+#define TIMER_DMA_IRQ(n)                                        \
+    static void timer_dma_irq##n(void) {                        \
+        if (timer_dma_owner[n]) timer_dma_owner[n]->dmaIrqHandler(); \
+    }
+TIMER_DMA_IRQ(0)  TIMER_DMA_IRQ(1)  TIMER_DMA_IRQ(2)  TIMER_DMA_IRQ(3)
+TIMER_DMA_IRQ(4)  TIMER_DMA_IRQ(5)  TIMER_DMA_IRQ(6)  TIMER_DMA_IRQ(7)
+TIMER_DMA_IRQ(8)  TIMER_DMA_IRQ(9)  TIMER_DMA_IRQ(10) TIMER_DMA_IRQ(11)
+
+static void (*const timer_dma_irq[12])(void) = {
+    timer_dma_irq0, timer_dma_irq1, timer_dma_irq2,  timer_dma_irq3,
+    timer_dma_irq4, timer_dma_irq5, timer_dma_irq6,  timer_dma_irq7,
+    timer_dma_irq8, timer_dma_irq9, timer_dma_irq10, timer_dma_irq11,
+};
+
+bool HardwareTimer::dmaClaim(uint8 request) {
+    if (!request) {
+        return false;
+    }
+
+#if defined(STM32_HIGH_DENSITY) || defined(STM32_XL_DENSITY)
+    dma_dev *d = (request >> 4) == 2 ? DMA2 : DMA1;
+#else
+    if ((request >> 4) != 1) {
+        return false;
+    }
+    dma_dev *d = DMA1;
+#endif
+    dma_tube t = (dma_tube)(request & 0xF);
+
+    /* Request lines of different timers share channels; never take
+     * one over from another timer. */
+    uint8 slot = timer_dma_slot(d, t);
+    if (timer_dma_owner[slot] != NULL && timer_dma_owner[slot] != this) {
+        return false;
+    }
+
+    this->stopDMA();
+    this->dma_d = d;
+    this->dma_t = t;
+    timer_dma_owner[slot] = this;
+    dma_init(this->dma_d);
+    dma_attach_interrupt(this->dma_d, this->dma_t, timer_dma_irq[slot]);
+    return true;
+}
+
+void HardwareTimer::stopDMA(void) {
+    if (this->dma_state == DMA_STATE_IDLE && this->dma_d == NULL) {
+        return;
+    }
+    if (this->dma_state == DMA_STATE_CAPTURE) {
+        timer_dma_disable_req(this->dev, this->dma_cc_channel);
+    } else {
+        timer_dma_disable_upd_req(this->dev);
+    }
+    this->dma_state = DMA_STATE_IDLE;
+    dma_disable(this->dma_d, this->dma_t);
+    dma_detach_interrupt(this->dma_d, this->dma_t);
+    timer_dma_owner[timer_dma_slot(this->dma_d, this->dma_t)] = NULL;
+    this->dma_d = NULL;
+}
+
+void HardwareTimer::dmaIrqHandler(void) {
+    uint8 isr = dma_get_isr_bits(this->dma_d, this->dma_t);
+
+    switch (this->dma_state) {
+    case DMA_STATE_CAPTURE:
+        if (isr & DMA_ISR_TCIF) {
+            this->cap_laps++;
+        }
+        break;
+    case DMA_STATE_PWM:
+        /* Last value is in CCRx/the burst registers; it stays there.
+         * Hand the channel back so other timers can use it. */
+        this->stopDMA();
+        break;
+    default:
+        break;
+    }
+}
+
+bool HardwareTimer::captureDMAStart(int channel, uint16 *buf, uint16 count) {
+    if (channel < 1 || channel > 4 || !count) {
+        return false;
+    }
+    if (!this->dmaClaim(timer_dma_request(this->dev, (uint8)channel))) {
+        return false;
+    }
+
+    this->cap_buf = buf;
+    this->cap_len = count;
+    this->cap_laps = 0;
+    this->cap_tail_laps = 0;
+    this->cap_tail_pos = 0;
+    this->cap_overrun = false;
+    this->dma_cc_channel = (uint8)channel;
+    timer_reset_status_bit(this->dev, TIMER_SR_CC1OF_BIT + channel - 1);
+
+    dma_setup_transfer(this->dma_d, this->dma_t,
+                       &(this->dev->regs).gen->CCR1 + (channel - 1), DMA_SIZE_16BITS,
+                       buf, DMA_SIZE_16BITS,
+                       (DMA_MINC_MODE | DMA_CIRC_MODE | DMA_TRNS_CMPLT));
+    dma_set_num_transfers(this->dma_d, this->dma_t, count);
+    dma_set_priority(this->dma_d, this->dma_t, DMA_PRIORITY_HIGH);
+    this->dma_state = DMA_STATE_CAPTURE;
+    dma_enable(this->dma_d, this->dma_t);
+    timer_dma_enable_req(this->dev, (uint8)channel);
+    return true;
+}
+
+/* Current DMA write position as (completed laps, index). CNDTR and the
+ * lap counter are read with interrupts off; a wrap whose interrupt is
+ * still pending is counted here. */
+void HardwareTimer::captureHead(uint32 *laps, uint16 *pos) {
+    noInterrupts();
+    uint32 l = this->cap_laps;
+    uint16 left = dma_get_count(this->dma_d, this->dma_t);
+    if (dma_get_isr_bits(this->dma_d, this->dma_t) & DMA_ISR_TCIF) {
+        l++;
+        left = dma_get_count(this->dma_d, this->dma_t);
+    }
+    interrupts();
+    *laps = l;
+    *pos = (uint16)(this->cap_len - left);
+}
+
+uint16 HardwareTimer::captureDMAAvailable(void) {
+    uint32 laps;
+    uint16 pos;
+
+    if (this->dma_state != DMA_STATE_CAPTURE) {
+        return 0;
+    }
+    if (timer_get_status(this->dev) & (TIMER_SR_CC1OF << (this->dma_cc_channel - 1))) {
+        timer_reset_status_bit(this->dev, TIMER_SR_CC1OF_BIT + this->dma_cc_channel - 1);
+        this->cap_overrun = true;
+    }
+
+    this->captureHead(&laps, &pos);
+    uint32 lapdiff = laps - this->cap_tail_laps;
+    if (lapdiff > 1 || (lapdiff == 1 && pos > this->cap_tail_pos)) {
+        /* Writer lapped us; what's left is a mix of old and new. */
+        this->cap_overrun = true;
+        this->cap_tail_laps = laps;
+        this->cap_tail_pos = pos;
+        return 0;
+    }
+    return (uint16)(lapdiff * this->cap_len + pos - this->cap_tail_pos);
+}
+
+uint16 HardwareTimer::captureDMARead(uint16 *dst, uint16 max) {
+    uint16 n = this->captureDMAAvailable();
+    if (n > max) {
+        n = max;
+    }
+    for (uint16 i = 0; i < n; i++) {
+        dst[i] = this->cap_buf[this->cap_tail_pos];
+        if (++this->cap_tail_pos == this->cap_len) {
+            this->cap_tail_pos = 0;
+            this->cap_tail_laps++;
+        }
+    }
+    return n;
+}
+
+bool HardwareTimer::captureDMAOverrun(void) {
+    this->captureDMAAvailable();
+    bool ret = this->cap_overrun;
+    this->cap_overrun = false;
+    return ret;
+}
+
+bool HardwareTimer::pwmDMAStart(int channel, const uint16 *seq, uint16 count, bool loop) {
+    if (this->dev->type == TIMER_BASIC || channel < 1 || channel > 4 || !count) {
+        return false;
+    }
+    if (!this->dmaClaim(timer_dma_request(this->dev, 0))) {
+        return false;
+    }
+
+    dma_setup_transfer(this->dma_d, this->dma_t,
+                       &(this->dev->regs).gen->CCR1 + (channel - 1), DMA_SIZE_16BITS,
+                       (void *)seq, DMA_SIZE_16BITS,
+                       (DMA_MINC_MODE | DMA_FROM_MEM |
+                        (loop ? DMA_CIRC_MODE : DMA_TRNS_CMPLT)));
+    dma_set_num_transfers(this->dma_d, this->dma_t, count);
+    this->dma_state = loop ? DMA_STATE_PWM_LOOP : DMA_STATE_PWM;
+    dma_enable(this->dma_d, this->dma_t);
+    timer_dma_enable_upd_req(this->dev);
+    return true;
+}
+
+bool HardwareTimer::pwmDMABurstStart(timer_dma_base_addr base, uint8 regsPerFrame,
+                                     const uint16 *seq, uint16 frames, bool loop) {
+    uint32 count = (uint32)frames * regsPerFrame;
+
+    if (this->dev->type == TIMER_BASIC || !regsPerFrame || regsPerFrame > 18 ||
+        !count || count > 0xFFFF) {
+        return false;
+    }
+    if (!this->dmaClaim(timer_dma_request(this->dev, 0))) {
+        return false;
+    }
+
+    timer_dma_set_base_addr(this->dev, base);
+    timer_dma_set_burst_len(this->dev, regsPerFrame);
+    (this->dev->regs).gen->CR1 |= TIMER_CR1_ARPE;
+
+    dma_setup_transfer(this->dma_d, this->dma_t,
+                       &(this->dev->regs).gen->DMAR, DMA_SIZE_16BITS,
+                       (void *)seq, DMA_SIZE_16BITS,
+                       (DMA_MINC_MODE | DMA_FROM_MEM |
+                        (loop ? DMA_CIRC_MODE : DMA_TRNS_CMPLT)));
+    dma_set_num_transfers(this->dma_d, this->dma_t, (uint16)count);
+    this->dma_state = loop ? DMA_STATE_PWM_LOOP : DMA_STATE_PWM;
+    dma_enable(this->dma_d, this->dma_t);
+    timer_dma_enable_upd_req(this->dev);
+    return true;
+}
+
 void HardwareTimer::refresh(void) {
     timer_generate_update(this->dev);
 }
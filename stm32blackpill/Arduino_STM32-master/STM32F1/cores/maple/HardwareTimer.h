@@ -34,6 +34,7 @@
 // TODO [0.1.0] Remove deprecated pieces, pick a better API
 
 #include <libmaple/timer.h>
+#include <libmaple/dma.h>
 
 /** Timer mode. */
 typedef timer_mode TimerMode;
@@ -49,6 +50,28 @@ class HardwareTimer {
 private:
     timer_dev *dev;
 
+    enum {
+        DMA_STATE_IDLE,
+        DMA_STATE_CAPTURE,
+        DMA_STATE_PWM,
+        DMA_STATE_PWM_LOOP
+    };
+
+    /* Capture/PWM DMA stream state */
+    dma_dev *dma_d;
+    dma_tube dma_t;
+    volatile uint8 dma_state;
+    uint8 dma_cc_channel;
+    bool cap_overrun;
+    uint16 *cap_buf;
+    uint16 cap_len;
+    volatile uint32 cap_laps;
+    uint32 cap_tail_laps;
+    uint16 cap_tail_pos;
+
+    bool dmaClaim(uint8 request);
+    void captureHead(uint32 *laps, uint16 *pos);
+
 public:
     /**
      * @brief Construct a new HardwareTimer instance.
@@ -274,6 +297,95 @@ public:
     void enableDMA(int channel);
     void disableDMA(int channel);
 
+    /**
+     * @brief Stream input capture values into a circular buffer.
+     *
+     * The channel must already be in input capture mode.  Every
+     * capture is copied from CCRx into buf by DMA without CPU
+     * involvement; read them back with captureDMARead().  Only one
+     * DMA stream (capture or PWM) can run per timer at a time.
+     *
+     * @param channel Timer channel, from 1 to 4.
+     * @param buf Buffer for raw counter values, owned by the timer
+     *            until stopDMA().
+     * @param count Number of entries in buf.
+     * @return false if the channel has no DMA request line, or if
+     *         another timer is using its DMA channel.
+     * @see HardwareTimer::captureDMARead()
+     */
+    bool captureDMAStart(int channel, uint16 *buf, uint16 count);
+
+    /**
+     * @brief Stop a capture or PWM DMA stream and release its DMA
+     *        channel.
+     */
+    void stopDMA(void);
+
+    /**
+     * @brief Number of captured values not yet read.
+     */
+    uint16 captureDMAAvailable(void);
+
+    /**
+     * @brief Copy up to max captured values, oldest first.
+     * @return Number of values copied.
+     */
+    uint16 captureDMARead(uint16 *dst, uint16 max);
+
+    /**
+     * @brief True if captures were lost since captureDMAStart().
+     *
+     * Set when the DMA write position laps the reader (unread values
+     * are discarded and reading resumes at the newest data) or when
+     * the timer reports an over-capture.  Cleared by reading it.
+     */
+    bool captureDMAOverrun(void);
+
+    /**
+     * @brief Play a sequence of compare values on a PWM channel.
+     *
+     * One value is loaded into CCRx per timer update, so each period
+     * gets its own duty cycle.  The channel must already be in PWM
+     * mode.  Unless looping, the DMA channel is released when the
+     * last value has been loaded; a looping sequence keeps it until
+     * stopDMA().
+     *
+     * @param channel Timer channel, from 1 to 4.
+     * @param seq Compare values; must stay valid while playing.
+     * @param count Number of values in seq.
+     * @param loop Restart from the beginning instead of stopping.
+     * @return false if the timer has no compare channels or no update
+     *         DMA request line, or if another timer is using its DMA
+     *         channel.
+     */
+    bool pwmDMAStart(int channel, const uint16 *seq, uint16 count, bool loop = false);
+
+    /**
+     * @brief Play a sequence of register frames using DMA burst mode.
+     *
+     * On every update, regsPerFrame consecutive timer registers
+     * starting at base are written from seq.  For example base
+     * TIMER_DMA_BASE_ARR with 3 registers loads ARR, RCR and CCR1,
+     * changing period and duty together.  ARR preload is enabled so a
+     * new period starts cleanly.  The DMA channel is released as for
+     * pwmDMAStart().
+     *
+     * @param frames Number of frames in seq (seq holds
+     *               frames * regsPerFrame values).
+     * @return false if the timer has no update DMA request line, or if
+     *         another timer is using its DMA channel.
+     */
+    bool pwmDMABurstStart(timer_dma_base_addr base, uint8 regsPerFrame,
+                          const uint16 *seq, uint16 frames, bool loop = false);
+
+    /**
+     * @brief True while a non-looping PWM sequence is still playing.
+     */
+    bool pwmDMABusy(void) { return dma_state == DMA_STATE_PWM; }
+
+    /** @brief Internal; DMA transfer interrupt for this timer's stream. */
+    void dmaIrqHandler(void);
+
     /**
      * @brief Get a pointer to the underlying libmaple timer_dev for
      *        this HardwareTimer instance.
@@ -27,11 +27,14 @@
 #define NO_SKIP_CHAR  1  // a magic char not found in a valid ASCII numeric field
 
 // private method to read stream with timeout
+// the clock is only read once the stream has run dry
 int Stream::timedRead()
 {
-  int c;
+  int c = read();
+  if (c >= 0) return c;
   _startMillis = millis();
   do {
+    yield();
     c = read();
     if (c >= 0) return c;
   } while(millis() - _startMillis < _timeout);
@@ -41,15 +44,68 @@ int Stream::timedRead()
 // private method to peek stream with timeout
 int Stream::timedPeek()
 {
-  int c;
+  int c = peek();
+  if (c >= 0) return c;
   _startMillis = millis();
   do {
+    yield();
     c = peek();
     if (c >= 0) return c;
   } while(millis() - _startMillis < _timeout);
   return -1;     // -1 indicates timeout
 }
 
+// private method to get a span of received data with timeout
+size_t Stream::timedSpan(const uint8_t **data)
+{
+  size_t n = readSpan(data);
+  if (n) return n;
+  _startMillis = millis();
+  do {
+    yield();
+    n = readSpan(data);
+    if (n) return n;
+  } while(millis() - _startMillis < _timeout);
+  return 0;      // 0 indicates timeout
+}
+
+// one match step for findUntil and findMulti: returns how much of str
+// is matched after c, given index characters were matched before it.
+// On a mismatch we need to walk back and see if we could have matched
+// further down the stream (ie '1112' doesn't match the first position
+// in '11112' but it will match the second position so we can't just
+// reset the current index to 0 when we find a mismatch).
+static size_t matchStep(const char *str, size_t index, char c)
+{
+  // the simple case is if we match, deal with that first.
+  if (c == str[index])
+    return index + 1;
+
+  size_t origIndex = index;
+  while (index) {
+    --index;
+    // first check if current char works against the new current index
+    if (c != str[index])
+      continue;
+
+    // otherwise we need to check the rest of the found string
+    size_t diff = origIndex - index;
+    size_t i;
+    for (i = 0; i < index; ++i) {
+      if (str[i] != str[i + diff])
+        break;
+    }
+
+    // if we successfully got through the previous loop then our current
+    // index is good.
+    if (i == index)
+      return index + 1;
+
+    // otherwise we just try the next index
+  }
+  return 0;
+}
+
 // returns peek of the next digit in the stream or -1 if timeout
 // discards non-numeric characters
 int Stream::peekNextDigit()
@@ -72,6 +128,38 @@ void Stream::setTimeout(unsigned long timeout)  // sets the maximum number of mi
   _timeout = timeout;
 }
 
+// a stream without a buffer of its own hands out one byte at a time
+size_t Stream::readSpan(const uint8_t **data)
+{
+  int c = peek();
+  if (c < 0) return 0;
+  _spanByte = c;
+  *data = &_spanByte;
+  return 1;
+}
+
+void Stream::consume(size_t n)
+{
+  while (n--)
+    read();
+}
+
+// copies up to length bytes that have already arrived, never waits
+// returns the number of bytes placed in the buffer
+size_t Stream::readAvailable(uint8_t *buffer, size_t length)
+{
+  size_t count = 0;
+  const uint8_t *data;
+  size_t n;
+  while (count < length && (n = readSpan(&data)) > 0) {
+    if (n > length - count) n = length - count;
+    memcpy(buffer + count, data, n);
+    consume(n);
+    count += n;
+  }
+  return count;
+}
+
  // find returns true if the target string is found
 bool  Stream::find(char *target)
 {
@@ -94,36 +182,101 @@ bool  Stream::findUntil(char *target, char *terminator)
 // reads data from the stream until the target string of the given length is found
 // search terminated if the terminator string is found
 // returns true if target string is found, false if terminated or timed out
+// while neither string is partly matched, memchr skips to the next byte
+// that could start one
 bool Stream::findUntil(char *target, size_t targetLen, char *terminator, size_t termLen)
 {
-  size_t index = 0;  // maximum target string length is 64k bytes!
+  size_t index = 0;
   size_t termIndex = 0;
-  int c;
-  
-  if( *target == 0)
+  const uint8_t *data;
+  size_t n;
+
+  if (targetLen == 0 || *target == 0)
     return true;   // return true if target is a null string
-  while( (c = timedRead()) > 0){
-    
-    if(c != target[index])
-      index = 0; // reset index if any char does not match
-    
-    if( c == target[index]){
-      //////Serial.print("found "); Serial.write(c); Serial.print("index now"); Serial.println(index+1);
-      if(++index >= targetLen){ // return true if all chars in the target match
+  while ((n = timedSpan(&data)) > 0) {
+    size_t i = 0;
+    while (i < n) {
+      if (index == 0 && termIndex == 0) {
+        const uint8_t *p = (const uint8_t *)memchr(data + i, target[0], n - i);
+        size_t end = p ? p - data : n;
+        if (termLen > 0 && end > i) {
+          p = (const uint8_t *)memchr(data + i, terminator[0], end - i);
+          if (p) end = p - data;
+        }
+        i = end;
+        if (i == n) break;
+      }
+      char c = data[i++];
+      index = matchStep(target, index, c);
+      if (index >= targetLen) { // return true if all chars in the target match
+        consume(i);
         return true;
       }
+      if (termLen > 0) {
+        termIndex = matchStep(terminator, termIndex, c);
+        if (termIndex >= termLen) {
+          consume(i);
+          return false;     // return false if terminate string found before target string
+        }
+      }
     }
-    
-    if(termLen > 0 && c == terminator[termIndex]){
-      if(++termIndex >= termLen)
-        return false;       // return false if terminate string found before target string
-    }
-    else
-      termIndex = 0;
+    consume(n);
   }
   return false;
 }
 
+// number parsing state machine shared by the blocking and the polling
+// versions: takes bytes from data until the number ends, returns how
+// many it took and sets *done if the number has ended.  Initial
+// characters that are not digits (or the minus sign) are skipped, the
+// byte that ends the number is left in the stream.
+size_t Stream::parseNumber(const uint8_t *data, size_t length, bool isFloat, char skipChar, bool *done)
+{
+  size_t i;
+  for (i = 0; i < length; i++) {
+    char c = data[i];
+    if (_number.state == 0) {
+      // ignore non numeric leading characters
+      if (c != '-' && (c < '0' || c > '9'))
+        continue;
+      _number.state = 1;
+      _number.isNegative = false;
+      _number.isFraction = false;
+      _number.value = 0;
+      _number.fraction = 1.0;
+      if (c == '-') {
+        _number.isNegative = true;
+        continue;
+      }
+    }
+    if (c == skipChar)
+      ; // ignore this charactor
+    else if (c >= '0' && c <= '9') {      // is c a digit?
+      _number.value = _number.value * 10 + c - '0';
+      if (_number.isFraction)
+        _number.fraction *= 0.1;
+    }
+    else if (isFloat && c == '.')
+      _number.isFraction = true;
+    else {
+      *done = true;
+      return i;
+    }
+  }
+  *done = false;
+  return i;
+}
+
+// takes what has arrived without waiting; true once the number has ended
+bool Stream::pollNumber(bool isFloat, char skipChar)
+{
+  const uint8_t *data;
+  size_t n;
+  bool done = false;
+  while (!done && (n = readSpan(&data)) > 0)
+    consume(parseNumber(data, n, isFloat, skipChar, &done));
+  return done;
+}
 
 // returns the first valid (long) integer value from the current position.
 // initial characters that are not digits (or the minus sign) are skipped
@@ -137,30 +290,20 @@ long Stream::parseInt()
 // this allows format characters (typically commas) in values to be ignored
 long Stream::parseInt(char skipChar)
 {
-  boolean isNegative = false;
-  long value = 0;
-  int c;
-
-  c = peekNextDigit();
-  // ignore non numeric leading characters
-  if(c < 0)
+  const uint8_t *data;
+  size_t n;
+  bool done = false;
+
+  _number.state = 0;
+  while (!done && (n = timedSpan(&data)) > 0)
+    consume(parseNumber(data, n, false, skipChar, &done));
+  if (_number.state == 0)
     return 0; // zero returned if timeout
+  _number.state = 0;
 
-  do{
-    if(c == skipChar)
-      ; // ignore this charactor
-    else if(c == '-')
-      isNegative = true;
-    else if(c >= '0' && c <= '9')        // is c a digit?
-      value = value * 10 + c - '0';
-    read();  // consume the character we got with peek
-    c = timedPeek();
-  }
-  while( (c >= '0' && c <= '9') || c == skipChar );
-
-  if(isNegative)
-    value = -value;
-  return value;
+  if (_number.isNegative)
+    return -_number.value;
+  return _number.value;
 }
 
 
@@ -173,42 +316,59 @@ float Stream::parseFloat()
 // as above but the given skipChar is ignored
 // this allows format characters (typically commas) in values to be ignored
 float Stream::parseFloat(char skipChar){
-  boolean isNegative = false;
-  boolean isFraction = false;
-  long value = 0;
-  int c;
-  float fraction = 1.0;
-
-  c = peekNextDigit();
-    // ignore non numeric leading characters
-  if(c < 0)
+  const uint8_t *data;
+  size_t n;
+  bool done = false;
+
+  _number.state = 0;
+  while (!done && (n = timedSpan(&data)) > 0)
+    consume(parseNumber(data, n, true, skipChar, &done));
+  if (_number.state == 0)
     return 0; // zero returned if timeout
+  _number.state = 0;
 
-  do{
-    if(c == skipChar)
-      ; // ignore
-    else if(c == '-')
-      isNegative = true;
-    else if (c == '.')
-      isFraction = true;
-    else if(c >= '0' && c <= '9')  {      // is c a digit?
-      value = value * 10 + c - '0';
-      if(isFraction)
-         fraction *= 0.1;
-    }
-    read();  // consume the character we got with peek
-    c = timedPeek();
-  }
-  while( (c >= '0' && c <= '9')  || c == '.' || c == skipChar );
-
-  if(isNegative)
-    value = -value;
-  if(isFraction)
-    return value * fraction;
+  long value = _number.isNegative ? -_number.value : _number.value;
+  if (_number.isFraction)
+    return value * _number.fraction;
   else
     return value;
 }
 
+// as parseInt but never waits: false until the number has ended, the
+// digits that arrived so far are kept for the next call
+bool Stream::pollInt(long *value)
+{
+  return pollInt(value, NO_SKIP_CHAR);
+}
+
+bool Stream::pollInt(long *value, char skipChar)
+{
+  if (!pollNumber(false, skipChar))
+    return false;
+  _number.state = 0;
+  *value = _number.isNegative ? -_number.value : _number.value;
+  return true;
+}
+
+// as parseFloat but never waits, like pollInt
+bool Stream::pollFloat(float *value)
+{
+  return pollFloat(value, NO_SKIP_CHAR);
+}
+
+bool Stream::pollFloat(float *value, char skipChar)
+{
+  if (!pollNumber(true, skipChar))
+    return false;
+  _number.state = 0;
+  long v = _number.isNegative ? -_number.value : _number.value;
+  if (_number.isFraction)
+    *value = v * _number.fraction;
+  else
+    *value = v;
+  return true;
+}
+
 // read characters from stream into buffer
 // terminates if length characters have been read, or timeout (see setTimeout)
 // returns the number of characters placed in the buffer
@@ -217,11 +377,13 @@ float Stream::parseFloat(char skipChar){
 size_t Stream::readBytes(char *buffer, size_t length)
 {
   size_t count = 0;
-  while (count < length) {
-    int c = timedRead();
-    if (c < 0) break;
-    *buffer++ = (char)c;
-    count++;
+  const uint8_t *data;
+  size_t n;
+  while (count < length && (n = timedSpan(&data)) > 0) {
+    if (n > length - count) n = length - count;
+    memcpy(buffer + count, data, n);
+    consume(n);
+    count += n;
   }
   return count;
 }
@@ -233,13 +395,20 @@ size_t Stream::readBytes(char *buffer, size_t length)
 
 size_t Stream::readBytesUntil(char terminator, char *buffer, size_t length)
 {
-  if (length < 1) return 0;
   size_t index = 0;
-  while (index < length) {
-    int c = timedRead();
-    if (c < 0 || c == terminator) break;
-    *buffer++ = (char)c;
-    index++;
+  const uint8_t *data;
+  size_t n;
+  while (index < length && (n = timedSpan(&data)) > 0) {
+    if (n > length - index) n = length - index;
+    const uint8_t *t = (const uint8_t *)memchr(data, terminator, n);
+    size_t copy = t ? t - data : n;
+    memcpy(buffer + index, data, copy);
+    index += copy;
+    if (t) {
+      consume(copy + 1);  // the terminator is consumed but not stored
+      break;
+    }
+    consume(n);
   }
   return index; // return number of characters, not including null terminator
 }
@@ -283,51 +452,9 @@ int Stream::findMulti( struct Stream::MultiTarget *targets, int tCount) {
       return -1;
 
     for (struct MultiTarget *t = targets; t < targets+tCount; ++t) {
-      // the simple case is if we match, deal with that first.
-      if (c == t->str[t->index]) {
-        if (++t->index == t->len)
-          return t - targets;
-        else
-          continue;
-      }
-
-      // if not we need to walk back and see if we could have matched further
-      // down the stream (ie '1112' doesn't match the first position in '11112'
-      // but it will match the second position so we can't just reset the current
-      // index to 0 when we find a mismatch.
-      if (t->index == 0)
-        continue;
-
-      int origIndex = t->index;
-      do {
-        --t->index;
-        // first check if current char works against the new current index
-        if (c != t->str[t->index])
-          continue;
-
-        // if it's the only char then we're good, nothing more to check
-        if (t->index == 0) {
-          t->index++;
-          break;
-        }
-
-        // otherwise we need to check the rest of the found string
-        int diff = origIndex - t->index;
-        size_t i;
-        for (i = 0; i < t->index; ++i) {
-          if (t->str[i] != t->str[i + diff])
-            break;
-        }
-
-        // if we successfully got through the previous loop then our current
-        // index is good.
-        if (i == t->index) {
-          t->index++;
-          break;
-        }
-
-        // otherwise we just try the next index
-      } while (t->index);
+      t->index = matchStep(t->str, t->index, c);
+      if (t->index == t->len)
+        return t - targets;
     }
   }
   // unreachable
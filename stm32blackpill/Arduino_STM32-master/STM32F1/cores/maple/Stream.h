@@ -40,9 +40,11 @@ class Stream : public Print
   protected:
     unsigned long _timeout;      // number of milliseconds to wait for the next char before aborting timed read
     unsigned long _startMillis;  // used for timeout measurement
+    uint8_t _spanByte;           // readSpan() of streams without a buffer
     int timedRead();    // private method to read stream with timeout
     int timedPeek();    // private method to peek stream with timeout
     int peekNextDigit(); // returns the next numeric digit in the stream or -1 if timeout
+    size_t timedSpan(const uint8_t **data); // readSpan() with timeout, 0 if timed out
 
   public:
     virtual int available() = 0;
@@ -50,7 +52,20 @@ class Stream : public Print
     virtual int peek() = 0;
     virtual void flush() = 0;
 
-    Stream() {_timeout=1000;}
+    Stream() {_timeout=1000; _number.state = 0; }
+
+// bulk access to received data
+
+  // Points *data at received bytes that are contiguous in the stream's
+  // buffer and returns how many there are, 0 if none; never waits.
+  // consume(n) then removes the first n of them (n at most what
+  // readSpan() returned).  Streams without a buffer of their own hand
+  // out one byte at a time through peek() and read().
+  virtual size_t readSpan(const uint8_t **data);
+  virtual void consume(size_t n);
+
+  size_t readAvailable(uint8_t *buffer, size_t length); // copies what has arrived, never waits
+  size_t readAvailable(char *buffer, size_t length) { return readAvailable((uint8_t *)buffer, length); }
 
 // parsing methods
 
@@ -80,6 +95,17 @@ class Stream : public Print
 
   float parseFloat();               // float version of parseInt
 
+  // Non-blocking parseInt() and parseFloat(): take the data that has
+  // arrived and return true with *value once the number has ended (the
+  // character that ends it stays in the stream).  Until then they return
+  // false and carry on from where they stopped on the next call, so one
+  // number may be in progress per stream.  pollReset() drops it.
+  bool pollInt(long *value);
+  bool pollInt(long *value, char skipChar);
+  bool pollFloat(float *value);
+  bool pollFloat(float *value, char skipChar);
+  void pollReset(void) { _number.state = 0; }
+
   size_t readBytes( char *buffer, size_t length); // read chars from stream into buffer
   size_t readBytes( uint8_t *buffer, size_t length) { return readBytes((char *)buffer, length); }
   // terminates if length characters have been read or timeout (see setTimeout)
@@ -101,6 +127,18 @@ class Stream : public Print
 
   float parseFloat(char skipChar);  // as above but the given skipChar is ignored
 
+  // number being parsed, shared by parseInt/parseFloat and the poll versions
+  struct NumberParse {
+    uint8_t state;      // 0: skipping to the number, 1: in the number
+    bool isNegative;
+    bool isFraction;
+    long value;
+    float fraction;
+  } _number;
+
+  size_t parseNumber(const uint8_t *data, size_t length, bool isFloat, char skipChar, bool *done);
+  bool pollNumber(bool isFloat, char skipChar);
+
   struct MultiTarget {
     const char *str;  // string you're searching for
     size_t len;       // length of string you're searching for
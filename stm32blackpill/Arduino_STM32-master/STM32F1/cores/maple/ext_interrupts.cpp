@@ -67,6 +67,38 @@ void attachInterrupt(uint8 pin, voidArgumentFuncPtr handler, void *arg,
                           outMode);
 }
 
+void attachInterruptRing(uint8 pin, exti_ring *ring, ExtIntTriggerMode mode) {
+    if (pin >= BOARD_NR_GPIO_PINS || !ring) {
+        return;
+    }
+
+    exti_trigger_mode outMode = exti_out_mode(mode);
+
+    exti_attach_ring((exti_num)(PIN_MAP[pin].gpio_bit),
+                     gpio_exti_port(PIN_MAP[pin].gpio_device),
+                     ring,
+                     outMode);
+}
+
+void setInterruptDeferred(uint8 pin, bool deferred) {
+    if (pin >= BOARD_NR_GPIO_PINS) {
+        return;
+    }
+
+    exti_set_deferred((exti_num)(PIN_MAP[pin].gpio_bit), deferred);
+}
+
+void getInterruptStats(uint8 pin, exti_line_stats *stats, bool reset) {
+    if (pin >= BOARD_NR_GPIO_PINS) {
+        return;
+    }
+
+    exti_get_stats((exti_num)(PIN_MAP[pin].gpio_bit), stats);
+    if (reset) {
+        exti_reset_stats((exti_num)(PIN_MAP[pin].gpio_bit));
+    }
+}
+
 void detachInterrupt(uint8 pin) {
     if (pin >= BOARD_NR_GPIO_PINS) {
         return;
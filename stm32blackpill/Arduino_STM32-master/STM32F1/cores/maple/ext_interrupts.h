@@ -34,6 +34,7 @@
 
 #include <libmaple/libmaple_types.h>
 #include <libmaple/nvic.h>
+#include <libmaple/exti.h>
 
 /**
  * The kind of transition on an external pin which should trigger an
@@ -90,6 +91,44 @@ void attachInterrupt(uint8 pin, voidFuncPtr handler, ExtIntTriggerMode mode);
 void attachInterrupt(uint8 pin, voidArgumentFuncPtr handler, void *arg,
                      ExtIntTriggerMode mode);
 
+/**
+ *  @brief Timestamp edges on a pin instead of running a handler.
+ *
+ *  Every edge stores the CPU cycle count (DWT CYCCNT) taken on entry
+ *  to the interrupt into ring, which must have been set up with
+ *  exti_ring_init().  Read them back with exti_ring_read(); edges that
+ *  find the ring full are counted in the pin's overrun statistics.
+ *
+ *  @param pin Pin number
+ *  @param ring Timestamp ring
+ *  @param mode Type of transition to trigger on, e.g. falling, rising, etc.
+ *
+ *  @sideeffect Registers a timestamp ring
+ *  @see detachInterrupt()
+ *  @see getInterruptStats()
+ */
+void attachInterruptRing(uint8 pin, exti_ring *ring, ExtIntTriggerMode mode);
+
+/**
+ *  @brief Run a pin's handler from the low priority PendSV exception.
+ *
+ *  The interrupt itself then only counts the edge; the handler runs
+ *  once higher priority interrupts are done.  Edges that arrive while
+ *  the handler is still waiting count as overruns.
+ *
+ *  @param pin Pin number
+ *  @param deferred true to defer, false to run in the interrupt.
+ */
+void setInterruptDeferred(uint8 pin, bool deferred);
+
+/**
+ *  @brief Get a pin's interrupt hit and overrun counters.
+ *  @param pin Pin number
+ *  @param stats Receives the counters
+ *  @param reset Zero the counters after reading them
+ */
+void getInterruptStats(uint8 pin, exti_line_stats *stats, bool reset = false);
+
 /**
  * @brief Disable any registered external interrupt.
  * @param pin Maple pin number
@@ -0,0 +1,186 @@
+/**
+ * @file wirish/include/wirish/fastpin.h
+ * @brief Pin I/O resolved at compile time.
+ *
+ * digitalWrite() and digitalRead() look the pin up in PIN_MAP on
+ * every call. FastPin<PB12> finds port and bit from the variant's
+ * BOARD_GPIO_PORT_BITS while compiling, so high(), low() and read()
+ * come down to a single store or load to a constant address:
+ *
+ *     FastPin<PB12>::mode(OUTPUT);
+ *     FastPin<PB12>::high();
+ *
+ * FastBus<...> drives pins of one port together with one BSRR store,
+ * the first pin taking bit 0 of the value, for parallel buses such as
+ * 8080-style displays:
+ *
+ *     typedef FastBus<PB8, PB9, PB10, PB11, PB12, PB13, PB14, PB15> Data;
+ *     Data::write(byte);
+ *     FastPin<PA1>::low();     // WR
+ *     FastPin<PA1>::high();
+ *
+ * Pins that are consecutive bits of the port cost one shift; others
+ * one shift and OR per pin.
+ *
+ * Nothing here waits: the pins change as fast as the core can store,
+ * so slow devices still need their delays.
+ */
+
+#ifndef _WIRISH_FASTPIN_H_
+#define _WIRISH_FASTPIN_H_
+
+#include <libmaple/gpio.h>
+#include <libmaple/bitband.h>
+#include <boards.h>
+#include <io.h>
+#include <wirish_constants.h>
+
+/* GPIOA; the other ports follow FASTPIN_PORT_STRIDE apart. */
+#define FASTPIN_GPIO_BASE   0x40010800UL
+#define FASTPIN_PORT_STRIDE 0x400UL
+
+static constexpr uint8 fastpin_port_bits[] = { BOARD_GPIO_PORT_BITS };
+
+template<uint8 pin>
+class FastPin {
+    static_assert(pin < sizeof(fastpin_port_bits), "FastPin: no such pin");
+
+  public:
+    static const uint8 port = fastpin_port_bits[pin] >> 4;
+    static const uint8 bit = fastpin_port_bits[pin] & 0xF;
+    static const uint32 mask = 1UL << bit;
+
+    static inline gpio_reg_map *regs(void) {
+        return (gpio_reg_map*)(FASTPIN_GPIO_BASE + port * FASTPIN_PORT_STRIDE);
+    }
+
+    static inline void mode(WiringPinMode m) { pinMode(pin, m); }
+
+    static inline void high(void) { regs()->BSRR = mask; }
+    static inline void low(void) { regs()->BRR = mask; }
+
+    /* Same as digitalWrite(): any non-zero val sets the pin. */
+    static inline void write(uint8 val) {
+        regs()->BSRR = val ? mask : mask << 16;
+    }
+
+    /* Not atomic, like gpio_toggle_bit(). */
+    static inline void toggle(void) { regs()->ODR ^= mask; }
+
+    /* HIGH or LOW, through the bit-band alias of IDR. */
+    static inline uint32 read(void) { return *bb_perip(&regs()->IDR, bit); }
+};
+
+/* Mask, port check and bit spreading over a list of pins. */
+template<uint8... pins>
+struct fastbus_pins {
+    static const uint32 mask = 0;
+    static constexpr bool on_port(uint8) { return true; }
+    static constexpr bool runs_from(uint8) { return true; }
+    static inline uint32 spread(uint32) { return 0; }
+    static inline uint32 gather(uint32) { return 0; }
+    static inline void mode(WiringPinMode) { }
+};
+
+template<uint8 pin, uint8... rest>
+struct fastbus_pins<pin, rest...> {
+    typedef FastPin<pin> P;
+    typedef fastbus_pins<rest...> R;
+
+    static const uint32 mask = P::mask | R::mask;
+
+    static constexpr bool on_port(uint8 port) {
+        return P::port == port && R::on_port(port);
+    }
+
+    /* Pins are bits b, b + 1, ... of the port. */
+    static constexpr bool runs_from(uint8 b) {
+        return P::bit == b && R::runs_from(b + 1);
+    }
+
+    static inline uint32 spread(uint32 v) {
+        return ((v & 1) << P::bit) | R::spread(v >> 1);
+    }
+
+    static inline uint32 gather(uint32 idr) {
+        return ((idr >> P::bit) & 1) | (R::gather(idr) << 1);
+    }
+
+    static inline void mode(WiringPinMode m) {
+        P::mode(m);
+        R::mode(m);
+    }
+};
+
+template<uint8 first, uint8... rest>
+class FastBus {
+    typedef FastPin<first> F;
+    typedef fastbus_pins<first, rest...> L;
+
+    static_assert(L::on_port(F::port), "FastBus: pins must be on one port");
+
+    static const bool run = L::runs_from(F::bit);
+
+  public:
+    static const uint32 mask = L::mask;
+    static const uint8 width = 1 + sizeof...(rest);
+
+    static inline void mode(WiringPinMode m) { L::mode(m); }
+
+    /* Bits of value above width are ignored. The set half of BSRR
+     * wins over the reset half, so every pin is reset and the ones
+     * to set are set in the same store. */
+    static inline void write(uint32 value) {
+        uint32 set = run ? (value << F::bit) & mask : L::spread(value);
+        F::regs()->BSRR = (mask << 16) | set;
+    }
+
+    static inline uint32 read(void) {
+        uint32 idr = F::regs()->IDR;
+        return run ? (idr & mask) >> F::bit : L::gather(idr);
+    }
+};
+
+/**
+ * shiftOut() and shiftIn() with the pins fixed at compile time, e.g.
+ * shiftOut<PB15, PB13>(MSBFIRST, value). The clock runs at several
+ * MHz; the clock pin is left low.
+ */
+template<uint8 dataPin, uint8 clockPin>
+inline void shiftOut(uint8 bitOrder, uint8 value) {
+    typedef FastPin<dataPin> D;
+    typedef FastPin<clockPin> C;
+    C::low();
+    if (bitOrder == LSBFIRST) {
+        for (int i = 0; i < 8; i++, value >>= 1) {
+            D::write(value & 0x01);
+            C::high();
+            C::low();
+        }
+    } else {
+        for (int i = 0; i < 8; i++, value <<= 1) {
+            D::write(value & 0x80);
+            C::high();
+            C::low();
+        }
+    }
+}
+
+template<uint8 dataPin, uint8 clockPin>
+inline uint8 shiftIn(uint8 bitOrder) {
+    typedef FastPin<dataPin> D;
+    typedef FastPin<clockPin> C;
+    uint8 value = 0;
+    for (int i = 0; i < 8; i++) {
+        C::high();
+        if (bitOrder == LSBFIRST) {
+            value |= D::read() << i;
+        } else {
+            value |= D::read() << (7 - i);
+        }
+        C::low();
+    }
+    return value;
+}
+
+#endif
@@ -137,13 +137,72 @@ uint32 digitalRead(uint8 pin);
  * conversion, and has 12 bits of resolution.  The pin must have its
  * mode set to INPUT_ANALOG.
  *
+ * For a pin that analogScanBegin() converts in the background, this
+ * returns its newest sample without waiting.
+ *
  * @param pin Pin to read from.
  * @return Converted voltage, in the range 0--4095, (i.e. a 12-bit ADC
  *         conversion).
  * @see pinMode()
+ * @see analogScanBegin()
  */
 uint16 analogRead(uint8 pin);
 
+/** Most pins analogScanBegin() takes. */
+#define ANALOG_SCAN_MAX 16
+
+/**
+ * Convert pins continuously in the background.
+ *
+ * ADC1 converts the pins one after the other in scan mode, over and
+ * over, and DMA stores every sample in memory, so analogRead() of
+ * these pins is a load instead of a conversion.  One scan takes
+ * sum(sample time + 12.5) ADC clock cycles, about 1.2 uS per pin at
+ * the shortest sample time and a 12 MHz ADC clock.
+ *
+ * With dual set, ADC1 and ADC2 convert two pins at a time (regular
+ * simultaneous mode), so a scan takes half as long.  The pins of a
+ * pair then use the longer of their two sample times.
+ *
+ * Other pins are still read with analogRead(), by ADC2 unless dual
+ * is set, in which case they read 0 until analogScanEnd().
+ *
+ * @param pins Pins to convert, each one with an ADC channel.
+ * @param nPins Number of pins, 1 to ANALOG_SCAN_MAX.
+ * @param sampleTimes Sample time of each pin, or NULL to keep the
+ *                    default one.
+ * @param dual Use ADC1 and ADC2 together.
+ * @return false if a pin has no ADC channel or appears twice.
+ * @see analogScanRead()
+ */
+bool analogScanBegin(const uint8 *pins, uint8 nPins,
+                     const adc_smp_rate *sampleTimes = NULL,
+                     bool dual = false);
+
+/**
+ * Stop the background conversions; analogRead() converts again.
+ */
+void analogScanEnd(void);
+
+/**
+ * Newest sample of a pin that analogScanBegin() converts.
+ *
+ * @param pin Pin to read.
+ * @param seq If not NULL, receives the number of the scan the sample
+ *            comes from, counting from 1; 0 if there is none yet.
+ *            analogScanCount() minus seq is the sample's age in scans,
+ *            0 for the scan in progress.
+ * @return The sample, or 0 if the pin is not converted in the
+ *         background or has not been yet.
+ */
+uint16 analogScanRead(uint8 pin, uint32 *seq);
+
+/**
+ * Number of scans started since analogScanBegin().  It wraps after
+ * 2^32 scans.
+ */
+uint32 analogScanCount(void);
+
 /**
  * Shift out a byte of data, one bit at a time.
  *
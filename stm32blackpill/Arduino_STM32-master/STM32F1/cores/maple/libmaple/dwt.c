@@ -0,0 +1,64 @@
+/******************************************************************************
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The  above copyright  notice and  this permission  notice  shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *****************************************************************************/
+
+/**
+ * @file libmaple/dwt.c
+ * @brief 64 bit extension of the DWT cycle counter
+ */
+
+#include <libmaple/dwt.h>
+#include <util/atomic.h>
+
+volatile uint32 dwt_cycles_hi;
+volatile uint32 dwt_cycles_last;
+
+/**
+ * @brief Start the cycle counter from 0 for dwt_cycles64().
+ */
+void dwt_cycles64_init(void) {
+    dwt_cycle_counter_enable();
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        DWT_BASE->CYCCNT = 0;
+        dwt_cycles_hi = 0;
+        dwt_cycles_last = 0;
+    }
+}
+
+/**
+ * @brief Count a wrap of the cycle counter since the last call.
+ *
+ * Must be called at least once per 2^32 cycles, and from one context
+ * only; the SysTick interrupt does it.  The two words change together
+ * with interrupts off, so dwt_cycles64() in a higher priority
+ * interrupt never sees one without the other.
+ */
+void dwt_cycles_extend(void) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        uint32 now = DWT_BASE->CYCCNT;
+        if (now < dwt_cycles_last) {
+            dwt_cycles_hi++;
+        }
+        dwt_cycles_last = now;
+    }
+}
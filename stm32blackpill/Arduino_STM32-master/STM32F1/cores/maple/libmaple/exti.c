@@ -34,9 +34,12 @@
 #include <libmaple/libmaple.h>
 #include <libmaple/nvic.h>
 #include <libmaple/bitband.h>
+#include <libmaple/scb.h>
+#include <libmaple/dwt.h>
 
-static inline void dispatch_single_exti(uint32 exti_num);
-static inline void dispatch_extis(uint32 start, uint32 stop);
+static inline void dispatch_extis(uint32 msk);
+static void exti_enable_line(exti_num num, exti_cfg port,
+                             exti_trigger_mode mode);
 
 /*
  * Internal state
@@ -45,6 +48,7 @@ static inline void dispatch_extis(uint32 start, uint32 stop);
 typedef struct exti_channel {
     void (*handler)(void *);
     void *arg;
+    exti_ring *ring;
 } exti_channel;
 
 static exti_channel exti_channels[] = {
@@ -66,6 +70,19 @@ static exti_channel exti_channels[] = {
     { .handler = NULL, .arg = NULL },  // EXTI15
 };
 
+static exti_line_stats exti_stats[16];
+
+/* Lines with a handler or ring attached; only these are dispatched. */
+static uint32 exti_active_msk;
+/* Lines feeding a timestamp ring; the cycle counter is read only for
+ * these. */
+static uint32 exti_ring_msk;
+/* Lines whose handler runs from PendSV instead of the EXTI vector. */
+static uint32 exti_deferred_msk;
+/* Deferred handlers waiting for PendSV.  Bits are set and cleared
+ * through the bit-band alias so neither side needs a lock. */
+static volatile uint32 exti_deferred_pending;
+
 /*
  * Portable routines
  */
@@ -119,9 +136,126 @@ void exti_attach_callback(exti_num num,
     ASSERT(handler);
 
     /* Register the handler */
+    exti_ring_msk &= ~(1U << num);
     exti_channels[num].handler = handler;
     exti_channels[num].arg = arg;
+    exti_channels[num].ring = NULL;
+
+    exti_enable_line(num, port, mode);
+}
+
+/**
+ * @brief Record edge timestamps on an external interrupt line.
+ *
+ * Each edge stores the DWT cycle count, sampled on entry to the EXTI
+ * interrupt, into ring.  No handler runs; drain the ring with
+ * exti_ring_read().  Edges arriving while the ring is full are
+ * counted as overruns.  Starts the DWT cycle counter if needed.
+ *
+ * @param num  External interrupt line number.
+ * @param port Port to use as source input for external interrupt.
+ * @param ring Ring initialized with exti_ring_init().
+ * @param mode Type of transition to trigger on.
+ * @see exti_ring_read()
+ */
+void exti_attach_ring(exti_num num,
+                      exti_cfg port,
+                      exti_ring *ring,
+                      exti_trigger_mode mode) {
+    ASSERT(ring);
+
+    dwt_cycle_counter_enable();
+    exti_channels[num].handler = NULL;
+    exti_channels[num].arg = NULL;
+    exti_channels[num].ring = ring;
+    exti_ring_msk |= 1U << num;
+
+    exti_enable_line(num, port, mode);
+}
+
+/**
+ * @brief Run a line's handler from PendSV instead of the EXTI vector.
+ *
+ * The EXTI interrupt then only counts the edge and pends PendSV,
+ * which runs at the lowest priority, so other interrupts are not
+ * held off by slow handlers.  Edges that arrive while the handler is
+ * still pending are counted as overruns.
+ *
+ * If another PendSV handler (e.g. an RTOS) is linked in, it must call
+ * exti_run_deferred() itself.
+ *
+ * @param num      External interrupt line number.
+ * @param deferred Nonzero to defer, zero to call handlers directly.
+ */
+void exti_set_deferred(exti_num num, int deferred) {
+    if (deferred) {
+        nvic_irq_set_priority(NVIC_PEND_SVC, 0xF);
+        exti_deferred_msk |= 1U << num;
+    } else {
+        exti_deferred_msk &= ~(1U << num);
+    }
+}
+
+/**
+ * @brief Run pending deferred handlers, highest line first.
+ */
+void exti_run_deferred(void) {
+    uint32 pending;
+
+    while ((pending = exti_deferred_pending) != 0) {
+        uint32 exti = 31 - __builtin_clz(pending);
+        bb_sram_set_bit(&exti_deferred_pending, exti, 0);
+        voidArgumentFuncPtr handler = exti_channels[exti].handler;
+        if (handler) {
+            handler(exti_channels[exti].arg);
+        }
+    }
+}
+
+/**
+ * @brief Copy a line's hit and overrun counters.
+ */
+void exti_get_stats(exti_num num, exti_line_stats *stats) {
+    *stats = exti_stats[num];
+}
+
+/**
+ * @brief Zero a line's hit and overrun counters.
+ */
+void exti_reset_stats(exti_num num) {
+    exti_stats[num].hits = 0;
+    exti_stats[num].overruns = 0;
+}
+
+/**
+ * @brief Unregister an external interrupt handler
+ * @param num External interrupt line to disable.
+ * @see exti_num
+ */
+void exti_detach_interrupt(exti_num num) {
+    /* First, mask the interrupt request */
+    bb_peri_set_bit(&EXTI_BASE->IMR, num, 0);
+
+    /* Then, clear the trigger selection registers */
+    bb_peri_set_bit(&EXTI_BASE->FTSR, num, 0);
+    bb_peri_set_bit(&EXTI_BASE->RTSR, num, 0);
+
+    /* Finally, unregister the user's handler */
+    exti_active_msk &= ~(1U << num);
+    exti_ring_msk &= ~(1U << num);
+    exti_deferred_msk &= ~(1U << num);
+    exti_channels[num].handler = NULL;
+    exti_channels[num].arg = NULL;
+    exti_channels[num].ring = NULL;
+}
+
+/*
+ * Private routines
+ */
 
+/* Program trigger mode and port, then unmask the line and its IRQ. */
+static void exti_enable_line(exti_num num, exti_cfg port,
+                             exti_trigger_mode mode) {
     /* Set trigger mode */
     switch (mode) {
     case EXTI_RISING:
@@ -140,6 +274,7 @@ void exti_attach_callback(exti_num num,
     exti_select(num, port);
 
     /* Unmask external interrupt request */
+    exti_active_msk |= 1U << num;
     bb_peri_set_bit(&EXTI_BASE->IMR, num, 1);
 
     /* Enable the interrupt line */
@@ -178,28 +313,6 @@ void exti_attach_callback(exti_num num,
     }
 }
 
-/**
- * @brief Unregister an external interrupt handler
- * @param num External interrupt line to disable.
- * @see exti_num
- */
-void exti_detach_interrupt(exti_num num) {
-    /* First, mask the interrupt request */
-    bb_peri_set_bit(&EXTI_BASE->IMR, num, 0);
-
-    /* Then, clear the trigger selection registers */
-    bb_peri_set_bit(&EXTI_BASE->FTSR, num, 0);
-    bb_peri_set_bit(&EXTI_BASE->RTSR, num, 0);
-
-    /* Finally, unregister the user's handler */
-    exti_channels[num].handler = NULL;
-    exti_channels[num].arg = NULL;
-}
-
-/*
- * Private routines
- */
-
 void exti_do_select(__IO uint32 *exti_cr, exti_num num, exti_cfg port) {
     uint32 shift = 4 * (num % 4);
     uint32 cr = *exti_cr;
@@ -213,31 +326,35 @@ void exti_do_select(__IO uint32 *exti_cr, exti_num num, exti_cfg port) {
  */
 
 __weak void __irq_exti0(void) {
-    dispatch_single_exti(EXTI0);
+    dispatch_extis(1U << EXTI0);
 }
 
 __weak void __irq_exti1(void) {
-    dispatch_single_exti(EXTI1);
+    dispatch_extis(1U << EXTI1);
 }
 
 __weak void __irq_exti2(void) {
-    dispatch_single_exti(EXTI2);
+    dispatch_extis(1U << EXTI2);
 }
 
 __weak void __irq_exti3(void) {
-    dispatch_single_exti(EXTI3);
+    dispatch_extis(1U << EXTI3);
 }
 
 __weak void __irq_exti4(void) {
-    dispatch_single_exti(EXTI4);
+    dispatch_extis(1U << EXTI4);
 }
 
 __weak void __irq_exti9_5(void) {
-    dispatch_extis(5, 9);
+    dispatch_extis(0x03E0);
 }
 
 __weak void __irq_exti15_10(void) {
-    dispatch_extis(10, 15);
+    dispatch_extis(0xFC00);
+}
+
+__weak void __exc_pendsv(void) {
+    exti_run_deferred();
 }
 
 /*
@@ -256,37 +373,59 @@ static inline __always_inline void clear_pending_msk(uint32 exti_msk) {
     asm volatile("nop");
 }
 
-/* This dispatch routine is for non-multiplexed EXTI lines only; i.e.,
- * it doesn't check EXTI_PR. */
-static inline __always_inline void dispatch_single_exti(uint32 exti) {
-    voidArgumentFuncPtr handler = exti_channels[exti].handler;
+/* Count one edge on a line and run or defer its handler. */
+static inline __always_inline void dispatch_line(uint32 exti, uint32 now) {
+    exti_line_stats *stats = &exti_stats[exti];
+    exti_ring *ring = exti_channels[exti].ring;
 
-    if (!handler) {
+    stats->hits++;
+
+    if (ring) {
+        uint16 head = ring->head;
+        if ((uint16)(head - ring->tail) > ring->mask) {
+            stats->overruns++;
+        } else {
+            ring->buf[head & ring->mask] = now;
+            ring->head = head + 1;
+        }
+        return;
+    }
+
+    if (exti_deferred_msk & (1U << exti)) {
+        if (exti_deferred_pending & (1U << exti)) {
+            stats->overruns++;
+        } else {
+            bb_sram_set_bit(&exti_deferred_pending, exti, 1);
+        }
+        SCB_BASE->ICSR = SCB_ICSR_PENDSVSET;
         return;
     }
 
-    handler(exti_channels[exti].arg);
-    clear_pending_msk(1U << exti);
+    voidArgumentFuncPtr handler = exti_channels[exti].handler;
+    if (handler) {
+        handler(exti_channels[exti].arg);
+    }
 }
 
-/* Dispatch routine for EXTIs which share an IRQ. */
-static inline __always_inline void dispatch_extis(uint32 start, uint32 stop) {
-    uint32 pr = EXTI_BASE->PR;
-    uint32 handled_msk = 0;
-    uint32 exti;
-
-    /* Dispatch user handlers for pending EXTIs. */
-    for (exti = start; exti <= stop; exti++) {
-        uint32 eb = (1U << exti);
-        if (pr & eb) {
-            voidArgumentFuncPtr handler = exti_channels[exti].handler;
-            if (handler) {
-                handler(exti_channels[exti].arg);
-                handled_msk |= eb;
-            }
-        }
+/* Dispatch routine for the EXTI lines in msk.
+ *
+ * The timestamp is taken first so it is as close to the edge as
+ * possible, and only when a ring on one of these lines needs it.
+ * Pending bits are cleared before the handlers run, so an
+ * edge arriving during a handler re-pends the IRQ instead of being
+ * lost.  Only set bits are visited, highest first, using CLZ. */
+static inline __always_inline void dispatch_extis(uint32 msk) {
+    uint32 now = (msk & exti_ring_msk) ? dwt_cycles() : 0;
+    uint32 pr = EXTI_BASE->PR & msk & exti_active_msk;
+
+    if (!pr) {
+        return;
     }
+    clear_pending_msk(pr);
 
-    /* Clear the pending bits for handled EXTIs. */
-    clear_pending_msk(handled_msk);
+    do {
+        uint32 exti = 31 - __builtin_clz(pr);
+        pr &= ~(1U << exti);
+        dispatch_line(exti, now);
+    } while (pr);
 }
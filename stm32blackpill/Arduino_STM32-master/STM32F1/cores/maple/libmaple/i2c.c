@@ -43,11 +43,14 @@
 #include <libmaple/systick.h>
 
 #include <string.h>
+#include <stdint.h>
+#include <util/atomic.h>
 
 static inline int32 wait_for_state_change(i2c_dev *dev,
                                           i2c_state state,
                                           uint32 timeout);
 static void set_ccr_trise(i2c_dev *dev, uint32 flags);
+static void i2c_async_start(i2c_dev *dev);
 
 /**
  * @brief Fill data register with slave address
@@ -171,6 +174,9 @@ void i2c_init(i2c_dev *dev) {
  *              I2C_BUS_RESET: Reset the bus and clock out any hung slaves on
  *                             initialization,
  *              I2C_10BIT_ADDRESSING: Enable 10-bit addressing,
+ *              I2C_DMA: Move messages of I2C_DMA_MIN bytes or more by
+ *                       DMA (STM32F1: DMA1 channels 6/7 for I2C1, 4/5
+ *                       for I2C2, which must not be used otherwise),
  *              I2C_REMAP: (deprecated, STM32F1 only) Remap I2C1 to SCL/PB8
  *                         SDA/PB9.
  */
@@ -178,6 +184,8 @@ void i2c_master_enable(i2c_dev *dev, uint32 flags) {
     /* If the device is already enabled, don't do it again */
     if(dev->regs->CR1 & I2C_CR1_PE) return;
 
+    dev->config_flags = flags;
+
     /* Ugh */
     _i2c_handle_remap(dev, flags);
 
@@ -201,7 +209,11 @@ void i2c_master_enable(i2c_dev *dev, uint32 flags) {
     /* Make it go! */
     i2c_peripheral_enable(dev);
 
-    dev->state = I2C_STATE_IDLE;
+    /* Transfers queued while the device was down or in error */
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        dev->state = I2C_STATE_IDLE;
+        i2c_async_start(dev);
+    }
 }
 
 /**
@@ -225,13 +237,23 @@ int32 i2c_master_xfer(i2c_dev *dev,
                       uint16 num,
                       uint32 timeout) {
     int32 rc;
-
-    ASSERT(dev->state == I2C_STATE_IDLE);
+    uint8 claimed = 0;
+
+    /* Let an asynchronous transfer on the bus finish; queued ones
+     * wait until this one is done. */
+    while (!claimed) {
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            if (dev->xfer == NULL) {
+                ASSERT(dev->state == I2C_STATE_IDLE);
+                dev->state = I2C_STATE_BUSY;
+                claimed = 1;
+            }
+        }
+    }
 
     dev->msg = msgs;
     dev->msgs_left = num;
     dev->timestamp = systick_uptime();
-    dev->state = I2C_STATE_BUSY;
 
     i2c_enable_irq(dev, I2C_IRQ_EVENT);
     i2c_start_condition(dev);
@@ -241,11 +263,205 @@ int32 i2c_master_xfer(i2c_dev *dev,
         goto out;
     }
 
-    dev->state = I2C_STATE_IDLE;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        dev->state = I2C_STATE_IDLE;
+        i2c_async_start(dev);
+    }
 out:
     return rc;
 }
 
+/*
+ * Asynchronous transfers
+ *
+ * The transfer on the bus is dev->xfer; the others wait in a list.
+ * All of this runs with interrupts off, or from the I2C event and
+ * error interrupts and the I2C DMA receive interrupt, which are all
+ * at priority 0 and so never preempt each other.
+ */
+
+/* Start the next queued transfer if the bus is free. */
+static void i2c_async_start(i2c_dev *dev) {
+    i2c_xfer *xfer = dev->queue;
+
+    if (xfer == NULL || dev->xfer != NULL || dev->state != I2C_STATE_IDLE) {
+        return;
+    }
+    dev->queue = xfer->next;
+    dev->xfer = xfer;
+
+    dev->msg = xfer->msgs;
+    dev->msgs_left = xfer->num;
+    dev->timestamp = systick_uptime();
+    dev->state = I2C_STATE_BUSY;
+
+    i2c_enable_irq(dev, I2C_IRQ_EVENT);
+    i2c_start_condition(dev);
+}
+
+/* End the transfer on the bus, start the next one, then tell the
+ * owner, so the bus is already busy while the callback runs. */
+static void i2c_async_finish(i2c_dev *dev, int32 result) {
+    i2c_xfer *xfer = dev->xfer;
+
+    dev->xfer = NULL;
+    if (dev->state != I2C_STATE_DISABLED) {
+        dev->state = I2C_STATE_IDLE;
+    }
+    i2c_async_start(dev);
+
+    xfer->result = result;
+    if (xfer->callback) {
+        xfer->callback(xfer);
+    }
+}
+
+static void i2c_dma_abort(i2c_dev *dev) {
+    if (dev->dma_msg) {
+        _i2c_dma_stop(dev, dev->msg);
+        dev->regs->CR2 &= ~(I2C_CR2_DMAEN | I2C_CR2_LAST);
+        dev->dma_msg = 0;
+    }
+}
+
+/* Take a transfer that has not reached the bus out of the queue. */
+static int i2c_async_unlink(i2c_dev *dev, i2c_xfer *xfer) {
+    i2c_xfer **pp = &dev->queue;
+    i2c_xfer *prev = NULL;
+
+    while (*pp != NULL && *pp != xfer) {
+        prev = *pp;
+        pp = &prev->next;
+    }
+    if (*pp == NULL) {
+        return 0;
+    }
+    *pp = xfer->next;
+    if (dev->queue_tail == xfer) {
+        dev->queue_tail = prev;
+    }
+    return 1;
+}
+
+/* Restart the peripheral after an error, optionally clocking out a
+ * slave that holds SDA low first. */
+static void i2c_recover(i2c_dev *dev, uint32 bus_reset) {
+    uint32 flags = dev->config_flags;
+    i2c_dma_abort(dev);
+    i2c_disable(dev);
+    i2c_master_enable(dev, flags | bus_reset);
+    dev->config_flags = flags;
+}
+
+/**
+ * @brief Queue an I2C transaction without waiting for it.
+ *
+ * The transaction starts at once if the bus is free, otherwise when
+ * the ones queued before it have ended. xfer->result is set and
+ * xfer->callback called from the I2C interrupt when it is done.
+ * Synchronous i2c_master_xfer() calls wait for the transaction on
+ * the bus, but not for the queue.
+ *
+ * @param dev I2C device
+ * @param xfer Transaction; the caller fills in msgs, num, callback
+ *             and arg.
+ * @return 0 if queued, I2C_ERROR_PROTOCOL if xfer has no messages.
+ */
+int32 i2c_master_xfer_async(i2c_dev *dev, i2c_xfer *xfer) {
+    if (xfer->num == 0) {
+        xfer->result = I2C_ERROR_PROTOCOL;
+        return I2C_ERROR_PROTOCOL;
+    }
+    xfer->result = I2C_XFER_PENDING;
+    xfer->next = NULL;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (dev->queue == NULL) {
+            dev->queue = xfer;
+        } else {
+            dev->queue_tail->next = xfer;
+        }
+        dev->queue_tail = xfer;
+        i2c_async_start(dev);
+    }
+    return 0;
+}
+
+/**
+ * @brief Abort the asynchronous transfer on the bus if there has been
+ *        no bus event for a while.
+ *
+ * A slave stretching the clock forever would otherwise stall the
+ * queue. The transfer ends with I2C_ERROR_TIMEOUT, and the bus is
+ * reset with i2c_bus_reset() before the next one starts.
+ *
+ * Also restarts the queue when a failed i2c_master_xfer() left the
+ * device in error with transfers waiting.
+ *
+ * Call with interrupts enabled: the bus reset takes a while and is
+ * done outside the critical section.
+ *
+ * @param dev I2C device
+ * @param timeout Milliseconds without bus activity
+ */
+void i2c_master_check_timeout(i2c_dev *dev, uint32 timeout) {
+    uint32 bus_reset = 0;
+    uint8 restart = 0;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (dev->xfer && systick_uptime() - dev->timestamp > timeout) {
+            /* Nothing is started on a disabled device, so the queue
+             * waits for the restart below. */
+            i2c_disable_irq(dev, I2C_IRQ_BUFFER | I2C_IRQ_EVENT | I2C_IRQ_ERROR);
+            i2c_dma_abort(dev);
+            i2c_disable(dev);
+            i2c_async_finish(dev, I2C_ERROR_TIMEOUT);
+            bus_reset = I2C_BUS_RESET;
+            restart = 1;
+        } else if (!dev->xfer && dev->queue && dev->state == I2C_STATE_ERROR) {
+            i2c_disable(dev);
+            restart = 1;
+        }
+    }
+    if (restart) {
+        i2c_recover(dev, bus_reset);
+    }
+}
+
+/**
+ * @brief Wait for an asynchronous transaction to end.
+ * @param dev I2C device
+ * @param xfer Transaction queued with i2c_master_xfer_async()
+ * @param timeout As for i2c_master_xfer(); 0 waits forever. A
+ *                transaction still queued ends with I2C_ERROR_TIMEOUT
+ *                too once the bus has been idle for this long, e.g.
+ *                behind a disabled device.
+ * @return 0 on success, I2C_ERROR_PROTOCOL or I2C_ERROR_TIMEOUT.
+ */
+int32 i2c_master_xfer_wait(i2c_dev *dev, i2c_xfer *xfer, uint32 timeout) {
+    uint32 start = systick_uptime();
+
+    while (xfer->result == I2C_XFER_PENDING) {
+        if (!timeout) {
+            continue;
+        }
+        i2c_master_check_timeout(dev, timeout);
+
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            uint32 now = systick_uptime();
+            if (xfer->result == I2C_XFER_PENDING &&
+                now - start > timeout && now - dev->timestamp > timeout &&
+                i2c_async_unlink(dev, xfer)) {
+                xfer->result = I2C_ERROR_TIMEOUT;
+                if (xfer->callback) {
+                    xfer->callback(xfer);
+                }
+            }
+        }
+    }
+    return xfer->result;
+}
+
 /**
  * @brief Wait for an I2C event, or time out in case of error.
  * @param dev I2C device
@@ -308,7 +524,18 @@ void _i2c_irq_handler(i2c_dev *dev) {
      */
     if (sr1 & I2C_SR1_SB) {
         msg->xferred = 0;
-        i2c_enable_irq(dev, I2C_IRQ_BUFFER);
+        /*
+         * Long messages: the DMA moves the data from the address
+         * phase on, and for a read, LAST makes the peripheral NACK
+         * the final byte by itself.
+         */
+        dev->dma_msg = (dev->config_flags & I2C_DMA) &&
+            msg->length >= I2C_DMA_MIN && _i2c_dma_start(dev, msg);
+        if (dev->dma_msg) {
+            dev->regs->CR2 |= I2C_CR2_DMAEN | (read ? I2C_CR2_LAST : 0);
+        } else {
+            i2c_enable_irq(dev, I2C_IRQ_BUFFER);
+        }
 
         /*
          * Master receiver
@@ -321,6 +548,21 @@ void _i2c_irq_handler(i2c_dev *dev) {
         sr1 = sr2 = 0;
     }
 
+    /*
+     * DMA message: reading SR1/SR2 above has cleared ADDR. A write
+     * ends with BTF once the DMA has supplied the last byte, and then
+     * goes on as EV8_2 below. A read ends in the DMA interrupt.
+     */
+    if (dev->dma_msg) {
+        if (read || !(sr1 & I2C_SR1_BTF) || _i2c_dma_remaining(dev, msg)) {
+            return;
+        }
+        i2c_dma_abort(dev);
+        msg->xferred = msg->length;
+        dev->msgs_left--;
+        sr1 &= I2C_SR1_TXE | I2C_SR1_BTF;
+    }
+
     /*
      * EV6: Slave address sent
      */
@@ -360,6 +602,10 @@ void _i2c_irq_handler(i2c_dev *dev) {
               i2c_disable_irq(dev, I2C_IRQ_EVENT);
               I2C_CRUMB(STOP_SENT, 0, 0);
               dev->state = I2C_STATE_XFER_DONE;
+              if (dev->xfer) {
+                  i2c_async_finish(dev, 0);
+                  return;
+              }
             } /* else we're just sending one byte */
         }
         sr1 = sr2 = 0;
@@ -420,6 +666,10 @@ void _i2c_irq_handler(i2c_dev *dev) {
             i2c_disable_irq(dev, I2C_IRQ_EVENT);
             I2C_CRUMB(STOP_SENT, 0, 0);
             dev->state = I2C_STATE_XFER_DONE;
+            if (dev->xfer) {
+                i2c_async_finish(dev, 0);
+                return;
+            }
         }
         sr1 = sr2 = 0;
     }
@@ -453,6 +703,9 @@ void _i2c_irq_handler(i2c_dev *dev) {
                  */
                 I2C_CRUMB(RXNE_DONE, 0, 0);
                 dev->state = I2C_STATE_XFER_DONE;
+                if (dev->xfer) {
+                    i2c_async_finish(dev, 0);
+                }
             } else {
                 dev->msg++;
             }
@@ -477,7 +730,46 @@ void _i2c_irq_error_handler(i2c_dev *dev) {
 
     i2c_stop_condition(dev);
     i2c_disable_irq(dev, I2C_IRQ_BUFFER | I2C_IRQ_EVENT | I2C_IRQ_ERROR);
+    i2c_dma_abort(dev);
     dev->state = I2C_STATE_ERROR;
+
+    /*
+     * Nobody waits to restart the device after an asynchronous
+     * transfer fails. A NACK needs no more than that; after a bus
+     * error or lost arbitration a slave may hold SDA, so the bus is
+     * reset too.
+     */
+    if (dev->xfer) {
+        i2c_recover(dev, dev->error_flags & (I2C_SR1_BERR | I2C_SR1_ARLO) ?
+                    I2C_BUS_RESET : 0);
+        i2c_async_finish(dev, I2C_ERROR_PROTOCOL);
+    }
+}
+
+/*
+ * DMA transfer complete for a read: the last byte has been NACKed
+ * (I2C_CR2_LAST), program the repeated start or stop.
+ */
+void _i2c_irq_dma_rx_handler(i2c_dev *dev) {
+    i2c_msg *msg = dev->msg;
+
+    if (!dev->dma_msg) {
+        return;
+    }
+    i2c_dma_abort(dev);
+    msg->xferred = msg->length;
+    dev->timestamp = systick_uptime();
+
+    if (--dev->msgs_left) {
+        i2c_start_condition(dev);
+        dev->msg++;
+    } else {
+        i2c_stop_condition(dev);
+        dev->state = I2C_STATE_XFER_DONE;
+        if (dev->xfer) {
+            i2c_async_finish(dev, 0);
+        }
+    }
 }
 
 /*
@@ -31,6 +31,7 @@
 
 #include "i2c_private.h"
 #include <libmaple/i2c.h>
+#include <libmaple/dma.h>
 
 /*
  * Devices
@@ -92,6 +93,59 @@ __weak void __irq_i2c2_er(void) {
     _i2c_irq_error_handler(I2C2);
 }
 
+/*
+ * DMA (RM0008, DMA1 request mapping)
+ */
+
+static void i2c1_dma_rx(void) {
+    _i2c_irq_dma_rx_handler(I2C1);
+}
+
+static void i2c2_dma_rx(void) {
+    _i2c_irq_dma_rx_handler(I2C2);
+}
+
+static dma_tube i2c_dma_tube(const i2c_dev *dev, const i2c_msg *msg) {
+    uint8 read = msg->flags & I2C_MSG_READ;
+    if (dev == I2C1) {
+        return read ? DMA_CH7 : DMA_CH6;
+    }
+    return read ? DMA_CH5 : DMA_CH4;
+}
+
+int _i2c_dma_start(i2c_dev *dev, i2c_msg *msg) {
+    dma_tube tube = i2c_dma_tube(dev, msg);
+    uint32 mode = DMA_MINC_MODE;
+
+    dma_init(DMA1);
+    if (msg->flags & I2C_MSG_READ) {
+        mode |= DMA_TRNS_CMPLT;
+        dma_attach_interrupt(DMA1, tube, dev == I2C1 ? i2c1_dma_rx : i2c2_dma_rx);
+        /* the handler ends transfers, like the EV/ER interrupts, so it
+         * must not preempt them or be preempted by them */
+        nvic_irq_set_priority(DMA1->handlers[tube - 1].irq_line, 0);
+    } else {
+        /* the end of a write is seen by the I2C as BTF */
+        mode |= DMA_FROM_MEM;
+    }
+    dma_setup_transfer(DMA1, tube, &dev->regs->DR, DMA_SIZE_8BITS,
+                       msg->data, DMA_SIZE_8BITS, mode);
+    dma_set_num_transfers(DMA1, tube, msg->length);
+    dma_clear_isr_bits(DMA1, tube);
+    dma_enable(DMA1, tube);
+    return 1;
+}
+
+void _i2c_dma_stop(i2c_dev *dev, i2c_msg *msg) {
+    dma_tube tube = i2c_dma_tube(dev, msg);
+    dma_disable(DMA1, tube);
+    dma_clear_isr_bits(DMA1, tube);
+}
+
+uint16 _i2c_dma_remaining(i2c_dev *dev, i2c_msg *msg) {
+    return dma_get_count(DMA1, i2c_dma_tube(dev, msg));
+}
+
 /*
  * Internal APIs
  */
@@ -31,6 +31,7 @@
  */
 
 #include <libmaple/systick.h>
+#include <libmaple/dwt.h>
 
 volatile uint32 systick_uptime_millis;
 static void (*systick_user_callback)(void);
@@ -39,12 +40,14 @@ static void (*systick_user_callback)(void);
  * @brief Initialize and enable SysTick.
  *
  * Clocks the system timer with the core clock, turns it on, and
- * enables interrupts.
+ * enables interrupts.  Also starts the DWT cycle counter from 0; the
+ * SysTick ISR extends it to 64 bits for dwt_cycles64().
  *
  * @param reload_val Appropriate reload counter to tick every 1 ms.
  */
 void systick_init(uint32 reload_val) {
     SYSTICK_BASE->RVR = reload_val;
+    dwt_cycles64_init();
     systick_enable();
 }
 
@@ -82,6 +85,7 @@ void systick_attach_callback(void (*callback)(void)) {
 
 __weak void __exc_systick(void) {
     systick_uptime_millis++;
+    dwt_cycles_extend();
     if (systick_user_callback) {
         systick_user_callback();
     }
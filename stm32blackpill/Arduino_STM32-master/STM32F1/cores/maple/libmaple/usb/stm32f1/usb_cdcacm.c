@@ -475,8 +475,29 @@ uint32 usb_cdcacm_rx(uint8* buf, uint32 len)
     uint32 n_copied = usb_cdcacm_peek(buf, len);
 
     /* Mark bytes as read. */
-	uint16 tail = rx_tail; // load volatile variable
-	tail = (tail + n_copied) & CDC_SERIAL_RX_BUFFER_SIZE_MASK;
+    usb_cdcacm_rx_consume(n_copied);
+    return n_copied;
+}
+
+/* Non-blocking access to the unread bytes in place.
+ *
+ * Points *buf at the unread bytes that are contiguous in our private
+ * data buffer and returns how many there are; bytes that wrap around
+ * come on the next call.  usb_cdcacm_rx_consume() marks them read. */
+uint32 usb_cdcacm_rx_span(const uint8** buf)
+{
+    uint32 head = rx_head; // load volatile variable
+    uint32 tail = rx_tail;
+
+    *buf = (const uint8*)&vcomBufferRx[tail];
+    return (head >= tail ? head : CDC_SERIAL_RX_BUFFER_SIZE) - tail;
+}
+
+/* Marks len unread bytes as read, at most usb_cdcacm_data_available(). */
+void usb_cdcacm_rx_consume(uint32 len)
+{
+	uint32 tail = rx_tail; // load volatile variable
+	tail = (tail + len) & CDC_SERIAL_RX_BUFFER_SIZE_MASK;
 	rx_tail = tail; // store volatile variable
 
 	uint32 rx_unread = (rx_head - tail) & CDC_SERIAL_RX_BUFFER_SIZE_MASK;
@@ -484,7 +505,6 @@ uint32 usb_cdcacm_rx(uint8* buf, uint32 len)
     if ( rx_unread <= 64 ) { // experimental value, gives the best performance
         usb_set_ep_rx_stat(USB_CDCACM_RX_ENDP, USB_EP_STAT_RX_VALID);
 	}
-    return n_copied;
 }
 
 /* Non-blocking byte lookahead.
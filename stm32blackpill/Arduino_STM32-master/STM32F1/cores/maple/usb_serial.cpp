@@ -158,6 +158,17 @@ int USBSerial::peek(void)
 
 int USBSerial::availableForWrite(void) { return usb_cdcacm_tx_available(); }
 
+/* The RX buffer in place, for Stream's bulk reads */
+size_t USBSerial::readSpan(const uint8_t **data)
+{
+    return usb_cdcacm_rx_span(data);
+}
+
+void USBSerial::consume(size_t n)
+{
+    usb_cdcacm_rx_consume(n);
+}
+
 void USBSerial::flush(void)
 {
 /*Roger Clark. Rather slow method. Need to improve this */
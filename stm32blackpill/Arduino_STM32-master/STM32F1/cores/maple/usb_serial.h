@@ -58,6 +58,8 @@ public:
     // Roger Clark. added functions to support Arduino 1.0 API
     virtual int peek(void);
     virtual int read(void);
+    virtual size_t readSpan(const uint8_t **data);
+    virtual void consume(size_t n);
     int availableForWrite(void);
     virtual void flush(void);
 
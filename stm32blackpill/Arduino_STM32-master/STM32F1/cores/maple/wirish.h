@@ -53,6 +53,7 @@
 
 #include <boards.h>
 #include <io.h>
+#include <fastpin.h>
 #include <bit_constants.h>
 #include <pwm.h>
 #include <ext_interrupts.h>
@@ -32,7 +32,255 @@
 
 #include "io.h"
 #include <libmaple/adc.h>
+#include <libmaple/dma.h>
+#include <libmaple/nvic.h>
+#include <libmaple/delay.h>
 #include "boards.h"
+#include <string.h>
+
+/*
+ * Background scan
+ *
+ * DMA runs circularly over ANALOG_SCAN_DEPTH scans, and the transfer
+ * complete interrupt counts the laps.  The lap count and the DMA
+ * channel's remaining transfers tell how often each slot of the scan
+ * has been written, so every sample gets a scan number without an
+ * interrupt per scan, and the newest sample of a pin is found from
+ * the position alone.  A slot is written again only DEPTH scans
+ * later, so the sample can be loaded after the position is read.
+ */
+
+/* Scans in the DMA ring; a power of 2, at least 2. */
+#define ANALOG_SCAN_DEPTH 8
+
+#if (ANALOG_SCAN_DEPTH & (ANALOG_SCAN_DEPTH - 1)) || ANALOG_SCAN_DEPTH < 2
+#error "ANALOG_SCAN_DEPTH must be a power of 2, at least 2"
+#endif
+
+#define ANALOG_SCAN_NONE 0xFF
+
+typedef struct analog_scan {
+    uint8 slot[BOARD_NR_GPIO_PINS]; /* position << 1 | ADC, or NONE */
+    uint8 len;                      /* conversions per ADC and scan */
+    uint8 dual;                     /* 1: words of ADC1 and ADC2 samples */
+    uint16 ring;                    /* DMA transfers per lap */
+    volatile uint32 laps;
+    uint32 smpr[2][2];              /* SMPR1/2 of ADC1/2 before the scan */
+    uint16 buf[ANALOG_SCAN_DEPTH * ANALOG_SCAN_MAX] __attribute__((aligned(4)));
+} analog_scan;
+
+static analog_scan scan_state;
+static analog_scan *volatile scan;  /* NULL unless scanning */
+
+static adc_smp_rate analog_scan_get_smp(adc_reg_map *regs, uint8 ch) {
+    uint32 smpr = ch < 10 ? regs->SMPR2 : regs->SMPR1;
+    return (adc_smp_rate)((smpr >> ((ch % 10) * 3)) & 0x7);
+}
+
+static void analog_scan_set_smp(adc_reg_map *regs, uint8 ch, uint8 smp) {
+    __IO uint32 *smpr = ch < 10 ? &regs->SMPR2 : &regs->SMPR1;
+    uint32 shift = (ch % 10) * 3;
+    *smpr = (*smpr & ~(0x7 << shift)) | (smp << shift);
+}
+
+static void analog_scan_set_seq(adc_reg_map *regs, const uint8 *chs, uint8 len) {
+    uint32 sqr[3] = { 0, 0, 0 };    /* SQR3, SQR2, SQR1 */
+    for (uint8 i = 0; i < len; i++) {
+        sqr[i / 6] |= (uint32)chs[i] << ((i % 6) * 5);
+    }
+    regs->SQR3 = sqr[0];
+    regs->SQR2 = sqr[1];
+    regs->SQR1 = sqr[2] | ((uint32)(len - 1) << 20);
+}
+
+static void analog_scan_dma_irq(void) {
+    /* the flag and the count change together for analog_scan_sync(),
+     * which may run in a higher priority interrupt */
+    nvic_globalirq_disable();
+    DMA1->regs->IFCR = DMA_IFCR_CTCIF1;
+    scan_state.laps++;
+    nvic_globalirq_enable();
+}
+
+/* Laps and the DMA position in the current lap that belong together.
+ * A finished lap whose interrupt is still pending is counted here, so
+ * the answer is the same at any interrupt priority. */
+static uint32 analog_scan_sync(analog_scan *s, uint32 *pos) {
+    dma_tube_reg_map *tube = dma_tube_regs(DMA1, DMA_CH1);
+    uint32 laps, tc, left;
+    do {
+        laps = s->laps;
+        tc = DMA1->regs->ISR & DMA_ISR_TCIF1;
+        left = tube->CNDTR;
+    } while (laps != s->laps || tc != (DMA1->regs->ISR & DMA_ISR_TCIF1));
+    if (tc) {
+        laps++;
+        if (left == 0) {
+            left = s->ring;
+        }
+    }
+    *pos = s->ring - left;
+    return laps;
+}
+
+bool analogScanBegin(const uint8 *pins, uint8 nPins,
+                     const adc_smp_rate *sampleTimes, bool dual) {
+    if (nPins == 0 || nPins > ANALOG_SCAN_MAX) {
+        return false;
+    }
+    analogScanEnd();
+
+    analog_scan *s = &scan_state;
+    uint8 len = dual ? (nPins + 1) / 2 : nPins;
+    uint8 chs[2][ANALOG_SCAN_MAX];
+    uint8 smp[2][ANALOG_SCAN_MAX];
+    uint32 used = 0;
+
+    memset(s->slot, ANALOG_SCAN_NONE, sizeof(s->slot));
+    for (uint8 i = 0; i < nPins; i++) {
+        uint8 pin = pins[i];
+        if (pin >= BOARD_NR_GPIO_PINS || PIN_MAP[pin].adc_device != ADC1) {
+            return false;
+        }
+        uint8 ch = PIN_MAP[pin].adc_channel;
+        if (used & (1UL << ch)) {
+            return false;
+        }
+        used |= 1UL << ch;
+        /* dual: the first half on ADC1, the second on ADC2 */
+        uint8 adc = i / len;
+        uint8 pos = i % len;
+        chs[adc][pos] = ch;
+        smp[adc][pos] = sampleTimes ? sampleTimes[i] : analog_scan_get_smp(ADC1->regs, ch);
+        s->slot[pin] = pos << 1 | adc;
+    }
+    if (dual) {
+        /* ADC2 is one short for an odd count: pad with a channel no
+         * pin uses, so no channel is converted by both at once */
+        if (nPins & 1) {
+            uint8 ch = 0;
+            while (used & (1UL << ch)) {
+                ch++;
+            }
+            chs[1][len - 1] = ch;
+            smp[1][len - 1] = smp[0][len - 1];
+        }
+        /* paired conversions must take the same time */
+        for (uint8 pos = 0; pos < len; pos++) {
+            if (smp[1][pos] > smp[0][pos]) {
+                smp[0][pos] = smp[1][pos];
+            }
+            smp[1][pos] = smp[0][pos];
+        }
+    }
+
+    for (uint8 adc = 0; adc <= (uint8)dual; adc++) {
+        adc_reg_map *regs = (adc ? ADC2 : ADC1)->regs;
+        s->smpr[adc][0] = regs->SMPR1;
+        s->smpr[adc][1] = regs->SMPR2;
+        for (uint8 pos = 0; pos < len; pos++) {
+            analog_scan_set_smp(regs, chs[adc][pos], smp[adc][pos]);
+        }
+        analog_scan_set_seq(regs, chs[adc], len);
+        regs->CR1 |= ADC_CR1_SCAN;
+        regs->CR2 |= ADC_CR2_CONT;
+    }
+    for (uint8 i = 0; i < nPins; i++) {
+        pinMode(pins[i], INPUT_ANALOG);
+    }
+
+    s->len = len;
+    s->dual = dual;
+    s->ring = len * ANALOG_SCAN_DEPTH;
+    s->laps = 0;
+
+    /* in dual mode ADC1's data register holds ADC2's sample in its
+     * upper half, so one word transfer takes both */
+    dma_xfer_size size = dual ? DMA_SIZE_32BITS : DMA_SIZE_16BITS;
+    adc_reg_map *regs = ADC1->regs;
+    dma_init(DMA1);
+    dma_setup_transfer(DMA1, DMA_CH1, &regs->DR, size, s->buf, size,
+                       DMA_MINC_MODE | DMA_CIRC_MODE | DMA_TRNS_CMPLT);
+    dma_set_num_transfers(DMA1, DMA_CH1, s->ring);
+    dma_clear_isr_bits(DMA1, DMA_CH1);
+    dma_attach_interrupt(DMA1, DMA_CH1, analog_scan_dma_irq);
+    dma_enable(DMA1, DMA_CH1);
+    scan = s;
+
+    (void)regs->DR;
+    regs->CR1 = (regs->CR1 & ~ADC_CR1_DUALMOD) |
+        (dual ? ADC_CR1_DUALMOD_REG_SIMULT : ADC_CR1_DUALMOD_INDEPENDENT);
+    regs->CR2 |= ADC_CR2_DMA;
+    regs->CR2 |= ADC_CR2_SWSTART;
+    return true;
+}
+
+void analogScanEnd(void) {
+    analog_scan *s = scan;
+    if (s == NULL) {
+        return;
+    }
+    scan = NULL;
+
+    /* Powering down stops the conversion in progress, which clearing
+     * CONT would not; recalibrate after powering up again. */
+    for (uint8 adc = 0; adc <= s->dual; adc++) {
+        adc_dev *dev = adc ? ADC2 : ADC1;
+        adc_reg_map *regs = dev->regs;
+        adc_disable(dev);
+        regs->CR1 &= ~(ADC_CR1_SCAN | ADC_CR1_DUALMOD);
+        regs->CR2 &= ~(ADC_CR2_CONT | ADC_CR2_DMA);
+        regs->SMPR1 = s->smpr[adc][0];
+        regs->SMPR2 = s->smpr[adc][1];
+        adc_set_reg_seqlen(dev, 1);
+    }
+    dma_disable(DMA1, DMA_CH1);
+    dma_detach_interrupt(DMA1, DMA_CH1);
+    for (uint8 adc = 0; adc <= s->dual; adc++) {
+        adc_dev *dev = adc ? ADC2 : ADC1;
+        adc_enable(dev);
+        delay_us(1);
+        adc_calibrate(dev);
+        (void)dev->regs->DR;
+    }
+}
+
+uint16 analogScanRead(uint8 pin, uint32 *seq) {
+    analog_scan *s = scan;
+    uint8 slot;
+    if (s == NULL || pin >= BOARD_NR_GPIO_PINS ||
+        (slot = s->slot[pin]) == ANALOG_SCAN_NONE) {
+        if (seq) {
+            *seq = 0;
+        }
+        return 0;
+    }
+
+    uint32 pos;
+    uint32 laps = analog_scan_sync(s, &pos);
+    uint32 c = slot >> 1;
+    /* times the slot has been written in this lap */
+    uint32 w = pos > c ? (pos - c - 1) / s->len + 1 : 0;
+    uint32 n = laps * ANALOG_SCAN_DEPTH + w;
+    if (seq) {
+        *seq = n;
+    }
+    if (n == 0) {
+        return 0;
+    }
+    uint32 i = (((n - 1) % ANALOG_SCAN_DEPTH) * s->len + c) << s->dual | (slot & 1);
+    return s->buf[i];
+}
+
+uint32 analogScanCount(void) {
+    analog_scan *s = scan;
+    if (s == NULL) {
+        return 0;
+    }
+    uint32 pos;
+    uint32 laps = analog_scan_sync(s, &pos);
+    return laps * ANALOG_SCAN_DEPTH + (pos + s->len - 1) / s->len;
+}
 
 /* Unlike Wiring and Arduino, this assumes that the pin's mode is set
  * to INPUT_ANALOG. That's faster, but it does require some extra work
@@ -43,5 +291,19 @@ uint16 analogRead(uint8 pin) {
         return 0;
     }
 
+    analog_scan *s = scan;
+    if (s != NULL) {
+        if (s->slot[pin] != ANALOG_SCAN_NONE) {
+            return analogScanRead(pin, NULL);
+        }
+        /* ADC1 (and ADC2 in dual mode) are busy scanning */
+        if (dev == ADC1) {
+            if (s->dual) {
+                return 0;
+            }
+            dev = ADC2;
+        }
+    }
+
     return adc_read(dev, PIN_MAP[pin].adc_channel);
 }
@@ -26,37 +26,43 @@
 
 #include "wirish.h"
 
+/* Port registers and masks are looked up once per byte rather than
+ * once per bit; see fastpin.h for pins fixed at compile time. */
+
 void shiftOut(uint8 dataPin, uint8 clockPin, uint8 bitOrder, uint8 value) {
-    digitalWrite(clockPin, LOW);
+    if (dataPin >= BOARD_NR_GPIO_PINS || clockPin >= BOARD_NR_GPIO_PINS) {
+        return;
+    }
+    gpio_reg_map *data = PIN_MAP[dataPin].gpio_device->regs;
+    gpio_reg_map *clock = PIN_MAP[clockPin].gpio_device->regs;
+    uint32 dmask = 1U << PIN_MAP[dataPin].gpio_bit;
+    uint32 cmask = 1U << PIN_MAP[clockPin].gpio_bit;
+
+    clock->BRR = cmask;
     for (int i = 0; i < 8; i++) {
         int bit = bitOrder == LSBFIRST ? i : (7 - i);
-        digitalWrite(dataPin, (value >> bit) & 0x1);
-		gpio_toggle_bit(PIN_MAP[clockPin].gpio_device, PIN_MAP[clockPin].gpio_bit);// togglePin(clockPin);
-		gpio_toggle_bit(PIN_MAP[clockPin].gpio_device, PIN_MAP[clockPin].gpio_bit);// togglePin(clockPin);  
+        data->BSRR = (value >> bit) & 0x1 ? dmask : dmask << 16;
+        clock->BSRR = cmask;
+        clock->BRR = cmask;
     }
 }
 
-uint32_t shiftIn( uint32_t ulDataPin, uint32_t ulClockPin, uint32_t ulBitOrder )
-{
-  uint8_t value = 0 ;
-  uint8_t i ;
-
-  
-  for ( i=0 ; i < 8 ; ++i )
-  {
-    digitalWrite( ulClockPin, HIGH ) ;
-
-    if ( ulBitOrder == LSBFIRST )
-    {
-      value |= digitalRead( ulDataPin ) << i ;
+uint32 shiftIn(uint32 ulDataPin, uint32 ulClockPin, uint32 ulBitOrder) {
+    if (ulDataPin >= BOARD_NR_GPIO_PINS || ulClockPin >= BOARD_NR_GPIO_PINS) {
+        return 0;
     }
-    else
-    {
-      value |= digitalRead( ulDataPin ) << (7 - i) ;
-    }
-
-    digitalWrite( ulClockPin, LOW ) ;
-  }
+    gpio_reg_map *data = PIN_MAP[ulDataPin].gpio_device->regs;
+    gpio_reg_map *clock = PIN_MAP[ulClockPin].gpio_device->regs;
+    uint32 dmask = 1U << PIN_MAP[ulDataPin].gpio_bit;
+    uint32 cmask = 1U << PIN_MAP[ulClockPin].gpio_bit;
+    uint8 value = 0;
 
-  return value ;
+    for (int i = 0; i < 8; i++) {
+        clock->BSRR = cmask;
+        if (data->IDR & dmask) {
+            value |= 1 << (ulBitOrder == LSBFIRST ? i : (7 - i));
+        }
+        clock->BRR = cmask;
+    }
+    return value;
 }
@@ -45,6 +45,16 @@ void delay(unsigned long ms)
             ms--;
             start += 1000;
         }
+        /* The next SysTick comes before the end, sleep until then.
+         * DBG_SLEEP keeps HCLK, and so the cycle counter behind
+         * cycles64(), running for just this sleep. */
+        if (ms > 1)
+        {
+            uint32 dbgmcu = DWT_DBGMCU_CR;
+            DWT_DBGMCU_CR = dbgmcu | DWT_DBGMCU_CR_DBG_SLEEP;
+            asm volatile("wfi");
+            DWT_DBGMCU_CR = dbgmcu;
+        }
     }
 }
 
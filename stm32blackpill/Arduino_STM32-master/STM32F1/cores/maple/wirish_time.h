@@ -34,6 +34,7 @@
 
 #include <libmaple/libmaple_types.h>
 #include <libmaple/systick.h>
+#include <libmaple/dwt.h>
 
 #include <boards.h>
 
@@ -70,6 +71,162 @@ static inline uint32 micros(void) {
 #undef US_PER_MS
 }
 
+/*
+ * 64 bit timebase
+ *
+ * The DWT cycle counter, extended to 64 bits by the SysTick interrupt,
+ * counts CPU cycles since startup without wrapping (for some 8000
+ * years at 72 MHz).  Reading it is a few loads, and the conversions
+ * below multiply by reciprocals that the compiler works out from F_CPU,
+ * so neither divides.  millis() and micros() are unchanged.
+ */
+
+/**
+ * Returns the number of CPU cycles since startup.
+ * @see cyclesToMicros()
+ */
+static inline uint64 cycles64(void) {
+    return dwt_cycles64();
+}
+
+/* 2^64 * n / d rounded up, for n < d < 2^32: the fraction bits of a
+ * fixed-point reciprocal, by long division a word at a time */
+#define __TIME_RECIP_HI(n, d)   ((((uint64)(n)) << 32) / (d))
+#define __TIME_RECIP_R1(n, d)   ((((uint64)(n)) << 32) % (d))
+#define __TIME_RECIP_LO(n, d)   ((__TIME_RECIP_R1(n, d) << 32) / (d))
+#define __TIME_RECIP_R0(n, d)   ((__TIME_RECIP_R1(n, d) << 32) % (d))
+#define __TIME_RECIP(n, d)      ((__TIME_RECIP_HI(n, d) << 32) +        \
+                                 __TIME_RECIP_LO(n, d) +                \
+                                 (__TIME_RECIP_R0(n, d) != 0))
+
+/* floor(a * f / 2^64), from 32 x 32 bit products */
+static inline __always_inline uint64 __time_mulhi64(uint64 a, uint64 f) {
+    uint64 al = (uint32)a, ah = a >> 32;
+    uint64 fl = (uint32)f, fh = f >> 32;
+    uint64 lh = al * fh, hl = ah * fl;
+    uint64 mid = ((al * fl) >> 32) + (uint32)lh + (uint32)hl;
+    return ah * fh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+}
+
+/* floor(cycles * unit / F_CPU).  The rounded up reciprocal gives that
+ * or one more; the low words of the exact products tell which. */
+static inline __always_inline uint64 __time_from_cycles(uint64 cycles,
+                                                        uint32 unit) {
+    const uint32 whole = unit / F_CPU;
+    const uint64 frac = __TIME_RECIP(unit % F_CPU, F_CPU);
+    uint64 t = cycles * whole + __time_mulhi64(cycles, frac);
+    if ((int64)(cycles * unit - t * F_CPU) < 0) {
+        t--;
+    }
+    return t;
+}
+
+/**
+ * Converts CPU cycles to whole milliseconds.
+ */
+static inline uint64 cyclesToMillis(uint64 cycles) {
+    return __time_from_cycles(cycles, 1000);
+}
+
+/**
+ * Converts CPU cycles to whole microseconds.
+ */
+static inline uint64 cyclesToMicros(uint64 cycles) {
+    return __time_from_cycles(cycles, 1000000);
+}
+
+/**
+ * Converts CPU cycles to whole nanoseconds.
+ */
+static inline uint64 cyclesToNanos(uint64 cycles) {
+    return __time_from_cycles(cycles, 1000000000);
+}
+
+/**
+ * Returns time (in milliseconds) since startup, like millis() but
+ * without wrapping.
+ */
+static inline uint64 millis64(void) {
+    return cyclesToMillis(cycles64());
+}
+
+/**
+ * Returns time (in microseconds) since startup, like micros() but
+ * without wrapping.
+ */
+static inline uint64 micros64(void) {
+    return cyclesToMicros(cycles64());
+}
+
+/**
+ * Cycle statistics of one piece of code, gathered by TIME_SCOPE().
+ * A TimeStats should be updated from one context only.
+ */
+struct TimeStats {
+    uint32 count;   /**< Times the code ran */
+    uint32 min;     /**< Fewest cycles */
+    uint32 max;     /**< Most cycles */
+    uint64 total;   /**< Sum of the cycles */
+
+    TimeStats() { reset(); }
+
+    void reset(void) {
+        count = 0;
+        min = 0xFFFFFFFF;
+        max = 0;
+        total = 0;
+    }
+
+    void add(uint32 cycles) {
+        count++;
+        total += cycles;
+        if (cycles < min) min = cycles;
+        if (cycles > max) max = cycles;
+    }
+
+    /** Mean cycles, 0 if the code has not run. */
+    uint32 average(void) const {
+        return count ? total / count : 0;
+    }
+};
+
+/* Adds the cycles from its construction to its destruction to a
+ * TimeStats; see TIME_SCOPE(). */
+class TimeScope {
+public:
+    TimeScope(TimeStats &stats) : stats(stats), start(dwt_cycles()) {}
+    ~TimeScope() { stats.add(dwt_cycles() - start); }
+private:
+    TimeStats &stats;
+    uint32 start;
+};
+
+/**
+ * Time the rest of the enclosing block in CPU cycles, adding each run
+ * to the given TimeStats, e.g.
+ *
+ * @code
+ *     TimeStats filterStats;
+ *
+ *     void filter(void) {
+ *         TIME_SCOPE(filterStats);
+ *         ...
+ *     }
+ * @endcode
+ *
+ * A run costs two reads of the cycle counter and the TimeStats
+ * update.  Blocks are timed up to 2^32 cycles (59 s at 72 MHz).
+ * Defining TIME_SCOPE_DISABLE before this header compiles every
+ * TIME_SCOPE() out.
+ */
+#ifndef TIME_SCOPE_DISABLE
+#define TIME_SCOPE(stats)       TimeScope __TIME_SCOPE_VAR(__LINE__)(stats)
+#else
+#define TIME_SCOPE(stats)       do { } while (0)
+#endif
+#define __TIME_SCOPE_VAR(line)  __TIME_SCOPE_VAR2(line)
+#define __TIME_SCOPE_VAR2(line) __time_scope_##line
+
 /**
  * Delay for at least the given number of milliseconds.
  *
@@ -77,6 +234,12 @@ static inline uint32 micros(void) {
  * exceed ms.  However, this function will return no less than ms
  * milliseconds from the time it is called.
  *
+ * While more than a millisecond remains the core sleeps (WFI) between
+ * interrupts; the SysTick interrupt wakes it every millisecond.  HCLK
+ * is kept running during those sleeps (DBG_SLEEP) so that cycles64()
+ * does not lose time; other code that sleeps with WFI must do the same
+ * if it relies on the cycle counter.
+ *
  * @param ms the number of milliseconds to delay.
  * @see delayMicroseconds()
  */
@@ -33,6 +33,13 @@ All text above, and the splash screen below must be included in any redistributi
 #define swap(a, b) { int16_t t = a; a = b; b = t; }
 #endif
 
+// data bytes per I2C transmission, the Wire buffer also holds the control byte
+#ifdef BUFFER_LENGTH
+#define SSD1306_I2C_CHUNK (BUFFER_LENGTH-1)
+#else
+#define SSD1306_I2C_CHUNK 16
+#endif
+
 // the memory buffer for the LCD
 
 static uint8_t buffer[SSD1306_LCDHEIGHT * SSD1306_LCDWIDTH / 8] = { 
@@ -136,7 +143,20 @@ void Adafruit_SSD1306::drawPixel(int16_t x, int16_t y, uint16_t color) {
       case BLACK:   buffer[x+ (y/8)*SSD1306_LCDWIDTH] &= ~(1 << (y&7)); break; 
       case INVERSE: buffer[x+ (y/8)*SSD1306_LCDWIDTH] ^=  (1 << (y&7)); break; 
     }
-    
+    markDirty(y/8, x, x);
+}
+
+// grow the changed column range of a page to include x0..x1
+inline void Adafruit_SSD1306::markDirty(uint8_t page, uint8_t x0, uint8_t x1) {
+  if (x0 < dirty_lo[page]) dirty_lo[page] = x0;
+  if (x1 > dirty_hi[page]) dirty_hi[page] = x1;
+}
+
+void Adafruit_SSD1306::invalidate(void) {
+  for (uint8_t p = 0; p < SSD1306_LCDPAGES; p++) {
+    dirty_lo[p] = 0;
+    dirty_hi[p] = SSD1306_LCDWIDTH-1;
+  }
 }
 
 Adafruit_SSD1306::Adafruit_SSD1306(int8_t SID, int8_t SCLK, int8_t DC, int8_t RST, int8_t CS) : Adafruit_GFX(SSD1306_LCDWIDTH, SSD1306_LCDHEIGHT) {
@@ -330,6 +350,9 @@ void Adafruit_SSD1306::begin(uint8_t vccstate, uint8_t i2caddr, bool reset) {
   #endif
 
   ssd1306_command(SSD1306_DISPLAYON);//--turn on oled panel
+
+  // display RAM content is unknown after reset, send everything next time
+  invalidate();
 }
 
 
@@ -432,6 +455,8 @@ void Adafruit_SSD1306::startscrolldiagleft(uint8_t start, uint8_t stop){
 
 void Adafruit_SSD1306::stopscroll(void){
   ssd1306_command(SSD1306_DEACTIVATE_SCROLL);
+  // scrolling has moved the display RAM away from our buffer
+  invalidate();
 }
 
 // Dim the display
@@ -481,22 +506,42 @@ void Adafruit_SSD1306::ssd1306_data(uint8_t c) {
 }
 
 void Adafruit_SSD1306::display(void) {
-  ssd1306_command(SSD1306_COLUMNADDR);
-  ssd1306_command(0);   // Column start address (0 = reset)
-  ssd1306_command(SSD1306_LCDWIDTH-1); // Column end address (127 = reset)
-
-  ssd1306_command(SSD1306_PAGEADDR);
-  ssd1306_command(0); // Page start address (0 = reset)
-  #if SSD1306_LCDHEIGHT == 64
-    ssd1306_command(7); // Page end address
-  #endif
-  #if SSD1306_LCDHEIGHT == 32
-    ssd1306_command(3); // Page end address
-  #endif
-  #if SSD1306_LCDHEIGHT == 16
-    ssd1306_command(1); // Page end address
-  #endif
+  // Only the columns touched since the last call are sent. Runs of pages
+  // with the same dirty range share one address window, and full width
+  // runs are contiguous in the buffer so they go out as a single block.
+  uint8_t p = 0;
+  while (p < SSD1306_LCDPAGES) {
+    uint8_t lo = dirty_lo[p], hi = dirty_hi[p];
+    if (lo > hi) { p++; continue; }
+
+    uint8_t last = p;
+    while (last+1 < SSD1306_LCDPAGES && dirty_lo[last+1] == lo && dirty_hi[last+1] == hi)
+      last++;
+
+    ssd1306_command(SSD1306_COLUMNADDR);
+    ssd1306_command(lo);   // Column start address
+    ssd1306_command(hi);   // Column end address
+    ssd1306_command(SSD1306_PAGEADDR);
+    ssd1306_command(p);    // Page start address
+    ssd1306_command(last); // Page end address
+
+    if (lo == 0 && hi == SSD1306_LCDWIDTH-1) {
+      sendData(buffer + p*SSD1306_LCDWIDTH, (last-p+1)*SSD1306_LCDWIDTH);
+    } else {
+      for (uint8_t q = p; q <= last; q++)
+        sendData(buffer + q*SSD1306_LCDWIDTH + lo, hi-lo+1);
+    }
 
+    for (uint8_t q = p; q <= last; q++) {
+      dirty_lo[q] = 0xFF;
+      dirty_hi[q] = 0;
+    }
+    p = last+1;
+  }
+}
+
+// send a run of framebuffer bytes to the display RAM
+void Adafruit_SSD1306::sendData(const uint8_t *data, uint16_t len) {
   if (sid != -1)
   {
     // SPI
@@ -504,47 +549,35 @@ void Adafruit_SSD1306::display(void) {
     *dcport |= dcpinmask;
     *csport &= ~cspinmask;
 
-    for (uint16_t i=0; i<(SSD1306_LCDWIDTH*SSD1306_LCDHEIGHT/8); i++) {
-      fastSPIwrite(buffer[i]);
-      //ssd1306_data(buffer[i]);
+    if (hwSPI) {
+      SPI.dmaSend(data, len);
+    } else {
+      while (len--)
+        fastSPIwrite(*data++);
     }
     *csport |= cspinmask;
   }
   else
   {
-    // save I2C bitrate
-      /*
-#ifndef __SAM3X8E__
-    uint8_t twbrbackup = TWBR;
-    TWBR = 12; // upgrade to 400KHz!
-#endif
-*/
-    //Serial.println(TWBR, DEC);
-    //Serial.println(TWSR & 0x3, DEC);
-
-    // I2C
-    for (uint16_t i=0; i<(SSD1306_LCDWIDTH*SSD1306_LCDHEIGHT/8); i++) {
-      // send a bunch of data in one xmission
+    // I2C, fill the Wire buffer as far as it goes (one byte is the control byte)
+    while (len) {
+      uint8_t n = (len < SSD1306_I2C_CHUNK) ? len : SSD1306_I2C_CHUNK;
       Wire.beginTransmission(_i2caddr);
       WIRE_WRITE(0x40);
-      for (uint8_t x=0; x<16; x++) {
-  WIRE_WRITE(buffer[i]);
-  i++;
+      for (uint8_t x=0; x<n; x++) {
+        WIRE_WRITE(data[x]);
       }
-      i--;
       Wire.endTransmission();
+      data += n;
+      len -= n;
     }
-/*
-#ifndef __SAM3X8E__
-    TWBR = twbrbackup;
-#endif
- */
   }
 }
 
 // clear everything
 void Adafruit_SSD1306::clearDisplay(void) {
   memset(buffer, 0, (SSD1306_LCDWIDTH*SSD1306_LCDHEIGHT/8));
+  invalidate();
 }
 
 
@@ -615,6 +648,8 @@ void Adafruit_SSD1306::drawFastHLineInternal(int16_t x, int16_t y, int16_t w, ui
   // if our width is now negative, punt
   if(w <= 0) { return; }
 
+  markDirty(y/8, x, x+w-1);
+
   // set up the pointer for  movement through the buffer
   register uint8_t *pBuf = buffer;
   // adjust the buffer pointer for the current row
@@ -693,6 +728,10 @@ void Adafruit_SSD1306::drawFastVLineInternal(int16_t x, int16_t __y, int16_t __h
   register uint8_t y = __y;
   register uint8_t h = __h;
 
+  for (uint8_t page = y/8; page <= (y+h-1)/8; page++) {
+    markDirty(page, x, x);
+  }
+
 
   // set up the pointer for fast movement through the buffer
   register uint8_t *pBuf = buffer;
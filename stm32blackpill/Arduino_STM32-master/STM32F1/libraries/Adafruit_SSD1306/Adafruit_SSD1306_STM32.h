@@ -84,6 +84,8 @@ All text above, and the splash screen must be included in any redistribution
   #define SSD1306_LCDHEIGHT                 16
 #endif
 
+#define SSD1306_LCDPAGES (SSD1306_LCDHEIGHT / 8)
+
 #define SSD1306_SETCONTRAST 0x81
 #define SSD1306_DISPLAYALLON_RESUME 0xA4
 #define SSD1306_DISPLAYALLON 0xA5
@@ -143,6 +145,8 @@ class Adafruit_SSD1306 : public Adafruit_GFX {
   void clearDisplay(void);
   void invertDisplay(uint8_t i);
   void display();
+  // force the next display() to resend the whole framebuffer
+  void invalidate(void);
 
   void startscrollright(uint8_t start, uint8_t stop);
   void startscrollleft(uint8_t start, uint8_t stop);
@@ -169,4 +173,9 @@ volatile uint32 *mosiport, *clkport, *csport, *dcport;
   inline void drawFastVLineInternal(int16_t x, int16_t y, int16_t h, uint16_t color) __attribute__((always_inline));
   inline void drawFastHLineInternal(int16_t x, int16_t y, int16_t w, uint16_t color) __attribute__((always_inline));
 
+  // per page range of columns changed since the last display(), empty when lo > hi
+  uint8_t dirty_lo[SSD1306_LCDPAGES], dirty_hi[SSD1306_LCDPAGES];
+  inline void markDirty(uint8_t page, uint8_t x0, uint8_t x1) __attribute__((always_inline));
+  void sendData(const uint8_t *data, uint16_t len);
+
 };
@@ -0,0 +1,440 @@
+/*
+USART/DMA 1-Wire master for STM32F1.
+
+Same bus protocol and search algorithm as OneWire (OneWireSTM.cpp),
+but every slot is generated by a half-duplex USART frame so bit
+timing is exact regardless of interrupt load, and whole bytes are
+moved by DMA.  See OneWireUART.h for the slot encoding.
+*/
+
+#include "OneWireUART.h"
+#include <libmaple/gpio.h>
+
+#define OW_UART_RESET_BAUD 9600
+#define OW_UART_DATA_BAUD  115200
+
+#define OW_SLOT_1    0xFF  // write 1, or read slot
+#define OW_SLOT_0    0x00  // write 0
+#define OW_RESET_TX  0xF0  // ~480uS low at 9600 baud
+
+// DMA callbacks carry no context, so keep one instance per USART.
+static OneWireUART *ow_uart_instance[3];
+
+static void ow_uart1_dma_irq(void) { if (ow_uart_instance[0]) ow_uart_instance[0]->dmaComplete(); }
+static void ow_uart2_dma_irq(void) { if (ow_uart_instance[1]) ow_uart_instance[1]->dmaComplete(); }
+static void ow_uart3_dma_irq(void) { if (ow_uart_instance[2]) ow_uart_instance[2]->dmaComplete(); }
+
+OneWireUART::OneWireUART(usart_dev *dev)
+{
+	this->dev = dev;
+	state = OW_IDLE;
+	result = 0;
+	callback = NULL;
+	reset_search();
+}
+
+void OneWireUART::begin(void)
+{
+	uint8_t pin;
+	void (*handler)(void);
+
+	if (dev == USART1) {
+		pin = BOARD_USART1_TX_PIN;
+		tx_tube = DMA_CH4;
+		rx_tube = DMA_CH5;
+		ow_uart_instance[0] = this;
+		handler = ow_uart1_dma_irq;
+	} else if (dev == USART2) {
+		pin = BOARD_USART2_TX_PIN;
+		tx_tube = DMA_CH7;
+		rx_tube = DMA_CH6;
+		ow_uart_instance[1] = this;
+		handler = ow_uart2_dma_irq;
+	} else {
+		pin = BOARD_USART3_TX_PIN;
+		tx_tube = DMA_CH2;
+		rx_tube = DMA_CH3;
+		ow_uart_instance[2] = this;
+		handler = ow_uart3_dma_irq;
+	}
+
+	// TX doubles as the bus line: open drain, RX echoed internally.
+	gpio_set_mode(PIN_MAP[pin].gpio_device, PIN_MAP[pin].gpio_bit, GPIO_AF_OUTPUT_OD);
+
+	usart_init(dev);
+	usart_set_baud_rate(dev, 0, OW_UART_DATA_BAUD);
+	dev->regs->CR3 = USART_CR3_HDSEL;
+	usart_enable(dev);
+	// Received slots are collected by DMA, not the serial ring buffer.
+	dev->regs->CR1 &= ~USART_CR1_RXNEIE;
+
+	dma_init(DMA1);
+	dma_setup_transfer(DMA1, tx_tube, &dev->regs->DR, DMA_SIZE_8BITS,
+			tx_slots, DMA_SIZE_8BITS, (DMA_MINC_MODE | DMA_FROM_MEM));
+	dma_setup_transfer(DMA1, rx_tube, &dev->regs->DR, DMA_SIZE_8BITS,
+			rx_slots, DMA_SIZE_8BITS, (DMA_MINC_MODE | DMA_TRNS_CMPLT | DMA_TRNS_ERR));
+	dma_set_priority(DMA1, rx_tube, DMA_PRIORITY_HIGH);
+	dma_attach_interrupt(DMA1, rx_tube, handler);
+}
+
+void OneWireUART::setBaud(uint32_t baud)
+{
+	// BRR must not change while UE is set.
+	dev->regs->CR1 &= ~USART_CR1_UE;
+	usart_set_baud_rate(dev, 0, baud);
+	dev->regs->CR1 |= USART_CR1_UE;
+}
+
+// Clock out 'count' slots from tx_slots; their echoes land in rx_slots
+// and dmaComplete() runs once the last one has been received.
+void OneWireUART::startSlots(uint16_t count)
+{
+	usart_reg_map *regs = dev->regs;
+
+	chunk = count;
+	// drop any stale echo and clear ORE before DMA takes over
+	(void)regs->SR;
+	(void)regs->DR;
+
+	dma_set_num_transfers(DMA1, rx_tube, count);
+	dma_set_num_transfers(DMA1, tx_tube, count);
+	dma_enable(DMA1, rx_tube);
+	dma_enable(DMA1, tx_tube);
+	regs->CR3 |= USART_CR3_DMAR | USART_CR3_DMAT;
+}
+
+void OneWireUART::startReset(void)
+{
+	setBaud(OW_UART_RESET_BAUD);
+	tx_slots[0] = OW_RESET_TX;
+	startSlots(1);
+}
+
+void OneWireUART::loadWriteChunk(void)
+{
+	uint16_t n = remaining;
+	if (n > ONEWIRE_UART_SLOTS / 8) n = ONEWIRE_UART_SLOTS / 8;
+
+	uint8_t *slot = tx_slots;
+	for (uint16_t i = 0; i < n; i++) {
+		uint8_t v = *wr_ptr++;
+		for (uint8_t bit = 0; bit < 8; bit++) {
+			*slot++ = (v & 0x01) ? OW_SLOT_1 : OW_SLOT_0;
+			v >>= 1;
+		}
+	}
+	remaining -= n;
+	startSlots(n * 8);
+}
+
+void OneWireUART::loadReadChunk(void)
+{
+	uint16_t n = remaining;
+	if (n > ONEWIRE_UART_SLOTS / 8) n = ONEWIRE_UART_SLOTS / 8;
+
+	memset(tx_slots, OW_SLOT_1, n * 8);
+	remaining -= n;
+	startSlots(n * 8);
+}
+
+void OneWireUART::finish(uint8_t res)
+{
+	onewire_uart_callback cb = callback;
+
+	result = res;
+	callback = NULL;
+	state = OW_IDLE;
+	if (cb) cb(this, res);
+}
+
+// RX DMA transfer complete (or error): every slot of the chunk has
+// been echoed back.  Advance the current operation.
+void OneWireUART::dmaComplete(void)
+{
+	uint8_t isr = dma_get_isr_bits(DMA1, rx_tube);
+
+	dma_disable(DMA1, tx_tube);
+	dma_disable(DMA1, rx_tube);
+	dma_clear_isr_bits(DMA1, tx_tube);
+	dma_clear_isr_bits(DMA1, rx_tube);
+	dev->regs->CR3 &= ~(USART_CR3_DMAR | USART_CR3_DMAT);
+
+	if (isr & DMA_ISR_TEIF) {
+		if (state == OW_RESET || state == OW_SEARCH_RESET)
+			setBaud(OW_UART_DATA_BAUD);
+		finish(0);
+		return;
+	}
+
+	switch (state) {
+	case OW_RESET:
+		setBaud(OW_UART_DATA_BAUD);
+		// a presence pulse pulls the echoed frame's high bits low
+		finish(rx_slots[0] != OW_RESET_TX);
+		break;
+
+	case OW_WRITE:
+		if (remaining)
+			loadWriteChunk();
+		else
+			finish(1);
+		break;
+
+	case OW_READ:
+		for (uint16_t i = 0; i < chunk; i += 8) {
+			uint8_t v = 0;
+			for (uint8_t bit = 0; bit < 8; bit++) {
+				if (rx_slots[i + bit] == OW_SLOT_1) v |= 1 << bit;
+			}
+			*rd_ptr++ = v;
+		}
+		if (remaining)
+			loadReadChunk();
+		else
+			finish(1);
+		break;
+
+	case OW_SEARCH_RESET:
+		setBaud(OW_UART_DATA_BAUD);
+		if (rx_slots[0] == OW_RESET_TX) {
+			reset_search();
+			finish(0);
+			break;
+		}
+		// search command followed by the first bit/complement pair
+		for (uint8_t bit = 0; bit < 8; bit++)
+			tx_slots[bit] = (0xF0 & (1 << bit)) ? OW_SLOT_1 : OW_SLOT_0;
+		tx_slots[8] = OW_SLOT_1;
+		tx_slots[9] = OW_SLOT_1;
+		state = OW_SEARCH_BITS;
+		startSlots(10);
+		break;
+
+	case OW_SEARCH_BITS: {
+		uint8_t id_bit = (rx_slots[chunk - 2] == OW_SLOT_1);
+		uint8_t cmp_id_bit = (rx_slots[chunk - 1] == OW_SLOT_1);
+
+		// check for no devices on 1-wire
+		if (id_bit && cmp_id_bit) {
+			searchDone(false);
+			break;
+		}
+
+		uint8_t direction = searchDirection(id_bit, cmp_id_bit);
+		uint8_t rom_byte_number = (id_bit_number - 1) >> 3;
+		uint8_t rom_byte_mask = 1 << ((id_bit_number - 1) & 7);
+
+		if (direction)
+			ROM_NO[rom_byte_number] |= rom_byte_mask;
+		else
+			ROM_NO[rom_byte_number] &= ~rom_byte_mask;
+
+		// write the direction bit, then read the next pair in the
+		// same transfer
+		tx_slots[0] = direction ? OW_SLOT_1 : OW_SLOT_0;
+		id_bit_number++;
+		if (id_bit_number > 64) {
+			state = OW_SEARCH_LAST;
+			startSlots(1);
+		} else {
+			tx_slots[1] = OW_SLOT_1;
+			tx_slots[2] = OW_SLOT_1;
+			startSlots(3);
+		}
+		break;
+	}
+
+	case OW_SEARCH_LAST:
+		searchDone(true);
+		break;
+
+	default:
+		break;
+	}
+}
+
+uint8_t OneWireUART::searchDirection(uint8_t id_bit, uint8_t cmp_id_bit)
+{
+	uint8_t direction;
+
+	// all devices coupled have 0 or 1
+	if (id_bit != cmp_id_bit)
+		return id_bit;
+
+	// if this discrepancy if before the Last Discrepancy
+	// on a previous next then pick the same as last time
+	if (id_bit_number < LastDiscrepancy)
+		direction = (ROM_NO[(id_bit_number - 1) >> 3] >> ((id_bit_number - 1) & 7)) & 1;
+	else
+		// if equal to last pick 1, if not then pick 0
+		direction = (id_bit_number == LastDiscrepancy);
+
+	// if 0 was picked then record its position in LastZero
+	if (direction == 0) {
+		last_zero = id_bit_number;
+
+		// check for Last discrepancy in family
+		if (last_zero < 9)
+			LastFamilyDiscrepancy = last_zero;
+	}
+	return direction;
+}
+
+void OneWireUART::searchDone(bool found)
+{
+	if (found) {
+		// search successful so set LastDiscrepancy,LastDeviceFlag
+		LastDiscrepancy = last_zero;
+		if (LastDiscrepancy == 0)
+			LastDeviceFlag = TRUE;
+	}
+
+	// if no device found then reset counters so next 'search' will be
+	// like a first
+	if (!found || !ROM_NO[0]) {
+		reset_search();
+		finish(0);
+		return;
+	}
+	for (uint8_t i = 0; i < 8; i++) search_out[i] = ROM_NO[i];
+	finish(1);
+}
+
+//
+// Non-blocking API
+//
+
+void OneWireUART::reset_async(onewire_uart_callback cb)
+{
+	callback = cb;
+	state = OW_RESET;
+	startReset();
+}
+
+void OneWireUART::write_bytes_async(const uint8_t *buf, uint16_t count, onewire_uart_callback cb)
+{
+	callback = cb;
+	if (count == 0) {
+		finish(1);
+		return;
+	}
+	wr_ptr = buf;
+	remaining = count;
+	state = OW_WRITE;
+	loadWriteChunk();
+}
+
+void OneWireUART::read_bytes_async(uint8_t *buf, uint16_t count, onewire_uart_callback cb)
+{
+	callback = cb;
+	if (count == 0) {
+		finish(1);
+		return;
+	}
+	rd_ptr = buf;
+	remaining = count;
+	state = OW_READ;
+	loadReadChunk();
+}
+
+void OneWireUART::search_async(uint8_t *newAddr, onewire_uart_callback cb)
+{
+	callback = cb;
+	// the last call already found the last device
+	if (LastDeviceFlag) {
+		finish(0);
+		return;
+	}
+	search_out = newAddr;
+	id_bit_number = 1;
+	last_zero = 0;
+	state = OW_SEARCH_RESET;
+	startReset();
+}
+
+//
+// Blocking API
+//
+
+void OneWireUART::wait(void)
+{
+	while (state != OW_IDLE)
+		;
+}
+
+uint8_t OneWireUART::reset(void)
+{
+	reset_async(NULL);
+	wait();
+	return result;
+}
+
+void OneWireUART::write_bytes(const uint8_t *buf, uint16_t count)
+{
+	write_bytes_async(buf, count, NULL);
+	wait();
+}
+
+void OneWireUART::write(uint8_t v)
+{
+	write_bytes(&v, 1);
+}
+
+void OneWireUART::select(const uint8_t rom[8])
+{
+	uint8_t cmd[9];
+
+	cmd[0] = 0x55;  // Choose ROM
+	for (uint8_t i = 0; i < 8; i++) cmd[i + 1] = rom[i];
+	write_bytes(cmd, 9);
+}
+
+void OneWireUART::skip(void)
+{
+	write(0xCC);  // Skip ROM
+}
+
+void OneWireUART::read_bytes(uint8_t *buf, uint16_t count)
+{
+	read_bytes_async(buf, count, NULL);
+	wait();
+}
+
+uint8_t OneWireUART::read(void)
+{
+	uint8_t v;
+
+	read_bytes(&v, 1);
+	return v;
+}
+
+void OneWireUART::reset_search(void)
+{
+	LastDiscrepancy = 0;
+	LastDeviceFlag = FALSE;
+	LastFamilyDiscrepancy = 0;
+	for (int i = 7; ; i--) {
+		ROM_NO[i] = 0;
+		if (i == 0) break;
+	}
+}
+
+// Setup the search to find the device type 'family_code' on the next call
+// to search(*newAddr) if it is present.
+void OneWireUART::target_search(uint8_t family_code)
+{
+	// set the search state to find SearchFamily type devices
+	ROM_NO[0] = family_code;
+	for (uint8_t i = 1; i < 8; i++)
+		ROM_NO[i] = 0;
+	LastDiscrepancy = 64;
+	LastFamilyDiscrepancy = 0;
+	LastDeviceFlag = FALSE;
+}
+
+uint8_t OneWireUART::search(uint8_t *newAddr)
+{
+	search_async(newAddr, NULL);
+	wait();
+	return result;
+}
@@ -0,0 +1,120 @@
+#ifndef OneWireUART_h
+#define OneWireUART_h
+
+#include <inttypes.h>
+#include "Arduino.h"
+#include <libmaple/usart.h>
+#include <libmaple/dma.h>
+
+#include "OneWireSTM.h"
+
+// Hardware timed 1-Wire master on a half-duplex USART.
+//
+// Every 1-Wire slot is one UART frame: the start bit is the low pulse
+// and the echoed data byte tells what the bus did.  Resets run at
+// 9600 baud (0xF0 = 480uS low), data slots at 115200 baud (0xFF =
+// write 1 / read slot, 0x00 = write 0).  Slots are moved by DMA in
+// both directions so the CPU is only involved once per chunk, and
+// interrupts never stretch a slot the way they do for the bit-banged
+// OneWire class.
+//
+// Wiring: the USART TX pin is switched to open drain and used as the
+// bus line; add the usual 4k7 pull-up.  RX is not used.  Parasite
+// power (strong pull-up after a write) is not supported.
+//
+// The *_async() calls return immediately and invoke the callback from
+// the DMA interrupt when done, with the same result the blocking call
+// would have returned.  Only one operation may be in flight per
+// instance; check busy() before starting another.
+
+// Slots moved per DMA transfer (8 slots per byte).
+#ifndef ONEWIRE_UART_SLOTS
+#define ONEWIRE_UART_SLOTS 64
+#endif
+
+class OneWireUART;
+
+typedef void (*onewire_uart_callback)(OneWireUART *ow, uint8_t result);
+
+class OneWireUART
+{
+  public:
+    OneWireUART(usart_dev *dev);
+
+    // Configure the USART, its DMA channels and the TX pin.
+    void begin(void);
+
+    bool busy(void) const { return state != OW_IDLE; }
+
+    // Blocking API, same semantics as OneWire.
+    uint8_t reset(void);
+    void select(const uint8_t rom[8]);
+    void skip(void);
+    void write(uint8_t v);
+    void write_bytes(const uint8_t *buf, uint16_t count);
+    uint8_t read(void);
+    void read_bytes(uint8_t *buf, uint16_t count);
+    void reset_search(void);
+    void target_search(uint8_t family_code);
+    uint8_t search(uint8_t *newAddr);
+
+    // Non-blocking API.  'buf' / 'newAddr' must stay valid until the
+    // callback has run.  cb may be NULL.
+    void reset_async(onewire_uart_callback cb);
+    void write_bytes_async(const uint8_t *buf, uint16_t count, onewire_uart_callback cb);
+    void read_bytes_async(uint8_t *buf, uint16_t count, onewire_uart_callback cb);
+    void search_async(uint8_t *newAddr, onewire_uart_callback cb);
+
+    static uint8_t crc8(const uint8_t *addr, uint8_t len) { return OneWire::crc8(addr, len); }
+
+    // Called from the RX DMA interrupt.
+    void dmaComplete(void);
+
+  private:
+    enum ow_state {
+        OW_IDLE,
+        OW_RESET,
+        OW_WRITE,
+        OW_READ,
+        OW_SEARCH_RESET,
+        OW_SEARCH_BITS,
+        OW_SEARCH_LAST
+    };
+
+    usart_dev *dev;
+    dma_tube tx_tube;
+    dma_tube rx_tube;
+
+    volatile uint8_t state;
+    volatile uint8_t result;
+    onewire_uart_callback callback;
+
+    const uint8_t *wr_ptr;
+    uint8_t *rd_ptr;
+    uint16_t remaining;
+    uint16_t chunk;
+
+    uint8_t tx_slots[ONEWIRE_UART_SLOTS];
+    uint8_t rx_slots[ONEWIRE_UART_SLOTS];
+
+    // search state
+    unsigned char ROM_NO[8];
+    uint8_t LastDiscrepancy;
+    uint8_t LastFamilyDiscrepancy;
+    uint8_t LastDeviceFlag;
+    uint8_t id_bit_number;
+    uint8_t last_zero;
+    uint8_t *search_out;
+
+    void setBaud(uint32_t baud);
+    void startSlots(uint16_t count);
+    void startReset(void);
+    void loadWriteChunk(void);
+    void loadReadChunk(void);
+    uint8_t searchDirection(uint8_t id_bit, uint8_t cmp_id_bit);
+    void searchDone(bool found);
+    void finish(uint8_t res);
+    void wait(void);
+};
+
+#endif
@@ -0,0 +1,49 @@
+/*
+ * Measure two signals at once, e.g. two channels of an RC receiver.
+ *
+ * PA0 is Timer2 channel 1 and PA2 Timer2 channel 3, so both use
+ * Timer2; PA1 and PA3 (channels 2 and 4) are taken by the measurement
+ * and cannot be used for PWM.  Any pin that is a timer channel can be
+ * used, two per timer.
+ */
+
+#include <PulseCapture.h>
+
+PulseCapture ch1;
+PulseCapture ch2;
+
+void setup()
+{
+	Serial.begin(115200);
+	if (!ch1.begin(PA0) || !ch2.begin(PA2)) {
+		Serial.println("PA0/PA2 cannot be used");
+	}
+	// average 8 pulses per result on the second input
+	ch2.setWindow(8);
+}
+
+void show(const char *name, PulseCapture &in)
+{
+	pulse_result r;
+
+	if (in.read(&r)) {
+		Serial.print(name);
+		Serial.print(" width ");
+		Serial.print(in.toMicros(r.width));
+		Serial.print("us period ");
+		Serial.print(in.toMicros(r.period));
+		Serial.print("us ");
+		Serial.print(in.frequency(&r));
+		Serial.println("Hz");
+	} else if (in.idleTicks() > 1000000) {
+		Serial.print(name);
+		Serial.println(" no signal");
+	}
+}
+
+void loop()
+{
+	show("PA0", ch1);
+	show("PA2", ch2);
+	delay(100);
+}
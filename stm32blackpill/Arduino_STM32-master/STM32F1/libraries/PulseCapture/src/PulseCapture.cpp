@@ -0,0 +1,352 @@
+/*
+Timer input capture pulse measurement for STM32F1, see PulseCapture.h.
+
+The AN3174 IR decoding example runs a timer in PWM input mode, where
+the counter is reset on every start edge; that measures one signal per
+timer and nothing longer than a counter wrap.  Here the counter runs
+free, so the channel 1/2 and channel 3/4 pairs of a timer measure two
+signals at once, and counter wraps are counted to get 32 bit time
+stamps.
+*/
+
+#include "PulseCapture.h"
+#ifdef PULSE_CAPTURE_PROFILE
+#include <libmaple/dwt.h>
+#endif
+
+// Input capture filter: 8 samples at the timer clock, drops spikes
+// shorter than ~0.1uS.  Both edges are delayed alike.
+#define PC_IC_FILTER 0x3
+
+typedef struct pc_timer {
+    timer_dev *dev;
+    uint32 psc;                     // prescaler + 1
+    volatile uint32 overflows;      // counter wraps, high half of the time
+    PulseCapture *inputs[2];        // channel 1/2 and 3/4 pair
+} pc_timer;
+
+static pc_timer pc_timers[8];
+
+// Overflow count and a counter value that belong together.  A wrap
+// that is still pending is counted here, so it does not matter
+// whether the update or the capture interrupt is taken first (they
+// are separate vectors on TIMER1 and TIMER8).  Call with interrupts
+// off outside the timer's interrupt.
+static uint32 pc_sync(pc_timer *tm, uint16 *cnt)
+{
+    timer_gen_reg_map *regs = (tm->dev->regs).gen;
+    uint32 uif;
+    do {
+        uif = regs->SR & TIMER_SR_UIF;
+        *cnt = regs->CNT;
+    } while ((regs->SR & TIMER_SR_UIF) != uif);
+    if (uif) {
+        regs->SR = ~TIMER_SR_UIF;
+        tm->overflows++;
+    }
+    return tm->overflows;
+}
+
+// 32 bit time of a capture taken less than one counter wrap before cnt.
+static inline uint32 pc_stamp(uint32 hi, uint16 cnt, uint16 capture)
+{
+    return ((capture > cnt ? hi - 1 : hi) << 16) | capture;
+}
+
+static void pc_overflow(uint8 t)
+{
+    uint16 cnt;
+    pc_sync(&pc_timers[t], &cnt);
+}
+
+// Timer callbacks carry no context, so dispatch through pc_timers.
+#define PC_TIMER_IRQS(n)                                                          \
+    static void pc_overflow_irq##n(void) { pc_overflow(n); }                     \
+    static void pc_pair0_irq##n(void) { pc_timers[n].inputs[0]->captureIrq(); } \
+    static void pc_pair1_irq##n(void) { pc_timers[n].inputs[1]->captureIrq(); }
+PC_TIMER_IRQS(0) PC_TIMER_IRQS(1) PC_TIMER_IRQS(2) PC_TIMER_IRQS(3)
+PC_TIMER_IRQS(4) PC_TIMER_IRQS(5) PC_TIMER_IRQS(6) PC_TIMER_IRQS(7)
+
+static void (*const pc_overflow_irqs[8])(void) = {
+    pc_overflow_irq0, pc_overflow_irq1, pc_overflow_irq2, pc_overflow_irq3,
+    pc_overflow_irq4, pc_overflow_irq5, pc_overflow_irq6, pc_overflow_irq7,
+};
+static void (*const pc_capture_irqs[8][2])(void) = {
+    { pc_pair0_irq0, pc_pair1_irq0 }, { pc_pair0_irq1, pc_pair1_irq1 },
+    { pc_pair0_irq2, pc_pair1_irq2 }, { pc_pair0_irq3, pc_pair1_irq3 },
+    { pc_pair0_irq4, pc_pair1_irq4 }, { pc_pair0_irq5, pc_pair1_irq5 },
+    { pc_pair0_irq6, pc_pair1_irq6 }, { pc_pair0_irq7, pc_pair1_irq7 },
+};
+
+PulseCapture::PulseCapture(void)
+{
+    dev = NULL;
+    window = PULSE_CAPTURE_WINDOW;
+    ready = false;
+    lost_count = 0;
+    overrun_count = 0;
+#ifdef PULSE_CAPTURE_PROFILE
+    isr_max_cycles = 0;
+#endif
+}
+
+bool PulseCapture::begin(uint8 pin, uint8 state, uint32 tickHz)
+{
+    if (pin >= BOARD_NR_GPIO_PINS) {
+        return false;
+    }
+    timer_dev *tdev = PIN_MAP[pin].timer_device;
+    uint8 ch = PIN_MAP[pin].timer_channel;
+    uint32 clk = CYCLES_PER_MICROSECOND * 1000000UL;
+
+    if (tdev == NULL || tdev->type == TIMER_BASIC || ch < 1 || ch > 4 ||
+        tickHz == 0 || tickHz > clk || clk / tickHz > 65536) {
+        return false;
+    }
+    uint8 t = tdev->clk_id - RCC_TIMER1;
+    if (t >= 8) {
+        return false;
+    }
+
+    end();
+    pc_timer *tm = &pc_timers[t];
+    uint8 pair = (ch - 1) >> 1;
+    uint32 psc = clk / tickHz;
+    bool first = tm->inputs[0] == NULL && tm->inputs[1] == NULL;
+    if (tm->inputs[pair] != NULL || (!first && tm->psc != psc)) {
+        return false;
+    }
+
+    dev = tdev;
+    timer = t;
+    start_ch = ch;
+    end_ch = ((ch - 1) ^ 1) + 1;
+    tick_hz = clk / psc;
+    started = false;
+    in_pulse = false;
+    width_sum = period_sum = 0;
+    pulses = periods = 0;
+    ready = false;
+
+    pinMode(pin, INPUT);
+#ifdef PULSE_CAPTURE_PROFILE
+    dwt_cycle_counter_enable();
+#endif
+
+    timer_gen_reg_map *regs = (dev->regs).gen;
+    if (first) {
+        timer_pause(dev);
+        regs->SMCR = 0;
+        timer_set_prescaler(dev, psc - 1);
+        timer_set_reload(dev, 0xFFFF);
+        timer_generate_update(dev);
+        regs->SR = 0;
+        tm->dev = dev;
+        tm->psc = psc;
+        tm->overflows = 0;
+        timer_attach_interrupt(dev, TIMER_UPDATE_INTERRUPT, pc_overflow_irqs[t]);
+        timer_resume(dev);
+    }
+
+    // The pin's channel takes its own input (CCxS = 01), the partner
+    // the same input crossed over (CCxS = 10), each on its own edge.
+    uint32 odd = (ch & 1) ? 0x1 : 0x2;
+    uint32 ccmr = (PC_IC_FILTER << 4) | odd | (((PC_IC_FILTER << 4) | (odd ^ 0x3)) << 8);
+    uint32 start_p = state == LOW ? TIMER_CCER_CC1P : 0;
+    uint32 end_p = state == LOW ? 0 : TIMER_CCER_CC1P;
+    uint32 pair_ccer = 0xFF << (pair * 8);
+
+    regs->CCER &= ~pair_ccer;
+    if (pair == 0) {
+        regs->CCMR1 = ccmr;
+    } else {
+        regs->CCMR2 = ccmr;
+    }
+    regs->CCER |= ((start_p | TIMER_CCER_CC1E) << ((start_ch - 1) * 4)) |
+                  ((end_p | TIMER_CCER_CC1E) << ((end_ch - 1) * 4));
+    regs->SR = ~(((TIMER_SR_CC1IF | TIMER_SR_CC1OF) << (start_ch - 1)) |
+                 ((TIMER_SR_CC1IF | TIMER_SR_CC1OF) << (end_ch - 1)));
+
+    noInterrupts();
+    uint16 cnt;
+    last_edge = pc_sync(tm, &cnt) << 16 | cnt;
+    tm->inputs[pair] = this;
+    interrupts();
+    timer_attach_interrupt(dev, start_ch, pc_capture_irqs[t][pair]);
+    timer_attach_interrupt(dev, end_ch, pc_capture_irqs[t][pair]);
+    return true;
+}
+
+void PulseCapture::end(void)
+{
+    if (dev == NULL) {
+        return;
+    }
+    pc_timer *tm = &pc_timers[timer];
+    uint8 pair = (start_ch - 1) >> 1;
+
+    timer_detach_interrupt(dev, start_ch);
+    timer_detach_interrupt(dev, end_ch);
+    (dev->regs).gen->CCER &= ~(0xFF << (pair * 8));
+    tm->inputs[pair] = NULL;
+    if (tm->inputs[pair ^ 1] == NULL) {
+        timer_pause(dev);
+        timer_detach_interrupt(dev, TIMER_UPDATE_INTERRUPT);
+    }
+    dev = NULL;
+}
+
+void PulseCapture::setWindow(uint16 pulses)
+{
+    window = pulses ? pulses : 1;
+}
+
+bool PulseCapture::read(pulse_result *res)
+{
+    if (!ready) {
+        return false;
+    }
+    noInterrupts();
+    uint64 w = done_width_sum;
+    uint64 p = done_period_sum;
+    res->pulses = done_pulses;
+    res->periods = done_periods;
+    ready = false;
+    interrupts();
+
+    res->width = (w + res->pulses / 2) / res->pulses;
+    res->period = res->periods ? (p + res->periods / 2) / res->periods : 0;
+    return true;
+}
+
+uint32 PulseCapture::toMicros(uint32 ticks) const
+{
+    return (uint64)ticks * 1000000 / tick_hz;
+}
+
+float PulseCapture::frequency(const pulse_result *res) const
+{
+    return res->period ? (float)tick_hz / res->period : 0.0f;
+}
+
+uint32 PulseCapture::idleTicks(void)
+{
+    if (dev == NULL) {
+        return 0;
+    }
+    noInterrupts();
+    uint16 cnt;
+    uint32 now = pc_sync(&pc_timers[timer], &cnt) << 16 | cnt;
+    uint32 idle = now - last_edge;
+    interrupts();
+    return idle;
+}
+
+/*
+ * Interrupt side
+ */
+
+// Start and end edges alternate; two of a kind in a row mean the one
+// between was missed, which can happen without an overcapture: the
+// timer dispatch clears the capture flags after the handler returns,
+// including one set by an edge that came during the handler.
+
+void PulseCapture::startEdge(uint32 t)
+{
+    if (in_pulse) {
+        started = false;
+        lost_count++;
+    }
+    // the period counts with the pulse it starts, once that is complete
+    pending_period = started ? t - last_start : 0;
+    last_start = t;
+    last_edge = t;
+    started = true;
+    in_pulse = true;
+}
+
+void PulseCapture::endEdge(uint32 t)
+{
+    last_edge = t;
+    if (!in_pulse) {
+        if (started) {
+            started = false;
+            lost_count++;
+        }
+        return;
+    }
+    in_pulse = false;
+    width_sum += t - last_start;
+    if (pending_period) {
+        period_sum += pending_period;
+        periods++;
+    }
+    if (++pulses < window) {
+        return;
+    }
+    if (ready) {
+        overrun_count++;
+    }
+    done_width_sum = width_sum;
+    done_period_sum = period_sum;
+    done_pulses = pulses;
+    done_periods = periods;
+    ready = true;
+    width_sum = period_sum = 0;
+    pulses = periods = 0;
+}
+
+// Both channels of the pair share this handler.  Both captures may be
+// pending (a pulse shorter than the interrupt latency); they are taken
+// in the order they happened.  Edges that come while the handler runs
+// are taken too, as the timer dispatch clears the flags it called a
+// handler for after it returns.
+void PulseCapture::captureIrq(void)
+{
+#ifdef PULSE_CAPTURE_PROFILE
+    uint32 t0 = dwt_cycles();
+#endif
+    timer_gen_reg_map *regs = (dev->regs).gen;
+    uint32 start_if = TIMER_SR_CC1IF << (start_ch - 1);
+    uint32 end_if = TIMER_SR_CC1IF << (end_ch - 1);
+    uint32 of = (TIMER_SR_CC1OF << (start_ch - 1)) | (TIMER_SR_CC1OF << (end_ch - 1));
+    uint32 sr;
+
+    while ((sr = regs->SR) & (start_if | end_if)) {
+        // reading the capture clears its flag
+        uint16 cs = (sr & start_if) ? timer_get_compare(dev, start_ch) : 0;
+        uint16 ce = (sr & end_if) ? timer_get_compare(dev, end_ch) : 0;
+
+        // an edge came while its flag was still set: the capture read
+        // above is the newer one and the pulse around the lost one is gone
+        if (regs->SR & of) {
+            regs->SR = ~of;
+            started = false;
+            in_pulse = false;
+            lost_count++;
+        }
+
+        uint16 cnt;
+        uint32 hi = pc_sync(&pc_timers[timer], &cnt);
+        uint32 ts = pc_stamp(hi, cnt, cs);
+        uint32 te = pc_stamp(hi, cnt, ce);
+
+        if (!(sr & end_if)) {
+            startEdge(ts);
+        } else if (!(sr & start_if)) {
+            endEdge(te);
+        } else if ((int32)(te - ts) < 0) {
+            endEdge(te);
+            startEdge(ts);
+        } else {
+            startEdge(ts);
+            endEdge(te);
+        }
+    }
+#ifdef PULSE_CAPTURE_PROFILE
+    uint32 t = dwt_cycles() - t0;
+    if (t > isr_max_cycles) {
+        isr_max_cycles = t;
+    }
+#endif
+}
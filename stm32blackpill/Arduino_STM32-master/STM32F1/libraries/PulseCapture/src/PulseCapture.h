@@ -0,0 +1,116 @@
+#ifndef PulseCapture_h
+#define PulseCapture_h
+
+#include <inttypes.h>
+#include "Arduino.h"
+#include <libmaple/timer.h>
+
+// Pulse width, period and frequency measurement by timer input capture.
+//
+// Unlike pulseIn() nothing here waits: the timer time-stamps both edges
+// of every pulse in hardware and the capture interrupt only adds the
+// width and period to running sums.  read() returns the averages over
+// the last window of pulses, or false if none completed since the last
+// call, so any number of inputs are measured at the same time.
+//
+// Each input takes a pair of timer channels, 1 and 2 or 3 and 4, like
+// PWM input mode: the pin's own channel captures the edge that starts
+// a pulse and the other channel captures the end edge of the same
+// signal.  So a timer measures up to two pins, one of channel 1/2 and
+// one of channel 3/4, and its other outputs cannot be used for PWM.
+//
+// The counter runs free and is extended to 32 bits in software, so
+// pulses and periods of any length up to 2^32 ticks are measured with
+// the resolution of one tick.
+
+// Pulses per result unless set with setWindow().
+#ifndef PULSE_CAPTURE_WINDOW
+#define PULSE_CAPTURE_WINDOW 1
+#endif
+
+typedef struct pulse_result {
+    uint32 width;       // average pulse width, timer ticks
+    uint32 period;      // average start to start, ticks; 0 if not known yet
+    uint16 pulses;      // pulses averaged
+    uint16 periods;     // periods averaged
+} pulse_result;
+
+class PulseCapture
+{
+  public:
+    PulseCapture(void);
+
+    // pin must be a timer channel.  state HIGH measures high pulses,
+    // LOW low ones.  tickHz is the counter rate; both inputs of a timer
+    // must use the same.  Returns false if the pin or the channel pair
+    // cannot be used.
+    bool begin(uint8 pin, uint8 state = HIGH, uint32 tickHz = 1000000);
+    void end(void);
+
+    // Pulses per result, from 1 (every pulse) up.
+    void setWindow(uint16 pulses);
+
+    // Averages of the newest complete window; false if there has been
+    // none since the last call.
+    bool read(pulse_result *res);
+
+    // Conversions for a result.
+    uint32 toMicros(uint32 ticks) const;
+    float frequency(const pulse_result *res) const;
+
+    // Time since the last edge, in ticks: a signal that stopped makes
+    // no more results.
+    uint32 idleTicks(void);
+
+    // Edges missed because the interrupt was held off for a whole
+    // pulse; the pulses around them are not counted.
+    uint32 lost(void) const { return lost_count; }
+
+    // Results overwritten before read() fetched them.
+    uint32 overruns(void) const { return overrun_count; }
+
+#ifdef PULSE_CAPTURE_PROFILE
+    // Longest capture interrupt, in CPU cycles.
+    uint32 isrMaxCycles(void) const { return isr_max_cycles; }
+#endif
+
+    // Called from the timer interrupt.
+    void captureIrq(void);
+
+  private:
+    timer_dev *dev;
+    uint8 timer;        // index into the per timer state
+    uint8 start_ch;     // pin's channel, edge that starts a pulse
+    uint8 end_ch;
+    uint32 tick_hz;
+    uint16 window;
+
+    // interrupt side
+    bool started;       // last_start is valid
+    bool in_pulse;      // between a start and its end edge
+    uint32 last_start;
+    uint32 pending_period;  // of the pulse in progress, 0 if not known
+    volatile uint32 last_edge;
+    uint64 width_sum;
+    uint64 period_sum;
+    uint16 pulses;
+    uint16 periods;
+
+    // last complete window, until read()
+    volatile bool ready;
+    uint64 done_width_sum;
+    uint64 done_period_sum;
+    uint16 done_pulses;
+    uint16 done_periods;
+
+    volatile uint32 lost_count;
+    volatile uint32 overrun_count;
+#ifdef PULSE_CAPTURE_PROFILE
+    volatile uint32 isr_max_cycles;
+#endif
+
+    void startEdge(uint32 t);
+    void endEdge(uint32 t);
+};
+
+#endif
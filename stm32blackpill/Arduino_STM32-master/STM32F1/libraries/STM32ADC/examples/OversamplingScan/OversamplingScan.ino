@@ -0,0 +1,40 @@
+#include <ADCOversampler.h>
+
+/*
+    Scan two analog pins with 4 extra bits of resolution (16 bit
+    results, 256 samples per result) and print the results together
+    with the noise statistics once a second.
+*/
+
+uint8 pins[] = {PA0, PA1};
+const uint8 nPins = sizeof(pins) / sizeof(pins[0]);
+
+ADCOversampler ovs;
+
+void setup() {
+  Serial.begin(115200);
+  ovs.begin(pins, nPins, 4);
+}
+
+void loop() {
+  uint16 results[nPins];
+  adc_ovs_stats stats;
+
+  delay(1000);
+  ovs.read(results);
+  for (uint8 i = 0; i < nPins; i++) {
+    ovs.getStats(i, &stats);
+    Serial.print("ch");
+    Serial.print(i);
+    Serial.print(": ");
+    Serial.print(results[i]);
+    Serial.print(" noise ");
+    Serial.print(stats.noise);
+    Serial.print(" LSB, ENOB ");
+    Serial.print(stats.enob);
+    Serial.print("  ");
+  }
+  Serial.print(stats.samplesPerSecond);
+  Serial.println(" samples/s");
+  ovs.resetStats();
+}
@@ -0,0 +1,238 @@
+#include "ADCOversampler.h"
+#include "Arduino.h"
+#include <libmaple/nvic.h>
+#include <math.h>
+
+// Only ADC1 has a DMA request, so there is a single instance.
+static ADCOversampler *adc_ovs_instance;
+
+static void adc_ovs_dma_irq(void) {
+    if (adc_ovs_instance) adc_ovs_instance->dmaIrq();
+}
+
+    ADCOversampler::ADCOversampler() : _adc(ADC1) {
+        _channels = 0;
+        _ready = false;
+        _overruns = 0;
+    }
+
+/*
+    Work out the ratio and the half buffer size, then start ADC1 in
+    continuous scan mode with circular DMA over both halves.
+*/
+    bool ADCOversampler::begin(const uint8 *pins, uint8 nPins, uint8 extraBits, uint16 ratio,
+                               adc_smp_rate sampleRate) {
+        if (nPins == 0 || nPins > ADC_OVS_MAX_CHANNELS || extraBits > 4) {
+            return false;
+        }
+        uint32 minRatio = 1UL << (2 * extraBits);
+        if (ratio < minRatio) ratio = minRatio;
+        if (ratio < 4) ratio = 4;
+        if (ratio > ADC_OVS_MAX_RATIO) return false;
+
+        uint8 log2ratio = 0;
+        while ((1UL << log2ratio) < ratio) log2ratio++;
+
+        end();
+
+        _channels = nPins;
+        _ratio = 1 << log2ratio;
+        _extraBits = extraBits;
+        _shift = log2ratio - extraBits;
+        // Two samples per 32 bit word: with an even channel count each
+        // word always holds the same pair of channels, with an odd one
+        // the pattern repeats every nPins words.
+        _lanes = (nPins & 1) ? nPins : nPins / 2;
+
+        // Scans per half buffer: a power of 2, so it divides the ratio
+        // or the ratio divides it, and even so odd channel counts fill
+        // whole rows.
+        uint16 scans = 2;
+        while (scans * 2 * nPins <= ADC_OVS_HALF_SAMPLES) scans *= 2;
+        _halfSamples = scans * nPins;
+        _rowsPerResult = _ratio * nPins / 2 / _lanes;
+
+        _rows = 0;
+        for (uint8 i = 0; i < ADC_OVS_MAX_CHANNELS; i++) {
+            _sums[i] = 0;
+            _results[i] = 0;
+        }
+        _ready = false;
+        resetStats();
+
+        for (uint8 i = 0; i < nPins; i++) {
+            pinMode(pins[i], INPUT_ANALOG);
+        }
+
+        adc_ovs_instance = this;
+        _adc.setSampleRate(sampleRate);
+        _adc.setPins((uint8 *)pins, nPins);
+        _adc.setScanMode();
+        _adc.setContinuous();
+        _adc.setDMA(_buf, 2 * _halfSamples,
+                    DMA_MINC_MODE | DMA_CIRC_MODE | DMA_HALF_TRNS | DMA_TRNS_CMPLT, adc_ovs_dma_irq);
+        _adc.setTrigger(ADC_EXT_EV_SWSTART);
+        _adc.startConversion();
+        return true;
+    }
+
+/*
+    Stop conversions and leave ADC1 ready for analogRead().
+*/
+    void ADCOversampler::end() {
+        if (adc_ovs_instance != this) {
+            return;
+        }
+        _adc.resetContinuous();
+        dma_disable(DMA1, DMA_CH1);
+        dma_detach_interrupt(DMA1, DMA_CH1);
+        ADC1->regs->CR2 &= ~ADC_CR2_DMA;
+        ADC1->regs->CR1 &= ~ADC_CR1_SCAN;
+        adc_set_reg_seqlen(ADC1, 1);
+        adc_ovs_instance = NULL;
+    }
+
+    bool ADCOversampler::available() {
+        return _ready;
+    }
+
+    void ADCOversampler::read(uint16 *results) {
+        nvic_irq_disable(NVIC_DMA_CH1);
+        for (uint8 i = 0; i < _channels; i++) {
+            results[i] = _results[i];
+        }
+        _ready = false;
+        nvic_irq_enable(NVIC_DMA_CH1);
+    }
+
+    uint16 ADCOversampler::read(uint8 channel) {
+        _ready = false;
+        return channel < _channels ? _results[channel] : 0;
+    }
+
+    void ADCOversampler::resetStats() {
+        nvic_irq_disable(NVIC_DMA_CH1);
+        _statCount = 0;
+        _statRaw = 0;
+        for (uint8 i = 0; i < ADC_OVS_MAX_CHANNELS; i++) {
+            _statSum[i] = 0;
+            _statSumSq[i] = 0;
+        }
+        _statStart = millis();
+        nvic_irq_enable(NVIC_DMA_CH1);
+    }
+
+/*
+    Mean and RMS noise of the results in result LSBs. ENOB is
+    log2(full scale / (noise * sqrt(12))), meaningful for a steady input.
+*/
+    void ADCOversampler::getStats(uint8 channel, adc_ovs_stats *stats) {
+        if (channel >= _channels) channel = 0;
+        nvic_irq_disable(NVIC_DMA_CH1);
+        uint32 n = _statCount;
+        uint32 raw = _statRaw;
+        uint64 sum = _statSum[channel];
+        uint64 sumSq = _statSumSq[channel];
+        nvic_irq_enable(NVIC_DMA_CH1);
+
+        uint8 bits = 12 + _extraBits;
+        uint32 elapsed = millis() - _statStart;
+        stats->results = n;
+        stats->samplesPerSecond = elapsed ? (uint32)((uint64)raw * 1000 / elapsed) : 0;
+        if (n == 0) {
+            stats->mean = 0;
+            stats->noise = 0;
+            stats->enob = 0;
+            return;
+        }
+        double mean = (double)sum / n;
+        double var = (double)sumSq / n - mean * mean;
+        double noise = var > 0 ? sqrt(var) : 0;
+        stats->mean = mean;
+        stats->noise = noise;
+        if (noise * sqrt(12.0) <= 1.0) {
+            stats->enob = bits;
+        } else {
+            stats->enob = bits - log2(noise * sqrt(12.0));
+        }
+    }
+
+/*
+    Add one half buffer to the channel sums.
+
+    Samples are 12 bit, so 16 of them fit in a 16 bit lane. The kernel
+    loads two samples per word and adds whole words, 16 rows at a time,
+    before splitting the lanes into the 32 bit channel sums: half the
+    loads and adds of a per-sample loop.
+*/
+    void ADCOversampler::accumulate(const uint16 *half) {
+        const uint32 *w = (const uint32 *)half;
+        uint32 rows = _halfSamples / 2 / _lanes;
+
+        while (rows) {
+            uint32 r = _rowsPerResult - _rows;
+            if (r > 16) r = 16;
+            if (r > rows) r = rows;
+            for (uint32 lane = 0; lane < _lanes; lane++) {
+                const uint32 *q = w + lane;
+                uint32 acc = 0;
+                for (uint32 i = 0; i < r; i++, q += _lanes) {
+                    acc += *q;
+                }
+                _sums[(2 * lane) % _channels] += acc & 0xFFFF;
+                _sums[(2 * lane + 1) % _channels] += acc >> 16;
+            }
+            w += r * _lanes;
+            rows -= r;
+            _rows += r;
+            if (_rows == _rowsPerResult) {
+                latch();
+                _rows = 0;
+            }
+        }
+        _statRaw += _halfSamples;
+    }
+
+/*
+    A result window is complete: scale the sums and update the statistics.
+*/
+    void ADCOversampler::latch() {
+        for (uint8 i = 0; i < _channels; i++) {
+            uint16 v = _sums[i] >> _shift;
+            _results[i] = v;
+            _statSum[i] += v;
+            _statSumSq[i] += (uint32)v * v;
+            _sums[i] = 0;
+        }
+        _statCount++;
+        _ready = true;
+    }
+
+/*
+    The dispatcher clears the flags again after this returns, so a half
+    that completes while accumulate() runs is picked up here, not left
+    to an interrupt that would never come.
+*/
+    void ADCOversampler::dmaIrq() {
+        uint8 bits = dma_get_isr_bits(DMA1, DMA_CH1);
+        dma_clear_isr_bits(DMA1, DMA_CH1);
+
+        while (bits & (DMA_ISR_HTIF | DMA_ISR_TCIF)) {
+            if ((bits & (DMA_ISR_HTIF | DMA_ISR_TCIF)) == (DMA_ISR_HTIF | DMA_ISR_TCIF)) {
+                // both halves finished before we got here: the first one is
+                // being overwritten, drop the partial result
+                _overruns++;
+                for (uint8 i = 0; i < _channels; i++) _sums[i] = 0;
+                _rows = 0;
+                accumulate(_buf + _halfSamples);
+            } else if (bits & DMA_ISR_TCIF) {
+                accumulate(_buf + _halfSamples);
+            } else {
+                accumulate(_buf);
+            }
+            bits = dma_get_isr_bits(DMA1, DMA_CH1);
+            if (bits & (DMA_ISR_HTIF | DMA_ISR_TCIF)) {
+                dma_clear_isr_bits(DMA1, DMA_CH1);
+            }
+        }
+    }
@@ -0,0 +1,115 @@
+#ifndef ADCOversampler_h
+#define ADCOversampler_h
+
+#include "STM32ADC.h"
+
+/*
+    Oversampling / decimation on ADC1 (AN2668).
+
+    ADC1 scans up to 16 pins continuously and DMA fills a circular
+    buffer. Each half-transfer / transfer-complete interrupt adds the
+    half that just finished to per-channel sums, so the CPU handles
+    samples in blocks and never once per conversion.
+
+    For every 'ratio' samples of a channel one result of 12 + extraBits
+    bits is produced (ratio defaults to 4^extraBits, the minimum that
+    gains extraBits of resolution). The extra bits are only real if
+    the input carries about 1 LSB of noise, as AN2668 explains: either
+    the natural white noise of the board, or a triangular dither added
+    to the signal by the analog front end.
+
+    Per-channel statistics on the results (mean, RMS noise and the
+    effective number of bits for a steady input) help tune the ratio.
+*/
+
+// Samples per DMA half buffer (all channels). Larger means fewer interrupts.
+#ifndef ADC_OVS_HALF_SAMPLES
+#define ADC_OVS_HALF_SAMPLES 256
+#endif
+
+#define ADC_OVS_MAX_CHANNELS 16
+#define ADC_OVS_MAX_RATIO    4096
+
+typedef struct adc_ovs_stats {
+    uint32 results;     // results in the statistics window
+    float mean;         // in result LSBs
+    float noise;        // RMS noise in result LSBs
+    float enob;         // effective bits for a steady input
+    uint32 samplesPerSecond; // raw conversions, all channels
+} adc_ovs_stats;
+
+class ADCOversampler {
+
+public:
+
+    ADCOversampler();
+
+/*
+    Start scanning 'pins' (Maple pin numbers) continuously.
+    extraBits: resolution to add to the 12 bit ADC, 0..4.
+    ratio: samples per result, rounded up to a power of 2 and to at
+    least 4^extraBits; 0 picks 4^extraBits.
+    Returns false if the arguments are out of range.
+*/
+    bool begin(const uint8 *pins, uint8 nPins, uint8 extraBits, uint16 ratio = 0,
+               adc_smp_rate sampleRate = ADC_SMPR_55_5);
+
+    void end();
+
+/*
+    True when a new set of results has been produced since the last read().
+*/
+    bool available();
+
+/*
+    Latest result of every channel, in pin order, 12 + extraBits bits wide.
+*/
+    void read(uint16 *results);
+    uint16 read(uint8 channel);
+
+/*
+    Statistics of a channel's results since begin() or resetStats().
+*/
+    void getStats(uint8 channel, adc_ovs_stats *stats);
+    void resetStats();
+
+/*
+    Results lost because the DMA interrupt ran late.
+*/
+    uint32 overruns() { return _overruns; }
+
+/*
+    Called from the DMA interrupt.
+*/
+    void dmaIrq();
+
+private:
+
+    STM32ADC _adc;
+    uint8 _channels;
+    uint8 _lanes;       // packed accumulators per half buffer row
+    uint8 _extraBits;
+    uint8 _shift;       // sum >> _shift gives the result
+    uint16 _ratio;
+    uint16 _halfSamples;
+    uint16 _rowsPerResult;
+    uint16 _rows;       // rows of the current result window summed so far
+
+    uint16 _buf[2 * ADC_OVS_HALF_SAMPLES] __attribute__((aligned(4)));
+    uint32 _sums[ADC_OVS_MAX_CHANNELS];
+    volatile uint16 _results[ADC_OVS_MAX_CHANNELS];
+    volatile bool _ready;
+    volatile uint32 _overruns;
+
+    // statistics
+    volatile uint32 _statCount;
+    volatile uint32 _statRaw;
+    volatile uint64 _statSum[ADC_OVS_MAX_CHANNELS];
+    volatile uint64 _statSumSq[ADC_OVS_MAX_CHANNELS];
+    uint32 _statStart;
+
+    void accumulate(const uint16 *half);
+    void latch();
+};
+
+#endif
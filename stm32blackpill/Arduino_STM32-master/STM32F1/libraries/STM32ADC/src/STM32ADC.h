@@ -1,3 +1,6 @@
+#ifndef STM32ADC_h
+#define STM32ADC_h
+
 #include "utility/util_adc.h"
 #include "libmaple/dma.h"
 
@@ -156,3 +159,5 @@ private:
     static constexpr float _V25 = 1.43; //Volts //1.34 - 1.52
 
 };
+
+#endif
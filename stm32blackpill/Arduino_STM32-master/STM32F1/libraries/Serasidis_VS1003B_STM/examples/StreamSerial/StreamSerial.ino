@@ -0,0 +1,47 @@
+/*
+  StreamSerial
+
+  Plays an MP3 that arrives on the USB serial port, e.g. sent with
+    cat song.mp3 > /dev/ttyACM0
+  The data goes into a ring buffer that the DREQ interrupt and DMA empty
+  into the VS1003, so loop() is free for other work and only moves what
+  has arrived.  Once a second the stream statistics are printed on Serial1.
+
+  Wiring as in the hello_STM example.
+*/
+
+#include <VS1003_STM.h>
+#include <SPI.h>
+
+SPIClass spiVS(1);
+VS1003 player(PC14, PB10, PA8, PA9, spiVS); // cs_pin, dcs_pin, dreq_pin, reset_pin, SPI channel
+
+static uint8_t ring[8192]; // half a second at 128 kbps
+static uint32_t lastReport;
+
+void setup ()
+{
+  Serial.begin();
+  Serial1.begin(115200);
+
+  player.begin();
+  player.modeSwitch(); //Change mode from MIDI to MP3 decoding.
+  player.setVolume(0x00);  // set maximum output volume
+  player.beginStream(ring, sizeof(ring));
+}
+
+void loop() {
+  player.feed(Serial);
+
+  if (millis() - lastReport >= 1000) {
+    lastReport = millis();
+    vs1003_stream_stats st;
+    player.getStreamStats(&st);
+    Serial1.print("bytes ");
+    Serial1.print(st.bytes);
+    Serial1.print(" underruns ");
+    Serial1.print(st.underruns);
+    Serial1.print(" low water ");
+    Serial1.println(st.lowWater);
+  }
+}
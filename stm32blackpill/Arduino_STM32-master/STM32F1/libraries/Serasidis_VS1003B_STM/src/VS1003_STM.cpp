@@ -15,6 +15,9 @@
 
 //#include <my_SPI.h>
 #include <VS1003_STM.h>
+#include <libmaple/exti.h>
+#include <libmaple/spi.h>
+#include <libmaple/nvic.h>
 
 #if defined(USEFLAC)
 #include "flac.h"
@@ -108,16 +111,19 @@ static PGM_P const register_names[] =
 
 /****************************************************************************/
 
-inline void DMA1_CH3_Event() {
-  dma1_ch3_Active = 0;
-  dma_disable(DMA1, DMA_CH3);
-}
+// Streamed playback states
+#define STREAM_OFF      0
+#define STREAM_PLAYING  1
+#define STREAM_HELD     2 // paused for register access
+
+VS1003* VS1003::streamer;
 
 /****************************************************************************/
 
 uint16_t VS1003::read_register(uint8_t _reg) const
 {
   uint16_t result;
+  stream_hold();
   control_mode_on();
   delayMicroseconds(1); // tXCSS
   my_SPI.transfer(VS_READ_COMMAND); // Read operation
@@ -127,6 +133,7 @@ uint16_t VS1003::read_register(uint8_t _reg) const
   delayMicroseconds(1); // tXCSH
   await_data_request();
   control_mode_off();
+  stream_release();
   return result;
 }
 
@@ -134,6 +141,7 @@ uint16_t VS1003::read_register(uint8_t _reg) const
 
 void VS1003::write_register(uint8_t _reg,uint16_t _value) const
 {
+  stream_hold();
   control_mode_on();
   delayMicroseconds(1); // tXCSS
   my_SPI.transfer(VS_WRITE_COMMAND); // Write operation
@@ -143,6 +151,7 @@ void VS1003::write_register(uint8_t _reg,uint16_t _value) const
   delayMicroseconds(1); // tXCSH
   await_data_request();
   control_mode_off();
+  stream_release();
 }
 
 /****************************************************************************/
@@ -183,7 +192,8 @@ void VS1003::sdi_send_zeroes(size_t len)
 /****************************************************************************/
 
 VS1003::VS1003( uint8_t _cs_pin, uint8_t _dcs_pin, uint8_t _dreq_pin, uint8_t _reset_pin, SPIClass _spiChan):
-  cs_pin(_cs_pin), dcs_pin(_dcs_pin), dreq_pin(_dreq_pin), reset_pin(_reset_pin), my_SPI(_spiChan)
+  cs_pin(_cs_pin), dcs_pin(_dcs_pin), dreq_pin(_dreq_pin), reset_pin(_reset_pin), my_SPI(_spiChan),
+  stream_buf(NULL), stream_state(STREAM_OFF), stream_dma_busy(false)
 {
 }
 
@@ -351,3 +361,313 @@ void VS1003::loadUserCode(const uint16_t* buf, size_t len) const
 }
 
 /****************************************************************************/
+
+bool VS1003::beginStream(uint8_t* buffer, size_t size)
+{
+  if ( size < 64 || (size & (size - 1)) || streamer )
+    return false;
+
+  spi_dev* spi = my_SPI.dev();
+  stream_spi = spi;
+  if ( spi == SPI1 ) {
+    stream_dma = DMA1; stream_tube = DMA_CH3;
+  } else if ( spi == SPI2 ) {
+    stream_dma = DMA1; stream_tube = DMA_CH5;
+#if BOARD_NR_SPI >= 3
+  } else if ( spi == SPI3 ) {
+    stream_dma = DMA2; stream_tube = DMA_CH2;
+#endif
+  } else {
+    return false;
+  }
+
+  stream_buf = buffer;
+  stream_mask = size - 1;
+  stream_head = stream_tail = 0;
+  stream_dma_busy = false;
+  stream_starved = false;
+  resetStreamStats();
+
+  startSong();
+
+  dma_init(stream_dma);
+  dma_setup_transfer(stream_dma, stream_tube, &spi->regs->DR, DMA_SIZE_8BITS,
+                     stream_buf, DMA_SIZE_8BITS,
+                     DMA_MINC_MODE | DMA_FROM_MEM | DMA_TRNS_CMPLT);
+  dma_attach_interrupt(stream_dma, stream_tube, stream_dma_isr);
+  spi_tx_dma_enable(spi);
+
+  streamer = this;
+  data_mode_on();
+  stream_state = STREAM_PLAYING;
+  attachInterrupt(dreq_pin, stream_dreq_isr, this, RISING);
+  stream_kick();
+  return true;
+}
+
+/****************************************************************************/
+
+void VS1003::endStream(void)
+{
+  if ( stream_state == STREAM_OFF )
+    return;
+  while ( streamQueued() )
+    yield();
+
+  stream_hold();
+  detachInterrupt(dreq_pin);
+  dma_detach_interrupt(stream_dma, stream_tube);
+  spi_tx_dma_disable(stream_spi);
+  stream_state = STREAM_OFF;
+  streamer = NULL;
+
+  stopSong();
+}
+
+/****************************************************************************/
+
+size_t VS1003::streamSpace(void) const
+{
+  if ( !stream_buf )
+    return 0;
+  return stream_mask + 1 - (stream_head - stream_tail);
+}
+
+/****************************************************************************/
+
+size_t VS1003::streamQueued(void) const
+{
+  return stream_head - stream_tail;
+}
+
+/****************************************************************************/
+
+size_t VS1003::streamWriteSpan(uint8_t** data)
+{
+  size_t space = streamSpace();
+  if ( !space )
+    return 0;
+  uint32_t at = stream_head & stream_mask;
+  size_t contiguous = stream_mask + 1 - at;
+  *data = stream_buf + at;
+  return min(space, contiguous);
+}
+
+/****************************************************************************/
+
+void VS1003::streamCommit(size_t len)
+{
+  stream_head += len;
+  if ( len )
+    stream_kick();
+}
+
+/****************************************************************************/
+
+size_t VS1003::streamWrite(const uint8_t* data, size_t len)
+{
+  size_t done = 0;
+  uint8_t* span;
+  size_t n;
+  while ( done < len && (n = streamWriteSpan(&span)) > 0 )
+  {
+    n = min(n, len - done);
+    memcpy(span, data + done, n);
+    stream_head += n;
+    done += n;
+  }
+  if ( done )
+    stream_kick();
+  return done;
+}
+
+/****************************************************************************/
+
+size_t VS1003::feed(Stream& src)
+{
+  size_t done = 0;
+  uint8_t* span;
+  size_t n;
+  while ( (n = streamWriteSpan(&span)) > 0 )
+  {
+    n = src.readAvailable(span, n);
+    if ( !n )
+      break;
+    stream_head += n;
+    done += n;
+  }
+  if ( done )
+    stream_kick();
+  return done;
+}
+
+/****************************************************************************/
+
+size_t VS1003::feed(Client& src)
+{
+  size_t done = 0;
+  uint8_t* span;
+  size_t n;
+  while ( (n = streamWriteSpan(&span)) > 0 )
+  {
+    int avail = src.available();
+    if ( avail <= 0 )
+      break;
+    int got = src.read(span, min(n, (size_t)avail));
+    if ( got <= 0 )
+      break;
+    stream_head += got;
+    done += got;
+  }
+  if ( done )
+    stream_kick();
+  return done;
+}
+
+/****************************************************************************/
+
+bool VS1003::feedBlocks(const uint8_t* buf, size_t blocks, void* arg)
+{
+  VS1003* player = static_cast<VS1003*>(arg);
+  size_t len = blocks * 512;
+  while ( len )
+  {
+    if ( player->stream_state == STREAM_OFF )
+      return false;
+    size_t n = player->streamWrite(buf, len);
+    buf += n;
+    len -= n;
+    if ( len )
+      yield();
+  }
+  return true;
+}
+
+/****************************************************************************/
+
+void VS1003::getStreamStats(vs1003_stream_stats* stats) const
+{
+  noInterrupts();
+  *stats = stream_stats;
+  interrupts();
+}
+
+/****************************************************************************/
+
+void VS1003::resetStreamStats(void)
+{
+  noInterrupts();
+  memset(&stream_stats, 0, sizeof(stream_stats));
+  stream_stats.lowWater = stream_mask + 1;
+  interrupts();
+}
+
+/****************************************************************************/
+
+// Start the next transfer if the codec has room and there is data.
+// Runs in the DREQ and DMA interrupts only, which do not preempt each
+// other.
+void VS1003::stream_pump(void)
+{
+  if ( stream_dma_busy || stream_state != STREAM_PLAYING )
+    return;
+  if ( !digitalRead(dreq_pin) )
+    return; // the rising edge of DREQ calls again
+
+  uint32_t tail = stream_tail;
+  uint32_t queued = stream_head - tail;
+  if ( !queued )
+  {
+    // waiting for the first data or after the last is no underrun;
+    // one is counted when data comes again
+    if ( !stream_starved && stream_stats.bytes )
+    {
+      stream_starved = true;
+      stream_starved_at = micros();
+    }
+    return; // streamCommit() calls again
+  }
+  if ( stream_starved )
+  {
+    stream_starved = false;
+    stream_stats.underruns++;
+    stream_stats.underrunMicros += micros() - stream_starved_at;
+  }
+  if ( queued < stream_stats.lowWater )
+    stream_stats.lowWater = queued;
+
+  // DREQ high means room for 32 bytes
+  uint32_t at = tail & stream_mask;
+  uint32_t n = min(queued, (uint32_t)vs1003_chunk_size);
+  n = min(n, stream_mask + 1 - at);
+
+  stream_chunk = n;
+  stream_dma_busy = true;
+  dma_set_mem_addr(stream_dma, stream_tube, stream_buf + at);
+  dma_set_num_transfers(stream_dma, stream_tube, n);
+  dma_enable(stream_dma, stream_tube);
+}
+
+/****************************************************************************/
+
+// Have the DREQ interrupt look for work, for data that arrived while
+// the codec was waiting, or a stream that was held
+void VS1003::stream_kick(void) const
+{
+  if ( stream_state == STREAM_PLAYING && !stream_dma_busy )
+    EXTI_BASE->SWIER = BIT(PIN_MAP[dreq_pin].gpio_bit);
+}
+
+/****************************************************************************/
+
+void VS1003::stream_dreq_isr(void* arg)
+{
+  static_cast<VS1003*>(arg)->stream_pump();
+}
+
+/****************************************************************************/
+
+void VS1003::stream_dma_isr(void)
+{
+  VS1003* p = streamer;
+  dma_disable(p->stream_dma, p->stream_tube);
+  p->stream_tail += p->stream_chunk;
+  p->stream_stats.bytes += p->stream_chunk;
+  p->stream_stats.chunks++;
+
+  // DREQ counts the last byte once it has left the shift register
+  while ( !spi_is_tx_empty(p->stream_spi) );
+  while ( spi_is_busy(p->stream_spi) );
+
+  p->stream_dma_busy = false;
+  p->stream_pump();
+}
+
+/****************************************************************************/
+
+// Pause the stream between transfers, to use the bus for SCI
+void VS1003::stream_hold(void) const
+{
+  if ( stream_state == STREAM_OFF )
+    return;
+  stream_state = STREAM_HELD;
+  while ( stream_dma_busy );
+
+  // the transmit only DMA leaves received bytes and the overrun flag
+  (void)stream_spi->regs->DR;
+  (void)stream_spi->regs->SR;
+  data_mode_off();
+}
+
+/****************************************************************************/
+
+void VS1003::stream_release(void) const
+{
+  if ( stream_state != STREAM_HELD )
+    return;
+  data_mode_on();
+  stream_state = STREAM_PLAYING;
+  stream_kick();
+}
+
+/****************************************************************************/
@@ -25,6 +25,23 @@
 
 #include <Arduino.h>
 #include <SPI.h>
+#include <Client.h>
+#include <libmaple/dma.h>
+/**
+ * Statistics of streamed playback, see VS1003::getStreamStats()
+ */
+typedef struct vs1003_stream_stats
+{
+  uint32_t bytes; /**< Bytes sent to the codec */
+  uint32_t chunks; /**< DMA transfers, at most 32 bytes each */
+  uint32_t underruns; /**< Times the buffer ran empty while DREQ asked for data,
+                           counted when data came again; the codec may still
+                           have had enough of its own to play on */
+  uint32_t underrunMicros; /**< Total time DREQ asked for data in vain */
+  uint32_t lowWater; /**< Least data buffered when a transfer started, in bytes;
+                          includes the start, so reset once prebuffered */
+} vs1003_stream_stats;
+
 /**
  * Driver for VS1003 - MP3 / WMA / MIDI Audio Codec Chip
  *
@@ -69,6 +86,30 @@ private:
     digitalWrite(dcs_pin,HIGH);
   }
 
+  // Streamed playback: a ring buffer that the DREQ interrupt and the
+  // SPI transmit DMA empty into the codec, 32 bytes per DREQ check.
+  uint8_t* stream_buf; /**< Ring buffer, a power of two in size */
+  uint32_t stream_mask; /**< Ring buffer size minus one */
+  volatile uint32_t stream_head; /**< Bytes written into the ring, free running */
+  volatile uint32_t stream_tail; /**< Bytes sent from the ring, free running */
+  mutable volatile uint8_t stream_state; /**< STREAM_OFF, _PLAYING or _HELD */
+  mutable volatile bool stream_dma_busy;
+  uint16_t stream_chunk; /**< Size of the DMA transfer in flight */
+  bool stream_starved; /**< Codec is waiting on an empty buffer */
+  uint32_t stream_starved_at; /**< micros() when it started waiting */
+  spi_dev* stream_spi; /**< SPI device of my_SPI */
+  dma_dev* stream_dma;
+  dma_tube stream_tube;
+  vs1003_stream_stats stream_stats;
+
+  static VS1003* streamer; /**< The one instance streaming, for the ISRs */
+  static void stream_dreq_isr(void* arg);
+  static void stream_dma_isr(void);
+  void stream_pump(void);
+  void stream_kick(void) const;
+  void stream_hold(void) const;
+  void stream_release(void) const;
+
   uint16_t read_register(uint8_t _reg) const;
   void write_register(uint8_t _reg,uint16_t _value) const;
   void sdi_send_buffer(const uint8_t* data,size_t len);
@@ -142,6 +183,105 @@ public:
    */
   void setVolume(uint8_t vol) const;
 
+  /**
+   * Start streamed playback
+   *
+   * Instead of blocking in playChunk() until the chip has taken the
+   * data, write it into a ring buffer with streamWrite() or feed()
+   * and return.  The DREQ pin interrupt starts an SPI DMA transfer of
+   * 32 bytes whenever the codec has room, and the end of each transfer
+   * starts the next one while DREQ stays high, so the CPU is only busy
+   * for a few microseconds per 32 bytes.
+   *
+   * One VS1003 streams at a time.  While it does, the SPI transmit DMA
+   * channel belongs to it, and the DREQ pin interrupt and the DMA
+   * interrupt must have the same priority (the default).  Register
+   * access such as setVolume() still works; it pauses the stream for
+   * its duration.
+   *
+   * @param buffer Ring buffer for the stream
+   * @param size Size of buffer in bytes, a power of two of at least 64;
+   *             it should hold the data of a longest stall of the source
+   * @return false if the size is not a power of two or the SPI has no
+   *         transmit DMA
+   */
+  bool beginStream(uint8_t* buffer, size_t size);
+
+  /**
+   * Let the buffered data play out and stop streamed playback
+   *
+   * Waits until the ring buffer is empty, then finishes the song like
+   * stopSong().
+   */
+  void endStream(void);
+
+  /**
+   * Free space in the stream buffer, in bytes
+   */
+  size_t streamSpace(void) const;
+
+  /**
+   * Data in the stream buffer that has not been sent yet, in bytes
+   */
+  size_t streamQueued(void) const;
+
+  /**
+   * Copy data into the stream buffer.  Never waits.
+   *
+   * @return How many bytes fitted
+   */
+  size_t streamWrite(const uint8_t* data, size_t len);
+
+  /**
+   * Write into the stream buffer in place
+   *
+   * Points *data at the free space of the buffer that is contiguous
+   * and returns its size, for a source to read into directly; then
+   * streamCommit() queues what was written.
+   */
+  size_t streamWriteSpan(uint8_t** data);
+  void streamCommit(size_t len);
+
+  /**
+   * Move what has arrived from a stream (e.g. Serial) into the stream
+   * buffer, as far as it fits.  Never waits.
+   *
+   * @return Bytes moved
+   */
+  size_t feed(Stream& src);
+
+  /**
+   * Move what has arrived on a network connection (e.g. an
+   * EthernetClient) into the stream buffer, as far as it fits.
+   * Never waits.
+   *
+   * @return Bytes moved
+   */
+  size_t feed(Client& src);
+
+  /**
+   * Queue whole 512 byte blocks, waiting (in yield()) for room
+   *
+   * The signature suits block-level readers that hand over each run of
+   * blocks to a callback. Called directly, it plays blocks read from a
+   * card:
+   *
+   *   card.readBlocks(lba, buf, 4);
+   *   VS1003::feedBlocks(buf, 4, &player);
+   *
+   * @param buf The blocks
+   * @param blocks Number of blocks in buf
+   * @param arg The VS1003
+   * @return false if streamed playback is not running
+   */
+  static bool feedBlocks(const uint8_t* buf, size_t blocks, void* arg);
+
+  /**
+   * Statistics of streamed playback since beginStream() or
+   * resetStreamStats()
+   */
+  void getStreamStats(vs1003_stream_stats* stats) const;
+  void resetStreamStats(void);
 };
 
 #endif
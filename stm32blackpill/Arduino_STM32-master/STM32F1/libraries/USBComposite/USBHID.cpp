@@ -35,6 +35,7 @@
 
 bool USBHID::init(USBHID* me) {
     usb_hid_setTXEPSize(me->txPacketSize);
+    usb_hid_setPollInterval(me->pollInterval);
 	return true;
 }
 
@@ -109,23 +110,8 @@ void USBHID::begin(USBCompositeSerial serial, const HIDReportDescriptor* report)
 }
 
 void HIDReporter::sendReport() {
-//    while (usb_is_transmitting() != 0) {
-//    }
-
-    unsigned toSend = bufferSize;
-    uint8* b = buffer;
-    
-    while (toSend) {
-        unsigned delta = usb_hid_tx(b, toSend);
-        toSend -= delta;
-        b += delta;
-    }
-    
-//    while (usb_is_transmitting() != 0) {
-//    }
-
-    /* flush out to avoid having the pc wait for more data */
-    usb_hid_tx(NULL, 0);
+    usb_hid_queue_report(buffer, bufferSize, reportID,
+        HID_TX_WAIT | (coalesce ? HID_TX_COALESCE : 0));
 }
         
 HIDReporter::HIDReporter(USBHID& _HID, uint8_t* _buffer, unsigned _size, uint8_t _reportID) : HID(_HID) {
@@ -139,6 +125,7 @@ HIDReporter::HIDReporter(USBHID& _HID, uint8_t* _buffer, unsigned _size, uint8_t
     }
     memset(buffer, 0, bufferSize);
     reportID = _reportID;
+    coalesce = false;
     if (_size > 0 && reportID != 0)
         buffer[0] = _reportID;
 }
@@ -148,6 +135,7 @@ HIDReporter::HIDReporter(USBHID& _HID, uint8_t* _buffer, unsigned _size) : HID(_
     bufferSize = _size;
     memset(buffer, 0, _size);
     reportID = 0;
+    coalesce = false;
 }
 
 void HIDReporter::setFeature(uint8_t* in) {
@@ -292,6 +292,7 @@ class USBHID {
 private:
 	bool enabledHID = false;
     uint32 txPacketSize = 64;
+    uint8 pollInterval = 10;
 public:
 	static bool init(USBHID* me);
 	bool registerComponent();
@@ -322,6 +323,16 @@ public:
     void setTXPacketSize(uint32 size=64) {
         txPacketSize = size;
     }
+    // bInterval of the IN endpoint in ms; takes effect at the next begin()
+    void setPollInterval(uint8 ms=10) {
+        pollInterval = ms;
+    }
+    void getTxStats(HIDTxStats& stats) {
+        usb_hid_get_tx_stats(&stats);
+    }
+    void resetTxStats() {
+        usb_hid_reset_tx_stats();
+    }
 };
 
 class HIDReporter {
@@ -329,12 +340,16 @@ class HIDReporter {
         uint8_t* buffer;
         unsigned bufferSize;
         uint8_t reportID;
+        bool coalesce;
 
     protected:
         USBHID& HID;
         
     public:
+        // queues the report; waits only if the transmit queue is full
         void sendReport(); 
+        // state-type reporters: a newer report replaces one still queued
+        void setCoalesce(bool c) { coalesce = c; }
         // if you use this init function, the buffer starts with a reportID, even if the reportID is zero,
         // and bufferSize includes the reportID; if reportID is zero, sendReport() will skip the initial
         // reportID byte
@@ -386,6 +401,7 @@ protected:
     AbsMouseReport_t report;
 public:
 	HIDAbsMouse(USBHID& HID, uint8_t reportID=HID_MOUSE_REPORT_ID) : HIDReporter(HID, (uint8_t*)&report, sizeof(report), reportID) {
+        setCoalesce(true);
         report.buttons = 0;
         report.x = 0;
         report.y = 0;
@@ -549,6 +565,7 @@ public:
 	void hat(int16_t dir);
 	HIDJoystick(USBHID& HID, uint8_t reportID=HID_JOYSTICK_REPORT_ID) 
             : HIDReporter(HID, (uint8_t*)&joyReport, sizeof(joyReport), reportID) {
+        setCoalesce(true);
         joyReport.buttons = 0;
         joyReport.hat = 15;
         joyReport.x = 512;
@@ -113,14 +113,7 @@ void USBMIDI::writePackets(const void *buf, uint32 len) {
         }
         old_txed = txed;
     }
-
-
-    if (sent == usb_midi_txEPSize) {
-        while (usb_midi_is_transmitting() != 0) {
-        }
-        /* flush out to avoid having the pc wait for more data */
-        usb_midi_tx(NULL, 0);
-    }
+    // the endpoint callback sends a ZLP if the stream ended on a full packet
 }
 
 uint32 USBMIDI::available(void) {
@@ -247,14 +240,87 @@ void USBMIDI::dispatchPacket(uint32 p)
                     break;
             }
             break;
+
+        case CIN_SYSEX:
+            sysExBytes(e.b + 1, 3, false);
+            break;
+        case CIN_SYSEX_ENDS_IN_1:
+            // CIN 5 is also used for single byte system common messages
+            if (inSysEx || e.p.midi0 == MIDIv1_SYSEX_END) {
+                sysExBytes(e.b + 1, 1, true);
+            }
+            break;
+        case CIN_SYSEX_ENDS_IN_2:
+            sysExBytes(e.b + 1, 2, true);
+            break;
+        case CIN_SYSEX_ENDS_IN_3:
+            sysExBytes(e.b + 1, 3, true);
+            break;
+    }
+}
+
+// Collect SysEx bytes so handleSysExData() is called once per chunk
+// rather than once per 3-byte packet.
+void USBMIDI::sysExBytes(const uint8 *b, uint32 n, bool end)
+{
+    inSysEx = !end;
+    while (n--) {
+        sysExChunk[sysExChunkLen++] = *b++;
+        if (sysExChunkLen == sizeof(sysExChunk) && (n || !end)) {
+            handleSysExData(sysExChunk, sysExChunkLen, false);
+            sysExChunkLen = 0;
+        }
+    }
+    if (end) {
+        handleSysExData(sysExChunk, sysExChunkLen, true);
+        sysExChunkLen = 0;
     }
 }
 
 
-// Try to read data from USB port & pass anything read to processing function
+// Pack a SysEx byte stream (F0 ... F7) into USB-MIDI packets and queue
+// them in batches, reading straight from data so large dumps can be
+// sent from flash without a RAM copy.
+void USBMIDI::sendSysEx(const uint8 *data, uint32 len) {
+    union EVENT_t batch[16];
+    uint32 n = 0;
+
+    while (len) {
+        union EVENT_t &e = batch[n];
+        e.i = 0;
+        e.p.cable = DEFAULT_MIDI_CABLE;
+        if (len > 3) {
+            e.p.cin = CIN_SYSEX;
+            e.p.midi0 = data[0];
+            e.p.midi1 = data[1];
+            e.p.midi2 = data[2];
+            data += 3;
+            len -= 3;
+        } else {
+            e.p.cin = CIN_SYSEX_ENDS_IN_1 + len - 1;
+            e.p.midi0 = data[0];
+            if (len > 1) e.p.midi1 = data[1];
+            if (len > 2) e.p.midi2 = data[2];
+            len = 0;
+        }
+        if (++n == sizeof(batch)/sizeof(*batch) || len == 0) {
+            writePackets(batch, n);
+            n = 0;
+        }
+    }
+}
+
+// Try to read data from USB port & pass anything read to processing function.
+// Drains everything that has arrived, a batch of packets at a time.
 void USBMIDI::poll(void)
-{   while(available()) {
-        dispatchPacket(readPacket());
+{
+    uint32 packets[16];
+    uint32 n;
+
+    while ((n = usb_midi_rx(packets, sizeof(packets)/sizeof(*packets))) != 0) {
+        for (uint32 i = 0; i < n; i++) {
+            dispatchPacket(packets[i]);
+        }
     }
 }
 
@@ -467,4 +533,5 @@ void USBMIDI::handleContinue(void) {}
 void USBMIDI::handleStop(void) {}
 void USBMIDI::handleActiveSense(void) {}
 void USBMIDI::handleReset(void) {}
+void USBMIDI::handleSysExData(const uint8 *data, uint32 len, bool last) {}
 #pragma GCC diagnostic pop
@@ -108,6 +108,11 @@ private:
     
     // Called whenever data is read from the USB port
     void dispatchPacket(uint32 packet);
+    void sysExBytes(const uint8 *b, uint32 n, bool end);
+
+    uint8 sysExChunk[48];
+    uint8 sysExChunkLen = 0;
+    bool inSysEx = false;
     
     uint32 txPacketSize = 64;
     uint32 rxPacketSize = 64;
@@ -170,6 +175,11 @@ public:
     void sendStop(void);
     void sendActiveSense(void);
     void sendReset(void);
+
+    // Send a complete SysEx message, F0 through F7. data is read in place
+    // (it may live in flash) and packed into USB-MIDI packets as the
+    // transmit queue drains.
+    void sendSysEx(const uint8 *data, uint32 len);
     
     // Overload these in a subclass to get MIDI messages when they come in
     virtual void handleNoteOff(unsigned int channel, unsigned int note, unsigned int velocity);
@@ -188,6 +198,9 @@ public:
     virtual void handleStop(void);
     virtual void handleActiveSense(void);
     virtual void handleReset(void);
+    // Received SysEx bytes, F0 and F7 included, in chunks of up to 48
+    // bytes; last is true for the chunk that ends the message.
+    virtual void handleSysExData(const uint8 *data, uint32 len, bool last);
     
 };
 
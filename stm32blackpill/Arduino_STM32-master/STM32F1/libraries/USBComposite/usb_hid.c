@@ -38,6 +38,7 @@
 #include <libmaple/usb.h>
 #include <libmaple/nvic.h>
 #include <libmaple/delay.h>
+#include <libmaple/systick.h>
 
 /* Private headers */
 #include "usb_lib_globals.h"
@@ -52,6 +53,7 @@ uint16 GetEPTxAddr(uint8 /*bEpNum*/);
 
 static uint32 ProtocolValue = 0;
 static uint32 txEPSize = 64;
+static uint8 hidPollInterval = 0x0A;
 
 static void hidDataTxCb(void);
 static void hidUSBReset(void);
@@ -138,6 +140,12 @@ void usb_hid_setTXEPSize(uint32_t size) {
     txEPSize = size;
 }
 
+void usb_hid_setPollInterval(uint8_t ms) {
+    if (ms == 0)
+        ms = 1;
+    hidPollInterval = ms;
+}
+
 #define OUT_BYTE(s,v) out[(uint8*)&(s.v)-(uint8*)&s]
 #define OUT_16(s,v) *(uint16_t*)&OUT_BYTE(s,v) // OK on Cortex which can handle unaligned writes
 
@@ -149,6 +157,7 @@ static void getHIDPartDescriptor(uint8* out) {
     OUT_BYTE(hidPartConfigData, HID_Descriptor.descLenL) = (uint8)HID_Report_Descriptor.Descriptor_Size;
     OUT_BYTE(hidPartConfigData, HID_Descriptor.descLenH) = (uint8)(HID_Report_Descriptor.Descriptor_Size>>8);
     OUT_16(hidPartConfigData, HIDDataInEndpoint.wMaxPacketSize) = txEPSize;
+    OUT_BYTE(hidPartConfigData, HIDDataInEndpoint.bInterval) = hidPollInterval;
 }
 
 USBCompositePart usbHIDPart = {
@@ -175,6 +184,32 @@ static volatile uint32 hid_tx_head = 0;
 // Read index from hidBufferTx
 static volatile uint32 hid_tx_tail = 0;
 
+// Report boundaries within hidBufferTx. Every queued report goes out
+// in its own packet(s), and a state-type report can be overwritten in
+// place while it is still waiting.
+#define HID_TX_QUEUE_SIZE	16 // must be power of 2
+#define HID_TX_QUEUE_SIZE_MASK (HID_TX_QUEUE_SIZE-1)
+#define HID_TX_KEY_COALESCE 0x100
+
+typedef struct {
+    uint16 start;       // offset of the first byte in hidBufferTx
+    uint16 len;
+    uint16 key;         // reportID, | HID_TX_KEY_COALESCE if mergeable
+    uint32 queuedAt;    // systick_uptime() when queued
+} hid_tx_report;
+
+static volatile hid_tx_report hidTxQueue[HID_TX_QUEUE_SIZE];
+static volatile uint32 hid_txq_head = 0;
+static volatile uint32 hid_txq_tail = 0;
+// Bytes of the report at hid_txq_tail already copied to the PMA
+static volatile uint32 hid_tx_offset = 0;
+/* -1: TX endpoint idle; 1: a report packet is in it; 0: the zero
+ * length packet that ends a burst is in it. Kept apart from
+ * usbGenericTransmitting, which the serial part drives. */
+static volatile int8 hid_transmitting = -1;
+
+static volatile HIDTxStats hidTxStats;
+
 #define CDC_SERIAL_RX_BUFFER_SIZE	256 // must be power of 2
 #define CDC_SERIAL_RX_BUFFER_SIZE_MASK (CDC_SERIAL_RX_BUFFER_SIZE-1)
 
@@ -327,41 +362,100 @@ void usb_hid_set_buffers(uint8 type, volatile HIDBuffer_t* bufs, int n) {
     currentHIDBuffer = NULL;
 }
 
-/* This function is non-blocking.
+static void hid_tx_copy(uint32 pos, const uint8* buf, uint32 len) {
+    uint32 i;
+    for (i=0; i<len; i++) {
+        hidBufferTx[pos] = buf[i];
+        pos = (pos+1) & HID_TX_BUFFER_SIZE_MASK;
+    }
+}
+
+/* Queue one report for the IN endpoint. Returns 1 if the report was
+ * queued or merged into a waiting one, 0 if it was dropped.
  *
- * It copies data from a user buffer into the USB peripheral TX
- * buffer, and returns the number of bytes copied. */
-uint32 usb_hid_tx(const uint8* buf, uint32 len)
+ * With HID_TX_COALESCE, a still-queued report with the same reportID
+ * and length is overwritten instead of adding another; use this for
+ * reports that carry absolute state (joystick, absolute mouse).
+ * With HID_TX_WAIT, a full queue is waited on while the device is
+ * configured; otherwise the report is dropped and counted. */
+uint32 usb_hid_queue_report(const uint8* buf, uint32 len, uint8 reportID, uint8 flags)
 {
-	if (len==0) return 0; // no data to send
-
-	uint32 head = hid_tx_head; // load volatile variable
-	uint32 tx_unsent = (head - hid_tx_tail) & HID_TX_BUFFER_SIZE_MASK;
+    uint16 key = reportID | ((flags & HID_TX_COALESCE) ? HID_TX_KEY_COALESCE : 0);
+    uint32 i;
+
+    if (len==0 || len > HID_TX_BUFFER_SIZE-1) return 0;
+
+    for (;;) {
+        nvic_irq_disable(NVIC_USB_LP_CAN_RX0);
+
+        if (flags & HID_TX_COALESCE) {
+            for (i = hid_txq_tail; i != hid_txq_head; i = (i+1) & HID_TX_QUEUE_SIZE_MASK) {
+                volatile hid_tx_report* r = &hidTxQueue[i];
+                // the head entry may already be partly in the PMA
+                if (i == hid_txq_tail && hid_tx_offset != 0)
+                    continue;
+                if (r->key == key && r->len == len) {
+                    hid_tx_copy(r->start, buf, len);
+                    hidTxStats.coalesced++;
+                    nvic_irq_enable(NVIC_USB_LP_CAN_RX0);
+                    return 1;
+                }
+            }
+        }
 
-    // We can only put bytes in the buffer if there is place
-    if (len > (HID_TX_BUFFER_SIZE-tx_unsent-1) ) {
-        len = (HID_TX_BUFFER_SIZE-tx_unsent-1);
-    }
-	if (len==0) return 0; // buffer full
+        uint32 head = hid_tx_head;
+        uint32 used = (head - hid_tx_tail) & HID_TX_BUFFER_SIZE_MASK;
+        uint32 qhead = hid_txq_head;
+        uint32 qused = (qhead - hid_txq_tail) & HID_TX_QUEUE_SIZE_MASK;
+
+        if (len <= HID_TX_BUFFER_SIZE-used-1 && qused < HID_TX_QUEUE_SIZE-1) {
+            volatile hid_tx_report* r = &hidTxQueue[qhead];
+            hid_tx_copy(head, buf, len);
+            r->start = head;
+            r->len = len;
+            r->key = key;
+            r->queuedAt = systick_uptime();
+            hid_tx_head = (head+len) & HID_TX_BUFFER_SIZE_MASK;
+            hid_txq_head = (qhead+1) & HID_TX_QUEUE_SIZE_MASK;
+            hidTxStats.queued++;
+
+            if (hid_transmitting<0) {
+                hidDataTxCb(); // initiate data transmission
+            }
+            nvic_irq_enable(NVIC_USB_LP_CAN_RX0);
+            return 1;
+        }
 
-	uint16 i;
-	// copy data from user buffer to USB Tx buffer
-	for (i=0; i<len; i++) {
-		hidBufferTx[head] = buf[i];
-		head = (head+1) & HID_TX_BUFFER_SIZE_MASK;
-	}
-	hid_tx_head = head; // store volatile variable
+        nvic_irq_enable(NVIC_USB_LP_CAN_RX0);
 
-	while(usbGenericTransmitting >= 0);
-	
-	if (usbGenericTransmitting<0) {
-		hidDataTxCb(); // initiate data transmission
-	}
+        if (!(flags & HID_TX_WAIT) || !usb_is_configured(USBLIB)) {
+            hidTxStats.dropped++;
+            return 0;
+        }
+        // the endpoint callback frees space as the host polls
+    }
+}
 
-    return len;
+/* This function is non-blocking.
+ *
+ * It queues the data as one report and returns the number of bytes
+ * accepted (all or nothing). */
+uint32 usb_hid_tx(const uint8* buf, uint32 len)
+{
+    return usb_hid_queue_report(buf, len, 0, 0) ? len : 0;
 }
 
+void usb_hid_get_tx_stats(HIDTxStats* stats) {
+    nvic_irq_disable(NVIC_USB_LP_CAN_RX0);
+    *stats = hidTxStats;
+    nvic_irq_enable(NVIC_USB_LP_CAN_RX0);
+}
 
+void usb_hid_reset_tx_stats(void) {
+    nvic_irq_disable(NVIC_USB_LP_CAN_RX0);
+    memset((void*)&hidTxStats, 0, sizeof(hidTxStats));
+    nvic_irq_enable(NVIC_USB_LP_CAN_RX0);
+}
 
 uint16 usb_hid_get_pending(void) {
     return (hid_tx_head - hid_tx_tail) & HID_TX_BUFFER_SIZE_MASK;
@@ -369,13 +463,16 @@ uint16 usb_hid_get_pending(void) {
 
 static void hidDataTxCb(void)
 {
-	uint32 tail = hid_tx_tail; // load volatile variable
-	uint32 tx_unsent = (hid_tx_head - tail) & HID_TX_BUFFER_SIZE_MASK;
-	if (tx_unsent==0) {
-		if ( (--usbGenericTransmitting)==0) goto flush_hid; // no more data to send
+	uint32 qtail = hid_txq_tail; // load volatile variable
+	uint32 tx_unsent = 0;
+	if (qtail == hid_txq_head) {
+		if ( (--hid_transmitting)==0) goto flush_hid; // no more data to send
 		return; // it was already flushed, keep Tx endpoint disabled
 	}
-	usbGenericTransmitting = 1;
+	hid_transmitting = 1;
+	volatile hid_tx_report* r = &hidTxQueue[qtail];
+	uint32 tail = (r->start + hid_tx_offset) & HID_TX_BUFFER_SIZE_MASK;
+	tx_unsent = r->len - hid_tx_offset;
     // We can only send up to USBHID_CDCACM_TX_EPSIZE bytes in the endpoint.
     if (tx_unsent > txEPSize) {
         tx_unsent = txEPSize;
@@ -397,7 +494,18 @@ static void hidDataTxCb(void)
     if ( tx_unsent&1 ) {
         *dst = tmp;
     }
-	hid_tx_tail = tail; // store volatile variable
+	hid_tx_offset += tx_unsent;
+	if (hid_tx_offset >= r->len) {
+		// whole report is in the endpoint; release it
+		uint32 latency = systick_uptime() - r->queuedAt;
+		if (latency > hidTxStats.maxLatency)
+			hidTxStats.maxLatency = latency;
+		hidTxStats.totalLatency += latency;
+		hidTxStats.sent++;
+		hid_tx_offset = 0;
+		hid_tx_tail = tail; // store volatile variable
+		hid_txq_tail = (qtail + 1) & HID_TX_QUEUE_SIZE_MASK;
+	}
     
 flush_hid:
 	// enable Tx endpoint
@@ -411,6 +519,10 @@ static void hidUSBReset(void) {
     /* Reset the RX/TX state */
 	hid_tx_head = 0;
 	hid_tx_tail = 0;
+	hid_txq_head = 0;
+	hid_txq_tail = 0;
+	hid_tx_offset = 0;
+	hid_transmitting = -1;
 
     currentHIDBuffer = NULL;
 }
@@ -79,6 +79,7 @@ void usb_hid_set_buffers(uint8_t type, volatile HIDBuffer_t* featureBuffers, int
 uint16_t usb_hid_get_data(uint8_t type, uint8_t reportID, uint8_t* out, uint8_t poll);
 void usb_hid_set_feature(uint8_t reportID, uint8_t* data);
 void usb_hid_setTXEPSize(uint32_t size); 
+void usb_hid_setPollInterval(uint8_t ms);
 
 /*
  * HID Requests
@@ -139,6 +140,22 @@ void   usb_hid_putc(char ch);
 uint32 usb_hid_tx(const uint8* buf, uint32 len);
 uint32 usb_hid_tx_mod(const uint8* buf, uint32 len);
 
+#define HID_TX_COALESCE 1 // replace a queued report with the same ID
+#define HID_TX_WAIT     2 // wait for room instead of dropping
+
+typedef struct HIDTxStats {
+    uint32 queued;       // reports accepted into the queue
+    uint32 sent;         // reports handed to the IN endpoint
+    uint32 coalesced;    // reports merged into a still-queued one
+    uint32 dropped;      // reports discarded because the queue was full
+    uint32 maxLatency;   // worst queue-to-endpoint time, ms
+    uint32 totalLatency; // sum of queue-to-endpoint times, ms
+} HIDTxStats;
+
+uint32 usb_hid_queue_report(const uint8* buf, uint32 len, uint8 reportID, uint8 flags);
+void usb_hid_get_tx_stats(HIDTxStats* stats);
+void usb_hid_reset_tx_stats(void);
+
 uint32 usb_hid_data_available(void); /* in RX buffer */
 uint16 usb_hid_get_pending(void);
 
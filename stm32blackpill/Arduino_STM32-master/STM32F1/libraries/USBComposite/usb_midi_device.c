@@ -250,6 +250,17 @@ static volatile uint8 transmitting = 0;
 /* Number of unread bytes */
 static volatile uint32 n_unread_packets = 0;
 
+/* Packets waiting for the IN endpoint. Filled by usb_midi_tx(),
+ * drained from midiDataTxCb() one endpoint buffer at a time, so
+ * callers never wait for the previous packet to go out. */
+#define MIDI_TX_RING_SIZE 64 /* packets, must be power of 2 */
+#define MIDI_TX_RING_MASK (MIDI_TX_RING_SIZE-1)
+static volatile uint32 midiTxRing[MIDI_TX_RING_SIZE];
+static volatile uint32 midi_tx_head = 0;
+static volatile uint32 midi_tx_tail = 0;
+/* Last IN packet was full size; end the transfer with a ZLP */
+static volatile uint8 midi_tx_zlp = 0;
+
 uint32_t usb_midi_txEPSize = 64;
 static uint32_t rxEPSize = 64;
 
@@ -321,36 +332,72 @@ void usb_midi_setRXEPSize(uint32_t size) {
  * MIDI interface
  */
 
-/* This function is non-blocking.
- *
- * It copies data from a usercode buffer into the USB peripheral TX
- * buffer, and returns the number of bytes copied. */
-uint32 usb_midi_tx(const uint32* buf, uint32 packets) {
-    uint32 bytes=packets*4;
-    /* Last transmission hasn't finished, so abort. */
-    if (usb_midi_is_transmitting()) {
-		/* Copy to TxBuffer */
-		
-        return 0;  /* return len */
+/* Move the next endpoint buffer's worth of packets from the ring
+ * into the PMA and arm the IN endpoint. Called with the USB interrupt
+ * masked or from the endpoint callback. */
+static void midi_tx_load(void) {
+    uint32 tail = midi_tx_tail;
+    uint32 packets = (midi_tx_head - tail) & MIDI_TX_RING_MASK;
+    uint32 max = usb_midi_txEPSize/4;
+
+    if (packets == 0) {
+        n_unsent_packets = 0;
+        if (midi_tx_zlp) {
+            /* flush out to avoid having the pc wait for more data */
+            midi_tx_zlp = 0;
+            usb_set_ep_tx_count(USB_MIDI_TX_ENDP, 0);
+            transmitting = 1;
+            usb_set_ep_tx_stat(USB_MIDI_TX_ENDP, USB_EP_STAT_TX_VALID);
+        } else {
+            transmitting = 0;
+        }
+        return;
     }
 
-    /* We can only put usb_midi_txEPSize bytes in the buffer. */
-    if (bytes > usb_midi_txEPSize) {
-        bytes = usb_midi_txEPSize;
-        packets=bytes/4;
+    if (packets > max) {
+        packets = max;
     }
-
-    /* Queue bytes for sending. */
-    if (packets) {
-        usb_copy_to_pma((uint8 *)buf, bytes, USB_MIDI_TX_ADDR);
+    uint32 first = MIDI_TX_RING_SIZE - tail;
+    if (first > packets) {
+        first = packets;
     }
-    // We still need to wait for the interrupt, even if we're sending
-    // zero bytes. (Sending zero-size packets is useful for flushing
-    // host-side buffers.)
-    usb_set_ep_tx_count(USB_MIDI_TX_ENDP, bytes);
+    usb_copy_to_pma((uint8 *)&midiTxRing[tail], first*4, USB_MIDI_TX_ADDR);
+    if (packets > first) {
+        usb_copy_to_pma((uint8 *)midiTxRing, (packets-first)*4, USB_MIDI_TX_ADDR + first*4);
+    }
+    midi_tx_tail = (tail + packets) & MIDI_TX_RING_MASK;
+
+    usb_set_ep_tx_count(USB_MIDI_TX_ENDP, packets*4);
     n_unsent_packets = packets;
+    midi_tx_zlp = (packets == max);
     transmitting = 1;
     usb_set_ep_tx_stat(USB_MIDI_TX_ENDP, USB_EP_STAT_TX_VALID);
+}
+
+/* This function is non-blocking.
+ *
+ * It copies packets from a usercode buffer into the TX ring, starts
+ * the IN endpoint if it is idle, and returns the number of packets
+ * queued. */
+uint32 usb_midi_tx(const uint32* buf, uint32 packets) {
+    uint32 head = midi_tx_head;
+    uint32 space = MIDI_TX_RING_MASK - ((head - midi_tx_tail) & MIDI_TX_RING_MASK);
+    uint32 i;
+
+    if (packets > space) {
+        packets = space;
+    }
+    for (i = 0; i < packets; i++) {
+        midiTxRing[head] = buf[i];
+        head = (head + 1) & MIDI_TX_RING_MASK;
+    }
+    midi_tx_head = head;
+
+    nvic_irq_disable(NVIC_USB_LP_CAN_RX0);
+    if (!transmitting) {
+        midi_tx_load();
+    }
+    nvic_irq_enable(NVIC_USB_LP_CAN_RX0);
 
     return packets;
 }
@@ -364,7 +411,7 @@ uint8 usb_midi_is_transmitting(void) {
 }
 
 uint16 usb_midi_get_pending(void) {
-    return n_unsent_packets;
+    return n_unsent_packets + ((midi_tx_head - midi_tx_tail) & MIDI_TX_RING_MASK);
 }
 
 /* Nonblocking byte receive.
@@ -411,8 +458,7 @@ uint32 usb_midi_peek(uint32* buf, uint32 packets) {
  */
 
 static void midiDataTxCb(void) {
-    n_unsent_packets = 0;
-    transmitting = 0;
+    midi_tx_load();
 }
 
 static void midiDataRxCb(void) {
@@ -441,6 +487,10 @@ static void usbMIDIReset(void) {
     n_unread_packets = 0;
     n_unsent_packets = 0;
     rx_offset = 0;
+    midi_tx_head = 0;
+    midi_tx_tail = 0;
+    midi_tx_zlp = 0;
+    transmitting = 0;
 }
 
 static RESULT usbMIDIDataSetup(uint8 request) {
@@ -103,4 +103,54 @@ void TwoWire::setClock(uint32_t frequencyHz)
 	}
 }
 
+static void wire_msg(i2c_msg *msg, uint8 addr, uint16 flags,
+                     uint8 *data, uint16 len) {
+    msg->addr = addr;
+    msg->flags = flags;
+    msg->length = len;
+    msg->xferred = 0;
+    msg->data = data;
+}
+
+static bool wire_start(i2c_dev *dev, WireTransfer &t, uint16 num,
+                       void (*callback)(i2c_xfer*)) {
+    t.xfer.msgs = t.msgs;
+    t.xfer.num = num;
+    t.xfer.callback = callback;
+    t.xfer.arg = &t;
+    return i2c_master_xfer_async(dev, &t.xfer) == 0;
+}
+
+bool TwoWire::startWrite(WireTransfer &t, uint8 addr, const uint8 *data,
+                         uint16 len, void (*callback)(i2c_xfer*)) {
+    wire_msg(&t.msgs[0], addr, 0, (uint8*)data, len);
+    return wire_start(sel_hard, t, 1, callback);
+}
+
+bool TwoWire::startRead(WireTransfer &t, uint8 addr, uint8 *data,
+                        uint16 len, void (*callback)(i2c_xfer*)) {
+    wire_msg(&t.msgs[0], addr, I2C_MSG_READ, data, len);
+    return wire_start(sel_hard, t, 1, callback);
+}
+
+bool TwoWire::startWriteRead(WireTransfer &t, uint8 addr, const uint8 *wdata,
+                             uint16 wlen, uint8 *rdata, uint16 rlen,
+                             void (*callback)(i2c_xfer*)) {
+    wire_msg(&t.msgs[0], addr, 0, (uint8*)wdata, wlen);
+    wire_msg(&t.msgs[1], addr, I2C_MSG_READ, rdata, rlen);
+    return wire_start(sel_hard, t, 2, callback);
+}
+
+/*
+ * Errors of queued transactions are recovered from in the interrupt
+ * handler, so unlike process() there is nothing to restart here.
+ */
+int32 TwoWire::wait(WireTransfer &t, uint32 timeout) {
+    return i2c_master_xfer_wait(sel_hard, &t.xfer, timeout);
+}
+
+void TwoWire::poll(uint32 timeout) {
+    i2c_master_check_timeout(sel_hard, timeout);
+}
+
 TwoWire Wire(1);
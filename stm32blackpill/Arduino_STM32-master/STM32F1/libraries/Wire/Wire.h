@@ -43,6 +43,19 @@
 #include "wirish.h"
 #include <libmaple/i2c.h>
 
+/*
+ * A transaction started with TwoWire::startWrite() and friends. It
+ * must stay in place, with the buffers it points at, until done().
+ */
+struct WireTransfer {
+    i2c_xfer xfer;
+    i2c_msg  msgs[2];
+
+    bool done() const { return xfer.result != I2C_XFER_PENDING; }
+    /* 0, or I2C_ERROR_PROTOCOL / I2C_ERROR_TIMEOUT */
+    int32 result() const { return xfer.result; }
+};
+
 class TwoWire : public WireBase {
 private:
     i2c_dev* sel_hard;
@@ -73,6 +86,32 @@ public:
     ~TwoWire();
 
     void begin(uint8 = 0x00);
+
+    /*
+     * Non-blocking transactions. They are queued and run from the I2C
+     * interrupt; the callback, if any, is called from there when the
+     * transaction has ended. Returns false if nothing was queued.
+     */
+    bool startWrite(WireTransfer&, uint8 addr, const uint8 *data,
+                    uint16 len, void (*callback)(i2c_xfer*) = NULL);
+    bool startRead(WireTransfer&, uint8 addr, uint8 *data, uint16 len,
+                   void (*callback)(i2c_xfer*) = NULL);
+    /* Write, then read after a repeated start, e.g. register reads */
+    bool startWriteRead(WireTransfer&, uint8 addr, const uint8 *wdata,
+                        uint16 wlen, uint8 *rdata, uint16 rlen,
+                        void (*callback)(i2c_xfer*) = NULL);
+
+    /*
+     * Wait for a transaction; timeout in mS without bus activity, 0 for
+     * none. Returns its result.
+     */
+    int32 wait(WireTransfer&, uint32 timeout = 0);
+
+    /*
+     * Abort the transaction on the bus if it has not moved for timeout
+     * mS, and reset the bus. Call from loop() when nobody waits.
+     */
+    void poll(uint32 timeout);
 };
 extern TwoWire Wire;
 #endif // _TWOWIRE_H_
@@ -0,0 +1,58 @@
+// i2c_async_read
+//
+// Reads 16 bytes from a 24Cxx EEPROM at 0x50 in the background while
+// loop() keeps blinking the LED. The transfer is queued with
+// startWriteRead() and finishes in the I2C interrupt; DMA moves the
+// data because the bus was set up with I2C_DMA.
+
+#include <Wire.h>
+
+TwoWire WireDMA(1, I2C_FAST_MODE | I2C_DMA);
+
+WireTransfer xfer;
+const uint8 wordAddr[2] = { 0x00, 0x00 };
+uint8 data[16];
+volatile bool ready = false;
+
+void readDone(i2c_xfer *x)
+{
+	// called from the I2C interrupt: keep it short
+	ready = true;
+}
+
+void startRead()
+{
+	ready = false;
+	WireDMA.startWriteRead(xfer, 0x50, wordAddr, sizeof(wordAddr),
+			data, sizeof(data), readDone);
+}
+
+void setup()
+{
+	Serial.begin(115200);
+	pinMode(LED_BUILTIN, OUTPUT);
+	WireDMA.begin();
+	startRead();
+}
+
+void loop()
+{
+	digitalWrite(LED_BUILTIN, (millis() / 250) & 1);
+
+	// give up on a transfer stuck for 10mS and reset the bus
+	WireDMA.poll(10);
+
+	if (ready) {
+		if (xfer.result() == 0) {
+			for (uint8 i = 0; i < sizeof(data); i++) {
+				Serial.print(data[i], HEX);
+				Serial.print(' ');
+			}
+			Serial.println();
+		} else {
+			Serial.println("read failed");
+		}
+		delay(500);
+		startRead();
+	}
+}
@@ -61,6 +61,14 @@
 
 void _i2c_irq_handler(i2c_dev *dev);
 void _i2c_irq_error_handler(i2c_dev *dev);
+void _i2c_irq_dma_rx_handler(i2c_dev *dev);
+
+/* Series support for I2C_DMA. _i2c_dma_start() returns 0 if dev has
+ * no DMA channels; the receive channel calls _i2c_irq_dma_rx_handler()
+ * on transfer complete. */
+int _i2c_dma_start(i2c_dev *dev, struct i2c_msg *msg);
+void _i2c_dma_stop(i2c_dev *dev, struct i2c_msg *msg);
+uint16 _i2c_dma_remaining(i2c_dev *dev, struct i2c_msg *msg);
 
 struct gpio_dev;
 
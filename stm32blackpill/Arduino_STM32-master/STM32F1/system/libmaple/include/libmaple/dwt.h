@@ -0,0 +1,126 @@
+/******************************************************************************
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The  above copyright  notice and  this permission  notice  shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *****************************************************************************/
+
+/**
+ * @file libmaple/include/libmaple/dwt.h
+ * @brief Data watchpoint and trace unit (cycle counter only)
+ */
+
+#ifndef _LIBMAPLE_DWT_H_
+#define _LIBMAPLE_DWT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <libmaple/libmaple_types.h>
+
+/*
+ * Register maps and base pointers
+ */
+
+/** DWT register map type (the part we use) */
+typedef struct dwt_reg_map {
+    __IO uint32 CTRL;    /**< Control register */
+    __IO uint32 CYCCNT;  /**< Cycle count register */
+} dwt_reg_map;
+
+/** DWT register map base pointer */
+#define DWT_BASE                        ((struct dwt_reg_map*)0xE0001000)
+
+/** Debug Exception and Monitor Control Register */
+#define DWT_DEMCR                       (*(__IO uint32*)0xE000EDFC)
+
+/** STM32 debug MCU configuration register */
+#define DWT_DBGMCU_CR                   (*(__IO uint32*)0xE0042004)
+
+/*
+ * Register bit definitions
+ */
+
+#define DWT_CTRL_CYCCNTENA              (1U << 0)
+#define DWT_DEMCR_TRCENA                (1U << 24)
+#define DWT_DBGMCU_CR_DBG_SLEEP         (1U << 0)
+
+/*
+ * Routines
+ */
+
+/**
+ * @brief Start the free running CPU cycle counter.
+ *
+ * Safe to call more than once; the count is not reset.  The counter
+ * stops while the core sleeps, unless DBG_SLEEP is set in
+ * DWT_DBGMCU_CR for that time (delay() does so around its WFI).
+ */
+static inline void dwt_cycle_counter_enable(void) {
+    DWT_DEMCR |= DWT_DEMCR_TRCENA;
+    DWT_BASE->CTRL |= DWT_CTRL_CYCCNTENA;
+}
+
+/**
+ * @brief Current CPU cycle count; wraps every 2^32 cycles.
+ */
+static inline uint32 dwt_cycles(void) {
+    return DWT_BASE->CYCCNT;
+}
+
+/*
+ * 64 bit cycle count
+ */
+
+/* Upper word of the count, and the count when it was last checked.
+ * Only dwt_cycles_extend() writes them. */
+extern volatile uint32 dwt_cycles_hi;
+extern volatile uint32 dwt_cycles_last;
+
+void dwt_cycles64_init(void);
+void dwt_cycles_extend(void);
+
+/**
+ * @brief CPU cycles since dwt_cycles64_init(); does not wrap.
+ *
+ * dwt_cycles_extend() must run at least once per 2^32 cycles (the
+ * SysTick interrupt does it every millisecond).  Callable from any
+ * context, including interrupts that preempt the extending one: a
+ * wrap it has not seen yet shows as a count below the last one.
+ */
+static inline uint64 dwt_cycles64(void) {
+    uint32 hi, last, now;
+    do {
+        hi = dwt_cycles_hi;
+        last = dwt_cycles_last;
+        now = DWT_BASE->CYCCNT;
+    } while (hi != dwt_cycles_hi);
+    if (now < last) {
+        hi++;
+    }
+    return ((uint64)hi << 32) | now;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -123,6 +123,73 @@ void exti_attach_callback(exti_num num,
                           exti_trigger_mode mode);
 void exti_detach_interrupt(exti_num num);
 
+/**
+ * @brief Edge timestamp ring.
+ *
+ * Single producer (the EXTI interrupt) / single consumer ring of DWT
+ * cycle counts.  head and tail run freely and are masked on access,
+ * so the size must be a power of two.  Use exti_ring_init() to set
+ * one up and exti_ring_read() to drain it; no locking is needed.
+ */
+typedef struct exti_ring {
+    uint32 *buf;            /**< Timestamp storage */
+    uint16 mask;            /**< Ring size - 1 */
+    volatile uint16 head;   /**< Next slot written by the ISR */
+    volatile uint16 tail;   /**< Next slot read by the consumer */
+} exti_ring;
+
+/** Per-line counters, updated from the EXTI interrupt. */
+typedef struct exti_line_stats {
+    uint32 hits;        /**< Edges seen on the line */
+    uint32 overruns;    /**< Edges dropped: ring full, or a deferred
+                             handler was still pending */
+} exti_line_stats;
+
+void exti_attach_ring(exti_num num,
+                      exti_cfg port,
+                      exti_ring *ring,
+                      exti_trigger_mode mode);
+void exti_set_deferred(exti_num num, int deferred);
+void exti_run_deferred(void);
+void exti_get_stats(exti_num num, exti_line_stats *stats);
+void exti_reset_stats(exti_num num);
+
+/**
+ * @brief Initialize a timestamp ring.
+ * @param ring Ring to initialize.
+ * @param buf  Storage for size timestamps.
+ * @param size Number of entries; must be a power of two <= 32768.
+ */
+static inline void exti_ring_init(exti_ring *ring, uint32 *buf, uint16 size) {
+    ring->buf = buf;
+    ring->mask = size - 1;
+    ring->head = 0;
+    ring->tail = 0;
+}
+
+/**
+ * @brief Number of timestamps waiting in a ring.
+ */
+static inline uint16 exti_ring_available(exti_ring *ring) {
+    return (uint16)(ring->head - ring->tail);
+}
+
+/**
+ * @brief Pop the oldest timestamp from a ring.
+ * @param ring Ring to read from.
+ * @param ts   Receives the DWT cycle count of the edge.
+ * @return 1 if a timestamp was read, 0 if the ring was empty.
+ */
+static inline int exti_ring_read(exti_ring *ring, uint32 *ts) {
+    uint16 tail = ring->tail;
+    if (tail == ring->head) {
+        return 0;
+    }
+    *ts = ring->buf[tail & ring->mask];
+    ring->tail = tail + 1;
+    return 1;
+}
+
 /**
  * @brief Set the GPIO port for an EXTI line.
  *
@@ -34,7 +34,8 @@
  * - Enable an I2C device with i2c_master_enable().
  * - Initialize an array of struct i2c_msg to suit the bus
  *   transactions (reads/writes) you wish to perform.
- * - Call i2c_master_xfer() to do the work.
+ * - Call i2c_master_xfer() to do the work, or queue an i2c_xfer
+ *   with i2c_master_xfer_async() and carry on.
  */
 
 #ifndef _LIBMAPLE_I2C_H_
@@ -198,12 +199,43 @@ typedef struct i2c_msg {
 #define I2C_DUTY_16_9           0x2           // 16/9 duty ratio
 /* Flag 0x4 is reserved; DO NOT USE. */
 #define I2C_BUS_RESET           0x8           // Perform a bus reset
+#define I2C_DMA                 0x10          // DMA for long messages
 void i2c_master_enable(i2c_dev *dev, uint32 flags);
 
+/* With I2C_DMA, messages of this length or more are moved by DMA
+ * instead of an interrupt per byte. */
+#ifndef I2C_DMA_MIN
+#define I2C_DMA_MIN             8
+#endif
+
 #define I2C_ERROR_PROTOCOL      (-1)
 #define I2C_ERROR_TIMEOUT       (-2)
 int32 i2c_master_xfer(i2c_dev *dev, i2c_msg *msgs, uint16 num, uint32 timeout);
 
+/**
+ * @brief Asynchronous I2C transaction
+ *
+ * Queued with i2c_master_xfer_async(). The structure and its
+ * messages must stay valid until result is no longer
+ * I2C_XFER_PENDING.
+ */
+typedef struct i2c_xfer {
+    i2c_msg *msgs;              /**< Messages, as for i2c_master_xfer() */
+    uint16 num;                 /**< Number of messages */
+    /** Called from the I2C interrupt when the transaction has ended.
+     *  May queue another transaction. Can be NULL. */
+    void (*callback)(struct i2c_xfer *xfer);
+    void *arg;                  /**< For the callback */
+    /** I2C_XFER_PENDING, then 0 or I2C_ERROR_* */
+    volatile int32 result;
+    struct i2c_xfer *next;      /**< For internal use */
+} i2c_xfer;
+
+#define I2C_XFER_PENDING        1
+int32 i2c_master_xfer_async(i2c_dev *dev, i2c_xfer *xfer);
+int32 i2c_master_xfer_wait(i2c_dev *dev, i2c_xfer *xfer, uint32 timeout);
+void i2c_master_check_timeout(i2c_dev *dev, uint32 timeout);
+
 void i2c_bus_reset(const i2c_dev *dev);
 
 /**
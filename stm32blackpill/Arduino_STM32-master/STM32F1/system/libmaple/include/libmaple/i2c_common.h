@@ -45,6 +45,7 @@
 struct gpio_dev;
 struct i2c_reg_map;
 struct i2c_msg;
+struct i2c_xfer;
 
 /** I2C device states */
 typedef enum i2c_state {
@@ -88,6 +89,11 @@ typedef struct i2c_dev {
     nvic_irq_num ev_nvic_line;  /**< Event IRQ number */
     nvic_irq_num er_nvic_line;  /**< Error IRQ number */
     volatile i2c_state state;   /**< Device state */
+    uint32 config_flags;        /**< Flags given to i2c_master_enable() */
+    struct i2c_xfer *volatile xfer; /**< Asynchronous transfer on the bus */
+    struct i2c_xfer *queue;     /**< Asynchronous transfers waiting */
+    struct i2c_xfer *queue_tail;
+    volatile uint8 dma_msg;     /**< Current message is moved by DMA */
 } i2c_dev;
 
 #endif
@@ -146,6 +146,40 @@ static inline int rb_peek(ring_buffer *rb)
 }
 
 
+/**
+ * @brief Return the items at the front of a ring buffer that are
+ *        contiguous in memory, without removing them.
+ *
+ * Together with rb_discard() this lets a reader copy or scan the
+ * buffer a run at a time instead of an item at a time.  The run ends
+ * at the end of the buffer memory or at the tail, so a full buffer
+ * that wraps takes two calls.
+ *
+ * @param rb Buffer to look into.
+ * @param data Set to the first item, if there is one.
+ * @return Number of items in the run, 0 if rb is empty.
+ */
+static inline uint16 rb_span(ring_buffer *rb, const uint8 **data) {
+    uint16 head = rb->head;
+    uint16 tail = rb->tail;
+    *data = (const uint8*)&rb->buf[head];
+    return (tail >= head ? tail : rb->size + 1) - head;
+}
+
+/**
+ * @brief Remove items from the front of a ring buffer.
+ * @param rb Buffer to remove from.
+ * @param n Number of items to remove, at most what rb_full_count()
+ *          (or rb_span()) returned.
+ */
+static inline void rb_discard(ring_buffer *rb, uint16 n) {
+    uint32 head = rb->head + n;
+    if (head > rb->size) {
+        head -= rb->size + 1;
+    }
+    rb->head = head;
+}
+
 /**
  * @brief Attempt to remove the first item from a ring buffer.
  *
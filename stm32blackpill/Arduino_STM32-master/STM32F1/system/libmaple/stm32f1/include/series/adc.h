@@ -66,6 +66,12 @@ extern struct adc_dev *ADC3;
  * Register bit definitions
  */
 
+/* Control register 1 (F1 specific bits; the rest are in libmaple/adc.h) */
+
+#define ADC_CR1_DUALMOD                 (0xF << 16)
+#define ADC_CR1_DUALMOD_INDEPENDENT     (0x0 << 16)
+#define ADC_CR1_DUALMOD_REG_SIMULT      (0x6 << 16)
+
 /* Control register 2 */
 
 #define ADC_CR2_ADON_BIT                0
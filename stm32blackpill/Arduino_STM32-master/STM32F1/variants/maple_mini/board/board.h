@@ -79,4 +79,13 @@ enum {
     PA8, PB15, PB14, PB13, PB12, PB8, PB1
 };
 
+// (port << 4) | bit of each pin in the enum, port A being 0. FastPin
+// resolves pins with this at compile time, so keep it in step.
+#define BOARD_GPIO_PORT_BITS \
+    0x1B, 0x1A, 0x12, 0x10, 0x07, 0x06, 0x05, 0x04, \
+    0x03, 0x02, 0x01, 0x00, 0x2F, 0x2E, 0x2D, 0x17, \
+    0x16, 0x15, 0x14, 0x13, 0x0F, 0x0E, 0x0D, 0x0C, \
+    0x0B, 0x0A, 0x09, 0x08, 0x1F, 0x1E, 0x1D, 0x1C, \
+    0x18, 0x11
+
 #endif
@@ -81,4 +81,14 @@ enum {
     PA12, PA11 //FIXME - button pin
 };
 
+// (port << 4) | bit of each PIN_MAP row, port A being 0. FastPin
+// resolves pin numbers with this at compile time, the same way
+// digitalWrite() does, so keep it in step with PIN_MAP. The enum above
+// lacks PB1 and PB8, so PA12 and PA11 index the PB1 and PA12 rows.
+#define BOARD_GPIO_PORT_BITS \
+    0x0A, 0x09, 0x1B, 0x1A, 0x08, 0x0D, 0x0E, 0x0F, \
+    0x13, 0x14, 0x04, 0x07, 0x06, 0x05, 0x00, 0x01, \
+    0x02, 0x03, 0x17, 0x16, 0x10, 0x11, 0x0C, 0x0B, \
+    0x18
+
 #endif
@@ -116,4 +116,14 @@ enum {
     PB2,PB1,PB15,PB14,PB13
 };
 
+// (port << 4) | bit of each pin in the enum, port A being 0. FastPin
+// resolves pins with this at compile time, so keep it in step.
+#define BOARD_GPIO_PORT_BITS \
+    0x03, 0x02, 0x0A, 0x13, 0x15, 0x14, 0x1A, 0x08, \
+    0x09, 0x27, 0x16, 0x07, 0x06, 0x05, 0x19, 0x18, \
+    0x00, 0x01, 0x04, 0x10, 0x21, 0x20, 0x2A, 0x2C, \
+    0x17, 0x2D, 0x2E, 0x2F, 0x22, 0x23, 0x2B, 0x32, \
+    0x29, 0x28, 0x26, 0x25, 0x0C, 0x0B, 0x1C, 0x1B, \
+    0x12, 0x11, 0x1F, 0x1E, 0x1D
+
 #endif
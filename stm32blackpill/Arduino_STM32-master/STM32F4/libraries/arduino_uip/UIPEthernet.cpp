@@ -249,7 +249,12 @@ UIPEthernetClass::tick()
         }
       else
         {
-          if ((long)( now - ((uip_userdata_t*)uip_conn->appstate)->timer) >= 0)
+          // only poll sockets that have something for uip to do: queued
+          // outgoing data, a pending close or a window restart.
+          uip_userdata_t* u = (uip_userdata_t*)uip_conn->appstate;
+          if (u
+              && (u->packets_out[0] != NOBLOCK || (u->state & (UIP_CLIENT_CLOSE | UIP_CLIENT_RESTART)))
+              && (long)( now - u->timer) >= 0)
             uip_process(UIP_POLL_REQUEST);
           else
             continue;
@@ -166,6 +166,19 @@ struct uip_conn *uip_conn;   /* uip_conn always points to the current
 struct uip_conn uip_conns[UIP_CONNS];
                              /* The uip_conns array holds all TCP
 				connections. */
+#if UIP_CONN_HASH_SIZE > 0
+#define UIP_CONN_UNHASHED 0xff
+static u8_t conn_hash_head[UIP_CONN_HASH_SIZE];
+                             /* Index + 1 of the first connection in
+				each hash chain, 0 if the chain is
+				empty. */
+static u8_t conn_hash_next[UIP_CONNS];
+                             /* Index + 1 of the next connection in
+				the same chain, 0 at the end. */
+static u8_t conn_hash_bucket[UIP_CONNS];
+                             /* The chain each connection is linked
+				into, or UIP_CONN_UNHASHED. */
+#endif /* UIP_CONN_HASH_SIZE > 0 */
 u16_t uip_listenports[UIP_LISTENPORTS];
                              /* The uip_listenports list all currently
 				listning ports. */
@@ -375,6 +388,42 @@ uip_udpchksum(void)
 #endif /* UIP_UDP_CHECKSUMS */
 #endif /* UIP_ARCH_CHKSUM */
 /*---------------------------------------------------------------------------*/
+#if UIP_CONN_HASH_SIZE > 0
+static u8_t
+uip_conn_hash(u16_t lport, u16_t rport, u16_t *ripaddr)
+{
+  register u16_t h;
+
+  h = lport ^ rport ^ ripaddr[0] ^ ripaddr[1];
+  h ^= h >> 8;
+  return h & (UIP_CONN_HASH_SIZE - 1);
+}
+/*---------------------------------------------------------------------------*/
+/* (Re)insert a connection into the hash chain selected by its current
+   ports and remote address. Must be called whenever a connection slot
+   is (re)assigned. Closed connections are left linked and filtered out
+   by the lookup, since a slot only changes its 4-tuple when it is
+   reused. */
+static void
+uip_conn_hash_link(struct uip_conn *conn)
+{
+  u8_t idx, b;
+  u8_t *p;
+
+  idx = conn - uip_conns;
+  b = conn_hash_bucket[idx];
+  if(b != UIP_CONN_UNHASHED) {
+    for(p = &conn_hash_head[b]; *p != idx + 1; p = &conn_hash_next[*p - 1]);
+    *p = conn_hash_next[idx];
+  }
+
+  b = uip_conn_hash(conn->lport, conn->rport, (u16_t *)conn->ripaddr);
+  conn_hash_bucket[idx] = b;
+  conn_hash_next[idx] = conn_hash_head[b];
+  conn_hash_head[b] = idx + 1;
+}
+#endif /* UIP_CONN_HASH_SIZE > 0 */
+/*---------------------------------------------------------------------------*/
 void
 uip_init(void)
 {
@@ -384,6 +433,10 @@ uip_init(void)
   for(c = 0; c < UIP_CONNS; ++c) {
     uip_conns[c].tcpstateflags = UIP_CLOSED;
   }
+#if UIP_CONN_HASH_SIZE > 0
+  memset(conn_hash_head, 0, sizeof(conn_hash_head));
+  memset(conn_hash_bucket, UIP_CONN_UNHASHED, sizeof(conn_hash_bucket));
+#endif /* UIP_CONN_HASH_SIZE > 0 */
 #if UIP_ACTIVE_OPEN
   lastport = 1024;
 #endif /* UIP_ACTIVE_OPEN */
@@ -463,6 +516,9 @@ uip_connect(uip_ipaddr_t *ripaddr, u16_t rport)
   conn->lport = htons(lastport);
   conn->rport = rport;
   uip_ipaddr_copy(&conn->ripaddr, ripaddr);
+#if UIP_CONN_HASH_SIZE > 0
+  uip_conn_hash_link(conn);
+#endif /* UIP_CONN_HASH_SIZE > 0 */
   
   return conn;
 }
@@ -1186,8 +1242,15 @@ uip_process(u8_t flag)
   
   /* Demultiplex this segment. */
   /* First check any active connections. */
+#if UIP_CONN_HASH_SIZE > 0
+  for(c = conn_hash_head[uip_conn_hash(BUF->destport, BUF->srcport,
+				       BUF->srcipaddr)];
+      c != 0; c = conn_hash_next[c - 1]) {
+    uip_connr = &uip_conns[c - 1];
+#else /* UIP_CONN_HASH_SIZE > 0 */
   for(uip_connr = &uip_conns[0]; uip_connr <= &uip_conns[UIP_CONNS - 1];
       ++uip_connr) {
+#endif /* UIP_CONN_HASH_SIZE > 0 */
     if(uip_connr->tcpstateflags != UIP_CLOSED &&
        BUF->destport == uip_connr->lport &&
        BUF->srcport == uip_connr->rport &&
@@ -1308,6 +1371,9 @@ uip_process(u8_t flag)
   uip_connr->lport = BUF->destport;
   uip_connr->rport = BUF->srcport;
   uip_ipaddr_copy(uip_connr->ripaddr, BUF->srcipaddr);
+#if UIP_CONN_HASH_SIZE > 0
+  uip_conn_hash_link(uip_connr);
+#endif /* UIP_CONN_HASH_SIZE > 0 */
   uip_connr->tcpstateflags = UIP_SYN_RCVD;
 
   uip_connr->snd_nxt[0] = iss[0];
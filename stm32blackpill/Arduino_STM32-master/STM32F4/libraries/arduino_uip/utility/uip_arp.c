@@ -108,7 +108,24 @@ static const u16_t broadcast_ipaddr[2] = {0xffff,0xffff};
 
 static struct arp_entry arp_table[UIP_ARPTAB_SIZE];
 static u16_t ipaddr[2];
-static u8_t i, c;
+static u8_t i, c, set;
+
+#if UIP_ARPTAB_SIZE % UIP_ARP_WAYS
+#error "UIP_ARPTAB_SIZE must be a multiple of UIP_ARP_WAYS"
+#endif
+
+#define ARP_SETS (UIP_ARPTAB_SIZE / UIP_ARP_WAYS)
+
+/* First table index of the set that the IP address addr maps to. With
+   a single set this is always 0 and the table degenerates to the
+   original fully associative linear scan. */
+#if ARP_SETS > 1
+#define ARP_SET(addr) ((u8_t)((((addr)[0] ^ (addr)[1]) ^		\
+			       (((addr)[0] ^ (addr)[1]) >> 8)) %	\
+			      ARP_SETS) * UIP_ARP_WAYS)
+#else
+#define ARP_SET(addr) 0
+#endif
 
 static u8_t arptime;
 static u8_t tmpage;
@@ -158,10 +175,11 @@ static void
 uip_arp_update(u16_t *ipaddr, struct uip_eth_addr *ethaddr)
 {
   register struct arp_entry *tabptr;
-  /* Walk through the ARP mapping table and try to find an entry to
-     update. If none is found, the IP -> MAC address mapping is
-     inserted in the ARP table. */
-  for(i = 0; i < UIP_ARPTAB_SIZE; ++i) {
+  /* Walk through the set of the ARP mapping table that ipaddr hashes
+     to and try to find an entry to update. If none is found, the IP ->
+     MAC address mapping is inserted into that set. */
+  set = ARP_SET(ipaddr);
+  for(i = set; i < set + UIP_ARP_WAYS; ++i) {
 
     tabptr = &arp_table[i];
     /* Only check those entries that are actually in use. */
@@ -185,8 +203,8 @@ uip_arp_update(u16_t *ipaddr, struct uip_eth_addr *ethaddr)
   /* If we get here, no existing ARP table entry was found, so we
      create one. */
 
-  /* First, we try to find an unused entry in the ARP table. */
-  for(i = 0; i < UIP_ARPTAB_SIZE; ++i) {
+  /* First, we try to find an unused entry in the set. */
+  for(i = set; i < set + UIP_ARP_WAYS; ++i) {
     tabptr = &arp_table[i];
     if(tabptr->ipaddr[0] == 0 &&
        tabptr->ipaddr[1] == 0) {
@@ -194,12 +212,12 @@ uip_arp_update(u16_t *ipaddr, struct uip_eth_addr *ethaddr)
     }
   }
 
-  /* If no unused entry is found, we try to find the oldest entry and
-     throw it away. */
-  if(i == UIP_ARPTAB_SIZE) {
+  /* If no unused entry is found, we try to find the oldest entry in
+     the set and throw it away. */
+  if(i == set + UIP_ARP_WAYS) {
     tmpage = 0;
-    c = 0;
-    for(i = 0; i < UIP_ARPTAB_SIZE; ++i) {
+    c = set;
+    for(i = set; i < set + UIP_ARP_WAYS; ++i) {
       tabptr = &arp_table[i];
       if(arptime - tabptr->time > tmpage) {
 	tmpage = arptime - tabptr->time;
@@ -377,14 +395,15 @@ uip_arp_out(void)
       uip_ipaddr_copy(ipaddr, IPBUF->destipaddr);
     }
       
-    for(i = 0; i < UIP_ARPTAB_SIZE; ++i) {
+    set = ARP_SET(ipaddr);
+    for(i = set; i < set + UIP_ARP_WAYS; ++i) {
       tabptr = &arp_table[i];
       if(uip_ipaddr_cmp(ipaddr, tabptr->ipaddr)) {
 	break;
       }
     }
 
-    if(i == UIP_ARPTAB_SIZE) {
+    if(i == set + UIP_ARP_WAYS) {
       /* The destination address was not in our ARP table, so we
 	 overwrite the IP packet with an ARP request. */
 
@@ -5,6 +5,15 @@
 #define UIP_SOCKET_NUMPACKETS    5
 #define UIP_CONF_MAX_CONNECTIONS 4
 
+/* number of buckets (power of two) in the TCP connection hash table.
+ * set to 0 to demultiplex incoming segments by linear scan (saves some flash) */
+#define UIP_CONF_CONN_HASH_SIZE  8
+
+/* ARP cache: total entries and entries per hash set.
+ * set UIP_CONF_ARP_WAYS equal to UIP_CONF_ARPTAB_SIZE for a plain linear cache */
+#define UIP_CONF_ARPTAB_SIZE     8
+#define UIP_CONF_ARP_WAYS        2
+
 /* for UDP
  * set UIP_CONF_UDP to 0 to disable UDP (saves aprox. 5kb flash) */
 #define UIP_CONF_UDP             1
@@ -247,6 +247,22 @@
 #define UIP_CONNS UIP_CONF_MAX_CONNECTIONS
 #endif /* UIP_CONF_MAX_CONNECTIONS */
 
+/**
+ * The number of buckets in the TCP connection hash table.
+ *
+ * Incoming segments are demultiplexed by hashing their (local port,
+ * remote port, remote address) tuple into this table instead of
+ * scanning all UIP_CONNS connections. Must be a power of two; set to
+ * 0 to fall back to the plain linear scan.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_CONN_HASH_SIZE
+#define UIP_CONN_HASH_SIZE UIP_CONF_CONN_HASH_SIZE
+#else /* UIP_CONF_CONN_HASH_SIZE */
+#define UIP_CONN_HASH_SIZE 0
+#endif /* UIP_CONF_CONN_HASH_SIZE */
+
 
 /**
  * The maximum number of simultaneously listening TCP ports.
@@ -353,6 +369,23 @@
 #define UIP_ARPTAB_SIZE 8
 #endif
 
+/**
+ * The associativity of the ARP table.
+ *
+ * The table is split into UIP_ARPTAB_SIZE / UIP_ARP_WAYS sets and an
+ * IP address is only ever looked up in, inserted into and evicted
+ * from the set its hash selects. The default of UIP_ARPTAB_SIZE gives
+ * a single fully associative set (plain linear scan). UIP_ARPTAB_SIZE
+ * must be a multiple of UIP_ARP_WAYS.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_ARP_WAYS
+#define UIP_ARP_WAYS UIP_CONF_ARP_WAYS
+#else
+#define UIP_ARP_WAYS UIP_ARPTAB_SIZE
+#endif
+
 /**
  * The maxium age of ARP table entries measured in 10ths of seconds.
  *
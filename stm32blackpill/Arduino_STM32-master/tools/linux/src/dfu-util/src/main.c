@@ -196,6 +196,13 @@ static void help(void)
 		"  -s --dfuse-address <address>\tST DfuSe mode, specify target address for\n"
 		"\t\t\t\traw file download or upload. Not applicable for\n"
 		"\t\t\t\tDfuSe file (.dfu) downloads\n"
+		"  -C --compare\t\t\tRead the device back before downloading and\n"
+		"\t\t\t\tskip what it already holds: the whole image\n"
+		"\t\t\t\t(DFU) or unchanged pages (DfuSe)\n"
+		"  -w --max-poll-wait <ms>\tUNSAFE, opt-in: poll a busy device again\n"
+		"\t\t\t\tafter at most <ms> instead of its full\n"
+		"\t\t\t\tbwPollTimeout. Breaks the DFU spec; only for\n"
+		"\t\t\t\tdevices known to answer GETSTATUS while busy\n"
 		);
 	exit(EX_USAGE);
 }
@@ -231,6 +238,8 @@ static struct option opts[] = {
 	{ "download", 1, 0, 'D' },
 	{ "reset", 0, 0, 'R' },
 	{ "dfuse-address", 1, 0, 's' },
+	{ "compare", 0, 0, 'C' },
+	{ "max-poll-wait", 1, 0, 'w' },
 	{ 0, 0, 0, 0 }
 };
 
@@ -259,7 +268,7 @@ int main(int argc, char **argv)
 
 	while (1) {
 		int c, option_index = 0;
-		c = getopt_long(argc, argv, "hVvleE:d:p:c:i:a:S:t:U:D:Rs:Z:", opts,
+		c = getopt_long(argc, argv, "hVvleE:d:p:c:i:a:S:t:U:D:Rs:Z:Cw:", opts,
 				&option_index);
 		if (c == -1)
 			break;
@@ -335,6 +344,12 @@ int main(int argc, char **argv)
 		case 's':
 			dfuse_options = optarg;
 			break;
+		case 'C':
+			dfu_compare = 1;
+			break;
+		case 'w':
+			dfu_poll_cap = atoi(optarg);
+			break;
 		default:
 			help();
 			break;
@@ -90,6 +90,59 @@ out_free:
 	return ret;
 }
 
+/*
+ * Reads the device back and compares it with the image to download.
+ * Returns 1 if the device already holds the whole image, 0 if not.
+ * The device is left in dfuIDLE.
+ */
+static int dfuload_compare(struct dfu_if *dif, int xfer_size,
+    struct dfu_file *file)
+{
+	int total_bytes = 0;
+	int expected_size;
+	unsigned short transaction = 0;
+	unsigned char *buf;
+	unsigned long start;
+	int match = 1;
+
+	expected_size = file->size.total - file->size.suffix;
+	buf = dfu_malloc(xfer_size);
+	start = dfu_milli_time();
+
+	while (match && total_bytes < expected_size) {
+		int rc;
+		int chunk_size;
+
+		rc = dfu_upload(dif->dev_handle, dif->interface,
+		    xfer_size, transaction++, buf);
+		if (rc < 0) {
+			warnx("Error during compare upload");
+			match = 0;
+			break;
+		}
+		chunk_size = expected_size - total_bytes;
+		if (rc < chunk_size)
+			chunk_size = rc;
+		if (memcmp(buf, file->firmware + total_bytes, chunk_size))
+			match = 0;
+		total_bytes += chunk_size;
+
+		if (rc < xfer_size)
+			/* device ended the upload */
+			break;
+	}
+	if (total_bytes < expected_size)
+		match = 0;
+
+	free(buf);
+	dfu_timing.compare += dfu_milli_time() - start;
+
+	/* Leave the upload, whether it ended or not */
+	dfu_abort_to_idle(dif);
+
+	return match;
+}
+
 int dfuload_do_dnload(struct dfu_if *dif, int xfer_size, struct dfu_file *file)
 {
 	int bytes_sent;
@@ -105,6 +158,18 @@ int dfuload_do_dnload(struct dfu_if *dif, int xfer_size, struct dfu_file *file)
 	expected_size = file->size.total - file->size.suffix;
 	bytes_sent = 0;
 
+	/* DFU downloads are sequential, so only an unchanged image as a
+	 * whole can be skipped */
+	if (dfu_compare && !(dif->func_dfu.bmAttributes & USB_DFU_CAN_UPLOAD)) {
+		warnx("Device cannot upload, not comparing");
+	} else if (dfu_compare && dfuload_compare(dif, xfer_size, file)) {
+		printf("Device already holds this image, download skipped\n");
+		dfu_timing.skipped = expected_size;
+		if (verbose)
+			dfu_print_timing();
+		return expected_size;
+	}
+
 	dfu_progress_bar("Download", 0, 1);
 	while (bytes_sent < expected_size) {
 		int bytes_left;
@@ -137,7 +202,7 @@ int dfuload_do_dnload(struct dfu_if *dif, int xfer_size, struct dfu_file *file)
 				break;
 
 			/* Wait while device executes flashing */
-			milli_sleep(dst.bwPollTimeout);
+			dfu_poll_wait(&dst);
 
 		} while (1);
 		if (dst.bStatus != DFU_STATUS_OK) {
@@ -161,8 +226,10 @@ int dfuload_do_dnload(struct dfu_if *dif, int xfer_size, struct dfu_file *file)
 
 	dfu_progress_bar("Download", bytes_sent, bytes_sent);
 
-	if (verbose)
+	if (verbose) {
 		printf("Sent a total of %i bytes\n", bytes_sent);
+		dfu_print_timing();
+	}
 
 get_status:
 	/* Transition to MANIFEST_SYNC state */
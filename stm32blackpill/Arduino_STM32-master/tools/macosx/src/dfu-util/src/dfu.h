@@ -83,6 +83,20 @@ struct dfu_status {
     unsigned char iString;
 };
 
+/* Time spent per download phase, in ms, reported with -v */
+struct dfu_timing {
+    unsigned long dnload;       /* DFU_DNLOAD requests */
+    unsigned long getstatus;    /* DFU_GETSTATUS requests */
+    unsigned long poll_wait;    /* sleeping for bwPollTimeout */
+    unsigned long erase;        /* DfuSe page erases, including their polling */
+    unsigned long compare;      /* read-back of the data already flashed */
+    unsigned int skipped;       /* bytes not rewritten since they matched */
+};
+
+extern struct dfu_timing dfu_timing;
+extern unsigned int dfu_poll_cap;
+extern int dfu_compare;
+
 struct dfu_if {
     struct usb_dfu_func_descriptor func_dfu;
     uint16_t quirks;
@@ -125,6 +139,9 @@ int dfu_get_state( libusb_device_handle *device,
 int dfu_abort( libusb_device_handle *device,
                const unsigned short interface );
 int dfu_abort_to_idle( struct dfu_if *dif);
+void dfu_poll_wait( const struct dfu_status *status );
+unsigned long dfu_milli_time( void );
+void dfu_print_timing( void );
 
 const char *dfu_state_to_string( int state );
 
@@ -30,8 +30,22 @@
 #include "dfu.h"
 #include "quirks.h"
 
+#ifdef HAVE_WINDOWS_H
+# include <windows.h>
+#endif
+
 static int dfu_timeout = 5000;  /* 5 seconds - default */
 
+struct dfu_timing dfu_timing;
+
+/* Upper bound in ms for a single wait between DFU_GETSTATUS requests,
+ * 0 to always honour bwPollTimeout (set with -w) */
+unsigned int dfu_poll_cap = 0;
+
+/* Read the device back before a download and leave data that already
+ * matches alone (set with -C) */
+int dfu_compare = 0;
+
 /*
  *  DFU_DETACH Request (DFU Spec 1.0, Section 5.1)
  *
@@ -75,7 +89,9 @@ int dfu_download( libusb_device_handle *device,
                   unsigned char* data )
 {
     int status;
+    unsigned long start;
 
+    start = dfu_milli_time();
     status = libusb_control_transfer( device,
           /* bmRequestType */ LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_CLASS | LIBUSB_RECIPIENT_INTERFACE,
           /* bRequest      */ DFU_DNLOAD,
@@ -84,6 +100,7 @@ int dfu_download( libusb_device_handle *device,
           /* Data          */ data,
           /* wLength       */ length,
                               dfu_timeout );
+    dfu_timing.dnload += dfu_milli_time() - start;
     return status;
 }
 
@@ -132,6 +149,7 @@ int dfu_get_status( struct dfu_if *dif, struct dfu_status *status )
 {
     unsigned char buffer[6];
     int result;
+    unsigned long start;
 
     /* Initialize the status data structure */
     status->bStatus       = DFU_STATUS_ERROR_UNKNOWN;
@@ -139,6 +157,7 @@ int dfu_get_status( struct dfu_if *dif, struct dfu_status *status )
     status->bState        = STATE_DFU_ERROR;
     status->iString       = 0;
 
+    start = dfu_milli_time();
     result = libusb_control_transfer( dif->dev_handle,
           /* bmRequestType */ LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_CLASS | LIBUSB_RECIPIENT_INTERFACE,
           /* bRequest      */ DFU_GETSTATUS,
@@ -147,6 +166,7 @@ int dfu_get_status( struct dfu_if *dif, struct dfu_status *status )
           /* Data          */ buffer,
           /* wLength       */ 6,
                               dfu_timeout );
+    dfu_timing.getstatus += dfu_milli_time() - start;
 
     if( 6 == result ) {
         status->bStatus = buffer[0];
@@ -355,3 +375,47 @@ int dfu_abort_to_idle(struct dfu_if *dif)
 	milli_sleep(dst.bwPollTimeout);
 	return ret;
 }
+
+/*
+ * Wait before issuing the next DFU_GETSTATUS while the device is busy.
+ *
+ * Devices tend to report a worst-case bwPollTimeout (a full sector
+ * erase) for every operation. With a poll cap the wait is clipped to
+ * dfu_poll_cap ms, so the device is polled again shortly and the
+ * actual completion time is picked up instead of the advertised one.
+ */
+void dfu_poll_wait(const struct dfu_status *status)
+{
+	unsigned int msec = status->bwPollTimeout;
+	unsigned long start;
+
+	if (dfu_poll_cap && msec > dfu_poll_cap)
+		msec = dfu_poll_cap;
+	start = dfu_milli_time();
+	milli_sleep(msec);
+	dfu_timing.poll_wait += dfu_milli_time() - start;
+}
+
+/* Monotonic millisecond clock used for the phase timing */
+unsigned long dfu_milli_time(void)
+{
+#ifdef HAVE_WINDOWS_H
+	return GetTickCount();
+#else
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000UL + now.tv_nsec / 1000000;
+#endif
+}
+
+void dfu_print_timing(void)
+{
+	printf("Timing: DNLOAD %lu ms, GETSTATUS %lu ms, poll wait %lu ms",
+	       dfu_timing.dnload, dfu_timing.getstatus, dfu_timing.poll_wait);
+	if (dfu_timing.erase || dfu_timing.compare || dfu_timing.skipped)
+		printf(", erase %lu ms, compare %lu ms, %u bytes unchanged",
+		       dfu_timing.erase, dfu_timing.compare,
+		       dfu_timing.skipped);
+	printf("\n");
+}
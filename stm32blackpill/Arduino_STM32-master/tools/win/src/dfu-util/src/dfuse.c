@@ -45,6 +45,7 @@ static int dfuse_force = 0;
 static int dfuse_leave = 0;
 static int dfuse_unprotect = 0;
 static int dfuse_mass_erase = 0;
+static int dfuse_compare = 0;
 
 unsigned int quad2uint(unsigned char *p)
 {
@@ -101,6 +102,11 @@ void dfuse_parse_options(const char *options)
 			options += 10;
 			continue;
 		}
+		if (!strncmp(options, "compare", endword - options)) {
+			dfuse_compare = 1;
+			options += 7;
+			continue;
+		}
 
 		/* any valid number is interpreted as upload length */
 		number = strtoul(options, &end, 0);
@@ -141,7 +147,9 @@ int dfuse_download(struct dfu_if *dif, const unsigned short length,
 		   unsigned char *data, unsigned short transaction)
 {
 	int status;
+	unsigned long start;
 
+	start = dfu_milli_time();
 	status = libusb_control_transfer(dif->dev_handle,
 		 /* bmRequestType */	 LIBUSB_ENDPOINT_OUT |
 					 LIBUSB_REQUEST_TYPE_CLASS |
@@ -152,6 +160,7 @@ int dfuse_download(struct dfu_if *dif, const unsigned short length,
 		 /* Data          */	 data,
 		 /* wLength       */	 length,
 					 DFU_TIMEOUT);
+	dfu_timing.dnload += dfu_milli_time() - start;
 	if (status < 0) {
 		errx(EX_IOERR, "%s: libusb_control_transfer returned %d",
 			__FUNCTION__, status);
@@ -171,6 +180,7 @@ int dfuse_special_command(struct dfu_if *dif, unsigned int address,
 	int ret;
 	struct dfu_status dst;
 	int firstpoll = 1;
+	unsigned long start = dfu_milli_time();
 
 	if (command == ERASE_PAGE) {
 		struct memsegment *segment;
@@ -230,18 +240,25 @@ int dfuse_special_command(struct dfu_if *dif, unsigned int address,
 				     dfuse_command_name[command]);
 			}
 		}
-		/* wait while command is executed */
-		if (verbose)
-			printf("   Poll timeout %i ms\n", dst.bwPollTimeout);
-		milli_sleep(dst.bwPollTimeout);
-		if (command == READ_UNPROTECT)
+		if (command == READ_UNPROTECT) {
+			milli_sleep(dst.bwPollTimeout);
 			return ret;
+		}
+		/* wait while command is executed */
+		if (dst.bState == DFU_STATE_dfuDNBUSY) {
+			if (verbose)
+				printf("   Poll timeout %i ms\n",
+				       dst.bwPollTimeout);
+			dfu_poll_wait(&dst);
+		}
 	} while (dst.bState == DFU_STATE_dfuDNBUSY);
 
 	if (dst.bStatus != DFU_STATUS_OK) {
 		errx(EX_IOERR, "%s not correctly executed",
 			dfuse_command_name[command]);
 	}
+	if (command == ERASE_PAGE)
+		dfu_timing.erase += dfu_milli_time() - start;
 	return ret;
 }
 
@@ -265,7 +282,10 @@ int dfuse_dnload_chunk(struct dfu_if *dif, unsigned char *data, int size,
 			errx(EX_IOERR, "Error during download get_status");
 			return ret;
 		}
-		milli_sleep(dst.bwPollTimeout);
+		/* no need to wait once the device reports it is done */
+		if (dst.bState != DFU_STATE_dfuDNLOAD_IDLE &&
+		    dst.bState != DFU_STATE_dfuERROR)
+			dfu_poll_wait(&dst);
 	} while (dst.bState != DFU_STATE_dfuDNLOAD_IDLE &&
 		 dst.bState != DFU_STATE_dfuERROR &&
 		 dst.bState != DFU_STATE_dfuMANIFEST);
@@ -369,6 +389,48 @@ int dfuse_do_upload(struct dfu_if *dif, int xfer_size, int fd,
 	return ret;
 }
 
+/* Reads back len bytes at address and compares them with data */
+/* returns 1 if the device memory already holds exactly this data */
+static int dfuse_region_matches(struct dfu_if *dif, unsigned int address,
+				unsigned char *data, int len, int xfer_size)
+{
+	unsigned char *buf;
+	unsigned long start;
+	int transaction = 2;
+	int done = 0;
+	int match = 1;
+
+	start = dfu_milli_time();
+	buf = dfu_malloc(xfer_size);
+
+	dfuse_special_command(dif, address, SET_ADDRESS);
+	dfu_abort_to_idle(dif);
+	while (done < len) {
+		int chunk_size = xfer_size;
+
+		if (len - done < xfer_size) {
+			/* restart block numbering for the short tail, so
+			 * its address does not depend on the request size */
+			chunk_size = len - done;
+			dfuse_special_command(dif, address + done,
+					      SET_ADDRESS);
+			dfu_abort_to_idle(dif);
+			transaction = 2;
+		}
+		if (dfuse_upload(dif, chunk_size, buf, transaction++) !=
+		    chunk_size || memcmp(buf, data + done, chunk_size)) {
+			match = 0;
+			break;
+		}
+		done += chunk_size;
+	}
+	dfu_abort_to_idle(dif);
+
+	free(buf);
+	dfu_timing.compare += dfu_milli_time() - start;
+	return match;
+}
+
 /* Writes an element of any size to the device, taking care of page erases */
 /* returns 0 on success, otherwise -EINVAL */
 int dfuse_dnload_element(struct dfu_if *dif, unsigned int dwElementAddress,
@@ -377,7 +439,10 @@ int dfuse_dnload_element(struct dfu_if *dif, unsigned int dwElementAddress,
 {
 	int p;
 	int ret;
+	int chunk_size;
 	struct memsegment *segment;
+	unsigned int compared_page = 1; /* non-aligned value, won't match */
+	int page_matches = 0;
 
 	/* Check at least that we can write to the last address */
 	segment =
@@ -389,11 +454,12 @@ int dfuse_dnload_element(struct dfu_if *dif, unsigned int dwElementAddress,
 
 	dfu_progress_bar("Download", 0, 1);
 
-	for (p = 0; p < (int)dwElementSize; p += xfer_size) {
+	for (p = 0; p < (int)dwElementSize; p += chunk_size) {
 		int page_size;
 		unsigned int erase_address;
 		unsigned int address = dwElementAddress + p;
-		int chunk_size = xfer_size;
+
+		chunk_size = xfer_size;
 
 		segment = find_segment(mem_layout, address);
 		if (!segment || !(segment->memtype & DFUSE_WRITEABLE)) {
@@ -406,6 +472,35 @@ int dfuse_dnload_element(struct dfu_if *dif, unsigned int dwElementAddress,
 		if (p + chunk_size > (int)dwElementSize)
 			chunk_size = dwElementSize - p;
 
+		/* In compare mode each page is read back first and left
+		 * alone (no erase, no write) if it already holds the image
+		 * data. Chunks are kept within one page so that the skip
+		 * decision covers whole pages. */
+		if ((dfuse_compare || dfu_compare) &&
+		    (segment->memtype & DFUSE_READABLE) &&
+		    (segment->memtype & DFUSE_ERASABLE) && !dfuse_mass_erase) {
+			unsigned int page = address & ~(page_size - 1);
+
+			if (address + chunk_size > page + page_size)
+				chunk_size = page + page_size - address;
+			if (page != compared_page) {
+				int len = page + page_size - address;
+
+				if (p + len > (int)dwElementSize)
+					len = dwElementSize - p;
+				compared_page = page;
+				page_matches = dfuse_region_matches(dif,
+				    address, data + p, len, xfer_size);
+				if (verbose > 1 && page_matches)
+					printf(" Page at 0x%08x unchanged, "
+					       "skipping\n", page);
+			}
+			if (page_matches) {
+				dfu_timing.skipped += chunk_size;
+				continue;
+			}
+		}
+
 		/* Erase only for flash memory downloads */
 		if ((segment->memtype & DFUSE_ERASABLE) && !dfuse_mass_erase) {
 			/* erase all involved pages */
@@ -450,6 +545,8 @@ int dfuse_dnload_element(struct dfu_if *dif, unsigned int dwElementAddress,
 	}
 	if (!verbose)
 		dfu_progress_bar("Download", dwElementSize, dwElementSize);
+	else
+		dfu_print_timing();
 	return 0;
 }
 
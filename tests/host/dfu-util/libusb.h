@@ -0,0 +1,43 @@
+/*
+ * Just enough of libusb-1.0 for dfu.c, dfu_load.c and dfuse.c to build
+ * against the emulated device in test_dfu.c.
+ */
+
+#ifndef FAKE_LIBUSB_H
+#define FAKE_LIBUSB_H
+
+#include <stdint.h>
+
+typedef struct libusb_device libusb_device;
+typedef struct libusb_device_handle libusb_device_handle;
+typedef struct libusb_context libusb_context;
+
+enum libusb_endpoint_direction {
+	LIBUSB_ENDPOINT_IN = 0x80,
+	LIBUSB_ENDPOINT_OUT = 0x00
+};
+
+enum libusb_request_type {
+	LIBUSB_REQUEST_TYPE_STANDARD = (0x00 << 5),
+	LIBUSB_REQUEST_TYPE_CLASS = (0x01 << 5),
+	LIBUSB_REQUEST_TYPE_VENDOR = (0x02 << 5)
+};
+
+enum libusb_request_recipient {
+	LIBUSB_RECIPIENT_DEVICE = 0x00,
+	LIBUSB_RECIPIENT_INTERFACE = 0x01
+};
+
+enum libusb_error {
+	LIBUSB_SUCCESS = 0,
+	LIBUSB_ERROR_IO = -1,
+	LIBUSB_ERROR_NOT_FOUND = -5,
+	LIBUSB_ERROR_PIPE = -9
+};
+
+int libusb_control_transfer(libusb_device_handle *dev_handle,
+	uint8_t request_type, uint8_t bRequest, uint16_t wValue,
+	uint16_t wIndex, unsigned char *data, uint16_t wLength,
+	unsigned int timeout);
+
+#endif /* FAKE_LIBUSB_H */
@@ -0,0 +1,370 @@
+/*
+ * Emulated DFU and DfuSe devices for dfu-util's download paths.
+ *
+ * libusb_control_transfer() is answered by a model of a flash device:
+ * a Maple style plain DFU bootloader that writes blocks one after the
+ * other from the start of flash, or an ST DfuSe bootloader with address
+ * pointer, page erase and readout. Flash bits can only be cleared by a
+ * write, so writing a page that was not erased first is caught.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libusb.h>
+
+#include "portable.h"
+#include "dfu.h"
+#include "usb_dfu.h"
+#include "dfu_file.h"
+#include "dfu_load.h"
+#include "dfuse.h"
+
+int verbose = 0;
+
+#define FLASH_BASE	0x08000000
+#define FLASH_SIZE	(16 * 1024)
+#define PAGE_SIZE	1024
+#define XFER_SIZE	1024
+
+enum dev_kind { DEV_MAPLE, DEV_DFUSE };
+
+static struct {
+	enum dev_kind kind;
+	int can_upload;
+	uint8_t flash[FLASH_SIZE];
+	uint8_t state;
+	uint8_t status;
+	/* DNLOAD waiting for the GETSTATUS that runs it */
+	uint8_t pending[XFER_SIZE];
+	int pending_len;
+	int pending_block;
+	/* Maple: next write offset; DfuSe: address pointer */
+	unsigned int pointer;
+	int page_erased[FLASH_SIZE / PAGE_SIZE];
+	/* counters checked by the tests */
+	int erases;
+	int writes;
+	int uploads;
+	int bad_writes;
+} dev;
+
+static void dev_reset(enum dev_kind kind)
+{
+	memset(&dev, 0, sizeof(dev));
+	dev.kind = kind;
+	dev.can_upload = 1;
+	memset(dev.flash, 0xff, sizeof(dev.flash));
+	dev.state = DFU_STATE_dfuIDLE;
+}
+
+static void dev_clear_counters(void)
+{
+	dev.erases = dev.writes = dev.uploads = dev.bad_writes = 0;
+	memset(dev.page_erased, 0, sizeof(dev.page_erased));
+}
+
+static void flash_erase(unsigned int offset)
+{
+	unsigned int page = offset / PAGE_SIZE;
+
+	memset(dev.flash + page * PAGE_SIZE, 0xff, PAGE_SIZE);
+	dev.page_erased[page] = 1;
+	dev.erases++;
+}
+
+static void flash_write(unsigned int offset, const uint8_t *data, int len)
+{
+	int i;
+
+	if (offset + len > FLASH_SIZE) {
+		dev.status = DFU_STATUS_errADDRESS;
+		return;
+	}
+	for (i = 0; i < len; i++) {
+		if ((dev.flash[offset + i] & data[i]) != data[i])
+			dev.bad_writes++;
+		dev.flash[offset + i] &= data[i];
+	}
+	dev.writes++;
+}
+
+/* Runs the DNLOAD that the first GETSTATUS after it picks up */
+static void dev_execute(void)
+{
+	if (dev.kind == DEV_MAPLE) {
+		unsigned int off = dev.pointer;
+		unsigned int end = off + dev.pending_len;
+
+		/* the bootloader erases each page when it first reaches it */
+		for (; off < end; off = (off / PAGE_SIZE + 1) * PAGE_SIZE)
+			if (!dev.page_erased[off / PAGE_SIZE])
+				flash_erase(off);
+		flash_write(dev.pointer, dev.pending, dev.pending_len);
+		dev.pointer += dev.pending_len;
+		return;
+	}
+
+	if (dev.pending_block == 0) {
+		uint8_t cmd = dev.pending[0];
+		unsigned int addr = dev.pending[1] | dev.pending[2] << 8 |
+		    dev.pending[3] << 16 | (unsigned int)dev.pending[4] << 24;
+
+		if (cmd == 0x21 && dev.pending_len == 5) {
+			dev.pointer = addr;
+		} else if (cmd == 0x41 && dev.pending_len == 5) {
+			if (addr < FLASH_BASE || addr >= FLASH_BASE + FLASH_SIZE)
+				dev.status = DFU_STATUS_errADDRESS;
+			else
+				flash_erase(addr - FLASH_BASE);
+		} else {
+			dev.status = DFU_STATUS_errUNKNOWN;
+		}
+		return;
+	}
+	flash_write(dev.pointer - FLASH_BASE +
+		    (dev.pending_block - 2) * XFER_SIZE,
+		    dev.pending, dev.pending_len);
+}
+
+static int dev_upload(uint16_t block, unsigned char *data, uint16_t len)
+{
+	unsigned int off;
+	int n;
+
+	if (dev.state != DFU_STATE_dfuIDLE &&
+	    dev.state != DFU_STATE_dfuUPLOAD_IDLE)
+		return LIBUSB_ERROR_PIPE;
+	dev.uploads++;
+
+	if (dev.kind == DEV_MAPLE)
+		off = block * len;
+	else if (block >= 2)
+		off = dev.pointer - FLASH_BASE + (block - 2) * XFER_SIZE;
+	else
+		return LIBUSB_ERROR_PIPE;
+
+	n = off < FLASH_SIZE ? FLASH_SIZE - off : 0;
+	if (n > len)
+		n = len;
+	memcpy(data, dev.flash + off, n);
+	dev.state = n < len ? DFU_STATE_dfuIDLE : DFU_STATE_dfuUPLOAD_IDLE;
+	return n;
+}
+
+int libusb_control_transfer(libusb_device_handle *dev_handle,
+	uint8_t request_type, uint8_t bRequest, uint16_t wValue,
+	uint16_t wIndex, unsigned char *data, uint16_t wLength,
+	unsigned int timeout)
+{
+	(void)dev_handle; (void)request_type; (void)wIndex; (void)timeout;
+
+	switch (bRequest) {
+	case DFU_DNLOAD:
+		if (dev.state != DFU_STATE_dfuIDLE &&
+		    dev.state != DFU_STATE_dfuDNLOAD_IDLE)
+			return LIBUSB_ERROR_PIPE;
+		if (wLength == 0) {
+			dev.state = DFU_STATE_dfuMANIFEST_SYNC;
+			return 0;
+		}
+		memcpy(dev.pending, data, wLength);
+		dev.pending_len = wLength;
+		dev.pending_block = wValue;
+		dev.state = DFU_STATE_dfuDNLOAD_SYNC;
+		return wLength;
+
+	case DFU_UPLOAD:
+		if (!dev.can_upload)
+			return LIBUSB_ERROR_PIPE;
+		return dev_upload(wValue, data, wLength);
+
+	case DFU_GETSTATUS:
+		if (dev.state == DFU_STATE_dfuDNLOAD_SYNC) {
+			dev_execute();
+			dev.state = DFU_STATE_dfuDNBUSY;
+		} else if (dev.state == DFU_STATE_dfuDNBUSY) {
+			dev.state = dev.status == DFU_STATUS_OK ?
+			    DFU_STATE_dfuDNLOAD_IDLE : DFU_STATE_dfuERROR;
+		} else if (dev.state == DFU_STATE_dfuMANIFEST_SYNC) {
+			dev.state = DFU_STATE_dfuIDLE;
+		}
+		data[0] = dev.status;
+		/* 1 ms poll timeout, busy only once per request */
+		data[1] = dev.state == DFU_STATE_dfuDNBUSY ? 1 : 0;
+		data[2] = 0;
+		data[3] = 0;
+		data[4] = dev.state;
+		data[5] = 0;
+		return 6;
+
+	case DFU_CLRSTATUS:
+		dev.status = DFU_STATUS_OK;
+		dev.state = DFU_STATE_dfuIDLE;
+		return 0;
+
+	case DFU_GETSTATE:
+		data[0] = dev.state;
+		return 1;
+
+	case DFU_ABORT:
+		if (dev.state == DFU_STATE_dfuERROR)
+			return LIBUSB_ERROR_PIPE;
+		dev.state = DFU_STATE_dfuIDLE;
+		return 0;
+	}
+	return LIBUSB_ERROR_PIPE;
+}
+
+static int failures;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: check failed: %s\n", \
+			__FILE__, __LINE__, #cond); \
+		failures++; \
+	} } while (0)
+
+static struct dfu_if dif;
+static char dfuse_alt_name[] = "@Internal Flash  /0x08000000/16*001Kg";
+
+static void setup_if(enum dev_kind kind)
+{
+	dev_reset(kind);
+	memset(&dif, 0, sizeof(dif));
+	dif.func_dfu.bmAttributes = USB_DFU_CAN_DOWNLOAD | USB_DFU_CAN_UPLOAD;
+	dif.func_dfu.wTransferSize = XFER_SIZE;
+	if (kind == DEV_DFUSE) {
+		dif.func_dfu.bcdDFUVersion = 0x11a;
+		dif.alt_name = dfuse_alt_name;
+	}
+}
+
+static void make_image(struct dfu_file *file, uint8_t *image, int size)
+{
+	int i;
+
+	for (i = 0; i < size; i++)
+		image[i] = (uint8_t)(i * 7 + (i >> 8));
+	memset(file, 0, sizeof(*file));
+	file->firmware = image;
+	file->size.total = size;
+	file->bcdDFU = 0x100;
+}
+
+static void test_maple(void)
+{
+	static uint8_t image[5 * XFER_SIZE + 100];
+	struct dfu_file file;
+
+	setup_if(DEV_MAPLE);
+	make_image(&file, image, sizeof(image));
+
+	/* empty device, compare finds a difference and downloads */
+	dfu_compare = 1;
+	CHECK(dfuload_do_dnload(&dif, XFER_SIZE, &file) == (int)sizeof(image));
+	CHECK(memcmp(dev.flash, image, sizeof(image)) == 0);
+	CHECK(dev.writes == 6);
+	CHECK(dev.uploads == 1);
+	CHECK(dev.bad_writes == 0);
+	CHECK(dev.state == DFU_STATE_dfuIDLE);
+
+	/* same image again: read back, nothing written */
+	dev.pointer = 0;
+	dev_clear_counters();
+	memset(&dfu_timing, 0, sizeof(dfu_timing));
+	CHECK(dfuload_do_dnload(&dif, XFER_SIZE, &file) == (int)sizeof(image));
+	CHECK(dev.writes == 0);
+	CHECK(dev.erases == 0);
+	CHECK(dev.uploads == 6);
+	CHECK(dfu_timing.skipped == sizeof(image));
+	CHECK(dev.state == DFU_STATE_dfuIDLE);
+
+	/* one byte changed in the last block: full download */
+	image[sizeof(image) - 1] ^= 0x55;
+	dev.pointer = 0;
+	dev_clear_counters();
+	CHECK(dfuload_do_dnload(&dif, XFER_SIZE, &file) == (int)sizeof(image));
+	CHECK(memcmp(dev.flash, image, sizeof(image)) == 0);
+	CHECK(dev.writes == 6);
+	CHECK(dev.bad_writes == 0);
+
+	/* a device that cannot upload is written without comparing */
+	dif.func_dfu.bmAttributes = USB_DFU_CAN_DOWNLOAD;
+	dev.can_upload = 0;
+	dev.pointer = 0;
+	dev_clear_counters();
+	CHECK(dfuload_do_dnload(&dif, XFER_SIZE, &file) == (int)sizeof(image));
+	CHECK(dev.uploads == 0);
+	CHECK(dev.writes == 6);
+
+	/* without -C nothing is read back */
+	dif.func_dfu.bmAttributes |= USB_DFU_CAN_UPLOAD;
+	dev.can_upload = 1;
+	dfu_compare = 0;
+	dev.pointer = 0;
+	dev_clear_counters();
+	CHECK(dfuload_do_dnload(&dif, XFER_SIZE, &file) == (int)sizeof(image));
+	CHECK(dev.uploads == 0);
+	CHECK(dev.writes == 6);
+}
+
+static void test_dfuse(void)
+{
+	static uint8_t image[6 * PAGE_SIZE + 300];
+	struct dfu_file file;
+	unsigned long poll_wait;
+
+	setup_if(DEV_DFUSE);
+	make_image(&file, image, sizeof(image));
+
+	/* first download, no compare: every page erased and written */
+	dfu_compare = 0;
+	memset(&dfu_timing, 0, sizeof(dfu_timing));
+	CHECK(dfuse_do_dnload(&dif, XFER_SIZE, &file, "0x08000000") ==
+	      (int)sizeof(image));
+	CHECK(memcmp(dev.flash, image, sizeof(image)) == 0);
+	CHECK(dev.erases == 7);
+	CHECK(dev.bad_writes == 0);
+	/* busy for one 1 ms poll per request; no extra wait once idle */
+	poll_wait = dfu_timing.poll_wait;
+	CHECK(poll_wait < 100);
+
+	/* compare: unchanged image, no erase and no write */
+	dfu_compare = 1;
+	dev_clear_counters();
+	memset(&dfu_timing, 0, sizeof(dfu_timing));
+	CHECK(dfuse_do_dnload(&dif, XFER_SIZE, &file, "0x08000000") ==
+	      (int)sizeof(image));
+	CHECK(dev.erases == 0);
+	CHECK(dev.writes == 0);
+	CHECK(dfu_timing.skipped == sizeof(image));
+
+	/* one byte in page 3 and one in the partial last page */
+	image[3 * PAGE_SIZE + 17] ^= 0xff;
+	image[sizeof(image) - 2] ^= 0x0f;
+	dev_clear_counters();
+	CHECK(dfuse_do_dnload(&dif, XFER_SIZE, &file, "0x08000000") ==
+	      (int)sizeof(image));
+	CHECK(memcmp(dev.flash, image, sizeof(image)) == 0);
+	CHECK(dev.erases == 2);
+	CHECK(dev.writes == 2);
+	CHECK(dev.bad_writes == 0);
+}
+
+int main(void)
+{
+	/* dfu-util's progress output, unless asked for */
+	if (!getenv("VERBOSE"))
+		freopen("/dev/null", "w", stdout);
+
+	test_maple();
+	test_dfuse();
+	if (failures) {
+		fprintf(stderr, "test_dfu: %d checks failed\n", failures);
+		return 1;
+	}
+	fprintf(stderr, "test_dfu: ok\n");
+	return 0;
+}
@@ -0,0 +1,153 @@
+/*
+ * Just enough of the StdPeriph library for the AN2868 HSI calibration:
+ * TIM3 in capture/slave reset mode, the RCC registers holding HSITRIM and
+ * the clock tree, the LSE ready flag and no-op GPIO, BKP, PWR and NVIC
+ * setup. The test owns the oscillator and the timer counting.
+ */
+#ifndef STM32F10X_H
+#define STM32F10X_H
+
+#include <stdint.h>
+
+#define __IO volatile
+
+typedef enum { RESET = 0, SET = !RESET } FlagStatus, ITStatus;
+typedef enum { DISABLE = 0, ENABLE = !DISABLE } FunctionalState;
+typedef enum { ERROR = 0, SUCCESS = !ERROR } ErrorStatus;
+
+#define HSI_Value ((uint32_t)8000000)
+
+typedef struct {
+	uint16_t CR1, SR, CCR1;
+	uint16_t DIER;
+	int enabled;
+} TIM_TypeDef;
+
+extern TIM_TypeDef test_tim3;
+#define TIM3 (&test_tim3)
+
+#define TIM_IT_Update    0x0001
+#define TIM_IT_CC1       0x0002
+
+#define TIM_Channel_1               0
+#define TIM_ICPolarity_Rising       0
+#define TIM_ICSelection_DirectTI    1
+#define TIM_ICPSC_DIV1              0
+#define TIM_TS_TI1FP1               0x50
+#define TIM_SlaveMode_Reset         4
+#define TIM_MasterSlaveMode_Enable  0x80
+#define TIM_UpdateSource_Regular    1
+#define TIM_CR1_URS                 0x0004
+
+typedef struct {
+	uint16_t TIM_Channel, TIM_ICPolarity, TIM_ICSelection;
+	uint16_t TIM_ICPrescaler, TIM_ICFilter;
+} TIM_ICInitTypeDef;
+
+typedef struct { uint32_t CR, CFGR, BDCR; } RCC_TypeDef;
+extern RCC_TypeDef test_rcc;
+#define RCC (&test_rcc)
+
+#define RCC_CR_HSITRIM      ((uint32_t)0x000000F8)
+#define RCC_CFGR_SWS        ((uint32_t)0x0000000C)
+#define RCC_CFGR_PPRE1_2    ((uint32_t)0x00000400)
+#define RCC_CFGR_PLLSRC     ((uint32_t)0x00010000)
+#define RCC_BDCR_LSERDY     ((uint32_t)0x00000002)
+
+typedef struct {
+	uint32_t SYSCLK_Frequency, HCLK_Frequency;
+	uint32_t PCLK1_Frequency, PCLK2_Frequency, ADCCLK_Frequency;
+} RCC_ClocksTypeDef;
+
+#define RCC_APB1Periph_TIM3   0x00000002
+#define RCC_APB1Periph_BKP    0x08000000
+#define RCC_APB1Periph_PWR    0x10000000
+#define RCC_APB2Periph_AFIO   0x00000001
+#define RCC_APB2Periph_GPIOA  0x00000004
+#define RCC_APB2Periph_GPIOC  0x00000010
+#define RCC_FLAG_LSERDY       0x41
+#define RCC_LSE_ON            1
+#define RCC_RTCCLKSource_LSE  0x100
+
+typedef struct { uint32_t CR; } PWR_TypeDef;
+typedef struct { uint16_t RTCCR; } BKP_TypeDef;
+extern PWR_TypeDef test_pwr;
+extern BKP_TypeDef test_bkp;
+#define PWR (&test_pwr)
+#define BKP (&test_bkp)
+#define BKP_RTCOutputSource_None       0x0000
+#define BKP_RTCOutputSource_CalibClock 0x0080
+
+typedef struct { int dummy; } GPIO_TypeDef;
+extern GPIO_TypeDef test_gpioa, test_gpioc;
+#define GPIOA (&test_gpioa)
+#define GPIOC (&test_gpioc)
+#define GPIO_Pin_6            0x0040
+#define GPIO_Pin_13           0x2000
+#define GPIO_Mode_IN_FLOATING 0x04
+#define GPIO_Mode_AF_PP       0x18
+#define GPIO_Speed_2MHz       2
+typedef struct { uint16_t GPIO_Pin; int GPIO_Speed; int GPIO_Mode; } GPIO_InitTypeDef;
+
+#define TIM3_IRQn 29
+typedef struct {
+	uint8_t NVIC_IRQChannel, NVIC_IRQChannelPreemptionPriority;
+	uint8_t NVIC_IRQChannelSubPriority;
+	FunctionalState NVIC_IRQChannelCmd;
+} NVIC_InitTypeDef;
+
+/* Provided by the test: they act on the oscillator model */
+void RCC_GetClocksFreq(RCC_ClocksTypeDef *clocks);
+void RCC_AdjustHSICalibrationValue(uint8_t value);
+
+static inline uint8_t RCC_GetSYSCLKSource(void) { return RCC->CFGR & RCC_CFGR_SWS; }
+static inline FlagStatus RCC_GetFlagStatus(uint8_t flag)
+{
+	(void)flag;
+	return (RCC->BDCR & RCC_BDCR_LSERDY) ? SET : RESET;
+}
+static inline void RCC_APB1PeriphClockCmd(uint32_t p, FunctionalState s) { (void)p; (void)s; }
+static inline void RCC_APB2PeriphClockCmd(uint32_t p, FunctionalState s) { (void)p; (void)s; }
+static inline void RCC_LSEConfig(uint8_t s) { (void)s; }
+static inline void RCC_RTCCLKConfig(uint32_t s) { (void)s; }
+static inline void RCC_RTCCLKCmd(FunctionalState s) { (void)s; }
+static inline void PWR_BackupAccessCmd(FunctionalState s)
+{
+	if (s == ENABLE)
+		PWR->CR |= 0x100;
+	else
+		PWR->CR &= ~0x100;
+}
+static inline void BKP_RTCOutputConfig(uint16_t s) { BKP->RTCCR = s; }
+static inline void GPIO_Init(GPIO_TypeDef *g, GPIO_InitTypeDef *i) { (void)g; (void)i; }
+static inline void NVIC_Init(NVIC_InitTypeDef *i) { (void)i; }
+
+static inline void TIM_DeInit(TIM_TypeDef *t) { t->enabled = 0; t->DIER = 0; t->SR = 0; t->CR1 = 0; }
+static inline void TIM_ICStructInit(TIM_ICInitTypeDef *i) { (void)i; }
+static inline void TIM_ICInit(TIM_TypeDef *t, TIM_ICInitTypeDef *i) { (void)t; (void)i; }
+static inline void TIM_SelectInputTrigger(TIM_TypeDef *t, uint16_t s) { (void)t; (void)s; }
+static inline void TIM_SelectSlaveMode(TIM_TypeDef *t, uint16_t m) { (void)t; (void)m; }
+static inline void TIM_SelectMasterSlaveMode(TIM_TypeDef *t, uint16_t m) { (void)t; (void)m; }
+static inline void TIM_UpdateRequestConfig(TIM_TypeDef *t, uint16_t s)
+{
+	if (s == TIM_UpdateSource_Regular)
+		t->CR1 |= TIM_CR1_URS;
+	else
+		t->CR1 &= ~TIM_CR1_URS;
+}
+static inline void TIM_Cmd(TIM_TypeDef *t, FunctionalState s) { t->enabled = (s == ENABLE); }
+static inline void TIM_ITConfig(TIM_TypeDef *t, uint16_t it, FunctionalState s)
+{
+	if (s == ENABLE)
+		t->DIER |= it;
+	else
+		t->DIER &= ~it;
+}
+static inline ITStatus TIM_GetITStatus(TIM_TypeDef *t, uint16_t it)
+{
+	return ((t->SR & it) && (t->DIER & it)) ? SET : RESET;
+}
+static inline void TIM_ClearITPendingBit(TIM_TypeDef *t, uint16_t it) { t->SR &= ~it; }
+static inline uint16_t TIM_GetCapture1(TIM_TypeDef *t) { return t->CCR1; }
+
+#endif
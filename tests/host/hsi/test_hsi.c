@@ -0,0 +1,526 @@
+/*
+ * Runs the AN2868 background HSI calibration against an oscillator model.
+ *
+ * The HSI frequency is a function of HSITRIM (factory offset, step size
+ * and some curvature) and of a drift term standing in for temperature.
+ * TIM3 counts a clock derived from the HSI (SYSCLK = HSI, or the PLL fed
+ * by HSI/2 with APB1 divided) and is reset by the RTC/64 reference edges
+ * (512 Hz from the LSE, with jitter). HSI_FreqMeasure() runs on each
+ * capture and overflow, and a new HSITRIM value only reaches the
+ * oscillator a couple of microseconds after the edge that triggered it,
+ * as with the interrupt latency on the chip.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "stm32f10x.h"
+#include "HSI_calibration.h"
+
+TIM_TypeDef test_tim3;
+RCC_TypeDef test_rcc;
+PWR_TypeDef test_pwr;
+BKP_TypeDef test_bkp;
+GPIO_TypeDef test_gpioa, test_gpioc;
+
+static int failures;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: check failed: %s\n", \
+			__FILE__, __LINE__, #cond); \
+		failures++; \
+	} } while (0)
+
+/*
+ * Oscillator and clock tree
+ */
+
+enum clock_mode { CLK_HSI, CLK_PLL36, CLK_PLL64, CLK_HSE };
+
+static const char *const clock_name[] = { "HSI", "PLL36", "PLL64", "HSE" };
+
+struct chip {
+	double f16;      /* HSI at HSITRIM = 16, Hz */
+	double step;     /* Hz per HSITRIM unit */
+	double curve;    /* Hz per HSITRIM unit squared */
+};
+
+static struct {
+	struct chip chip;
+	enum clock_mode mode;
+	double tim_ratio;         /* TIM3 clock / HSI */
+	double drift_ppm;         /* current drift */
+	double drift_rate;        /* ppm per second */
+
+	double t;                 /* seconds */
+	double ticks;             /* TIM3 counter, fractional */
+	int trim;                 /* HSITRIM applied to the oscillator */
+	int pending_trim;
+	double trim_at;
+
+	double next_edge;
+	double ref_grid;          /* ideal time of the next edge */
+	double ref_jitter;        /* seconds, +/- around the ideal edge */
+	double lse_ready_at;
+	int ref_off;
+
+	unsigned long isr_calls;
+	double isr_ns;
+	unsigned long trim_writes;
+} sim;
+
+static double hsi_at(int trim)
+{
+	double d = trim - 16;
+
+	return (sim.chip.f16 + d * sim.chip.step + d * d * sim.chip.curve) *
+		(1 + sim.drift_ppm * 1e-6);
+}
+
+static double hsi_error(int trim)
+{
+	return hsi_at(trim) - HSI_Value;
+}
+
+/* HSITRIM with the minimum error for the current drift */
+static int best_trim(void)
+{
+	int i, best = 0;
+
+	for (i = 1; i < 32; i++)
+		if (fabs(hsi_error(i)) < fabs(hsi_error(best)))
+			best = i;
+	return best;
+}
+
+void RCC_AdjustHSICalibrationValue(uint8_t value)
+{
+	RCC->CR = (RCC->CR & ~RCC_CR_HSITRIM) | ((uint32_t)value << 3);
+	sim.pending_trim = value;
+	sim.trim_at = sim.t + 2e-6;
+	sim.trim_writes++;
+}
+
+/* Nominal frequencies, as computed by the library from HSI_Value */
+void RCC_GetClocksFreq(RCC_ClocksTypeDef *clocks)
+{
+	memset(clocks, 0, sizeof(*clocks));
+	switch (sim.mode) {
+	case CLK_HSI:
+		clocks->SYSCLK_Frequency = 8000000;
+		clocks->PCLK1_Frequency = 8000000;
+		break;
+	case CLK_PLL36:
+		clocks->SYSCLK_Frequency = 36000000;
+		clocks->PCLK1_Frequency = 18000000;
+		break;
+	case CLK_PLL64:
+		clocks->SYSCLK_Frequency = 64000000;
+		clocks->PCLK1_Frequency = 32000000;
+		break;
+	case CLK_HSE:
+		clocks->SYSCLK_Frequency = 72000000;
+		clocks->PCLK1_Frequency = 36000000;
+		break;
+	}
+	clocks->HCLK_Frequency = clocks->PCLK2_Frequency = clocks->SYSCLK_Frequency;
+}
+
+/*
+ * Timer model
+ */
+
+static double now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void run_isr(void)
+{
+	double t0;
+
+	if (!(TIM3->SR & TIM3->DIER))
+		return;
+	t0 = now_ns();
+	HSI_FreqMeasure();
+	sim.isr_ns += now_ns() - t0;
+	sim.isr_calls++;
+}
+
+/* Count the TIM3 clock up to time target, raising the overflows */
+static void count_to(double target)
+{
+	while (sim.t < target) {
+		double f = hsi_at(sim.trim) * sim.tim_ratio;
+		double need = 65536 - fmod(sim.ticks, 65536);
+		double end = target;
+
+		if (sim.trim_at > sim.t && sim.trim_at < end)
+			end = sim.trim_at;
+		if (!TIM3->enabled) {
+			sim.t = end;
+		} else if (sim.t + need / f <= end) {
+			sim.t += need / f;
+			sim.ticks = 0;
+			TIM3->SR |= TIM_IT_Update;
+			run_isr();
+		} else {
+			sim.ticks += (end - sim.t) * f;
+			sim.t = end;
+		}
+		if (sim.trim_at <= sim.t && sim.trim != sim.pending_trim)
+			sim.trim = sim.pending_trim;
+	}
+}
+
+static double uniform(double a)
+{
+	return a * (2.0 * rand() / RAND_MAX - 1);
+}
+
+/* Reference edge on PA6: capture and counter reset */
+static void edge(void)
+{
+	if (!TIM3->enabled)
+		return;
+	TIM3->CCR1 = (uint16_t)sim.ticks;
+	TIM3->SR |= TIM_IT_CC1;
+	/* Reset by the slave mode controller: only an update event when
+	   URS is clear */
+	if (!(TIM3->CR1 & TIM_CR1_URS))
+		TIM3->SR |= TIM_IT_Update;
+	/* The counter restarts on the next clock edge: the phase of the
+	   timer clock carries over */
+	sim.ticks -= floor(sim.ticks);
+	run_isr();
+}
+
+static void run(double seconds)
+{
+	double end = sim.t + seconds;
+
+	while (sim.t < end) {
+		double next = sim.next_edge < end ? sim.next_edge : end;
+
+		count_to(next);
+		if (sim.t < sim.next_edge)
+			continue;
+		if (sim.t >= sim.lse_ready_at)
+			RCC->BDCR |= RCC_BDCR_LSERDY;
+		if (!sim.ref_off)
+			edge();
+		if (RCC->BDCR & RCC_BDCR_LSERDY)
+			sim.ref_grid += 1.0 / Ref_Frequency;
+		else
+			/* LSE starting: irregular edges */
+			sim.ref_grid += 0.5e-3 + 4.5e-3 * rand() / RAND_MAX;
+		sim.next_edge = sim.ref_grid + uniform(sim.ref_jitter);
+	}
+}
+
+static void setup(enum clock_mode mode, struct chip chip)
+{
+	memset(&sim, 0, sizeof(sim));
+	memset(&test_tim3, 0, sizeof(test_tim3));
+	memset(&test_rcc, 0, sizeof(test_rcc));
+
+	sim.chip = chip;
+	sim.mode = mode;
+	sim.trim = sim.pending_trim = 16;
+	RCC->CR = 16 << 3;
+	switch (mode) {
+	case CLK_HSI:
+		sim.tim_ratio = 1;
+		break;
+	case CLK_PLL36:
+		/* HSI/2 * 9, APB1 / 2, TIM3 at 2 * PCLK1 */
+		sim.tim_ratio = 4.5;
+		RCC->CFGR = 0x08 | RCC_CFGR_PPRE1_2;
+		break;
+	case CLK_PLL64:
+		sim.tim_ratio = 8;
+		RCC->CFGR = 0x08 | RCC_CFGR_PPRE1_2;
+		break;
+	case CLK_HSE:
+		RCC->CFGR = 0x04;
+		break;
+	}
+	sim.next_edge = sim.ref_grid = 1e-3;
+	sim.lse_ready_at = 0.3;
+	sim.ref_jitter = 50e-9;
+	sim.trim_at = -1;
+
+	/* Fresh service state for every case */
+	HSI_TrimStop();
+	test_pwr.CR = 0;
+	test_bkp.RTCCR = 0;
+}
+
+/* Run until the search is over, return the number of windows it took */
+static unsigned long converge(double *seconds)
+{
+	double start = sim.t;
+
+	while (HSI_TrimState == HSI_TRIM_SEARCH && sim.t - start < 5)
+		run(1e-3);
+	*seconds = sim.t - start;
+	return HSI_TrimWindows;
+}
+
+/*
+ * Tests
+ */
+
+static const struct chip chips[] = {
+	{ 8000000, 40000, 0 },
+	{ 7720000, 40000, 80 },
+	{ 8290000, 36000, -60 },
+	{ 7930000, 48000, 120 },
+	{ 8025000, 30000, 0 },
+	{ 7400000, 44000, 0 },      /* slow part: best HSITRIM 30 */
+	{ 8800000, 40000, 0 },      /* fast part: out of range, HSITRIM 0 */
+};
+
+static void test_search(void)
+{
+	unsigned int c;
+	int m;
+
+	for (m = CLK_HSI; m <= CLK_PLL64; m++) {
+		for (c = 0; c < sizeof(chips) / sizeof(chips[0]); c++) {
+			unsigned long windows;
+			double seconds, err;
+			int trim;
+
+			setup(m, chips[c]);
+			CHECK(HSI_TrimStart(0) == SUCCESS);
+			CHECK(HSI_TrimState == HSI_TRIM_SEARCH);
+			CHECK(TIM3->CR1 & TIM_CR1_URS);
+			CHECK(BKP->RTCCR == BKP_RTCOutputSource_CalibClock);
+			windows = converge(&seconds);
+			run(0.01);
+			trim = (RCC->CR & RCC_CR_HSITRIM) >> 3;
+			err = hsi_error(trim);
+
+			printf("%-5s f16 %.0f step %.0f: HSITRIM %2d (best %2d), "
+			       "error %6ld Hz (true %6.0f), step %lu, %lu windows, "
+			       "%.3f s\n", clock_name[m], chips[c].f16,
+			       chips[c].step, trim, best_trim(),
+			       (long)HSI_TrimError, err,
+			       (unsigned long)HSI_TrimStep, windows, seconds);
+
+			CHECK(HSI_TrimState == HSI_TRIM_TRACK);
+			CHECK(HSI_TrimGetStatus() == SUCCESS);
+			/* 5 halvings plus at most one neighbour */
+			CHECK(windows <= 6);
+			/* The LSE comes up at 0.3 s */
+			CHECK(seconds < 0.3 + 6 * (NbOfPeriod + 1.0) / Ref_Frequency);
+			/* A tick of TIM3 is 51 Hz of HSI in a window at 8 MHz */
+			CHECK(fabs(err) <= fabs(hsi_error(best_trim())) + 120);
+			CHECK(fabs(HSI_TrimError - err) < 120);
+			CHECK(fabs(HSI_TrimStep - chips[c].step) < chips[c].step / 4);
+			CHECK(sim.trim == trim);
+		}
+	}
+}
+
+/* No drift: once searched, HSITRIM must stay put */
+static void test_stable(void)
+{
+	double seconds;
+	unsigned long writes;
+
+	setup(CLK_PLL36, chips[1]);
+	sim.ref_jitter = 200e-9;
+	HSI_TrimStart(0);
+	converge(&seconds);
+	run(0.1);
+	writes = sim.trim_writes;
+	run(20);
+	printf("stable: %lu HSITRIM writes in 20 s\n", sim.trim_writes - writes);
+	CHECK(sim.trim_writes == writes);
+	CHECK(HSI_TrimState == HSI_TRIM_TRACK);
+}
+
+/* Temperature drift: the tracking follows one step at a time */
+static void test_drift(double total_ppm, double seconds)
+{
+	double conv, worst = 0, step;
+	unsigned long writes;
+	int moves = 0, last, t;
+
+	setup(CLK_PLL36, chips[0]);
+	HSI_TrimStart(0);
+	converge(&conv);
+	run(0.1);
+	step = HSI_TrimStep;
+	writes = sim.trim_writes;
+	last = sim.trim;
+	sim.drift_rate = total_ppm / seconds;
+
+	for (t = 0; t < seconds * 100; t++) {
+		sim.drift_ppm += sim.drift_rate * 0.01;
+		run(0.01);
+		if (sim.trim != last) {
+			moves++;
+			last = sim.trim;
+		}
+		if (HSI_TrimState == HSI_TRIM_TRACK &&
+		    fabs(hsi_error(sim.trim)) > worst)
+			worst = fabs(hsi_error(sim.trim));
+		/* The published error follows the true one */
+		if (HSI_TrimState == HSI_TRIM_TRACK)
+			CHECK(fabs(HSI_TrimError - hsi_error(sim.trim)) < 300);
+	}
+	printf("drift %+.0f ppm in %.0f s: %d HSITRIM moves, %lu writes, "
+	       "worst error %.0f Hz (step %.0f), HSITRIM %d best %d\n",
+	       total_ppm, seconds, moves, sim.trim_writes - writes, worst,
+	       step, sim.trim, best_trim());
+
+	/* Half a step plus the hysteresis plus the drift of a window */
+	CHECK(worst < step * 5 / 8 + 300);
+	CHECK(abs(sim.trim - best_trim()) <= 1);
+	CHECK(fabs(hsi_error(sim.trim)) < step * 5 / 8 + 300);
+	/* Every kept move is one probe, reverted probes are extra writes */
+	CHECK(moves <= fabs(total_ppm) * 8 / step + 2);
+	CHECK(sim.trim_writes - writes <= 2 * moves + 4);
+}
+
+/* Reference lost for a while: the windows are dropped, nothing is trimmed */
+static void test_reference_loss(void)
+{
+	double seconds;
+	unsigned long writes, windows;
+	int32_t error;
+
+	setup(CLK_PLL64, chips[2]);
+	HSI_TrimStart(0);
+	converge(&seconds);
+	run(0.1);
+	writes = sim.trim_writes;
+	error = HSI_TrimError;
+
+	sim.ref_off = 1;
+	run(0.2);
+	windows = HSI_TrimWindows;
+	run(0.2);
+	CHECK(HSI_TrimWindows == windows);
+	sim.ref_off = 0;
+	run(0.5);
+
+	CHECK(HSI_TrimWindows > windows + 10);
+	CHECK(sim.trim_writes == writes);
+	CHECK(labs((long)(HSI_TrimError - error)) < 200);
+	CHECK(HSI_TrimState == HSI_TRIM_TRACK);
+}
+
+static void test_allowed_error(void)
+{
+	double seconds;
+
+	/* Best HSITRIM is 9000 Hz off: within 14000 */
+	setup(CLK_PLL36, (struct chip){ 8009000, 40000, 0 });
+	HSI_TrimStart(14000);
+	CHECK(HSI_TrimGetStatus() == ERROR);
+	converge(&seconds);
+	run(0.1);
+	CHECK(HSI_TrimGetStatus() == SUCCESS);
+
+	/* Best HSITRIM is 18000 Hz off */
+	setup(CLK_PLL36, (struct chip){ 8018000, 40000, 0 });
+	HSI_TrimStart(14000);
+	converge(&seconds);
+	run(0.1);
+	CHECK(HSI_TrimState == HSI_TRIM_TRACK);
+	CHECK(HSI_TrimGetStatus() == ERROR);
+}
+
+static void test_start_stop(void)
+{
+	double seconds;
+	int trim;
+
+	/* TIM3 would count HSE: refuse */
+	setup(CLK_HSE, chips[0]);
+	CHECK(HSI_TrimStart(0) == ERROR);
+	CHECK(HSI_TrimState == HSI_TRIM_IDLE);
+	CHECK(!TIM3->enabled);
+	CHECK(sim.trim_writes == 0);
+
+	/* The application had neither backup access nor the RTC output */
+	setup(CLK_HSI, chips[1]);
+	HSI_TrimStart(0);
+	CHECK(PWR->CR & 0x100);
+	converge(&seconds);
+	trim = sim.trim;
+	HSI_TrimStop();
+	CHECK(HSI_TrimState == HSI_TRIM_IDLE);
+	CHECK(TIM3->DIER == 0);
+	CHECK(!TIM3->enabled);
+	CHECK(BKP->RTCCR == BKP_RTCOutputSource_None);
+	CHECK(!(PWR->CR & 0x100));
+	CHECK(HSI_TrimGetStatus() == ERROR);
+	run(0.1);
+	CHECK(sim.trim == trim);
+
+	/* Restart from an already trimmed HSI */
+	CHECK(HSI_TrimStart(0) == SUCCESS);
+	converge(&seconds);
+	CHECK(HSI_TrimState == HSI_TRIM_TRACK);
+	CHECK(fabs(hsi_error(sim.trim)) <= fabs(hsi_error(best_trim())) + 120);
+}
+
+/* Interrupt load of the service while tracking */
+static void test_cost(void)
+{
+	enum clock_mode m;
+	double seconds;
+
+	for (m = CLK_HSI; m <= CLK_PLL64; m++) {
+		unsigned long calls;
+		double ns;
+
+		setup(m, chips[0]);
+		HSI_TrimStart(0);
+		converge(&seconds);
+		calls = sim.isr_calls;
+		ns = sim.isr_ns;
+		run(10);
+		printf("%-5s tracking: %.0f interrupts/s, %.0f ns each on the host\n",
+		       clock_name[m], (sim.isr_calls - calls) / 10.0,
+		       (sim.isr_ns - ns) / (sim.isr_calls - calls));
+		/* 512 captures plus TIM3CLK / 65536 overflows per second */
+		CHECK((sim.isr_calls - calls) / 10.0 <
+		      Ref_Frequency + 8e6 * sim.tim_ratio / 65536 + 10);
+	}
+}
+
+int main(void)
+{
+	if (!getenv("VERBOSE"))
+		freopen("/dev/null", "w", stdout);
+
+	srand(1);
+	test_search();
+	test_stable();
+	test_drift(15000, 60);
+	test_drift(-15000, 60);
+	test_drift(4000, 5);
+	test_reference_loss();
+	test_allowed_error();
+	test_start_stop();
+	test_cost();
+	if (failures) {
+		fprintf(stderr, "test_hsi: %d checks failed\n", failures);
+		return 1;
+	}
+	fprintf(stderr, "test_hsi: ok\n");
+	return 0;
+}
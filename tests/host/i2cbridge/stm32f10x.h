@@ -0,0 +1,197 @@
+/*
+ * Stands in for stm32f10x.h, core_cm3.h and the StdPeriph headers: just
+ * enough RCC, GPIO, NVIC, SysTick, DMA and I2C for the USBI2CBridge
+ * sources. The functions are the model in test_i2cbridge.c: the I2C1
+ * registers the driver reads directly, and the DMA channel CMAR and
+ * CNDTR it sets, are model state too.
+ */
+#ifndef __STM32F10x_H
+#define __STM32F10x_H
+
+#include <stdint.h>
+
+#define __IO volatile
+
+typedef uint32_t u32;
+typedef uint16_t u16;
+typedef uint8_t u8;
+
+typedef enum {FALSE = 0, TRUE = !FALSE} bool;
+typedef enum {RESET = 0, SET = !RESET} FlagStatus, ITStatus;
+typedef enum {DISABLE = 0, ENABLE = !DISABLE} FunctionalState;
+typedef enum {ERROR = 0, SUCCESS = !ERROR} ErrorStatus;
+
+typedef enum {
+	SysTick_IRQn = -1,
+	DMA1_Channel6_IRQn = 16,
+	DMA1_Channel7_IRQn = 17,
+	USB_LP_CAN1_RX0_IRQn = 20,
+	I2C1_EV_IRQn = 31,
+	I2C1_ER_IRQn = 32,
+} IRQn_Type;
+
+typedef struct {
+	__IO uint16_t CR1;
+	__IO uint16_t SR1;
+	__IO uint16_t SR2;
+} I2C_TypeDef;
+
+typedef struct {
+	__IO uint32_t CCR;
+	__IO uint32_t CNDTR;
+	__IO uint32_t CPAR;
+	__IO uint32_t CMAR;
+} DMA_Channel_TypeDef;
+
+typedef struct { int index; } GPIO_TypeDef;
+
+extern I2C_TypeDef test_i2c1;
+extern DMA_Channel_TypeDef test_dma1_ch6, test_dma1_ch7;
+extern GPIO_TypeDef test_gpiob;
+extern uint32_t SystemCoreClock;
+
+#define I2C1           (&test_i2c1)
+#define DMA1_Channel6  (&test_dma1_ch6)
+#define DMA1_Channel7  (&test_dma1_ch7)
+#define GPIOB          (&test_gpiob)
+
+#define I2C_CR1_START  ((uint16_t)0x0100)
+#define I2C_CR1_STOP   ((uint16_t)0x0200)
+#define I2C_SR1_SB     ((uint16_t)0x0001)
+#define I2C_SR1_ADDR   ((uint16_t)0x0002)
+#define I2C_SR1_BTF    ((uint16_t)0x0004)
+#define I2C_SR1_RXNE   ((uint16_t)0x0040)
+#define I2C_SR1_TXE    ((uint16_t)0x0080)
+#define I2C_SR1_BERR   ((uint16_t)0x0100)
+#define I2C_SR1_ARLO   ((uint16_t)0x0200)
+#define I2C_SR1_AF     ((uint16_t)0x0400)
+#define I2C_SR2_MSL    ((uint16_t)0x0001)
+#define I2C_SR2_BUSY   ((uint16_t)0x0002)
+#define I2C_SR2_TRA    ((uint16_t)0x0004)
+
+#define DMA_CCR1_EN    ((uint16_t)0x0001)
+#define DMA_CCR1_TCIE  ((uint16_t)0x0002)
+
+/* core_cm3.h */
+void __WFI(void);
+void __disable_irq(void);
+void __enable_irq(void);
+uint32_t SysTick_Config(uint32_t ticks);
+void NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority);
+
+/* misc.h */
+typedef struct {
+	uint8_t NVIC_IRQChannel;
+	uint8_t NVIC_IRQChannelPreemptionPriority;
+	uint8_t NVIC_IRQChannelSubPriority;
+	FunctionalState NVIC_IRQChannelCmd;
+} NVIC_InitTypeDef;
+
+#define NVIC_PriorityGroup_1 ((uint32_t)0x600)
+
+void NVIC_Init(NVIC_InitTypeDef *NVIC_InitStruct);
+void NVIC_PriorityGroupConfig(uint32_t NVIC_PriorityGroup);
+
+/* stm32f10x_rcc.h */
+#define RCC_AHBPeriph_DMA1    ((uint32_t)0x00000001)
+#define RCC_APB2Periph_GPIOB  ((uint32_t)0x00000008)
+#define RCC_APB1Periph_I2C1   ((uint32_t)0x00200000)
+
+void RCC_AHBPeriphClockCmd(uint32_t RCC_AHBPeriph, FunctionalState NewState);
+void RCC_APB2PeriphClockCmd(uint32_t RCC_APB2Periph, FunctionalState NewState);
+void RCC_APB1PeriphClockCmd(uint32_t RCC_APB1Periph, FunctionalState NewState);
+
+/* stm32f10x_gpio.h */
+typedef enum { GPIO_Speed_10MHz = 1, GPIO_Speed_2MHz, GPIO_Speed_50MHz } GPIOSpeed_TypeDef;
+typedef enum { GPIO_Mode_Out_PP = 0x10, GPIO_Mode_AF_OD = 0x1C } GPIOMode_TypeDef;
+typedef struct {
+	uint16_t GPIO_Pin;
+	GPIOSpeed_TypeDef GPIO_Speed;
+	GPIOMode_TypeDef GPIO_Mode;
+} GPIO_InitTypeDef;
+
+#define GPIO_Pin_6  ((uint16_t)0x0040)
+#define GPIO_Pin_7  ((uint16_t)0x0080)
+
+void GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_InitStruct);
+
+/* stm32f10x_dma.h */
+typedef struct {
+	uint32_t DMA_PeripheralBaseAddr;
+	uint32_t DMA_MemoryBaseAddr;
+	uint32_t DMA_DIR;
+	uint32_t DMA_BufferSize;
+	uint32_t DMA_PeripheralInc;
+	uint32_t DMA_MemoryInc;
+	uint32_t DMA_PeripheralDataSize;
+	uint32_t DMA_MemoryDataSize;
+	uint32_t DMA_Mode;
+	uint32_t DMA_Priority;
+	uint32_t DMA_M2M;
+} DMA_InitTypeDef;
+
+#define DMA_DIR_PeripheralDST        ((uint32_t)0x00000010)
+#define DMA_DIR_PeripheralSRC        ((uint32_t)0x00000000)
+#define DMA_PeripheralInc_Disable    ((uint32_t)0x00000000)
+#define DMA_MemoryInc_Enable         ((uint32_t)0x00000080)
+#define DMA_PeripheralDataSize_Byte  ((uint32_t)0x00000000)
+#define DMA_MemoryDataSize_Byte      ((uint32_t)0x00000000)
+#define DMA_Mode_Normal              ((uint32_t)0x00000000)
+#define DMA_Priority_VeryHigh        ((uint32_t)0x00003000)
+#define DMA_Priority_High            ((uint32_t)0x00002000)
+#define DMA_M2M_Disable              ((uint32_t)0x00000000)
+#define DMA_IT_TC                    ((uint32_t)0x00000002)
+
+#define DMA1_IT_GL6    ((uint32_t)0x00100000)
+#define DMA1_IT_TC6    ((uint32_t)0x00200000)
+#define DMA1_IT_GL7    ((uint32_t)0x01000000)
+#define DMA1_IT_TC7    ((uint32_t)0x02000000)
+
+void DMA_DeInit(DMA_Channel_TypeDef *DMAy_Channelx);
+void DMA_Init(DMA_Channel_TypeDef *DMAy_Channelx, DMA_InitTypeDef *DMA_InitStruct);
+void DMA_ITConfig(DMA_Channel_TypeDef *DMAy_Channelx, uint32_t DMA_IT, FunctionalState NewState);
+void DMA_Cmd(DMA_Channel_TypeDef *DMAy_Channelx, FunctionalState NewState);
+void DMA_ClearITPendingBit(uint32_t DMAy_IT);
+
+/* stm32f10x_i2c.h */
+typedef struct {
+	uint32_t I2C_ClockSpeed;
+	uint16_t I2C_Mode;
+	uint16_t I2C_DutyCycle;
+	uint16_t I2C_OwnAddress1;
+	uint16_t I2C_Ack;
+	uint16_t I2C_AcknowledgedAddress;
+} I2C_InitTypeDef;
+
+#define I2C_Mode_I2C                  ((uint16_t)0x0000)
+#define I2C_DutyCycle_2               ((uint16_t)0xBFFF)
+#define I2C_Ack_Enable                ((uint16_t)0x0400)
+#define I2C_AcknowledgedAddress_7bit  ((uint16_t)0x4000)
+#define I2C_Direction_Transmitter     ((uint8_t)0x00)
+#define I2C_Direction_Receiver        ((uint8_t)0x01)
+
+#define I2C_IT_BUF   ((uint16_t)0x0400)
+#define I2C_IT_EVT   ((uint16_t)0x0200)
+#define I2C_IT_ERR   ((uint16_t)0x0100)
+#define I2C_IT_AF    ((uint32_t)0x01000400)
+#define I2C_IT_ARLO  ((uint32_t)0x01000200)
+#define I2C_IT_BERR  ((uint32_t)0x01000100)
+
+#define I2C_EVENT_MASTER_MODE_SELECT                ((uint32_t)0x00030001)
+#define I2C_EVENT_MASTER_TRANSMITTER_MODE_SELECTED  ((uint32_t)0x00070082)
+#define I2C_EVENT_MASTER_RECEIVER_MODE_SELECTED     ((uint32_t)0x00030002)
+#define I2C_EVENT_MASTER_BYTE_TRANSMITTED           ((uint32_t)0x00070084)
+
+void I2C_DeInit(I2C_TypeDef *I2Cx);
+void I2C_Init(I2C_TypeDef *I2Cx, I2C_InitTypeDef *I2C_InitStruct);
+void I2C_Cmd(I2C_TypeDef *I2Cx, FunctionalState NewState);
+void I2C_DMACmd(I2C_TypeDef *I2Cx, FunctionalState NewState);
+void I2C_DMALastTransferCmd(I2C_TypeDef *I2Cx, FunctionalState NewState);
+void I2C_ITConfig(I2C_TypeDef *I2Cx, uint16_t I2C_IT, FunctionalState NewState);
+void I2C_GenerateSTART(I2C_TypeDef *I2Cx, FunctionalState NewState);
+void I2C_GenerateSTOP(I2C_TypeDef *I2Cx, FunctionalState NewState);
+void I2C_Send7bitAddress(I2C_TypeDef *I2Cx, uint8_t Address, uint8_t I2C_Direction);
+uint32_t I2C_GetLastEvent(I2C_TypeDef *I2Cx);
+void I2C_ClearITPendingBit(I2C_TypeDef *I2Cx, uint32_t I2C_IT);
+
+#endif
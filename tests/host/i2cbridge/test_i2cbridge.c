@@ -0,0 +1,1266 @@
+/*
+ * Runs the USBI2CBridge DFU firmware (usb_prop.c, dfu_mal.c, i2c_if.c,
+ * i2c_flash.c) on the ST USB-FS device driver against models of the
+ * hardware around it, and measures what a DfuSe host gets through.
+ *
+ * Time is simulated, in ns. The host runs DfuSe's control transfers on
+ * EP0: each starts on a 1 ms frame, its packets follow back to back at
+ * 12 Mbit/s, and the host sleeps the bwPollTimeout of each GETSTATUS
+ * answer. CTR_LP() runs for each packet, as the USB interrupt; the host
+ * waits for it to return.
+ *
+ * I2C1 runs at 400 kHz, 22.5 us a byte with its acknowledge, with the
+ * flags, events and DMA requests of RM0008 that the driver uses. The
+ * I2C1 event and error, DMA1 channel 6 and 7 and 1 ms SysTick interrupts
+ * preempt the USB interrupt: they run when the model time reaches them,
+ * or when the firmware waits in __WFI(). The handlers are called as
+ * stm32f10x_it.c calls them.
+ *
+ * The target is the IAPOverI2C slave at 0x30 built for STM3210B-EVAL
+ * (1 KB pages): OPC_WREN erases the page at the address and programs
+ * the halfwords, in the datasheet's worst case (40 ms a page, 70 us a
+ * halfword); a transaction addressed to it before it is done would be
+ * lost and is counted. OPC_READ sets up what the next receiver
+ * transaction returns.
+ *
+ * The throughput checks are against the bounds of the model: a download
+ * can't beat one page on the bus plus the programming hold-off per KB,
+ * an upload one page on the bus per KB.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "usb_lib.h"
+#include "usb_conf.h"
+#include "usb_prop.h"
+#include "usb_desc.h"
+#include "usb_pwr.h"
+#include "dfu_mal.h"
+#include "i2c_flash.h"
+
+static int failures;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: check failed: %s\n", \
+			__FILE__, __LINE__, #cond); \
+		failures++; \
+	} } while (0)
+
+#define FATAL(msg) do { \
+	fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, msg); \
+	exit(1); \
+	} while (0)
+
+#define NS_PER_MS   1000000ull
+#define NEVER       (~0ull)
+
+static uint64_t now;
+
+/*
+ * Interrupts
+ */
+
+enum { IRQ_I2C_EV, IRQ_I2C_ER, IRQ_DMA6, IRQ_DMA7, IRQ_SYSTICK, IRQ_COUNT };
+
+static int primask;
+static int running = 2;         /* 0 I2C/DMA/SysTick handler, 1 USB, 2 thread */
+static int nvic_enabled[IRQ_COUNT];
+static int systick_pending;
+static uint64_t systick_next = NEVER;
+static unsigned long wfi_count;
+
+static int irq_pending(int irq);
+
+static void (*const irq_handler[IRQ_COUNT])(void) = {
+	I2C_FLASH_EV_IRQHandler,
+	I2C_FLASH_ER_IRQHandler,
+	I2C_FLASH_DMATx_IRQHandler,
+	I2C_FLASH_DMARx_IRQHandler,
+	I2C_FLASH_TimingHandler,
+};
+
+/* runs what is pending and may preempt what runs now */
+static void irq_service(void)
+{
+	int irq, saved, guard = 0;
+
+	if (primask || running == 0)
+		return;
+	for (;;) {
+		for (irq = 0; irq < IRQ_COUNT; irq++)
+			if (nvic_enabled[irq] && irq_pending(irq))
+				break;
+		if (irq == IRQ_COUNT)
+			return;
+		if (++guard > 100)
+			FATAL("interrupt stays pending");
+		if (irq == IRQ_SYSTICK)
+			systick_pending = 0;
+		saved = running;
+		running = 0;
+		irq_handler[irq]();
+		running = saved;
+	}
+}
+
+void __disable_irq(void)
+{
+	primask = 1;
+}
+
+void __enable_irq(void)
+{
+	primask = 0;
+	irq_service();
+}
+
+uint32_t SystemCoreClock = 72000000;
+
+uint32_t SysTick_Config(uint32_t ticks)
+{
+	CHECK(ticks == SystemCoreClock / 1000);
+	systick_next = (now / NS_PER_MS + 1) * NS_PER_MS;
+	nvic_enabled[IRQ_SYSTICK] = 1;
+	return 0;
+}
+
+void NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority)
+{
+	CHECK(IRQn == SysTick_IRQn && priority == 0);
+}
+
+void NVIC_Init(NVIC_InitTypeDef *NVIC_InitStruct)
+{
+	int irq;
+
+	switch (NVIC_InitStruct->NVIC_IRQChannel) {
+	case I2C1_EV_IRQn: irq = IRQ_I2C_EV; break;
+	case I2C1_ER_IRQn: irq = IRQ_I2C_ER; break;
+	case DMA1_Channel6_IRQn: irq = IRQ_DMA6; break;
+	case DMA1_Channel7_IRQn: irq = IRQ_DMA7; break;
+	default: FATAL("unexpected IRQ channel");
+	}
+	/* they must preempt the USB interrupt */
+	CHECK(NVIC_InitStruct->NVIC_IRQChannelPreemptionPriority == 0);
+	nvic_enabled[irq] = NVIC_InitStruct->NVIC_IRQChannelCmd == ENABLE;
+}
+
+void NVIC_PriorityGroupConfig(uint32_t NVIC_PriorityGroup)
+{
+	(void)NVIC_PriorityGroup;
+}
+
+void RCC_AHBPeriphClockCmd(uint32_t p, FunctionalState s) { (void)p; (void)s; }
+void RCC_APB2PeriphClockCmd(uint32_t p, FunctionalState s) { (void)p; (void)s; }
+void RCC_APB1PeriphClockCmd(uint32_t p, FunctionalState s) { (void)p; (void)s; }
+
+GPIO_TypeDef test_gpiob;
+
+void GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_InitStruct)
+{
+	CHECK(GPIOx == GPIOB);
+	CHECK(GPIO_InitStruct->GPIO_Mode == GPIO_Mode_AF_OD);
+}
+
+/*
+ * DMA1 channels 6 (I2C1 TX) and 7 (I2C1 RX)
+ */
+
+DMA_Channel_TypeDef test_dma1_ch6, test_dma1_ch7;
+
+static struct dma {
+	DMA_Channel_TypeDef *regs;
+	int tcie, tcif;
+	uint8_t *ptr;           /* the channel's internal memory address */
+} dma6 = { &test_dma1_ch6 }, dma7 = { &test_dma1_ch7 };
+
+static struct dma *dma_of(DMA_Channel_TypeDef *ch)
+{
+	if (ch == DMA1_Channel6)
+		return &dma6;
+	if (ch == DMA1_Channel7)
+		return &dma7;
+	FATAL("unexpected DMA channel");
+}
+
+static int dma_on(struct dma *d)
+{
+	return d->regs->CCR & DMA_CCR1_EN;
+}
+
+void DMA_DeInit(DMA_Channel_TypeDef *ch)
+{
+	struct dma *d = dma_of(ch);
+
+	memset((void *)ch, 0, sizeof(*ch));
+	d->tcie = d->tcif = 0;
+}
+
+void DMA_Init(DMA_Channel_TypeDef *ch, DMA_InitTypeDef *init)
+{
+	CHECK(!dma_on(dma_of(ch)));
+	CHECK(init->DMA_PeripheralBaseAddr == 0x40005410);
+	CHECK(init->DMA_DIR == (ch == DMA1_Channel6 ? DMA_DIR_PeripheralDST
+						    : DMA_DIR_PeripheralSRC));
+	CHECK(init->DMA_MemoryInc == DMA_MemoryInc_Enable);
+	CHECK(init->DMA_Mode == DMA_Mode_Normal);
+	ch->CMAR = init->DMA_MemoryBaseAddr;
+	ch->CNDTR = init->DMA_BufferSize;
+}
+
+void DMA_ITConfig(DMA_Channel_TypeDef *ch, uint32_t it, FunctionalState s)
+{
+	CHECK(it == DMA_IT_TC);
+	dma_of(ch)->tcie = s == ENABLE;
+	irq_service();
+}
+
+static void i2c_dma_request(void);
+
+void DMA_Cmd(DMA_Channel_TypeDef *ch, FunctionalState s)
+{
+	struct dma *d = dma_of(ch);
+
+	if (s == ENABLE && !dma_on(d)) {
+		/* CMAR and CNDTR are taken when the channel starts */
+		CHECK(ch->CNDTR != 0);
+		d->ptr = (uint8_t *)(uintptr_t)ch->CMAR;
+		ch->CCR |= DMA_CCR1_EN;
+		i2c_dma_request();
+	} else if (s == DISABLE) {
+		ch->CCR &= ~DMA_CCR1_EN;
+	}
+}
+
+void DMA_ClearITPendingBit(uint32_t it)
+{
+	if (it & (DMA1_IT_GL6 | DMA1_IT_TC6))
+		dma6.tcif = 0;
+	if (it & (DMA1_IT_GL7 | DMA1_IT_TC7))
+		dma7.tcif = 0;
+}
+
+/* one byte through a channel: 0 if it has no request to serve */
+static int dma_transfer(struct dma *d, uint8_t *byte, int to_memory)
+{
+	if (!dma_on(d) || d->regs->CNDTR == 0)
+		return 0;
+	if (to_memory)
+		*d->ptr++ = *byte;
+	else
+		*byte = *d->ptr++;
+	if (--d->regs->CNDTR == 0)
+		d->tcif = 1;
+	return 1;
+}
+
+/*
+ * IAPOverI2C target
+ */
+
+#define TARGET_ADDRESS   0x30     /* I2C_OwnAddress1: bits 7:1 */
+#define TARGET_BASE      0x08000000u
+#define TARGET_SIZE      0x20000u
+#define TARGET_PAGE      0x400u
+#define T_PAGE_ERASE     (40 * NS_PER_MS)
+#define T_HALFWORD       70000ull
+
+static struct {
+	int present;
+	uint8_t flash[TARGET_SIZE];
+	uint64_t busy_until;
+	uint32_t rd_addr;
+	uint16_t rd_count, rd_idx;
+	int rd_armed;
+	unsigned long lost, bad, writes, reads, faults;
+} target;
+
+static uint32_t be32(const uint8_t *p)
+{
+	return (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+/* ADDR of a transaction to the target: 0 if it NACKs */
+static int target_address(int rx)
+{
+	if (!target.present)
+		return 0;
+	if (now < target.busy_until)
+		target.lost++;
+	if (rx && !target.rd_armed)
+		target.bad++;
+	return 1;
+}
+
+/* the STOP of a transaction the bridge wrote */
+static void target_command(const uint8_t *b, int len)
+{
+	uint32_t addr, off, page;
+	uint16_t count;
+	int i;
+
+	if (len < 7) {
+		target.bad++;
+		return;
+	}
+	addr = be32(&b[1]);
+	count = (uint16_t)(b[5] << 8 | b[6]);
+	off = addr - TARGET_BASE;
+	if (b[0] == 0x03 && len == 7) {
+		/* Read_Memory_Command copies from the flash address as it is */
+		if (addr < TARGET_BASE || off + count > TARGET_SIZE) {
+			target.faults++;
+			return;
+		}
+		target.rd_addr = off;
+		target.rd_count = count;
+		target.rd_idx = 0;
+		target.rd_armed = 1;
+		target.reads++;
+	} else if (b[0] == 0x06 && len == 8 + count && !(count & 1)) {
+		if (addr < TARGET_BASE || off + count > TARGET_SIZE) {
+			target.faults++;
+			return;
+		}
+		/* Erase_Page() of the page(s), then FLASH_ProgramHalfWord() */
+		page = off / TARGET_PAGE;
+		for (i = 0; i < (count + TARGET_PAGE - 1) / TARGET_PAGE || i == 0; i++)
+			memset(&target.flash[(page + i) * TARGET_PAGE], 0xFF, TARGET_PAGE);
+		memcpy(&target.flash[off], &b[8], count);
+		target.busy_until = now + (i * T_PAGE_ERASE) + count / 2 * T_HALFWORD;
+		target.writes++;
+	} else {
+		target.bad++;
+	}
+}
+
+/* next byte of the armed read */
+static uint8_t target_read_byte(void)
+{
+	if (!target.rd_armed || target.rd_idx >= target.rd_count) {
+		target.bad++;
+		return 0xFF;
+	}
+	return target.flash[target.rd_addr + target.rd_idx++];
+}
+
+static void target_read_done(void)
+{
+	if (target.rd_armed && target.rd_idx != target.rd_count)
+		target.bad++;
+	target.rd_armed = 0;
+}
+
+/*
+ * I2C1 master at 400 kHz
+ */
+
+#define T_BIT   2500ull
+#define T_BYTE  (9 * T_BIT)
+
+I2C_TypeDef test_i2c1;
+
+enum { PH_FREE, PH_START, PH_ADDRESS, PH_DATA, PH_WAIT, PH_STOP };
+
+static struct {
+	int on, dma_en, evt_ie, err_ie, last;
+	int phase;
+	uint64_t at;            /* end of the phase, NEVER while waiting */
+	int start_req;          /* START after the STOP under way */
+	int rx;
+	int sr1_read;
+	int dr_full, shifting;
+	uint8_t dr, shift;
+	uint8_t frame[2 * TARGET_PAGE];
+	int len;
+	uint64_t busy_ns;       /* bus time, for the bounds */
+	uint64_t started;
+} i2c;
+
+#define SR1 test_i2c1.SR1
+#define SR2 test_i2c1.SR2
+
+void I2C_DeInit(I2C_TypeDef *I2Cx)
+{
+	CHECK(I2Cx == I2C1);
+	memset(&i2c, 0, sizeof(i2c));
+	memset((void *)I2Cx, 0, sizeof(*I2Cx));
+	i2c.at = NEVER;
+}
+
+void I2C_Init(I2C_TypeDef *I2Cx, I2C_InitTypeDef *init)
+{
+	CHECK(I2Cx == I2C1);
+	CHECK(init->I2C_ClockSpeed == 400000);
+	CHECK(init->I2C_Mode == I2C_Mode_I2C);
+}
+
+void I2C_Cmd(I2C_TypeDef *I2Cx, FunctionalState s)
+{
+	(void)I2Cx;
+	i2c.on = s == ENABLE;
+}
+
+void I2C_DMACmd(I2C_TypeDef *I2Cx, FunctionalState s)
+{
+	(void)I2Cx;
+	i2c.dma_en = s == ENABLE;
+}
+
+void I2C_DMALastTransferCmd(I2C_TypeDef *I2Cx, FunctionalState s)
+{
+	(void)I2Cx;
+	i2c.last = s == ENABLE;
+}
+
+void I2C_ITConfig(I2C_TypeDef *I2Cx, uint16_t it, FunctionalState s)
+{
+	(void)I2Cx;
+	CHECK(!(it & I2C_IT_BUF));
+	if (it & I2C_IT_EVT)
+		i2c.evt_ie = s == ENABLE;
+	if (it & I2C_IT_ERR)
+		i2c.err_ie = s == ENABLE;
+	irq_service();
+}
+
+void I2C_ClearITPendingBit(I2C_TypeDef *I2Cx, uint32_t it)
+{
+	(void)I2Cx;
+	SR1 &= ~(uint16_t)(it & (I2C_SR1_AF | I2C_SR1_ARLO | I2C_SR1_BERR));
+}
+
+static void i2c_begin(void)
+{
+	i2c.phase = PH_START;
+	i2c.at = now + T_BIT;
+	i2c.started = now;
+}
+
+void I2C_GenerateSTART(I2C_TypeDef *I2Cx, FunctionalState s)
+{
+	(void)I2Cx;
+	CHECK(s == ENABLE && i2c.on);
+	if (i2c.phase == PH_FREE)
+		i2c_begin();
+	else if (i2c.phase == PH_STOP)
+		i2c.start_req = 1;
+	else
+		FATAL("repeated START: the driver always sends a STOP first");
+}
+
+void I2C_GenerateSTOP(I2C_TypeDef *I2Cx, FunctionalState s)
+{
+	(void)I2Cx;
+	CHECK(s == ENABLE);
+	if (i2c.phase == PH_FREE || i2c.phase == PH_STOP)
+		return;
+	if (i2c.phase == PH_DATA && i2c.shifting)
+		FATAL("STOP while a byte is on the bus");
+	SR1 &= ~(I2C_SR1_BTF | I2C_SR1_TXE | I2C_SR1_SB | I2C_SR1_ADDR);
+	i2c.phase = PH_STOP;
+	i2c.at = now + T_BIT;
+}
+
+void I2C_Send7bitAddress(I2C_TypeDef *I2Cx, uint8_t address, uint8_t dir)
+{
+	(void)I2Cx;
+	CHECK((address & 0xFE) == TARGET_ADDRESS);
+	CHECK(i2c.phase == PH_START && (SR1 & I2C_SR1_SB) && i2c.sr1_read);
+	SR1 &= ~I2C_SR1_SB;
+	i2c.sr1_read = 0;
+	i2c.rx = dir == I2C_Direction_Receiver;
+	i2c.len = 0;
+	i2c.phase = PH_ADDRESS;
+	i2c.at = now + T_BYTE;
+}
+
+/* transmitter: DR refilled from channel 6, the shift register from DR */
+static void i2c_tx_pump(void)
+{
+	if (!i2c.dr_full && i2c.dma_en && dma_transfer(&dma6, &i2c.dr, 0))
+		i2c.dr_full = 1;
+	if (!i2c.shifting && i2c.dr_full) {
+		i2c.shift = i2c.dr;
+		i2c.dr_full = 0;
+		i2c.shifting = 1;
+		i2c.at = now + T_BYTE;
+		SR1 &= ~I2C_SR1_BTF;
+		if (i2c.dma_en && dma_transfer(&dma6, &i2c.dr, 0))
+			i2c.dr_full = 1;
+	}
+	if (i2c.dr_full)
+		SR1 &= ~I2C_SR1_TXE;
+	else
+		SR1 |= I2C_SR1_TXE;
+	if (!i2c.shifting) {
+		/* clock stretched until DR is written */
+		i2c.at = NEVER;
+		if (!i2c.dr_full && i2c.len > 0)
+			SR1 |= I2C_SR1_BTF;
+	}
+}
+
+static void i2c_dma_request(void)
+{
+	if (i2c.phase == PH_DATA && !i2c.rx)
+		i2c_tx_pump();
+	irq_service();
+}
+
+uint32_t I2C_GetLastEvent(I2C_TypeDef *I2Cx)
+{
+	uint32_t event;
+
+	(void)I2Cx;
+	event = ((uint32_t)SR2 << 16 | SR1) & 0x00FFFFFF;
+	i2c.sr1_read = 1;
+	if (SR1 & I2C_SR1_ADDR) {
+		/* SR1 then SR2 read: ADDR cleared, the data phase starts */
+		SR1 &= ~I2C_SR1_ADDR;
+		i2c.phase = PH_DATA;
+		if (i2c.rx) {
+			i2c.at = now + T_BYTE;
+		} else {
+			i2c.shifting = i2c.dr_full = 0;
+			i2c_tx_pump();
+		}
+	}
+	return event;
+}
+
+/* end of the current phase */
+static void i2c_event(void)
+{
+	uint8_t b;
+
+	i2c.at = NEVER;
+	switch (i2c.phase) {
+	case PH_START:
+		SR1 |= I2C_SR1_SB;
+		SR2 |= I2C_SR2_MSL | I2C_SR2_BUSY;
+		i2c.sr1_read = 0;
+		break;
+	case PH_ADDRESS:
+		if (!target_address(i2c.rx)) {
+			SR1 |= I2C_SR1_AF;
+			i2c.phase = PH_WAIT;
+			break;
+		}
+		SR1 |= I2C_SR1_ADDR;
+		if (i2c.rx)
+			SR2 &= ~I2C_SR2_TRA;
+		else
+			SR2 |= I2C_SR2_TRA;
+		break;
+	case PH_DATA:
+		if (i2c.rx) {
+			b = target_read_byte();
+			i2c.len++;
+			if (!dma_transfer(&dma7, &b, 1))
+				FATAL("received byte with no DMA to take it");
+			if (dma7.regs->CNDTR == 0) {
+				/* the DMA's last transfer NACKs, the bus waits for STOP */
+				if (!i2c.last)
+					FATAL("last read byte ACKed: LAST not set");
+				i2c.phase = PH_WAIT;
+			} else {
+				i2c.at = now + T_BYTE;
+			}
+		} else {
+			if (i2c.len == sizeof(i2c.frame))
+				FATAL("write longer than the target's buffer");
+			i2c.frame[i2c.len++] = i2c.shift;
+			i2c.shifting = 0;
+			i2c_tx_pump();
+		}
+		break;
+	case PH_STOP:
+		SR1 = 0;
+		SR2 = 0;
+		if (i2c.len > 0 || !i2c.rx) {
+			if (i2c.rx)
+				target_read_done();
+			else if (target.present)
+				target_command(i2c.frame, i2c.len);
+		}
+		i2c.busy_ns += now - i2c.started;
+		i2c.phase = PH_FREE;
+		i2c.shifting = i2c.dr_full = 0;
+		if (i2c.start_req) {
+			i2c.start_req = 0;
+			i2c_begin();
+		}
+		break;
+	}
+}
+
+static int irq_pending(int irq)
+{
+	switch (irq) {
+	case IRQ_I2C_EV:
+		return i2c.evt_ie && (SR1 & (I2C_SR1_SB | I2C_SR1_ADDR | I2C_SR1_BTF));
+	case IRQ_I2C_ER:
+		return i2c.err_ie && (SR1 & (I2C_SR1_AF | I2C_SR1_BERR | I2C_SR1_ARLO));
+	case IRQ_DMA6:
+		return dma6.tcie && dma6.tcif;
+	case IRQ_DMA7:
+		return dma7.tcie && dma7.tcif;
+	default:
+		return systick_pending;
+	}
+}
+
+/*
+ * Model time
+ */
+
+static uint64_t next_event(void)
+{
+	return i2c.at < systick_next ? i2c.at : systick_next;
+}
+
+static void step(void)
+{
+	uint64_t t = next_event();
+
+	if (t == NEVER)
+		FATAL("waiting with nothing to wake up");
+	now = t;
+	if (i2c.at == t) {
+		i2c_event();
+	} else {
+		systick_pending = 1;
+		systick_next += NS_PER_MS;
+	}
+	irq_service();
+}
+
+static void run_until(uint64_t t)
+{
+	while (next_event() <= t)
+		step();
+	if (t > now)
+		now = t;
+}
+
+void __WFI(void)
+{
+	CHECK(!primask);
+	wfi_count++;
+	step();
+}
+
+/*
+ * USB peripheral: EP0 only
+ */
+
+uint32_t test_pma[256];
+uint32_t test_usb_regs[32];
+static uint16_t epreg[8];
+
+#define EP_TOGGLE_BITS (EP_DTOG_RX | EPRX_STAT | EP_DTOG_TX | EPTX_STAT)
+#define EP_RW_BITS     (EP_T_FIELD | EP_KIND | EPADDR_FIELD)
+#define EP_CTR_BITS    (EP_CTR_RX | EP_CTR_TX)
+
+void test_set_endpoint(uint8_t bEpNum, uint16_t wRegValue)
+{
+	uint16_t r = epreg[bEpNum];
+
+	r = (r & ~EP_RW_BITS) | (wRegValue & EP_RW_BITS);
+	r ^= wRegValue & EP_TOGGLE_BITS;
+	r &= ~EP_CTR_BITS | (wRegValue & EP_CTR_BITS);
+	epreg[bEpNum] = r;
+}
+
+uint16_t test_get_endpoint(uint8_t bEpNum)
+{
+	return epreg[bEpNum];
+}
+
+uint16_t test_get_istr(void)
+{
+	if (epreg[0] & EP_CTR_RX)
+		return ISTR_CTR | ISTR_DIR;
+	if (epreg[0] & EP_CTR_TX)
+		return ISTR_CTR;
+	return 0;
+}
+
+static uint32_t *btable(int ep, int field)
+{
+	return &test_pma[ep * 4 + field];
+}
+
+static uint8_t pma_byte(uint16_t addr)
+{
+	return test_pma[addr >> 1] >> ((addr & 1) * 8);
+}
+
+static void pma_set_byte(uint16_t addr, uint8_t b)
+{
+	uint32_t *w = &test_pma[addr >> 1];
+
+	if (addr & 1)
+		*w = (*w & ~0xFF00u) | b << 8;
+	else
+		*w = (*w & ~0x00FFu) | b;
+}
+
+/* what the hardware does to STAT on a completed transaction */
+static void ep0_set_stat(uint16_t mask, uint16_t stat)
+{
+	epreg[0] = (epreg[0] & ~mask) | stat;
+}
+
+/*
+ * Driver glue: usb_istr.c, usb_init.c, usb_pwr.c, hw_config.c, main.c
+ */
+
+__IO uint16_t wIstr;
+uint8_t EPindex;
+DEVICE_INFO *pInformation;
+DEVICE_PROP *pProperty;
+USER_STANDARD_REQUESTS *pUser_Standard_Requests;
+DEVICE_INFO Device_Info;
+__IO uint32_t bDeviceState;
+uint8_t DeviceState;
+uint8_t DeviceStatus[6];
+static unsigned long resets;
+static uint64_t reset_at;
+
+static void nop(void)
+{
+}
+
+void (*pEpInt_IN[7])(void) = { nop, nop, nop, nop, nop, nop, nop };
+void (*pEpInt_OUT[7])(void) = { nop, nop, nop, nop, nop, nop, nop };
+
+void Get_SerialNum(void)
+{
+}
+
+RESULT PowerOn(void)
+{
+	return USB_SUCCESS;
+}
+
+uint32_t USB_SIL_Init(void)
+{
+	return 0;
+}
+
+void USB_Interrupts_Config(void)
+{
+}
+
+void Reset_Device(void)
+{
+	resets++;
+	reset_at = now;
+}
+
+/* the USB low priority interrupt, for a correct transfer */
+static void usb_isr(void)
+{
+	CHECK(running == 2);
+	running = 1;
+	CTR_LP();
+	running = 2;
+	irq_service();
+}
+
+/*
+ * Host
+ */
+
+/* a packet and its token and handshake at 12 Mbit/s, with bit stuffing */
+static uint64_t packet_ns(int len)
+{
+	return (uint64_t)(len + 14) * 8 * 1000 * 7 / (12 * 6);
+}
+
+static unsigned long transfers, naks;
+
+static int wait_stat(uint16_t mask, uint16_t valid, uint16_t stall)
+{
+	int tries;
+
+	for (tries = 0; tries < 100000; tries++) {
+		if ((epreg[0] & mask) == valid)
+			return 0;
+		if ((epreg[0] & mask) == stall)
+			return -1;
+		naks++;
+		run_until(now + packet_ns(0));
+	}
+	FATAL("EP0 NAKs for good");
+}
+
+/*
+ * A control transfer, from the next frame: the data length, or -1 if the
+ * device stalled it
+ */
+static int control(uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue,
+		   uint16_t wIndex, uint8_t *data, uint16_t wLength)
+{
+	uint8_t setup[8] = {
+		bmRequestType, bRequest, wValue, wValue >> 8,
+		wIndex, wIndex >> 8, wLength, wLength >> 8
+	};
+	uint16_t rx = *btable(0, 2), tx = *btable(0, 0);
+	int in = bmRequestType & 0x80, done = 0, n, i;
+
+	transfers++;
+	run_until((now + NS_PER_MS - 1) / NS_PER_MS * NS_PER_MS);
+
+	/* SETUP: taken whatever STAT_RX says */
+	for (i = 0; i < 8; i++)
+		pma_set_byte(rx + i, setup[i]);
+	*btable(0, 3) = (*btable(0, 3) & ~0x3FFu) | 8;
+	ep0_set_stat(EPRX_STAT | EPTX_STAT, EP_RX_NAK | EP_TX_NAK);
+	epreg[0] |= EP_CTR_RX | EP_SETUP;
+	run_until(now + packet_ns(8));
+	usb_isr();
+	epreg[0] &= ~EP_SETUP;
+
+	while (done < wLength) {
+		if (in) {
+			if (wait_stat(EPTX_STAT, EP_TX_VALID, EP_TX_STALL))
+				return -1;
+			n = *btable(0, 1) & 0x3FF;
+			CHECK(n <= 64 && done + n <= wLength);
+			for (i = 0; i < n; i++)
+				data[done + i] = pma_byte(tx + i);
+			ep0_set_stat(EPTX_STAT, EP_TX_NAK);
+			epreg[0] |= EP_CTR_TX;
+		} else {
+			if (wait_stat(EPRX_STAT, EP_RX_VALID, EP_RX_STALL))
+				return -1;
+			n = wLength - done > 64 ? 64 : wLength - done;
+			for (i = 0; i < n; i++)
+				pma_set_byte(rx + i, data[done + i]);
+			*btable(0, 3) = (*btable(0, 3) & ~0x3FFu) | n;
+			ep0_set_stat(EPRX_STAT, EP_RX_NAK);
+			epreg[0] |= EP_CTR_RX;
+		}
+		run_until(now + packet_ns(n));
+		usb_isr();
+		done += n;
+		if (n < 64)
+			break;
+	}
+
+	/* status stage */
+	if (in) {
+		if (wait_stat(EPRX_STAT, EP_RX_VALID, EP_RX_STALL))
+			return -1;
+		*btable(0, 3) &= ~0x3FFu;
+		ep0_set_stat(EPRX_STAT, EP_RX_NAK);
+		epreg[0] |= EP_CTR_RX;
+	} else {
+		if (wait_stat(EPTX_STAT, EP_TX_VALID, EP_TX_STALL))
+			return -1;
+		CHECK((*btable(0, 1) & 0x3FF) == 0);
+		ep0_set_stat(EPTX_STAT, EP_TX_NAK);
+		epreg[0] |= EP_CTR_TX;
+	}
+	run_until(now + packet_ns(0));
+	usb_isr();
+	return done;
+}
+
+#define DFU_OUT  0x21
+#define DFU_IN   0xA1
+
+static uint8_t status[6];
+static unsigned long getstatus_count;
+
+static int dfu_getstatus(void)
+{
+	getstatus_count++;
+	return control(DFU_IN, DFU_GETSTATUS, 0, 0, status, 6) == 6 ? 0 : -1;
+}
+
+static int poll_ms(void)
+{
+	return status[1] | status[2] << 8 | status[3] << 16;
+}
+
+static int dfu_dnload(uint16_t block, const uint8_t *data, uint16_t len)
+{
+	return control(DFU_OUT, DFU_DNLOAD, block, 0, (uint8_t *)data, len) < 0 ? -1 : 0;
+}
+
+static int dfu_upload(uint16_t block, uint8_t *data, uint16_t len)
+{
+	return control(DFU_IN, DFU_UPLOAD, block, 0, data, len);
+}
+
+static void dfu_clrstatus(void)
+{
+	CHECK(control(DFU_OUT, DFU_CLRSTATUS, 0, 0, NULL, 0) == 0);
+}
+
+static void dfu_abort(void)
+{
+	CHECK(control(DFU_OUT, DFU_ABORT, 0, 0, NULL, 0) == 0);
+}
+
+/* GETSTATUS until the device is past its busy states, as DfuSe does */
+static int dfu_wait(void)
+{
+	do {
+		if (dfu_getstatus())
+			return -1;
+		run_until(now + poll_ms() * NS_PER_MS);
+	} while (status[4] == STATE_dfuDNBUSY || status[4] == STATE_dfuDNLOAD_SYNC
+		 || (status[4] == STATE_dfuMANIFEST && !resets));
+	return status[4];
+}
+
+static int dfuse_command(uint8_t cmd, uint32_t addr)
+{
+	uint8_t b[5] = { cmd, addr, addr >> 8, addr >> 16, addr >> 24 };
+
+	if (dfu_dnload(0, b, 5))
+		return -1;
+	return dfu_wait();
+}
+
+/*
+ * Tests
+ */
+
+#define IMAGE_BASE   0x1000u
+#define IMAGE_PAGES  124
+
+static uint8_t image[IMAGE_PAGES * TARGET_PAGE];
+
+static void bring_up(void)
+{
+	uint8_t buf[4];
+
+	memset(&target, 0, sizeof(target));
+	memset(target.flash, 0xA5, sizeof(target.flash));
+	target.present = 1;
+
+	DeviceState = STATE_dfuERROR;
+	DeviceStatus[0] = STATUS_ERRFIRMWARE;
+	DeviceStatus[4] = DeviceState;
+
+	/* Set_System() then USB_Init() */
+	NVIC_PriorityGroupConfig(NVIC_PriorityGroup_1);
+	MAL_Init();
+	pInformation = &Device_Info;
+	pInformation->ControlState = 2;
+	pProperty = &Device_Property;
+	pUser_Standard_Requests = &User_Standard_Requests;
+	pProperty->Init();
+	pProperty->Reset();
+	CHECK(nvic_enabled[IRQ_I2C_EV] && nvic_enabled[IRQ_I2C_ER]
+	      && nvic_enabled[IRQ_DMA6] && nvic_enabled[IRQ_DMA7]
+	      && i2c.err_ie && dma6.tcie && dma7.tcie);
+
+	CHECK(control(0x00, SET_ADDRESS, 5, 0, NULL, 0) == 0);
+	CHECK(control(0x00, SET_CONFIGURATION, 1, 0, NULL, 0) == 0);
+	CHECK(bDeviceState == CONFIGURED);
+	CHECK(control(0x80, GET_CONFIGURATION, 0, 0, buf, 1) == 1 && buf[0] == 1);
+
+	CHECK(dfu_getstatus() == 0 && status[4] == STATE_dfuERROR);
+	dfu_clrstatus();
+	CHECK(dfu_getstatus() == 0 && status[4] == STATE_dfuIDLE);
+
+	/* GETCOMMANDS lists the batch command */
+	CHECK(dfu_upload(0, buf, 4) == 4);
+	CHECK(buf[0] == CMD_GETCOMMANDS && buf[1] == CMD_SETADDRESSPOINTER
+	      && buf[2] == CMD_ERASE && buf[3] == CMD_BATCH);
+	dfu_abort();
+}
+
+static double kbps(uint32_t bytes, uint64_t ns)
+{
+	return bytes * 1e9 / ns / 1024;
+}
+
+/* bus time of a page write or read: START, address, bytes, STOP */
+static uint64_t frame_ns(int bytes)
+{
+	return T_BIT + (uint64_t)(bytes + 1) * T_BYTE + T_BIT;
+}
+
+static void test_download(void)
+{
+	uint64_t t0, t, bound;
+	uint32_t p;
+	int i;
+
+	for (i = 0; i < (int)sizeof(image); i++)
+		image[i] = rand();
+
+	/* DfuSe: erase the pages, set the address, blocks from 2 on */
+	for (p = 0; p < IMAGE_PAGES; p++)
+		CHECK(dfuse_command(CMD_ERASE, IMAGE_BASE + p * TARGET_PAGE)
+		      == STATE_dfuDNLOAD_IDLE);
+	CHECK(dfuse_command(CMD_SETADDRESSPOINTER, IMAGE_BASE) == STATE_dfuDNLOAD_IDLE);
+	t0 = now;
+	for (p = 0; p < IMAGE_PAGES; p++) {
+		CHECK(dfu_dnload(2 + p, &image[p * TARGET_PAGE], TARGET_PAGE) == 0);
+		CHECK(dfu_wait() == STATE_dfuDNLOAD_IDLE);
+	}
+	/* manifestation: done once the last page is programmed */
+	CHECK(dfu_dnload(0, NULL, 0) == 0);
+	CHECK(dfu_wait() == STATE_dfuMANIFEST);
+	CHECK(resets == 1);
+	/* the device leaves for its application once the last page is in */
+	CHECK(reset_at >= target.busy_until);
+	t = reset_at - t0;
+
+	CHECK(memcmp(&target.flash[IMAGE_BASE], image, sizeof(image)) == 0);
+	for (i = 0; i < (int)IMAGE_BASE; i++)
+		CHECK(target.flash[i] == 0xA5);
+	CHECK(target.writes == IMAGE_PAGES);
+	CHECK(target.lost == 0 && target.bad == 0 && target.faults == 0);
+	CHECK(I2C_FLASH_Stats.BytesWritten == sizeof(image));
+	CHECK(I2C_FLASH_Stats.Errors == 0);
+	/* the host never waits while a slot is free */
+	CHECK(I2C_FLASH_Stats.PagesQueued >= IMAGE_PAGES - 2);
+
+	/* each page: on the bus, then held off while the target programs */
+	bound = IMAGE_PAGES * (frame_ns(8 + TARGET_PAGE)
+			       + I2C_FLASH_PROGRAM_TIME * NS_PER_MS);
+	printf("download: %u bytes in %.1f ms, %.2f KB/s (bound %.2f KB/s), "
+	       "%lu transfers, %lu GETSTATUS, queue full %lu times\n",
+	       (unsigned)sizeof(image), t / 1e6, kbps(sizeof(image), t),
+	       kbps(sizeof(image), bound), transfers, getstatus_count,
+	       (unsigned long)I2C_FLASH_Stats.QueueFull);
+	CHECK(t >= bound && t <= bound + bound / 50);
+}
+
+static void test_upload(void)
+{
+	static uint8_t buf[sizeof(image)];
+	uint32_t hits = I2C_FLASH_Stats.ReadHits, misses = I2C_FLASH_Stats.ReadMisses;
+	uint64_t t0, t, bound, bus0 = i2c.busy_ns;
+	uint32_t p;
+
+	/* out of manifestation: the device came back after the reset */
+	DeviceState = STATE_dfuIDLE;
+	DeviceStatus[4] = DeviceState;
+
+	CHECK(dfuse_command(CMD_SETADDRESSPOINTER, IMAGE_BASE) == STATE_dfuDNLOAD_IDLE);
+	dfu_abort();
+	t0 = now;
+	for (p = 0; p < IMAGE_PAGES; p++)
+		CHECK(dfu_upload(2 + p, &buf[p * TARGET_PAGE], TARGET_PAGE)
+		      == TARGET_PAGE);
+	t = now - t0;
+	dfu_abort();
+
+	CHECK(memcmp(buf, image, sizeof(image)) == 0);
+	CHECK(target.lost == 0 && target.bad == 0 && target.faults == 0);
+	/* one read on demand, the others read ahead */
+	CHECK(I2C_FLASH_Stats.ReadMisses - misses == 1);
+	CHECK(I2C_FLASH_Stats.ReadHits - hits == IMAGE_PAGES - 1);
+	/* the read ahead of the last page stops at the end of the flash */
+	CHECK(target.reads <= IMAGE_PAGES + 1);
+
+	bound = IMAGE_PAGES * (frame_ns(7) + frame_ns(TARGET_PAGE));
+	printf("upload: %u bytes in %.1f ms, %.2f KB/s (bound %.2f KB/s), "
+	       "bus busy %.1f ms\n",
+	       (unsigned)sizeof(image), t / 1e6, kbps(sizeof(image), t),
+	       kbps(sizeof(image), bound), (i2c.busy_ns - bus0) / 1e6);
+	/* a frame for the first request, one for the last */
+	CHECK(t >= bound && t <= bound + 2 * NS_PER_MS);
+}
+
+/* a page read ahead, then written: the upload returns the new data */
+static void test_read_after_write(void)
+{
+	static uint8_t page[TARGET_PAGE], buf[TARGET_PAGE];
+	uint32_t addr = 0x8000;
+	int i;
+
+	for (i = 0; i < TARGET_PAGE; i++)
+		page[i] = i ^ 0x5A;
+	CHECK(dfuse_command(CMD_SETADDRESSPOINTER, addr) == STATE_dfuDNLOAD_IDLE);
+	dfu_abort();
+	CHECK(dfu_upload(2, buf, TARGET_PAGE) == TARGET_PAGE);
+	dfu_abort();
+	CHECK(memcmp(buf, &target.flash[addr], TARGET_PAGE) == 0);
+
+	/* the next page is in the ring now */
+	CHECK(dfuse_command(CMD_SETADDRESSPOINTER, addr + TARGET_PAGE) == STATE_dfuDNLOAD_IDLE);
+	CHECK(dfu_dnload(2, page, TARGET_PAGE) == 0);
+	CHECK(dfu_wait() == STATE_dfuDNLOAD_IDLE);
+	dfu_abort();
+	CHECK(dfu_upload(2, buf, TARGET_PAGE) == TARGET_PAGE);
+	dfu_abort();
+	CHECK(memcmp(buf, page, TARGET_PAGE) == 0);
+	CHECK(memcmp(&target.flash[addr + TARGET_PAGE], page, TARGET_PAGE) == 0);
+	CHECK(target.lost == 0 && target.bad == 0);
+}
+
+static int put_record(uint8_t *b, uint8_t cmd, uint32_t addr,
+		      const uint8_t *data, uint16_t count)
+{
+	int n = 5;
+
+	b[0] = cmd;
+	b[1] = addr;
+	b[2] = addr >> 8;
+	b[3] = addr >> 16;
+	b[4] = addr >> 24;
+	if (cmd == CMD_WRITEMEMORY) {
+		b[5] = count;
+		b[6] = count >> 8;
+		memcpy(&b[7], data, count);
+		n += 2 + count;
+	}
+	return n;
+}
+
+static void test_batch(void)
+{
+	static const struct { uint32_t addr; uint16_t count; } w[] = {
+		{ 0x3000, 100 }, { 0x5000, 300 }, { 0x7010, 64 }, { 0x9000, 33 },
+		{ 0xA000, 200 },
+	};
+	uint8_t block[TARGET_PAGE], data[300], buf[TARGET_PAGE];
+	unsigned long t0 = transfers;
+	uint32_t batches = I2C_FLASH_Stats.Batches;
+	int n = 0, i, j;
+
+	for (i = 0; i < (int)sizeof(data); i++)
+		data[i] = rand();
+	block[n++] = CMD_BATCH;
+	for (i = 0; i < 5; i++)
+		n += put_record(&block[n], CMD_WRITEMEMORY, w[i].addr, data, w[i].count);
+	n += put_record(&block[n], CMD_ERASE, 0x3000, NULL, 0);
+	n += put_record(&block[n], CMD_SETADDRESSPOINTER, 0x7000, NULL, 0);
+	CHECK(n <= TARGET_PAGE);
+
+	CHECK(dfu_dnload(0, block, n) == 0);
+	CHECK(dfu_wait() == STATE_dfuDNLOAD_IDLE);
+	CHECK(I2C_FLASH_Stats.Batches == batches + 1);
+	/* five writes in one block, two slots: the host waited for them */
+	CHECK(I2C_FLASH_Stats.QueueFull > 0);
+	printf("batch: 5 writes and 2 commands in %lu control transfers\n",
+	       transfers - t0);
+	CHECK(transfers - t0 < 5 * 2);
+
+	/* the pointer the batch set; the page erased around the write */
+	dfu_abort();
+	CHECK(dfu_upload(2, buf, TARGET_PAGE) == TARGET_PAGE);
+	dfu_abort();
+	for (j = 0; j < TARGET_PAGE; j++)
+		CHECK(buf[j] == (j >= 0x10 && j < 0x10 + 64 ? data[j - 0x10] : 0xFF));
+
+	for (i = 0; i < 5; i++) {
+		uint32_t page = w[i].addr & ~(TARGET_PAGE - 1);
+
+		CHECK(memcmp(&target.flash[w[i].addr], data, w[i].count) == 0);
+		for (j = page; j < (int)w[i].addr; j++)
+			CHECK(target.flash[j] == 0xFF);
+		/* an odd count is padded to the halfword */
+		for (j = w[i].addr + w[i].count; j < (int)(page + TARGET_PAGE); j++)
+			CHECK(target.flash[j] == 0xFF);
+	}
+	CHECK(target.lost == 0 && target.bad == 0);
+
+	/* a record running past the block */
+	n = 0;
+	block[n++] = CMD_BATCH;
+	n += put_record(&block[n], CMD_WRITEMEMORY, 0x3000, data, 64);
+	block[n - 64 - 2] = 0xFF;
+	CHECK(dfu_dnload(0, block, n) == 0);
+	CHECK(dfu_wait() == STATE_dfuERROR && status[0] == STATUS_ERRFILE);
+	dfu_clrstatus();
+	/* and an unknown one */
+	block[1] = 0x77;
+	CHECK(dfu_dnload(0, block, 6) == 0);
+	CHECK(dfu_wait() == STATE_dfuERROR && status[0] == STATUS_ERRFILE);
+	dfu_clrstatus();
+}
+
+/* the counters as upload block 1 */
+static void test_counters(void)
+{
+	I2C_FLASH_Stats_TypeDef stats;
+
+	CHECK(dfu_upload(1, (uint8_t *)&stats, sizeof(stats)) == sizeof(stats));
+	dfu_abort();
+	CHECK(stats.BytesWritten == I2C_FLASH_Stats.BytesWritten);
+	CHECK(stats.BytesRead == I2C_FLASH_Stats.BytesRead);
+	CHECK(stats.ReadHits == I2C_FLASH_Stats.ReadHits);
+	CHECK(stats.Time > 0 && stats.Time <= now / NS_PER_MS);
+	CHECK(stats.BusTime > 0 && stats.ProgramTime > 0);
+	CHECK(stats.BusTime + stats.ProgramTime <= stats.Time);
+	printf("counters: written %u read %u hits %u misses %u queued %u "
+	       "full %u batches %u bus %u ms program %u ms of %u ms, errors %u\n",
+	       stats.BytesWritten, stats.BytesRead, stats.ReadHits,
+	       stats.ReadMisses, stats.PagesQueued, stats.QueueFull,
+	       stats.Batches, stats.BusTime, stats.ProgramTime, stats.Time,
+	       stats.Errors);
+}
+
+/* a target out of IAP mode NACKs: requests fail, nothing hangs */
+static void test_no_target(void)
+{
+	uint8_t buf[TARGET_PAGE];
+	uint32_t errors = I2C_FLASH_Stats.Errors;
+
+	target.present = 0;
+	CHECK(dfuse_command(CMD_SETADDRESSPOINTER, 0x10000) == STATE_dfuDNLOAD_IDLE);
+	dfu_abort();
+	CHECK(dfu_upload(2, buf, TARGET_PAGE) == -1);
+	CHECK(dfu_getstatus() == 0 && status[4] == STATE_dfuERROR
+	      && status[0] == STATUS_ERRUNKNOWN);
+	dfu_clrstatus();
+	CHECK(I2C_FLASH_Stats.Errors > errors);
+
+	/* a page written to nobody fails the manifestation */
+	resets = 0;
+	memset(buf, 0x11, sizeof(buf));
+	CHECK(dfuse_command(CMD_SETADDRESSPOINTER, 0x10000) == STATE_dfuDNLOAD_IDLE);
+	CHECK(dfu_dnload(2, buf, TARGET_PAGE) == 0);
+	CHECK(dfu_wait() == STATE_dfuDNLOAD_IDLE);
+	CHECK(dfu_dnload(0, NULL, 0) == 0);
+	CHECK(dfu_wait() == STATE_dfuERROR && status[0] == STATUS_ERRWRITE);
+	CHECK(resets == 0);
+	dfu_clrstatus();
+
+	/* back in IAP mode */
+	target.present = 1;
+	CHECK(dfuse_command(CMD_SETADDRESSPOINTER, IMAGE_BASE) == STATE_dfuDNLOAD_IDLE);
+	dfu_abort();
+	CHECK(dfu_upload(2, buf, TARGET_PAGE) == TARGET_PAGE);
+	dfu_abort();
+	CHECK(memcmp(buf, image, TARGET_PAGE) == 0);
+}
+
+int main(void)
+{
+	if (!getenv("VERBOSE"))
+		freopen("/dev/null", "w", stdout);
+
+	srand(1);
+	bring_up();
+	test_download();
+	test_upload();
+	test_read_after_write();
+	test_batch();
+	test_counters();
+	test_no_target();
+	printf("%lu WFI wake-ups, %lu NAKs\n", wfi_count, naks);
+
+	if (failures) {
+		fprintf(stderr, "test_i2cbridge: %d failures\n", failures);
+		return 1;
+	}
+	fprintf(stderr, "test_i2cbridge: ok\n");
+	return 0;
+}
@@ -0,0 +1,114 @@
+/*
+ * Stands in for stm32_eval.h and the StdPeriph headers behind it: just
+ * enough I2C and DMA for the M24Cxx driver, plus the STM3210C-EVAL sEE
+ * resources (M24C64 on I2C1, DMA1 channels 6 and 7). The test owns the
+ * peripherals and the EEPROM model behind them.
+ */
+#ifndef STM32_EVAL_H
+#define STM32_EVAL_H
+
+#include <stdint.h>
+
+#define __IO volatile
+
+typedef enum { RESET = 0, SET = !RESET } FlagStatus, ITStatus;
+typedef enum { DISABLE = 0, ENABLE = !DISABLE } FunctionalState;
+typedef enum { ERROR = 0, SUCCESS = !ERROR } ErrorStatus;
+
+typedef struct {
+	__IO uint16_t CR1;
+	__IO uint16_t SR1;
+	__IO uint16_t SR2;
+} I2C_TypeDef;
+typedef struct { int index; } DMA_Channel_TypeDef;
+
+extern I2C_TypeDef test_i2c1;
+extern DMA_Channel_TypeDef test_dma1_ch6, test_dma1_ch7;
+
+#define I2C1           (&test_i2c1)
+#define DMA1_Channel6  (&test_dma1_ch6)
+#define DMA1_Channel7  (&test_dma1_ch7)
+
+#define DMA1_IT_GL6    ((uint32_t)0x00100000)
+#define DMA1_IT_TC6    ((uint32_t)0x00200000)
+#define DMA1_IT_GL7    ((uint32_t)0x01000000)
+#define DMA1_IT_TC7    ((uint32_t)0x02000000)
+
+/* stm3210c_eval.h */
+#define sEE_I2C                          I2C1
+#define sEE_M24C64_32
+#define sEE_I2C_DMA_CHANNEL_TX           DMA1_Channel6
+#define sEE_I2C_DMA_CHANNEL_RX           DMA1_Channel7
+#define sEE_I2C_DMA_FLAG_TX_TC           DMA1_IT_TC6
+#define sEE_I2C_DMA_FLAG_TX_GL           DMA1_IT_GL6
+#define sEE_I2C_DMA_FLAG_RX_TC           DMA1_IT_TC7
+#define sEE_I2C_DMA_FLAG_RX_GL           DMA1_IT_GL7
+#define sEE_DIRECTION_TX                 0
+#define sEE_DIRECTION_RX                 1
+
+/* stm32f10x.h */
+#define I2C_CR1_STOP    ((uint16_t)0x0200)
+#define I2C_SR1_SB      ((uint16_t)0x0001)
+#define I2C_SR1_ADDR    ((uint16_t)0x0002)
+#define I2C_SR1_BTF     ((uint16_t)0x0004)
+#define I2C_SR1_RXNE    ((uint16_t)0x0040)
+#define I2C_SR1_TXE     ((uint16_t)0x0080)
+#define I2C_SR1_AF      ((uint16_t)0x0400)
+#define I2C_SR2_MSL     ((uint16_t)0x0001)
+#define I2C_SR2_BUSY    ((uint16_t)0x0002)
+#define I2C_SR2_TRA     ((uint16_t)0x0004)
+
+/* core_cm3.h */
+static inline void __disable_irq(void) {}
+static inline void __enable_irq(void) {}
+
+/* stm32f10x_i2c.h */
+typedef struct {
+	uint32_t I2C_ClockSpeed;
+	uint16_t I2C_Mode, I2C_DutyCycle, I2C_OwnAddress1, I2C_Ack;
+	uint16_t I2C_AcknowledgedAddress;
+} I2C_InitTypeDef;
+
+#define I2C_Mode_I2C                    ((uint16_t)0x0000)
+#define I2C_DutyCycle_2                 ((uint16_t)0xBFFF)
+#define I2C_Ack_Enable                  ((uint16_t)0x0400)
+#define I2C_AcknowledgedAddress_7bit    ((uint16_t)0x4000)
+#define I2C_Direction_Transmitter       ((uint8_t)0x00)
+#define I2C_Direction_Receiver          ((uint8_t)0x01)
+
+#define I2C_FLAG_BUSY                   ((uint32_t)0x00020000)
+#define I2C_FLAG_AF                     ((uint32_t)0x10000400)
+#define I2C_FLAG_RXNE                   ((uint32_t)0x10000040)
+#define I2C_FLAG_BTF                    ((uint32_t)0x10000004)
+#define I2C_FLAG_ADDR                   ((uint32_t)0x10000002)
+
+#define I2C_EVENT_MASTER_MODE_SELECT                 ((uint32_t)0x00030001)
+#define I2C_EVENT_MASTER_TRANSMITTER_MODE_SELECTED   ((uint32_t)0x00070082)
+#define I2C_EVENT_MASTER_RECEIVER_MODE_SELECTED      ((uint32_t)0x00030002)
+#define I2C_EVENT_MASTER_BYTE_TRANSMITTED            ((uint32_t)0x00070084)
+
+void I2C_Init(I2C_TypeDef *I2Cx, I2C_InitTypeDef *init);
+void I2C_Cmd(I2C_TypeDef *I2Cx, FunctionalState state);
+void I2C_DMACmd(I2C_TypeDef *I2Cx, FunctionalState state);
+void I2C_DMALastTransferCmd(I2C_TypeDef *I2Cx, FunctionalState state);
+void I2C_GenerateSTART(I2C_TypeDef *I2Cx, FunctionalState state);
+void I2C_GenerateSTOP(I2C_TypeDef *I2Cx, FunctionalState state);
+void I2C_AcknowledgeConfig(I2C_TypeDef *I2Cx, FunctionalState state);
+void I2C_Send7bitAddress(I2C_TypeDef *I2Cx, uint8_t address, uint8_t direction);
+void I2C_SendData(I2C_TypeDef *I2Cx, uint8_t data);
+uint8_t I2C_ReceiveData(I2C_TypeDef *I2Cx);
+ErrorStatus I2C_CheckEvent(I2C_TypeDef *I2Cx, uint32_t event);
+FlagStatus I2C_GetFlagStatus(I2C_TypeDef *I2Cx, uint32_t flag);
+void I2C_ClearFlag(I2C_TypeDef *I2Cx, uint32_t flag);
+
+/* stm32f10x_dma.h */
+void DMA_Cmd(DMA_Channel_TypeDef *ch, FunctionalState state);
+FlagStatus DMA_GetFlagStatus(uint32_t flag);
+void DMA_ClearFlag(uint32_t flag);
+
+/* stm3210c_eval.c */
+void sEE_LowLevel_DeInit(void);
+void sEE_LowLevel_Init(void);
+void sEE_LowLevel_DMAConfig(uint32_t pBuffer, uint32_t BufferSize, uint32_t Direction);
+
+#endif
@@ -0,0 +1,850 @@
+/*
+ * Runs the sEE driver (stm32_eval_i2c_ee.c) against a model of the
+ * M24C64 on the STM3210C-EVAL, and measures its write-back cache.
+ *
+ * The model follows the master through START, address, data and STOP.
+ * A write sets the 13-bit address pointer with its first two bytes and
+ * latches the rest into the page (the address wraps at the page end);
+ * the STOP starts a 5 ms write cycle during which the EEPROM does not
+ * acknowledge its address. A read streams from the address pointer.
+ * Data sent outside a transaction, a START in the middle of a write or
+ * read, a DMA started in the wrong phase and a page write that wraps are
+ * counted as protocol errors; a timeout shows up as a call of
+ * sEE_TIMEOUT_UserCallback().
+ *
+ * Time only moves with the bus: 30 us per byte at 300 kHz (address
+ * byte, data byte or ACK poll), 5 us per START or STOP. The DMA runs to
+ * completion as soon as it is enabled, its interrupt included; its bus
+ * time is counted apart so that the CPU time of a call can be told. While
+ * the application "works", a 1 kHz timer interrupt calls
+ * sEE_PollHandler(). Interrupts can also be injected in the middle of a
+ * driver call.
+ *
+ * The DMA addresses go through 32-bit integers, so the test is linked
+ * without PIE and runs on a stack mapped below 2 GB.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+
+#include "stm32_eval.h"
+#include "stm32_eval_i2c_ee.h"
+
+I2C_TypeDef test_i2c1;
+DMA_Channel_TypeDef test_dma1_ch6 = { 6 }, test_dma1_ch7 = { 7 };
+
+static int failures;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: check failed: %s\n", \
+			__FILE__, __LINE__, #cond); \
+		failures++; \
+	} } while (0)
+
+/*
+ * M24C64
+ */
+
+#define EE_SIZE      8192u
+#define PAGE_SIZE    32u
+#define EE_ADDRESS   0xA0
+
+#define BYTE_NS      30000ull
+#define EDGE_NS      5000ull
+#define TW_NS        5000000ull
+#define TICK_NS      1000000ull
+
+enum { PH_IDLE, PH_ADDRESS, PH_PTR_HI, PH_PTR_LO, PH_DATA, PH_READ };
+
+static uint8_t mem[EE_SIZE];
+static uint8_t ref[EE_SIZE];
+
+static struct {
+	unsigned long long t;
+	unsigned long long busy_until;
+	unsigned long long dma_ns;
+	int phase;
+	int tra;
+	int sb, addr, af, btf, rxne;
+	uint16_t ptr;
+	uint16_t page;                  /* page latched by the write */
+	uint8_t latch[PAGE_SIZE];
+	uint32_t latched;               /* latch bytes written */
+	int n;                          /* data bytes of the write */
+	uint8_t rx;
+	int read_n;                     /* bytes read by DMA */
+	unsigned long polls;            /* addresses not acknowledged */
+	unsigned long transactions;
+	unsigned long page_writes;
+	unsigned long errors;
+	int log_on;
+	int log_n;
+	struct { uint16_t page; uint8_t first; } log[64];
+} ee;
+
+static unsigned long timeouts;
+
+static int ee_busy(void)
+{
+	return ee.t < ee.busy_until;
+}
+
+static void ee_sync(void)
+{
+	test_i2c1.SR1 = (ee.sb ? I2C_SR1_SB : 0) | (ee.addr ? I2C_SR1_ADDR : 0) |
+		(ee.btf ? I2C_SR1_BTF : 0) | (ee.rxne ? I2C_SR1_RXNE : 0) |
+		(ee.af ? I2C_SR1_AF : 0) | (ee.tra ? I2C_SR1_TXE : 0);
+	test_i2c1.SR2 = ee.phase != PH_IDLE ?
+		(I2C_SR2_MSL | I2C_SR2_BUSY | (ee.tra ? I2C_SR2_TRA : 0)) : 0;
+	test_i2c1.CR1 = 0;
+}
+
+static void ee_write_byte(uint8_t b)
+{
+	ee.t += BYTE_NS;
+	ee.btf = 1;
+	switch (ee.phase) {
+	case PH_PTR_HI:
+		ee.ptr = (uint16_t)(b << 8);
+		ee.phase = PH_PTR_LO;
+		break;
+	case PH_PTR_LO:
+		ee.ptr = (ee.ptr | b) & (EE_SIZE - 1);
+		ee.page = ee.ptr / PAGE_SIZE;
+		ee.latched = 0;
+		ee.n = 0;
+		ee.phase = PH_DATA;
+		break;
+	case PH_DATA:
+		if ((ee.ptr % PAGE_SIZE) + ee.n >= PAGE_SIZE)
+			ee.errors++;            /* wraps within the page */
+		ee.latch[(ee.ptr + ee.n) % PAGE_SIZE] = b;
+		ee.latched |= 1u << ((ee.ptr + ee.n) % PAGE_SIZE);
+		ee.n++;
+		break;
+	default:
+		ee.errors++;
+		ee.btf = 0;
+		break;
+	}
+	ee_sync();
+}
+
+static uint8_t ee_read_byte(void)
+{
+	uint8_t b = mem[ee.ptr];
+
+	ee.ptr = (ee.ptr + 1) & (EE_SIZE - 1);
+	ee.t += BYTE_NS;
+	return b;
+}
+
+/*
+ * Peripherals
+ */
+
+static struct {
+	uint32_t buffer, size;
+	int enabled;
+} dma[2];
+static uint32_t dma_flags;
+
+static int irq_countdown;
+static void timer_isr(void);
+
+void sEE_I2C_DMA_TX_IRQHandler(void);
+void sEE_I2C_DMA_RX_IRQHandler(void);
+
+static void maybe_irq(void)
+{
+	if (irq_countdown > 0 && --irq_countdown == 0)
+		timer_isr();
+}
+
+void sEE_LowLevel_Init(void) {}
+void sEE_LowLevel_DeInit(void) {}
+void I2C_Init(I2C_TypeDef *I2Cx, I2C_InitTypeDef *init) { (void)I2Cx; (void)init; }
+void I2C_Cmd(I2C_TypeDef *I2Cx, FunctionalState state) { (void)I2Cx; (void)state; }
+void I2C_DMACmd(I2C_TypeDef *I2Cx, FunctionalState state) { (void)I2Cx; (void)state; }
+void I2C_DMALastTransferCmd(I2C_TypeDef *I2Cx, FunctionalState state) { (void)I2Cx; (void)state; }
+void I2C_AcknowledgeConfig(I2C_TypeDef *I2Cx, FunctionalState state) { (void)I2Cx; (void)state; }
+
+void I2C_GenerateSTART(I2C_TypeDef *I2Cx, FunctionalState state)
+{
+	(void)I2Cx;
+	(void)state;
+	/* a repeated START may only follow the address pointer of a read */
+	if (ee.phase == PH_READ || ee.phase == PH_PTR_HI ||
+	    ee.phase == PH_PTR_LO || (ee.phase == PH_DATA && ee.n > 0))
+		ee.errors++;
+	ee.phase = PH_ADDRESS;
+	ee.sb = 1;
+	ee.addr = ee.btf = ee.rxne = ee.tra = 0;
+	ee.t += EDGE_NS;
+	ee_sync();
+}
+
+void I2C_GenerateSTOP(I2C_TypeDef *I2Cx, FunctionalState state)
+{
+	(void)I2Cx;
+	(void)state;
+	if (ee.phase == PH_DATA && ee.n > 0) {
+		uint32_t i, base = ee.page * PAGE_SIZE;
+
+		for (i = 0; i < PAGE_SIZE; i++)
+			if (ee.latched & (1u << i))
+				mem[base + i] = ee.latch[i];
+		ee.busy_until = ee.t + EDGE_NS + TW_NS;
+		ee.page_writes++;
+		if (ee.log_on && ee.log_n < 64) {
+			ee.log[ee.log_n].page = ee.page;
+			ee.log[ee.log_n].first = ee.latch[ee.ptr % PAGE_SIZE];
+			ee.log_n++;
+		}
+	}
+	/* a single byte read comes in once ACK is off and STOP is set */
+	if (ee.phase == PH_READ && ee.read_n == 0) {
+		ee.rx = ee_read_byte();
+		ee.rxne = 1;
+	}
+	ee.phase = PH_IDLE;
+	ee.sb = ee.addr = ee.btf = ee.tra = 0;
+	ee.t += EDGE_NS;
+	ee_sync();
+	maybe_irq();
+}
+
+void I2C_Send7bitAddress(I2C_TypeDef *I2Cx, uint8_t address, uint8_t direction)
+{
+	(void)I2Cx;
+	if (ee.phase != PH_ADDRESS || !ee.sb)
+		ee.errors++;
+	ee.sb = 0;
+	ee.t += BYTE_NS;
+	ee.transactions++;
+	if ((address & 0xFE) != EE_ADDRESS || ee_busy()) {
+		ee.af = 1;
+		ee.polls++;
+	} else {
+		ee.addr = 1;
+		ee.tra = direction == I2C_Direction_Transmitter;
+		if (ee.tra) {
+			ee.phase = PH_PTR_HI;
+		} else {
+			ee.phase = PH_READ;
+			ee.read_n = 0;
+		}
+	}
+	ee_sync();
+	maybe_irq();
+}
+
+void I2C_SendData(I2C_TypeDef *I2Cx, uint8_t data)
+{
+	(void)I2Cx;
+	ee_write_byte(data);
+	maybe_irq();
+}
+
+uint8_t I2C_ReceiveData(I2C_TypeDef *I2Cx)
+{
+	(void)I2Cx;
+	if (!ee.rxne)
+		ee.errors++;
+	ee.rxne = 0;
+	ee_sync();
+	return ee.rx;
+}
+
+ErrorStatus I2C_CheckEvent(I2C_TypeDef *I2Cx, uint32_t event)
+{
+	(void)I2Cx;
+	switch (event) {
+	case I2C_EVENT_MASTER_MODE_SELECT:
+		return ee.sb ? SUCCESS : ERROR;
+	case I2C_EVENT_MASTER_TRANSMITTER_MODE_SELECTED:
+		if (!ee.addr || !ee.tra)
+			return ERROR;
+		ee.addr = 0;            /* SR1 then SR2 read */
+		ee_sync();
+		return SUCCESS;
+	case I2C_EVENT_MASTER_RECEIVER_MODE_SELECTED:
+		if (!ee.addr || ee.tra)
+			return ERROR;
+		ee.addr = 0;
+		ee_sync();
+		return SUCCESS;
+	case I2C_EVENT_MASTER_BYTE_TRANSMITTED:
+		return ee.btf && ee.tra ? SUCCESS : ERROR;
+	}
+	return ERROR;
+}
+
+FlagStatus I2C_GetFlagStatus(I2C_TypeDef *I2Cx, uint32_t flag)
+{
+	(void)I2Cx;
+	switch (flag) {
+	case I2C_FLAG_BUSY:
+		return ee.phase != PH_IDLE ? SET : RESET;
+	case I2C_FLAG_BTF:
+		return ee.btf ? SET : RESET;
+	case I2C_FLAG_ADDR:
+		return ee.addr ? SET : RESET;
+	case I2C_FLAG_RXNE:
+		return ee.rxne ? SET : RESET;
+	}
+	return RESET;
+}
+
+void I2C_ClearFlag(I2C_TypeDef *I2Cx, uint32_t flag)
+{
+	(void)I2Cx;
+	if (flag == I2C_FLAG_AF)
+		ee.af = 0;
+	ee_sync();
+}
+
+void sEE_LowLevel_DMAConfig(uint32_t pBuffer, uint32_t BufferSize, uint32_t Direction)
+{
+	dma[Direction].buffer = pBuffer;
+	dma[Direction].size = BufferSize;
+}
+
+/* The transfer runs as soon as the channel is enabled. */
+void DMA_Cmd(DMA_Channel_TypeDef *ch, FunctionalState state)
+{
+	int dir = ch->index == 6 ? sEE_DIRECTION_TX : sEE_DIRECTION_RX;
+	uint8_t *p = (uint8_t *)(uintptr_t)dma[dir].buffer;
+	unsigned long long t0 = ee.t;
+	uint32_t i;
+
+	dma[dir].enabled = state == ENABLE;
+	if (state != ENABLE)
+		return;
+	if (dir == sEE_DIRECTION_TX) {
+		if (ee.phase != PH_DATA || dma[dir].size == 0)
+			ee.errors++;
+		for (i = 0; i < dma[dir].size; i++)
+			ee_write_byte(p[i]);
+		ee.dma_ns += ee.t - t0;
+		dma_flags |= sEE_I2C_DMA_FLAG_TX_TC | sEE_I2C_DMA_FLAG_TX_GL;
+		sEE_I2C_DMA_TX_IRQHandler();
+	} else {
+		if (ee.phase != PH_READ || dma[dir].size < 2)
+			ee.errors++;
+		for (i = 0; i < dma[dir].size; i++)
+			p[i] = ee_read_byte();
+		ee.read_n = dma[dir].size;
+		ee.dma_ns += ee.t - t0;
+		dma_flags |= sEE_I2C_DMA_FLAG_RX_TC | sEE_I2C_DMA_FLAG_RX_GL;
+		sEE_I2C_DMA_RX_IRQHandler();
+	}
+}
+
+FlagStatus DMA_GetFlagStatus(uint32_t flag)
+{
+	return (dma_flags & flag) ? SET : RESET;
+}
+
+void DMA_ClearFlag(uint32_t flag)
+{
+	/* the GL flag clears the whole channel */
+	if (flag & (sEE_I2C_DMA_FLAG_TX_GL))
+		dma_flags &= ~(sEE_I2C_DMA_FLAG_TX_GL | sEE_I2C_DMA_FLAG_TX_TC);
+	if (flag & (sEE_I2C_DMA_FLAG_RX_GL))
+		dma_flags &= ~(sEE_I2C_DMA_FLAG_RX_GL | sEE_I2C_DMA_FLAG_RX_TC);
+}
+
+uint32_t sEE_TIMEOUT_UserCallback(void)
+{
+	/* what an application would do: release the bus and carry on */
+	timeouts++;
+	ee.phase = PH_IDLE;
+	ee.sb = ee.addr = ee.btf = ee.af = ee.tra = 0;
+	ee_sync();
+	return sEE_FAIL;
+}
+
+/*
+ * Timer and application
+ */
+
+static struct {
+	unsigned long calls;
+	unsigned long long ns;          /* CPU time, DMA transfers excluded */
+	unsigned long long max_ns;
+	unsigned long max_pages;        /* page writes started by one call */
+} isr;
+
+static void timer_isr(void)
+{
+	unsigned long long t0 = ee.t, d0 = ee.dma_ns, ns;
+	unsigned long pages = ee.page_writes;
+
+	sEE_PollHandler();
+	ns = (ee.t - t0) - (ee.dma_ns - d0);
+	isr.calls++;
+	isr.ns += ns;
+	if (ns > isr.max_ns)
+		isr.max_ns = ns;
+	if (ee.page_writes - pages > isr.max_pages)
+		isr.max_pages = ee.page_writes - pages;
+}
+
+/* The application computes for a while; the 1 ms tick keeps firing. */
+static void app_work(unsigned long long ns)
+{
+	unsigned long long end = ee.t + ns;
+
+	for (;;) {
+		unsigned long long tick = (ee.t / TICK_NS + 1) * TICK_NS;
+
+		if (tick > end) {
+			if (ee.t < end)
+				ee.t = end;
+			return;
+		}
+		ee.t = tick;
+		timer_isr();
+	}
+}
+
+static void app_wait_cache(void)
+{
+	while (sEE_GetCacheStatus() == SET)
+		app_work(TICK_NS);
+}
+
+static unsigned long long fg_ns;
+
+/* CPU time of a call: the DMA would carry on in the background */
+#define FG(call) do { \
+	unsigned long long fg_t0 = ee.t, fg_d0 = ee.dma_ns; \
+	call; \
+	fg_ns += (ee.t - fg_t0) - (ee.dma_ns - fg_d0); \
+	} while (0)
+
+/* What sEE_ReadBuffer() callers do: start the read, wait for the DMA. */
+static uint32_t read_raw(uint8_t *buf, uint16_t addr, uint16_t len)
+{
+	volatile uint16_t n = len;
+	uint32_t status = sEE_ReadBuffer(buf, addr, (uint16_t *)&n);
+
+	CHECK(n == 0);
+	return status;
+}
+
+static void ref_write(uint16_t addr, const uint8_t *data, uint16_t len)
+{
+	memcpy(ref + addr, data, len);
+}
+
+static void fill_random(uint8_t *p, uint32_t len)
+{
+	while (len--)
+		*p++ = rand();
+}
+
+static int errors(void)
+{
+	return ee.errors + timeouts;
+}
+
+/*
+ * Tests
+ */
+
+static void test_blocking(void)
+{
+	static uint8_t buf[300], back[300];
+
+	fill_random(buf, sizeof(buf));
+	sEE_WriteBuffer(buf, 0x105, sizeof(buf));
+	ref_write(0x105, buf, sizeof(buf));
+	CHECK(memcmp(mem, ref, EE_SIZE) == 0);
+	CHECK(read_raw(back, 0x105, sizeof(back)) == sEE_OK);
+	CHECK(memcmp(back, buf, sizeof(buf)) == 0);
+	CHECK(read_raw(back, 0x200, 1) == sEE_OK);
+	CHECK(back[0] == ref[0x200]);
+	CHECK(errors() == 0);
+}
+
+static void test_cache(void)
+{
+	static uint8_t buf[100], back[100];
+	unsigned long pages = ee.page_writes;
+
+	fill_random(buf, sizeof(buf));
+	CHECK(sEE_CacheWriteBuffer(buf, 0x310, sizeof(buf)) == sEE_OK);
+	ref_write(0x310, buf, sizeof(buf));
+	/* only the first page has gone out, the rest is in RAM */
+	CHECK(ee.page_writes - pages == 1);
+	CHECK(sEE_GetCacheStatus() == SET);
+	CHECK(memcmp(mem + 0x310, ref + 0x310, sizeof(buf)) != 0);
+	CHECK(sEE_CacheReadBuffer(back, 0x310, sizeof(back)) == sEE_OK);
+	CHECK(memcmp(back, buf, sizeof(buf)) == 0);
+
+	app_wait_cache();
+	CHECK(memcmp(mem, ref, EE_SIZE) == 0);
+	/* 0x310..0x373: four pages, one write cycle each */
+	CHECK(ee.page_writes - pages == 4);
+	CHECK(isr.max_pages == 1);
+	CHECK(errors() == 0);
+}
+
+static void test_merge(void)
+{
+	uint8_t rec[4];
+	unsigned long pages;
+	uint32_t i;
+
+	/* keep the EEPROM busy so that the records pile up */
+	rec[0] = 0x55;
+	CHECK(sEE_CacheWriteBuffer(rec, 0x800, 1) == sEE_OK);
+	ref_write(0x800, rec, 1);
+	pages = ee.page_writes;
+	for (i = 0; i < 8; i++) {
+		memset(rec, 0x10 + i, sizeof(rec));
+		CHECK(sEE_CacheWriteBuffer(rec, 0x820 + 4 * i, sizeof(rec)) == sEE_OK);
+		ref_write(0x820 + 4 * i, rec, sizeof(rec));
+		/* overwrite part of the previous record */
+		if (i > 0) {
+			rec[0] = 0xA0 + i;
+			CHECK(sEE_CacheWriteBuffer(rec, 0x820 + 4 * i - 1, 1) == sEE_OK);
+			ref_write(0x820 + 4 * i - 1, rec, 1);
+		}
+	}
+	CHECK(ee.page_writes == pages);
+	CHECK(sEE_CacheFlush() == sEE_OK);
+	CHECK(sEE_GetCacheStatus() == RESET);
+	CHECK(ee.page_writes - pages == 1);
+	CHECK(memcmp(mem, ref, EE_SIZE) == 0);
+	CHECK(errors() == 0);
+}
+
+/* ACK polling: one address per tick, none at a busy EEPROM otherwise */
+static void test_polling(void)
+{
+	static uint8_t buf[4 * PAGE_SIZE];
+	unsigned long polls = ee.polls, pages = ee.page_writes, tr;
+	unsigned long long t0;
+
+	fill_random(buf, sizeof(buf));
+	app_work(10 * TICK_NS);
+	t0 = ee.t;
+	isr.max_ns = 0;
+	CHECK(sEE_CacheWriteBuffer(buf, 0x1000, sizeof(buf)) == sEE_OK);
+	ref_write(0x1000, buf, sizeof(buf));
+	tr = ee.transactions;
+	app_wait_cache();
+	CHECK(ee.page_writes - pages == 4);
+	/* a 5 ms write cycle answers on the 6th tick at most */
+	CHECK(ee.polls - polls <= 4 * 6);
+	CHECK(ee.transactions - tr <= 4 * 7);
+	CHECK(ee.t - t0 <= 4 * 7 * TICK_NS);
+	CHECK(memcmp(mem, ref, EE_SIZE) == 0);
+	printf("4 pages through the timer: %.1f ms, %lu polls, longest tick %.1f us\n",
+	       (ee.t - t0) / 1e6, ee.polls - polls, isr.max_ns / 1e3);
+	CHECK(errors() == 0);
+}
+
+static void test_barrier(void)
+{
+	uint8_t b;
+	int i;
+
+	/* without a barrier the second write to 0x400 joins the first */
+	ee.log_n = 0;
+	ee.log_on = 1;
+	b = 1; sEE_CacheWriteBuffer(&b, 0x3E0, 1);
+	b = 2; sEE_CacheWriteBuffer(&b, 0x400, 1);
+	b = 3; sEE_CacheWriteBuffer(&b, 0x420, 1);
+	b = 4; sEE_CacheWriteBuffer(&b, 0x400, 1);
+	CHECK(sEE_CacheFlush() == sEE_OK);
+	CHECK(ee.log_n == 3);
+	CHECK(ee.log[1].page == 0x400 / PAGE_SIZE && ee.log[1].first == 4);
+	CHECK(ee.log[2].page == 0x420 / PAGE_SIZE);
+
+	/* with one, 0x420 reaches the EEPROM before the new 0x400 */
+	ee.log_n = 0;
+	b = 5; sEE_CacheWriteBuffer(&b, 0x3E0, 1);
+	b = 6; sEE_CacheWriteBuffer(&b, 0x400, 1);
+	b = 7; sEE_CacheWriteBuffer(&b, 0x420, 1);
+	sEE_CacheBarrier();
+	b = 8; sEE_CacheWriteBuffer(&b, 0x400, 1);
+	CHECK(sEE_CacheFlush() == sEE_OK);
+	ee.log_on = 0;
+	CHECK(ee.log_n == 4);
+	for (i = 0; i < ee.log_n; i++)
+		CHECK(ee.log[i].first == 5 + i);
+	CHECK(mem[0x400] == 8 && mem[0x420] == 7);
+	ref[0x3E0] = 5; ref[0x400] = 8; ref[0x420] = 7;
+	CHECK(memcmp(mem, ref, EE_SIZE) == 0);
+	CHECK(errors() == 0);
+}
+
+static void test_read(void)
+{
+	static uint8_t buf[PAGE_SIZE], back[3 * PAGE_SIZE];
+	unsigned long tr;
+
+	fill_random(back, sizeof(back));
+	sEE_WriteBuffer(back, 0x1400, sizeof(back));
+	ref_write(0x1400, back, sizeof(back));
+
+	/* 0x1400 cached whole, 0x1420 in part, 0x1440 not at all */
+	fill_random(buf, sizeof(buf));
+	CHECK(sEE_CacheWriteBuffer(buf, 0x13F0, 1) == sEE_OK);
+	ref_write(0x13F0, buf, 1);
+	CHECK(sEE_CacheWriteBuffer(buf, 0x1400, PAGE_SIZE) == sEE_OK);
+	ref_write(0x1400, buf, PAGE_SIZE);
+	CHECK(sEE_CacheWriteBuffer(buf, 0x1428, 5) == sEE_OK);
+	ref_write(0x1428, buf, 5);
+
+	tr = ee.transactions;
+	CHECK(sEE_CacheReadBuffer(back, 0x1400, PAGE_SIZE) == sEE_OK);
+	CHECK(ee.transactions == tr);
+	CHECK(memcmp(back, ref + 0x1400, PAGE_SIZE) == 0);
+
+	CHECK(sEE_CacheReadBuffer(back, 0x1410, sizeof(back)) == sEE_OK);
+	CHECK(memcmp(back, ref + 0x1410, sizeof(back)) == 0);
+	/* what came from the EEPROM stays in the line */
+	tr = ee.transactions;
+	CHECK(sEE_CacheReadBuffer(back, 0x1420, PAGE_SIZE) == sEE_OK);
+	CHECK(ee.transactions == tr);
+	CHECK(memcmp(back, ref + 0x1420, PAGE_SIZE) == 0);
+
+	CHECK(sEE_CacheFlush() == sEE_OK);
+	CHECK(memcmp(mem, ref, EE_SIZE) == 0);
+	CHECK(errors() == 0);
+}
+
+/*
+ * sEE_ReadBuffer() shares the bus with the cache: a write cycle that is
+ * over but not polled yet, and a tick in the middle of the read.
+ */
+static void test_shared_bus(void)
+{
+	static uint8_t buf[2 * PAGE_SIZE], back[50];
+	int i;
+
+	for (i = 0; i < 20; i++) {
+		fill_random(buf, sizeof(buf));
+		CHECK(sEE_CacheWriteBuffer(buf, 0x1600, sizeof(buf)) == sEE_OK);
+		ref_write(0x1600, buf, sizeof(buf));
+		ee.t = ee.busy_until + 1000;
+		irq_countdown = 1 + i % 5;
+		CHECK(read_raw(back, 0x1700, sizeof(back)) == sEE_OK);
+		CHECK(memcmp(back, ref + 0x1700, sizeof(back)) == 0);
+		irq_countdown = 0;
+		app_wait_cache();
+	}
+	CHECK(memcmp(mem, ref, EE_SIZE) == 0);
+	CHECK(errors() == 0);
+}
+
+/* sEE_WriteBuffer() writes the cache first and forgets its pages */
+static void test_coherent(void)
+{
+	static uint8_t a[40], b[8], back[40];
+
+	fill_random(a, sizeof(a));
+	fill_random(b, sizeof(b));
+	CHECK(sEE_CacheWriteBuffer(a, 0x1800, sizeof(a)) == sEE_OK);
+	ref_write(0x1800, a, sizeof(a));
+	sEE_WriteBuffer(b, 0x1810, sizeof(b));
+	ref_write(0x1810, b, sizeof(b));
+	CHECK(sEE_GetCacheStatus() == RESET);
+	CHECK(memcmp(mem, ref, EE_SIZE) == 0);
+	CHECK(sEE_CacheReadBuffer(back, 0x1800, sizeof(back)) == sEE_OK);
+	CHECK(memcmp(back, ref + 0x1800, sizeof(back)) == 0);
+	CHECK(errors() == 0);
+}
+
+/* the timer interrupt comes in the middle of every kind of call */
+static void test_lock(void)
+{
+	static uint8_t buf[80], back[80];
+	uint16_t addr, len;
+	int i, when;
+
+	for (i = 0; i < 300; i++) {
+		addr = 0x1A00 + rand() % 0x200;
+		len = 1 + rand() % 80;
+		when = 1 + rand() % 12;
+		fill_random(buf, sizeof(buf));
+		irq_countdown = when;
+		switch (rand() % 4) {
+		case 0:
+			CHECK(sEE_CacheWriteBuffer(buf, addr, len) == sEE_OK);
+			ref_write(addr, buf, len);
+			break;
+		case 1:
+			CHECK(sEE_CacheReadBuffer(back, addr, len) == sEE_OK);
+			CHECK(memcmp(back, ref + addr, len) == 0);
+			break;
+		case 2:
+			sEE_WriteBuffer(buf, addr, len);
+			ref_write(addr, buf, len);
+			break;
+		default:
+			irq_countdown = 0;
+			CHECK(sEE_CacheFlush() == sEE_OK);
+			irq_countdown = when;
+			CHECK(read_raw(back, addr, len) == sEE_OK);
+			CHECK(memcmp(back, ref + addr, len) == 0);
+			break;
+		}
+		irq_countdown = 0;
+		app_work(rand() % (3 * TICK_NS));
+	}
+	CHECK(sEE_CacheFlush() == sEE_OK);
+	CHECK(memcmp(mem, ref, EE_SIZE) == 0);
+	CHECK(errors() == 0);
+}
+
+/* random traffic against a plain copy of the EEPROM */
+static void test_random(void)
+{
+	static uint8_t buf[100], back[100];
+	uint16_t addr, len;
+	int i;
+
+	for (i = 0; i < 3000; i++) {
+		addr = rand() % (EE_SIZE - sizeof(buf));
+		if (i % 3)
+			addr = 0x1C00 + rand() % 0x100;     /* hot spot */
+		len = 1 + rand() % sizeof(buf);
+		switch (rand() % 8) {
+		case 0: case 1: case 2: case 3:
+			fill_random(buf, len);
+			CHECK(sEE_CacheWriteBuffer(buf, addr, len) == sEE_OK);
+			ref_write(addr, buf, len);
+			break;
+		case 4: case 5:
+			CHECK(sEE_CacheReadBuffer(back, addr, len) == sEE_OK);
+			CHECK(memcmp(back, ref + addr, len) == 0);
+			break;
+		case 6:
+			sEE_CacheBarrier();
+			break;
+		default:
+			if (rand() % 8 == 0) {
+				CHECK(sEE_CacheFlush() == sEE_OK);
+				CHECK(memcmp(mem, ref, EE_SIZE) == 0);
+			}
+			break;
+		}
+		app_work(rand() % (2 * TICK_NS));
+	}
+	app_wait_cache();
+	CHECK(memcmp(mem, ref, EE_SIZE) == 0);
+	CHECK(isr.max_pages <= 1);
+	CHECK(errors() == 0);
+}
+
+/*
+ * Saving settings: 16-byte records every 4 ms, blocking or through the
+ * cache, with the time each costs the caller.
+ */
+static void bench(void)
+{
+	static uint8_t buf[16];
+	uint32_t base = 0x1E00, i, n = 64;
+	unsigned long long t0, blocking, cached, isr_ns, wall;
+	unsigned long pages_blocking, pages_cached;
+
+	pages_blocking = ee.page_writes;
+	fg_ns = 0;
+	for (i = 0; i < n; i++) {
+		memset(buf, i, sizeof(buf));
+		app_work(4 * TICK_NS);
+		FG(sEE_WriteBuffer(buf, base + 16 * (i % 16), sizeof(buf)));
+		ref_write(base + 16 * (i % 16), buf, sizeof(buf));
+	}
+	blocking = fg_ns;
+	pages_blocking = ee.page_writes - pages_blocking;
+
+	pages_cached = ee.page_writes;
+	fg_ns = 0;
+	isr.ns = 0;
+	t0 = ee.t;
+	for (i = 0; i < n; i++) {
+		memset(buf, 0x80 + i, sizeof(buf));
+		app_work(4 * TICK_NS);
+		FG(CHECK(sEE_CacheWriteBuffer(buf, base + 16 * (i % 16), sizeof(buf)) == sEE_OK));
+		ref_write(base + 16 * (i % 16), buf, sizeof(buf));
+	}
+	app_wait_cache();
+	cached = fg_ns;
+	isr_ns = isr.ns;
+	wall = ee.t - t0;
+	pages_cached = ee.page_writes - pages_cached;
+	CHECK(memcmp(mem, ref, EE_SIZE) == 0);
+
+	printf("save 64 x 16 bytes: blocking %.1f ms in the caller, %lu page writes; "
+	       "cached %.2f ms in the caller, %.2f ms in the timer interrupt over "
+	       "%.0f ms, %lu page writes\n",
+	       blocking / 1e6, pages_blocking, cached / 1e6, isr_ns / 1e6,
+	       wall / 1e6, pages_cached);
+	CHECK(cached * 20 < blocking);
+	CHECK(pages_cached < pages_blocking);
+	CHECK(errors() == 0);
+}
+
+static void run_tests(void)
+{
+	uint8_t local;
+
+	CHECK((uintptr_t)&local < 0x80000000ull);
+	srand(1);
+	memset(mem, 0xFF, sizeof(mem));
+	memset(ref, 0xFF, sizeof(ref));
+	sEE_Init();
+	test_blocking();
+	test_cache();
+	test_merge();
+	test_polling();
+	test_barrier();
+	test_read();
+	test_shared_bus();
+	test_coherent();
+	test_lock();
+	test_random();
+	bench();
+}
+
+int main(void)
+{
+	static ucontext_t main_ctx, test_ctx;
+	size_t stack_size = 1 << 20;
+	void *stack;
+
+	if (!getenv("VERBOSE"))
+		freopen("/dev/null", "w", stdout);
+
+	stack = mmap(NULL, stack_size, PROT_READ | PROT_WRITE,
+		     MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+	if (stack == MAP_FAILED) {
+		perror("test_i2cee: mmap");
+		return 1;
+	}
+	getcontext(&test_ctx);
+	test_ctx.uc_stack.ss_sp = stack;
+	test_ctx.uc_stack.ss_size = stack_size;
+	test_ctx.uc_link = &main_ctx;
+	makecontext(&test_ctx, run_tests, 0);
+	swapcontext(&main_ctx, &test_ctx);
+
+	if (failures) {
+		fprintf(stderr, "test_i2cee: %d checks failed\n", failures);
+		return 1;
+	}
+	fprintf(stderr, "test_i2cee: ok\n");
+	return 0;
+}
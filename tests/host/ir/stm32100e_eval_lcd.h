@@ -0,0 +1,25 @@
+/* LCD of the STM32100E-EVAL: the test keeps the lines written. */
+#ifndef STM32100E_EVAL_LCD_H
+#define STM32100E_EVAL_LCD_H
+
+#include <stdint.h>
+
+#define LINE(x) (x)
+#define LCD_LINE_0 LINE(0)
+#define LCD_LINE_1 LINE(1)
+#define LCD_LINE_4 LINE(4)
+#define LCD_LINE_5 LINE(5)
+#define LCD_LINE_6 LINE(6)
+
+#define LCD_COLOR_WHITE 0xFFFF
+#define LCD_COLOR_BLUE  0x001F
+#define LCD_COLOR_RED   0xF800
+#define LCD_COLOR_GREEN 0x07E0
+
+extern char test_lcd[10][32];
+
+void LCD_DisplayStringLine(uint8_t line, uint8_t *ptr);
+static inline void LCD_SetBackColor(uint16_t c) { (void)c; }
+static inline void LCD_SetTextColor(uint16_t c) { (void)c; }
+
+#endif
@@ -0,0 +1,121 @@
+/*
+ * Just enough of the StdPeriph library for the AN3174 IR decoder: one
+ * general purpose timer whose status and capture registers the test
+ * drives, and no-op clock, GPIO and NVIC setup.
+ */
+#ifndef STM32F10X_H
+#define STM32F10X_H
+
+#include <stdint.h>
+
+#define __IO volatile
+
+typedef enum { RESET = 0, SET = !RESET } FlagStatus, ITStatus;
+typedef enum { DISABLE = 0, ENABLE = !DISABLE } FunctionalState;
+
+typedef struct {
+	uint16_t CR1, SR, ARR, CCR1, CCR2;
+	uint16_t PSC, ICFilter;
+	uint16_t DIER;
+	int enabled;
+} TIM_TypeDef;
+
+extern TIM_TypeDef test_tim[8];
+#define TIM1  (&test_tim[0])
+#define TIM2  (&test_tim[1])
+#define TIM3  (&test_tim[2])
+#define TIM4  (&test_tim[3])
+#define TIM5  (&test_tim[4])
+#define TIM6  (&test_tim[5])
+#define TIM7  (&test_tim[6])
+#define TIM8  (&test_tim[7])
+#define TIM15 ((TIM_TypeDef *)0)
+#define TIM16 ((TIM_TypeDef *)0)
+#define TIM17 ((TIM_TypeDef *)0)
+
+#define TIM_FLAG_Update  0x0001
+#define TIM_FLAG_CC1     0x0002
+#define TIM_FLAG_CC2     0x0004
+#define TIM_IT_Update    0x0001
+#define TIM_IT_CC1       0x0002
+#define TIM_IT_CC2       0x0004
+
+#define TIM_Channel_1               0
+#define TIM_ICPolarity_Falling      1
+#define TIM_ICSelection_DirectTI    1
+#define TIM_ICPSC_DIV1              0
+#define TIM_TS_TI1FP1               0x50
+#define TIM_SlaveMode_Reset         4
+#define TIM_MasterSlaveMode_Enable  0x80
+#define TIM_UpdateSource_Regular    1
+#define TIM_PSCReloadMode_Immediate 1
+
+typedef struct {
+	uint16_t TIM_Channel, TIM_ICPolarity, TIM_ICSelection;
+	uint16_t TIM_ICPrescaler, TIM_ICFilter;
+} TIM_ICInitTypeDef;
+
+typedef struct { uint32_t CFGR; } RCC_TypeDef;
+extern RCC_TypeDef test_rcc;
+#define RCC (&test_rcc)
+
+typedef struct {
+	uint32_t SYSCLK_Frequency, HCLK_Frequency;
+	uint32_t PCLK1_Frequency, PCLK2_Frequency, ADCCLK_Frequency;
+} RCC_ClocksTypeDef;
+
+#define RCC_APB1Periph_TIM3   0x00000002
+#define RCC_APB2Periph_GPIOC  0x00000010
+#define RCC_APB2Periph_AFIO   0x00000001
+
+typedef struct { int dummy; } GPIO_TypeDef;
+extern GPIO_TypeDef test_gpioc;
+#define GPIOC (&test_gpioc)
+#define GPIO_Pin_6            0x0040
+#define GPIO_Mode_IN_FLOATING 0x04
+#define GPIO_Speed_50MHz      3
+#define GPIO_FullRemap_TIM3   0x001A0C00
+typedef struct { uint16_t GPIO_Pin; int GPIO_Speed; int GPIO_Mode; } GPIO_InitTypeDef;
+
+#define TIM3_IRQn 29
+#define NVIC_PriorityGroup_2 0x500
+typedef struct {
+	uint8_t NVIC_IRQChannel, NVIC_IRQChannelPreemptionPriority;
+	uint8_t NVIC_IRQChannelSubPriority;
+	FunctionalState NVIC_IRQChannelCmd;
+} NVIC_InitTypeDef;
+
+static inline void RCC_APB1PeriphClockCmd(uint32_t p, FunctionalState s) { (void)p; (void)s; }
+static inline void RCC_APB2PeriphClockCmd(uint32_t p, FunctionalState s) { (void)p; (void)s; }
+void RCC_GetClocksFreq(RCC_ClocksTypeDef *clocks);
+static inline void GPIO_Init(GPIO_TypeDef *g, GPIO_InitTypeDef *i) { (void)g; (void)i; }
+static inline void GPIO_DeInit(GPIO_TypeDef *g) { (void)g; }
+static inline void GPIO_PinRemapConfig(uint32_t r, FunctionalState s) { (void)r; (void)s; }
+static inline void NVIC_PriorityGroupConfig(uint32_t g) { (void)g; }
+static inline void NVIC_Init(NVIC_InitTypeDef *i) { (void)i; }
+
+static inline void TIM_DeInit(TIM_TypeDef *t) { t->enabled = 0; t->DIER = 0; t->SR = 0; }
+static inline void TIM_PrescalerConfig(TIM_TypeDef *t, uint16_t psc, uint16_t mode) { (void)mode; t->PSC = psc; }
+static inline void TIM_PWMIConfig(TIM_TypeDef *t, TIM_ICInitTypeDef *i) { t->ICFilter = i->TIM_ICFilter; }
+static inline void TIM_SelectInputTrigger(TIM_TypeDef *t, uint16_t s) { (void)t; (void)s; }
+static inline void TIM_SelectSlaveMode(TIM_TypeDef *t, uint16_t m) { (void)t; (void)m; }
+static inline void TIM_SelectMasterSlaveMode(TIM_TypeDef *t, uint16_t m) { (void)t; (void)m; }
+static inline void TIM_UpdateRequestConfig(TIM_TypeDef *t, uint16_t s) { (void)s; t->CR1 |= 4; }
+static inline void TIM_ClearFlag(TIM_TypeDef *t, uint16_t f) { t->SR &= ~f; }
+static inline void TIM_Cmd(TIM_TypeDef *t, FunctionalState s) { t->enabled = (s == ENABLE); }
+static inline void TIM_ITConfig(TIM_TypeDef *t, uint16_t it, FunctionalState s)
+{
+	if (s == ENABLE)
+		t->DIER |= it;
+	else
+		t->DIER &= ~it;
+}
+static inline FlagStatus TIM_GetFlagStatus(TIM_TypeDef *t, uint16_t f)
+{
+	return (t->SR & f) ? SET : RESET;
+}
+/* Reading a capture register clears its flag, as on the chip */
+static inline uint16_t TIM_GetCapture1(TIM_TypeDef *t) { t->SR &= ~TIM_FLAG_CC1; return t->CCR1; }
+static inline uint16_t TIM_GetCapture2(TIM_TypeDef *t) { t->SR &= ~TIM_FLAG_CC2; return t->CCR2; }
+
+#endif
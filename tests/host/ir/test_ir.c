@@ -0,0 +1,550 @@
+/*
+ * Replays IR remote frames through the AN3174 decoder.
+ *
+ * Frames are generated as mark/space timelines (with timing jitter) and
+ * played into a model of TIM3 in PWM input mode: every falling edge
+ * resets the counter and captures the period in CCR1, every rising edge
+ * captures the mark length in CCR2, and the counter overflows at ARR.
+ * TIM3_IRQHandler runs on each CC1 and update event, IR_Decode() runs
+ * from the "main loop" between frames.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ir_decode.h"
+
+TIM_TypeDef test_tim[8];
+RCC_TypeDef test_rcc;
+GPIO_TypeDef test_gpioc;
+char test_lcd[10][32];
+
+void TIM3_IRQHandler(void);
+
+/* STM32100E-EVAL: 24 MHz, APB1 undivided, TIM_PRESCALER 23 -> 1 us ticks */
+void RCC_GetClocksFreq(RCC_ClocksTypeDef *clocks)
+{
+	memset(clocks, 0, sizeof(*clocks));
+	clocks->SYSCLK_Frequency = clocks->HCLK_Frequency = 24000000;
+	clocks->PCLK1_Frequency = clocks->PCLK2_Frequency = 24000000;
+}
+
+void LCD_DisplayStringLine(uint8_t line, uint8_t *ptr)
+{
+	snprintf(test_lcd[line], sizeof(test_lcd[line]), "%s", (char *)ptr);
+}
+
+static int failures;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: check failed: %s\n", \
+			__FILE__, __LINE__, #cond); \
+		failures++; \
+	} } while (0)
+
+/*
+ * Timer model, time in us (= ticks)
+ */
+
+static struct {
+	unsigned long now;        /* time of the last edge */
+	unsigned long base;       /* counter reset (falling edge or overflow) */
+	unsigned long isr_calls;
+	double isr_ns;
+} sim;
+
+static double now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void run_isr(void)
+{
+	double t0 = now_ns();
+
+	TIM3_IRQHandler();
+	sim.isr_ns += now_ns() - t0;
+	sim.isr_calls++;
+}
+
+/* Let time pass up to t, raising the overflows on the way */
+static void advance(unsigned long t)
+{
+	while (sim.base + TIM3->ARR + 1 <= t) {
+		sim.base += TIM3->ARR + 1;
+		TIM3->SR |= TIM_FLAG_Update;
+		run_isr();
+	}
+	sim.now = t;
+}
+
+static void falling_edge(unsigned long t)
+{
+	advance(t);
+	TIM3->CCR1 = t - sim.base;
+	TIM3->SR |= TIM_FLAG_CC1;
+	sim.base = t;
+	run_isr();
+}
+
+static void rising_edge(unsigned long t)
+{
+	advance(t);
+	TIM3->CCR2 = t - sim.base;
+	TIM3->SR |= TIM_FLAG_CC2;
+}
+
+/*
+ * Frame generation
+ */
+
+#define MAX_PULSES 80
+
+struct frame {
+	int n;
+	unsigned int mark[MAX_PULSES];
+	unsigned int space[MAX_PULSES];   /* 0 after the last mark */
+};
+
+static int jitter_pct;
+
+static unsigned int jit(unsigned int us)
+{
+	int j;
+
+	if (!jitter_pct)
+		return us;
+	j = (int)us * jitter_pct / 100;
+	return us + (rand() % (2 * j + 1)) - j;
+}
+
+static void add(struct frame *f, unsigned int mark, unsigned int space)
+{
+	f->mark[f->n] = mark;
+	f->space[f->n] = space;
+	f->n++;
+}
+
+/* Play a frame starting at time t, return the time of its last edge */
+static unsigned long play(const struct frame *f, unsigned long t)
+{
+	int i;
+
+	for (i = 0; i < f->n; i++) {
+		falling_edge(t);
+		t += jit(f->mark[i]);
+		rising_edge(t);
+		t += f->space[i] ? jit(f->space[i]) : 0;
+	}
+	return t;
+}
+
+static void nec_bits(struct frame *f, uint32_t data, int bits)
+{
+	int i;
+
+	for (i = 0; i < bits; i++)
+		add(f, 560, (data >> i) & 1 ? 1690 : 560);
+}
+
+static void gen_nec(struct frame *f, uint8_t addr, uint8_t cmd)
+{
+	f->n = 0;
+	add(f, 9000, 4500);
+	nec_bits(f, addr | (uint32_t)(uint8_t)~addr << 8 |
+		 (uint32_t)cmd << 16 | (uint32_t)(uint8_t)~cmd << 24, 32);
+	add(f, 560, 0);
+}
+
+static void gen_nec_repeat(struct frame *f)
+{
+	f->n = 0;
+	add(f, 9000, 2250);
+	add(f, 560, 0);
+}
+
+static void gen_samsung(struct frame *f, uint8_t addr, uint8_t cmd)
+{
+	f->n = 0;
+	add(f, 4500, 4500);
+	nec_bits(f, addr | (uint32_t)addr << 8 |
+		 (uint32_t)cmd << 16 | (uint32_t)(uint8_t)~cmd << 24, 32);
+	add(f, 560, 0);
+}
+
+static void gen_sirc(struct frame *f, uint8_t addr, uint8_t cmd)
+{
+	uint32_t data = (cmd & 0x7F) | (uint32_t)(addr & 0x1F) << 7;
+	int i;
+
+	f->n = 0;
+	add(f, 2400, 600);
+	for (i = 0; i < 12; i++)
+		add(f, (data >> i) & 1 ? 1200 : 600, i == 11 ? 0 : 600);
+}
+
+/*
+ * Manchester: build the line as half bit levels, then merge the runs
+ * into mark/space pairs. The idle line before the first mark and after
+ * the last one is dropped.
+ */
+static void halves_to_frame(struct frame *f, const uint8_t *level,
+			    const uint8_t *units, int n, unsigned int unit)
+{
+	int i = 0;
+
+	while (i < n && !level[i])
+		i++;
+	while (i < n) {
+		unsigned int mark = 0, space = 0;
+
+		while (i < n && level[i])
+			mark += units[i++] * unit;
+		while (i < n && !level[i])
+			space += units[i++] * unit;
+		add(f, mark, i < n ? space : 0);
+	}
+}
+
+static void gen_rc5(struct frame *f, int toggle, uint8_t addr, uint8_t cmd)
+{
+	uint32_t data = 3u << 12 | (uint32_t)(toggle & 1) << 11 |
+			(uint32_t)(addr & 0x1F) << 6 | (cmd & 0x3F);
+	uint8_t level[28], units[28];
+	int i;
+
+	/* RC5: a '1' is space then mark */
+	for (i = 0; i < 14; i++) {
+		int bit = (data >> (13 - i)) & 1;
+
+		level[2 * i] = !bit;
+		level[2 * i + 1] = bit;
+		units[2 * i] = units[2 * i + 1] = 1;
+	}
+	f->n = 0;
+	halves_to_frame(f, level, units, 28, 889);
+}
+
+static void gen_rc6(struct frame *f, int toggle, uint8_t addr, uint8_t cmd)
+{
+	/* start bit, mode 000, trailer, address, command */
+	uint32_t data = 1u << 20 | (uint32_t)(toggle & 1) << 16 |
+			(uint32_t)addr << 8 | cmd;
+	uint8_t level[2 + 42], units[2 + 42];
+	int i, n = 0;
+
+	level[n] = 1; units[n++] = 6;          /* leader 2666 us */
+	level[n] = 0; units[n++] = 2;          /* 889 us */
+	/* RC6: a '1' is mark then space, the trailer is double width */
+	for (i = 0; i < 21; i++) {
+		int bit = (data >> (20 - i)) & 1;
+		int w = (i == 4) ? 2 : 1;
+
+		level[n] = bit; units[n++] = w;
+		level[n] = !bit; units[n++] = w;
+	}
+	f->n = 0;
+	halves_to_frame(f, level, units, n, 444);
+	/* the leader is 2666 us, not six units of 444 */
+	f->mark[0] = 2666;
+}
+
+/*
+ * Helpers
+ */
+
+static void reset_decoder(void)
+{
+	memset(&sim, 0, sizeof(sim));
+	memset(test_tim, 0, sizeof(test_tim));
+	IR_DeInit();
+	IR_Init();
+	/* the line was idle for a while */
+	advance(200000);
+}
+
+/* Send a frame, wait for the line to go idle, run the main loop */
+static int send(const struct frame *f, unsigned long period, IR_Frame_TypeDef *out)
+{
+	unsigned long start = sim.now;
+	int got = 0;
+	IR_Frame_TypeDef tmp;
+
+	play(f, start);
+	advance(start + period);
+	while (IR_Decode(&tmp) != NO) {
+		*out = tmp;
+		got++;
+	}
+	return got;
+}
+
+/*
+ * Tests
+ */
+
+static void test_timer_setup(void)
+{
+	reset_decoder();
+	/* longest pair: NEC header 13500 us + 25 % + slack */
+	CHECK(TIM3->ARR == 16975);
+	CHECK(TIM3->PSC == 23);
+	CHECK(TIM3->DIER == (TIM_IT_Update | TIM_IT_CC1));
+	CHECK(TIM3->enabled);
+}
+
+static void check_all_protocols(int jitter, int rounds)
+{
+	IR_Frame_TypeDef fr;
+	struct frame f;
+	int r;
+
+	jitter_pct = jitter;
+	reset_decoder();
+	for (r = 0; r < rounds; r++) {
+		uint8_t addr = rand(), cmd = rand();
+		int toggle = r & 1;
+
+		gen_nec(&f, addr, cmd);
+		CHECK(send(&f, 200000, &fr) == 1);
+		CHECK(fr.Protocol == IR_NEC);
+		CHECK(fr.Address == (addr | (uint8_t)~addr << 8));
+		CHECK(fr.Command == cmd);
+		CHECK(fr.Repeat == 0);
+
+		gen_samsung(&f, addr, cmd);
+		CHECK(send(&f, 200000, &fr) == 1);
+		CHECK(fr.Protocol == IR_SAMSUNG);
+		CHECK(fr.Address == (addr | addr << 8));
+		CHECK(fr.Command == cmd);
+
+		gen_sirc(&f, addr, cmd);
+		CHECK(send(&f, 200000, &fr) == 1);
+		CHECK(fr.Protocol == IR_SIRC);
+		CHECK(fr.Address == (addr & 0x1F));
+		CHECK(fr.Command == (cmd & 0x7F));
+
+		gen_rc5(&f, toggle, addr, cmd);
+		CHECK(send(&f, 200000, &fr) == 1);
+		CHECK(fr.Protocol == IR_RC5);
+		CHECK(fr.Address == (addr & 0x1F));
+		CHECK(fr.Command == (cmd & 0x3F));
+		CHECK(fr.ToggleBit == toggle);
+
+		gen_rc6(&f, toggle, addr, cmd);
+		CHECK(send(&f, 200000, &fr) == 1);
+		CHECK(fr.Protocol == IR_RC6);
+		CHECK(fr.Address == addr);
+		CHECK(fr.Command == cmd);
+		CHECK(fr.ToggleBit == toggle);
+	}
+	CHECK(IROverruns == 0);
+}
+
+static void test_repeat(void)
+{
+	IR_Frame_TypeDef fr;
+	struct frame f;
+	int i;
+
+	jitter_pct = 5;
+	reset_decoder();
+
+	/* NEC: frame, then a repeat code every 108 ms while held */
+	gen_nec(&f, 0x10, 0x42);
+	CHECK(send(&f, 108000, &fr) == 1);
+	CHECK(fr.Repeat == 0);
+	CHECK(IR_KeyHeld() == YES);
+	gen_nec_repeat(&f);
+	for (i = 1; i <= 5; i++) {
+		CHECK(send(&f, 108000, &fr) == 1);
+		CHECK(fr.Protocol == IR_NEC);
+		CHECK(fr.Command == 0x42);
+		CHECK(fr.Repeat == i);
+	}
+	CHECK(strstr(test_lcd[4], "repeat 5") != NULL);
+	CHECK(strstr(test_lcd[5], "0x42") != NULL);
+
+	/* key released */
+	advance(sim.now + 300000);
+	CHECK(IR_KeyHeld() == NO);
+
+	/* a repeat code with no key before it is ignored */
+	CHECK(send(&f, 300000, &fr) == 0);
+
+	/* same key again after the pause: a new press */
+	gen_nec(&f, 0x10, 0x42);
+	CHECK(send(&f, 108000, &fr) == 1);
+	CHECK(fr.Repeat == 0);
+
+	/* RC5 held: same toggle bit, frames every 114 ms */
+	gen_rc5(&f, 1, 0, 12);
+	for (i = 0; i < 4; i++) {
+		CHECK(send(&f, 114000, &fr) == 1);
+		CHECK(fr.Repeat == i);
+	}
+	CHECK(strstr(test_lcd[5], "StandBy") != NULL);
+	CHECK(strstr(test_lcd[6], "TV1") != NULL);
+	/* pressed again: the toggle bit changes, a new press */
+	gen_rc5(&f, 0, 0, 12);
+	CHECK(send(&f, 114000, &fr) == 1);
+	CHECK(fr.Repeat == 0);
+
+	/* SIRC repeats the frame every 45 ms */
+	gen_sirc(&f, 1, 21);
+	for (i = 0; i < 6; i++) {
+		CHECK(send(&f, 45000, &fr) == 1);
+		CHECK(fr.Protocol == IR_SIRC);
+		CHECK(fr.Repeat == i);
+	}
+
+	/* a different key right after is a new press */
+	gen_sirc(&f, 1, 22);
+	CHECK(send(&f, 45000, &fr) == 1);
+	CHECK(fr.Repeat == 0);
+	CHECK(fr.Command == 22);
+}
+
+static void test_noise(void)
+{
+	IR_Frame_TypeDef fr;
+	struct frame f;
+	int i, bad = 0;
+
+	jitter_pct = 0;
+	reset_decoder();
+	for (i = 0; i < 2000; i++) {
+		int j, n = 1 + rand() % 40;
+
+		f.n = 0;
+		for (j = 0; j < n; j++)
+			add(&f, 50 + rand() % 3000, j == n - 1 ? 0 : 50 + rand() % 5000);
+		bad += send(&f, 30000, &fr);
+	}
+	/* random pulse trains practically never form a valid frame */
+	CHECK(bad <= 2);
+
+	/* a frame cut short is dropped and the next one decodes */
+	gen_nec(&f, 1, 2);
+	f.n = 20;
+	f.space[19] = 0;
+	CHECK(send(&f, 120000, &fr) == 0);
+	gen_nec(&f, 1, 2);
+	CHECK(send(&f, 120000, &fr) == 1);
+	CHECK(fr.Command == 2);
+
+	/* a NEC frame with one bad bit space */
+	gen_nec(&f, 1, 3);
+	f.space[10] = 1100;
+	CHECK(send(&f, 120000, &fr) == 0);
+
+	/* a receiver that stretches marks by 100 us and shortens spaces */
+	for (i = 0; i < 5; i++) {
+		int j;
+
+		switch (i) {
+		case 0: gen_nec(&f, 5, 6); break;
+		case 1: gen_rc5(&f, 0, 5, 6); break;
+		case 2: gen_rc6(&f, 0, 5, 6); break;
+		case 3: gen_sirc(&f, 5, 6); break;
+		case 4: gen_samsung(&f, 5, 6); break;
+		}
+		for (j = 0; j < f.n; j++) {
+			f.mark[j] += 100;
+			if (f.space[j])
+				f.space[j] -= 100;
+		}
+		CHECK(send(&f, 200000, &fr) == 1);
+		CHECK(fr.Protocol == i);
+		CHECK(fr.Command == 6);
+	}
+}
+
+static void test_overrun(void)
+{
+	IR_Frame_TypeDef fr;
+	struct frame f;
+	unsigned long t;
+	int i, got = 0;
+
+	jitter_pct = 0;
+	reset_decoder();
+
+	/* three NEC frames (105 entries) without running the main loop */
+	gen_nec(&f, 3, 4);
+	for (i = 0; i < 3; i++) {
+		t = play(&f, sim.now);
+		advance(t + 50000);
+	}
+	CHECK(IROverruns > 0);
+	while (IR_Decode(&fr) != NO)
+		got++;
+	CHECK(got >= 1 && got < 3);
+
+	/* back in step */
+	CHECK(send(&f, 120000, &fr) == 1);
+	CHECK(fr.Command == 4);
+}
+
+/* ISR cost per capture and decode cost per pulse, for reference */
+static void test_throughput(void)
+{
+	IR_Frame_TypeDef fr;
+	struct frame f;
+	unsigned long pulses = 0, frames = 0;
+	double t0, decode_ns = 0;
+	int i;
+
+	jitter_pct = 10;
+	reset_decoder();
+	sim.isr_ns = 0;
+	sim.isr_calls = 0;
+	for (i = 0; i < 2000; i++) {
+		switch (i % 5) {
+		case 0: gen_nec(&f, i, i >> 3); break;
+		case 1: gen_rc5(&f, i & 1, i, i >> 3); break;
+		case 2: gen_rc6(&f, i & 1, i, i >> 3); break;
+		case 3: gen_sirc(&f, i, i >> 3); break;
+		case 4: gen_samsung(&f, i, i >> 3); break;
+		}
+		play(&f, sim.now);
+		advance(sim.now + 200000);
+		pulses += f.n;
+		t0 = now_ns();
+		while (IR_Decode(&fr) != NO)
+			frames++;
+		decode_ns += now_ns() - t0;
+	}
+	CHECK(frames == 2000);
+	printf("isr: %lu calls, %.1f ns each\n", sim.isr_calls,
+	       sim.isr_ns / sim.isr_calls);
+	printf("decode: %lu pulses, %.1f ns per pulse, %.0f frames/s\n",
+	       pulses, decode_ns / pulses, frames / (decode_ns / 1e9));
+}
+
+int main(void)
+{
+	if (!getenv("VERBOSE"))
+		freopen("/dev/null", "w", stdout);
+
+	srand(1);
+	test_timer_setup();
+	check_all_protocols(0, 50);
+	check_all_protocols(10, 200);
+	test_repeat();
+	test_noise();
+	test_overrun();
+	test_throughput();
+	if (failures) {
+		fprintf(stderr, "test_ir: %d checks failed\n", failures);
+		return 1;
+	}
+	fprintf(stderr, "test_ir: ok\n");
+	return 0;
+}
@@ -0,0 +1,9 @@
+/* What fatfs_storage.c and the LCD header take from the application */
+#ifndef MAIN_H
+#define MAIN_H
+
+#include "stm32l1xx.h"
+
+#define MAX_BMP_FILES 25
+
+#endif
@@ -0,0 +1,16 @@
+/*
+ * Just the StdPeriph types used by the STM_ble_app FatFs port, the
+ * adafruit SD driver and the bitmap display code.
+ */
+#ifndef STM32L1XX_H
+#define STM32L1XX_H
+
+#include <stdint.h>
+
+#define __IO volatile
+
+typedef enum { RESET = 0, SET = !RESET } FlagStatus, ITStatus;
+typedef enum { DISABLE = 0, ENABLE = !DISABLE } FunctionalState;
+typedef enum { ERROR = 0, SUCCESS = !ERROR } ErrorStatus;
+
+#endif
@@ -0,0 +1,29 @@
+/*
+ * The Nucleo SPI and control lines as seen by the SD and LCD code. The
+ * test implements them on a bus shared by an SD card model and an
+ * ST7735 model; the DMA transfers are modelled by the test as well.
+ */
+#ifndef STM32L1XX_NUCLEO_H
+#define STM32L1XX_NUCLEO_H
+
+#include "stm32l1xx.h"
+
+void test_sd_cs(int low);
+void test_lcd_cs(int low);
+void test_lcd_dc(int high);
+
+#define SD_CS_LOW()   test_sd_cs(1)
+#define SD_CS_HIGH()  test_sd_cs(0)
+#define LCD_CS_LOW()  test_lcd_cs(1)
+#define LCD_CS_HIGH() test_lcd_cs(0)
+#define LCD_DC_LOW()  test_lcd_dc(0)
+#define LCD_DC_HIGH() test_lcd_dc(1)
+
+void SD_CtrlLines_Config(void);
+uint8_t STM_SPI_WriteRead(uint8_t Data);
+void STM_SPI_ReadBuffer(uint8_t* pBuffer, uint16_t Length);
+void STM_SPI_WriteBuffer(const uint8_t* pBuffer, uint16_t Length);
+void STM_SPI_StartWrite16(const uint16_t* pBuffer, uint16_t Length);
+void STM_SPI_WaitTransfer(void);
+
+#endif
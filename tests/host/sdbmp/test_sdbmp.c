@@ -0,0 +1,802 @@
+/*
+ * Runs the STM_ble_app FatFs port (fatfs_drv.c over the adafruit SPI SD
+ * driver) and the bitmap display path (fatfs_storage.c) against a shared
+ * SPI bus carrying an SD card model and an ST7735 model.
+ *
+ * The card speaks the SPI mode protocol with byte addressing: R1 after
+ * one fill byte, data tokens, CMD18 streaming until CMD12, CMD25 with
+ * 0xFC/0xFD tokens, data responses and busy bytes. It holds a FAT16
+ * image built here. The LCD decodes CASET/RASET/RAMWR/MADCTL into a
+ * frame buffer, with the row order reversed when MADCTL.MY is cleared.
+ *
+ * The DMA helpers are modelled so that misuse shows: a 16-bit write only
+ * reaches the bus when it is waited for (or when the bus is next used),
+ * and releasing the LCD chip select before that, or selecting both
+ * devices at once, is an error.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stm32l1xx.h"
+#include "ff.h"
+#include "diskio.h"
+#include "stm32_adafruit_spi_usd.h"
+#include "stm32_adafruit_spi_lcd.h"
+#include "fatfs_storage.h"
+
+static int failures;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: check failed: %s\n", \
+			__FILE__, __LINE__, #cond); \
+		failures++; \
+	} } while (0)
+
+/*
+ * FAT16 image: 1 reserved sector, two FATs, 512 root entries and
+ * 2 KB clusters.
+ */
+
+#define SPC        4
+#define NCLUST     4200
+#define FATSZ      17
+#define ROOTSECS   32
+#define DATA_START (1 + 2 * FATSZ + ROOTSECS)
+#define TOTSEC     (DATA_START + NCLUST * SPC)
+
+static uint8_t *image;
+static unsigned next_cluster;
+static unsigned root_entries;
+
+static void put16(uint8_t *p, unsigned v) { p[0] = v; p[1] = v >> 8; }
+static void put32(uint8_t *p, unsigned long v)
+{
+	put16(p, v & 0xFFFF);
+	put16(p + 2, v >> 16);
+}
+
+static void fat_set(unsigned cl, unsigned v)
+{
+	put16(image + 512 + cl * 2, v);
+	put16(image + 512 * (1 + FATSZ) + cl * 2, v);
+}
+
+static void build_image(void)
+{
+	uint8_t *bs;
+
+	free(image);
+	image = calloc(TOTSEC, 512);
+	bs = image;
+	bs[0] = 0xEB; bs[1] = 0x3C; bs[2] = 0x90;
+	memcpy(bs + 3, "MSDOS5.0", 8);
+	put16(bs + 11, 512);
+	bs[13] = SPC;
+	put16(bs + 14, 1);
+	bs[16] = 2;
+	put16(bs + 17, ROOTSECS * 16);
+	put16(bs + 19, TOTSEC);
+	bs[21] = 0xF8;
+	put16(bs + 22, FATSZ);
+	bs[36] = 0x80;
+	bs[38] = 0x29;
+	memcpy(bs + 43, "NO NAME    FAT16   ", 19);
+	bs[510] = 0x55; bs[511] = 0xAA;
+	fat_set(0, 0xFFF8);
+	fat_set(1, 0xFFFF);
+	next_cluster = 2;
+	root_entries = 0;
+}
+
+/* Stores a file in consecutive clusters. name is the 11 character 8.3 form */
+static void add_file(const char *name, const uint8_t *data, unsigned long size)
+{
+	uint8_t *de = image + 512 * (1 + 2 * FATSZ) + 32 * root_entries++;
+	unsigned nclust = (size + SPC * 512 - 1) / (SPC * 512);
+	unsigned i;
+
+	memcpy(de, name, 11);
+	de[11] = 0x20;
+	put16(de + 26, nclust ? next_cluster : 0);
+	put32(de + 28, size);
+	for (i = 0; i < nclust; i++)
+		fat_set(next_cluster + i, i + 1 < nclust ? next_cluster + i + 1 : 0xFFFF);
+	memcpy(image + 512UL * (DATA_START + (next_cluster - 2) * SPC), data, size);
+	next_cluster += nclust;
+}
+
+/*
+ * SD card
+ */
+
+static struct {
+	int cs;
+	uint8_t cmd[6];
+	int cmd_len;
+
+	uint8_t out[1100];
+	int out_head, out_tail;
+
+	int streaming;            /* CMD18 in progress */
+	unsigned long stream_addr;
+	int stream_stopped;       /* error token sent, waiting for CMD12 */
+
+	int writing;              /* 1: CMD24, 2: CMD25 */
+	int collecting;
+	unsigned long write_addr;
+	uint8_t wbuf[514];
+	int wlen;
+
+	unsigned long fail_read;  /* byte address answered with an error token */
+	unsigned long fail_write; /* byte address answered with a CRC error */
+
+	unsigned long cmds[64];
+	unsigned long blocks_read, blocks_written;
+	int errors;
+} sd;
+
+static void sd_queue(uint8_t b)
+{
+	sd.out[sd.out_tail++] = b;
+}
+
+static void sd_queue_block(unsigned long addr)
+{
+	int i;
+
+	sd_queue(0xFF);
+	if (addr == sd.fail_read || addr / 512 >= TOTSEC) {
+		sd_queue(0x08);           /* error token: out of range */
+		sd.stream_stopped = 1;
+		return;
+	}
+	sd_queue(0xFE);
+	for (i = 0; i < 512; i++)
+		sd_queue(image[addr + i]);
+	sd_queue(0x12);
+	sd_queue(0x34);
+	sd.blocks_read++;
+}
+
+static void sd_command(uint8_t cmd, unsigned long arg)
+{
+	sd.cmds[cmd & 63]++;
+	if (sd.streaming && cmd != SD_CMD_STOP_TRANSMISSION) {
+		fprintf(stderr, "sd: CMD%d during a multiple block read\n", cmd);
+		sd.errors++;
+		return;
+	}
+	sd.out_head = sd.out_tail = 0;
+
+	switch (cmd) {
+	case SD_CMD_GO_IDLE_STATE:
+		sd_queue(0xFF);
+		sd_queue(0x01);
+		break;
+	case SD_CMD_SEND_OP_COND:
+		sd_queue(0xFF);
+		sd_queue(0x00);
+		break;
+	case SD_CMD_SEND_STATUS:
+		sd_queue(0xFF);
+		sd_queue(0x00);
+		sd_queue(0x00);
+		break;
+	case SD_CMD_SEND_CSD:
+	case SD_CMD_SEND_CID: {
+		int i;
+
+		sd_queue(0xFF);
+		sd_queue(0x00);
+		sd_queue(0xFF);
+		sd_queue(0xFE);
+		for (i = 0; i < 18; i++)
+			sd_queue(0x00);
+		break;
+	}
+	case SD_CMD_READ_SINGLE_BLOCK:
+		sd_queue(0xFF);
+		sd_queue(0x00);
+		sd_queue(0xFF);
+		sd_queue_block(arg);
+		break;
+	case SD_CMD_READ_MULT_BLOCK:
+		sd_queue(0xFF);
+		sd_queue(0x00);
+		sd.streaming = 1;
+		sd.stream_stopped = 0;
+		sd.stream_addr = arg;
+		break;
+	case SD_CMD_STOP_TRANSMISSION:
+		if (!sd.streaming) {
+			fprintf(stderr, "sd: CMD12 outside a multiple block read\n");
+			sd.errors++;
+		}
+		sd.streaming = 0;
+		sd_queue(0xA5);           /* stuff byte */
+		sd_queue(0x00);
+		sd_queue(0x00);
+		sd_queue(0x00);
+		break;
+	case SD_CMD_WRITE_SINGLE_BLOCK:
+	case SD_CMD_WRITE_MULT_BLOCK:
+		sd_queue(0xFF);
+		sd_queue(0x00);
+		sd.writing = cmd == SD_CMD_WRITE_SINGLE_BLOCK ? 1 : 2;
+		sd.collecting = 0;
+		sd.write_addr = arg;
+		break;
+	default:
+		sd_queue(0xFF);
+		sd_queue(0x04);           /* illegal command */
+		break;
+	}
+}
+
+static void sd_write_byte(uint8_t mosi)
+{
+	int i;
+
+	if (!sd.collecting) {
+		if (mosi == 0xFF)
+			return;
+		if ((sd.writing == 1 && mosi == 0xFE) ||
+		    (sd.writing == 2 && mosi == SD_START_DATA_MULTIPLE_BLOCK_WRITE)) {
+			sd.collecting = 1;
+			sd.wlen = 0;
+			return;
+		}
+		if (sd.writing == 2 && mosi == SD_STOP_DATA_MULTIPLE_BLOCK_WRITE) {
+			sd.writing = 0;
+			sd.out_head = sd.out_tail = 0;
+			sd_queue(0xFF);
+			for (i = 0; i < 3; i++)
+				sd_queue(0x00);
+			return;
+		}
+		fprintf(stderr, "sd: unexpected 0x%02X while writing\n", mosi);
+		sd.errors++;
+		sd.writing = 0;
+		return;
+	}
+
+	sd.wbuf[sd.wlen++] = mosi;
+	if (sd.wlen < 514)
+		return;
+	sd.collecting = 0;
+	sd.out_head = sd.out_tail = 0;
+	if (sd.write_addr == sd.fail_write || sd.write_addr / 512 >= TOTSEC) {
+		sd_queue(0x0B);
+	} else {
+		memcpy(image + sd.write_addr, sd.wbuf, 512);
+		sd.blocks_written++;
+		sd_queue(0x05);
+		for (i = 0; i < 4; i++)
+			sd_queue(0x00);
+	}
+	sd.write_addr += 512;
+	if (sd.writing == 1)
+		sd.writing = 0;
+}
+
+static uint8_t sd_byte(uint8_t mosi)
+{
+	uint8_t miso = 0xFF;
+
+	if (sd.out_head == sd.out_tail && sd.streaming && !sd.stream_stopped) {
+		sd.out_head = sd.out_tail = 0;
+		sd_queue_block(sd.stream_addr);
+		sd.stream_addr += 512;
+	}
+	if (sd.out_head != sd.out_tail)
+		miso = sd.out[sd.out_head++];
+
+	if (sd.writing) {
+		sd_write_byte(mosi);
+	} else if (sd.cmd_len || (mosi & 0xC0) == 0x40) {
+		sd.cmd[sd.cmd_len++] = mosi;
+		if (sd.cmd_len == 6) {
+			sd.cmd_len = 0;
+			sd_command(sd.cmd[0] & 0x3F,
+				   (unsigned long)sd.cmd[1] << 24 | sd.cmd[2] << 16 |
+				   sd.cmd[3] << 8 | sd.cmd[4]);
+		}
+	}
+	return miso;
+}
+
+/*
+ * ST7735
+ */
+
+#define LCD_W LCD_PIXEL_WIDTH
+#define LCD_H LCD_PIXEL_HEIGHT
+
+static struct {
+	int cs, dc;
+	uint8_t cmd;
+	int nparam;
+	uint8_t param[4];
+	uint8_t madctl;
+	int xs, xe, ys, ye, x, y;
+	int hi;
+	uint8_t hibyte;
+	uint16_t fb[LCD_H][LCD_W];
+	unsigned long windows, pixels;
+	int errors;
+} lcd;
+
+static void lcd_pixel(uint16_t color)
+{
+	int row = (lcd.madctl & 0x80) ? lcd.y : (LCD_H - 1) - lcd.y;
+
+	if (lcd.x < 0 || lcd.x >= LCD_W || row < 0 || row >= LCD_H) {
+		lcd.errors++;
+	} else {
+		lcd.fb[row][lcd.x] = color;
+		lcd.pixels++;
+	}
+	if (++lcd.x > lcd.xe) {
+		lcd.x = lcd.xs;
+		if (++lcd.y > lcd.ye)
+			lcd.y = lcd.ys;
+	}
+}
+
+static void lcd_byte(uint8_t mosi)
+{
+	if (!lcd.dc) {
+		lcd.cmd = mosi;
+		lcd.nparam = 0;
+		if (mosi == RAMWR) {
+			lcd.x = lcd.xs;
+			lcd.y = lcd.ys;
+			lcd.hi = 1;
+			lcd.windows++;
+		}
+		return;
+	}
+	if (lcd.cmd == RAMWR) {
+		if (lcd.hi)
+			lcd.hibyte = mosi;
+		else
+			lcd_pixel(lcd.hibyte << 8 | mosi);
+		lcd.hi = !lcd.hi;
+		return;
+	}
+	if (lcd.nparam < 4)
+		lcd.param[lcd.nparam] = mosi;
+	lcd.nparam++;
+	if (lcd.cmd == MADCTL && lcd.nparam == 1)
+		lcd.madctl = mosi;
+	if (lcd.cmd == CASET && lcd.nparam == 4) {
+		lcd.xs = lcd.param[0] << 8 | lcd.param[1];
+		lcd.xe = lcd.param[2] << 8 | lcd.param[3];
+	}
+	if (lcd.cmd == RASET && lcd.nparam == 4) {
+		lcd.ys = lcd.param[0] << 8 | lcd.param[1];
+		lcd.ye = lcd.param[2] << 8 | lcd.param[3];
+	}
+}
+
+/*
+ * Bus, control lines and DMA
+ */
+
+static struct {
+	const uint16_t *buf;
+	uint16_t len;
+	int pending;
+	unsigned long pio_bytes, dma_bytes;
+	unsigned long overlap_polls;
+} bus;
+
+static uint8_t spi_xfer(uint8_t mosi)
+{
+	uint8_t miso = 0xFF;
+
+	if (!sd.cs && !lcd.cs) {
+		fprintf(stderr, "spi: SD and LCD both selected\n");
+		lcd.errors++;
+	}
+	if (!sd.cs)
+		miso = sd_byte(mosi);
+	if (!lcd.cs)
+		lcd_byte(mosi);
+	return miso;
+}
+
+static void dma_flush(void)
+{
+	uint16_t i;
+
+	if (!bus.pending)
+		return;
+	for (i = 0; i < bus.len; i++) {
+		spi_xfer(bus.buf[i] >> 8);
+		spi_xfer(bus.buf[i] & 0xFF);
+	}
+	bus.dma_bytes += 2 * bus.len;
+	bus.pending = 0;
+}
+
+void test_sd_cs(int low)
+{
+	dma_flush();
+	if (!low && sd.streaming) {
+		fprintf(stderr, "sd: deselected during a multiple block read\n");
+		sd.errors++;
+		sd.streaming = 0;
+	}
+	if (!low)
+		sd.out_head = sd.out_tail = 0;
+	sd.cs = !low;
+}
+
+void test_lcd_cs(int low)
+{
+	if (!low && bus.pending) {
+		fprintf(stderr, "lcd: deselected during a DMA write\n");
+		lcd.errors++;
+	}
+	dma_flush();
+	lcd.cs = !low;
+}
+
+void test_lcd_dc(int high)
+{
+	dma_flush();
+	lcd.dc = high;
+}
+
+void SD_CtrlLines_Config(void)
+{
+	sd.cs = 1;
+}
+
+uint8_t STM_SPI_WriteRead(uint8_t Data)
+{
+	dma_flush();
+	bus.pio_bytes++;
+	return spi_xfer(Data);
+}
+
+void STM_SPI_ReadBuffer(uint8_t *pBuffer, uint16_t Length)
+{
+	dma_flush();
+	bus.dma_bytes += Length;
+	while (Length--)
+		*pBuffer++ = spi_xfer(0xFF);
+}
+
+void STM_SPI_WriteBuffer(const uint8_t *pBuffer, uint16_t Length)
+{
+	dma_flush();
+	bus.dma_bytes += Length;
+	while (Length--)
+		spi_xfer(*pBuffer++);
+}
+
+void STM_SPI_StartWrite16(const uint16_t *pBuffer, uint16_t Length)
+{
+	dma_flush();
+	bus.buf = pBuffer;
+	bus.len = Length;
+	bus.pending = Length != 0;
+}
+
+void STM_SPI_WaitTransfer(void)
+{
+	if (bus.pending)
+		bus.overlap_polls++;
+	dma_flush();
+}
+
+/* The two LCD primitives of app_stm32_adafruit_spi_lcd.c used by the
+   bitmap code */
+void LCD_WriteCommand(uint8_t LCD_Reg)
+{
+	LCD_DC_LOW();
+	STM_SPI_WriteRead(LCD_Reg);
+}
+
+void LCD_WriteData(uint8_t value)
+{
+	LCD_DC_HIGH();
+	STM_SPI_WriteRead(value);
+}
+
+/*
+ * Bitmaps
+ */
+
+static uint16_t pattern(int x, int y)
+{
+	return (uint16_t)((x * 517 + y * 1031) ^ (y << 11) ^ (x << 3));
+}
+
+static unsigned long make_bmp(uint8_t *out, int w, int h, int bpp)
+{
+	unsigned header = bpp == 16 ? 66 : 54;
+	unsigned line = (w * bpp / 8 + 3) & ~3;
+	unsigned long size = header + (unsigned long)line * h;
+	int x, y;
+
+	memset(out, 0, size);
+	out[0] = 'B'; out[1] = 'M';
+	put32(out + 2, size);
+	put32(out + 10, header);
+	put32(out + 14, 40);
+	put32(out + 18, w);
+	put32(out + 22, h);
+	put16(out + 26, 1);
+	put16(out + 28, bpp);
+	if (bpp == 16) {
+		put32(out + 30, 3);       /* BI_BITFIELDS, RGB565 masks */
+		put32(out + 54, 0xF800);
+		put32(out + 58, 0x07E0);
+		put32(out + 62, 0x001F);
+	}
+	for (y = 0; y < h; y++) {
+		/* bottom line first */
+		uint8_t *p = out + header + (unsigned long)line * (h - 1 - y);
+
+		for (x = 0; x < w; x++) {
+			uint16_t c = pattern(x, y);
+
+			if (bpp == 16) {
+				put16(p + 2 * x, c);
+			} else {
+				p[3 * x] = (c & 0x1F) << 3;
+				p[3 * x + 1] = ((c >> 5) & 0x3F) << 2;
+				p[3 * x + 2] = (c >> 11) << 3;
+			}
+		}
+	}
+	return size;
+}
+
+static uint8_t filebuf[128 * 160 * 3 + 1024];
+static FATFS fatfs;
+
+static void setup(void)
+{
+	memset(&sd, 0, sizeof(sd));
+	memset(&lcd, 0, sizeof(lcd));
+	memset(&bus, 0, sizeof(bus));
+	sd.cs = lcd.cs = 1;
+	sd.fail_read = sd.fail_write = ~0UL;
+	lcd.madctl = 0xC0;
+	build_image();
+}
+
+static void mount(void)
+{
+	CHECK(SD_ADAFRUIT_Init() == SD_RESPONSE_NO_ERROR);
+	CHECK(f_mount(&fatfs, "", 1) == FR_OK);
+}
+
+static void fill_fb(uint16_t v)
+{
+	int x, y;
+
+	for (y = 0; y < LCD_H; y++)
+		for (x = 0; x < LCD_W; x++)
+			lcd.fb[y][x] = v;
+}
+
+/* Checks the image occupies the w x h area whose bottom right pixel is
+   (xr, yb), and that nothing else was drawn */
+static int check_fb(int xr, int yb, int w, int h)
+{
+	int x, y, bad = 0;
+
+	for (y = 0; y < LCD_H; y++)
+		for (x = 0; x < LCD_W; x++) {
+			int ix = x - (xr + 1 - w), iy = y - (yb + 1 - h);
+			uint16_t want = 0xDEAD;
+
+			if (ix >= 0 && ix < w && iy >= 0 && iy < h)
+				want = pattern(ix, iy);
+			if (lcd.fb[y][x] != want)
+				bad++;
+		}
+	return bad;
+}
+
+static void show(const char *what, int w, int h)
+{
+	unsigned long pix = 2UL * w * h;
+	unsigned long total = bus.pio_bytes + bus.dma_bytes;
+
+	printf("%s: %lu bus bytes for %lu pixel bytes, %lu by DMA; "
+	       "CMD17 %lu, CMD18 %lu, %lu LCD windows, %lu waits on DMA\n",
+	       what, total, pix, bus.dma_bytes, sd.cmds[17], sd.cmds[18],
+	       lcd.windows, bus.overlap_polls);
+}
+
+static void test_full_screen(void)
+{
+	unsigned long size;
+
+	setup();
+	size = make_bmp(filebuf, 128, 160, 16);
+	add_file("IMAGE16 BMP", filebuf, size);
+	mount();
+	fill_fb(0xDEAD);
+
+	memset(&bus, 0, sizeof(bus));
+	memset(sd.cmds, 0, sizeof(sd.cmds));
+	CHECK(Storage_OpenReadFile(127, 159, "IMAGE16.BMP") == 0);
+	CHECK(check_fb(127, 159, 128, 160) == 0);
+	CHECK(lcd.errors == 0 && sd.errors == 0);
+	CHECK(lcd.madctl == 0xC0);
+	CHECK(lcd.cs && sd.cs && !bus.pending);
+	/* 8 lines per window, most of the file read by CMD18 */
+	CHECK(lcd.windows == 160 / 8);
+	CHECK(sd.cmds[18] >= 1);
+	CHECK(sd.cmds[17] <= sd.cmds[18] + 3);
+	/* Pixels and file data go by DMA, the rest is commands and tokens */
+	CHECK(bus.dma_bytes >= 2 * 2UL * 128 * 160);
+	CHECK(bus.pio_bytes < (2UL * 128 * 160) / 20);
+	show("128x160 16 bpp", 128, 160);
+}
+
+static void test_placed(int bpp, int w, int h, int xr, int yb)
+{
+	unsigned long size;
+
+	setup();
+	size = make_bmp(filebuf, w, h, bpp);
+	add_file("PLACED  BMP", filebuf, size);
+	mount();
+	fill_fb(0xDEAD);
+
+	memset(&bus, 0, sizeof(bus));
+	CHECK(Storage_OpenReadFile(xr, yb, "PLACED.BMP") == 0);
+	CHECK(check_fb(xr, yb, w, h) == 0);
+	CHECK(lcd.errors == 0 && sd.errors == 0);
+	CHECK(lcd.madctl == 0xC0);
+	CHECK(lcd.windows == (unsigned long)(h + 7) / 8);
+	if (bpp == 24) {
+		char what[32];
+
+		snprintf(what, sizeof(what), "%dx%d 24 bpp", w, h);
+		show(what, w, h);
+	}
+}
+
+static void test_rejected(void)
+{
+	unsigned long size;
+
+	setup();
+	size = make_bmp(filebuf, 64, 64, 16);
+	add_file("SMALL   BMP", filebuf, size);
+	size = make_bmp(filebuf, 32, 32, 16);
+	put16(filebuf + 28, 8);           /* 8 bpp */
+	add_file("PALETTE BMP", filebuf, size);
+	memcpy(filebuf, "XX", 2);
+	add_file("NOTBMP  BMP", filebuf, size);
+	mount();
+	fill_fb(0xDEAD);
+
+	CHECK(Storage_OpenReadFile(62, 159, "SMALL.BMP") == 1);    /* too wide */
+	CHECK(Storage_OpenReadFile(127, 62, "SMALL.BMP") == 1);    /* too high */
+	CHECK(Storage_OpenReadFile(127, 160, "SMALL.BMP") == 1);   /* off screen */
+	CHECK(Storage_OpenReadFile(127, 159, "PALETTE.BMP") == 1);
+	CHECK(Storage_OpenReadFile(127, 159, "NOTBMP.BMP") == 1);
+	CHECK(Storage_OpenReadFile(127, 159, "MISSING.BMP") == 1);
+	CHECK(check_fb(0, 0, 0, 0) == 0);
+	CHECK(lcd.cs && sd.cs);
+	CHECK(Storage_OpenReadFile(63, 63, "SMALL.BMP") == 0);
+	CHECK(check_fb(63, 63, 64, 64) == 0);
+}
+
+static uint8_t big[16384], back[16384];
+
+static void test_multi_block_io(void)
+{
+	FIL f;
+	UINT n;
+	unsigned i;
+	unsigned long written;
+
+	setup();
+	mount();
+	for (i = 0; i < sizeof(big); i++)
+		big[i] = (uint8_t)(i * 7 + (i >> 9));
+
+	memset(sd.cmds, 0, sizeof(sd.cmds));
+	CHECK(f_open(&f, "BIG.BIN", FA_CREATE_ALWAYS | FA_WRITE) == FR_OK);
+	CHECK(f_write(&f, big, sizeof(big), &n) == FR_OK && n == sizeof(big));
+	CHECK(f_close(&f) == FR_OK);
+	written = sd.blocks_written;
+	/* whole clusters go out with CMD25, 4 blocks each */
+	CHECK(sd.cmds[25] == sizeof(big) / (SPC * 512));
+	CHECK(written >= sizeof(big) / 512);
+	CHECK(sd.errors == 0 && sd.cs);
+	printf("16 KB write: CMD24 %lu, CMD25 %lu, %lu blocks\n",
+	       sd.cmds[24], sd.cmds[25], written);
+
+	memset(sd.cmds, 0, sizeof(sd.cmds));
+	CHECK(f_open(&f, "BIG.BIN", FA_READ) == FR_OK);
+	CHECK(f_read(&f, back, sizeof(back), &n) == FR_OK && n == sizeof(back));
+	CHECK(memcmp(big, back, sizeof(big)) == 0);
+	CHECK(f_close(&f) == FR_OK);
+	CHECK(sd.cmds[18] == sizeof(big) / (SPC * 512));
+	CHECK(sd.cmds[17] <= 2);           /* directory and FAT sectors */
+	CHECK(sd.errors == 0 && sd.cs);
+
+	/* Storage_CopyFile goes sector by sector */
+	CHECK(Storage_CopyFile("BIG.BIN", "COPY.BIN") == 1);
+	CHECK(f_open(&f, "COPY.BIN", FA_READ) == FR_OK);
+	memset(back, 0, sizeof(back));
+	CHECK(f_read(&f, back, sizeof(back), &n) == FR_OK && n == sizeof(back));
+	CHECK(memcmp(big, back, sizeof(big)) == 0);
+	f_close(&f);
+	CHECK(sd.errors == 0);
+}
+
+static void test_errors(void)
+{
+	uint8_t buf[SPC * 512];
+	unsigned long first;
+
+	setup();
+	mount();
+	memset(buf, 0x5A, sizeof(buf));
+	first = DATA_START + 40 * SPC;
+
+	/* An error token in the middle of a CMD18 stream */
+	sd.fail_read = (first + 2) * 512;
+	CHECK(disk_read(0, buf, first, SPC) == RES_ERROR);
+	CHECK(sd.cs && !sd.streaming && sd.errors == 0);
+	CHECK(disk_read(0, buf, first, 2) == RES_OK);
+	CHECK(memcmp(buf, image + first * 512, 1024) == 0);
+	CHECK(disk_read(0, buf, first + 2, 1) == RES_ERROR);
+	sd.fail_read = ~0UL;
+	CHECK(disk_read(0, buf, first, SPC) == RES_OK);
+	CHECK(memcmp(buf, image + first * 512, sizeof(buf)) == 0);
+
+	/* A rejected block in the middle of a CMD25 stream */
+	memset(buf, 0xC3, sizeof(buf));
+	sd.fail_write = (first + 1) * 512;
+	CHECK(disk_write(0, buf, first, SPC) == RES_ERROR);
+	CHECK(sd.cs && !sd.writing && sd.errors == 0);
+	CHECK(image[first * 512] == 0xC3);
+	CHECK(image[(first + 2) * 512] != 0xC3);
+	CHECK(disk_write(0, buf, first + 1, 1) == RES_ERROR);
+	sd.fail_write = ~0UL;
+	CHECK(disk_write(0, buf, first, SPC) == RES_OK);
+	CHECK(image[(first + SPC) * 512 - 1] == 0xC3);
+	CHECK(sd.errors == 0);
+
+	/* The card keeps working afterwards */
+	CHECK(disk_read(0, buf, 0, 1) == RES_OK);
+	CHECK(buf[510] == 0x55 && buf[511] == 0xAA);
+}
+
+int main(void)
+{
+	if (!getenv("VERBOSE"))
+		freopen("/dev/null", "w", stdout);
+
+	test_full_screen();
+	test_placed(16, 127, 100, 127, 159);   /* padded lines */
+	test_placed(16, 40, 13, 90, 70);
+	test_placed(24, 99, 50, 110, 120);
+	test_placed(24, 128, 160, 127, 159);
+	test_rejected();
+	test_multi_block_io();
+	test_errors();
+	if (failures) {
+		fprintf(stderr, "test_sdbmp: %d checks failed\n", failures);
+		return 1;
+	}
+	fprintf(stderr, "test_sdbmp: ok\n");
+	return 0;
+}
@@ -0,0 +1,826 @@
+/*
+ * Runs the sFLASH driver (stm32_eval_spi_flash.c) against a model of the
+ * M25P64 on the STM3210E-EVAL, and measures it.
+ *
+ * The model decodes WREN, RDSR, RDID, READ, FAST_READ, PP, SE and BE one
+ * byte at a time. A page program clears bits within one page (the
+ * address wraps at the page end), a sector erase sets 64 KByte to 0xFF
+ * and a bulk erase the whole chip. Both need WREN first and keep WIP set
+ * for the typical datasheet times. Any instruction other than RDSR sent
+ * while WIP is set, a program or erase without WREN, and clocking the
+ * bus without chip select are all counted as errors.
+ *
+ * Time only moves with the SPI: 444 ns per byte at 18 MHz (SPI1 at
+ * 72 MHz / 4), plus 280 ns of CPU loop around every byte that goes
+ * through SPI_I2S_SendData(). DMA bytes go back to back. While the
+ * application "works", a 1 kHz timer interrupt calls sFLASH_PollHandler().
+ * Interrupts can also be injected in the middle of a driver call.
+ *
+ * The DMA structures hold 32-bit addresses, so the test is linked
+ * without PIE and runs on a stack mapped below 2 GB.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+
+#include "stm32_eval.h"
+#include "stm32_eval_spi_flash.h"
+
+SPI_TypeDef test_spi1;
+GPIO_TypeDef test_gpiob;
+DMA_Channel_TypeDef test_dma1_ch2 = { 2 }, test_dma1_ch3 = { 3 };
+
+static int failures;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: check failed: %s\n", \
+			__FILE__, __LINE__, #cond); \
+		failures++; \
+	} } while (0)
+
+/*
+ * M25P64
+ */
+
+#define FLASH_SIZE   0x800000u
+#define SECTOR_SIZE  0x10000u
+#define PAGE_SIZE    256u
+
+#define BYTE_NS      444ull
+#define CPU_BYTE_NS  280ull
+#define TPP_NS       1400000ull
+#define TSE_NS       1000000000ull
+#define TBE_NS       68000000000ull
+#define TICK_NS      1000000ull
+
+#define CMD_WRSR     0x01
+#define CMD_PP       0x02
+#define CMD_READ     0x03
+#define CMD_RDSR     0x05
+#define CMD_WREN     0x06
+#define CMD_FAST     0x0B
+#define CMD_RDID     0x9F
+#define CMD_BE       0xC7
+#define CMD_SE       0xD8
+
+static uint8_t mem[FLASH_SIZE];
+static uint8_t ref[FLASH_SIZE];
+
+static struct {
+	unsigned long long t;
+	unsigned long long busy_until;
+	int wel;
+	int selected;
+	int n;
+	int ignored;
+	uint8_t cmd;
+	uint32_t addr;
+	uint8_t latch[PAGE_SIZE];
+
+	unsigned long cmds[256];
+	unsigned long bytes;
+	unsigned long busy_errors, wel_errors, cs_errors, dma_errors;
+} nor;
+
+static int nor_wip(void)
+{
+	return nor.t < nor.busy_until;
+}
+
+static void nor_select(void)
+{
+	if (nor.selected)
+		nor.cs_errors++;
+	nor.selected = 1;
+	nor.n = 0;
+	nor.ignored = 0;
+}
+
+static void nor_deselect(void)
+{
+	uint32_t i, base;
+
+	if (!nor.selected)
+		return;
+	nor.selected = 0;
+	if (nor.n == 0 || nor.ignored)
+		return;
+
+	switch (nor.cmd) {
+	case CMD_WREN:
+		nor.wel = 1;
+		break;
+	case CMD_PP:
+		if (nor.n < 5)
+			break;
+		if (!nor.wel) {
+			nor.wel_errors++;
+			break;
+		}
+		base = nor.addr & ~(PAGE_SIZE - 1);
+		for (i = 0; i < PAGE_SIZE; i++)
+			mem[base + i] &= nor.latch[i];
+		nor.busy_until = nor.t + TPP_NS;
+		nor.wel = 0;
+		break;
+	case CMD_SE:
+		if (nor.n != 4)
+			break;
+		if (!nor.wel) {
+			nor.wel_errors++;
+			break;
+		}
+		memset(&mem[nor.addr & ~(SECTOR_SIZE - 1)], 0xFF, SECTOR_SIZE);
+		nor.busy_until = nor.t + TSE_NS;
+		nor.wel = 0;
+		break;
+	case CMD_BE:
+		if (nor.n != 1)
+			break;
+		if (!nor.wel) {
+			nor.wel_errors++;
+			break;
+		}
+		memset(mem, 0xFF, FLASH_SIZE);
+		nor.busy_until = nor.t + TBE_NS;
+		nor.wel = 0;
+		break;
+	}
+}
+
+static uint8_t nor_xfer(uint8_t out)
+{
+	static const uint8_t id[3] = { 0x20, 0x20, 0x17 };
+	int n;
+
+	nor.bytes++;
+	if (!nor.selected) {
+		nor.cs_errors++;
+		return 0xFF;
+	}
+	n = ++nor.n;
+	if (n == 1) {
+		nor.cmd = out;
+		nor.cmds[out]++;
+		nor.addr = 0;
+		if (nor_wip() && out != CMD_RDSR) {
+			nor.ignored = 1;
+			nor.busy_errors++;
+		}
+		if (out == CMD_PP)
+			memset(nor.latch, 0xFF, PAGE_SIZE);
+		return 0xFF;
+	}
+	if (nor.ignored)
+		return 0xFF;
+
+	switch (nor.cmd) {
+	case CMD_RDSR:
+		return (nor_wip() ? 0x01 : 0) | (nor.wel ? 0x02 : 0);
+	case CMD_RDID:
+		return n <= 4 ? id[n - 2] : 0;
+	case CMD_READ:
+	case CMD_FAST:
+	case CMD_PP:
+	case CMD_SE:
+		if (n <= 4) {
+			nor.addr = (nor.addr << 8) | out;
+			return 0xFF;
+		}
+		if (nor.cmd == CMD_READ)
+			return mem[(nor.addr + n - 5) % FLASH_SIZE];
+		if (nor.cmd == CMD_FAST)
+			return n == 5 ? 0xFF : mem[(nor.addr + n - 6) % FLASH_SIZE];
+		if (nor.cmd == CMD_PP)
+			nor.latch[(nor.addr + n - 5) % PAGE_SIZE] = out;
+		return 0xFF;
+	}
+	return 0xFF;
+}
+
+/*
+ * Peripherals
+ */
+
+static struct {
+	DMA_InitTypeDef init;
+	int enabled;
+} dma[2];
+static uint32_t dma_flags;
+static uint8_t spi_rx;
+static int spi_rxne;
+static unsigned long dma_bytes;
+
+static int irq_countdown;
+static void timer_isr(void);
+
+void sFLASH_LowLevel_Init(void) {}
+void sFLASH_LowLevel_DeInit(void) {}
+void SPI_Init(SPI_TypeDef *SPIx, SPI_InitTypeDef *init) { (void)SPIx; (void)init; }
+void SPI_Cmd(SPI_TypeDef *SPIx, FunctionalState state) { (void)SPIx; (void)state; }
+
+void GPIO_ResetBits(GPIO_TypeDef *GPIOx, uint16_t pin)
+{
+	(void)GPIOx;
+	(void)pin;
+	nor_select();
+}
+
+void GPIO_SetBits(GPIO_TypeDef *GPIOx, uint16_t pin)
+{
+	(void)GPIOx;
+	(void)pin;
+	nor_deselect();
+}
+
+FlagStatus SPI_I2S_GetFlagStatus(SPI_TypeDef *SPIx, uint16_t flag)
+{
+	(void)SPIx;
+	if (flag == SPI_I2S_FLAG_RXNE)
+		return spi_rxne ? SET : RESET;
+	return SET;
+}
+
+void SPI_I2S_SendData(SPI_TypeDef *SPIx, uint16_t data)
+{
+	(void)SPIx;
+	spi_rx = nor_xfer(data);
+	spi_rxne = 1;
+	nor.t += BYTE_NS + CPU_BYTE_NS;
+	if (irq_countdown > 0 && --irq_countdown == 0)
+		timer_isr();
+}
+
+uint16_t SPI_I2S_ReceiveData(SPI_TypeDef *SPIx)
+{
+	(void)SPIx;
+	spi_rxne = 0;
+	return spi_rx;
+}
+
+void DMA_DeInit(DMA_Channel_TypeDef *ch)
+{
+	memset(&dma[ch->index - 2], 0, sizeof(dma[0]));
+	dma_flags &= ~(0xFu << (4 * (ch->index - 1)));
+}
+
+void DMA_Init(DMA_Channel_TypeDef *ch, DMA_InitTypeDef *init)
+{
+	dma[ch->index - 2].init = *init;
+}
+
+void DMA_Cmd(DMA_Channel_TypeDef *ch, FunctionalState state)
+{
+	dma[ch->index - 2].enabled = (state == ENABLE);
+}
+
+/* The transfer runs as soon as the SPI raises its DMA requests. */
+void SPI_I2S_DMACmd(SPI_TypeDef *SPIx, uint16_t req, FunctionalState state)
+{
+	DMA_InitTypeDef *rx = &dma[0].init, *tx = &dma[1].init;
+	uint32_t i;
+
+	(void)SPIx;
+	if (state != ENABLE)
+		return;
+	if (req != (SPI_I2S_DMAReq_Rx | SPI_I2S_DMAReq_Tx) ||
+	    !dma[0].enabled || !dma[1].enabled || !nor.selected ||
+	    rx->DMA_DIR != DMA_DIR_PeripheralSRC ||
+	    tx->DMA_DIR != DMA_DIR_PeripheralDST ||
+	    rx->DMA_PeripheralBaseAddr != sFLASH_SPI_DR ||
+	    tx->DMA_PeripheralBaseAddr != sFLASH_SPI_DR ||
+	    rx->DMA_BufferSize != tx->DMA_BufferSize ||
+	    rx->DMA_BufferSize == 0) {
+		nor.dma_errors++;
+		return;
+	}
+	for (i = 0; i < rx->DMA_BufferSize; i++) {
+		uint8_t *src = (uint8_t *)(uintptr_t)tx->DMA_MemoryBaseAddr;
+		uint8_t *dst = (uint8_t *)(uintptr_t)rx->DMA_MemoryBaseAddr;
+		uint8_t in = nor_xfer(src[tx->DMA_MemoryInc ? i : 0]);
+
+		dst[rx->DMA_MemoryInc ? i : 0] = in;
+		nor.t += BYTE_NS;
+	}
+	dma_bytes += rx->DMA_BufferSize;
+	dma_flags |= DMA1_FLAG_GL2 | DMA1_FLAG_TC2 | DMA1_FLAG_GL3 | DMA1_FLAG_TC3;
+}
+
+FlagStatus DMA_GetFlagStatus(uint32_t flag)
+{
+	if (!(dma_flags & flag)) {
+		/* nothing will ever set it: report instead of hanging */
+		nor.dma_errors++;
+		return SET;
+	}
+	return SET;
+}
+
+void DMA_ClearFlag(uint32_t flag)
+{
+	dma_flags &= ~flag;
+}
+
+/*
+ * Timer and application
+ */
+
+static struct {
+	unsigned long calls;
+	unsigned long long ns;
+	unsigned long max_busy_bytes;   /* bytes sent by a call that found WIP set */
+} isr;
+
+static void timer_isr(void)
+{
+	unsigned long long t0 = nor.t;
+	unsigned long bytes = nor.bytes;
+	unsigned long wren = nor.cmds[CMD_WREN];
+	unsigned long rdsr = nor.cmds[CMD_RDSR];
+
+	sFLASH_PollHandler();
+	isr.calls++;
+	isr.ns += nor.t - t0;
+	if (nor.cmds[CMD_RDSR] != rdsr && nor.cmds[CMD_WREN] == wren &&
+	    nor.bytes - bytes > isr.max_busy_bytes)
+		isr.max_busy_bytes = nor.bytes - bytes;
+}
+
+/* The application computes for a while; the 1 ms tick keeps firing. */
+static void app_work(unsigned long long ns)
+{
+	unsigned long long end = nor.t + ns;
+
+	for (;;) {
+		unsigned long long tick = (nor.t / TICK_NS + 1) * TICK_NS;
+
+		if (tick > end) {
+			if (nor.t < end)
+				nor.t = end;
+			return;
+		}
+		nor.t = tick;
+		timer_isr();
+	}
+}
+
+static void app_wait_queue(void)
+{
+	while (sFLASH_GetQueueStatus() == SET)
+		app_work(TICK_NS);
+}
+
+static unsigned long long fg_ns;
+
+#define FG(call) do { \
+	unsigned long long fg_t0 = nor.t; \
+	call; \
+	fg_ns += nor.t - fg_t0; \
+	} while (0)
+
+static void ref_program(uint32_t addr, const uint8_t *data, uint32_t len)
+{
+	uint32_t i;
+
+	for (i = 0; i < len; i++)
+		ref[addr + i] &= data[i];
+}
+
+static void ref_erase(uint32_t addr)
+{
+	memset(&ref[addr & ~(SECTOR_SIZE - 1)], 0xFF, SECTOR_SIZE);
+}
+
+static void fill_random(uint8_t *p, uint32_t len)
+{
+	while (len--)
+		*p++ = rand();
+}
+
+static int all_erased(const uint8_t *p, uint32_t len)
+{
+	while (len--)
+		if (*p++ != 0xFF)
+			return 0;
+	return 1;
+}
+
+static int errors(void)
+{
+	return nor.busy_errors + nor.wel_errors + nor.cs_errors + nor.dma_errors;
+}
+
+/*
+ * Tests
+ */
+
+static void test_id(void)
+{
+	sFLASH_Init();
+	CHECK(sFLASH_ReadID() == sFLASH_M25P64_ID);
+	CHECK(errors() == 0);
+}
+
+static void test_blocking(void)
+{
+	static uint8_t src[1000], dst[1200];
+	unsigned long read = nor.cmds[CMD_READ], fast = nor.cmds[CMD_FAST];
+	unsigned long pp = nor.cmds[CMD_PP];
+
+	memset(&mem[0x10000], 0, SECTOR_SIZE);
+	sFLASH_EraseSector(0x10000);
+	CHECK(all_erased(&mem[0x10000], SECTOR_SIZE));
+
+	fill_random(src, sizeof(src));
+	sFLASH_WriteBuffer(src, 0x10064, sizeof(src));
+	/* 156 bytes, 3 pages and 76 bytes */
+	CHECK(nor.cmds[CMD_PP] - pp == 5);
+	CHECK(memcmp(&mem[0x10064], src, sizeof(src)) == 0);
+	CHECK(mem[0x10063] == 0xFF && mem[0x10064 + sizeof(src)] == 0xFF);
+
+	sFLASH_ReadBuffer(dst, 0x10000, sizeof(dst));
+	CHECK(memcmp(dst + 0x64, src, sizeof(src)) == 0);
+	CHECK(dst[0] == 0xFF && dst[0x63] == 0xFF && dst[0x64 + sizeof(src)] == 0xFF);
+	CHECK(nor.cmds[CMD_READ] == read && nor.cmds[CMD_FAST] > fast);
+
+	/* programming clears bits only */
+	src[0] = 0x0F;
+	sFLASH_WritePage(src, 0x10000, 1);
+	src[0] = 0xF3;
+	sFLASH_WritePage(src, 0x10000, 1);
+	sFLASH_ReadBuffer(dst, 0x10000, 1);
+	CHECK(dst[0] == 0x03);
+	CHECK(errors() == 0);
+}
+
+static void test_queue(void)
+{
+	static uint8_t src[3000], dst[3100];
+	unsigned long se = nor.cmds[CMD_SE], pp = nor.cmds[CMD_PP];
+	unsigned long long t0;
+
+	memset(&mem[0x20000], 0x55, SECTOR_SIZE);
+	fill_random(src, sizeof(src));
+
+	/* the erase starts at once, three pages fit in the queue behind it */
+	t0 = nor.t;
+	sFLASH_QueueEraseSector(0x20000);
+	sFLASH_QueueWriteBuffer(src, 0x20010, 3 * PAGE_SIZE - 0x10);
+	CHECK(nor.t - t0 < 20 * PAGE_SIZE * BYTE_NS);
+	CHECK(sFLASH_GetQueueStatus() == SET);
+	CHECK(nor.cmds[CMD_SE] - se == 1 && nor.cmds[CMD_PP] == pp);
+
+	/* a full queue waits for the erase */
+	sFLASH_QueueWriteBuffer(src + 3 * PAGE_SIZE - 0x10, 0x20000 + 3 * PAGE_SIZE,
+				sizeof(src) - (3 * PAGE_SIZE - 0x10));
+	CHECK(nor.t - t0 >= TSE_NS);
+	CHECK(sFLASH_GetQueueStatus() == SET);
+
+	/* reads see the queued data */
+	sFLASH_ReadBuffer(dst, 0x20000, sizeof(dst));
+	CHECK(memcmp(dst + 0x10, src, sizeof(src)) == 0);
+	CHECK(dst[0] == 0xFF && dst[0x10 + sizeof(src)] == 0xFF);
+
+	/* the timer writes the rest, one status read per tick while busy */
+	t0 = nor.t;
+	isr.max_busy_bytes = 0;
+	app_wait_queue();
+	CHECK(nor.t - t0 < 5 * 2 * TICK_NS);
+	CHECK(isr.max_busy_bytes == 2);
+	CHECK(nor.cmds[CMD_PP] - pp == 12);
+	CHECK(memcmp(&mem[0x20010], src, sizeof(src)) == 0);
+	CHECK(mem[0x2000F] == 0xFF && mem[0x20010 + sizeof(src)] == 0xFF);
+	CHECK(errors() == 0);
+}
+
+static void test_merge_order(void)
+{
+	static uint8_t a[PAGE_SIZE], b[300], c[100], dst[2 * PAGE_SIZE];
+	uint32_t base = 0x30000;
+
+	sFLASH_EraseSector(base);
+	memset(a, 0xA5, sizeof(a));
+	sFLASH_WriteBuffer(a, base, sizeof(a));
+	memcpy(ref + base, mem + base, SECTOR_SIZE);
+
+	/* erase, then two overlapping programs; none has reached the chip */
+	fill_random(b, sizeof(b));
+	fill_random(c, sizeof(c));
+	sFLASH_QueueEraseSector(base);
+	ref_erase(base);
+	sFLASH_QueueWriteBuffer(b, base + 100, sizeof(b));
+	ref_program(base + 100, b, sizeof(b));
+	sFLASH_QueueWriteBuffer(c, base + 150, sizeof(c));
+	ref_program(base + 150, c, sizeof(c));
+
+	sFLASH_ReadBuffer(dst, base, sizeof(dst));
+	CHECK(memcmp(dst, ref + base, sizeof(dst)) == 0);
+
+	sFLASH_WaitForQueueEnd();
+	CHECK(sFLASH_GetQueueStatus() == RESET);
+	CHECK(memcmp(mem + base, ref + base, SECTOR_SIZE) == 0);
+	CHECK(errors() == 0);
+}
+
+/* Timer interrupts in the middle of driver calls keep off the bus. */
+static void test_lock(void)
+{
+	static uint8_t src[4 * PAGE_SIZE], dst[4 * PAGE_SIZE];
+	uint32_t base = 0x40000;
+	int at;
+
+	sFLASH_EraseSector(base);
+	memset(ref + base, 0xFF, SECTOR_SIZE);
+	for (at = 1; at < 12; at++) {
+		uint32_t addr = base + at * sizeof(src);
+
+		fill_random(src, sizeof(src));
+		sFLASH_QueueWriteBuffer(src, addr, sizeof(src));
+		ref_program(addr, src, sizeof(src));
+		irq_countdown = at;
+		sFLASH_ReadBuffer(dst, addr, sizeof(dst));
+		CHECK(memcmp(dst, ref + addr, sizeof(dst)) == 0);
+		irq_countdown = at;
+		sFLASH_WritePage(src, addr + sizeof(src), 10);
+		ref_program(addr + sizeof(src), src, 10);
+		irq_countdown = at;
+		sFLASH_QueueWriteBuffer(src, addr + sizeof(src) + 10, 20);
+		ref_program(addr + sizeof(src) + 10, src, 20);
+		irq_countdown = 0;
+	}
+	app_wait_queue();
+	CHECK(memcmp(mem + base, ref + base, SECTOR_SIZE) == 0);
+	CHECK(errors() == 0);
+}
+
+/* Queued, blocking and timer activity mixed at random against a reference. */
+static void test_random(void)
+{
+	static uint8_t buf[1024], dst[1024];
+	uint32_t base = 0x80000, span = 4 * SECTOR_SIZE;
+	int i, bad = 0;
+
+	for (i = 0; i < 4; i++)
+		sFLASH_QueueEraseSector(base + i * SECTOR_SIZE);
+	sFLASH_WaitForQueueEnd();
+	memcpy(ref + base, mem + base, span);
+
+	for (i = 0; i < 1500; i++) {
+		int op = rand() % 100;
+		uint32_t len = 1 + rand() % sizeof(buf);
+		uint32_t addr = base + rand() % (span - len);
+
+		if (rand() % 4 == 0)
+			irq_countdown = 1 + rand() % 40;
+		if (op < 45) {
+			fill_random(buf, len);
+			/* keep some bits set so later programs still show */
+			memset(buf, 0xFF, len / 2);
+			sFLASH_QueueWriteBuffer(buf, addr, len);
+			ref_program(addr, buf, len);
+		} else if (op < 47) {
+			sFLASH_QueueEraseSector(addr);
+			ref_erase(addr);
+		} else if (op < 52) {
+			fill_random(buf, len);
+			len = len % (PAGE_SIZE - addr % PAGE_SIZE) + 1;
+			sFLASH_WritePage(buf, addr, len);
+			ref_program(addr, buf, len);
+		} else if (op < 53) {
+			sFLASH_EraseSector(addr);
+			ref_erase(addr);
+		} else if (op < 80) {
+			sFLASH_ReadBuffer(dst, addr, len);
+			if (memcmp(dst, ref + addr, len) != 0)
+				bad++;
+		} else {
+			app_work(rand() % (3 * TICK_NS));
+		}
+		irq_countdown = 0;
+	}
+	CHECK(bad == 0);
+	app_wait_queue();
+	CHECK(memcmp(mem + base, ref + base, span) == 0);
+	CHECK(errors() == 0);
+}
+
+static uint8_t record_end(uint8_t *p, uint32_t len)
+{
+	/* records must not end with 0xFF */
+	if (p[len - 1] == 0xFF)
+		p[len - 1] = 0x7E;
+	return p[len - 1];
+}
+
+static void test_log(void)
+{
+	static uint8_t data[2 * SECTOR_SIZE], rec[300];
+	uint32_t base = 0x100000, size = 2 * SECTOR_SIZE, total = 0, len;
+	unsigned long se, pp;
+	int i;
+
+	memset(mem + base, 0xFF, size);
+	CHECK(sFLASH_LogInit(base, size) == sFLASH_OK);
+	CHECK(sFLASH_LogGetSize() == 0);
+	/* stale data in the second sector: it must be erased before use */
+	memset(mem + base + SECTOR_SIZE, 0x00, SECTOR_SIZE);
+
+	/* small records are gathered into whole pages */
+	se = nor.cmds[CMD_SE];
+	pp = nor.cmds[CMD_PP];
+	for (i = 0; i < 1000; i++) {
+		fill_random(rec, 10);
+		record_end(rec, 10);
+		CHECK(sFLASH_LogAppend(rec, 10) == sFLASH_OK);
+		memcpy(data + total, rec, 10);
+		total += 10;
+		if (i % 50 == 0)
+			app_work(TICK_NS);
+	}
+	app_wait_queue();
+	CHECK(nor.cmds[CMD_PP] - pp == total / PAGE_SIZE);
+	CHECK(nor.cmds[CMD_SE] - se == 1);
+	CHECK(sFLASH_LogGetSize() == total);
+
+	/* on into the second sector, with flushes */
+	while (total < SECTOR_SIZE + 5000) {
+		len = 1 + rand() % sizeof(rec);
+		fill_random(rec, len);
+		record_end(rec, len);
+		CHECK(sFLASH_LogAppend(rec, len) == sFLASH_OK);
+		memcpy(data + total, rec, len);
+		total += len;
+		if (rand() % 8 == 0)
+			sFLASH_LogFlush();
+		app_work(rand() % TICK_NS);
+	}
+	sFLASH_LogFlush();
+	app_wait_queue();
+	CHECK(nor.cmds[CMD_SE] - se == 2);
+	CHECK(memcmp(mem + base, data, total) == 0);
+	CHECK(mem[base + total] == 0xFF);
+
+	/* a restart finds the end, and the partly written page is reused */
+	memset(&rec, 0, sizeof(rec));
+	CHECK(sFLASH_LogInit(base, size) == sFLASH_OK);
+	CHECK(sFLASH_LogGetSize() == total);
+	fill_random(rec, 40);
+	record_end(rec, 40);
+	CHECK(sFLASH_LogAppend(rec, 40) == sFLASH_OK);
+	memcpy(data + total, rec, 40);
+	total += 40;
+	sFLASH_LogFlush();
+	app_wait_queue();
+	CHECK(nor.cmds[CMD_SE] - se == 2);
+	CHECK(memcmp(mem + base, data, total) == 0);
+
+	/* a restart on an exact page boundary */
+	len = PAGE_SIZE - total % PAGE_SIZE;
+	memset(rec, 0x11, len);
+	CHECK(sFLASH_LogAppend(rec, len) == sFLASH_OK);
+	memcpy(data + total, rec, len);
+	total += len;
+	app_wait_queue();
+	CHECK(sFLASH_LogInit(base, size) == sFLASH_OK);
+	CHECK(sFLASH_LogGetSize() == total);
+
+	/* full */
+	CHECK(sFLASH_LogAppend(rec, size - total + 1) == sFLASH_FAIL);
+	CHECK(sFLASH_LogGetSize() == total);
+
+	CHECK(sFLASH_LogInit(base + 1, size) == sFLASH_FAIL);
+	CHECK(sFLASH_LogInit(base, size - PAGE_SIZE) == sFLASH_FAIL);
+	CHECK(sFLASH_LogInit(FLASH_SIZE - SECTOR_SIZE, size) == sFLASH_FAIL);
+	CHECK(sFLASH_LogInit(base, 0) == sFLASH_FAIL);
+
+	CHECK(sFLASH_LogInit(base, size) == sFLASH_OK);
+	sFLASH_LogClear();
+	CHECK(sFLASH_LogGetSize() == 0);
+	/* the log reads back as erased before the erases are done */
+	sFLASH_ReadBuffer(rec, base, sizeof(rec));
+	CHECK(all_erased(rec, sizeof(rec)));
+	app_wait_queue();
+	CHECK(sFLASH_LogInit(base, size) == sFLASH_OK);
+	CHECK(sFLASH_LogGetSize() == 0);
+	CHECK(errors() == 0);
+}
+
+static void bench(void)
+{
+	static uint8_t buf[SECTOR_SIZE], rec[16];
+	uint32_t base = 0x200000, i;
+	unsigned long long t0, polled, dmaread, blocking, queued, wall;
+
+	/* reading 64 KByte */
+	t0 = nor.t;
+	sFLASH_StartReadSequence(base);
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = sFLASH_ReadByte();
+	sFLASH_CS_HIGH();
+	polled = nor.t - t0;
+	t0 = nor.t;
+	sFLASH_ReadBuffer(buf, base, sizeof(buf) / 2);
+	sFLASH_ReadBuffer(buf + sizeof(buf) / 2, base + sizeof(buf) / 2, sizeof(buf) / 2);
+	dmaread = nor.t - t0;
+	printf("read 64 KByte: %.2f ms byte by byte (READ), %.2f ms by DMA (FAST_READ)\n",
+	       polled / 1e6, dmaread / 1e6);
+	CHECK(dmaread * 10 < polled * 7);
+
+	/* writing 64 KByte with the blocking calls */
+	sFLASH_EraseSector(base);
+	fill_random(buf, sizeof(buf));
+	t0 = nor.t;
+	sFLASH_WriteBuffer(buf, base, sizeof(buf) / 2);
+	sFLASH_WriteBuffer(buf + sizeof(buf) / 2, base + sizeof(buf) / 2, sizeof(buf) / 2);
+	blocking = nor.t - t0;
+
+	/* producing 256 bytes every 2 ms and queueing them */
+	sFLASH_EraseSector(base);
+	fg_ns = 0;
+	isr.ns = 0;
+	t0 = nor.t;
+	for (i = 0; i < sizeof(buf); i += PAGE_SIZE) {
+		app_work(2 * TICK_NS);
+		FG(sFLASH_QueueWriteBuffer(buf + i, base + i, PAGE_SIZE));
+	}
+	app_wait_queue();
+	queued = fg_ns;
+	wall = nor.t - t0;
+	CHECK(memcmp(mem + base, buf, sizeof(buf)) == 0);
+	printf("write 64 KByte: blocking %.1f ms in the caller; queued %.1f ms in "
+	       "the caller, %.1f ms in the timer interrupt over %.0f ms\n",
+	       blocking / 1e6, queued / 1e6, isr.ns / 1e6, wall / 1e6);
+	CHECK(queued * 4 < blocking);
+
+	/* logging 16-byte records into an area erased beforehand */
+	sFLASH_LogInit(base, 2 * SECTOR_SIZE);
+	sFLASH_LogClear();
+	app_wait_queue();
+	fg_ns = 0;
+	isr.ns = 0;
+	for (i = 0; i < 4096; i++) {
+		memset(rec, i, sizeof(rec));
+		rec[15] = 0;
+		app_work(100000);
+		FG(sFLASH_LogAppend(rec, sizeof(rec)));
+	}
+	app_wait_queue();
+	printf("log 4096 x 16 bytes: %.2f us per record in the caller, "
+	       "%.2f us per record in the timer interrupt\n",
+	       fg_ns / 4096e3, isr.ns / 4096e3);
+	CHECK(fg_ns / 4096 < 20000);
+	CHECK(errors() == 0);
+}
+
+static void run_tests(void)
+{
+	uint8_t local;
+
+	CHECK((uintptr_t)mem < 0x100000000ull && (uintptr_t)&local < 0x80000000ull);
+	srand(1);
+	memset(mem, 0xFF, sizeof(mem));
+	memset(ref, 0xFF, sizeof(ref));
+	test_id();
+	test_blocking();
+	test_queue();
+	test_merge_order();
+	test_lock();
+	test_random();
+	test_log();
+	bench();
+}
+
+int main(void)
+{
+	static ucontext_t main_ctx, test_ctx;
+	size_t stack_size = 1 << 20;
+	void *stack;
+
+	if (!getenv("VERBOSE"))
+		freopen("/dev/null", "w", stdout);
+
+	stack = mmap(NULL, stack_size, PROT_READ | PROT_WRITE,
+		     MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+	if (stack == MAP_FAILED) {
+		perror("test_sflash: mmap");
+		return 1;
+	}
+	getcontext(&test_ctx);
+	test_ctx.uc_stack.ss_sp = stack;
+	test_ctx.uc_stack.ss_size = stack_size;
+	test_ctx.uc_link = &main_ctx;
+	makecontext(&test_ctx, run_tests, 0);
+	swapcontext(&main_ctx, &test_ctx);
+
+	if (failures) {
+		fprintf(stderr, "test_sflash: %d checks failed\n", failures);
+		return 1;
+	}
+	fprintf(stderr, "test_sflash: ok\n");
+	return 0;
+}
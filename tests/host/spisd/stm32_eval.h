@@ -0,0 +1,98 @@
+/*
+ * Stands in for stm32_eval.h and the StdPeriph headers behind it: just
+ * enough SPI, DMA and GPIO for the SPI SD driver, plus the STM3210B-EVAL
+ * SD resources (SPI1, DMA1 channels 2 and 3). The test owns the
+ * peripherals and the card model behind them.
+ */
+#ifndef STM32_EVAL_H
+#define STM32_EVAL_H
+
+#include <stdint.h>
+
+#define __IO volatile
+
+typedef enum { RESET = 0, SET = !RESET } FlagStatus, ITStatus;
+typedef enum { DISABLE = 0, ENABLE = !DISABLE } FunctionalState;
+
+typedef struct { int dummy; } SPI_TypeDef;
+typedef struct { int dummy; } GPIO_TypeDef;
+typedef struct { int index; } DMA_Channel_TypeDef;
+
+extern SPI_TypeDef test_spi1;
+extern GPIO_TypeDef test_gpioc, test_gpioe;
+extern DMA_Channel_TypeDef test_dma1_ch2, test_dma1_ch3;
+
+#define SPI1           (&test_spi1)
+#define GPIOC          (&test_gpioc)
+#define GPIOE          (&test_gpioe)
+#define DMA1_Channel2  (&test_dma1_ch2)
+#define DMA1_Channel3  (&test_dma1_ch3)
+#define GPIO_Pin_7     ((uint16_t)0x0080)
+#define GPIO_Pin_12    ((uint16_t)0x1000)
+
+#define DMA1_FLAG_GL2  ((uint32_t)0x00000010)
+#define DMA1_FLAG_TC2  ((uint32_t)0x00000020)
+#define DMA1_FLAG_GL3  ((uint32_t)0x00000100)
+#define DMA1_FLAG_TC3  ((uint32_t)0x00000200)
+
+/* stm3210b_eval.h */
+#define SD_SPI                           SPI1
+#define SD_CS_PIN                        GPIO_Pin_12
+#define SD_CS_GPIO_PORT                  GPIOC
+#define SD_DETECT_PIN                    GPIO_Pin_7
+#define SD_DETECT_GPIO_PORT              GPIOE
+#define SD_SPI_DR                        ((uint32_t)0x4001300C)
+#define SD_DMA_RX_CHANNEL                DMA1_Channel2
+#define SD_DMA_TX_CHANNEL                DMA1_Channel3
+#define SD_DMA_RX_FLAG_TC                DMA1_FLAG_TC2
+#define SD_DMA_RX_FLAG_GL                DMA1_FLAG_GL2
+#define SD_DMA_TX_FLAG_GL                DMA1_FLAG_GL3
+
+/* stm32f10x_spi.h */
+#define SPI_I2S_FLAG_RXNE               ((uint16_t)0x0001)
+#define SPI_I2S_FLAG_TXE                ((uint16_t)0x0002)
+#define SPI_I2S_DMAReq_Tx               ((uint16_t)0x0002)
+#define SPI_I2S_DMAReq_Rx               ((uint16_t)0x0001)
+
+FlagStatus SPI_I2S_GetFlagStatus(SPI_TypeDef *SPIx, uint16_t flag);
+void SPI_I2S_SendData(SPI_TypeDef *SPIx, uint16_t data);
+uint16_t SPI_I2S_ReceiveData(SPI_TypeDef *SPIx);
+void SPI_I2S_DMACmd(SPI_TypeDef *SPIx, uint16_t req, FunctionalState state);
+
+/* stm32f10x_dma.h */
+typedef struct {
+	uint32_t DMA_PeripheralBaseAddr, DMA_MemoryBaseAddr, DMA_DIR;
+	uint32_t DMA_BufferSize, DMA_PeripheralInc, DMA_MemoryInc;
+	uint32_t DMA_PeripheralDataSize, DMA_MemoryDataSize, DMA_Mode;
+	uint32_t DMA_Priority, DMA_M2M;
+} DMA_InitTypeDef;
+
+#define DMA_DIR_PeripheralDST           ((uint32_t)0x00000010)
+#define DMA_DIR_PeripheralSRC           ((uint32_t)0x00000000)
+#define DMA_PeripheralInc_Disable       ((uint32_t)0x00000000)
+#define DMA_MemoryInc_Enable            ((uint32_t)0x00000080)
+#define DMA_MemoryInc_Disable           ((uint32_t)0x00000000)
+#define DMA_PeripheralDataSize_Byte     ((uint32_t)0x00000000)
+#define DMA_MemoryDataSize_Byte         ((uint32_t)0x00000000)
+#define DMA_Mode_Normal                 ((uint32_t)0x00000000)
+#define DMA_Priority_VeryHigh           ((uint32_t)0x00003000)
+#define DMA_Priority_High               ((uint32_t)0x00002000)
+#define DMA_M2M_Disable                 ((uint32_t)0x00000000)
+
+void DMA_DeInit(DMA_Channel_TypeDef *ch);
+void DMA_Init(DMA_Channel_TypeDef *ch, DMA_InitTypeDef *init);
+void DMA_Cmd(DMA_Channel_TypeDef *ch, FunctionalState state);
+uint16_t DMA_GetCurrDataCounter(DMA_Channel_TypeDef *ch);
+FlagStatus DMA_GetFlagStatus(uint32_t flag);
+void DMA_ClearFlag(uint32_t flag);
+
+/* stm32f10x_gpio.h */
+void GPIO_SetBits(GPIO_TypeDef *GPIOx, uint16_t pin);
+void GPIO_ResetBits(GPIO_TypeDef *GPIOx, uint16_t pin);
+uint16_t GPIO_ReadInputData(GPIO_TypeDef *GPIOx);
+
+/* stm3210b_eval.c */
+void SD_LowLevel_DeInit(void);
+void SD_LowLevel_Init(void);
+
+#endif
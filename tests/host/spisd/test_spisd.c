@@ -0,0 +1,917 @@
+/*
+ * Runs the SPI SD driver (stm32_eval_spi_sd.c) against a model of a
+ * standard capacity SD card in SPI mode on the STM3210B-EVAL, and
+ * measures it.
+ *
+ * The card decodes CMD0, 1, 9, 10, 12, 13, 16, 17, 18, 24, 25, 55 and
+ * ACMD23 from the bytes it is clocked, one byte at a time: R1 comes one
+ * byte after the command, a data token after the read access time, and
+ * a written block is answered with its data response followed by busy
+ * (MISO low) for the programming time. CMD18 streams blocks until CMD12,
+ * whose R1 follows a stuff byte that is not 0xFF. CMD25 takes 0xFC blocks
+ * until the 0xFD stop token. The card computes the CRC16 of every block
+ * it sends and checks the one of every block it receives, and can be
+ * told to corrupt a byte of a block on the wire.
+ *
+ * The times are the model's, typical of a class 4 card: 300 us to the
+ * first block of a read, 40 us to the next ones of a CMD18, 1.5 ms to
+ * program a CMD24 block, 700 us for a CMD25 block and 200 us for one
+ * that ACMD23 announced, since the card erased it beforehand.
+ *
+ * Time only moves with the SPI: 444 ns per byte at 18 MHz (SPI1 at
+ * 72 MHz / 4), plus 280 ns of CPU loop around every byte that goes
+ * through SPI_I2S_SendData(). DMA bytes go back to back, and the DMA
+ * only moves on while the CPU looks at it, so the driver sees a block
+ * arrive a few bytes at a time.
+ *
+ * The DMA structures hold 32-bit addresses, so the test is linked
+ * without PIE and runs on a stack mapped below 2 GB.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+
+#include "stm32_eval.h"
+#include "stm32_eval_spi_sd.h"
+
+SPI_TypeDef test_spi1;
+GPIO_TypeDef test_gpioc, test_gpioe;
+DMA_Channel_TypeDef test_dma1_ch2 = { 2 }, test_dma1_ch3 = { 3 };
+
+static int failures;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: check failed: %s\n", \
+			__FILE__, __LINE__, #cond); \
+		failures++; \
+	} } while (0)
+
+/*
+ * SD card
+ */
+
+#define CARD_SIZE    0x1000000u
+#define BLOCK        512u
+
+#define BYTE_NS      444ull
+#define CPU_BYTE_NS  280ull
+#define NAC_NS       300000ull
+#define NAC_NEXT_NS  40000ull
+#define TPROG_NS     1500000ull
+#define TMULTI_NS    700000ull
+#define TERASED_NS   200000ull
+#define TSTOP_NS     250000ull
+#define TCMD12_NS    2000ull
+
+enum { S_CMD, S_READ, S_WRITE };
+
+static uint8_t mem[CARD_SIZE];
+static uint8_t ref[CARD_SIZE];
+
+static struct {
+	unsigned long long t;
+	unsigned long long busy_until;
+	unsigned long long token_at;
+	int selected;
+	int state;
+	int multi;
+	int idle;
+	int init_tries;
+	int app;
+	uint32_t addr;
+	uint32_t preerase_next, preerase;
+
+	uint8_t frame[6];
+	int nframe;
+	uint8_t out[64];
+	int out_head, out_n;
+
+	int pos;                /* -1 before the token, then data and CRC */
+	uint16_t crc;
+	uint8_t in[BLOCK + 2];
+
+	int corrupt_in;         /* corrupt the n-th block sent from now on */
+
+	unsigned long cmds[64], acmds[64];
+	unsigned long blocks_read, blocks_written, erased_blocks;
+	unsigned long bytes;
+	unsigned long busy_errors, proto_errors, crc_errors, cs_errors, dma_errors;
+} card;
+
+static const uint8_t csd[16] = {
+	0x00, 0x26, 0x00, 0x32, 0x5F, 0x59, 0x80, 0x0F,
+	0xC0, 0x0F, 0x80, 0x7F, 0x80, 0x0A, 0x40, 0x01
+};
+static const uint8_t cid[16] = {
+	0x03, 'S', 'D', 'S', 'U', '0', '1', '6',
+	0x80, 0x12, 0x34, 0x56, 0x78, 0x00, 0xA3, 0x01
+};
+
+static uint16_t crc16(uint16_t crc, uint8_t d)
+{
+	int i;
+
+	crc ^= (uint16_t)d << 8;
+	for (i = 0; i < 8; i++)
+		crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+	return crc;
+}
+
+static uint16_t crc16_block(const uint8_t *p, uint32_t len)
+{
+	uint16_t crc = 0;
+
+	while (len--)
+		crc = crc16(crc, *p++);
+	return crc;
+}
+
+static void card_push(uint8_t b)
+{
+	if (card.out_n == sizeof(card.out)) {
+		card.proto_errors++;
+		return;
+	}
+	card.out[(card.out_head + card.out_n++) % sizeof(card.out)] = b;
+}
+
+static void card_push_data(const uint8_t *p, int len)
+{
+	uint16_t crc = crc16_block(p, len);
+	int i;
+
+	card_push(0xFE);
+	for (i = 0; i < len; i++)
+		card_push(p[i]);
+	card_push(crc >> 8);
+	card_push(crc);
+}
+
+static int card_busy(void)
+{
+	return card.t < card.busy_until;
+}
+
+static void card_select(void)
+{
+	if (card.selected)
+		card.cs_errors++;
+	card.selected = 1;
+}
+
+static void card_deselect(void)
+{
+	card.selected = 0;
+	card.nframe = 0;
+	card.out_n = 0;
+	if (card.state == S_READ) {
+		/* CMD18 must be closed with CMD12 */
+		if (card.multi)
+			card.proto_errors++;
+		card.state = S_CMD;
+	}
+	if (card.state == S_WRITE) {
+		card.proto_errors++;
+		card.state = S_CMD;
+	}
+}
+
+static int card_address_ok(uint32_t arg)
+{
+	return arg % BLOCK == 0 && arg < CARD_SIZE;
+}
+
+static void card_command(uint8_t cmd, uint32_t arg)
+{
+	int app = card.app;
+	uint8_t r1 = card.idle ? 0x01 : 0x00;
+
+	card.app = 0;
+	card_push(0xFF);                /* NCR */
+	if (app) {
+		card.acmds[cmd]++;
+		if (cmd == 23)
+			card.preerase_next = arg & 0x7FFFFF;
+		else if (cmd != 41)
+			r1 |= 0x04;
+		card_push(r1);
+		return;
+	}
+	card.cmds[cmd]++;
+	if (card.idle && cmd != 0 && cmd != 1 && cmd != 55) {
+		card_push(r1 | 0x04);
+		return;
+	}
+	switch (cmd) {
+	case 0:
+		card.idle = 1;
+		card.init_tries = 0;
+		card.state = S_CMD;
+		card_push(0x01);
+		break;
+	case 1:
+		if (++card.init_tries >= 3)
+			card.idle = 0;
+		card_push(card.idle ? 0x01 : 0x00);
+		break;
+	case 9:
+	case 10:
+		card_push(r1);
+		card_push(0xFF);
+		card_push_data(cmd == 9 ? csd : cid, 16);
+		break;
+	case 12:
+		if (card.state != S_READ || !card.multi) {
+			card_push(r1 | 0x04);
+			break;
+		}
+		/* the stuff byte, then R1b */
+		card.out_n = 0;
+		card_push(0x5A);
+		card_push(0xFF);
+		card_push(r1);
+		card.state = S_CMD;
+		card.busy_until = card.t + 3 * BYTE_NS + TCMD12_NS;
+		break;
+	case 13:
+		card_push(r1);
+		card_push(0x00);
+		break;
+	case 16:
+		card_push(arg == BLOCK ? r1 : (r1 | 0x40));
+		break;
+	case 17:
+	case 18:
+		if (!card_address_ok(arg)) {
+			card_push(r1 | 0x20);
+			break;
+		}
+		card_push(r1);
+		card.state = S_READ;
+		card.multi = cmd == 18;
+		card.addr = arg;
+		card.pos = -1;
+		card.token_at = card.t + NAC_NS;
+		break;
+	case 24:
+	case 25:
+		if (!card_address_ok(arg)) {
+			card_push(r1 | 0x20);
+			break;
+		}
+		card_push(r1);
+		card.state = S_WRITE;
+		card.multi = cmd == 25;
+		card.addr = arg;
+		card.pos = -1;
+		card.preerase = cmd == 25 ? card.preerase_next : 0;
+		card.preerase_next = 0;
+		break;
+	case 55:
+		card.app = 1;
+		card_push(r1);
+		break;
+	default:
+		card_push(r1 | 0x04);
+		break;
+	}
+}
+
+/* What the card drives on MISO for the next byte. */
+static uint8_t card_out(void)
+{
+	uint8_t b;
+
+	if (!card.selected)
+		return 0xFF;
+	if (card.out_n) {
+		b = card.out[card.out_head];
+		card.out_head = (card.out_head + 1) % sizeof(card.out);
+		card.out_n--;
+		return b;
+	}
+	if (card_busy())
+		return 0x00;
+	if (card.state != S_READ || card.t < card.token_at)
+		return 0xFF;
+
+	if (card.pos < 0) {
+		card.pos = 0;
+		card.crc = crc16_block(&mem[card.addr], BLOCK);
+		return 0xFE;
+	}
+	if (card.pos < (int)BLOCK) {
+		b = mem[card.addr + card.pos];
+		if (card.corrupt_in == 1 && card.pos == 100)
+			b ^= 0x10;
+		card.pos++;
+		return b;
+	}
+	b = card.pos == BLOCK ? card.crc >> 8 : card.crc;
+	if (++card.pos == BLOCK + 2) {
+		card.blocks_read++;
+		if (card.corrupt_in > 0)
+			card.corrupt_in--;
+		if (card.multi && card.addr + BLOCK < CARD_SIZE) {
+			card.addr += BLOCK;
+			card.pos = -1;
+			card.token_at = card.t + NAC_NEXT_NS;
+		} else {
+			card.state = S_CMD;
+		}
+	}
+	return b;
+}
+
+static void card_write_byte(uint8_t in)
+{
+	unsigned long long tprog;
+
+	if (card.pos < 0) {
+		if (in == 0xFF)
+			return;
+		if (card.multi && in == 0xFD) {
+			card_push(0xFF);        /* Nbr */
+			card.busy_until = card.t + 2 * BYTE_NS + TSTOP_NS;
+			card.state = S_CMD;
+		} else if (in == (card.multi ? 0xFC : 0xFE)) {
+			card.pos = 0;
+		} else {
+			card.proto_errors++;
+		}
+		return;
+	}
+	card.in[card.pos++] = in;
+	if (card.pos < (int)BLOCK + 2)
+		return;
+
+	if (crc16_block(card.in, BLOCK) != ((card.in[BLOCK] << 8) | card.in[BLOCK + 1]))
+		card.crc_errors++;
+	memcpy(&mem[card.addr], card.in, BLOCK);
+	card.blocks_written++;
+	if (!card.multi) {
+		tprog = TPROG_NS;
+	} else if (card.preerase) {
+		card.preerase--;
+		card.erased_blocks++;
+		tprog = TERASED_NS;
+	} else {
+		tprog = TMULTI_NS;
+	}
+	card_push(0xE5);                /* data accepted */
+	card.busy_until = card.t + 2 * BYTE_NS + tprog;
+	if (card.multi && card.addr + BLOCK < CARD_SIZE) {
+		card.addr += BLOCK;
+		card.pos = -1;
+	} else {
+		card.state = S_CMD;
+	}
+}
+
+/* Takes the byte the host drives on MOSI. */
+static void card_in(uint8_t in)
+{
+	if (!card.selected)
+		return;
+	if (card_busy() && !card.out_n) {
+		/* only clocks with MOSI high while programming */
+		if (in != 0xFF)
+			card.busy_errors++;
+		return;
+	}
+	if (card.state == S_WRITE) {
+		card_write_byte(in);
+		return;
+	}
+	if (card.nframe == 0 && (in & 0xC0) != 0x40) {
+		if (in != 0xFF)
+			card.proto_errors++;
+		return;
+	}
+	card.frame[card.nframe++] = in;
+	if (card.nframe == 6) {
+		card.nframe = 0;
+		card_command(card.frame[0] & 0x3F,
+			     ((uint32_t)card.frame[1] << 24) | (card.frame[2] << 16) |
+			     (card.frame[3] << 8) | card.frame[4]);
+	}
+}
+
+static uint8_t card_xfer(uint8_t in)
+{
+	uint8_t out = card_out();
+
+	card.bytes++;
+	card_in(in);
+	return out;
+}
+
+/*
+ * Peripherals
+ */
+
+static struct {
+	DMA_InitTypeDef init;
+	int enabled;
+} dma[2];
+static uint32_t dma_flags;
+static uint32_t dma_pos, dma_len;
+static int dma_running;
+static uint8_t spi_rx;
+static int spi_rxne;
+
+void SD_LowLevel_Init(void) {}
+void SD_LowLevel_DeInit(void) {}
+
+void GPIO_ResetBits(GPIO_TypeDef *GPIOx, uint16_t pin)
+{
+	if (GPIOx == SD_CS_GPIO_PORT && pin == SD_CS_PIN)
+		card_select();
+}
+
+void GPIO_SetBits(GPIO_TypeDef *GPIOx, uint16_t pin)
+{
+	if (GPIOx == SD_CS_GPIO_PORT && pin == SD_CS_PIN)
+		card_deselect();
+}
+
+uint16_t GPIO_ReadInputData(GPIO_TypeDef *GPIOx)
+{
+	(void)GPIOx;
+	return 0;               /* card detect low: present */
+}
+
+FlagStatus SPI_I2S_GetFlagStatus(SPI_TypeDef *SPIx, uint16_t flag)
+{
+	(void)SPIx;
+	if (flag == SPI_I2S_FLAG_RXNE)
+		return spi_rxne ? SET : RESET;
+	return SET;
+}
+
+void SPI_I2S_SendData(SPI_TypeDef *SPIx, uint16_t data)
+{
+	(void)SPIx;
+	if (dma_running)
+		card.dma_errors++;
+	spi_rx = card_xfer(data);
+	spi_rxne = 1;
+	card.t += BYTE_NS + CPU_BYTE_NS;
+}
+
+uint16_t SPI_I2S_ReceiveData(SPI_TypeDef *SPIx)
+{
+	(void)SPIx;
+	spi_rxne = 0;
+	return spi_rx;
+}
+
+void DMA_DeInit(DMA_Channel_TypeDef *ch)
+{
+	memset(&dma[ch->index - 2], 0, sizeof(dma[0]));
+	dma_flags &= ~(0xFu << (4 * (ch->index - 1)));
+}
+
+void DMA_Init(DMA_Channel_TypeDef *ch, DMA_InitTypeDef *init)
+{
+	dma[ch->index - 2].init = *init;
+}
+
+void DMA_Cmd(DMA_Channel_TypeDef *ch, FunctionalState state)
+{
+	dma[ch->index - 2].enabled = (state == ENABLE);
+}
+
+/* Moves up to n bytes of the running transfer. */
+static void dma_step(uint32_t n)
+{
+	DMA_InitTypeDef *rx = &dma[0].init, *tx = &dma[1].init;
+	uint8_t *src = (uint8_t *)(uintptr_t)tx->DMA_MemoryBaseAddr;
+	uint8_t *dst = (uint8_t *)(uintptr_t)rx->DMA_MemoryBaseAddr;
+
+	while (dma_running && n--) {
+		uint8_t in = card_xfer(src[tx->DMA_MemoryInc ? dma_pos : 0]);
+
+		dst[rx->DMA_MemoryInc ? dma_pos : 0] = in;
+		card.t += BYTE_NS;
+		if (++dma_pos == dma_len) {
+			dma_running = 0;
+			dma_flags |= DMA1_FLAG_GL2 | DMA1_FLAG_TC2 |
+				     DMA1_FLAG_GL3 | DMA1_FLAG_TC3;
+		}
+	}
+}
+
+void SPI_I2S_DMACmd(SPI_TypeDef *SPIx, uint16_t req, FunctionalState state)
+{
+	DMA_InitTypeDef *rx = &dma[0].init, *tx = &dma[1].init;
+
+	(void)SPIx;
+	if (state != ENABLE) {
+		if (dma_running)
+			card.dma_errors++;
+		dma_running = 0;
+		return;
+	}
+	if (req != (SPI_I2S_DMAReq_Rx | SPI_I2S_DMAReq_Tx) ||
+	    !dma[0].enabled || !dma[1].enabled || !card.selected ||
+	    rx->DMA_DIR != DMA_DIR_PeripheralSRC ||
+	    tx->DMA_DIR != DMA_DIR_PeripheralDST ||
+	    rx->DMA_PeripheralBaseAddr != SD_SPI_DR ||
+	    tx->DMA_PeripheralBaseAddr != SD_SPI_DR ||
+	    rx->DMA_BufferSize != tx->DMA_BufferSize ||
+	    rx->DMA_BufferSize == 0) {
+		card.dma_errors++;
+		return;
+	}
+	dma_pos = 0;
+	dma_len = rx->DMA_BufferSize;
+	dma_running = 1;
+}
+
+uint16_t DMA_GetCurrDataCounter(DMA_Channel_TypeDef *ch)
+{
+	if (ch != SD_DMA_RX_CHANNEL)
+		card.dma_errors++;
+	dma_step(16);
+	return dma_running ? dma_len - dma_pos : 0;
+}
+
+FlagStatus DMA_GetFlagStatus(uint32_t flag)
+{
+	dma_step(dma_len);
+	if (!(dma_flags & flag)) {
+		/* nothing will ever set it: report instead of hanging */
+		card.dma_errors++;
+	}
+	return SET;
+}
+
+void DMA_ClearFlag(uint32_t flag)
+{
+	dma_flags &= ~flag;
+}
+
+/*
+ * Helpers
+ */
+
+static void fill_random(uint8_t *p, uint32_t len)
+{
+	while (len--)
+		*p++ = rand();
+}
+
+static int errors(void)
+{
+	return card.busy_errors + card.proto_errors + card.crc_errors +
+	       card.cs_errors + card.dma_errors;
+}
+
+static int card_idle(void)
+{
+	return card.state == S_CMD && !card.selected && !card.out_n && !card.app;
+}
+
+/*
+ * Tests
+ */
+
+static void test_init(void)
+{
+	SD_CardInfo info;
+
+	CHECK(SD_Detect() == SD_PRESENT);
+	CHECK(SD_Init() == SD_RESPONSE_NO_ERROR);
+	CHECK(!card.idle);
+	CHECK(SD_GetCardInfo(&info) == SD_RESPONSE_NO_ERROR);
+	CHECK(info.CardCapacity == CARD_SIZE);
+	CHECK(info.CardBlockSize == BLOCK);
+	CHECK(info.SD_cid.ManufacturerID == 0x03);
+	CHECK(info.SD_cid.ProdSN == 0x12345678);
+	CHECK(card_idle());
+	CHECK(errors() == 0);
+}
+
+static void test_single(void)
+{
+	static uint8_t src[BLOCK], dst[BLOCK];
+	uint32_t addr = 100 * BLOCK;
+	unsigned long c17 = card.cmds[17], c24 = card.cmds[24];
+
+	fill_random(src, sizeof(src));
+	CHECK(SD_WriteBlock(src, addr, BLOCK) == SD_RESPONSE_NO_ERROR);
+	CHECK(memcmp(&mem[addr], src, BLOCK) == 0);
+	CHECK(!card_busy());
+	memset(dst, 0xA5, sizeof(dst));
+	CHECK(SD_ReadBlock(dst, addr, BLOCK) == SD_RESPONSE_NO_ERROR);
+	CHECK(memcmp(dst, src, BLOCK) == 0);
+	CHECK(card.cmds[17] - c17 == 1 && card.cmds[24] - c24 == 1);
+
+	/* out of range */
+	CHECK(SD_ReadBlock(dst, CARD_SIZE, BLOCK) == SD_RESPONSE_FAILURE);
+	CHECK(SD_WriteBlock(src, CARD_SIZE, BLOCK) == SD_RESPONSE_FAILURE);
+	CHECK(card_idle());
+	CHECK(errors() == 0);
+}
+
+static void test_multi(void)
+{
+	static uint8_t src[37 * BLOCK], dst[37 * BLOCK + 1];
+	uint32_t addr = 2000 * BLOCK;
+	unsigned long c17 = card.cmds[17], c18 = card.cmds[18], c12 = card.cmds[12];
+	unsigned long c24 = card.cmds[24], c25 = card.cmds[25];
+	unsigned long c55 = card.cmds[55], a23 = card.acmds[23];
+	unsigned long erased = card.erased_blocks;
+
+	fill_random(src, sizeof(src));
+	CHECK(SD_WriteMultiBlocks(src, addr, BLOCK, 37) == SD_RESPONSE_NO_ERROR);
+	CHECK(memcmp(&mem[addr], src, sizeof(src)) == 0);
+	/* one ACMD23 announcing 37 blocks, one CMD25 */
+	CHECK(card.cmds[55] - c55 == 1 && card.acmds[23] - a23 == 1);
+	CHECK(card.erased_blocks - erased == 37);
+	CHECK(card.cmds[25] - c25 == 1 && card.cmds[24] == c24);
+	CHECK(!card_busy());
+
+	memset(dst, 0xA5, sizeof(dst));
+	CHECK(SD_ReadMultiBlocks(dst, addr, BLOCK, 37) == SD_RESPONSE_NO_ERROR);
+	CHECK(memcmp(dst, src, sizeof(src)) == 0);
+	CHECK(dst[sizeof(src)] == 0xA5);
+	CHECK(card.cmds[18] - c18 == 1 && card.cmds[12] - c12 == 1);
+	CHECK(card.cmds[17] == c17);
+
+	/* the ACMD23 count only applies to the next CMD25 */
+	CHECK(SD_WriteBlock(src, addr, BLOCK) == SD_RESPONSE_NO_ERROR);
+	CHECK(card.preerase == 0 && card.preerase_next == 0);
+	CHECK(card_idle());
+	CHECK(errors() == 0);
+}
+
+/* A byte corrupted on the wire fails the read, and the card stays usable. */
+static void test_crc(void)
+{
+	static uint8_t dst[10 * BLOCK];
+	uint32_t addr = 2000 * BLOCK;
+	unsigned long c12 = card.cmds[12];
+
+	card.corrupt_in = 1;
+	CHECK(SD_ReadBlock(dst, addr, BLOCK) == SD_RESPONSE_FAILURE);
+	CHECK(card_idle());
+	CHECK(SD_ReadBlock(dst, addr, BLOCK) == SD_RESPONSE_NO_ERROR);
+	CHECK(memcmp(dst, &mem[addr], BLOCK) == 0);
+
+	card.corrupt_in = 6;
+	CHECK(SD_ReadMultiBlocks(dst, addr, BLOCK, 10) == SD_RESPONSE_FAILURE);
+	CHECK(memcmp(dst, &mem[addr], 5 * BLOCK) == 0);
+	CHECK(card.cmds[12] - c12 == 1);
+	CHECK(card_idle());
+	CHECK(SD_ReadMultiBlocks(dst, addr, BLOCK, 10) == SD_RESPONSE_NO_ERROR);
+	CHECK(memcmp(dst, &mem[addr], sizeof(dst)) == 0);
+	CHECK(errors() == 0);
+}
+
+static int near(uint32_t polls, unsigned long long ns, unsigned long long per)
+{
+	uint32_t expect = ns / per;
+
+	return polls + 4 >= expect && polls <= expect + 4;
+}
+
+static void test_latency(void)
+{
+	static uint8_t buf[8 * BLOCK];
+	SD_Latency lat;
+	uint32_t addr = 3000 * BLOCK;
+
+	SD_ResetLatency();
+	SD_GetLatency(&lat);
+	CHECK(lat.Command.Count == 0 && lat.ReadAccess.Count == 0 && lat.WriteBusy.Count == 0);
+
+	fill_random(buf, sizeof(buf));
+	CHECK(SD_WriteBlock(buf, addr, BLOCK) == SD_RESPONSE_NO_ERROR);
+	SD_GetLatency(&lat);
+	CHECK(lat.Command.Count == 1 && lat.Command.Last == 2);
+	CHECK(lat.WriteBusy.Count == 1);
+	CHECK(near(lat.WriteBusy.Last, TPROG_NS, BYTE_NS + CPU_BYTE_NS));
+
+	CHECK(SD_ReadBlock(buf, addr, BLOCK) == SD_RESPONSE_NO_ERROR);
+	SD_GetLatency(&lat);
+	CHECK(lat.ReadAccess.Count == 1);
+	CHECK(near(lat.ReadAccess.Last, NAC_NS, BYTE_NS + CPU_BYTE_NS));
+
+	/* CMD18: the first block waits longest */
+	SD_ResetLatency();
+	CHECK(SD_ReadMultiBlocks(buf, addr, BLOCK, 8) == SD_RESPONSE_NO_ERROR);
+	SD_GetLatency(&lat);
+	CHECK(lat.ReadAccess.Count == 8);
+	CHECK(near(lat.ReadAccess.Max, NAC_NS, BYTE_NS + CPU_BYTE_NS));
+	CHECK(lat.ReadAccess.Last < lat.ReadAccess.Max / 4);
+
+	/* CMD55, ACMD23, CMD25, then 8 blocks and the stop token */
+	SD_ResetLatency();
+	CHECK(SD_WriteMultiBlocks(buf, addr, BLOCK, 8) == SD_RESPONSE_NO_ERROR);
+	SD_GetLatency(&lat);
+	CHECK(lat.Command.Count == 3);
+	CHECK(lat.WriteBusy.Count == 9);
+	CHECK(near(lat.WriteBusy.Max, TERASED_NS, BYTE_NS + CPU_BYTE_NS) ||
+	      near(lat.WriteBusy.Max, TSTOP_NS, BYTE_NS + CPU_BYTE_NS));
+	CHECK(lat.WriteBusy.Total > 8 * (TERASED_NS / (BYTE_NS + CPU_BYTE_NS)));
+	CHECK(errors() == 0);
+}
+
+/* Single and multi-block calls mixed at random against a reference. */
+static void test_random(void)
+{
+	static uint8_t buf[64 * BLOCK];
+	uint32_t base = 8192 * BLOCK, span = 1024 * BLOCK;
+	int i, bad = 0;
+
+	memcpy(ref + base, mem + base, span);
+	for (i = 0; i < 400; i++) {
+		uint32_t n = 1 + rand() % 64;
+		uint32_t addr = base + (rand() % (span / BLOCK - n)) * BLOCK;
+		int op = rand() % 4;
+
+		if (rand() % 16 == 0)
+			card.corrupt_in = 1 + rand() % n;
+		if (op == 0) {
+			fill_random(buf, n * BLOCK);
+			if (SD_WriteMultiBlocks(buf, addr, BLOCK, n) != SD_RESPONSE_NO_ERROR)
+				bad++;
+			memcpy(ref + addr, buf, n * BLOCK);
+		} else if (op == 1) {
+			fill_random(buf, BLOCK);
+			if (SD_WriteBlock(buf, addr, BLOCK) != SD_RESPONSE_NO_ERROR)
+				bad++;
+			memcpy(ref + addr, buf, BLOCK);
+		} else {
+			int corrupt = card.corrupt_in;
+			SD_Error e = op == 2 ?
+				SD_ReadMultiBlocks(buf, addr, BLOCK, n) :
+				SD_ReadBlock(buf, addr, BLOCK);
+
+			if (op == 3)
+				n = 1;
+			if (corrupt && corrupt <= (int)n) {
+				if (e != SD_RESPONSE_FAILURE)
+					bad++;
+			} else if (e != SD_RESPONSE_NO_ERROR ||
+				   memcmp(buf, ref + addr, n * BLOCK) != 0) {
+				bad++;
+			}
+		}
+		card.corrupt_in = 0;
+		if (!card_idle())
+			bad++;
+	}
+	CHECK(bad == 0);
+	CHECK(memcmp(mem + base, ref + base, span) == 0);
+	CHECK(errors() == 0);
+}
+
+/*
+ * The driver as it was: one CMD17 or CMD24 per block, each byte through
+ * SD_ReadByte() or SD_WriteByte(), dummy CRC.
+ */
+static void old_read(uint8_t *p, uint32_t addr, uint32_t n)
+{
+	uint32_t i;
+
+	SD_CS_LOW();
+	while (n--) {
+		SD_SendCmd(SD_CMD_READ_SINGLE_BLOCK, addr, 0xFF);
+		CHECK(SD_GetResponse(SD_RESPONSE_NO_ERROR) == SD_RESPONSE_NO_ERROR);
+		CHECK(SD_GetResponse(SD_START_DATA_SINGLE_BLOCK_READ) == SD_RESPONSE_NO_ERROR);
+		for (i = 0; i < BLOCK; i++)
+			*p++ = SD_ReadByte();
+		SD_ReadByte();
+		SD_ReadByte();
+		addr += BLOCK;
+	}
+	SD_CS_HIGH();
+	SD_WriteByte(SD_DUMMY_BYTE);
+}
+
+static void old_write(const uint8_t *p, uint32_t addr, uint32_t n)
+{
+	uint32_t i;
+
+	SD_CS_LOW();
+	while (n--) {
+		SD_SendCmd(SD_CMD_WRITE_SINGLE_BLOCK, addr, 0xFF);
+		CHECK(SD_GetResponse(SD_RESPONSE_NO_ERROR) == SD_RESPONSE_NO_ERROR);
+		SD_WriteByte(SD_DUMMY_BYTE);
+		SD_WriteByte(SD_START_DATA_SINGLE_BLOCK_WRITE);
+		for (i = 0; i < BLOCK; i++)
+			SD_WriteByte(*p++);
+		SD_ReadByte();
+		SD_ReadByte();
+		CHECK(SD_GetDataResponse() == SD_DATA_OK);
+		addr += BLOCK;
+	}
+	SD_CS_HIGH();
+	SD_WriteByte(SD_DUMMY_BYTE);
+}
+
+static void bench(void)
+{
+	static uint8_t src[64 * BLOCK], dst[64 * BLOCK];
+	uint32_t addr = 16384 * BLOCK;
+	unsigned long long t0, old_rd, new_rd, old_wr, new_wr;
+	unsigned long crc_errors;
+	SD_Latency lat;
+
+	fill_random(src, sizeof(src));
+
+	crc_errors = card.crc_errors;
+	t0 = card.t;
+	old_write(src, addr, 64);
+	old_wr = card.t - t0;
+	CHECK(memcmp(&mem[addr], src, sizeof(src)) == 0);
+	/* the old driver sent no CRC */
+	CHECK(card.crc_errors - crc_errors == 64);
+	card.crc_errors = crc_errors;
+
+	t0 = card.t;
+	old_read(dst, addr, 64);
+	old_rd = card.t - t0;
+	CHECK(memcmp(dst, src, sizeof(src)) == 0);
+
+	fill_random(src, sizeof(src));
+	SD_ResetLatency();
+	t0 = card.t;
+	CHECK(SD_WriteMultiBlocks(src, addr, BLOCK, 64) == SD_RESPONSE_NO_ERROR);
+	new_wr = card.t - t0;
+	CHECK(memcmp(&mem[addr], src, sizeof(src)) == 0);
+
+	memset(dst, 0, sizeof(dst));
+	t0 = card.t;
+	CHECK(SD_ReadMultiBlocks(dst, addr, BLOCK, 64) == SD_RESPONSE_NO_ERROR);
+	new_rd = card.t - t0;
+	CHECK(memcmp(dst, src, sizeof(src)) == 0);
+	SD_GetLatency(&lat);
+
+	printf("read 32 KByte: %.2f ms with CMD17 byte by byte, %.2f ms with CMD18 by DMA\n",
+	       old_rd / 1e6, new_rd / 1e6);
+	printf("write 32 KByte: %.2f ms with CMD24 byte by byte, %.2f ms with ACMD23 + CMD25 by DMA\n",
+	       old_wr / 1e6, new_wr / 1e6);
+	printf("latency in bus bytes: command avg %.1f max %u, read access avg %.1f max %u, "
+	       "write busy avg %.1f max %u\n",
+	       (double)lat.Command.Total / lat.Command.Count, lat.Command.Max,
+	       (double)lat.ReadAccess.Total / lat.ReadAccess.Count, lat.ReadAccess.Max,
+	       (double)lat.WriteBusy.Total / lat.WriteBusy.Count, lat.WriteBusy.Max);
+	CHECK(new_rd * 2 < old_rd);
+	CHECK(new_wr * 3 < old_wr);
+	CHECK(errors() == 0);
+}
+
+static void run_tests(void)
+{
+	uint8_t local;
+
+	CHECK((uintptr_t)mem < 0x100000000ull && (uintptr_t)&local < 0x80000000ull);
+	srand(1);
+	memset(mem, 0xFF, sizeof(mem));
+	test_init();
+	test_single();
+	test_multi();
+	test_crc();
+	test_latency();
+	test_random();
+	bench();
+}
+
+int main(void)
+{
+	static ucontext_t main_ctx, test_ctx;
+	size_t stack_size = 1 << 20;
+	void *stack;
+
+	if (!getenv("VERBOSE"))
+		freopen("/dev/null", "w", stdout);
+
+	stack = mmap(NULL, stack_size, PROT_READ | PROT_WRITE,
+		     MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+	if (stack == MAP_FAILED) {
+		perror("test_spisd: mmap");
+		return 1;
+	}
+	getcontext(&test_ctx);
+	test_ctx.uc_stack.ss_sp = stack;
+	test_ctx.uc_stack.ss_size = stack_size;
+	test_ctx.uc_link = &main_ctx;
+	makecontext(&test_ctx, run_tests, 0);
+	swapcontext(&main_ctx, &test_ctx);
+
+	if (failures) {
+		fprintf(stderr, "test_spisd: %d checks failed\n", failures);
+		return 1;
+	}
+	fprintf(stderr, "test_spisd: ok\n");
+	return 0;
+}
@@ -0,0 +1,17 @@
+/*
+ * Stands in for stm32f10x.h: the types the USB-FS device driver takes
+ * from it. The driver's own headers are used as they are.
+ */
+#ifndef __STM32F10x_H
+#define __STM32F10x_H
+
+#include <stdint.h>
+
+#define __IO volatile
+
+typedef enum {FALSE = 0, TRUE = !FALSE} bool;
+typedef enum {RESET = 0, SET = !RESET} FlagStatus, ITStatus;
+typedef enum {DISABLE = 0, ENABLE = !DISABLE} FunctionalState;
+typedef enum {ERROR = 0, SUCCESS = !ERROR} ErrorStatus;
+
+#endif
@@ -0,0 +1,690 @@
+/*
+ * Runs the PMA copies, PMA streams and double-buffered bulk endpoint
+ * support of the ST USB-FS device driver (usb_mem.c, usb_int.c,
+ * usb_core.c) against a model of the STM32F103 USB peripheral.
+ *
+ * The PMA is 256 words of which only the low halfword holds data, two
+ * bytes per word, as the CPU sees it. The copies are checked byte for
+ * byte across every buffer alignment and length up to 130 bytes; the
+ * high halfwords and the words around the buffer must stay as they
+ * were, and user buffers end at a guard page so that a read or write
+ * past them faults.
+ *
+ * The endpoint registers have the hardware's write semantics: DTOG and
+ * STAT toggle when 1 is written, CTR is cleared by writing 0. The host
+ * side of a double-buffered bulk endpoint uses the buffer selected by
+ * DTOG and NAKs while SW_BUF selects the same one, as in RM0008. ISTR is
+ * derived from the CTR bits, and CTR_HP() dispatches to the endpoint
+ * callbacks.
+ *
+ * The timings are host figures for the copy of one 64-byte packet,
+ * against the copy loops the driver had before; they are not Cortex-M3
+ * cycles.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "usb_lib.h"
+
+static int failures;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: check failed: %s\n", \
+			__FILE__, __LINE__, #cond); \
+		failures++; \
+	} } while (0)
+
+/*
+ * USB peripheral
+ */
+
+uint32_t test_pma[256];
+uint32_t test_usb_regs[32];
+static uint16_t epreg[8];
+
+#define EP_TOGGLE_BITS (EP_DTOG_RX | EPRX_STAT | EP_DTOG_TX | EPTX_STAT)
+#define EP_RW_BITS     (EP_T_FIELD | EP_KIND | EPADDR_FIELD)
+#define EP_CTR_BITS    (EP_CTR_RX | EP_CTR_TX)
+
+void test_set_endpoint(uint8_t bEpNum, uint16_t wRegValue)
+{
+	uint16_t r = epreg[bEpNum];
+
+	r = (r & ~EP_RW_BITS) | (wRegValue & EP_RW_BITS);
+	r ^= wRegValue & EP_TOGGLE_BITS;
+	r &= ~EP_CTR_BITS | (wRegValue & EP_CTR_BITS);
+	epreg[bEpNum] = r;
+}
+
+uint16_t test_get_endpoint(uint8_t bEpNum)
+{
+	return epreg[bEpNum];
+}
+
+uint16_t test_get_istr(void)
+{
+	int ep;
+
+	for (ep = 0; ep < 8; ep++) {
+		if (epreg[ep] & EP_CTR_RX)
+			return ISTR_CTR | ISTR_DIR | ep;
+		if (epreg[ep] & EP_CTR_TX)
+			return ISTR_CTR | ep;
+	}
+	return 0;
+}
+
+/* BTABLE at 0: ADDR_TX, COUNT_TX, ADDR_RX, COUNT_RX of each endpoint */
+static uint32_t *btable(int ep, int field)
+{
+	return &test_pma[ep * 4 + field];
+}
+
+static uint8_t pma_byte(uint16_t addr)
+{
+	return test_pma[addr >> 1] >> ((addr & 1) * 8);
+}
+
+static void pma_set_byte(uint16_t addr, uint8_t b)
+{
+	uint32_t *w = &test_pma[addr >> 1];
+
+	if (addr & 1)
+		*w = (*w & ~0xFF00u) | b << 8;
+	else
+		*w = (*w & ~0x00FFu) | b;
+}
+
+static unsigned long host_naks, host_packets;
+
+/* OUT transaction on a double-buffered bulk endpoint: 0 if ACKed */
+static int host_out(int ep, const uint8_t *data, uint16_t len)
+{
+	uint16_t r = epreg[ep];
+	int dtog = !!(r & EP_DTOG_RX), sw_buf = !!(r & EP_DTOG_TX);
+	uint32_t *count = btable(ep, dtog ? 3 : 1);
+	uint16_t addr = *btable(ep, dtog ? 2 : 0);
+	uint16_t size, i;
+
+	if ((r & EPRX_STAT) != EP_RX_VALID)
+		return -2;
+	if (dtog == sw_buf) {
+		host_naks++;
+		return -1;
+	}
+	size = *count & 0x8000 ? ((*count >> 10 & 0x1F) + 1) * 32
+			       : (*count >> 10 & 0x1F) * 2;
+	CHECK(len <= size);
+	for (i = 0; i < len; i++)
+		pma_set_byte(addr + i, data[i]);
+	*count = (*count & ~0x3FFu) | len;
+	epreg[ep] ^= EP_DTOG_RX;
+	epreg[ep] |= EP_CTR_RX;
+	host_packets++;
+	return 0;
+}
+
+/* IN transaction on a double-buffered bulk endpoint: length, or -1 on NAK */
+static int host_in(int ep, uint8_t *data)
+{
+	uint16_t r = epreg[ep];
+	int dtog = !!(r & EP_DTOG_TX), sw_buf = !!(r & EP_DTOG_RX);
+	uint16_t addr = *btable(ep, dtog ? 2 : 0);
+	uint16_t len = *btable(ep, dtog ? 3 : 1) & 0x3FF;
+	uint16_t i;
+
+	if ((r & EPTX_STAT) != EP_TX_VALID)
+		return -2;
+	if (dtog == sw_buf) {
+		host_naks++;
+		return -1;
+	}
+	for (i = 0; i < len; i++)
+		data[i] = pma_byte(addr + i);
+	epreg[ep] ^= EP_DTOG_TX;
+	epreg[ep] |= EP_CTR_TX;
+	host_packets++;
+	return len;
+}
+
+/*
+ * Driver glue: usb_istr.c, usb_init.c and usb_prop.c of an application
+ */
+
+__IO uint16_t wIstr;
+uint8_t EPindex;
+DEVICE_INFO *pInformation;
+DEVICE_PROP *pProperty;
+USER_STANDARD_REQUESTS *pUser_Standard_Requests;
+DEVICE Device_Table = { 3, 1 };
+DEVICE_PROP Device_Property;
+DEVICE_INFO Device_Info;
+USER_STANDARD_REQUESTS User_Standard_Requests;
+
+static void nop(void)
+{
+}
+
+void (*pEpInt_IN[7])(void) = { nop, nop, nop, nop, nop, nop, nop };
+void (*pEpInt_OUT[7])(void) = { nop, nop, nop, nop, nop, nop, nop };
+
+static void glue_init(void)
+{
+	static USER_STANDARD_REQUESTS requests = {
+		nop, nop, nop, nop, nop, nop, nop, nop, nop
+	};
+
+	memset(epreg, 0, sizeof(epreg));
+	memset(test_pma, 0, sizeof(test_pma));
+	pInformation = &Device_Info;
+	pProperty = &Device_Property;
+	pUser_Standard_Requests = &requests;
+	Device_Info.Current_Configuration = 1;
+	host_naks = host_packets = 0;
+}
+
+/* CLEAR_FEATURE or SET_FEATURE(ENDPOINT_HALT) */
+static RESULT endpoint_halt(uint8_t address, int set)
+{
+	Device_Info.USBbmRequestType = STANDARD_REQUEST | ENDPOINT_RECIPIENT;
+	Device_Info.USBwValues.w = ENDPOINT_STALL;
+	Device_Info.USBwIndexs.w = 0;
+	Device_Info.USBwIndexs.bw.bb0 = address;
+	if (set) {
+		Device_Info.USBwValues.w = 0;
+		return Standard_SetEndPointFeature();
+	}
+	return Standard_ClearFeature();
+}
+
+/*
+ * Copies
+ */
+
+static uint8_t *guard_page_end;
+
+/* a buffer of len bytes that ends where the guard page starts */
+static uint8_t *at_guard(uint16_t len)
+{
+	return guard_page_end - len;
+}
+
+static void fill_pma(uint32_t seed)
+{
+	int i;
+
+	for (i = 0; i < 256; i++)
+		test_pma[i] = (seed + i * 0x9E3779B1u) | 0xA5000000u;
+}
+
+static void check_to_pma(const uint32_t *before, uint16_t addr,
+			 const uint8_t *src, uint16_t len)
+{
+	int w;
+
+	for (w = 0; w < 256; w++) {
+		int off = w * 2 - addr;
+
+		if (off < 0 || off >= len) {
+			CHECK(test_pma[w] == before[w]);
+			continue;
+		}
+		CHECK((test_pma[w] & 0xFFFF0000u) == (before[w] & 0xFFFF0000u));
+		CHECK((uint8_t)test_pma[w] == src[off]);
+		if (off + 1 < len)
+			CHECK((uint8_t)(test_pma[w] >> 8) == src[off + 1]);
+	}
+}
+
+static void test_copy_to_pma(void)
+{
+	static uint8_t pool[256];
+	uint32_t before[256];
+	uint16_t len, addr;
+	int align, i;
+
+	for (addr = 64; addr <= 66; addr += 2)
+		for (align = 0; align < 4; align++)
+			for (len = 0; len <= 130; len++) {
+				uint8_t *src = pool + 8 + align;
+
+				for (i = 0; i < len; i++)
+					src[i] = rand();
+				fill_pma(len * 7 + align);
+				memcpy(before, test_pma, sizeof(before));
+				UserToPMABufferCopy(src, addr, len);
+				check_to_pma(before, addr, src, len);
+
+				/* nothing past the buffer is read */
+				src = at_guard(len);
+				for (i = 0; i < len; i++)
+					src[i] = rand();
+				memcpy(before, test_pma, sizeof(before));
+				UserToPMABufferCopy(src, addr, len);
+				check_to_pma(before, addr, src, len);
+			}
+}
+
+static void test_copy_from_pma(void)
+{
+	static uint8_t pool[256];
+	uint16_t len, addr;
+	int align, i;
+
+	for (addr = 64; addr <= 66; addr += 2)
+		for (align = 0; align < 4; align++)
+			for (len = 0; len <= 130; len++) {
+				uint8_t *dst = pool + 8 + align;
+
+				fill_pma(len * 13 + align);
+				memset(pool, 0x5A, sizeof(pool));
+				PMAToUserBufferCopy(dst, addr, len);
+				for (i = 0; i < (int)sizeof(pool); i++) {
+					int off = pool + i - dst;
+
+					if (off < 0 || off >= len)
+						CHECK(pool[i] == 0x5A);
+					else
+						CHECK(pool[i] == pma_byte(addr + off));
+				}
+
+				/* nothing past the buffer is written */
+				dst = at_guard(len);
+				PMAToUserBufferCopy(dst, addr, len);
+				for (i = 0; i < len; i++)
+					CHECK(dst[i] == pma_byte(addr + i));
+			}
+}
+
+static void test_stream(void)
+{
+	static uint8_t pool[256];
+	uint8_t data[128], out[128];
+	uint32_t before[256];
+	int round;
+
+	for (round = 0; round < 20000; round++) {
+		uint16_t addr = 64 + 2 * (rand() % 32);
+		uint16_t len = rand() % 129, done, n;
+		PMA_STREAM s;
+		int i;
+
+		for (i = 0; i < len; i++)
+			data[i] = rand();
+		fill_pma(round);
+		memcpy(before, test_pma, sizeof(before));
+
+		PMAStreamInit(&s, addr);
+		for (done = 0; done < len; done += n) {
+			uint8_t *src = pool + 8 + rand() % 4;
+
+			n = rand() % 4 ? rand() % 8 : rand() % (len - done + 1);
+			if (n > len - done)
+				n = len - done;
+			memcpy(src, data + done, n);
+			PMAStreamWrite(&s, src, n);
+		}
+		CHECK(PMAStreamFlush(&s) == len);
+		check_to_pma(before, addr, data, len);
+
+		memset(out, 0, sizeof(out));
+		PMAStreamInit(&s, addr);
+		for (done = 0; done < len; done += n) {
+			uint8_t *dst = pool + 8 + rand() % 4;
+
+			n = rand() % 4 ? rand() % 8 : rand() % (len - done + 1);
+			if (n > len - done)
+				n = len - done;
+			memset(pool, 0x5A, sizeof(pool));
+			PMAStreamRead(&s, dst, n);
+			for (i = 0; i < (int)sizeof(pool); i++)
+				if (pool + i < dst || pool + i >= dst + n)
+					CHECK(pool[i] == 0x5A);
+			memcpy(out + done, dst, n);
+		}
+		CHECK(memcmp(out, data, len) == 0);
+	}
+}
+
+/*
+ * Double-buffered bulk endpoints
+ */
+
+#define OUT_EP        ENDP1
+#define IN_EP         ENDP2
+#define STREAM_LEN    20000
+
+static uint8_t stream[STREAM_LEN];
+static uint8_t got[STREAM_LEN];
+static uint32_t sent, received;
+
+/* packet lengths of the host, 0..64 with mostly full packets */
+static uint16_t next_len(uint32_t pos)
+{
+	uint16_t len = rand() % 3 ? 64 : rand() % 65;
+
+	if (len > STREAM_LEN - pos)
+		len = STREAM_LEN - pos;
+	return len;
+}
+
+/* the application reads the packet after releasing the buffer */
+static int out_early_release;
+static unsigned long out_overlap;
+
+static void ep1_out(void)
+{
+	uint16_t addr = GetEPDblBufRxAddr(OUT_EP);
+	uint16_t len = GetEPDblBufRxCount(OUT_EP);
+	uint8_t piece[64];
+	PMA_STREAM s;
+	uint16_t done, n;
+
+	if (out_early_release) {
+		FreeUserBuffer(OUT_EP, EP_DBUF_OUT);
+		/* the host sends into the other buffer meanwhile */
+		if (sent < STREAM_LEN) {
+			uint16_t next = next_len(sent);
+
+			if (host_out(OUT_EP, stream + sent, next) == 0) {
+				sent += next;
+				out_overlap++;
+			}
+		}
+	}
+	PMAStreamInit(&s, addr);
+	for (done = 0; done < len; done += n) {
+		n = 1 + rand() % 16;
+		if (n > len - done)
+			n = len - done;
+		PMAStreamRead(&s, piece, n);
+		CHECK(received + done + n <= STREAM_LEN);
+		if (received + done + n <= STREAM_LEN)
+			memcpy(got + received + done, piece, n);
+	}
+	received += len;
+	if (!out_early_release)
+		FreeUserBuffer(OUT_EP, EP_DBUF_OUT);
+}
+
+static void run_out(int early_release)
+{
+	int i, idle = 0;
+
+	glue_init();
+	pEpInt_OUT[OUT_EP - 1] = ep1_out;
+	SetEPDblBuffBulk(OUT_EP, EP_DBUF_OUT, 0x80, 0xC0, 64);
+	CHECK((epreg[OUT_EP] & EPRX_STAT) == EP_RX_VALID);
+	CHECK((epreg[OUT_EP] & EPTX_STAT) == EP_TX_DIS);
+	CHECK((epreg[OUT_EP] & (EP_T_FIELD | EP_KIND)) == (EP_BULK | EP_KIND));
+
+	for (i = 0; i < STREAM_LEN; i++)
+		stream[i] = rand();
+	memset(got, 0, sizeof(got));
+	sent = received = 0;
+	out_early_release = early_release;
+	out_overlap = 0;
+
+	while (received < STREAM_LEN && idle < 100) {
+		uint16_t len = next_len(sent);
+
+		/* two packets back to back before the interrupt is taken */
+		if (sent < STREAM_LEN && host_out(OUT_EP, stream + sent, len) == 0)
+			sent += len;
+		len = next_len(sent);
+		if (sent < STREAM_LEN && host_out(OUT_EP, stream + sent, len) == 0)
+			sent += len;
+		idle = test_get_istr() ? 0 : idle + 1;
+		CTR_HP();
+	}
+	CHECK(received == STREAM_LEN);
+	CHECK(memcmp(got, stream, STREAM_LEN) == 0);
+	if (early_release)
+		CHECK(out_overlap > 100);
+	printf("OUT %s release: %lu packets, %lu NAKs, %lu received while "
+	       "the application held a buffer\n",
+	       early_release ? "early" : "late", host_packets, host_naks,
+	       out_overlap);
+}
+
+static void test_dbl_out(void)
+{
+	run_out(0);
+	run_out(1);
+}
+
+/* IN: the next packet is filled while the last one waits to be sent */
+static uint32_t in_pos;
+static int in_ready;            /* a filled buffer waits for SetEPDblBufTxValid */
+static uint16_t in_ready_len;
+
+static void in_fill(void)
+{
+	uint16_t len = next_len(in_pos), done, n;
+	PMA_STREAM s;
+
+	if (in_ready || in_pos >= STREAM_LEN)
+		return;
+	PMAStreamInit(&s, GetEPDblBufTxAddr(IN_EP));
+	for (done = 0; done < len; done += n) {
+		n = 1 + rand() % 16;
+		if (n > len - done)
+			n = len - done;
+		PMAStreamWrite(&s, stream + in_pos + done, n);
+	}
+	in_ready_len = PMAStreamFlush(&s);
+	CHECK(in_ready_len == len);
+	in_pos += len;
+	in_ready = 1;
+}
+
+static void in_commit(void)
+{
+	if (in_ready) {
+		SetEPDblBufTxValid(IN_EP, in_ready_len);
+		in_ready = 0;
+	}
+}
+
+static void ep2_in(void)
+{
+	in_commit();
+	in_fill();
+}
+
+static void test_dbl_in(void)
+{
+	uint8_t packet[64];
+	int i, idle = 0, len;
+	unsigned long queued = 0;
+
+	glue_init();
+	pEpInt_IN[IN_EP - 1] = ep2_in;
+	SetEPDblBuffBulk(IN_EP, EP_DBUF_IN, 0x100, 0x140, 0);
+	CHECK((epreg[IN_EP] & EPTX_STAT) == EP_TX_VALID);
+	CHECK((epreg[IN_EP] & EPRX_STAT) == EP_RX_DIS);
+	CHECK(host_in(IN_EP, packet) == -1);
+
+	for (i = 0; i < STREAM_LEN; i++)
+		stream[i] = rand();
+	memset(got, 0, sizeof(got));
+	received = in_pos = 0;
+	in_ready = 0;
+
+	in_fill();
+	in_commit();
+	in_fill();
+	while (received < STREAM_LEN && idle < 100) {
+		if (in_ready)
+			queued++;
+		len = host_in(IN_EP, packet);
+		if (len >= 0) {
+			CHECK(received + len <= STREAM_LEN);
+			if (received + len <= STREAM_LEN)
+				memcpy(got + received, packet, len);
+			received += len;
+		}
+		idle = len >= 0 ? 0 : idle + 1;
+		CTR_HP();
+	}
+	CHECK(received == STREAM_LEN);
+	CHECK(memcmp(got, stream, STREAM_LEN) == 0);
+	CHECK(queued > 100);
+	printf("IN: %lu packets, next packet already filled for %lu of them\n",
+	       host_packets, queued);
+}
+
+static void test_clear_halt(void)
+{
+	uint8_t packet[64];
+	int state, i;
+
+	for (state = 0; state < 4; state++) {
+		/* OUT endpoint halted in any DTOG/SW_BUF state */
+		glue_init();
+		pEpInt_OUT[OUT_EP - 1] = ep1_out;
+		SetEPDblBuffBulk(OUT_EP, EP_DBUF_OUT, 0x80, 0xC0, 64);
+		if (state & 1)
+			ToggleDTOG_RX(OUT_EP);
+		if (state & 2)
+			ToggleDTOG_TX(OUT_EP);
+		CHECK(endpoint_halt(OUT_EP, 1) == USB_SUCCESS);
+		CHECK(host_out(OUT_EP, stream, 8) == -2);
+		CHECK(endpoint_halt(OUT_EP, 0) == USB_SUCCESS);
+		CHECK((epreg[OUT_EP] & EPRX_STAT) == EP_RX_VALID);
+
+		for (i = 0; i < 64; i++)
+			stream[i] = rand();
+		sent = received = 0;
+		out_early_release = 0;
+		CHECK(host_out(OUT_EP, stream, 32) == 0);
+		CTR_HP();
+		CHECK(host_out(OUT_EP, stream + 32, 32) == 0);
+		CTR_HP();
+		CHECK(received == 64);
+		CHECK(memcmp(got, stream, 64) == 0);
+
+		/* IN endpoint */
+		pEpInt_IN[IN_EP - 1] = nop;
+		SetEPDblBuffBulk(IN_EP, EP_DBUF_IN, 0x100, 0x140, 0);
+		if (state & 1)
+			ToggleDTOG_TX(IN_EP);
+		if (state & 2)
+			ToggleDTOG_RX(IN_EP);
+		CHECK(endpoint_halt(0x80 | IN_EP, 1) == USB_SUCCESS);
+		CHECK(host_in(IN_EP, packet) == -2);
+		CHECK(endpoint_halt(0x80 | IN_EP, 0) == USB_SUCCESS);
+		CHECK((epreg[IN_EP] & EPTX_STAT) == EP_TX_VALID);
+		/* nothing is sent until the application queues a packet */
+		CHECK(host_in(IN_EP, packet) == -1);
+		UserToPMABufferCopy(stream, GetEPDblBufTxAddr(IN_EP), 20);
+		SetEPDblBufTxValid(IN_EP, 20);
+		CHECK(host_in(IN_EP, packet) == 20);
+		CHECK(memcmp(packet, stream, 20) == 0);
+		CHECK(host_in(IN_EP, packet) == -1);
+	}
+}
+
+/*
+ * Timing
+ */
+
+/* the copy loops of the driver before the aligned paths */
+static void old_user_to_pma(uint8_t *pbUsrBuf, uint16_t wPMABufAddr, uint16_t wNBytes)
+{
+	uint32_t n = (wNBytes + 1) >> 1;
+	uint32_t i, temp1, temp2;
+	uint16_t *pdwVal = (uint16_t *)(wPMABufAddr * 2 + PMAAddr);
+
+	for (i = n; i != 0; i--) {
+		temp1 = (uint16_t)*pbUsrBuf;
+		pbUsrBuf++;
+		temp2 = temp1 | (uint16_t)*pbUsrBuf << 8;
+		*pdwVal++ = temp2;
+		pdwVal++;
+		pbUsrBuf++;
+	}
+}
+
+static void old_pma_to_user(uint8_t *pbUsrBuf, uint16_t wPMABufAddr, uint16_t wNBytes)
+{
+	uint32_t n = (wNBytes + 1) >> 1;
+	uint32_t i;
+	uint32_t *pdwVal = (uint32_t *)(wPMABufAddr * 2 + PMAAddr);
+
+	for (i = n; i != 0; i--) {
+		*(uint16_t *)pbUsrBuf++ = *pdwVal++;
+		pbUsrBuf++;
+	}
+}
+
+typedef void copy_fn(uint8_t *, uint16_t, uint16_t);
+
+static double ns_per_packet(copy_fn *fn, uint8_t *buf)
+{
+	struct timespec t0, t1;
+	int i, rounds = 200000;
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (i = 0; i < rounds; i++) {
+		fn(buf, 0x80, 64);
+		__asm__ volatile("" : : "r"(buf) : "memory");
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	return ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / rounds;
+}
+
+static void bench(void)
+{
+	static uint32_t words[20];
+	uint8_t *aligned = (uint8_t *)words, *odd = aligned + 1;
+
+	printf("64-byte packet to PMA, host ns: before %.1f, aligned %.1f, odd %.1f\n",
+	       ns_per_packet(old_user_to_pma, aligned),
+	       ns_per_packet(UserToPMABufferCopy, aligned),
+	       ns_per_packet(UserToPMABufferCopy, odd));
+	printf("64-byte packet from PMA, host ns: before %.1f, aligned %.1f, odd %.1f\n",
+	       ns_per_packet(old_pma_to_user, aligned),
+	       ns_per_packet(PMAToUserBufferCopy, aligned),
+	       ns_per_packet(PMAToUserBufferCopy, odd));
+}
+
+int main(void)
+{
+	long page = sysconf(_SC_PAGESIZE);
+	uint8_t *pages;
+
+	if (!getenv("VERBOSE"))
+		freopen("/dev/null", "w", stdout);
+
+	pages = mmap(NULL, 2 * page, PROT_READ | PROT_WRITE,
+		     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (pages == MAP_FAILED || mprotect(pages + page, page, PROT_NONE)) {
+		perror("test_usbpma: mmap");
+		return 1;
+	}
+	guard_page_end = pages + page;
+
+	srand(1);
+	test_copy_to_pma();
+	test_copy_from_pma();
+	test_stream();
+	test_dbl_out();
+	test_dbl_in();
+	test_clear_halt();
+	bench();
+
+	if (failures) {
+		fprintf(stderr, "test_usbpma: %d checks failed\n", failures);
+		return 1;
+	}
+	fprintf(stderr, "test_usbpma: ok\n");
+	return 0;
+}
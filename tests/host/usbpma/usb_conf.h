@@ -0,0 +1,8 @@
+/* Stands in for the application's usb_conf.h */
+#ifndef __USB_CONF_H
+#define __USB_CONF_H
+
+#define EP_NUM     (2)
+#define BTABLE_ADDRESS      (0x00)
+
+#endif
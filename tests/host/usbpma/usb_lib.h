@@ -0,0 +1,39 @@
+/*
+ * Stands in for usb_lib.h: includes the driver headers, then points the
+ * register and PMA accesses at the model in test_usbpma.c. The endpoint
+ * registers and ISTR go through functions because of their toggle,
+ * clear-by-writing-0 and read-only bits.
+ */
+#ifndef __USB_LIB_H
+#define __USB_LIB_H
+
+#include "stm32f10x.h"
+#include "usb_type.h"
+#include "usb_regs.h"
+#include "usb_def.h"
+#include "usb_core.h"
+#include "usb_init.h"
+#include "usb_mem.h"
+#include "usb_int.h"
+#include "usb_sil.h"
+
+extern uint32_t test_pma[256];
+extern uint32_t test_usb_regs[32];
+void test_set_endpoint(uint8_t bEpNum, uint16_t wRegValue);
+uint16_t test_get_endpoint(uint8_t bEpNum);
+uint16_t test_get_istr(void);
+
+#undef RegBase
+#define RegBase ((uintptr_t)test_usb_regs)
+#undef PMAAddr
+#define PMAAddr ((uintptr_t)test_pma)
+#undef _SetENDPOINT
+#define _SetENDPOINT(bEpNum, wRegValue) test_set_endpoint(bEpNum, (uint16_t)(wRegValue))
+#undef _GetENDPOINT
+#define _GetENDPOINT(bEpNum) test_get_endpoint(bEpNum)
+#undef _GetISTR
+#define _GetISTR() test_get_istr()
+#undef _SetISTR
+#define _SetISTR(wRegValue) ((void)(wRegValue))
+
+#endif